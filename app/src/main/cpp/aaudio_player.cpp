@@ -1,673 +1,1059 @@
 #include "aaudio_player.h"
+#include "aaudio_sink.h"
+#include "peak_index.h"
+#include "player_engine.h"
+#include "sink_pool.h"
 #include <aaudio/AAudio.h>
 #include <algorithm>
-#include <atomic>
-#include <cstring>
 #include <jni.h>
-#include <limits>
 #include <memory>
-#include <sstream>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
-// Latency test configuration
-#define LATENCY_TEST_ENABLE 0
+static std::unique_ptr<AudioSink> createAAudioSink() { return std::make_unique<AAudioSink>(); }
 
-#if LATENCY_TEST_ENABLE
-#define LATENCY_TEST_GPIO_FILE "/sys/class/gpio/gpio376/value"
-#define LATENCY_TEST_INTERVAL 100 // Toggle every 100 writes
+// Process-wide, only used to reach the Java side from native threads
+static JavaVM* g_jvm = nullptr;
 
-#include <cerrno>
-#include <fcntl.h>
-#include <unistd.h>
-#endif
+struct PlayerInstance;
 
-// AAudio Player implementation
-struct AudioPlayerState {
-    AAudioStream* stream = nullptr;
-    std::unique_ptr<WaveFile> waveFile;
-    std::atomic<bool> isPlaying{false};
+// Forwards engine events to the Kotlin AAudioPlayer that owns the instance
+class JavaPlaybackListener : public PlayerEngine::Listener {
+public:
+    explicit JavaPlaybackListener(PlayerInstance& player) : player_(player) {}
+
+    void onPlaybackStarted() override;
+    void onPlaybackStopped() override;
+    void onPlaybackError(const std::string& error) override;
+
+private:
+    PlayerInstance& player_;
+};
+
+// One native player, owned by an AAudioPlayer through an opaque handle
+struct PlayerInstance {
+    SinkPool sinkPool{createAAudioSink}; // Outlives the engine's sinks
+    PlayerEngine engine{[this] { return sinkPool.createSink(); }};
+    JavaPlaybackListener listener{*this};
 
     // Java callback related
-    JavaVM* jvm = nullptr;
     jobject playerInstance = nullptr;
     jmethodID onPlaybackStartedMethod = nullptr;
     jmethodID onPlaybackStoppedMethod = nullptr;
     jmethodID onPlaybackErrorMethod = nullptr;
 
-    // Configuration parameters
-    aaudio_usage_t usage = AAUDIO_USAGE_MEDIA;
-    aaudio_content_type_t contentType = AAUDIO_CONTENT_TYPE_MUSIC;
-    aaudio_performance_mode_t performanceMode = AAUDIO_PERFORMANCE_MODE_LOW_LATENCY;
-    aaudio_sharing_mode_t sharingMode = AAUDIO_SHARING_MODE_SHARED;
-    std::string audioFilePath = "/data/48k_2ch_16bit.wav";
-
-#if LATENCY_TEST_ENABLE
-    // Latency test variables
-    std::atomic<int> writeCounter{0};
-    std::atomic<bool> gpioState{false};
-    std::atomic<bool> muteAudio{false};
-    std::atomic<bool> latencyTestEnabled{false}; // 控制是否启用latency测试
-    int gpioFd = -1;                             // Pre-opened GPIO file descriptor
-#endif
-};
-
-static AudioPlayerState g_player;
-
-#if LATENCY_TEST_ENABLE
-// Optimized GPIO control functions for latency test
-static bool initGpio() {
-    g_player.gpioFd = open(LATENCY_TEST_GPIO_FILE, O_WRONLY);
-    if (g_player.gpioFd < 0) {
-        LOGE("Failed to open GPIO file: %s, errno: %d", LATENCY_TEST_GPIO_FILE, errno);
-        return false;
-    }
-    LOGI("GPIO file opened successfully: fd=%d", g_player.gpioFd);
-    return true;
-}
-
-static void closeGpio() {
-    if (g_player.gpioFd >= 0) {
-        close(g_player.gpioFd);
-        g_player.gpioFd = -1;
-    }
-}
+    // Configuration parameters, handed to the engine on each start
+    PlayerConfig config;
 
-static inline bool writeGpioValue(int value) {
-    if (g_player.gpioFd < 0) {
-        return false;
-    }
+    // Waveform index of the last loadNativePeakIndex, loaded and summarized off the UI thread
+    std::mutex peakIndexLock;
+    PeakIndex peakIndex;
+};
 
-    char buf = value ? '1' : '0';
-    ssize_t result = write(g_player.gpioFd, &buf, 1);
+static PlayerInstance* fromHandle(jlong handle) { return reinterpret_cast<PlayerInstance*>(handle); }
 
-    if (result != 1) {
-        LOGE("Failed to write GPIO value: %d, result: %zd, errno: %d", value, result, errno);
-        return false;
+// Listener methods run on the engine's event dispatcher thread, attached to the VM for its lifetime
+static void attachDispatcherThread() {
+    JNIEnv* env;
+    if (g_jvm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        LOGE("Failed to attach event dispatcher thread");
     }
-
-    return true;
 }
 
-static inline void toggleGpio() {
-    bool currentState = g_player.gpioState.load(std::memory_order_relaxed);
-    bool newState = !currentState;
+static void detachDispatcherThread() { g_jvm->DetachCurrentThread(); }
 
-    if (writeGpioValue(newState ? 1 : 0)) {
-        g_player.gpioState.store(newState, std::memory_order_relaxed);
-        // Remove debug log in callback to reduce overhead
-        // LOGD("GPIO toggled to: %d", newState ? 1 : 0);
+// A Java listener that throws must not leave the exception pending on the dispatcher thread
+static void clearJavaException(JNIEnv* env) {
+    if (env->ExceptionCheck()) {
+        LOGE("Exception in playback listener");
+        env->ExceptionDescribe();
+        env->ExceptionClear();
     }
 }
-#endif
 
-// Java callback functions
-static void notifyPlaybackStarted() {
-    if (g_player.jvm && g_player.playerInstance && g_player.onPlaybackStartedMethod) {
+void JavaPlaybackListener::onPlaybackStarted() {
+    if (g_jvm && player_.playerInstance && player_.onPlaybackStartedMethod) {
         JNIEnv* env;
-        if (g_player.jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
-            env->CallVoidMethod(g_player.playerInstance, g_player.onPlaybackStartedMethod);
+        if (g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+            env->CallVoidMethod(player_.playerInstance, player_.onPlaybackStartedMethod);
+            clearJavaException(env);
         }
     }
 }
 
-static void notifyPlaybackStopped() {
-    if (g_player.jvm && g_player.playerInstance && g_player.onPlaybackStoppedMethod) {
+void JavaPlaybackListener::onPlaybackStopped() {
+    if (g_jvm && player_.playerInstance && player_.onPlaybackStoppedMethod) {
         JNIEnv* env;
-        if (g_player.jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
-            env->CallVoidMethod(g_player.playerInstance, g_player.onPlaybackStoppedMethod);
+        if (g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+            env->CallVoidMethod(player_.playerInstance, player_.onPlaybackStoppedMethod);
+            clearJavaException(env);
         }
     }
 }
 
-static void notifyPlaybackError(const std::string& error) {
-    if (g_player.jvm && g_player.playerInstance && g_player.onPlaybackErrorMethod) {
+void JavaPlaybackListener::onPlaybackError(const std::string& error) {
+    if (g_jvm && player_.playerInstance && player_.onPlaybackErrorMethod) {
         JNIEnv* env;
-        if (g_player.jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        if (g_jvm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
             jstring errorStr = env->NewStringUTF(error.c_str());
-            env->CallVoidMethod(g_player.playerInstance, g_player.onPlaybackErrorMethod, errorStr);
+            env->CallVoidMethod(player_.playerInstance, player_.onPlaybackErrorMethod, errorStr);
             env->DeleteLocalRef(errorStr);
+            clearJavaException(env);
         }
     }
 }
 
-// Audio callback
-static aaudio_data_callback_result_t
-audioCallback(AAudioStream* stream, void* userData, void* audioData, int32_t numFrames) {
-    if (!g_player.isPlaying.load()) {
-        return AAUDIO_CALLBACK_RESULT_STOP;
+// JNI method implementations
+extern "C" {
+
+JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
+    g_jvm = vm;
+    LOGI("JNI_OnLoad - AAudio Player");
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT jlong JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_initializeNative(JNIEnv* env,
+                                                                                           jobject thiz,
+                                                                                           jstring filePath) {
+    LOGI("initializeNative");
+
+    // Save JVM reference
+    env->GetJavaVM(&g_jvm);
+
+    auto player = std::make_unique<PlayerInstance>();
+
+    // Get callback method IDs
+    jclass clazz = env->GetObjectClass(thiz);
+    player->onPlaybackStartedMethod = env->GetMethodID(clazz, "onNativePlaybackStarted", "()V");
+    player->onPlaybackStoppedMethod = env->GetMethodID(clazz, "onNativePlaybackStopped", "()V");
+    player->onPlaybackErrorMethod = env->GetMethodID(clazz, "onNativePlaybackError", "(Ljava/lang/String;)V");
+
+    if (!player->onPlaybackStartedMethod || !player->onPlaybackStoppedMethod || !player->onPlaybackErrorMethod) {
+        LOGE("Failed to get callback method IDs");
+        return 0;
+    }
+
+    // Save Java object reference
+    player->playerInstance = env->NewGlobalRef(thiz);
+
+    // Get file path
+    if (filePath) {
+        const char* path = env->GetStringUTFChars(filePath, nullptr);
+        player->config.audioFilePath = std::string(path);
+        env->ReleaseStringUTFChars(filePath, path);
     }
 
-    if (!g_player.waveFile || !g_player.waveFile->isOpen()) {
-        g_player.isPlaying.store(false);
-        notifyPlaybackError("[FILE] Audio file not opened");
-        return AAUDIO_CALLBACK_RESULT_STOP;
+    player->engine.setListener(&player->listener, attachDispatcherThread, detachDispatcherThread);
+    LOGI("Player instance created: %p", static_cast<void*>(player.get()));
+    return reinterpret_cast<jlong>(player.release());
+}
+
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeConfig(
+    JNIEnv* env, jobject thiz, jlong handle, jint usage, jint contentType, jint performanceMode, jint sharingMode,
+    jstring filePath) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
     }
 
-    // Calculate required bytes
-    int32_t channelCount = AAudioStream_getChannelCount(stream);
-    int32_t bytesPerSample = (AAudioStream_getFormat(stream) == AAUDIO_FORMAT_PCM_I16) ? 2 : 4;
-    int32_t bytesToRead = numFrames * channelCount * bytesPerSample;
+    LOGI("setNativeConfig");
 
-    size_t bytesRead = g_player.waveFile->readAudioData(audioData, bytesToRead);
+    // Update configuration parameters - direct integer assignment
+    player->config.usage = static_cast<aaudio_usage_t>(usage);
+    player->config.contentType = static_cast<aaudio_content_type_t>(contentType);
+    player->config.performanceMode = static_cast<aaudio_performance_mode_t>(performanceMode);
+    player->config.sharingMode = static_cast<aaudio_sharing_mode_t>(sharingMode);
 
-    if (bytesRead < static_cast<size_t>(bytesToRead)) {
-        // Playback completed
-        g_player.isPlaying.store(false);
-        notifyPlaybackStopped();
-        return AAUDIO_CALLBACK_RESULT_STOP;
+    if (filePath) {
+        const char* path = env->GetStringUTFChars(filePath, nullptr);
+        player->config.audioFilePath = std::string(path);
+        env->ReleaseStringUTFChars(filePath, path);
     }
 
-#if LATENCY_TEST_ENABLE
-    // Latency test logic - only execute if enabled
-    if (g_player.latencyTestEnabled.load(std::memory_order_relaxed)) {
-        int currentCount = g_player.writeCounter.fetch_add(1);
+    LOGI("Config updated: usage=%d, contentType=%d, performanceMode=%d, sharingMode=%d, file=%s",
+         player->config.usage, player->config.contentType, player->config.performanceMode,
+         player->config.sharingMode, player->config.audioFilePath.c_str());
 
-        if (currentCount % LATENCY_TEST_INTERVAL == 0) {
-            // Toggle GPIO every LATENCY_TEST_INTERVAL writes
-            toggleGpio();
+    return JNI_TRUE;
+}
 
-            // Toggle audio mute state
-            bool currentMuteState = g_player.muteAudio.load(std::memory_order_relaxed);
-            g_player.muteAudio.store(!currentMuteState, std::memory_order_relaxed);
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_startNativePlayback(JNIEnv* env,
+                                                                                                 jobject thiz,
+                                                                                                 jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-            // Reduce logging in callback for better performance
-            // Only log every 1000 intervals to avoid spam
-            if (currentCount % (LATENCY_TEST_INTERVAL * 1000) == 0) {
-                LOGD("Latency test: count=%d, gpio=%d, mute=%d", currentCount,
-                     g_player.gpioState.load(std::memory_order_relaxed) ? 1 : 0, !currentMuteState ? 1 : 0);
-            }
-        }
+    LOGI("startNativePlayback");
 
-        // Apply mute if enabled
-        if (g_player.muteAudio.load(std::memory_order_relaxed)) {
-            memset(audioData, 0, bytesToRead);
-        }
+    if (player->engine.isPlaying()) {
+        return JNI_FALSE;
     }
-#endif
 
-    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+    player->engine.setConfig(player->config);
+    return player->engine.start() ? JNI_TRUE : JNI_FALSE;
 }
 
-// Error callback
-static void errorCallback(AAudioStream* stream, void* userData, aaudio_result_t error) {
-    LOGE("AAudio error: %s", AAudio_convertResultToText(error));
-    g_player.isPlaying.store(false);
-    std::string errorMsg = "[STREAM] Playback stream error: ";
-    errorMsg += AAudio_convertResultToText(error);
-    notifyPlaybackError(errorMsg);
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_stopNativePlayback(JNIEnv* env,
+                                                                                            jobject thiz,
+                                                                                            jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
+    }
+
+    LOGI("stopNativePlayback");
+
+    player->engine.stop();
 }
 
-// Create AAudio stream
-static bool createAAudioStream() {
-    AAudioStreamBuilder* builder = nullptr;
-    aaudio_result_t result = AAudio_createStreamBuilder(&builder);
-    if (result != AAUDIO_OK) {
-        LOGE("Failed to create builder: %s", AAudio_convertResultToText(result));
-        return false;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_prewarmNativeStream(JNIEnv* env,
+                                                                                                 jobject thiz,
+                                                                                                 jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
     }
 
-    // Use WAV file parameters or default values
-    int32_t sampleRate = 48000;
-    int32_t channelCount = 2;
-    aaudio_format_t format = AAUDIO_FORMAT_PCM_I16;
+    LOGI("prewarmNativeStream");
 
-    if (g_player.waveFile && g_player.waveFile->isOpen()) {
-        sampleRate = g_player.waveFile->getSampleRate();
-        channelCount = g_player.waveFile->getChannelCount();
-        format = static_cast<aaudio_format_t>(g_player.waveFile->getAAudioFormat());
+    if (player->engine.isPlaying()) {
+        return JNI_FALSE;
     }
 
-    // Configure stream
-    AAudioStreamBuilder_setSampleRate(builder, sampleRate);
-    AAudioStreamBuilder_setChannelCount(builder, channelCount);
-    AAudioStreamBuilder_setFormat(builder, format);
-    AAudioStreamBuilder_setUsage(builder, g_player.usage);
-    AAudioStreamBuilder_setContentType(builder, g_player.contentType);
-    AAudioStreamBuilder_setSharingMode(builder, g_player.sharingMode);
-    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
-    AAudioStreamBuilder_setPerformanceMode(builder, g_player.performanceMode);
-
-    // Buffer configuration
-    int32_t bufferCapacity = (g_player.performanceMode == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY)
-                                 ? (sampleRate * 40) / 1000   // 40ms for low latency
-                                 : (sampleRate * 100) / 1000; // 100ms for power saving
-    AAudioStreamBuilder_setBufferCapacityInFrames(builder, bufferCapacity);
+    player->engine.setConfig(player->config);
+    return player->engine.prewarm() ? JNI_TRUE : JNI_FALSE;
+}
 
-    // Set callbacks
-    AAudioStreamBuilder_setDataCallback(builder, audioCallback, nullptr);
-    AAudioStreamBuilder_setErrorCallback(builder, errorCallback, nullptr);
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeStreamPool(
+    JNIEnv* env, jobject thiz, jlong handle, jint maxIdleStreams, jint idleTimeoutMs, jint powerSavingIdleTimeoutMs) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-    // Create stream
-    result = AAudioStreamBuilder_openStream(builder, &g_player.stream);
-    AAudioStreamBuilder_delete(builder);
-    if (result != AAUDIO_OK) {
-        LOGE("Failed to open stream: %s", AAudio_convertResultToText(result));
-        return false;
+    if (maxIdleStreams < 0 || idleTimeoutMs < 0 || powerSavingIdleTimeoutMs < 0) {
+        LOGE("Invalid stream pool config: max idle=%d, timeouts=%d/%dms", maxIdleStreams, idleTimeoutMs,
+             powerSavingIdleTimeoutMs);
+        return JNI_FALSE;
     }
 
-    // Optimize buffer size
-    int32_t framesPerBurst = AAudioStream_getFramesPerBurst(g_player.stream);
-    if (framesPerBurst > 0) {
-        int32_t optimalSize =
-            framesPerBurst * (g_player.performanceMode == AAUDIO_PERFORMANCE_MODE_LOW_LATENCY ? 2 : 4);
-        optimalSize = std::min(optimalSize, AAudioStream_getBufferCapacityInFrames(g_player.stream));
-        AAudioStream_setBufferSizeInFrames(g_player.stream, optimalSize);
+    SinkPool::Options options;
+    options.maxIdleSinks = maxIdleStreams;
+    options.idleTimeoutMs = idleTimeoutMs;
+    options.powerSavingIdleTimeoutMs = powerSavingIdleTimeoutMs;
+    player->sinkPool.setOptions(options);
+    return JNI_TRUE;
+}
+
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativePrefetchConfig(
+    JNIEnv* env, jobject thiz, jlong handle, jint depthMs, jint lowWaterPercent, jint highWaterPercent) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
     }
 
-    LOGI("Stream created: %dHz, %dch, format=%d, mode=%d", AAudioStream_getSampleRate(g_player.stream),
-         AAudioStream_getChannelCount(g_player.stream), AAudioStream_getFormat(g_player.stream),
-         AAudioStream_getPerformanceMode(g_player.stream));
+    LOGI("setNativePrefetchConfig");
 
-    return true;
-}
+    if (depthMs <= 0 || lowWaterPercent <= 0 || highWaterPercent <= lowWaterPercent || highWaterPercent > 100) {
+        LOGE("Invalid prefetch config: depth=%dms, lowWater=%d%%, highWater=%d%%", depthMs, lowWaterPercent,
+             highWaterPercent);
+        return JNI_FALSE;
+    }
 
-// JNI method implementations
-extern "C" {
+    // Takes effect on the next startNativePlayback
+    player->config.prefetchDepthMs = depthMs;
+    player->config.prefetchLowWaterPercent = lowWaterPercent;
+    player->config.prefetchHighWaterPercent = highWaterPercent;
 
-JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
-    g_player.jvm = vm;
-    LOGI("JNI_OnLoad - AAudio Player");
-    return JNI_VERSION_1_6;
+    LOGI("Prefetch config updated: depth=%dms, lowWater=%d%%, highWater=%d%%", depthMs, lowWaterPercent,
+         highWaterPercent);
+    return JNI_TRUE;
 }
 
-JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_initializeNative(JNIEnv* env,
-                                                                                              jobject thiz,
-                                                                                              jstring filePath) {
-    LOGI("initializeNative");
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeMemoryMapped(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jboolean enabled) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
+    }
 
-    // Save JVM reference
-    env->GetJavaVM(&g_player.jvm);
+    // Takes effect on the next startNativePlayback
+    player->config.ioMode = enabled ? AudioFile::IoMode::MemoryMap : AudioFile::IoMode::Stream;
+    LOGI("WAV I/O mode: %s", enabled ? "mmap" : "stream");
+}
 
-    // Save Java object reference
-    if (g_player.playerInstance) {
-        env->DeleteGlobalRef(g_player.playerInstance);
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeResampler(
+    JNIEnv* env, jobject thiz, jlong handle, jboolean enabled, jint quality) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
     }
-    g_player.playerInstance = env->NewGlobalRef(thiz);
 
-    // Get callback method IDs
-    jclass clazz = env->GetObjectClass(thiz);
-    g_player.onPlaybackStartedMethod = env->GetMethodID(clazz, "onNativePlaybackStarted", "()V");
-    g_player.onPlaybackStoppedMethod = env->GetMethodID(clazz, "onNativePlaybackStopped", "()V");
-    g_player.onPlaybackErrorMethod = env->GetMethodID(clazz, "onNativePlaybackError", "(Ljava/lang/String;)V");
+    // Takes effect on the next startNativePlayback
+    player->config.resampleToDeviceRate = enabled;
+    switch (quality) {
+    case 0:
+        player->config.resamplerQuality = Resampler::Quality::Low;
+        break;
+    case 2:
+        player->config.resamplerQuality = Resampler::Quality::High;
+        break;
+    default:
+        player->config.resamplerQuality = Resampler::Quality::Medium;
+        break;
+    }
+    LOGI("Resample to device rate: %s, quality=%s", enabled ? "on" : "off",
+         Resampler::getQualityName(player->config.resamplerQuality));
+}
 
-    if (!g_player.onPlaybackStartedMethod || !g_player.onPlaybackStoppedMethod || !g_player.onPlaybackErrorMethod) {
-        LOGE("Failed to get callback method IDs");
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeChannelMapping(
+    JNIEnv* env, jobject thiz, jlong handle, jint channelCount, jfloatArray matrix) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
         return JNI_FALSE;
     }
 
-    // Get file path
-    if (filePath) {
-        const char* path = env->GetStringUTFChars(filePath, nullptr);
-        g_player.audioFilePath = std::string(path);
-        env->ReleaseStringUTFChars(filePath, path);
+    if (channelCount < PlayerConfig::kChannelsOfDevice || channelCount > ChannelMatrix::kMaxChannels) {
+        LOGE("Invalid output channel count: %d", channelCount);
+        return JNI_FALSE;
     }
 
+    // Takes effect on the next startNativePlayback, the matrix size is checked against the file there
+    player->config.outputChannelCount = channelCount;
+    player->config.channelMatrix.clear();
+    if (matrix) {
+        jsize length = env->GetArrayLength(matrix);
+        player->config.channelMatrix.resize(static_cast<size_t>(length));
+        env->GetFloatArrayRegion(matrix, 0, length, player->config.channelMatrix.data());
+    }
+    LOGI("Output channels: %d, matrix: %s", channelCount, matrix ? "user" : "preset");
     return JNI_TRUE;
 }
 
-JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeConfig(
-    JNIEnv* env, jobject thiz, jint usage, jint contentType, jint performanceMode, jint sharingMode, jstring filePath) {
-    LOGI("setNativeConfig");
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativePrefetchStats(JNIEnv* env,
+                                                                                                      jobject thiz,
+                                                                                                      jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-    // Update configuration parameters - direct integer assignment
-    g_player.usage = static_cast<aaudio_usage_t>(usage);
-    g_player.contentType = static_cast<aaudio_content_type_t>(contentType);
-    g_player.performanceMode = static_cast<aaudio_performance_mode_t>(performanceMode);
-    g_player.sharingMode = static_cast<aaudio_sharing_mode_t>(sharingMode);
+    PrefetchReader::Stats stats = player->engine.getPrefetchStats();
 
-    if (filePath) {
-        const char* path = env->GetStringUTFChars(filePath, nullptr);
-        g_player.audioFilePath = std::string(path);
-        env->ReleaseStringUTFChars(filePath, path);
+    // Order must match AAudioPlayer.PrefetchStats
+    const jlong values[] = {
+        static_cast<jlong>(stats.underflowCount),   static_cast<jlong>(stats.underflowBytes),
+        static_cast<jlong>(stats.refillCount),      static_cast<jlong>(stats.maxRefillLagNs),
+        static_cast<jlong>(stats.totalRefillLagNs), static_cast<jlong>(stats.bytesPrefetched),
+        static_cast<jlong>(stats.fillLevel),        static_cast<jlong>(stats.capacity),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
     }
+    return result;
+}
 
-    LOGI("Config updated: usage=%d, contentType=%d, performanceMode=%d, sharingMode=%d, file=%s", g_player.usage,
-         g_player.contentType, g_player.performanceMode, g_player.sharingMode, g_player.audioFilePath.c_str());
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeStreamPoolStats(JNIEnv* env,
+                                                                                                        jobject thiz,
+                                                                                                        jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-    return JNI_TRUE;
+    SinkPool::Stats pool = player->sinkPool.getStats();
+    PlayerEngine::StartLatency latency = player->engine.getStartLatency();
+
+    // Order must match AAudioPlayer.StreamPoolStats
+    const jlong values[] = {
+        static_cast<jlong>(pool.warmOpens),         static_cast<jlong>(pool.coldOpens),
+        static_cast<jlong>(pool.reaped),            static_cast<jlong>(pool.discarded),
+        static_cast<jlong>(pool.idleCount),         static_cast<jlong>(latency.warmNs.count),
+        static_cast<jlong>(latency.warmNs.p50),     static_cast<jlong>(latency.warmNs.p99),
+        static_cast<jlong>(latency.warmNs.p999),    static_cast<jlong>(latency.warmNs.max),
+        static_cast<jlong>(latency.coldNs.count),   static_cast<jlong>(latency.coldNs.p50),
+        static_cast<jlong>(latency.coldNs.p99),     static_cast<jlong>(latency.coldNs.p999),
+        static_cast<jlong>(latency.coldNs.max),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
 }
 
-JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_startNativePlayback(JNIEnv* env,
-                                                                                                 jobject thiz) {
-    LOGI("startNativePlayback");
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeCallbackStats(JNIEnv* env,
+                                                                                                      jobject thiz,
+                                                                                                      jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-    if (g_player.isPlaying.load()) {
-        return JNI_FALSE;
+    CallbackStats::Snapshot stats = player->engine.getCallbackStats();
+    PlayerEngine::StreamInfo stream = player->engine.getStreamInfo();
+
+    // Order must match AAudioPlayer.CallbackStats
+    const jlong values[] = {
+        static_cast<jlong>(stats.callbackCount),
+        static_cast<jlong>(stats.deadlineMisses),
+        static_cast<jlong>(stats.xruns),
+        stream.framesPerBurst,
+        stream.bufferSizeInFrames,
+        static_cast<jlong>(stats.durationNs.p50),
+        static_cast<jlong>(stats.durationNs.p99),
+        static_cast<jlong>(stats.durationNs.p999),
+        static_cast<jlong>(stats.durationNs.max),
+        static_cast<jlong>(stats.intervalJitterNs.p50),
+        static_cast<jlong>(stats.intervalJitterNs.p99),
+        static_cast<jlong>(stats.intervalJitterNs.p999),
+        static_cast<jlong>(stats.intervalJitterNs.max),
+        static_cast<jlong>(stats.framesRequested.p50),
+        static_cast<jlong>(stats.framesRequested.p99),
+        static_cast<jlong>(stats.framesRequested.p999),
+        static_cast<jlong>(stats.framesRequested.max),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
     }
+    return result;
+}
 
-    g_player.waveFile = std::make_unique<WaveFile>();
-    if (!g_player.waveFile->open(g_player.audioFilePath)) {
-        LOGE("Failed to open: %s", g_player.audioFilePath.c_str());
-        g_player.waveFile.reset();
-        notifyPlaybackError("[FILE] Cannot open audio file");
-        return JNI_FALSE;
+JNIEXPORT jint JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_addNativeLayer(
+    JNIEnv* env, jobject thiz, jlong handle, jstring filePath, jfloat gain) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return -1;
+    }
+
+    if (!filePath) {
+        return -1;
     }
 
-    if (!createAAudioStream()) {
-        g_player.waveFile.reset();
-        notifyPlaybackError("[STREAM] Failed to create playback stream");
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    std::string layerPath(path);
+    env->ReleaseStringUTFChars(filePath, path);
+
+    return player->engine.addLayer(layerPath, gain);
+}
+
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_removeNativeLayer(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jint layerId) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
         return JNI_FALSE;
     }
 
-#if LATENCY_TEST_ENABLE
-    // Initialize latency test
-    if (!initGpio()) {
-        LOGE("Failed to initialize GPIO for latency test - latency test DISABLED");
-        g_player.latencyTestEnabled.store(false);
-        // Continue without latency test functionality
-    } else {
-        // Reset latency test counters
-        g_player.writeCounter.store(0);
-        g_player.gpioState.store(false);
-        g_player.muteAudio.store(false);
-        g_player.latencyTestEnabled.store(true);
-
-        // Initialize GPIO to low state
-        writeGpioValue(0);
-        LOGI("Latency test initialized: GPIO=%s, interval=%d", LATENCY_TEST_GPIO_FILE, LATENCY_TEST_INTERVAL);
-    }
-#endif
-
-    g_player.isPlaying.store(true);
-    aaudio_result_t result = AAudioStream_requestStart(g_player.stream);
-
-    if (result != AAUDIO_OK) {
-        LOGE("Failed to start: %s", AAudio_convertResultToText(result));
-        g_player.isPlaying.store(false);
-        AAudioStream_close(g_player.stream);
-        g_player.stream = nullptr;
-        g_player.waveFile.reset();
-        notifyPlaybackError("[STREAM] Failed to start playback stream");
+    return player->engine.removeLayer(layerId) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeLayerGain(
+    JNIEnv* env, jobject thiz, jlong handle, jint layerId, jfloat gain) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
         return JNI_FALSE;
     }
 
-    LOGI("Playback started successfully");
-    notifyPlaybackStarted();
-    return JNI_TRUE;
+    return player->engine.setLayerGain(layerId, gain) ? JNI_TRUE : JNI_FALSE;
 }
 
-JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_stopNativePlayback(JNIEnv* env, jobject thiz) {
-    LOGI("stopNativePlayback");
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_enqueueNativeTrack(JNIEnv* env,
+                                                                                                jobject thiz,
+                                                                                                jlong handle,
+                                                                                                jstring filePath) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-    g_player.isPlaying.store(false);
-
-    if (g_player.stream) {
-        aaudio_result_t result = AAudioStream_requestStop(g_player.stream);
-        if (result != AAUDIO_OK) {
-            LOGW("Failed to request stop: %s", AAudio_convertResultToText(result));
-        } else {
-            aaudio_stream_state_t state = AAUDIO_STREAM_STATE_STOPPING;
-            result = AAudioStream_waitForStateChange(g_player.stream, AAUDIO_STREAM_STATE_STOPPING, &state,
-                                                     100000000 // 100ms timeout in nanoseconds
-            );
-            if (result != AAUDIO_OK) {
-                LOGW("Failed to wait for stop: %s", AAudio_convertResultToText(result));
-            }
-        }
-        AAudioStream_close(g_player.stream);
-        g_player.stream = nullptr;
+    if (!filePath) {
+        return JNI_FALSE;
     }
 
-    g_player.waveFile.reset();
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    std::string trackPath(path);
+    env->ReleaseStringUTFChars(filePath, path);
 
-#if LATENCY_TEST_ENABLE
-    closeGpio();
-#endif
+    return player->engine.enqueue(trackPath) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_clearNativeQueue(JNIEnv* env,
+                                                                                          jobject thiz,
+                                                                                          jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
+    }
 
-    notifyPlaybackStopped();
+    player->engine.clearQueue();
 }
 
-JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_releaseNative(JNIEnv* env, jobject thiz) {
-    LOGI("Releasing AAudio player");
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeTransitions(JNIEnv* env,
+                                                                                                    jobject thiz,
+                                                                                                    jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-    // Stop playback if still playing
-    if (g_player.isPlaying.load()) {
-        Java_com_example_aaudioplayer_player_AAudioPlayer_stopNativePlayback(env, thiz);
+    std::vector<TrackQueue::Transition> transitions = player->engine.getTransitions();
+
+    // Order must match AAudioPlayer.TrackTransition
+    std::vector<jlong> values;
+    values.reserve(transitions.size() * 4);
+    for (const auto& transition : transitions) {
+        values.push_back(transition.fromIndex);
+        values.push_back(transition.toIndex);
+        values.push_back(transition.gapFrames);
+        values.push_back(transition.gapless ? 1 : 0);
     }
 
-    // Clean up Java references
-    if (g_player.playerInstance) {
-        env->DeleteGlobalRef(g_player.playerInstance);
-        g_player.playerInstance = nullptr;
+    auto count = static_cast<jsize>(values.size());
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values.data());
     }
+    return result;
+}
 
-    g_player.jvm = nullptr;
-    g_player.onPlaybackStartedMethod = nullptr;
-    g_player.onPlaybackStoppedMethod = nullptr;
-    g_player.onPlaybackErrorMethod = nullptr;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_seekNative(JNIEnv* env,
+                                                                                       jobject thiz,
+                                                                                       jlong handle,
+                                                                                       jlong frame) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-    LOGI("AAudio player released");
+    return player->engine.seek(static_cast<int64_t>(frame)) ? JNI_TRUE : JNI_FALSE;
 }
 
-} // extern "C"
+JNIEXPORT jlong JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativePosition(JNIEnv* env,
+                                                                                           jobject thiz,
+                                                                                           jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return 0;
+    }
+
+    return static_cast<jlong>(player->engine.getPosition());
+}
+
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeSeekLatency(JNIEnv* env,
+                                                                                                   jobject thiz,
+                                                                                                   jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-// ============================================================================
-// WaveFile Class Implementation
-// ============================================================================
+    LogLinearHistogram::Summary latency = player->engine.getSeekLatency();
 
-WaveFile::WaveFile() : isOpen_(false), header_{} {}
+    // Order must match AAudioPlayer.SeekLatency
+    const jlong values[] = {
+        static_cast<jlong>(latency.count), static_cast<jlong>(latency.p50), static_cast<jlong>(latency.p99),
+        static_cast<jlong>(latency.p999),  static_cast<jlong>(latency.max),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
 
-WaveFile::~WaveFile() noexcept { close(); }
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
 
-bool WaveFile::open(const std::string& filePath) {
-    close(); // Ensure previous file is closed
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeClipCacheLimits(
+    JNIEnv* env, jobject thiz, jlong handle, jlong budgetBytes, jlong maxClipBytes) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-    file_.open(filePath, std::ios::binary);
-    if (!file_.is_open()) {
-        LOGE("Failed to open file: %s", filePath.c_str());
-        return false;
+    if (budgetBytes < 0 || maxClipBytes < 0) {
+        LOGE("Invalid clip cache limits: budget=%lld, max clip=%lld", static_cast<long long>(budgetBytes),
+             static_cast<long long>(maxClipBytes));
+        return JNI_FALSE;
     }
+    player->engine.setClipCacheLimits(static_cast<size_t>(budgetBytes), static_cast<size_t>(maxClipBytes));
+    return JNI_TRUE;
+}
 
-    if (!readHeader()) {
-        LOGE("Failed to read WAV header from: %s", filePath.c_str());
-        close();
-        return false;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_preloadNativeClip(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jstring filePath) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
     }
 
-    if (!isValidFormat()) {
-        LOGE("Invalid WAV format in file: %s", filePath.c_str());
-        close();
-        return false;
+    if (!filePath) {
+        return JNI_FALSE;
     }
 
-    isOpen_ = true;
-    LOGI("Successfully opened WAV file: %s", filePath.c_str());
-    LOGI("Format: %s", getFormatInfo().c_str());
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    std::string clipPath(path);
+    env->ReleaseStringUTFChars(filePath, path);
 
-    return true;
+    return player->engine.preloadClip(clipPath) ? JNI_TRUE : JNI_FALSE;
 }
 
-void WaveFile::close() {
-    if (file_.is_open()) {
-        file_.close();
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_clearNativeClipCache(JNIEnv* env,
+                                                                                              jobject thiz,
+                                                                                              jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
     }
-    isOpen_ = false;
-    header_ = {};
+
+    player->engine.clearClipCache();
 }
 
-size_t WaveFile::readAudioData(void* buffer, size_t bufferSize) {
-    if (!isOpen_ || !buffer || bufferSize == 0) {
-        return 0;
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeClipCacheStats(JNIEnv* env,
+                                                                                                       jobject thiz,
+                                                                                                       jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
     }
 
-    // Check if bufferSize exceeds maximum streamsize value
-    constexpr auto maxStreamSize = static_cast<size_t>(std::numeric_limits<std::streamsize>::max());
-    size_t actualReadSize = std::min(bufferSize, maxStreamSize);
+    ClipCache::Stats stats = player->engine.getClipCacheStats();
+
+    // Order must match AAudioPlayer.ClipCacheStats
+    std::vector<jlong> values = {
+        static_cast<jlong>(stats.hits),      static_cast<jlong>(stats.misses),
+        static_cast<jlong>(stats.evictions), static_cast<jlong>(stats.bypasses),
+        static_cast<jlong>(stats.bytesUsed), static_cast<jlong>(stats.budgetBytes),
+        static_cast<jlong>(stats.clipCount),
+    };
+    for (const auto& firstFrame : stats.firstFrame) {
+        values.push_back(static_cast<jlong>(firstFrame.count));
+        values.push_back(static_cast<jlong>(firstFrame.totalNs));
+        values.push_back(static_cast<jlong>(firstFrame.maxNs));
+    }
 
-    auto readSize = static_cast<std::streamsize>(actualReadSize);
-    file_.read(static_cast<char*>(buffer), readSize);
-    auto bytesRead = static_cast<size_t>(file_.gcount());
+    auto count = static_cast<jsize>(values.size());
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values.data());
+    }
+    return result;
+}
 
-    if (bytesRead < bufferSize) {
-        // If insufficient data is read, fill remaining part with zeros
-        memset(static_cast<char*>(buffer) + bytesRead, 0, bufferSize - bytesRead);
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeBufferTuning(
+    JNIEnv* env, jobject thiz, jlong handle, jboolean enabled, jint stablePeriodMs, jint minBursts, jint maxBursts) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
+
+    if (stablePeriodMs < 0 || minBursts < 0 || maxBursts < 0 || (maxBursts > 0 && minBursts > maxBursts)) {
+        LOGE("Invalid buffer tuning: stable=%dms, bursts=%d..%d", stablePeriodMs, minBursts, maxBursts);
+        return JNI_FALSE;
     }
 
-    return bytesRead;
+    // Takes effect on the next startNativePlayback
+    BufferTuner::Options& options = player->config.bufferTuning;
+    options.enabled = enabled;
+    options.stablePeriodMs = stablePeriodMs;
+    options.minBursts = minBursts;
+    options.maxBursts = maxBursts;
+    LOGI("Buffer tuning: %s, stable=%dms, bursts=%d..%d", enabled ? "on" : "off", stablePeriodMs, minBursts,
+         maxBursts);
+    return JNI_TRUE;
 }
 
-bool WaveFile::isOpen() const { return isOpen_; }
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeBufferTuningStats(
+    JNIEnv* env, jobject thiz, jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
+
+    BufferTuner::Stats stats = player->engine.getBufferTuningStats();
 
-int32_t WaveFile::getAAudioFormat() const {
-    // Return AAudio format based on WAV file bit depth
-    // Return int32_t to avoid including AAudio header files
-    // AAudio format constant values:
-    // AAUDIO_FORMAT_PCM_I16 = 1
-    // AAUDIO_FORMAT_PCM_I24_PACKED = 2
-    // AAUDIO_FORMAT_PCM_I32 = 3
-    // AAUDIO_FORMAT_PCM_FLOAT = 4
-    switch (header_.bitsPerSample) {
-    case 16:
-        return 1; // AAUDIO_FORMAT_PCM_I16
-    case 24:
-        return 2; // AAUDIO_FORMAT_PCM_I24_PACKED
-    case 32:
-        return 3; // AAUDIO_FORMAT_PCM_I32
-    default:
-        return 1; // Default return 16-bit format
+    // Order must match AAudioPlayer.BufferTuningStats
+    const jlong values[] = {
+        static_cast<jlong>(stats.grows),     static_cast<jlong>(stats.shrinks),
+        static_cast<jlong>(stats.xrunCount), static_cast<jlong>(stats.bufferSizeInFrames),
+        static_cast<jlong>(stats.minFrames), static_cast<jlong>(stats.maxFrames),
+        static_cast<jlong>(stats.stablePeriodMs),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
+
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
     }
+    return result;
 }
 
-std::string WaveFile::getFormatInfo() const {
-    std::ostringstream oss;
-    oss << static_cast<int32_t>(header_.sampleRate) << "Hz, " << static_cast<int32_t>(header_.numChannels)
-        << " channels, " << static_cast<int32_t>(header_.bitsPerSample) << " bits, PCM";
-    return oss.str();
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeBufferTuningTrace(
+    JNIEnv* env, jobject thiz, jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
+
+    std::vector<BufferTuner::Decision> trace = player->engine.getBufferTuningTrace();
+
+    // Order must match AAudioPlayer.BufferTuningDecision
+    std::vector<jlong> values;
+    values.reserve(trace.size() * 5);
+    for (const auto& decision : trace) {
+        values.push_back(static_cast<jlong>(decision.timeNs));
+        values.push_back(decision.xrunCount);
+        values.push_back(decision.fromFrames);
+        values.push_back(decision.toFrames);
+        values.push_back(decision.reason == BufferTuner::Reason::Underrun ? 1 : 0);
+    }
+
+    auto count = static_cast<jsize>(values.size());
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values.data());
+    }
+    return result;
 }
 
-bool WaveFile::isValidFormat() const {
-    return (header_.audioFormat == 1 &&                               // PCM format
-            header_.numChannels > 0 && header_.numChannels <= 16 &&   // Reasonable channel count
-            header_.sampleRate > 0 && header_.sampleRate <= 192000 && // Reasonable sample rate
-            (header_.bitsPerSample == 8 || header_.bitsPerSample == 16 || header_.bitsPerSample == 24 ||
-             header_.bitsPerSample == 32) && // Supported bit depth
-            header_.dataSize > 0);           // Has audio data
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeLatencyEstimation(
+    JNIEnv* env, jobject thiz, jlong handle, jboolean enabled, jint sampleIntervalMs, jint logIntervalMs) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
+
+    if (sampleIntervalMs <= 0 || logIntervalMs < 0) {
+        LOGE("Invalid latency estimation: sample=%dms, log=%dms", sampleIntervalMs, logIntervalMs);
+        return JNI_FALSE;
+    }
+
+    // Takes effect on the next startNativePlayback
+    LatencyEstimator::Options& options = player->config.latencyEstimation;
+    options.enabled = enabled;
+    options.sampleIntervalMs = sampleIntervalMs;
+    options.logIntervalMs = logIntervalMs;
+    LOGI("Latency estimation: %s, sample=%dms, log=%dms", enabled ? "on" : "off", sampleIntervalMs, logIntervalMs);
+    return JNI_TRUE;
 }
 
-bool WaveFile::readHeader() {
-    file_.seekg(0, std::ios::beg);
-    return validateRiffHeader() && readFmtChunk() && findDataChunk();
+JNIEXPORT jdoubleArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeLatencyStats(JNIEnv* env,
+                                                                                                       jobject thiz,
+                                                                                                       jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
+
+    LatencyEstimator::Stats stats = player->engine.getLatencyStats();
+
+    // Order must match AAudioPlayer.LatencyStats
+    const jdouble values[] = {
+        static_cast<jdouble>(stats.latencyMs.count),
+        stats.latencyMs.mean,
+        stats.latencyMs.stdDev,
+        stats.latencyMs.min,
+        stats.latencyMs.max,
+        static_cast<jdouble>(stats.driftPpm.count),
+        stats.driftPpm.mean,
+        stats.driftPpm.stdDev,
+        static_cast<jdouble>(stats.rejected),
+    };
+    constexpr jsize count = sizeof(values) / sizeof(values[0]);
+
+    jdoubleArray result = env->NewDoubleArray(count);
+    if (result) {
+        env->SetDoubleArrayRegion(result, 0, count, values);
+    }
+    return result;
 }
 
-bool WaveFile::validateRiffHeader() {
-    // Read RIFF identifier
-    file_.read(header_.riffId, 4);
-    if (file_.gcount() != 4 || strncmp(header_.riffId, "RIFF", 4) != 0) {
-        LOGE("Invalid RIFF header");
-        return false;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeLatencyMarker(JNIEnv* env,
+                                                                                                   jobject thiz,
+                                                                                                   jlong handle,
+                                                                                                   jboolean enabled,
+                                                                                                   jint type,
+                                                                                                   jint trigger,
+                                                                                                   jstring triggerPath,
+                                                                                                   jint triggerFd,
+                                                                                                   jint periodMs,
+                                                                                                   jint durationMs) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
+
+    if (type < 0 || type > static_cast<jint>(LatencyMarker::Type::ToneBurst) || trigger < 0 ||
+        trigger > static_cast<jint>(LatencyMarker::Trigger::Pipe) || periodMs <= 0 || durationMs <= 0) {
+        LOGE("Invalid latency marker: type=%d, trigger=%d, period=%dms, duration=%dms", type, trigger, periodMs,
+             durationMs);
+        return JNI_FALSE;
     }
 
-    // Read file size
-    file_.read(reinterpret_cast<char*>(&header_.riffSize), 4);
-    if (file_.gcount() != 4) {
-        LOGE("Failed to read RIFF size");
-        return false;
+    // Takes effect on the next startNativePlayback, the fd is duplicated then
+    LatencyMarker::Options& options = player->config.latencyMarker;
+    options.enabled = enabled;
+    options.type = static_cast<LatencyMarker::Type>(type);
+    options.trigger = static_cast<LatencyMarker::Trigger>(trigger);
+    if (triggerPath) {
+        const char* path = env->GetStringUTFChars(triggerPath, nullptr);
+        options.triggerPath = std::string(path);
+        env->ReleaseStringUTFChars(triggerPath, path);
     }
+    options.triggerFd = triggerFd;
+    options.periodMs = periodMs;
+    options.durationMs = durationMs;
+    LOGI("Latency marker: %s, %s every %dms", enabled ? "on" : "off", LatencyMarker::getTypeName(options.type),
+         periodMs);
+    return JNI_TRUE;
+}
 
-    // Read WAVE identifier
-    file_.read(header_.waveId, 4);
-    if (file_.gcount() != 4 || strncmp(header_.waveId, "WAVE", 4) != 0) {
-        LOGE("Invalid WAVE header");
-        return false;
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeLatencyMarkers(JNIEnv* env,
+                                                                                                       jobject thiz,
+                                                                                                       jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
     }
 
-    return true;
+    std::vector<MarkerEvent> markers = player->engine.getLatencyMarkers();
+
+    // Order must match AAudioPlayer.LatencyMarkerEvent
+    std::vector<jlong> values;
+    values.reserve(markers.size() * 5);
+    for (const auto& marker : markers) {
+        values.push_back(marker.index);
+        values.push_back(marker.frame);
+        values.push_back(marker.offset);
+        values.push_back(marker.level);
+        values.push_back(static_cast<jlong>(marker.timeNs));
+    }
+
+    auto count = static_cast<jsize>(values.size());
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values.data());
+    }
+    return result;
 }
 
-bool WaveFile::readFmtChunk() {
-    char chunkId[4];
-    uint32_t chunkSize;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeDspChain(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jint startFadeMs,
+                                                                                               jint stopFadeMs,
+                                                                                               jint fadeShape,
+                                                                                               jfloatArray bands) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return JNI_FALSE;
+    }
 
-    // Find fmt subchunk
-    while (file_.good()) {
-        file_.read(chunkId, 4);
-        if (file_.gcount() != 4) {
-            LOGE("Failed to read chunk ID");
-            return false;
-        }
+    // Bands are flattened as (type, frequencyHz, q, gainDb)
+    jsize length = bands ? env->GetArrayLength(bands) : 0;
+    if (startFadeMs < 0 || stopFadeMs < 0 || fadeShape < 0 ||
+        fadeShape > static_cast<jint>(DspChain::FadeShape::Exponential) || length % 4 != 0 ||
+        length / 4 > DspChain::kMaxBands) {
+        LOGE("Invalid DSP chain: fades %d/%dms, shape=%d, %d band values", startFadeMs, stopFadeMs, fadeShape, length);
+        return JNI_FALSE;
+    }
+    std::vector<float> values(static_cast<size_t>(length));
+    if (length > 0) {
+        env->GetFloatArrayRegion(bands, 0, length, values.data());
+    }
 
-        file_.read(reinterpret_cast<char*>(&chunkSize), 4);
-        if (file_.gcount() != 4) {
-            LOGE("Failed to read chunk size");
-            return false;
+    // Takes effect on the next startNativePlayback, the bands are checked against the stream rate there
+    DspChain::Options& options = player->config.dsp;
+    options.startFadeMs = startFadeMs;
+    options.stopFadeMs = stopFadeMs;
+    options.fadeShape = static_cast<DspChain::FadeShape>(fadeShape);
+    options.bands.clear();
+    for (size_t i = 0; i < values.size(); i += 4) {
+        auto type = static_cast<int32_t>(values[i]);
+        if (type < 0 || type > static_cast<int32_t>(DspChain::FilterType::HighShelf)) {
+            LOGE("Invalid EQ band type: %d", type);
+            options.bands.clear();
+            return JNI_FALSE;
         }
+        DspChain::Band band;
+        band.type = static_cast<DspChain::FilterType>(type);
+        band.frequencyHz = values[i + 1];
+        band.q = values[i + 2];
+        band.gainDb = values[i + 3];
+        options.bands.push_back(band);
+    }
+    LOGI("DSP chain: fades %d/%dms %s, %zu EQ bands", startFadeMs, stopFadeMs,
+         DspChain::getFadeShapeName(options.fadeShape), options.bands.size());
+    return JNI_TRUE;
+}
 
-        if (strncmp(chunkId, "fmt ", 4) == 0) {
-            // Found fmt subchunk
-            strncpy(header_.fmtId, chunkId, 4);
-
-            // Read fmt data
-            file_.read(reinterpret_cast<char*>(&header_.audioFormat), 2);
-            file_.read(reinterpret_cast<char*>(&header_.numChannels), 2);
-            file_.read(reinterpret_cast<char*>(&header_.sampleRate), 4);
-            file_.read(reinterpret_cast<char*>(&header_.byteRate), 4);
-            file_.read(reinterpret_cast<char*>(&header_.blockAlign), 2);
-            file_.read(reinterpret_cast<char*>(&header_.bitsPerSample), 2);
-
-            // Skip extra fmt data (if any)
-            if (chunkSize > 16) {
-                skipChunk(static_cast<uint32_t>(chunkSize - 16));
-            }
-
-            return true;
-        } else {
-            // Skip other subchunks
-            skipChunk(chunkSize);
-        }
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeGain(JNIEnv* env,
+                                                                                       jobject thiz,
+                                                                                       jlong handle,
+                                                                                       jfloat gain) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return;
     }
 
-    LOGE("fmt chunk not found");
-    return false;
+    // Applies right away when playing and is kept for the next startNativePlayback
+    player->config.dsp.gain = gain;
+    player->engine.setGain(gain);
 }
 
-bool WaveFile::findDataChunk() {
-    char chunkId[4];
-    uint32_t chunkSize;
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeLevelMeter(JNIEnv* env,
+                                                                                                jobject thiz,
+                                                                                                jlong handle,
+                                                                                                jboolean enabled,
+                                                                                                jint windowMs) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player || windowMs <= 0) {
+        return JNI_FALSE;
+    }
 
-    // Find data subchunk
-    while (file_.good()) {
-        file_.read(chunkId, 4);
-        if (file_.gcount() != 4) {
-            LOGE("Failed to read chunk ID while looking for data");
-            return false;
-        }
+    // Takes effect on the next startNativePlayback
+    player->config.levelMeter.enabled = enabled == JNI_TRUE;
+    player->config.levelMeter.windowMs = windowMs;
+    LOGI("Level meter %s, %dms windows", enabled ? "enabled" : "disabled", windowMs);
+    return JNI_TRUE;
+}
 
-        file_.read(reinterpret_cast<char*>(&chunkSize), 4);
-        if (file_.gcount() != 4) {
-            LOGE("Failed to read chunk size while looking for data");
-            return false;
-        }
+JNIEXPORT jobject JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeLevelMeterBuffer(JNIEnv* env,
+                                                                                                     jobject thiz,
+                                                                                                     jlong handle) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player) {
+        return nullptr;
+    }
 
-        if (strncmp(chunkId, "data", 4) == 0) {
-            // Found data subchunk
-            strncpy(header_.dataId, chunkId, 4);
-            header_.dataSize = chunkSize;
+    // Wraps the engine's Region in place; Kotlin only reads it and drops the buffer before releaseNative
+    const LevelMeter::Region* region = player->engine.getLevelMeterRegion();
+    return env->NewDirectByteBuffer(const_cast<LevelMeter::Region*>(region),
+                                    static_cast<jlong>(LevelMeter::kRegionBytes));
+}
 
-            LOGD("Found data chunk: size = %u bytes", chunkSize);
-            return true;
-        } else {
-            // Skip other subchunks
-            skipChunk(chunkSize);
-        }
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_loadNativePeakIndex(JNIEnv* env,
+                                                                                                   jobject thiz,
+                                                                                                   jlong handle,
+                                                                                                   jstring filePath,
+                                                                                                   jstring cachePath,
+                                                                                                   jint threadCount) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player || !filePath) {
+        return nullptr;
+    }
+
+    const char* path = env->GetStringUTFChars(filePath, nullptr);
+    std::string audioPath(path);
+    env->ReleaseStringUTFChars(filePath, path);
+    PeakIndex::Options options;
+    options.threadCount = threadCount;
+    if (cachePath) {
+        path = env->GetStringUTFChars(cachePath, nullptr);
+        options.cachePath = path;
+        env->ReleaseStringUTFChars(cachePath, path);
+    }
+
+    // Blocking: maps the cache, or scans the file on all cores
+    std::lock_guard<std::mutex> lock(player->peakIndexLock);
+    if (!player->peakIndex.load(audioPath, options)) {
+        return nullptr;
+    }
+    const PeakIndex::BuildStats& stats = player->peakIndex.getBuildStats();
+    jlong values[] = {
+        static_cast<jlong>(player->peakIndex.getFrameCount()),
+        player->peakIndex.getSampleRate(),
+        player->peakIndex.getChannelCount(),
+        static_cast<jlong>(stats.source),
+        static_cast<jlong>(stats.framesScanned),
+        static_cast<jlong>(stats.elapsedNs),
+    };
+    auto count = static_cast<jsize>(sizeof(values) / sizeof(values[0]));
+    jlongArray result = env->NewLongArray(count);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, count, values);
+    }
+    return result;
+}
+
+JNIEXPORT jfloatArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeWaveform(JNIEnv* env,
+                                                                                                 jobject thiz,
+                                                                                                 jlong handle,
+                                                                                                 jlong startFrame,
+                                                                                                 jlong frameCount,
+                                                                                                 jint columns) {
+    PlayerInstance* player = fromHandle(handle);
+    if (!player || columns <= 0) {
+        return nullptr;
     }
 
-    LOGE("data chunk not found");
-    return false;
+    std::lock_guard<std::mutex> lock(player->peakIndexLock);
+    const PeakIndex& index = player->peakIndex;
+    std::vector<PeakIndex::Bin> bins(static_cast<size_t>(columns) * std::max(index.getChannelCount(), 1));
+    if (!index.summarize(startFrame, frameCount, columns, bins.data())) {
+        return nullptr;
+    }
+
+    // Flattened as (min, max, rms) per channel per column, full scale 1.0
+    std::vector<jfloat> values;
+    values.reserve(bins.size() * 3);
+    for (const PeakIndex::Bin& bin : bins) {
+        values.push_back(bin.min / 32768.0f);
+        values.push_back(bin.max / 32768.0f);
+        values.push_back(bin.rms / 65535.0f);
+    }
+    auto count = static_cast<jsize>(values.size());
+    jfloatArray result = env->NewFloatArray(count);
+    if (result) {
+        env->SetFloatArrayRegion(result, 0, count, values.data());
+    }
+    return result;
 }
 
-void WaveFile::skipChunk(uint32_t chunkSize) {
-    // Check if chunkSize exceeds maximum streamoff value
-    constexpr auto maxStreamOff = static_cast<uint64_t>(std::numeric_limits<std::streamoff>::max());
-    if (static_cast<uint64_t>(chunkSize) > maxStreamOff) {
-        LOGE("Chunk size too large: %u", chunkSize);
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_releaseNative(JNIEnv* env,
+                                                                                       jobject thiz,
+                                                                                       jlong handle) {
+    LOGI("Releasing AAudio player");
+
+    std::unique_ptr<PlayerInstance> player(fromHandle(handle));
+    if (!player) {
         return;
     }
 
-    file_.seekg(static_cast<std::streamoff>(chunkSize), std::ios::cur);
+    // Stop playback if still playing, the instance's threads are joined before the Java reference goes
+    if (player->engine.isPlaying()) {
+        player->engine.stop();
+    }
+
+    // Deliver pending notifications and join the dispatcher thread while the Java reference is valid
+    player->engine.setListener(nullptr);
 
-    // WAV files require subchunk size to be even, if odd need to skip one padding byte
-    if (chunkSize % 2 == 1) {
-        file_.seekg(1, std::ios::cur);
+    // Idle streams would otherwise hold the device until their timeout
+    player->sinkPool.clear();
+
+    // Clean up Java references
+    if (player->playerInstance) {
+        env->DeleteGlobalRef(player->playerInstance);
+        player->playerInstance = nullptr;
     }
-}
\ No newline at end of file
+
+    LOGI("AAudio player released");
+}
+
+} // extern "C"
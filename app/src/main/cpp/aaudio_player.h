@@ -1,18 +1,8 @@
 #ifndef AAUDIO_PLAYER_H
 #define AAUDIO_PLAYER_H
 
-#include <android/log.h>
-#include <cstdint>
-#include <fstream>
+#include "audio_log.h"
 #include <jni.h>
-#include <string>
-
-// Log macros
-#define LOG_TAG "AAudioPlayer"
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,6 +14,11 @@ extern "C" {
  * This header defines the JNI interface for the AAudio player functionality.
  * It provides functions to initialize, control, and manage audio playback
  * using Android's AAudio API with WAV file support.
+ *
+ * Every AAudioPlayer owns its own native player (engine, streams, file,
+ * callbacks and stats) through the opaque handle returned by
+ * initializeNative(), so several players can run side by side and be driven
+ * from different threads. The handle is invalid after releaseNative().
  */
 
 /**
@@ -31,39 +26,85 @@ extern "C" {
  * @param env JNI environment
  * @param thiz Java object instance
  * @param filePath Path to the audio file to play
- * @return JNI_TRUE if initialization successful, JNI_FALSE otherwise
+ * @return Handle of the new native player, 0 on failure
  */
-JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_initializeNative(JNIEnv* env,
-                                                                                              jobject thiz,
-                                                                                              jstring filePath);
+JNIEXPORT jlong JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_initializeNative(JNIEnv* env,
+                                                                                           jobject thiz,
+                                                                                           jstring filePath);
 
 /**
  * Start audio playback
  * @param env JNI environment
  * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
  * @return JNI_TRUE if playback started successfully, JNI_FALSE otherwise
  */
 JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_startNativePlayback(JNIEnv* env,
-                                                                                                 jobject thiz);
+                                                                                                 jobject thiz,
+                                                                                                 jlong handle);
 
 /**
  * Stop audio playback
  * @param env JNI environment
  * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_stopNativePlayback(JNIEnv* env,
+                                                                                            jobject thiz,
+                                                                                            jlong handle);
+
+/**
+ * Open the stream for the current configuration ahead of playback
+ * The stream is kept stopped in the stream pool, the next start only starts it.
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return JNI_TRUE if a stream is ready, JNI_FALSE if playing or opening failed
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_prewarmNativeStream(JNIEnv* env,
+                                                                                                 jobject thiz,
+                                                                                                 jlong handle);
+
+/**
+ * Configure the pool of opened, stopped streams
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param maxIdleStreams Streams kept open while not playing, 0 disables the pool
+ * @param idleTimeoutMs Idle time before a shared low-latency stream is closed
+ * @param powerSavingIdleTimeoutMs Idle time before any other stream is closed
+ * @return JNI_TRUE if configuration set successfully, JNI_FALSE otherwise
  */
-JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_stopNativePlayback(JNIEnv* env, jobject thiz);
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeStreamPool(
+    JNIEnv* env, jobject thiz, jlong handle, jint maxIdleStreams, jint idleTimeoutMs, jint powerSavingIdleTimeoutMs);
 
 /**
- * Release audio player resources
+ * Get stream pool counters and start latency
  * @param env JNI environment
  * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return Array of warmOpens, coldOpens, reaped, discarded, idleCount, then count/p50/p99/p99.9/max
+ *         of the time from start to first callback (ns) with a warm and with a newly opened stream
  */
-JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_releaseNative(JNIEnv* env, jobject thiz);
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeStreamPoolStats(JNIEnv* env,
+                                                                                                        jobject thiz,
+                                                                                                        jlong handle);
+
+/**
+ * Release audio player resources and destroy the native player
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle, invalid afterwards
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_releaseNative(JNIEnv* env,
+                                                                                       jobject thiz,
+                                                                                       jlong handle);
 
 /**
  * Set native audio configuration
  * @param env JNI environment
  * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
  * @param usage Audio usage integer value
  * @param contentType Audio content type integer value
  * @param performanceMode Performance mode integer value
@@ -72,132 +113,201 @@ JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_release
  * @return JNI_TRUE if configuration set successfully, JNI_FALSE otherwise
  */
 JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeConfig(
-    JNIEnv* env, jobject thiz, jint usage, jint contentType, jint performanceMode, jint sharingMode, jstring filePath);
+    JNIEnv* env, jobject thiz, jlong handle, jint usage, jint contentType, jint performanceMode, jint sharingMode,
+    jstring filePath);
 
-#ifdef __cplusplus
-}
+/**
+ * Set prefetch ring configuration, applied on the next playback start
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param depthMs Ring depth in milliseconds of audio
+ * @param lowWaterPercent Fill level (percent of depth) below which the reader refills
+ * @param highWaterPercent Fill level (percent of depth) the reader refills up to
+ * @return JNI_TRUE if configuration set successfully, JNI_FALSE otherwise
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativePrefetchConfig(
+    JNIEnv* env, jobject thiz, jlong handle, jint depthMs, jint lowWaterPercent, jint highWaterPercent);
+
+/**
+ * Select the WAV I/O backend, applied on the next playback start
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param enabled JNI_TRUE to memory-map the data chunk, JNI_FALSE for stream reads
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeMemoryMapped(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jboolean enabled);
+
+/**
+ * Configure in-process resampling to the device's native rate, takes effect on the next start
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param enabled Open the stream at the native rate and resample in the callback
+ * @param quality 0 = low, 1 = medium, 2 = high
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeResampler(
+    JNIEnv* env, jobject thiz, jlong handle, jboolean enabled, jint quality);
+
+/**
+ * Configure the stream channel count and remix matrix, takes effect on the next start
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param channelCount 0 = same as the file, -1 = device's native count, otherwise 1..16
+ * @param matrix Output channels x file channels gains (row-major), null for the preset downmix
+ * @return JNI_TRUE if the channel count is valid
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeChannelMapping(
+    JNIEnv* env, jobject thiz, jlong handle, jint channelCount, jfloatArray matrix);
+
+/**
+ * Get prefetch ring counters of the current playback
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return Array of underflowCount, underflowBytes, refillCount, maxRefillLagNs,
+ *         totalRefillLagNs, bytesPrefetched, fillLevel, capacity
+ */
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativePrefetchStats(JNIEnv* env,
+                                                                                                      jobject thiz,
+                                                                                                      jlong handle);
+
+/**
+ * Get audio callback timing statistics without pausing playback
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return Array of callbackCount, deadlineMisses, xruns, framesPerBurst, bufferSizeInFrames,
+ *         then p50/p99/p99.9/max of callback duration (ns), interval jitter (ns) and frames requested
+ */
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeCallbackStats(JNIEnv* env,
+                                                                                                      jobject thiz,
+                                                                                                      jlong handle);
 
 /**
- * WAV file management class
- * Supports WAV file reading, parsing and audio data extraction
- */
-class WaveFile {
-public:
-    // WAV file header structure
-    struct WaveHeader {
-        // RIFF header
-        char riffId[4];    // "RIFF"
-        uint32_t riffSize; // File size - 8
-        char waveId[4];    // "WAVE"
-
-        // fmt subchunk
-        char fmtId[4];          // "fmt "
-        uint16_t audioFormat;   // Audio format (1 = PCM)
-        uint16_t numChannels;   // Channel count
-        uint32_t sampleRate;    // Sample rate
-        uint32_t byteRate;      // Byte rate
-        uint16_t blockAlign;    // Block align
-        uint16_t bitsPerSample; // Bits per sample
-
-        // data subchunk
-        char dataId[4];    // "data"
-        uint32_t dataSize; // Audio data size
-    };
-
-    /**
-     * Constructor
-     */
-    WaveFile();
-
-    /**
-     * Destructor
-     */
-    ~WaveFile() noexcept;
-
-    // Disable copy and assignment
-    WaveFile(const WaveFile&) = delete;
-    WaveFile& operator=(const WaveFile&) = delete;
-
-    // Allow move
-    WaveFile(WaveFile&&) noexcept = default;
-    WaveFile& operator=(WaveFile&&) noexcept = default;
-
-    /**
-     * Open WAV file
-     * @param filePath File path
-     * @return Returns true on success, false on failure
-     */
-    bool open(const std::string& filePath);
-
-    /**
-     * Close file
-     */
-    void close();
-
-    /**
-     * Read audio data
-     * @param buffer Data buffer
-     * @param bufferSize Buffer size (bytes)
-     * @return Actual bytes read
-     */
-    size_t readAudioData(void* buffer, size_t bufferSize);
-
-    bool isOpen() const;
-
-    // Safe getter methods
-    int32_t getSampleRate() const { return static_cast<int32_t>(header_.sampleRate); }
-    int32_t getChannelCount() const { return static_cast<int32_t>(header_.numChannels); }
-
-    /**
-     * Get corresponding AAudio format
-     * @return AAudio format enumeration value
-     */
-    int32_t getAAudioFormat() const;
-
-    std::string getFormatInfo() const;
-
-    /**
-     * Validate WAV file format
-     * @return Returns true if format is correct
-     */
-    bool isValidFormat() const;
-
-private:
-    std::ifstream file_;
-    WaveHeader header_{};
-    bool isOpen_;
-
-    /**
-     * Read and validate WAV file header
-     * @return Returns true on success
-     */
-    bool readHeader();
-
-    /**
-     * Validate RIFF header
-     * @return Returns true if validation passes
-     */
-    bool validateRiffHeader();
-
-    /**
-     * Find and read fmt subchunk
-     * @return Returns true on success
-     */
-    bool readFmtChunk();
-
-    /**
-     * Find and locate data subchunk
-     * @return Returns true on success
-     */
-    bool findDataChunk();
-
-    /**
-     * Skip unknown subchunks
-     * @param chunkSize Subchunk size
-     */
-    void skipChunk(uint32_t chunkSize);
-};
+ * Mix another WAV file into the running playback
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param filePath WAV file, resampled and remixed to the stream as needed
+ * @param gain Linear gain
+ * @return Layer id, or -1 on failure
+ */
+JNIEXPORT jint JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_addNativeLayer(
+    JNIEnv* env, jobject thiz, jlong handle, jstring filePath, jfloat gain);
+
+/**
+ * Remove a mixed layer
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param layerId Id returned by addNativeLayer
+ * @return Returns true if the layer was playing
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_removeNativeLayer(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jint layerId);
+
+/**
+ * Change the gain of a mixed layer
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param layerId Id returned by addNativeLayer
+ * @param gain Linear gain
+ * @return Returns true if the layer was playing
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeLayerGain(
+    JNIEnv* env, jobject thiz, jlong handle, jint layerId, jfloat gain);
 
+/**
+ * Queue a WAV file to play gaplessly after the current one
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param filePath WAV file path
+ * @return Returns true if queued (only while playing)
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_enqueueNativeTrack(JNIEnv* env,
+                                                                                                jobject thiz,
+                                                                                                jlong handle,
+                                                                                                jstring filePath);
+
+/**
+ * Drop all queued files, the current one plays to its end
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_clearNativeQueue(JNIEnv* env,
+                                                                                          jobject thiz,
+                                                                                          jlong handle);
+
+/**
+ * Get the recent track transitions of the current playback
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return fromIndex, toIndex, gapFrames, gapless (0/1) for each transition, oldest first
+ */
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeTransitions(JNIEnv* env,
+                                                                                                    jobject thiz,
+                                                                                                    jlong handle);
+
+/**
+ * Set the clip cache limits, takes effect immediately
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param budgetBytes Total size of cached PCM, 0 disables the cache
+ * @param maxClipBytes Largest file kept in memory, larger ones are streamed
+ * @return JNI_TRUE if the limits are valid, JNI_FALSE otherwise
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_setNativeClipCacheLimits(
+    JNIEnv* env, jobject thiz, jlong handle, jlong budgetBytes, jlong maxClipBytes);
+
+/**
+ * Load a WAV file into the clip cache ahead of its first playback (blocking)
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @param filePath WAV file path
+ * @return JNI_TRUE if the file is cached, JNI_FALSE if unreadable or too large
+ */
+JNIEXPORT jboolean JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_preloadNativeClip(JNIEnv* env,
+                                                                                               jobject thiz,
+                                                                                               jlong handle,
+                                                                                               jstring filePath);
+
+/**
+ * Drop all cached clips
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ */
+JNIEXPORT void JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_clearNativeClipCache(JNIEnv* env,
+                                                                                              jobject thiz,
+                                                                                              jlong handle);
+
+/**
+ * Get clip cache counters
+ * @param env JNI environment
+ * @param thiz Java object instance
+ * @param handle Player handle from initializeNative
+ * @return Array of hits, misses, evictions, bypasses, bytesUsed, budgetBytes, clipCount,
+ *         then count/totalNs/maxNs of time-to-first-frame for the hit, miss and stream paths
+ */
+JNIEXPORT jlongArray JNICALL Java_com_example_aaudioplayer_player_AAudioPlayer_getNativeClipCacheStats(JNIEnv* env,
+                                                                                                       jobject thiz,
+                                                                                                       jlong handle);
+
+#ifdef __cplusplus
+}
 #endif
 
 #endif // AAUDIO_PLAYER_H
\ No newline at end of file
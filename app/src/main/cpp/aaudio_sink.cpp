@@ -0,0 +1,156 @@
+#include "aaudio_sink.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <ctime>
+
+AAudioSink::~AAudioSink() { close(); }
+
+bool AAudioSink::open(const AudioSinkConfig& config,
+                      DataCallback dataCallback,
+                      ErrorCallback errorCallback,
+                      void* userData) {
+    close();
+
+    dataCallback_ = dataCallback;
+    errorCallback_ = errorCallback;
+    userData_ = userData;
+
+    AAudioStreamBuilder* builder = nullptr;
+    aaudio_result_t result = AAudio_createStreamBuilder(&builder);
+    if (result != AAUDIO_OK) {
+        LOGE("Failed to create builder: %s", AAudio_convertResultToText(result));
+        return false;
+    }
+
+    // Configure stream
+    AAudioStreamBuilder_setSampleRate(builder, config.sampleRate);
+    AAudioStreamBuilder_setChannelCount(builder, config.channelCount);
+    AAudioStreamBuilder_setFormat(builder, static_cast<aaudio_format_t>(config.format));
+    AAudioStreamBuilder_setUsage(builder, static_cast<aaudio_usage_t>(config.usage));
+    AAudioStreamBuilder_setContentType(builder, static_cast<aaudio_content_type_t>(config.contentType));
+    AAudioStreamBuilder_setSharingMode(builder, static_cast<aaudio_sharing_mode_t>(config.sharingMode));
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setPerformanceMode(builder, static_cast<aaudio_performance_mode_t>(config.performanceMode));
+
+    // Buffer configuration, sized for 48kHz when the device picks the rate
+    int32_t sizingRate = config.sampleRate > 0 ? config.sampleRate : 48000;
+    int32_t bufferCapacity = config.isLowLatency() ? (sizingRate * 40) / 1000   // 40ms for low latency
+                                                   : (sizingRate * 100) / 1000; // 100ms for power saving
+    AAudioStreamBuilder_setBufferCapacityInFrames(builder, bufferCapacity);
+
+    // Set callbacks
+    AAudioStreamBuilder_setDataCallback(builder, onAudioData, this);
+    AAudioStreamBuilder_setErrorCallback(builder, onError, this);
+
+    // Create stream
+    result = AAudioStreamBuilder_openStream(builder, &stream_);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        LOGE("Failed to open stream: %s", AAudio_convertResultToText(result));
+        stream_ = nullptr;
+        return false;
+    }
+
+    // Starting buffer size, adapted while playing by BufferTuner
+    int32_t framesPerBurst = AAudioStream_getFramesPerBurst(stream_);
+    if (framesPerBurst > 0) {
+        int32_t optimalSize = framesPerBurst * (config.isLowLatency() ? 2 : 4);
+        optimalSize = std::min(optimalSize, AAudioStream_getBufferCapacityInFrames(stream_));
+        AAudioStream_setBufferSizeInFrames(stream_, optimalSize);
+    }
+
+    LOGI("Stream created: %dHz, %dch, format=%d, mode=%d", AAudioStream_getSampleRate(stream_),
+         AAudioStream_getChannelCount(stream_), AAudioStream_getFormat(stream_),
+         AAudioStream_getPerformanceMode(stream_));
+
+    return true;
+}
+
+bool AAudioSink::start() {
+    if (!stream_) {
+        return false;
+    }
+
+    aaudio_result_t result = AAudioStream_requestStart(stream_);
+    if (result != AAUDIO_OK) {
+        LOGE("Failed to start: %s", AAudio_convertResultToText(result));
+        return false;
+    }
+    return true;
+}
+
+bool AAudioSink::stop() {
+    if (!stream_) {
+        return false;
+    }
+
+    aaudio_result_t result = AAudioStream_requestStop(stream_);
+    if (result != AAUDIO_OK) {
+        LOGW("Failed to request stop: %s", AAudio_convertResultToText(result));
+        return false;
+    }
+
+    aaudio_stream_state_t state = AAUDIO_STREAM_STATE_STOPPING;
+    result = AAudioStream_waitForStateChange(stream_, AAUDIO_STREAM_STATE_STOPPING, &state,
+                                             100000000 // 100ms timeout in nanoseconds
+    );
+    if (result != AAUDIO_OK) {
+        LOGW("Failed to wait for stop: %s", AAudio_convertResultToText(result));
+        return false;
+    }
+    return true;
+}
+
+void AAudioSink::close() {
+    if (stream_) {
+        AAudioStream_close(stream_);
+        stream_ = nullptr;
+    }
+}
+
+int32_t AAudioSink::getSampleRate() const { return stream_ ? AAudioStream_getSampleRate(stream_) : 0; }
+
+int32_t AAudioSink::getChannelCount() const { return stream_ ? AAudioStream_getChannelCount(stream_) : 0; }
+
+SampleFormat AAudioSink::getFormat() const {
+    return stream_ ? static_cast<SampleFormat>(AAudioStream_getFormat(stream_)) : SampleFormat::Unspecified;
+}
+
+int32_t AAudioSink::getFramesPerBurst() const { return stream_ ? AAudioStream_getFramesPerBurst(stream_) : 0; }
+
+int32_t AAudioSink::getBufferSizeInFrames() const {
+    return stream_ ? AAudioStream_getBufferSizeInFrames(stream_) : 0;
+}
+
+int32_t AAudioSink::getBufferCapacityInFrames() const {
+    return stream_ ? AAudioStream_getBufferCapacityInFrames(stream_) : 0;
+}
+
+int32_t AAudioSink::setBufferSizeInFrames(int32_t numFrames) {
+    return stream_ ? AAudioStream_setBufferSizeInFrames(stream_, numFrames) : AAUDIO_ERROR_INVALID_STATE;
+}
+
+int32_t AAudioSink::getXRunCount() const { return stream_ ? AAudioStream_getXRunCount(stream_) : 0; }
+
+int64_t AAudioSink::getFramesWritten() const { return stream_ ? AAudioStream_getFramesWritten(stream_) : 0; }
+
+bool AAudioSink::getTimestamp(int64_t* framePosition, int64_t* timeNs) const {
+    // Fails with AAUDIO_ERROR_INVALID_STATE until the stream is running and has presented data
+    return stream_ && AAudioStream_getTimestamp(stream_, CLOCK_MONOTONIC, framePosition, timeNs) == AAUDIO_OK;
+}
+
+const char* AAudioSink::convertErrorToText(int32_t error) const { return AAudio_convertResultToText(error); }
+
+aaudio_data_callback_result_t
+AAudioSink::onAudioData(AAudioStream* stream, void* userData, void* audioData, int32_t numFrames) {
+    auto* sink = static_cast<AAudioSink*>(userData);
+    CallbackResult result = sink->dataCallback_(sink->userData_, audioData, numFrames);
+    return result == CallbackResult::Continue ? AAUDIO_CALLBACK_RESULT_CONTINUE : AAUDIO_CALLBACK_RESULT_STOP;
+}
+
+void AAudioSink::onError(AAudioStream* stream, void* userData, aaudio_result_t error) {
+    auto* sink = static_cast<AAudioSink*>(userData);
+    if (sink->errorCallback_) {
+        sink->errorCallback_(sink->userData_, error);
+    }
+}
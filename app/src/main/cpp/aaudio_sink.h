@@ -0,0 +1,52 @@
+#ifndef AAUDIO_SINK_H
+#define AAUDIO_SINK_H
+
+#include "audio_sink.h"
+#include <aaudio/AAudio.h>
+
+/**
+ * AudioSink backed by an AAudio output stream (callback mode)
+ */
+class AAudioSink : public AudioSink {
+public:
+    AAudioSink() = default;
+    ~AAudioSink() override;
+
+    // Disable copy and assignment
+    AAudioSink(const AAudioSink&) = delete;
+    AAudioSink& operator=(const AAudioSink&) = delete;
+
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override;
+    bool start() override;
+    bool stop() override;
+    void close() override;
+    bool isOpen() const override { return stream_ != nullptr; }
+
+    int32_t getSampleRate() const override;
+    int32_t getChannelCount() const override;
+    SampleFormat getFormat() const override;
+    int32_t getFramesPerBurst() const override;
+    int32_t getBufferSizeInFrames() const override;
+    int32_t getBufferCapacityInFrames() const override;
+    int32_t setBufferSizeInFrames(int32_t numFrames) override;
+    int32_t getXRunCount() const override;
+    int64_t getFramesWritten() const override;
+    bool getTimestamp(int64_t* framePosition, int64_t* timeNs) const override;
+    const char* convertErrorToText(int32_t error) const override;
+    const char* getName() const override { return "AAudio"; }
+
+private:
+    static aaudio_data_callback_result_t
+    onAudioData(AAudioStream* stream, void* userData, void* audioData, int32_t numFrames);
+    static void onError(AAudioStream* stream, void* userData, aaudio_result_t error);
+
+    AAudioStream* stream_ = nullptr;
+    DataCallback dataCallback_ = nullptr;
+    ErrorCallback errorCallback_ = nullptr;
+    void* userData_ = nullptr;
+};
+
+#endif // AAUDIO_SINK_H
@@ -0,0 +1,30 @@
+#include "audio_file.h"
+#include "audio_log.h"
+#include "flac_file.h"
+#include "wave_file.h"
+#include <cstring>
+#include <fstream>
+
+std::unique_ptr<AudioFile> openAudioFile(const std::string& filePath, AudioFile::IoMode ioMode) {
+    char signature[4] = {};
+    {
+        std::ifstream probe(filePath, std::ios::binary);
+        if (!probe.is_open()) {
+            LOGE("Failed to open file: %s", filePath.c_str());
+            return nullptr;
+        }
+        probe.read(signature, sizeof(signature));
+    }
+
+    std::unique_ptr<AudioFile> file;
+    if (memcmp(signature, "fLaC", 4) == 0 || memcmp(signature, "ID3", 3) == 0) {
+        file.reset(new FlacFile());
+    } else {
+        // WaveFile reports anything else as an invalid RIFF header
+        file.reset(new WaveFile());
+    }
+    if (!file->open(filePath, ioMode)) {
+        return nullptr;
+    }
+    return file;
+}
@@ -0,0 +1,107 @@
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include "audio_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Audio file delivering interleaved PCM in the sample format it stores
+ *
+ * WaveFile reads the data chunk as it is, FlacFile decodes. Readers (the
+ * prefetch reader, the clip cache) only see the PCM byte stream, so byte
+ * offsets are always positions in that stream, not in the file.
+ */
+class AudioFile {
+public:
+    // How audio data is read from the file
+    enum class IoMode {
+        Stream,    // std::ifstream reads (one syscall and copy per read)
+        MemoryMap, // mmap of the data, read in place where the format allows it
+    };
+
+    virtual ~AudioFile() = default;
+
+    /**
+     * Open and parse the file
+     * @param filePath File path
+     * @param ioMode Preferred I/O backend, a hint for formats that cannot be read in place
+     * @return Returns true on success, false on failure
+     */
+    virtual bool open(const std::string& filePath, IoMode ioMode) = 0;
+
+    virtual void close() = 0;
+
+    virtual bool isOpen() const = 0;
+
+    /**
+     * Read PCM data, the unserved rest of the buffer is zeroed
+     * @param buffer Data buffer
+     * @param bufferSize Buffer size (bytes)
+     * @return Actual bytes read, less than bufferSize only at the end
+     */
+    virtual size_t readAudioData(void* buffer, size_t bufferSize) = 0;
+
+    /**
+     * Move the read position
+     * @param offset Byte offset within the PCM data, clamped to its size
+     * @return Returns false if not open or the position cannot be reached
+     */
+    virtual bool seekAudioData(uint64_t offset) = 0;
+
+    /**
+     * Get the read position within the PCM data, in bytes
+     */
+    virtual uint64_t getDataPosition() const = 0;
+
+    /**
+     * Get the size of the PCM data, in bytes
+     */
+    virtual uint64_t getDataSize() const = 0;
+
+    virtual int32_t getSampleRate() const = 0;
+    virtual int32_t getChannelCount() const = 0;
+    virtual int32_t getBytesPerFrame() const = 0;
+
+    /**
+     * Get the sample format of the PCM data
+     */
+    virtual SampleFormat getSampleFormat() const = 0;
+
+    virtual std::string getFormatInfo() const = 0;
+
+    /**
+     * Get the most PCM one read may have to decode before it returns, in bytes
+     * Readers keep at least this much buffered ahead of the consumer.
+     * @return 0 for files whose data is read as it is stored
+     */
+    virtual size_t getDecodeUnitBytes() const { return 0; }
+
+    // In-place access, only for files whose data is memory-mapped PCM
+
+    virtual bool isMemoryMapped() const { return false; }
+
+    /**
+     * Get PCM data in place without copying, see WaveFile
+     * @return Bytes available at *data, 0 if not memory-mapped
+     */
+    virtual size_t mapAudioData(const void** /*data*/, size_t /*maxBytes*/) { return 0; }
+
+    /**
+     * Page in part of the PCM data ahead of use, see WaveFile
+     */
+    virtual void prefetchAudioData(uint64_t /*offset*/, size_t /*length*/, bool /*populate*/) const {}
+};
+
+/**
+ * Open a WAV or FLAC file, told apart by its signature rather than its name
+ * @param filePath File path
+ * @param ioMode Preferred I/O backend
+ * @return The opened file, or nullptr if it cannot be opened or is not supported
+ */
+std::unique_ptr<AudioFile> openAudioFile(const std::string& filePath,
+                                         AudioFile::IoMode ioMode = AudioFile::IoMode::MemoryMap);
+
+#endif // AUDIO_FILE_H
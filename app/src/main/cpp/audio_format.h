@@ -0,0 +1,40 @@
+#ifndef AUDIO_FORMAT_H
+#define AUDIO_FORMAT_H
+
+#include <cstdint>
+
+/**
+ * PCM sample formats
+ * Values match aaudio_format_t so they can be passed to AAudio unchanged,
+ * except U8 which only exists in files and is never requested from a device.
+ */
+enum class SampleFormat : int32_t {
+    Unspecified = 0,
+    I16 = 1,       // AAUDIO_FORMAT_PCM_I16
+    Float = 2,     // AAUDIO_FORMAT_PCM_FLOAT
+    I24Packed = 3, // AAUDIO_FORMAT_PCM_I24_PACKED
+    I32 = 4,       // AAUDIO_FORMAT_PCM_I32
+    U8 = 0x100,    // File only, offset binary
+};
+
+/**
+ * Get storage size of one sample
+ * @return Bytes per sample, 0 for an unspecified format
+ */
+inline int32_t getBytesPerSample(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::U8:
+        return 1;
+    case SampleFormat::I16:
+        return 2;
+    case SampleFormat::I24Packed:
+        return 3;
+    case SampleFormat::I32:
+    case SampleFormat::Float:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+#endif // AUDIO_FORMAT_H
@@ -0,0 +1,31 @@
+#ifndef AUDIO_LOG_H
+#define AUDIO_LOG_H
+
+// Log macros
+// On Android these go to logcat, on a host build (no liblog) they go to stderr
+#define LOG_TAG "AAudioPlayer"
+
+#ifdef __ANDROID__
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#else
+#include <cstdio>
+
+#define HOST_LOG(level, ...)                                                                                           \
+    do {                                                                                                               \
+        fprintf(stderr, "%s/" LOG_TAG ": ", level);                                                                    \
+        fprintf(stderr, __VA_ARGS__);                                                                                  \
+        fputc('\n', stderr);                                                                                           \
+    } while (0)
+
+#define LOGD(...) HOST_LOG("D", __VA_ARGS__)
+#define LOGI(...) HOST_LOG("I", __VA_ARGS__)
+#define LOGW(...) HOST_LOG("W", __VA_ARGS__)
+#define LOGE(...) HOST_LOG("E", __VA_ARGS__)
+#endif
+
+#endif // AUDIO_LOG_H
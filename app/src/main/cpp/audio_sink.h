@@ -0,0 +1,128 @@
+#ifndef AUDIO_SINK_H
+#define AUDIO_SINK_H
+
+#include "audio_format.h"
+#include <cstdint>
+
+/**
+ * Requested output stream parameters
+ * usage/contentType/performanceMode/sharingMode carry raw aaudio_* values;
+ * backends that have no such concept ignore them.
+ */
+struct AudioSinkConfig {
+    int32_t sampleRate = 48000; // 0 lets the device choose its native rate
+    int32_t channelCount = 2;   // 0 lets the device choose its native channel count
+    SampleFormat format = SampleFormat::I16;
+    int32_t usage = 1;             // AAUDIO_USAGE_MEDIA
+    int32_t contentType = 2;       // AAUDIO_CONTENT_TYPE_MUSIC
+    int32_t performanceMode = 12;  // AAUDIO_PERFORMANCE_MODE_LOW_LATENCY
+    int32_t sharingMode = 1;       // AAUDIO_SHARING_MODE_SHARED
+
+    bool isLowLatency() const { return performanceMode == 12; }
+
+    bool operator==(const AudioSinkConfig& other) const {
+        return sampleRate == other.sampleRate && channelCount == other.channelCount && format == other.format &&
+               usage == other.usage && contentType == other.contentType &&
+               performanceMode == other.performanceMode && sharingMode == other.sharingMode;
+    }
+};
+
+/**
+ * Output device abstraction
+ *
+ * A sink pulls audio through a data callback on its own (real-time) thread.
+ * The player only talks to this interface, so the whole pipeline can run
+ * against AAudio on a device or against a simulated device on a host.
+ */
+class AudioSink {
+public:
+    enum class CallbackResult {
+        Continue,
+        Stop,
+    };
+
+    /**
+     * Data callback, fill audioData with numFrames frames in the granted format
+     */
+    using DataCallback = CallbackResult (*)(void* userData, void* audioData, int32_t numFrames);
+
+    /**
+     * Error callback, the stream is unusable afterwards
+     */
+    using ErrorCallback = void (*)(void* userData, int32_t error);
+
+    virtual ~AudioSink() = default;
+
+    /**
+     * Open the output stream (stopped)
+     * @param config Requested stream parameters, the device may grant different ones
+     * @param dataCallback Called on the audio thread for every burst
+     * @param errorCallback Called when the stream fails
+     * @param userData Passed back to the callbacks
+     * @return Returns true on success
+     */
+    virtual bool open(const AudioSinkConfig& config,
+                      DataCallback dataCallback,
+                      ErrorCallback errorCallback,
+                      void* userData) = 0;
+
+    virtual bool start() = 0;
+
+    /**
+     * Stop the stream and wait (bounded) until the callback is no longer running
+     */
+    virtual bool stop() = 0;
+
+    virtual void close() = 0;
+
+    virtual bool isOpen() const = 0;
+
+    // Granted stream parameters, valid after open()
+    virtual int32_t getSampleRate() const = 0;
+    virtual int32_t getChannelCount() const = 0;
+    virtual SampleFormat getFormat() const = 0;
+    virtual int32_t getFramesPerBurst() const = 0;
+    virtual int32_t getBufferSizeInFrames() const = 0;
+    virtual int32_t getBufferCapacityInFrames() const = 0;
+
+    /**
+     * Set the part of the buffer used for latency tuning
+     * @return Actual buffer size or a negative error
+     */
+    virtual int32_t setBufferSizeInFrames(int32_t numFrames) = 0;
+
+    /**
+     * Get the number of underruns since the stream was opened
+     */
+    virtual int32_t getXRunCount() const = 0;
+
+    /**
+     * Get the number of frames handed to the stream since it was opened
+     */
+    virtual int64_t getFramesWritten() const = 0;
+
+    /**
+     * Get the time a recent frame was presented at the output
+     * @param framePosition Frame index (counted like getFramesWritten())
+     * @param timeNs When it was presented, CLOCK_MONOTONIC
+     * @return Returns false if the stream has no valid timestamp yet (not running, no data)
+     */
+    virtual bool getTimestamp(int64_t* framePosition, int64_t* timeNs) const = 0;
+
+    /**
+     * Get a readable description of an error code from this backend
+     */
+    virtual const char* convertErrorToText(int32_t error) const = 0;
+
+    /**
+     * True if open() took over an already opened stream (see SinkPool)
+     */
+    virtual bool isReused() const { return false; }
+
+    /**
+     * Get backend name for logs
+     */
+    virtual const char* getName() const = 0;
+};
+
+#endif // AUDIO_SINK_H
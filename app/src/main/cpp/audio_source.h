@@ -0,0 +1,33 @@
+#ifndef AUDIO_SOURCE_H
+#define AUDIO_SOURCE_H
+
+#include <cstdint>
+
+/**
+ * Pull source of interleaved float audio
+ *
+ * read() is called on the audio thread and must be real-time safe. Creating
+ * and destroying a source happens on a control thread.
+ */
+class AudioSource {
+public:
+    virtual ~AudioSource() = default;
+
+    virtual int32_t getSampleRate() const = 0;
+    virtual int32_t getChannelCount() const = 0;
+
+    /**
+     * Read frames as interleaved float in [-1, 1]
+     * @param buffer Destination, numFrames * channel count samples
+     * @param numFrames Frames requested
+     * @return Frames written, fewer than requested only at the end or on an underflow
+     */
+    virtual int32_t read(float* buffer, int32_t numFrames) = 0;
+
+    /**
+     * True once the end of the source has been read
+     */
+    virtual bool isFinished() const = 0;
+};
+
+#endif // AUDIO_SOURCE_H
@@ -0,0 +1,167 @@
+#include "buffer_tuner.h"
+#include "audio_log.h"
+#include "audio_sink.h"
+#include "callback_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <pthread.h>
+
+// Bound by reference in std::min, so it needs a definition before C++17
+constexpr int32_t BufferTuner::kMaxBackoff;
+
+BufferTuner::~BufferTuner() noexcept { stop(); }
+
+void BufferTuner::setOptions(const Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    options_.pollIntervalMs = std::max(options_.pollIntervalMs, 1);
+    options_.stablePeriodMs = std::max(options_.stablePeriodMs, 0);
+}
+
+BufferTuner::Options BufferTuner::getOptions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return options_;
+}
+
+bool BufferTuner::start(AudioSink* sink) {
+    stop();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_.clear();
+    stats_ = Stats();
+    active_ = options_;
+    if (!active_.enabled || !sink) {
+        return false;
+    }
+    burst_ = sink->getFramesPerBurst();
+    int32_t size = sink->getBufferSizeInFrames();
+    if (burst_ <= 0 || size <= 0) {
+        LOGW("Buffer tuner: stream reports burst=%d, size=%d, not tuning", burst_, size);
+        return false;
+    }
+
+    int32_t capacity = std::max(sink->getBufferCapacityInFrames(), size);
+    int32_t maxFrames = active_.maxBursts > 0 ? std::min(active_.maxBursts * burst_, capacity) : capacity;
+    int32_t minFrames = active_.minBursts > 0 ? active_.minBursts * burst_ : size;
+    stats_.maxFrames = std::max(maxFrames, burst_);
+    stats_.minFrames = std::min(std::max(minFrames, burst_), stats_.maxFrames);
+    if (size < stats_.minFrames || size > stats_.maxFrames) {
+        int32_t granted = sink->setBufferSizeInFrames(std::min(std::max(size, stats_.minFrames), stats_.maxFrames));
+        size = granted > 0 ? granted : size;
+    }
+    stats_.bufferSizeInFrames = size;
+    stats_.stablePeriodMs = active_.stablePeriodMs;
+
+    sink_ = sink;
+    startNs_ = CallbackStats::nowNs();
+    quietSinceNs_ = startNs_;
+    lastShrinkNs_ = 0;
+    lastXruns_ = sink->getXRunCount();
+    stats_.xrunCount = lastXruns_;
+    backoff_ = 1;
+
+    running_ = true;
+    thread_ = std::thread(&BufferTuner::tunerLoop, this);
+    LOGI("Buffer tuner started: size=%d, burst=%d, range=%d..%d frames, stable=%dms", size, burst_,
+         stats_.minFrames, stats_.maxFrames, active_.stablePeriodMs);
+    return true;
+}
+
+void BufferTuner::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wakeup_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    sink_ = nullptr;
+}
+
+std::vector<BufferTuner::Decision> BufferTuner::getTrace() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<Decision>(trace_.begin(), trace_.end());
+}
+
+BufferTuner::Stats BufferTuner::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void BufferTuner::tunerLoop() {
+    pthread_setname_np(pthread_self(), "aap-buftuner");
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        lock.unlock();
+        update(CallbackStats::nowNs());
+        lock.lock();
+        if (running_) {
+            wakeup_.wait_for(lock, std::chrono::milliseconds(active_.pollIntervalMs));
+        }
+    }
+}
+
+void BufferTuner::update(uint64_t nowNs) {
+    int32_t xruns = sink_->getXRunCount();
+    int32_t size = sink_->getBufferSizeInFrames();
+    uint64_t stablePeriodNs = static_cast<uint64_t>(active_.stablePeriodMs) * 1000000ULL;
+
+    // Restarting a stream may reset its counter
+    if (xruns < lastXruns_) {
+        lastXruns_ = xruns;
+    }
+
+    if (xruns > lastXruns_) {
+        lastXruns_ = xruns;
+        quietSinceNs_ = nowNs;
+        // The last shrink went too far, wait longer before trying again
+        if (lastShrinkNs_ != 0 && nowNs - lastShrinkNs_ < stablePeriodNs) {
+            backoff_ = std::min(backoff_ * 2, kMaxBackoff);
+            lastShrinkNs_ = 0;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.xrunCount = xruns;
+            stats_.stablePeriodMs = active_.stablePeriodMs * backoff_;
+        }
+        if (size < stats_.maxFrames) {
+            apply(std::min(size + burst_, stats_.maxFrames), Reason::Underrun, nowNs);
+        }
+        return;
+    }
+
+    if (size - burst_ >= stats_.minFrames && nowNs - quietSinceNs_ >= stablePeriodNs * backoff_) {
+        apply(size - burst_, Reason::Stable, nowNs);
+        lastShrinkNs_ = nowNs;
+    }
+}
+
+void BufferTuner::apply(int32_t targetFrames, Reason reason, uint64_t nowNs) {
+    int32_t fromFrames = sink_->getBufferSizeInFrames();
+    int32_t granted = sink_->setBufferSizeInFrames(targetFrames);
+    quietSinceNs_ = nowNs;
+    if (granted < 0) {
+        LOGW("Buffer tuner: cannot set %d frames: %s", targetFrames, sink_->convertErrorToText(granted));
+        return;
+    }
+
+    Decision decision;
+    decision.timeNs = nowNs - startNs_;
+    decision.xrunCount = lastXruns_;
+    decision.fromFrames = fromFrames;
+    decision.toFrames = granted;
+    decision.reason = reason;
+    LOGI("Buffer tuner: %s %d -> %d frames (xruns=%d, t=%llums)", reason == Reason::Underrun ? "underrun" : "stable",
+         fromFrames, granted, lastXruns_, static_cast<unsigned long long>(decision.timeNs / 1000000ULL));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    (reason == Reason::Underrun ? stats_.grows : stats_.shrinks)++;
+    stats_.bufferSizeInFrames = granted;
+    trace_.push_back(decision);
+    if (trace_.size() > kMaxDecisions) {
+        trace_.pop_front();
+    }
+}
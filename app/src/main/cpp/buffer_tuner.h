@@ -0,0 +1,130 @@
+#ifndef BUFFER_TUNER_H
+#define BUFFER_TUNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AudioSink;
+
+/**
+ * Adaptive stream buffer size
+ *
+ * The sink opens with a fixed buffer (2 bursts for low latency, 4 otherwise),
+ * which underruns on some devices and adds needless latency on others. A
+ * tuner thread polls the sink's underrun counter: every poll that saw new
+ * underruns grows the buffer by one burst, and a buffer that stayed clean
+ * for a stable period shrinks by one burst, between a floor and the stream
+ * capacity. A shrink that underruns again within one stable period doubles
+ * the period required for the next shrink, so the size settles instead of
+ * oscillating.
+ *
+ * The audio thread is never involved; every decision is logged and kept in
+ * a short trace.
+ */
+class BufferTuner {
+public:
+    struct Options {
+        bool enabled = true;
+        int32_t pollIntervalMs = 10;
+        int32_t stablePeriodMs = 5000; // Underrun-free time before shrinking by one burst
+        int32_t minBursts = 0;         // Floor, 0 for the size the stream opened with
+        int32_t maxBursts = 0;         // Ceiling, 0 for the stream capacity
+    };
+
+    enum class Reason : int32_t {
+        Underrun,
+        Stable,
+    };
+
+    /**
+     * One buffer size change
+     */
+    struct Decision {
+        uint64_t timeNs = 0;    // Since start()
+        int32_t xrunCount = 0;  // Stream underrun counter when deciding
+        int32_t fromFrames = 0;
+        int32_t toFrames = 0;   // As granted by the stream
+        Reason reason = Reason::Underrun;
+    };
+
+    struct Stats {
+        uint64_t grows = 0;
+        uint64_t shrinks = 0;
+        int32_t xrunCount = 0;
+        int32_t bufferSizeInFrames = 0;
+        int32_t minFrames = 0;
+        int32_t maxFrames = 0;
+        int32_t stablePeriodMs = 0; // Current, including backoff
+    };
+
+    static constexpr size_t kMaxDecisions = 64;
+    static constexpr int32_t kMaxBackoff = 16;
+
+    BufferTuner() = default;
+
+    /**
+     * Destructor, stops the tuner thread
+     */
+    ~BufferTuner() noexcept;
+
+    // Disable copy and assignment
+    BufferTuner(const BufferTuner&) = delete;
+    BufferTuner& operator=(const BufferTuner&) = delete;
+
+    /**
+     * Set the policy, applied on the next start()
+     */
+    void setOptions(const Options& options);
+    Options getOptions() const;
+
+    /**
+     * Start tuning an opened stream, clears the trace and counters
+     * @param sink Opened stream, must stay open until stop()
+     * @return Returns false if tuning is disabled or the stream reports no burst size
+     */
+    bool start(AudioSink* sink);
+
+    /**
+     * Stop the tuner thread (blocking), the stream keeps its current size
+     */
+    void stop();
+
+    /**
+     * Get the recent decisions of this (or the last) stream, oldest first
+     */
+    std::vector<Decision> getTrace() const;
+
+    Stats getStats() const;
+
+private:
+    void tunerLoop();
+    void update(uint64_t nowNs);
+    void apply(int32_t targetFrames, Reason reason, uint64_t nowNs);
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool running_ = false;
+    Options options_;
+
+    // Tuner thread only while running
+    AudioSink* sink_ = nullptr;
+    Options active_;
+    int32_t burst_ = 0;
+    int32_t lastXruns_ = 0;
+    uint64_t startNs_ = 0;
+    uint64_t quietSinceNs_ = 0; // Last underrun or size change
+    uint64_t lastShrinkNs_ = 0;
+    int32_t backoff_ = 1;
+
+    // Guarded by mutex_
+    std::deque<Decision> trace_;
+    Stats stats_;
+};
+
+#endif // BUFFER_TUNER_H
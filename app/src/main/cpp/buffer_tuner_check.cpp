@@ -0,0 +1,296 @@
+// Host check of BufferTuner against SimulatedSink with injected scheduling jitter: underruns grow the buffer one
+// burst per poll, the size stays between floor and ceiling, a shrink that underruns again doubles the stable period
+// up to kMaxBackoff times, and the trace holds every decision as one unbroken chain of sizes. The device runs unpaced:
+// a burst underruns when its injected delay exceeds the buffer, whatever else the host is doing, and a size the jitter
+// can exceed underruns within microseconds. The tuner polls on the wall clock, so every case runs until it saw what it
+// waits for or its time is up.
+#include "buffer_tuner.h"
+#include "simulated_sink.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("buffer_tuner_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// 2 ms bursts, the sink opens low latency at 2 bursts
+constexpr int32_t kBurstFrames = 96;
+constexpr int32_t kBurstUs = 2000;
+
+// Share of the bursts that are delayed, a few per millisecond with the device unpaced
+constexpr int32_t kJitterPercent = 1;
+
+AudioSink::CallbackResult silenceCallback(void* /*userData*/, void* audioData, int32_t numFrames) {
+    memset(audioData, 0, static_cast<size_t>(numFrames) * 2 * sizeof(int16_t));
+    return AudioSink::CallbackResult::Continue;
+}
+
+/**
+ * Device and tuner policy of one case
+ */
+struct TunerCase {
+    const char* name;
+    int32_t jitterMaxUs;
+    BufferTuner::Options tuning;
+};
+
+/**
+ * What the tuner did during one case
+ */
+struct TunerRun {
+    std::vector<BufferTuner::Decision> trace;
+    BufferTuner::Stats stats;
+    std::vector<int32_t> stablePeriodsMs; // Every distinct stable period seen, in order
+    int32_t initialFrames = 0;
+    int32_t finalFrames = 0;
+    int32_t xruns = 0;
+};
+
+/**
+ * Run the tuner on a jittery device until done(tuner, stats) holds or the time is up, polling its stats every
+ * millisecond
+ */
+template <typename Done>
+bool runTuner(const TunerCase& tunerCase, int32_t maxMs, Done done, TunerRun* run) {
+    SimulatedSink::Options device;
+    device.framesPerBurst = kBurstFrames;
+    device.bufferCapacityBursts = 16;
+    device.realtime = false;
+    device.jitterMaxUs = tunerCase.jitterMaxUs;
+    device.jitterPercent = kJitterPercent;
+    SimulatedSink sink(device);
+    if (!expect(sink.open(AudioSinkConfig(), silenceCallback, nullptr, nullptr) && sink.start(), tunerCase.name,
+                "cannot start the device")) {
+        return false;
+    }
+    run->initialFrames = sink.getBufferSizeInFrames();
+
+    BufferTuner tuner;
+    tuner.setOptions(tunerCase.tuning);
+    if (!expect(tuner.start(&sink), tunerCase.name, "tuner did not start")) {
+        return false;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxMs);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        run->stats = tuner.getStats();
+        if (run->stablePeriodsMs.empty() || run->stablePeriodsMs.back() != run->stats.stablePeriodMs) {
+            run->stablePeriodsMs.push_back(run->stats.stablePeriodMs);
+        }
+        if (done(tuner, run->stats)) {
+            break;
+        }
+    }
+    tuner.stop();
+    run->trace = tuner.getTrace();
+    run->stats = tuner.getStats();
+    run->finalFrames = sink.getBufferSizeInFrames();
+    run->xruns = sink.getXRunCount();
+    sink.stop();
+    sink.close();
+    return true;
+}
+
+/**
+ * Invariants of every run: decisions stay within floor and ceiling, each starts where the previous one ended and the
+ * last one is the stream's size, grows are one burst after new underruns, shrinks one burst, and none is missing
+ */
+bool checkTrace(const char* name, const TunerRun& run) {
+    const BufferTuner::Stats& stats = run.stats;
+    const uint64_t decisions = stats.grows + stats.shrinks;
+    char what[128];
+    snprintf(what, sizeof(what), "trace holds %zu decisions, counters %llu", run.trace.size(),
+             static_cast<unsigned long long>(decisions));
+    const uint64_t kept = std::min(decisions, static_cast<uint64_t>(BufferTuner::kMaxDecisions));
+    if (!expect(run.trace.size() == kept, name, what)) {
+        return false;
+    }
+
+    bool chained = true;
+    bool bounded = true;
+    bool stepped = true;
+    bool afterUnderrun = true;
+    int32_t size = run.trace.size() < decisions ? run.trace.front().fromFrames : run.initialFrames;
+    int32_t xruns = 0;
+    for (const BufferTuner::Decision& decision : run.trace) {
+        chained = chained && decision.fromFrames == size;
+        bounded = bounded && decision.toFrames >= stats.minFrames && decision.toFrames <= stats.maxFrames;
+        if (decision.reason == BufferTuner::Reason::Underrun) {
+            stepped = stepped && decision.toFrames == std::min(decision.fromFrames + kBurstFrames, stats.maxFrames);
+            // Only a poll that saw new underruns grows
+            afterUnderrun = afterUnderrun && decision.xrunCount > xruns;
+        } else {
+            stepped = stepped && decision.toFrames == decision.fromFrames - kBurstFrames;
+            afterUnderrun = afterUnderrun && decision.xrunCount >= xruns;
+        }
+        xruns = decision.xrunCount;
+        size = decision.toFrames;
+    }
+    snprintf(what, sizeof(what), "trace ends at %d frames, stream has %d", size, run.finalFrames);
+    return expect(chained, name, "a decision does not start where the previous one ended") &&
+           expect(size == run.finalFrames && stats.bufferSizeInFrames == run.finalFrames, name, what) &&
+           expect(bounded, name, "a decision left the floor..ceiling range") &&
+           expect(stepped, name, "a decision changed the size by more than one burst") &&
+           expect(afterUnderrun, name, "a grow without new underruns");
+}
+
+void printRun(const char* name, const TunerRun& run) {
+    printf("%s: %d underruns, %llu grows, %llu shrinks, %d -> %d frames, stable period %d ms: ok\n", name, run.xruns,
+           static_cast<unsigned long long>(run.stats.grows), static_cast<unsigned long long>(run.stats.shrinks),
+           run.initialFrames, run.finalFrames, run.stats.stablePeriodMs);
+}
+
+// Up to 5 ms of jitter underruns the 4 ms opening size, the buffer grows until it covers the jitter and stays there
+void checkGrowth() {
+    TunerCase tunerCase{"growth", 5000, {}};
+    tunerCase.tuning.pollIntervalMs = 2;
+    tunerCase.tuning.stablePeriodMs = 60000;
+    tunerCase.tuning.maxBursts = 8;
+    const int32_t coveringFrames = (tunerCase.jitterMaxUs / kBurstUs + 1) * kBurstFrames;
+    TunerRun run;
+    // Run on for a while once covered, no underrun should come
+    int32_t coveredPolls = 0;
+    auto done = [&](const BufferTuner&, const BufferTuner::Stats& stats) {
+        coveredPolls += stats.bufferSizeInFrames >= coveringFrames;
+        return coveredPolls >= 100;
+    };
+    if (!runTuner(tunerCase, 5000, done, &run) || !checkTrace(tunerCase.name, run)) {
+        return;
+    }
+    if (expect(run.finalFrames >= coveringFrames && run.stats.grows >= 1, tunerCase.name,
+               "underruns did not grow the buffer to cover the jitter") &&
+        expect(run.stats.shrinks == 0, tunerCase.name, "shrank before a stable period")) {
+        printRun(tunerCase.name, run);
+    }
+}
+
+// Jitter of up to 20 ms underruns any allowed size, the buffer stops at the ceiling while underruns go on
+void checkCeiling() {
+    TunerCase tunerCase{"ceiling", 20000, {}};
+    tunerCase.tuning.pollIntervalMs = 2;
+    tunerCase.tuning.stablePeriodMs = 60000;
+    tunerCase.tuning.maxBursts = 3;
+    TunerRun run;
+    int32_t xrunsAtCeiling = -1;
+    auto done = [&](const BufferTuner&, const BufferTuner::Stats& stats) {
+        if (stats.bufferSizeInFrames == 3 * kBurstFrames && xrunsAtCeiling < 0) {
+            xrunsAtCeiling = stats.xrunCount;
+        }
+        return xrunsAtCeiling >= 0 && stats.xrunCount >= xrunsAtCeiling + 100;
+    };
+    if (!runTuner(tunerCase, 5000, done, &run) || !checkTrace(tunerCase.name, run)) {
+        return;
+    }
+    if (expect(run.stats.maxFrames == 3 * kBurstFrames && run.finalFrames == run.stats.maxFrames, tunerCase.name,
+               "buffer did not stop at the ceiling") &&
+        expect(run.stats.grows == 1 && run.xruns >= xrunsAtCeiling + 100, tunerCase.name,
+               "grew past the ceiling")) {
+        printRun(tunerCase.name, run);
+    }
+}
+
+// Up to 5 ms of jitter: 3 bursts hold, every shrink to 2 underruns again at once. The stable period doubles on each
+// of them, up to kMaxBackoff times the configured one and never further
+void checkBackoff() {
+    TunerCase tunerCase{"backoff", 5000, {}};
+    tunerCase.tuning.pollIntervalMs = 1;
+    tunerCase.tuning.stablePeriodMs = 20;
+    tunerCase.tuning.minBursts = 1;
+    tunerCase.tuning.maxBursts = 6;
+    const int32_t maxPeriodMs = tunerCase.tuning.stablePeriodMs * BufferTuner::kMaxBackoff;
+    TunerRun run;
+    // Once the period is at its cap, run on until a shrink underran within the configured period again: that would
+    // have doubled it once more
+    const uint64_t stablePeriodNs = tunerCase.tuning.stablePeriodMs * UINT64_C(1000000);
+    uint64_t decisionsAtCap = UINT64_MAX;
+    int32_t backoffsAtCap = 0;
+    auto done = [&](const BufferTuner& tuner, const BufferTuner::Stats& stats) {
+        if (stats.stablePeriodMs < maxPeriodMs) {
+            return false;
+        }
+        const uint64_t decisions = stats.grows + stats.shrinks;
+        decisionsAtCap = std::min(decisionsAtCap, decisions);
+        // Absolute decision numbers of the trace run up to the counters, the trace only holds the latest ones
+        const std::vector<BufferTuner::Decision> trace = tuner.getTrace();
+        const uint64_t first = tuner.getStats().grows + tuner.getStats().shrinks - trace.size();
+        backoffsAtCap = 0;
+        for (size_t i = 1; i < trace.size(); i++) {
+            backoffsAtCap += first + i - 1 >= decisionsAtCap && trace[i - 1].reason == BufferTuner::Reason::Stable &&
+                             trace[i].reason == BufferTuner::Reason::Underrun &&
+                             trace[i].timeNs - trace[i - 1].timeNs < stablePeriodNs;
+        }
+        return backoffsAtCap > 0;
+    };
+    if (!runTuner(tunerCase, 10000, done, &run) || !checkTrace(tunerCase.name, run)) {
+        return;
+    }
+    bool doubled = true;
+    for (size_t i = 1; i < run.stablePeriodsMs.size(); i++) {
+        doubled = doubled && run.stablePeriodsMs[i] == 2 * run.stablePeriodsMs[i - 1];
+    }
+    char what[128];
+    snprintf(what, sizeof(what), "stable period went %d", run.stablePeriodsMs.front());
+    for (size_t i = 1; i < run.stablePeriodsMs.size() && i < 8; i++) {
+        snprintf(what + strlen(what), sizeof(what) - strlen(what), " -> %d", run.stablePeriodsMs[i]);
+    }
+    if (expect(run.stablePeriodsMs.front() == tunerCase.tuning.stablePeriodMs && doubled, tunerCase.name, what) &&
+        expect(run.stablePeriodsMs.back() == maxPeriodMs, tunerCase.name, what) &&
+        expect(backoffsAtCap > 0, tunerCase.name, "no underrun right after a shrink at the cap")) {
+        printRun(tunerCase.name, run);
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -v            Keep the tuner's decision log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // The tuner logs every decision
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    checkGrowth();
+    checkCeiling();
+    checkBackoff();
+
+    if (failures > 0) {
+        printf("buffer_tuner_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
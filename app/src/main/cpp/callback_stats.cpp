@@ -0,0 +1,132 @@
+#include "callback_stats.h"
+#include <algorithm>
+#include <chrono>
+
+void LogLinearHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+int LogLinearHistogram::bucketIndex(uint64_t value) {
+    // Values below kSubBuckets get one bucket each
+    if (value < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(value);
+    }
+
+    // Octave from the highest set bit, linear position from the next kSubBucketBits bits
+    int msb = 63 - __builtin_clzll(value);
+    int octave = msb - kSubBucketBits + 1;
+    int subBucket = static_cast<int>((value >> (msb - kSubBucketBits)) & (kSubBuckets - 1));
+    return octave * kSubBuckets + subBucket;
+}
+
+uint64_t LogLinearHistogram::bucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+
+    int octave = index / kSubBuckets;
+    int subBucket = index % kSubBuckets;
+    int shift = octave - 1;
+    uint64_t lower = (static_cast<uint64_t>(kSubBuckets + subBucket)) << shift;
+    return lower + ((1ULL << shift) - 1);
+}
+
+uint64_t LogLinearHistogram::getPercentile(double fraction) const {
+    uint64_t total = count_.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return 0;
+    }
+
+    fraction = std::min(std::max(fraction, 0.0), 1.0);
+    auto target = static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5);
+    target = std::max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            // Never report more than the exact maximum
+            return std::min(bucketUpperBound(i), max_.load(std::memory_order_relaxed));
+        }
+    }
+    return max_.load(std::memory_order_relaxed);
+}
+
+LogLinearHistogram::Summary LogLinearHistogram::getSummary() const {
+    Summary summary;
+    summary.count = count_.load(std::memory_order_relaxed);
+    summary.p50 = getPercentile(0.50);
+    summary.p99 = getPercentile(0.99);
+    summary.p999 = getPercentile(0.999);
+    summary.max = max_.load(std::memory_order_relaxed);
+    return summary;
+}
+
+void CallbackStats::reset(int32_t sampleRate, int32_t initialXRunCount) {
+    duration_.reset();
+    intervalJitter_.reset();
+    framesRequested_.reset();
+    xrunDelta_.reset();
+
+    sampleRate_ = sampleRate > 0 ? sampleRate : 48000;
+    lastBeginNs_ = 0;
+    lastXRunCount_ = initialXRunCount;
+    callbackCount_.store(0, std::memory_order_relaxed);
+    deadlineMisses_.store(0, std::memory_order_relaxed);
+    xruns_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t CallbackStats::begin(int32_t numFrames) {
+    uint64_t now = nowNs();
+
+    // Jitter is the distance between the actual wake-up interval and the burst duration
+    if (lastBeginNs_ != 0) {
+        uint64_t interval = now - lastBeginNs_;
+        uint64_t expected = static_cast<uint64_t>(numFrames) * 1000000000ULL / static_cast<uint64_t>(sampleRate_);
+        intervalJitter_.record(interval > expected ? interval - expected : expected - interval);
+    }
+    lastBeginNs_ = now;
+    return now;
+}
+
+void CallbackStats::end(uint64_t beginNs, int32_t numFrames, int32_t xrunCount) {
+    uint64_t duration = nowNs() - beginNs;
+    uint64_t deadline = static_cast<uint64_t>(numFrames) * 1000000000ULL / static_cast<uint64_t>(sampleRate_);
+
+    duration_.record(duration);
+    framesRequested_.record(static_cast<uint64_t>(std::max(numFrames, 0)));
+    if (duration > deadline) {
+        deadlineMisses_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    int32_t delta = xrunCount > lastXRunCount_ ? xrunCount - lastXRunCount_ : 0;
+    lastXRunCount_ = xrunCount;
+    xrunDelta_.record(static_cast<uint64_t>(delta));
+    if (delta > 0) {
+        xruns_.fetch_add(static_cast<uint64_t>(delta), std::memory_order_relaxed);
+    }
+
+    callbackCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
+CallbackStats::Snapshot CallbackStats::getSnapshot() const {
+    Snapshot snapshot;
+    snapshot.callbackCount = callbackCount_.load(std::memory_order_relaxed);
+    snapshot.deadlineMisses = deadlineMisses_.load(std::memory_order_relaxed);
+    snapshot.xruns = xruns_.load(std::memory_order_relaxed);
+    snapshot.durationNs = duration_.getSummary();
+    snapshot.intervalJitterNs = intervalJitter_.getSummary();
+    snapshot.framesRequested = framesRequested_.getSummary();
+    snapshot.xrunDelta = xrunDelta_.getSummary();
+    return snapshot;
+}
+
+uint64_t CallbackStats::nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
@@ -0,0 +1,135 @@
+#ifndef CALLBACK_STATS_H
+#define CALLBACK_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Lock-free log-linear histogram
+ *
+ * Each power-of-two range is split into kSubBuckets linear buckets, so the
+ * relative error of any reported value is below 1/kSubBuckets over the whole
+ * 64-bit range. Storage is fixed: recording never allocates, and snapshots
+ * can be taken from another thread while values are being recorded.
+ */
+class LogLinearHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t p50 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+        uint64_t max = 0;
+    };
+
+    LogLinearHistogram() { reset(); }
+
+    // Disable copy and assignment
+    LogLinearHistogram(const LogLinearHistogram&) = delete;
+    LogLinearHistogram& operator=(const LogLinearHistogram&) = delete;
+
+    /**
+     * Record one value (real-time safe, single writer)
+     */
+    void record(uint64_t value) {
+        buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Clear all buckets, only while nobody is recording
+     */
+    void reset();
+
+    /**
+     * Get a value at or above the given fraction of all recorded values
+     * @param fraction Quantile in [0, 1]
+     * @return Upper bound of the bucket holding the quantile, 0 when empty
+     */
+    uint64_t getPercentile(double fraction) const;
+
+    Summary getSummary() const;
+
+private:
+    static int bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(int index);
+
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> max_{0};
+};
+
+/**
+ * Audio callback instrumentation
+ *
+ * Records callback duration, wake-up interval jitter, frames requested and
+ * the sink's underrun delta for every callback, plus a deadline-miss count
+ * (callbacks that took longer than the audio they produced). Everything is
+ * fixed-size and lock-free, so it can stay enabled on the audio thread.
+ */
+class CallbackStats {
+public:
+    struct Snapshot {
+        uint64_t callbackCount = 0;
+        uint64_t deadlineMisses = 0;
+        uint64_t xruns = 0;
+        LogLinearHistogram::Summary durationNs;
+        LogLinearHistogram::Summary intervalJitterNs;
+        LogLinearHistogram::Summary framesRequested;
+        LogLinearHistogram::Summary xrunDelta;
+    };
+
+    CallbackStats() = default;
+
+    // Disable copy and assignment
+    CallbackStats(const CallbackStats&) = delete;
+    CallbackStats& operator=(const CallbackStats&) = delete;
+
+    /**
+     * Reset before a new stream starts
+     * @param sampleRate Stream sample rate, used to turn frames into deadlines
+     * @param initialXRunCount Sink xrun count at stream start
+     */
+    void reset(int32_t sampleRate, int32_t initialXRunCount);
+
+    /**
+     * Mark callback entry
+     * @return Timestamp to pass to end()
+     */
+    uint64_t begin(int32_t numFrames);
+
+    /**
+     * Mark callback exit
+     * @param beginNs Value returned by begin()
+     * @param numFrames Frames requested by this callback
+     * @param xrunCount Current sink xrun count
+     */
+    void end(uint64_t beginNs, int32_t numFrames, int32_t xrunCount);
+
+    Snapshot getSnapshot() const;
+
+    static uint64_t nowNs();
+
+private:
+    LogLinearHistogram duration_;
+    LogLinearHistogram intervalJitter_;
+    LogLinearHistogram framesRequested_;
+    LogLinearHistogram xrunDelta_;
+
+    int32_t sampleRate_ = 48000;
+    uint64_t lastBeginNs_ = 0;
+    int32_t lastXRunCount_ = 0;
+    std::atomic<uint64_t> callbackCount_{0};
+    std::atomic<uint64_t> deadlineMisses_{0};
+    std::atomic<uint64_t> xruns_{0};
+};
+
+#endif // CALLBACK_STATS_H
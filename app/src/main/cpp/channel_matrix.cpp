@@ -0,0 +1,396 @@
+#include "channel_matrix.h"
+#include "audio_log.h"
+#include "format_converter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define MATRIX_HAS_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MATRIX_HAS_SSE2 1
+#endif
+
+namespace {
+
+// WAVE_FORMAT_EXTENSIBLE speaker order
+constexpr int32_t kFrontLeft = 0;
+constexpr int32_t kFrontRight = 1;
+constexpr int32_t kFrontCenter = 2;
+constexpr int32_t kBackLeft = 4;
+constexpr int32_t kBackRight = 5;
+constexpr int32_t kSideLeft = 6;
+constexpr int32_t kSideRight = 7;
+
+constexpr float kMinus3dB = 0.70710678f;
+
+/**
+ * ITU-R BS.775 style stereo fold-down rows (left row, then right row)
+ */
+std::vector<float> makeStereoDownmix(int32_t inputChannels) {
+    std::vector<float> matrix(static_cast<size_t>(2) * inputChannels, 0.0f);
+    float* left = matrix.data();
+    float* right = matrix.data() + inputChannels;
+
+    if (inputChannels == 1) {
+        left[0] = 1.0f;
+        right[0] = 1.0f;
+        return matrix;
+    }
+
+    left[kFrontLeft] = 1.0f;
+    right[kFrontRight] = 1.0f;
+    switch (inputChannels) {
+    case 3: // L R C
+        left[kFrontCenter] = kMinus3dB;
+        right[kFrontCenter] = kMinus3dB;
+        break;
+    case 4: // L R Ls Rs
+        left[2] = kMinus3dB;
+        right[3] = kMinus3dB;
+        break;
+    case 6: // 5.1, LFE dropped
+    case 8: // 7.1, LFE dropped
+        left[kFrontCenter] = kMinus3dB;
+        right[kFrontCenter] = kMinus3dB;
+        left[kBackLeft] = kMinus3dB;
+        right[kBackRight] = kMinus3dB;
+        if (inputChannels == 8) {
+            left[kSideLeft] = kMinus3dB;
+            right[kSideRight] = kMinus3dB;
+        }
+        break;
+    default: // Unknown layout, keep the front pair
+        break;
+    }
+    return matrix;
+}
+
+std::vector<float> makePreset(int32_t inputChannels, int32_t outputChannels) {
+    std::vector<float> matrix(static_cast<size_t>(outputChannels) * inputChannels, 0.0f);
+
+    if (outputChannels == 2) {
+        return makeStereoDownmix(inputChannels);
+    }
+
+    if (outputChannels == 1) {
+        if (inputChannels == 4 || inputChannels == 6 || inputChannels == 8) {
+            // Average of the stereo fold-down keeps the centre and surround weighting
+            std::vector<float> stereo = makeStereoDownmix(inputChannels);
+            for (int32_t i = 0; i < inputChannels; i++) {
+                matrix[i] = 0.5f * (stereo[i] + stereo[inputChannels + i]);
+            }
+        } else {
+            std::fill(matrix.begin(), matrix.end(), 1.0f / static_cast<float>(inputChannels));
+        }
+        return matrix;
+    }
+
+    if (inputChannels == 1) {
+        // Mono feeds the front pair of a wider layout
+        matrix[kFrontLeft] = 1.0f;
+        matrix[kFrontRight] = 1.0f;
+        return matrix;
+    }
+
+    // Same or unrelated layouts: one to one, extra inputs dropped, extra outputs silent
+    for (int32_t channel = 0; channel < std::min(inputChannels, outputChannels); channel++) {
+        matrix[static_cast<size_t>(channel) * inputChannels + channel] = 1.0f;
+    }
+    return matrix;
+}
+
+void identityKernel(const float*, int32_t inputChannels, int32_t, const float* input, float* output,
+                    int32_t numFrames) {
+    memcpy(output, input, static_cast<size_t>(numFrames) * inputChannels * sizeof(float));
+}
+
+void genericKernel(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                   float* output, int32_t numFrames) {
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        for (int32_t out = 0; out < outputChannels; out++) {
+            const float* row = matrix + out * inputChannels;
+            float sum = 0.0f;
+            for (int32_t in = 0; in < inputChannels; in++) {
+                sum += row[in] * input[in];
+            }
+            output[out] = sum;
+        }
+        input += inputChannels;
+        output += outputChannels;
+    }
+}
+
+/**
+ * Fixed-shape kernel, fully unrolled so the compiler keeps the matrix in registers
+ */
+template <int32_t In, int32_t Out>
+void fixedKernel(const float* matrix, int32_t, int32_t, const float* input, float* output, int32_t numFrames) {
+    float m[Out * In];
+    memcpy(m, matrix, sizeof(m));
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        for (int32_t out = 0; out < Out; out++) {
+            float sum = 0.0f;
+            for (int32_t in = 0; in < In; in++) {
+                sum += m[out * In + in] * input[in];
+            }
+            output[out] = sum;
+        }
+        input += In;
+        output += Out;
+    }
+}
+
+void monoToStereoScalar(const float* matrix, int32_t, int32_t, const float* input, float* output,
+                        int32_t numFrames) {
+    for (int32_t i = 0; i < numFrames; i++) {
+        output[2 * i] = input[i] * matrix[0];
+        output[2 * i + 1] = input[i] * matrix[1];
+    }
+}
+
+void stereoToMonoScalar(const float* matrix, int32_t, int32_t, const float* input, float* output,
+                        int32_t numFrames) {
+    for (int32_t i = 0; i < numFrames; i++) {
+        output[i] = input[2 * i] * matrix[0] + input[2 * i + 1] * matrix[1];
+    }
+}
+
+void stereoToStereoScalar(const float* matrix, int32_t, int32_t, const float* input, float* output,
+                          int32_t numFrames) {
+    for (int32_t i = 0; i < numFrames; i++) {
+        float left = input[2 * i];
+        float right = input[2 * i + 1];
+        output[2 * i] = left * matrix[0] + right * matrix[1];
+        output[2 * i + 1] = left * matrix[2] + right * matrix[3];
+    }
+}
+
+#if MATRIX_HAS_SSE2
+void monoToStereoSse2(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                      float* output, int32_t numFrames) {
+    const __m128 leftGain = _mm_set1_ps(matrix[0]);
+    const __m128 rightGain = _mm_set1_ps(matrix[1]);
+    int32_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 mono = _mm_loadu_ps(input + i);
+        __m128 left = _mm_mul_ps(mono, leftGain);
+        __m128 right = _mm_mul_ps(mono, rightGain);
+        _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(left, right));
+        _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(left, right));
+    }
+    monoToStereoScalar(matrix, inputChannels, outputChannels, input + i, output + 2 * i, numFrames - i);
+}
+
+void stereoToMonoSse2(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                      float* output, int32_t numFrames) {
+    const __m128 leftGain = _mm_set1_ps(matrix[0]);
+    const __m128 rightGain = _mm_set1_ps(matrix[1]);
+    int32_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        __m128 a = _mm_loadu_ps(input + 2 * i);
+        __m128 b = _mm_loadu_ps(input + 2 * i + 4);
+        __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(left, leftGain), _mm_mul_ps(right, rightGain)));
+    }
+    stereoToMonoScalar(matrix, inputChannels, outputChannels, input + 2 * i, output + i, numFrames - i);
+}
+
+void stereoToStereoSse2(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                        float* output, int32_t numFrames) {
+    // [L R L R] * [m00 m11 ..] + [R L R L] * [m01 m10 ..]
+    const __m128 direct = _mm_setr_ps(matrix[0], matrix[3], matrix[0], matrix[3]);
+    const __m128 cross = _mm_setr_ps(matrix[1], matrix[2], matrix[1], matrix[2]);
+    int32_t i = 0;
+    for (; i + 2 <= numFrames; i += 2) {
+        __m128 frames = _mm_loadu_ps(input + 2 * i);
+        __m128 swapped = _mm_shuffle_ps(frames, frames, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_ps(output + 2 * i, _mm_add_ps(_mm_mul_ps(frames, direct), _mm_mul_ps(swapped, cross)));
+    }
+    stereoToStereoScalar(matrix, inputChannels, outputChannels, input + 2 * i, output + 2 * i, numFrames - i);
+}
+#endif
+
+#if MATRIX_HAS_NEON
+void monoToStereoNeon(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                      float* output, int32_t numFrames) {
+    int32_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        float32x4_t mono = vld1q_f32(input + i);
+        float32x4x2_t stereo;
+        stereo.val[0] = vmulq_n_f32(mono, matrix[0]);
+        stereo.val[1] = vmulq_n_f32(mono, matrix[1]);
+        vst2q_f32(output + 2 * i, stereo);
+    }
+    monoToStereoScalar(matrix, inputChannels, outputChannels, input + i, output + 2 * i, numFrames - i);
+}
+
+void stereoToMonoNeon(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                      float* output, int32_t numFrames) {
+    int32_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        float32x4x2_t stereo = vld2q_f32(input + 2 * i);
+        vst1q_f32(output + i, vmlaq_n_f32(vmulq_n_f32(stereo.val[0], matrix[0]), stereo.val[1], matrix[1]));
+    }
+    stereoToMonoScalar(matrix, inputChannels, outputChannels, input + 2 * i, output + i, numFrames - i);
+}
+
+void stereoToStereoNeon(const float* matrix, int32_t inputChannels, int32_t outputChannels, const float* input,
+                        float* output, int32_t numFrames) {
+    int32_t i = 0;
+    for (; i + 4 <= numFrames; i += 4) {
+        float32x4x2_t in = vld2q_f32(input + 2 * i);
+        float32x4x2_t out;
+        out.val[0] = vmlaq_n_f32(vmulq_n_f32(in.val[0], matrix[0]), in.val[1], matrix[1]);
+        out.val[1] = vmlaq_n_f32(vmulq_n_f32(in.val[0], matrix[2]), in.val[1], matrix[3]);
+        vst2q_f32(output + 2 * i, out);
+    }
+    stereoToStereoScalar(matrix, inputChannels, outputChannels, input + 2 * i, output + 2 * i, numFrames - i);
+}
+#endif
+
+} // namespace
+
+bool ChannelMatrix::configure(int32_t inputChannels, int32_t outputChannels, bool normalize) {
+    if (inputChannels <= 0 || inputChannels > kMaxChannels || outputChannels <= 0 ||
+        outputChannels > kMaxChannels) {
+        LOGE("Unsupported channel mapping %d -> %d", inputChannels, outputChannels);
+        return false;
+    }
+
+    std::vector<float> matrix = makePreset(inputChannels, outputChannels);
+    if (normalize) {
+        // One scale for all rows keeps the balance between outputs
+        float largestRowSum = 0.0f;
+        for (int32_t out = 0; out < outputChannels; out++) {
+            float rowSum = 0.0f;
+            for (int32_t in = 0; in < inputChannels; in++) {
+                rowSum += std::fabs(matrix[static_cast<size_t>(out) * inputChannels + in]);
+            }
+            largestRowSum = std::max(largestRowSum, rowSum);
+        }
+        if (largestRowSum > 1.0f) {
+            for (auto& gain : matrix) {
+                gain /= largestRowSum;
+            }
+        }
+    }
+    return apply(inputChannels, outputChannels, matrix);
+}
+
+bool ChannelMatrix::configure(int32_t inputChannels, int32_t outputChannels, const std::vector<float>& matrix) {
+    if (inputChannels <= 0 || inputChannels > kMaxChannels || outputChannels <= 0 ||
+        outputChannels > kMaxChannels) {
+        LOGE("Unsupported channel mapping %d -> %d", inputChannels, outputChannels);
+        return false;
+    }
+    if (matrix.size() != static_cast<size_t>(inputChannels) * outputChannels) {
+        LOGE("Channel matrix has %zu gains, expected %d x %d", matrix.size(), outputChannels, inputChannels);
+        return false;
+    }
+    return apply(inputChannels, outputChannels, matrix);
+}
+
+bool ChannelMatrix::apply(int32_t inputChannels, int32_t outputChannels, const std::vector<float>& matrix) {
+    inputChannels_ = inputChannels;
+    outputChannels_ = outputChannels;
+    std::fill(std::begin(matrix_), std::end(matrix_), 0.0f);
+    std::copy(matrix.begin(), matrix.end(), matrix_);
+
+    identity_ = inputChannels == outputChannels;
+    for (int32_t out = 0; identity_ && out < outputChannels; out++) {
+        for (int32_t in = 0; in < inputChannels; in++) {
+            if (matrix_[out * inputChannels + in] != (in == out ? 1.0f : 0.0f)) {
+                identity_ = false;
+                break;
+            }
+        }
+    }
+
+    kernel_ = identity_ ? identityKernel : selectKernel(inputChannels, outputChannels);
+    LOGI("Channel matrix %d -> %d%s", inputChannels, outputChannels, identity_ ? " (identity)" : "");
+    return true;
+}
+
+ChannelMatrix::Kernel ChannelMatrix::selectKernel(int32_t inputChannels, int32_t outputChannels) {
+    FormatConverter::Isa isa = FormatConverter::getBestIsa();
+    bool simd = isa != FormatConverter::Isa::Scalar;
+
+    if (simd && inputChannels <= 2 && outputChannels <= 2 && inputChannels + outputChannels == 3) {
+#if MATRIX_HAS_NEON
+        return inputChannels == 1 ? monoToStereoNeon : stereoToMonoNeon;
+#elif MATRIX_HAS_SSE2
+        return inputChannels == 1 ? monoToStereoSse2 : stereoToMonoSse2;
+#endif
+    }
+    if (simd && inputChannels == 2 && outputChannels == 2) {
+#if MATRIX_HAS_NEON
+        return stereoToStereoNeon;
+#elif MATRIX_HAS_SSE2
+        return stereoToStereoSse2;
+#endif
+    }
+
+    switch (inputChannels * 100 + outputChannels) {
+    case 102:
+        return monoToStereoScalar;
+    case 201:
+        return stereoToMonoScalar;
+    case 202:
+        return stereoToStereoScalar;
+    case 206:
+        return fixedKernel<2, 6>;
+    case 208:
+        return fixedKernel<2, 8>;
+    case 401:
+        return fixedKernel<4, 1>;
+    case 402:
+        return fixedKernel<4, 2>;
+    case 601:
+        return fixedKernel<6, 1>;
+    case 602:
+        return fixedKernel<6, 2>;
+    case 801:
+        return fixedKernel<8, 1>;
+    case 802:
+        return fixedKernel<8, 2>;
+    default:
+        return genericKernel;
+    }
+}
+
+void ChannelMatrix::process(const float* input, float* output, int32_t numFrames) const {
+    if (numFrames <= 0) {
+        return;
+    }
+    kernel_(matrix_, inputChannels_, outputChannels_, input, output, numFrames);
+}
+
+RemixedSource::RemixedSource(std::unique_ptr<AudioSource> source, int32_t outputChannels, int32_t maxFrames)
+    : source_(std::move(source)), maxFrames_(maxFrames) {
+    if (!source_ || maxFrames <= 0 || !matrix_.configure(source_->getChannelCount(), outputChannels)) {
+        return;
+    }
+    inputBuffer_.reset(new float[static_cast<size_t>(maxFrames) * source_->getChannelCount()]);
+    valid_ = true;
+}
+
+int32_t RemixedSource::read(float* buffer, int32_t numFrames) {
+    int32_t outputChannels = matrix_.getOutputChannels();
+    int32_t framesDone = 0;
+    while (framesDone < numFrames) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, maxFrames_);
+        int32_t framesRead = source_->read(inputBuffer_.get(), chunkFrames);
+        matrix_.process(inputBuffer_.get(), buffer + static_cast<size_t>(framesDone) * outputChannels, framesRead);
+        framesDone += framesRead;
+        if (framesRead < chunkFrames) {
+            break;
+        }
+    }
+    return framesDone;
+}
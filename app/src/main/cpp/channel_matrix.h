@@ -0,0 +1,103 @@
+#ifndef CHANNEL_MATRIX_H
+#define CHANNEL_MATRIX_H
+
+#include "audio_source.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Channel mapping / downmix stage for up to kMaxChannels channels
+ *
+ * out[o] = sum over i of matrix[o * inputChannels + i] * in[i], per frame of
+ * interleaved float. Presets cover the usual WAV layouts (mono, stereo, quad,
+ * 5.1, 7.1 in WAVE_FORMAT_EXTENSIBLE order); any other shape takes a user
+ * matrix. Identity, mono<->stereo, stereo->stereo, stereo<->5.1/7.1 and
+ * quad/5.1/7.1->mono/stereo run specialized kernels (hand-written NEON/SSE2
+ * for the mono/stereo shapes, fixed-shape unrolled loops for the rest),
+ * everything else a generic matrix loop.
+ */
+class ChannelMatrix {
+public:
+    static constexpr int32_t kMaxChannels = 16;
+
+    ChannelMatrix() = default;
+
+    // Disable copy and assignment
+    ChannelMatrix(const ChannelMatrix&) = delete;
+    ChannelMatrix& operator=(const ChannelMatrix&) = delete;
+
+    /**
+     * Use the preset for a layout change (not real-time safe)
+     * 5.1/7.1/quad -> stereo follow ITU-R BS.775 (-3 dB centre and surrounds, no LFE),
+     * N -> mono averages, mono -> N feeds the front pair, other shapes map
+     * channels one to one and drop or silence the rest.
+     * @param normalize Scale rows so no output can exceed full scale
+     * @return Returns false if a channel count is out of range
+     */
+    bool configure(int32_t inputChannels, int32_t outputChannels, bool normalize = true);
+
+    /**
+     * Use a user matrix (not real-time safe)
+     * @param matrix outputChannels rows of inputChannels gains, row-major
+     * @return Returns false if a channel count is out of range or the matrix has the wrong size
+     */
+    bool configure(int32_t inputChannels, int32_t outputChannels, const std::vector<float>& matrix);
+
+    /**
+     * Remix frames (real-time safe)
+     * @param input numFrames frames of inputChannels interleaved float
+     * @param output numFrames frames of outputChannels interleaved float, must not alias input
+     */
+    void process(const float* input, float* output, int32_t numFrames) const;
+
+    int32_t getInputChannels() const { return inputChannels_; }
+    int32_t getOutputChannels() const { return outputChannels_; }
+
+    /**
+     * True when the matrix is a plain copy
+     */
+    bool isIdentity() const { return identity_; }
+
+private:
+    using Kernel = void (*)(const float* matrix, int32_t inputChannels, int32_t outputChannels,
+                            const float* input, float* output, int32_t numFrames);
+
+    bool apply(int32_t inputChannels, int32_t outputChannels, const std::vector<float>& matrix);
+    static Kernel selectKernel(int32_t inputChannels, int32_t outputChannels);
+
+    int32_t inputChannels_ = 0;
+    int32_t outputChannels_ = 0;
+    float matrix_[kMaxChannels * kMaxChannels] = {};
+    Kernel kernel_ = nullptr;
+    bool identity_ = false;
+};
+
+/**
+ * AudioSource adapter that remixes another source to a channel count
+ */
+class RemixedSource : public AudioSource {
+public:
+    /**
+     * @param source Input source, owned
+     * @param outputChannels Channel count to produce, using the preset matrix
+     * @param maxFrames Largest read, sizes the input buffer
+     */
+    RemixedSource(std::unique_ptr<AudioSource> source, int32_t outputChannels, int32_t maxFrames);
+
+    bool isValid() const { return valid_; }
+
+    int32_t getSampleRate() const override { return source_->getSampleRate(); }
+    int32_t getChannelCount() const override { return matrix_.getOutputChannels(); }
+    int32_t read(float* buffer, int32_t numFrames) override;
+    bool isFinished() const override { return source_->isFinished(); }
+
+private:
+    std::unique_ptr<AudioSource> source_;
+    ChannelMatrix matrix_;
+    std::unique_ptr<float[]> inputBuffer_;
+    int32_t maxFrames_;
+    bool valid_ = false;
+};
+
+#endif // CHANNEL_MATRIX_H
@@ -0,0 +1,232 @@
+#include "clip_cache.h"
+#include "audio_log.h"
+#include "audio_file.h"
+#include <algorithm>
+#include <cstring>
+
+// std::min takes kChunkFrames by reference
+constexpr int32_t ClipSource::kChunkFrames;
+
+namespace {
+
+// Frames read and converted per pass while loading
+constexpr int32_t kLoadChunkFrames = 4096;
+
+void updateMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+void ClipCache::setLimits(size_t budgetBytes, size_t maxClipBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budgetBytes_ = budgetBytes;
+    maxClipBytes_ = std::min(maxClipBytes, budgetBytes);
+    evictTo(budgetBytes_);
+    LOGI("Clip cache: budget=%zu bytes, max clip=%zu bytes", budgetBytes_, maxClipBytes_);
+}
+
+std::shared_ptr<const ClipCache::Clip> ClipCache::acquire(const std::string& path, bool* hit) {
+    if (hit) {
+        *hit = false;
+    }
+
+    size_t maxClipBytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto found = index_.find(path);
+        if (found != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, found->second);
+            hits_++;
+            if (hit) {
+                *hit = true;
+            }
+            return found->second->clip;
+        }
+        if (maxClipBytes_ == 0) {
+            bypasses_++;
+            return nullptr;
+        }
+        maxClipBytes = maxClipBytes_;
+    }
+
+    // Load without holding the lock, stats and other clips stay available meanwhile
+    std::shared_ptr<Clip> clip = load(path, maxClipBytes);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!clip || clip->size > maxClipBytes_) {
+        bypasses_++;
+        return nullptr;
+    }
+
+    // Another thread may have loaded the same path meanwhile
+    auto found = index_.find(path);
+    if (found != index_.end()) {
+        lru_.splice(lru_.begin(), lru_, found->second);
+        hits_++;
+        return found->second->clip;
+    }
+
+    misses_++;
+    evictTo(budgetBytes_ - clip->size);
+    lru_.push_front({clip});
+    index_[path] = lru_.begin();
+    bytesUsed_ += clip->size;
+    LOGI("Clip cached: %s (%zu bytes, %zu/%zu used)", path.c_str(), clip->size, bytesUsed_, budgetBytes_);
+    return clip;
+}
+
+void ClipCache::invalidate(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(path);
+    if (found == index_.end()) {
+        return;
+    }
+    bytesUsed_ -= found->second->clip->size;
+    lru_.erase(found->second);
+    index_.erase(found);
+}
+
+void ClipCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    bytesUsed_ = 0;
+}
+
+ClipCache::Stats ClipCache::getStats() const {
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.evictions = evictions_;
+        stats.bypasses = bypasses_;
+        stats.bytesUsed = bytesUsed_;
+        stats.budgetBytes = budgetBytes_;
+        stats.clipCount = static_cast<int32_t>(lru_.size());
+    }
+    for (int32_t i = 0; i < 3; i++) {
+        stats.firstFrame[i].count = firstFrame_[i].count.load(std::memory_order_relaxed);
+        stats.firstFrame[i].totalNs = firstFrame_[i].totalNs.load(std::memory_order_relaxed);
+        stats.firstFrame[i].maxNs = firstFrame_[i].maxNs.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+void ClipCache::recordFirstFrame(Path path, uint64_t ns) {
+    FirstFrameCounters& counters = firstFrame_[static_cast<int32_t>(path)];
+    counters.count.fetch_add(1, std::memory_order_relaxed);
+    counters.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    updateMax(counters.maxNs, ns);
+}
+
+std::shared_ptr<ClipCache::Clip> ClipCache::load(const std::string& path, size_t maxClipBytes) {
+    std::unique_ptr<AudioFile> source = openAudioFile(path, AudioFile::IoMode::Stream);
+    if (!source) {
+        return nullptr;
+    }
+    AudioFile& file = *source;
+
+    auto clip = std::make_shared<Clip>();
+    clip->path = path;
+    clip->formatInfo = file.getFormatInfo();
+    clip->sampleRate = file.getSampleRate();
+    clip->channelCount = file.getChannelCount();
+    clip->format = FormatConverter::getPreferredDeviceFormat(file.getSampleFormat());
+    clip->bytesPerFrame = clip->channelCount * getBytesPerSample(clip->format);
+
+    int32_t fileBytesPerFrame = file.getBytesPerFrame();
+    uint64_t frames = file.getDataSize() / static_cast<uint64_t>(fileBytesPerFrame);
+    if (frames * static_cast<uint64_t>(clip->bytesPerFrame) > maxClipBytes) {
+        LOGD("Not caching %s: %llu frames exceed the clip limit", path.c_str(),
+             static_cast<unsigned long long>(frames));
+        return nullptr;
+    }
+
+    // Converted once here, so the callback of a cache hit can usually copy straight through
+    FormatConverter converter;
+    if (!converter.configure(file.getSampleFormat(), clip->format, kLoadChunkFrames * clip->channelCount, false)) {
+        return nullptr;
+    }
+    clip->data.reset(new uint8_t[static_cast<size_t>(frames) * clip->bytesPerFrame]);
+    std::unique_ptr<uint8_t[]> chunk(new uint8_t[static_cast<size_t>(kLoadChunkFrames) * fileBytesPerFrame]);
+
+    uint64_t framesLoaded = 0;
+    while (framesLoaded < frames) {
+        auto chunkFrames = static_cast<int32_t>(std::min<uint64_t>(frames - framesLoaded, kLoadChunkFrames));
+        size_t bytesRead = file.readAudioData(chunk.get(), static_cast<size_t>(chunkFrames) * fileBytesPerFrame);
+        auto framesRead = static_cast<int32_t>(bytesRead / fileBytesPerFrame);
+        converter.convert(chunk.get(), clip->data.get() + framesLoaded * clip->bytesPerFrame,
+                          framesRead * clip->channelCount);
+        framesLoaded += framesRead;
+        if (framesRead < chunkFrames) {
+            break; // Truncated data chunk, keep what is there
+        }
+    }
+    clip->size = static_cast<size_t>(framesLoaded) * clip->bytesPerFrame;
+    return clip;
+}
+
+void ClipCache::evictTo(size_t budgetBytes) {
+    // Playing clips stay alive through their shared_ptr, only the cache entry goes
+    while (bytesUsed_ > budgetBytes && !lru_.empty()) {
+        const Entry& oldest = lru_.back();
+        LOGD("Clip evicted: %s", oldest.clip->path.c_str());
+        bytesUsed_ -= oldest.clip->size;
+        index_.erase(oldest.clip->path);
+        lru_.pop_back();
+        evictions_++;
+    }
+}
+
+size_t ClipReader::read(void* buffer, size_t size) {
+    const void* data = nullptr;
+    size_t bytesRead = map(&data, size);
+    if (bytesRead > 0) {
+        memcpy(buffer, data, bytesRead);
+    }
+    if (bytesRead < size) {
+        memset(static_cast<uint8_t*>(buffer) + bytesRead, 0, size - bytesRead);
+    }
+    return bytesRead;
+}
+
+size_t ClipReader::map(const void** data, size_t maxBytes) {
+    size_t available = clip_->size - position_;
+    size_t bytes = std::min(maxBytes, available);
+    bytes -= bytes % static_cast<size_t>(clip_->bytesPerFrame);
+    *data = clip_->data.get() + position_;
+    position_ += bytes;
+    return bytes;
+}
+
+void ClipReader::seek(size_t offset) {
+    offset = std::min(offset, clip_->size);
+    position_ = offset - offset % static_cast<size_t>(clip_->bytesPerFrame);
+}
+
+ClipSource::ClipSource(std::shared_ptr<const ClipCache::Clip> clip) : reader_(std::move(clip)) {
+    const ClipCache::Clip& cached = reader_.getClip();
+    valid_ = converter_.configure(cached.format, SampleFormat::Float, kChunkFrames * cached.channelCount, false);
+}
+
+int32_t ClipSource::read(float* buffer, int32_t numFrames) {
+    const ClipCache::Clip& clip = reader_.getClip();
+    int32_t framesDone = 0;
+    while (framesDone < numFrames) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, kChunkFrames);
+        const void* data = nullptr;
+        size_t bytes = reader_.map(&data, static_cast<size_t>(chunkFrames) * clip.bytesPerFrame);
+        auto framesRead = static_cast<int32_t>(bytes / clip.bytesPerFrame);
+        converter_.convert(data, buffer + static_cast<size_t>(framesDone) * clip.channelCount,
+                           framesRead * clip.channelCount);
+        framesDone += framesRead;
+        if (framesRead < chunkFrames) {
+            break;
+        }
+    }
+    return framesDone;
+}
@@ -0,0 +1,200 @@
+#ifndef CLIP_CACHE_H
+#define CLIP_CACHE_H
+
+#include "audio_format.h"
+#include "audio_source.h"
+#include "format_converter.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * In-memory cache of short WAV clips
+ *
+ * Alarm, notification and signalling sounds are played over and over. A
+ * cached clip holds the whole data chunk already converted to the format the
+ * stream will be opened with, so a hit starts playback without parsing or
+ * reading the file. Clips are shared, eviction never invalidates one that is
+ * still playing.
+ *
+ * Entries are keyed by path and not revalidated against the file system, call
+ * invalidate() after replacing a file. Least recently used clips are evicted
+ * to stay within the byte budget; files larger than the per-clip limit are not
+ * cached and stream from disk as before.
+ */
+class ClipCache {
+public:
+    /**
+     * Decoded PCM of one file
+     */
+    struct Clip {
+        std::string path;
+        std::string formatInfo; // Of the file, for logs
+        int32_t sampleRate = 0;
+        int32_t channelCount = 0;
+        SampleFormat format = SampleFormat::Unspecified; // Device-preferred format of the file format
+        int32_t bytesPerFrame = 0;
+        size_t size = 0;
+        std::unique_ptr<uint8_t[]> data;
+    };
+
+    /**
+     * How a playback got its data, for time-to-first-frame accounting
+     */
+    enum class Path {
+        Hit,    // Served from the cache
+        Miss,   // Loaded into the cache
+        Stream, // Not cacheable, streamed from the file
+    };
+
+    struct FirstFrameStats {
+        uint64_t count = 0;
+        uint64_t totalNs = 0; // Divide by count for the average
+        uint64_t maxNs = 0;
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t bypasses = 0; // Files over the per-clip limit, or with the cache disabled
+        size_t bytesUsed = 0;
+        size_t budgetBytes = 0;
+        int32_t clipCount = 0;
+        FirstFrameStats firstFrame[3]; // Indexed by Path
+    };
+
+    static constexpr size_t kDefaultBudgetBytes = 8 * 1024 * 1024;
+    static constexpr size_t kDefaultMaxClipBytes = 2 * 1024 * 1024;
+
+    ClipCache() = default;
+
+    // Disable copy and assignment
+    ClipCache(const ClipCache&) = delete;
+    ClipCache& operator=(const ClipCache&) = delete;
+
+    /**
+     * Set the limits, evicting clips if the new budget is smaller
+     * @param budgetBytes Total size of cached PCM, 0 disables the cache
+     * @param maxClipBytes Largest single clip
+     */
+    void setLimits(size_t budgetBytes, size_t maxClipBytes);
+
+    /**
+     * Get a clip, loading it on a miss (blocking on a miss)
+     * @param path WAV file path
+     * @param hit Set to true if the clip was already cached
+     * @return The clip, or nullptr if the file cannot be cached (too large, disabled or unreadable)
+     */
+    std::shared_ptr<const Clip> acquire(const std::string& path, bool* hit = nullptr);
+
+    /**
+     * Drop one path, for example after the file was replaced
+     */
+    void invalidate(const std::string& path);
+
+    /**
+     * Drop all clips
+     */
+    void clear();
+
+    Stats getStats() const;
+
+    /**
+     * Record the time from a start request to its first callback (real-time safe)
+     */
+    void recordFirstFrame(Path path, uint64_t ns);
+
+private:
+    struct Entry {
+        std::shared_ptr<const Clip> clip;
+    };
+
+    static std::shared_ptr<Clip> load(const std::string& path, size_t maxClipBytes);
+    void evictTo(size_t budgetBytes);
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    size_t budgetBytes_ = kDefaultBudgetBytes;
+    size_t maxClipBytes_ = kDefaultMaxClipBytes;
+    size_t bytesUsed_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t bypasses_ = 0;
+
+    struct FirstFrameCounters {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+    };
+    FirstFrameCounters firstFrame_[3];
+};
+
+/**
+ * Read cursor over a cached clip, same contract as PrefetchReader::read()
+ */
+class ClipReader {
+public:
+    explicit ClipReader(std::shared_ptr<const ClipCache::Clip> clip) : clip_(std::move(clip)) {}
+
+    /**
+     * Copy clip data (real-time safe), the unserved rest of buffer is zeroed
+     * @return Bytes copied
+     */
+    size_t read(void* buffer, size_t size);
+
+    /**
+     * Get clip data in place and advance past it (real-time safe)
+     * @return Bytes available at *data, 0 at the end
+     */
+    size_t map(const void** data, size_t maxBytes);
+
+    bool isEndOfStream() const { return position_ >= clip_->size; }
+
+    /**
+     * Continue from another position (real-time safe)
+     * @param offset Byte offset, rounded down to a whole frame and clamped to the clip
+     */
+    void seek(size_t offset);
+
+    /**
+     * Get the read position in bytes
+     */
+    size_t getPosition() const { return position_; }
+
+    const ClipCache::Clip& getClip() const { return *clip_; }
+
+private:
+    std::shared_ptr<const ClipCache::Clip> clip_;
+    size_t position_ = 0;
+};
+
+/**
+ * Cached clip as an AudioSource, for layers
+ */
+class ClipSource : public AudioSource {
+public:
+    explicit ClipSource(std::shared_ptr<const ClipCache::Clip> clip);
+
+    bool isValid() const { return valid_; }
+
+    int32_t getSampleRate() const override { return reader_.getClip().sampleRate; }
+    int32_t getChannelCount() const override { return reader_.getClip().channelCount; }
+    int32_t read(float* buffer, int32_t numFrames) override;
+    bool isFinished() const override { return reader_.isEndOfStream(); }
+
+private:
+    static constexpr int32_t kChunkFrames = 1024;
+
+    ClipReader reader_;
+    FormatConverter converter_;
+    bool valid_ = false;
+};
+
+#endif // CLIP_CACHE_H
@@ -0,0 +1,379 @@
+#include "dsp_chain.h"
+#include "audio_log.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+/**
+ * Run one sample through the band cascade (transposed direct form II)
+ * @param z z1, z2 of the first band for this channel, stride bands apart
+ */
+inline float filterSample(float x, const float* coefficients, int32_t bandCount, float* z, int32_t stride) {
+    for (int32_t band = 0; band < bandCount; band++) {
+        const float* c = coefficients + band * 5;
+        float* s = z + band * stride;
+        float y = c[0] * x + s[0];
+        s[0] = c[1] * x - c[3] * y + s[1];
+        s[1] = c[2] * x - c[4] * y;
+        x = y;
+    }
+    return x;
+}
+
+/**
+ * Kernel for one stream format; Channels > 0 fixes the channel count at compile time,
+ * 0 takes it from channelCount
+ */
+template <typename Format, int32_t Channels, bool Filtered>
+void processKernel(void* audioData,
+                   int32_t numFrames,
+                   int32_t channelCount,
+                   const float* gains,
+                   float gain,
+                   const float* coefficients,
+                   int32_t bandCount,
+                   float* state) {
+    const int32_t channels = Channels > 0 ? Channels : channelCount;
+
+    if (!Filtered) {
+        if (!gains) {
+            // Flat gain, one pass over all samples
+            const int32_t count = numFrames * channels;
+            for (int32_t i = 0; i < count; i++) {
+                Format::store(audioData, i, Format::load(audioData, i) * gain);
+            }
+            return;
+        }
+        for (int32_t frame = 0; frame < numFrames; frame++) {
+            const float frameGain = gains[frame];
+            for (int32_t channel = 0; channel < channels; channel++) {
+                int32_t index = frame * channels + channel;
+                Format::store(audioData, index, Format::load(audioData, index) * frameGain);
+            }
+        }
+        return;
+    }
+
+    // Filter state in locals for the fixed layouts, so it can stay in registers
+    constexpr int32_t kLocalState = Channels > 0 ? DspChain::kMaxBands * Channels * 2 : 1;
+    float localState[kLocalState];
+    float* z = state;
+    if (Channels > 0) {
+        memcpy(localState, state, sizeof(float) * bandCount * channels * 2);
+        z = localState;
+    }
+    const int32_t stride = channels * 2;
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        const float frameGain = gains ? gains[frame] : gain;
+        for (int32_t channel = 0; channel < channels; channel++) {
+            int32_t index = frame * channels + channel;
+            float y = filterSample(Format::load(audioData, index), coefficients, bandCount, z + channel * 2, stride);
+            Format::store(audioData, index, y * frameGain);
+        }
+    }
+    if (Channels > 0) {
+        memcpy(state, localState, sizeof(float) * bandCount * channels * 2);
+    }
+}
+
+template <typename Format, bool Filtered>
+DspChain::Kernel selectKernel(int32_t channelCount, bool specialized) {
+    if (specialized) {
+        switch (channelCount) {
+        case 1:
+            return processKernel<Format, 1, Filtered>;
+        case 2:
+            return processKernel<Format, 2, Filtered>;
+        case 6:
+            return processKernel<Format, 6, Filtered>;
+        case 8:
+            return processKernel<Format, 8, Filtered>;
+        default:
+            break;
+        }
+    }
+    return processKernel<Format, 0, Filtered>;
+}
+
+template <bool Filtered>
+DspChain::Kernel selectKernel(SampleFormat format, int32_t channelCount, bool specialized) {
+    switch (format) {
+    case SampleFormat::I16:
+        return selectKernel<I16Format, Filtered>(channelCount, specialized);
+    case SampleFormat::I24Packed:
+        return selectKernel<I24PackedFormat, Filtered>(channelCount, specialized);
+    case SampleFormat::I32:
+        return selectKernel<I32Format, Filtered>(channelCount, specialized);
+    case SampleFormat::Float:
+        return selectKernel<FloatFormat, Filtered>(channelCount, specialized);
+    default:
+        return nullptr;
+    }
+}
+
+/**
+ * RBJ audio EQ cookbook coefficients, normalized by a0
+ * @return Returns false if the band is out of range for the sample rate
+ */
+bool designBand(const DspChain::Band& band, int32_t sampleRate, float* coefficients) {
+    if (band.frequencyHz <= 0.0f || band.frequencyHz >= 0.5f * static_cast<float>(sampleRate) || band.q <= 0.0f) {
+        return false;
+    }
+    const double w0 = 2.0 * M_PI * band.frequencyHz / sampleRate;
+    const double cosW0 = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * band.q);
+    const double a = std::pow(10.0, band.gainDb / 40.0);
+    double b0, b1, b2, a0, a1, a2;
+
+    switch (band.type) {
+    case DspChain::FilterType::LowPass:
+        b0 = (1.0 - cosW0) / 2.0;
+        b1 = 1.0 - cosW0;
+        b2 = b0;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha;
+        break;
+    case DspChain::FilterType::HighPass:
+        b0 = (1.0 + cosW0) / 2.0;
+        b1 = -(1.0 + cosW0);
+        b2 = b0;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha;
+        break;
+    case DspChain::FilterType::LowShelf: {
+        const double shelf = 2.0 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + shelf);
+        b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+        b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - shelf);
+        a0 = (a + 1.0) + (a - 1.0) * cosW0 + shelf;
+        a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+        a2 = (a + 1.0) + (a - 1.0) * cosW0 - shelf;
+        break;
+    }
+    case DspChain::FilterType::HighShelf: {
+        const double shelf = 2.0 * std::sqrt(a) * alpha;
+        b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + shelf);
+        b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+        b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - shelf);
+        a0 = (a + 1.0) - (a - 1.0) * cosW0 + shelf;
+        a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+        a2 = (a + 1.0) - (a - 1.0) * cosW0 - shelf;
+        break;
+    }
+    case DspChain::FilterType::Peaking:
+        b0 = 1.0 + alpha * a;
+        b1 = -2.0 * cosW0;
+        b2 = 1.0 - alpha * a;
+        a0 = 1.0 + alpha / a;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha / a;
+        break;
+    default:
+        return false;
+    }
+
+    coefficients[0] = static_cast<float>(b0 / a0);
+    coefficients[1] = static_cast<float>(b1 / a0);
+    coefficients[2] = static_cast<float>(b2 / a0);
+    coefficients[3] = static_cast<float>(a1 / a0);
+    coefficients[4] = static_cast<float>(a2 / a0);
+    return true;
+}
+
+} // namespace
+
+bool DspChain::prepare(const Options& options,
+                       SampleFormat format,
+                       int32_t channelCount,
+                       int32_t sampleRate,
+                       int32_t maxFrames,
+                       bool specialized) {
+    kernel_ = nullptr;
+    if (channelCount <= 0 || channelCount > kMaxChannels || sampleRate <= 0 || maxFrames <= 0 ||
+        options.bands.size() > static_cast<size_t>(kMaxBands)) {
+        LOGE("DSP chain: unsupported layout %dch %dHz, %zu bands", channelCount, sampleRate, options.bands.size());
+        return false;
+    }
+
+    bandCount_ = static_cast<int32_t>(options.bands.size());
+    for (int32_t band = 0; band < bandCount_; band++) {
+        if (!designBand(options.bands[band], sampleRate, coefficients_ + band * kCoefficientsPerBand)) {
+            LOGE("DSP chain: band %d (%.1fHz, Q %.2f) out of range at %dHz", band, options.bands[band].frequencyHz,
+                 options.bands[band].q, sampleRate);
+            bandCount_ = 0;
+            return false;
+        }
+    }
+
+    kernel_ = findKernel(format, channelCount, bandCount_ > 0, specialized);
+    if (!kernel_) {
+        LOGE("DSP chain: unsupported format %d", static_cast<int32_t>(format));
+        return false;
+    }
+
+    channelCount_ = channelCount;
+    sampleRate_ = sampleRate;
+    bytesPerFrame_ = channelCount * getBytesPerSample(format);
+    maxFrames_ = maxFrames;
+    specialized_ = specialized && (channelCount == 1 || channelCount == 2 || channelCount == 6 || channelCount == 8);
+    state_.reset(new float[static_cast<size_t>(std::max(bandCount_, 1)) * channelCount * 2]());
+    gains_.reset(new float[maxFrames]);
+
+    gain_.store(options.gain, std::memory_order_relaxed);
+    appliedGain_ = options.gain;
+    resetFade(1.0f);
+    return true;
+}
+
+void DspChain::resetFade(float level) {
+    fadeLevel_ = level;
+    fadeEnd_ = level;
+    fading_ = false;
+    fadeRemaining_ = 0;
+    // A fade posted before this one is dropped and counts as done
+    fadeTaken_ = fadeRequested_.load(std::memory_order_acquire);
+    fadeCompleted_.store(fadeTaken_, std::memory_order_release);
+}
+
+uint32_t DspChain::fadeTo(float level, int32_t durationMs, FadeShape shape) {
+    int64_t frames = static_cast<int64_t>(std::max(durationMs, 0)) * sampleRate_ / 1000;
+    fadeTarget_.store(std::max(level, 0.0f), std::memory_order_relaxed);
+    fadeFrames_.store(static_cast<int32_t>(frames), std::memory_order_relaxed);
+    fadeShape_.store(static_cast<int32_t>(shape), std::memory_order_relaxed);
+    return fadeRequested_.fetch_add(1, std::memory_order_release) + 1;
+}
+
+void DspChain::process(void* audioData, int32_t numFrames) {
+    if (!kernel_ || numFrames <= 0) {
+        return;
+    }
+    if (fadeRequested_.load(std::memory_order_acquire) != fadeTaken_) {
+        takeFadeRequest();
+    }
+    if (isBypassed() && gain_.load(std::memory_order_relaxed) == 1.0f) {
+        return;
+    }
+
+    auto output = static_cast<uint8_t*>(audioData);
+    for (int32_t framesDone = 0; framesDone < numFrames;) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, maxFrames_);
+        processChunk(output + static_cast<size_t>(framesDone) * bytesPerFrame_, chunkFrames);
+        framesDone += chunkFrames;
+    }
+}
+
+void DspChain::processChunk(uint8_t* audioData, int32_t numFrames) {
+    // Gain changes ramp over the chunk, fades run at their own pace across chunks
+    const float startGain = appliedGain_;
+    const float endGain = gain_.load(std::memory_order_relaxed);
+    appliedGain_ = endGain;
+
+    const bool ramped = fillFadeGains(numFrames, startGain, endGain);
+    if (!ramped && bandCount_ == 0 && endGain * fadeLevel_ == 1.0f) {
+        return;
+    }
+    kernel_(audioData, numFrames, channelCount_, ramped ? gains_.get() : nullptr, endGain * fadeLevel_,
+            coefficients_, bandCount_, state_.get());
+
+    // A filter decaying on silence ends in denormals, which are slow on many CPUs
+    if (bandCount_ > 0) {
+        float* state = state_.get();
+        const int32_t stateCount = bandCount_ * channelCount_ * 2;
+        for (int32_t i = 0; i < stateCount; i++) {
+            state[i] = std::fabs(state[i]) < kDenormalThreshold ? 0.0f : state[i];
+        }
+    }
+}
+
+// Per-frame gains of this chunk into gains_, returns false if the gain is the same for every frame
+bool DspChain::fillFadeGains(int32_t numFrames, float startGain, float endGain) {
+    if (!fading_ && startGain == endGain) {
+        return false;
+    }
+
+    float* gains = gains_.get();
+    const float gainStep = (endGain - startGain) / static_cast<float>(numFrames);
+    for (int32_t i = 0; i < numFrames; i++) {
+        float level = fadeLevel_;
+        if (fading_) {
+            // The last frame of the fade lands exactly on its level
+            if (--fadeRemaining_ <= 0) {
+                fadeLevel_ = fadeEnd_;
+                fading_ = false;
+                fadeCompleted_.store(fadeTaken_, std::memory_order_release);
+            } else {
+                fadeLevel_ = fadeExponential_ ? fadeLevel_ * fadeStep_ : fadeLevel_ + fadeStep_;
+            }
+            level = fadeLevel_;
+        }
+        gains[i] = (startGain + gainStep * static_cast<float>(i + 1)) * level;
+    }
+    return true;
+}
+
+// Audio thread: start the latest posted fade from the level reached so far
+void DspChain::takeFadeRequest() {
+    fadeTaken_ = fadeRequested_.load(std::memory_order_acquire);
+    const float target = fadeTarget_.load(std::memory_order_relaxed);
+    const int32_t frames = fadeFrames_.load(std::memory_order_relaxed);
+    if (frames <= 0 || target == fadeLevel_) {
+        fadeLevel_ = target;
+        fadeEnd_ = target;
+        fading_ = false;
+        fadeCompleted_.store(fadeTaken_, std::memory_order_release);
+        return;
+    }
+
+    fading_ = true;
+    fadeEnd_ = target;
+    fadeRemaining_ = frames;
+    fadeExponential_ = fadeShape_.load(std::memory_order_relaxed) == static_cast<int32_t>(FadeShape::Exponential);
+    if (fadeExponential_) {
+        // Equal dB steps between the two levels, silence stands in for the floor
+        const float floor = std::pow(10.0f, kFadeFloorDb / 20.0f);
+        fadeLevel_ = std::max(fadeLevel_, floor);
+        fadeStep_ = std::pow(std::max(target, floor) / fadeLevel_, 1.0f / static_cast<float>(frames));
+    } else {
+        fadeStep_ = (target - fadeLevel_) / static_cast<float>(frames);
+    }
+}
+
+DspChain::Kernel DspChain::findKernel(SampleFormat format, int32_t channelCount, bool filtered, bool specialized) {
+    return filtered ? selectKernel<true>(format, channelCount, specialized)
+                    : selectKernel<false>(format, channelCount, specialized);
+}
+
+void DspChain::applyGainRamp(SampleFormat format,
+                             int32_t channelCount,
+                             void* audioData,
+                             int32_t numFrames,
+                             float startGain,
+                             float gainStep) {
+    Kernel kernel = selectKernel<false>(format, channelCount, false);
+    if (!kernel) {
+        return;
+    }
+    // Short spans only, a stack buffer of gains is enough
+    constexpr int32_t kSpanFrames = 256;
+    float gains[kSpanFrames];
+    auto output = static_cast<uint8_t*>(audioData);
+    const int32_t bytesPerFrame = channelCount * getBytesPerSample(format);
+    for (int32_t framesDone = 0; framesDone < numFrames;) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, kSpanFrames);
+        for (int32_t i = 0; i < chunkFrames; i++) {
+            gains[i] = startGain + gainStep * static_cast<float>(framesDone + i);
+        }
+        kernel(output + static_cast<size_t>(framesDone) * bytesPerFrame, chunkFrames, channelCount, gains, 1.0f,
+               nullptr, 0, nullptr);
+        framesDone += chunkFrames;
+    }
+}
+
+const char* DspChain::getFadeShapeName(FadeShape shape) {
+    return shape == FadeShape::Exponential ? "exponential" : "linear";
+}
@@ -0,0 +1,201 @@
+#ifndef DSP_CHAIN_H
+#define DSP_CHAIN_H
+
+#include "audio_format.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Output processing in the stream format: biquad EQ, gain and fade ramps
+ *
+ * Runs in place on the rendered callback buffer, so it covers the direct copy
+ * path as well as converted and mixed output. The kernel is selected once per
+ * stream: formats I16, I24 packed, I32 and float with 1, 2, 6 or 8 channels
+ * get a template instance with the sample type and channel count fixed at
+ * compile time, other channel counts a generic loop.
+ *
+ * Gain changes are ramped over one callback; fades are sample accurate, a
+ * fade of N frames reaches its level on the Nth frame after it was taken up
+ * by the audio thread. With unity gain, no fade and no EQ band the buffer is
+ * not touched at all, so integer output stays bit exact.
+ */
+class DspChain {
+public:
+    static constexpr int32_t kMaxBands = 8;
+    static constexpr int32_t kMaxChannels = 16;
+
+    enum class FadeShape : int32_t {
+        Linear,
+        Exponential, // Constant dB per frame, down to kFadeFloorDb and then silent
+    };
+
+    enum class FilterType : int32_t {
+        LowPass,
+        HighPass,
+        Peaking,
+        LowShelf,
+        HighShelf,
+    };
+
+    /**
+     * EQ band, RBJ cookbook biquad
+     */
+    struct Band {
+        FilterType type = FilterType::Peaking;
+        float frequencyHz = 1000.0f;
+        float q = 0.7071f;
+        float gainDb = 0.0f; // Peaking and shelves only
+    };
+
+    struct Options {
+        float gain = 1.0f;            // Linear output gain
+        int32_t startFadeMs = 10;     // Fade in when playback starts, 0 starts at full level
+        int32_t stopFadeMs = 20;      // Fade out before playback stops, 0 cuts
+        FadeShape fadeShape = FadeShape::Linear;
+        std::vector<Band> bands;      // At most kMaxBands
+    };
+
+    /**
+     * Process numFrames frames in place
+     * gains holds one gain per frame, or is nullptr to apply gain to every frame.
+     */
+    using Kernel = void (*)(void* audioData,
+                            int32_t numFrames,
+                            int32_t channelCount,
+                            const float* gains,
+                            float gain,
+                            const float* coefficients,
+                            int32_t bandCount,
+                            float* state);
+
+    DspChain() = default;
+
+    // Disable copy and assignment
+    DspChain(const DspChain&) = delete;
+    DspChain& operator=(const DspChain&) = delete;
+
+    /**
+     * Configure for a new stream (not real-time safe, the stream must not be rendering)
+     * Resets the filter state and sets the fade level to full.
+     * @param maxFrames Largest numFrames passed to process() in one go, longer buffers are split
+     * @param specialized Use the compile-time specialized kernel when one exists, false forces the generic one
+     * @return Returns false if the format, channel count or a band is unsupported
+     */
+    bool prepare(const Options& options,
+                 SampleFormat format,
+                 int32_t channelCount,
+                 int32_t sampleRate,
+                 int32_t maxFrames,
+                 bool specialized = true);
+
+    /**
+     * Apply the chain to rendered output (real-time safe, audio thread)
+     * @param audioData numFrames frames in the stream format, modified in place
+     */
+    void process(void* audioData, int32_t numFrames);
+
+    /**
+     * Change the output gain, ramped over the next callback (any thread)
+     */
+    void setGain(float gain) { gain_.store(gain, std::memory_order_relaxed); }
+    float getGain() const { return gain_.load(std::memory_order_relaxed); }
+
+    /**
+     * Set the fade level before the stream starts, e.g. silence for a fade in (not while rendering)
+     */
+    void resetFade(float level);
+
+    /**
+     * Fade from the current level to another one (any thread)
+     * A fade still running is replaced, starting from the level it reached.
+     * @param level Target level, 0 is silence and 1 full
+     * @param durationMs Fade length, 0 jumps to the level
+     * @return Fade id, see isFadeComplete()
+     */
+    uint32_t fadeTo(float level, int32_t durationMs, FadeShape shape);
+
+    /**
+     * True once the audio thread rendered the last frame of that fade or a later one
+     */
+    bool isFadeComplete(uint32_t fadeId) const {
+        return static_cast<int32_t>(fadeCompleted_.load(std::memory_order_acquire) - fadeId) >= 0;
+    }
+
+    /**
+     * True when process() leaves buffers untouched: unity gain, full level, no EQ (audio thread)
+     */
+    bool isBypassed() const { return bandCount_ == 0 && !fading_ && appliedGain_ == 1.0f && fadeLevel_ == 1.0f; }
+
+    bool isSpecialized() const { return specialized_; }
+
+    /**
+     * Get the kernel for a format and channel count
+     * @param specialized Prefer a compile-time specialized instance over the generic loop
+     * @return nullptr if the format is unsupported
+     */
+    static Kernel findKernel(SampleFormat format, int32_t channelCount, bool filtered, bool specialized);
+
+    /**
+     * Apply a linear gain ramp to stream-format frames (real-time safe)
+     * Runtime dispatched, meant for short spans such as marker edges.
+     * @param startGain Gain of the first frame
+     * @param gainStep Added per frame
+     */
+    static void applyGainRamp(SampleFormat format,
+                              int32_t channelCount,
+                              void* audioData,
+                              int32_t numFrames,
+                              float startGain,
+                              float gainStep);
+
+    static const char* getFadeShapeName(FadeShape shape);
+
+private:
+    // Exponential fades run down to this level, then drop to silence
+    static constexpr float kFadeFloorDb = -60.0f;
+
+    // Filter state below this is flushed to zero
+    static constexpr float kDenormalThreshold = 1e-20f;
+
+    // Per band: b0, b1, b2, a1, a2 normalized by a0
+    static constexpr int32_t kCoefficientsPerBand = 5;
+
+    void processChunk(uint8_t* audioData, int32_t numFrames);
+    bool fillFadeGains(int32_t numFrames, float startGain, float endGain);
+    void takeFadeRequest();
+
+    Kernel kernel_ = nullptr;
+    int32_t channelCount_ = 0;
+    int32_t sampleRate_ = 0;
+    int32_t bytesPerFrame_ = 0;
+    int32_t maxFrames_ = 0;
+    int32_t bandCount_ = 0;
+    bool specialized_ = false;
+    float coefficients_[kMaxBands * kCoefficientsPerBand] = {};
+    std::unique_ptr<float[]> state_; // Per band and channel: z1, z2 (transposed direct form II)
+    std::unique_ptr<float[]> gains_; // Per-frame gain while ramping
+
+    // Output gain: written by any thread, ramped to by the audio thread
+    std::atomic<float> gain_{1.0f};
+    float appliedGain_ = 1.0f;
+
+    // Fade request posted by fadeTo(), taken up by the audio thread
+    std::atomic<float> fadeTarget_{1.0f};
+    std::atomic<int32_t> fadeFrames_{0};
+    std::atomic<int32_t> fadeShape_{0};
+    std::atomic<uint32_t> fadeRequested_{0};
+    std::atomic<uint32_t> fadeCompleted_{0};
+
+    // Audio thread
+    uint32_t fadeTaken_ = 0;
+    bool fading_ = false;
+    bool fadeExponential_ = false;
+    float fadeLevel_ = 1.0f;
+    float fadeEnd_ = 1.0f;
+    float fadeStep_ = 0.0f; // Added per frame (linear) or multiplied per frame (exponential)
+    int32_t fadeRemaining_ = 0;
+};
+
+#endif // DSP_CHAIN_H
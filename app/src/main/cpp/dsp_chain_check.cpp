@@ -0,0 +1,491 @@
+// Host check of DspChain: bypass leaves integer output bit exact, gain changes ramp over one callback, linear and
+// exponential fades land on their level on their last frame, EQ bands have their designed response, and every
+// specialized kernel matches the generic loop bit for bit. With -b it also benchmarks ns/frame of the specialized
+// kernels against the generic one.
+#include "dsp_chain.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("dsp_chain_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run processes the same buffers
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    double uniform(double low, double high) {
+        return low + (high - low) * static_cast<double>(next() >> 11) / 9007199254740992.0;
+    }
+
+private:
+    uint64_t state_;
+};
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kBurstFrames = 192;
+
+const char* getFormatName(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::I16:
+        return "i16";
+    case SampleFormat::I24Packed:
+        return "i24";
+    case SampleFormat::I32:
+        return "i32";
+    case SampleFormat::Float:
+        return "float";
+    default:
+        return "?";
+    }
+}
+
+// Random bytes are valid samples of every integer format; float stays a little beyond full scale
+std::vector<uint8_t> makeSamples(SampleFormat format, int32_t sampleCount, uint64_t seed) {
+    Random random(seed);
+    std::vector<uint8_t> data(static_cast<size_t>(sampleCount) * getBytesPerSample(format));
+    if (format == SampleFormat::Float) {
+        for (int32_t i = 0; i < sampleCount; i++) {
+            auto sample = static_cast<float>(random.uniform(-1.2, 1.2));
+            memcpy(data.data() + static_cast<size_t>(i) * sizeof(float), &sample, sizeof(sample));
+        }
+    } else {
+        for (uint8_t& byte : data) {
+            byte = static_cast<uint8_t>(random.next() >> 56);
+        }
+    }
+    return data;
+}
+
+// Unity gain and no band never touch the buffer, also once a gain change has ramped back to unity
+void checkBypass(SampleFormat format, int32_t channelCount) {
+    const char* name = "bypass";
+    DspChain chain;
+    DspChain::Options options;
+    if (!expect(chain.prepare(options, format, channelCount, kSampleRate, kBurstFrames), name, "prepare failed")) {
+        return;
+    }
+    const int32_t sampleCount = kBurstFrames * channelCount;
+    std::vector<uint8_t> source = makeSamples(format, sampleCount, 1);
+    std::vector<uint8_t> buffer = source;
+    chain.process(buffer.data(), kBurstFrames);
+    if (!expect(chain.isBypassed() && buffer == source, name, "unity gain changed the buffer")) {
+        return;
+    }
+    chain.setGain(0.5f);
+    chain.process(buffer.data(), kBurstFrames);
+    chain.setGain(1.0f);
+    chain.process(buffer.data(), kBurstFrames);
+    buffer = source;
+    chain.process(buffer.data(), kBurstFrames);
+    if (expect(chain.isBypassed() && buffer == source, name, "buffer changed after the gain returned to unity")) {
+        printf("%s %s %dch: ok\n", name, getFormatName(format), channelCount);
+    }
+}
+
+/**
+ * Run callbacks of full-scale DC through a float chain, so the output is the applied gain per frame
+ * @return Gain of each frame of the first channel
+ */
+std::vector<float> renderGains(DspChain& chain, int32_t channelCount, int32_t frames, bool* channelsEqual) {
+    std::vector<float> gains;
+    std::vector<float> buffer(static_cast<size_t>(kBurstFrames) * channelCount);
+    *channelsEqual = true;
+    for (int32_t done = 0; done < frames; done += kBurstFrames) {
+        std::fill(buffer.begin(), buffer.end(), 1.0f);
+        chain.process(buffer.data(), kBurstFrames);
+        for (int32_t frame = 0; frame < kBurstFrames; frame++) {
+            const float* samples = buffer.data() + frame * channelCount;
+            for (int32_t channel = 1; channel < channelCount; channel++) {
+                *channelsEqual = *channelsEqual && samples[channel] == samples[0];
+            }
+            gains.push_back(samples[0]);
+        }
+    }
+    return gains;
+}
+
+// A new gain is reached on the last frame of the next callback, in equal steps
+void checkGainRamp() {
+    const char* name = "gain ramp";
+    DspChain chain;
+    DspChain::Options options;
+    if (!expect(chain.prepare(options, SampleFormat::Float, 2, kSampleRate, kBurstFrames), name, "prepare failed")) {
+        return;
+    }
+    chain.setGain(0.25f);
+    bool channelsEqual = false;
+    std::vector<float> gains = renderGains(chain, 2, 2 * kBurstFrames, &channelsEqual);
+    bool ramped = true;
+    for (int32_t frame = 0; frame < kBurstFrames; frame++) {
+        float expected = 1.0f - 0.75f * static_cast<float>(frame + 1) / kBurstFrames;
+        ramped = ramped && std::fabs(gains[frame] - expected) < 1e-6f;
+    }
+    bool steady = std::all_of(gains.begin() + kBurstFrames, gains.end(), [](float gain) { return gain == 0.25f; });
+    if (!expect(channelsEqual, name, "channels got different gains") ||
+        !expect(ramped && gains[kBurstFrames - 1] == 0.25f, name, "gain not ramped over one callback") ||
+        !expect(steady, name, "gain not held after the ramp")) {
+        return;
+    }
+
+    // The static ramp used at marker edges: gain of frame i is start + i * step
+    std::vector<float> buffer(64 * 3, 1.0f);
+    DspChain::applyGainRamp(SampleFormat::Float, 3, buffer.data(), 64, 0.5f, 0.25f / 64);
+    bool linear = true;
+    for (int32_t i = 0; i < 64 * 3; i++) {
+        linear = linear && std::fabs(buffer[i] - (0.5f + 0.25f * static_cast<float>(i / 3) / 64)) < 1e-6f;
+    }
+    if (expect(linear, name, "applyGainRamp() off its line")) {
+        printf("%s: ok\n", name);
+    }
+}
+
+/**
+ * A fade of N frames reaches its level exactly on its Nth frame, in even linear or dB steps from where it
+ * started, and isFadeComplete() turns true with the callback that rendered that frame
+ */
+void checkFade(DspChain::FadeShape shape, float from, float to) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s fade %.2f->%.2f", DspChain::getFadeShapeName(shape), from, to);
+    DspChain chain;
+    DspChain::Options options;
+    if (!expect(chain.prepare(options, SampleFormat::Float, 2, kSampleRate, kBurstFrames), name, "prepare failed")) {
+        return;
+    }
+    const int32_t fadeMs = 10;
+    const int32_t fadeFrames = fadeMs * kSampleRate / 1000; // 480, not a multiple of the callback size
+    chain.resetFade(from);
+    uint32_t fadeId = chain.fadeTo(to, fadeMs, shape);
+
+    std::vector<float> levels;
+    std::vector<float> buffer(static_cast<size_t>(kBurstFrames) * 2);
+    bool completion = true;
+    for (int32_t done = 0; done < fadeFrames + 2 * kBurstFrames; done += kBurstFrames) {
+        std::fill(buffer.begin(), buffer.end(), 1.0f);
+        chain.process(buffer.data(), kBurstFrames);
+        for (int32_t frame = 0; frame < kBurstFrames; frame++) {
+            levels.push_back(buffer[frame * 2]);
+        }
+        completion = completion && chain.isFadeComplete(fadeId) == (done + kBurstFrames >= fadeFrames);
+    }
+
+    // Linear fades step evenly; exponential ones by an even ratio from the -60 dB floor, silence stands in for it
+    const float floor = 0.001f;
+    const double start = shape == DspChain::FadeShape::Linear ? from : std::max(from, floor);
+    const double end = shape == DspChain::FadeShape::Linear ? to : std::max(to, floor);
+    bool shaped = true;
+    for (int32_t frame = 0; frame < fadeFrames - 1; frame++) {
+        double t = static_cast<double>(frame + 1) / fadeFrames;
+        double expected = shape == DspChain::FadeShape::Linear ? start + (end - start) * t
+                                                               : start * std::pow(end / start, t);
+        // Steps accumulate in float: an absolute bound for linear fades, a relative one for exponential ones
+        double tolerance = shape == DspChain::FadeShape::Linear ? 1e-4 : 1e-3 * expected;
+        shaped = shaped && std::fabs(levels[frame] - expected) <= tolerance;
+    }
+    bool held = std::all_of(levels.begin() + fadeFrames, levels.end(), [to](float level) { return level == to; });
+    if (expect(shaped, name, "fade off its curve") &&
+        expect(levels[fadeFrames - 1] == to && levels[fadeFrames - 2] != to, name, "level not reached on frame N") &&
+        expect(held, name, "level not held after the fade") &&
+        expect(completion, name, "isFadeComplete() not set by the callback that ended the fade")) {
+        printf("%s: ok (%d frames)\n", name, fadeFrames);
+    }
+}
+
+// A fade posted while another runs continues from the level reached, without a jump
+void checkFadeReplaced() {
+    const char* name = "fade replaced";
+    DspChain chain;
+    DspChain::Options options;
+    if (!expect(chain.prepare(options, SampleFormat::Float, 1, kSampleRate, kBurstFrames), name, "prepare failed")) {
+        return;
+    }
+    chain.fadeTo(0.0f, 10, DspChain::FadeShape::Linear);
+    bool channelsEqual = false;
+    std::vector<float> levels = renderGains(chain, 1, kBurstFrames, &channelsEqual);
+    uint32_t fadeId = chain.fadeTo(1.0f, 10, DspChain::FadeShape::Linear);
+    std::vector<float> next = renderGains(chain, 1, 3 * kBurstFrames, &channelsEqual);
+    const float reached = levels.back();
+    const float step = (1.0f - reached) / 480;
+    if (expect(std::fabs(next[0] - (reached + step)) < 1e-5f, name, "new fade did not start from the level reached") &&
+        expect(chain.isFadeComplete(fadeId) && next[479] == 1.0f, name, "new fade did not finish on time")) {
+        printf("%s: ok (turned at %.3f)\n", name, reached);
+    }
+}
+
+// Gain in dB of a sine through the chain, measured over whole periods once the filter settled
+double measureResponse(const DspChain::Band& band, double frequency) {
+    DspChain chain;
+    DspChain::Options options;
+    options.bands.push_back(band);
+    if (!chain.prepare(options, SampleFormat::Float, 1, kSampleRate, kBurstFrames)) {
+        return NAN;
+    }
+    const int32_t settleFrames = 2 * kSampleRate;
+    const int32_t measureFrames = kSampleRate / 10; // Whole periods of every frequency below
+    std::vector<float> buffer(static_cast<size_t>(settleFrames + measureFrames));
+    for (size_t i = 0; i < buffer.size(); i++) {
+        buffer[i] = static_cast<float>(0.25 * std::sin(2.0 * M_PI * frequency * static_cast<double>(i) / kSampleRate));
+    }
+    std::vector<float> input = buffer;
+    for (size_t done = 0; done < buffer.size(); done += kBurstFrames) {
+        chain.process(buffer.data() + done, static_cast<int32_t>(std::min<size_t>(kBurstFrames, buffer.size() - done)));
+    }
+    double inputPower = 0.0;
+    double outputPower = 0.0;
+    for (size_t i = settleFrames; i < buffer.size(); i++) {
+        inputPower += static_cast<double>(input[i]) * input[i];
+        outputPower += static_cast<double>(buffer[i]) * buffer[i];
+    }
+    return 10.0 * std::log10(outputPower / inputPower);
+}
+
+struct ResponsePoint {
+    double frequency;
+    double expectedDb;
+    double toleranceDb; // Negative: the response must be at most expectedDb
+};
+
+struct ResponseCase {
+    const char* name;
+    DspChain::Band band;
+    std::vector<ResponsePoint> points;
+};
+
+void checkResponse(const ResponseCase& responseCase) {
+    const char* name = responseCase.name;
+    char what[128];
+    bool ok = true;
+    for (const ResponsePoint& point : responseCase.points) {
+        double gainDb = measureResponse(responseCase.band, point.frequency);
+        bool inRange = point.toleranceDb < 0.0 ? gainDb <= point.expectedDb
+                                               : std::fabs(gainDb - point.expectedDb) <= point.toleranceDb;
+        snprintf(what, sizeof(what), "%.4g dB at %.0f Hz, expected %s%.4g dB", gainDb, point.frequency,
+                 point.toleranceDb < 0.0 ? "at most " : "", point.expectedDb);
+        ok = expect(inRange, name, what) && ok;
+    }
+    if (ok) {
+        printf("%s: ok\n", name);
+    }
+}
+
+DspChain::Band makeBand(DspChain::FilterType type, float frequencyHz, float q, float gainDb) {
+    DspChain::Band band;
+    band.type = type;
+    band.frequencyHz = frequencyHz;
+    band.q = q;
+    band.gainDb = gainDb;
+    return band;
+}
+
+const ResponseCase kResponseCases[] = {
+    {"peaking +6 dB at 1 kHz",
+     makeBand(DspChain::FilterType::Peaking, 1000.0f, 1.0f, 6.0f),
+     {{1000.0, 6.0, 0.02}, {100.0, 0.0, 0.3}, {10000.0, 0.0, 0.3}}},
+    {"peaking -12 dB at 3 kHz",
+     makeBand(DspChain::FilterType::Peaking, 3000.0f, 2.0f, -12.0f),
+     {{3000.0, -12.0, 0.02}, {300.0, 0.0, 0.2}, {20000.0, 0.0, 0.3}}},
+    {"low pass 1 kHz",
+     makeBand(DspChain::FilterType::LowPass, 1000.0f, 0.7071f, 0.0f),
+     {{1000.0, -3.01, 0.02}, {100.0, 0.0, 0.02}, {10000.0, -35.0, -1.0}}},
+    {"high pass 1 kHz",
+     makeBand(DspChain::FilterType::HighPass, 1000.0f, 0.7071f, 0.0f),
+     {{1000.0, -3.01, 0.02}, {10000.0, 0.0, 0.1}, {100.0, -35.0, -1.0}}},
+    {"low shelf +6 dB at 200 Hz",
+     makeBand(DspChain::FilterType::LowShelf, 200.0f, 0.7071f, 6.0f),
+     {{200.0, 3.0, 0.1}, {30.0, 6.0, 0.3}, {10000.0, 0.0, 0.05}}},
+    {"high shelf -6 dB at 8 kHz",
+     makeBand(DspChain::FilterType::HighShelf, 8000.0f, 0.7071f, -6.0f),
+     {{8000.0, -3.0, 0.1}, {20000.0, -6.0, 0.3}, {100.0, 0.0, 0.05}}},
+};
+
+// Two stable biquads and some history, so specialized and generic kernels run the same recursion
+const float kCoefficients[] = {1.02f, -1.90f, 0.90f, -1.90f, 0.92f, 0.30f, 0.60f, 0.30f, -0.20f, 0.10f};
+constexpr int32_t kKernelBands = 2;
+
+std::vector<float> makeState(int32_t channelCount) {
+    Random random(3);
+    std::vector<float> state(static_cast<size_t>(kKernelBands) * channelCount * 2);
+    for (float& value : state) {
+        value = static_cast<float>(random.uniform(-0.1, 0.1));
+    }
+    return state;
+}
+
+const SampleFormat kFormats[] = {SampleFormat::I16, SampleFormat::I24Packed, SampleFormat::I32, SampleFormat::Float};
+
+// Every specialized kernel against the generic loop, with flat or per-frame gain, over blocks that carry state
+void checkKernels() {
+    const char* name = "kernels";
+    const int32_t blockFrames = 100;
+    const int32_t blocks = 3;
+    std::vector<float> gains(static_cast<size_t>(blockFrames));
+    for (int32_t i = 0; i < blockFrames; i++) {
+        gains[i] = 0.8f - 0.5f * static_cast<float>(i) / blockFrames;
+    }
+    const float* const gainOptions[] = {nullptr, gains.data()};
+    int32_t compared = 0;
+    for (SampleFormat format : kFormats) {
+        for (int32_t channelCount : {1, 2, 3, 6, 8}) {
+            for (bool filtered : {false, true}) {
+                DspChain::Kernel specialized = DspChain::findKernel(format, channelCount, filtered, true);
+                DspChain::Kernel generic = DspChain::findKernel(format, channelCount, filtered, false);
+                const bool fixedLayout = channelCount != 3;
+                if (!expect(specialized && generic && (specialized != generic) == fixedLayout, name,
+                            "specialized kernel missing or unexpected")) {
+                    continue;
+                }
+                for (const float* frameGains : gainOptions) {
+                    std::vector<uint8_t> expected = makeSamples(format, blockFrames * blocks * channelCount, 2);
+                    std::vector<uint8_t> actual = expected;
+                    std::vector<float> expectedState = makeState(channelCount);
+                    std::vector<float> actualState = expectedState;
+                    const size_t blockBytes =
+                        static_cast<size_t>(blockFrames) * channelCount * getBytesPerSample(format);
+                    for (int32_t block = 0; block < blocks; block++) {
+                        generic(expected.data() + block * blockBytes, blockFrames, channelCount, frameGains, 0.7f,
+                                kCoefficients, filtered ? kKernelBands : 0, expectedState.data());
+                        specialized(actual.data() + block * blockBytes, blockFrames, channelCount, frameGains, 0.7f,
+                                    kCoefficients, filtered ? kKernelBands : 0, actualState.data());
+                    }
+                    char what[96];
+                    snprintf(what, sizeof(what), "%s %dch %s %s gain differs from the generic loop",
+                             getFormatName(format), channelCount, filtered ? "EQ" : "no EQ",
+                             frameGains ? "ramped" : "flat");
+                    expect(actual == expected && actualState == expectedState, name, what);
+                    compared++;
+                }
+            }
+        }
+    }
+    printf("%s: %d layouts compared\n", name, compared);
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// ns/frame of a kernel over a callback-sized buffer kept in cache, best of a few timed batches
+double measureKernel(DspChain::Kernel kernel, SampleFormat format, int32_t channelCount, bool filtered,
+                     const float* gains, int32_t milliseconds) {
+    std::vector<uint8_t> buffer = makeSamples(format, kBurstFrames * channelCount, 4);
+    std::vector<float> state(static_cast<size_t>(kKernelBands) * channelCount * 2, 0.0f);
+    double best = 1e30;
+    const uint64_t endNs = nowNs() + static_cast<uint64_t>(milliseconds) * 1000000;
+    while (nowNs() < endNs) {
+        const int32_t batch = 256;
+        uint64_t beginNs = nowNs();
+        for (int32_t i = 0; i < batch; i++) {
+            // Gains at unity-ish levels keep the samples from decaying to zero or clipping over the batch
+            kernel(buffer.data(), kBurstFrames, channelCount, gains, 1.0f, kCoefficients,
+                   filtered ? kKernelBands : 0, state.data());
+        }
+        best = std::min(best, static_cast<double>(nowNs() - beginNs) / (static_cast<double>(batch) * kBurstFrames));
+    }
+    return best;
+}
+
+void benchmark(int32_t milliseconds) {
+    std::vector<float> gains(static_cast<size_t>(kBurstFrames), 1.0f);
+    for (SampleFormat format : kFormats) {
+        for (int32_t channelCount : {2, 8}) {
+            for (int32_t variant = 0; variant < 3; variant++) {
+                const bool filtered = variant == 2;
+                const float* frameGains = variant == 1 ? gains.data() : nullptr;
+                double specialized = measureKernel(DspChain::findKernel(format, channelCount, filtered, true), format,
+                                                   channelCount, filtered, frameGains, milliseconds);
+                double generic = measureKernel(DspChain::findKernel(format, channelCount, filtered, false), format,
+                                               channelCount, filtered, frameGains, milliseconds);
+                printf("%-5s %dch %-11s %7.2f ns/frame specialized, %7.2f generic  %5.2fx\n", getFormatName(format),
+                       channelCount, filtered ? "2-band EQ" : variant == 1 ? "ramped gain" : "flat gain",
+                       specialized, generic, specialized > 0.0 ? generic / specialized : 0.0);
+            }
+        }
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Also benchmark the specialized kernels against the generic loop\n"
+            "  -m <ms>       Time per kernel for -b, default 200\n"
+            "  -v            Keep the chain's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool bench = false;
+    int32_t milliseconds = 200;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-m") == 0 && index + 1 < argc && atoi(argv[index + 1]) > 0) {
+            milliseconds = atoi(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // prepare() logs rejected layouts
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    checkBypass(SampleFormat::I16, 2);
+    checkBypass(SampleFormat::I24Packed, 6);
+    checkBypass(SampleFormat::I32, 3);
+    checkGainRamp();
+    for (DspChain::FadeShape shape : {DspChain::FadeShape::Linear, DspChain::FadeShape::Exponential}) {
+        checkFade(shape, 0.0f, 1.0f);
+        checkFade(shape, 1.0f, 0.0f);
+        checkFade(shape, 0.5f, 0.125f);
+    }
+    checkFadeReplaced();
+    for (const ResponseCase& responseCase : kResponseCases) {
+        checkResponse(responseCase);
+    }
+    checkKernels();
+
+    if (bench) {
+        benchmark(milliseconds);
+    }
+    if (failures > 0) {
+        printf("dsp_chain_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
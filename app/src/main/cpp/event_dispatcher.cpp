@@ -0,0 +1,91 @@
+#include "event_dispatcher.h"
+#include "audio_log.h"
+
+EventDispatcher::EventDispatcher(size_t capacity) : queue_(capacity) { sem_init(&semaphore_, 0, 0); }
+
+EventDispatcher::~EventDispatcher() noexcept {
+    stop();
+    sem_destroy(&semaphore_);
+}
+
+bool EventDispatcher::start(Handler handler, ThreadHook onThreadStart, ThreadHook onThreadStop) {
+    if (thread_.joinable()) {
+        return false;
+    }
+    handler_ = std::move(handler);
+    running_.store(true);
+    thread_ = std::thread(&EventDispatcher::run, this, std::move(onThreadStart), std::move(onThreadStop));
+    return true;
+}
+
+void EventDispatcher::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    running_.store(false);
+    sem_post(&semaphore_);
+    thread_.join();
+    handler_ = nullptr;
+}
+
+bool EventDispatcher::post(PlayerEvent event) {
+    event.postNs = CallbackStats::nowNs();
+    if (!queue_.push(event)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    posted_.fetch_add(1, std::memory_order_relaxed);
+    sem_post(&semaphore_);
+    return true;
+}
+
+EventDispatcher::Stats EventDispatcher::getStats() const {
+    Stats stats;
+    stats.posted = posted_.load(std::memory_order_relaxed);
+    stats.delivered = delivered_.load(std::memory_order_relaxed);
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.latencyNs = latencyNs_.getSummary();
+    return stats;
+}
+
+void EventDispatcher::run(ThreadHook onThreadStart, ThreadHook onThreadStop) {
+    if (onThreadStart) {
+        onThreadStart();
+    }
+
+    while (running_.load()) {
+        sem_wait(&semaphore_);
+        drain();
+    }
+    // Events posted before stop() still reach the handler
+    while (drain() > 0) {
+    }
+
+    if (onThreadStop) {
+        onThreadStop();
+    }
+}
+
+size_t EventDispatcher::drain() {
+    PlayerEvent batch[kMaxBatch];
+    size_t total = 0;
+    for (;;) {
+        size_t count = 0;
+        while (count < kMaxBatch && queue_.pop(&batch[count])) {
+            count++;
+        }
+        if (count == 0) {
+            return total;
+        }
+
+        uint64_t now = CallbackStats::nowNs();
+        for (size_t i = 0; i < count; i++) {
+            latencyNs_.record(now > batch[i].postNs ? now - batch[i].postNs : 0);
+        }
+        handler_(batch, count);
+        delivered_.fetch_add(count, std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        total += count;
+    }
+}
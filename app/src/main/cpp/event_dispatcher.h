@@ -0,0 +1,112 @@
+#ifndef EVENT_DISPATCHER_H
+#define EVENT_DISPATCHER_H
+
+#include "callback_stats.h"
+#include "event_queue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <semaphore.h>
+#include <thread>
+
+/**
+ * Playback notification, small enough to post from the audio thread
+ */
+struct PlayerEvent {
+    enum class Type : int32_t {
+        Started,
+        Stopped,
+        Error,
+    };
+
+    Type type = Type::Stopped;
+    const char* message = nullptr; // Static string, errors only
+    const char* detail = nullptr;  // Static string appended to message, may be null
+    uint64_t postNs = 0;
+};
+
+/**
+ * Delivers PlayerEvents on a dedicated thread
+ *
+ * Producers (audio callback, stream error callback, queue worker, control
+ * thread) only push a PlayerEvent into a lock-free queue and post a
+ * semaphore, which neither locks nor allocates. The dispatcher thread
+ * drains the queue in batches and hands them to the handler, so listeners
+ * never run on the audio thread. Thread hooks let the caller prepare the
+ * dispatcher thread, for example attach it to the Java VM.
+ */
+class EventDispatcher {
+public:
+    /**
+     * Receives one batch of events, oldest first, on the dispatcher thread
+     */
+    using Handler = std::function<void(const PlayerEvent* events, size_t count)>;
+    using ThreadHook = std::function<void()>;
+
+    struct Stats {
+        uint64_t posted = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped = 0; // Queue was full
+        uint64_t batches = 0;
+        LogLinearHistogram::Summary latencyNs; // Post to delivery
+    };
+
+    static constexpr size_t kDefaultCapacity = 64;
+    static constexpr size_t kMaxBatch = 16;
+
+    explicit EventDispatcher(size_t capacity = kDefaultCapacity);
+
+    /**
+     * Destructor, stops the dispatcher thread
+     */
+    ~EventDispatcher() noexcept;
+
+    // Disable copy and assignment
+    EventDispatcher(const EventDispatcher&) = delete;
+    EventDispatcher& operator=(const EventDispatcher&) = delete;
+
+    /**
+     * Start the dispatcher thread
+     * @param handler Receives the events
+     * @param onThreadStart Run first on the dispatcher thread, may be empty
+     * @param onThreadStop Run last on the dispatcher thread, may be empty
+     * @return Returns false if already running
+     */
+    bool start(Handler handler, ThreadHook onThreadStart, ThreadHook onThreadStop);
+
+    /**
+     * Deliver what is still queued and stop the dispatcher thread (blocking)
+     */
+    void stop();
+
+    /**
+     * Queue an event for delivery (real-time safe, any thread)
+     * Events posted while stopped are kept and delivered after the next start().
+     * @return Returns false if the queue is full and the event was dropped
+     */
+    bool post(PlayerEvent event);
+
+    /**
+     * Get delivery counters, safe from any thread
+     */
+    Stats getStats() const;
+
+private:
+    void run(ThreadHook onThreadStart, ThreadHook onThreadStop);
+    size_t drain();
+
+    EventQueue<PlayerEvent> queue_;
+    sem_t semaphore_;
+    Handler handler_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::atomic<uint64_t> posted_{0};
+    std::atomic<uint64_t> delivered_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> batches_{0};
+    LogLinearHistogram latencyNs_; // Recorded by the dispatcher thread only
+};
+
+#endif // EVENT_DISPATCHER_H
@@ -0,0 +1,102 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+/**
+ * Bounded multi-producer/single-consumer lock-free queue of small POD values
+ *
+ * Each cell carries a sequence number telling producers and the consumer
+ * whose turn it is (the bounded queue by D. Vyukov). A push is one CAS on
+ * the tail plus a copy; storage is allocated once in the constructor, so
+ * any thread, the audio thread included, can push without locking or
+ * allocating. Capacity is rounded up to a power of two.
+ */
+template <typename T>
+class EventQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "EventQueue holds trivially copyable values only");
+
+public:
+    /**
+     * Constructor
+     * @param capacity Minimum number of queued values (rounded up to a power of two)
+     */
+    explicit EventQueue(size_t capacity) : capacity_(roundUpToPowerOfTwo(capacity)), mask_(capacity_ - 1) {
+        cells_.reset(new Cell[capacity_]);
+        for (size_t i = 0; i < capacity_; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Disable copy and assignment
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * Append a value (real-time safe, any thread)
+     * @return Returns false if the queue is full
+     */
+    bool push(const T& value) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[position & mask_];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                return false; // Full
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Take the oldest value (consumer only)
+     * @return Returns false if the queue is empty
+     */
+    bool pop(T* value) {
+        Cell& cell = cells_[head_ & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(head_ + 1) < 0) {
+            return false; // Empty, or the producer of this cell has not finished yet
+        }
+        *value = cell.value;
+        cell.sequence.store(head_ + capacity_, std::memory_order_release);
+        head_++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        T value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> tail_{0}; // Producers
+    alignas(64) size_t head_ = 0;             // Consumer
+};
+
+#endif // EVENT_QUEUE_H
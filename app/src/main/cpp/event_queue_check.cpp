@@ -0,0 +1,217 @@
+// Host check of EventQueue and EventDispatcher: FIFO and full/empty behaviour, several producers racing one
+// consumer without loss, duplication or reordering per producer, producers that never allocate, lock or do I/O
+// (under RealtimeChecker), drops while the queue is full, and post-to-delivery latency of paced events.
+#include "event_dispatcher.h"
+#include "event_queue.h"
+#include "realtime_checker.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("event_queue_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+struct Item {
+    uint32_t producer;
+    uint32_t sequence;
+};
+
+void checkFifo() {
+    const char* name = "fifo";
+    EventQueue<Item> queue(5);
+    if (!expect(queue.capacity() == 8, name, "capacity not rounded up to a power of two")) {
+        return;
+    }
+    // Fill and drain in uneven steps, so positions wrap the cells many times
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    for (int32_t round = 0; round < 1000; round++) {
+        for (int32_t i = 0; i < 1 + round % 11; i++) {
+            bool full = pushed - popped == queue.capacity();
+            if (!expect(queue.push(Item{0, pushed}) == !full, name, "push did not match the fill level")) {
+                return;
+            }
+            pushed += full ? 0 : 1;
+        }
+        Item item{};
+        for (int32_t i = 0; i < 1 + round % 7; i++) {
+            bool empty = pushed == popped;
+            if (!expect(queue.pop(&item) == !empty, name, "pop did not match the fill level") ||
+                !expect(empty || item.sequence == popped, name, "values out of order")) {
+                return;
+            }
+            popped += empty ? 0 : 1;
+        }
+    }
+    printf("%s: ok (%u values)\n", name, pushed);
+}
+
+// Producers race for the tail while the consumer drains; every producer's values arrive once and in order
+void checkProducers() {
+    const char* name = "mpsc stress";
+    const uint32_t producerCount = 4;
+    const uint32_t itemsPerProducer = 200000;
+    EventQueue<Item> queue(64);
+
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < producerCount; p++) {
+        producers.emplace_back([&queue, p, itemsPerProducer]() {
+            for (uint32_t sequence = 0; sequence < itemsPerProducer; sequence++) {
+                while (!queue.push(Item{p, sequence})) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(producerCount, 0);
+    bool ordered = true;
+    for (uint64_t received = 0; received < uint64_t{producerCount} * itemsPerProducer;) {
+        Item item{};
+        if (!queue.pop(&item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (item.producer >= producerCount || item.sequence != next[item.producer]) {
+            ordered = false;
+            break;
+        }
+        next[item.producer]++;
+        received++;
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    Item item{};
+    if (expect(ordered, name, "a value was lost, duplicated or reordered") &&
+        expect(!queue.pop(&item), name, "values left over")) {
+        printf("%s: ok (%u producers x %u values)\n", name, producerCount, itemsPerProducer);
+    }
+}
+
+// One static message per producer, so deliveries can be told apart without allocating
+const char* const kProducerNames[] = {"producer 0", "producer 1", "producer 2", "producer 3"};
+
+/**
+ * Producers post through an EventDispatcher inside RealtimeChecker scopes, paced like callbacks or in bursts
+ * @param pauseUs Pause between posts, outside the scope; 0 posts back to back
+ */
+void checkDispatcher(const char* name, uint32_t eventsPerProducer, int32_t pauseUs, double maxP99Ms) {
+    const uint32_t producerCount = 4;
+    EventDispatcher dispatcher(256);
+
+    // Touched by the dispatcher thread only until stop() joins it
+    std::vector<uint64_t> delivered(producerCount, 0);
+    std::vector<uint64_t> lastPostNs(producerCount, 0);
+    bool ordered = true;
+    dispatcher.start(
+        [&](const PlayerEvent* events, size_t count) {
+            for (size_t i = 0; i < count; i++) {
+                uint32_t p = 0;
+                while (p < producerCount && events[i].message != kProducerNames[p]) {
+                    p++;
+                }
+                if (p == producerCount || events[i].postNs < lastPostNs[p]) {
+                    ordered = false;
+                    continue;
+                }
+                lastPostNs[p] = events[i].postNs;
+                delivered[p]++;
+            }
+        },
+        nullptr, nullptr);
+
+    RealtimeChecker::clear();
+    RealtimeChecker::enable();
+    std::vector<std::thread> producers;
+    std::vector<uint64_t> accepted(producerCount, 0);
+    for (uint32_t p = 0; p < producerCount; p++) {
+        producers.emplace_back([&dispatcher, &accepted, p, eventsPerProducer, pauseUs]() {
+            PlayerEvent event;
+            event.type = PlayerEvent::Type::Error;
+            event.message = kProducerNames[p];
+            for (uint32_t i = 0; i < eventsPerProducer; i++) {
+                {
+                    RealtimeChecker::Scope scope;
+                    accepted[p] += dispatcher.post(event) ? 1 : 0;
+                }
+                if (pauseUs > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(pauseUs));
+                }
+            }
+        });
+    }
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+    RealtimeChecker::disable();
+    dispatcher.stop();
+
+    EventDispatcher::Stats stats = dispatcher.getStats();
+    uint64_t violations = RealtimeChecker::getViolationCount();
+    if (violations > 0) {
+        RealtimeChecker::printReport(stdout);
+    }
+    expect(violations == 0, name, "post() allocated, locked or did I/O");
+    expect(ordered, name, "events of a producer delivered out of order");
+    bool counted = stats.posted + stats.dropped == uint64_t{producerCount} * eventsPerProducer &&
+                   stats.delivered == stats.posted;
+    for (uint32_t p = 0; p < producerCount; p++) {
+        counted = counted && delivered[p] == accepted[p];
+    }
+    expect(counted, name, "delivered events do not match the posted ones");
+    double p99Ms = static_cast<double>(stats.latencyNs.p99) / 1e6;
+    expect(pauseUs == 0 || (stats.dropped == 0 && p99Ms <= maxP99Ms), name, "paced events late or dropped");
+    printf("%s: %llu posted, %llu dropped, %llu batches, latency p50 %.1f us p99 %.1f us max %.1f us\n", name,
+           static_cast<unsigned long long>(stats.posted), static_cast<unsigned long long>(stats.dropped),
+           static_cast<unsigned long long>(stats.batches), stats.latencyNs.p50 / 1e3, stats.latencyNs.p99 / 1e3,
+           stats.latencyNs.max / 1e3);
+}
+
+// While stopped the queue keeps what fits and drops the rest; start() delivers what was kept
+void checkDrops() {
+    const char* name = "full queue";
+    EventDispatcher dispatcher(16);
+    PlayerEvent event;
+    uint32_t accepted = 0;
+    for (int32_t i = 0; i < 40; i++) {
+        accepted += dispatcher.post(event) ? 1 : 0;
+    }
+    uint64_t delivered = 0;
+    dispatcher.start([&delivered](const PlayerEvent*, size_t count) { delivered += count; }, nullptr, nullptr);
+    dispatcher.stop();
+    EventDispatcher::Stats stats = dispatcher.getStats();
+    if (expect(accepted == 16 && stats.dropped == 24 && delivered == 16, name, "wrong events kept or dropped")) {
+        printf("%s: ok\n", name);
+    }
+}
+
+} // namespace
+
+int main() {
+    checkFifo();
+    checkProducers();
+    // Paced like a few streams posting once per 1 ms callback: delivery stays within a few scheduler ticks
+    checkDispatcher("dispatcher paced", 500, 1000, 20.0);
+    // Back to back: the queue may fill, but nothing is lost without being counted
+    checkDispatcher("dispatcher burst", 5000, 0, 0.0);
+    checkDrops();
+
+    if (failures > 0) {
+        printf("event_queue_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
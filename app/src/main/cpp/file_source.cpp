@@ -0,0 +1,61 @@
+#include "file_source.h"
+#include "audio_log.h"
+#include <algorithm>
+
+// std::min takes kChunkFrames by reference
+constexpr int32_t FileSource::kChunkFrames;
+
+FileSource::~FileSource() noexcept {
+    // The reader thread must be gone before its source file is closed
+    prefetch_.stop();
+}
+
+bool FileSource::open(const std::string& path, AudioFile::IoMode ioMode, int32_t prefetchDepthMs) {
+    prefetch_.stop();
+    file_ = openAudioFile(path, ioMode);
+    if (!file_) {
+        LOGE("Failed to open source: %s", path.c_str());
+        return false;
+    }
+
+    bytesPerFrame_ = file_->getBytesPerFrame();
+    int32_t channelCount = file_->getChannelCount();
+    if (!converter_.configure(file_->getSampleFormat(), SampleFormat::Float, kChunkFrames * channelCount, false)) {
+        return false;
+    }
+    readBuffer_.reset(new uint8_t[static_cast<size_t>(kChunkFrames) * bytesPerFrame_]);
+
+    PrefetchReader::Config config = PrefetchReader::makeConfig(
+        static_cast<int64_t>(bytesPerFrame_) * file_->getSampleRate(), bytesPerFrame_, prefetchDepthMs, 50, 90);
+    if (!prefetch_.start(file_.get(), config)) {
+        return false;
+    }
+
+    finished_ = false;
+    return true;
+}
+
+int32_t FileSource::read(float* buffer, int32_t numFrames) {
+    if (!readBuffer_ || finished_) {
+        return 0;
+    }
+
+    int32_t channelCount = file_->getChannelCount();
+    int32_t framesDone = 0;
+    while (framesDone < numFrames) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, kChunkFrames);
+        size_t chunkBytes = static_cast<size_t>(chunkFrames) * bytesPerFrame_;
+        size_t bytesRead = prefetch_.read(readBuffer_.get(), chunkBytes);
+        auto framesRead = static_cast<int32_t>(bytesRead / bytesPerFrame_);
+
+        converter_.convert(readBuffer_.get(), buffer + static_cast<size_t>(framesDone) * channelCount,
+                           framesRead * channelCount);
+        framesDone += framesRead;
+
+        if (bytesRead < chunkBytes) {
+            finished_ = prefetch_.isEndOfStream();
+            break;
+        }
+    }
+    return framesDone;
+}
@@ -0,0 +1,57 @@
+#ifndef FILE_SOURCE_H
+#define FILE_SOURCE_H
+
+#include "audio_file.h"
+#include "audio_source.h"
+#include "format_converter.h"
+#include "prefetch_reader.h"
+#include <memory>
+#include <string>
+
+/**
+ * WAV or FLAC file as an AudioSource
+ *
+ * Owns the file and its prefetch reader, so the audio thread only copies out
+ * of memory and converts to float.
+ */
+class FileSource : public AudioSource {
+public:
+    FileSource() = default;
+
+    /**
+     * Destructor, stops the reader thread
+     */
+    ~FileSource() noexcept override;
+
+    // Disable copy and assignment
+    FileSource(const FileSource&) = delete;
+    FileSource& operator=(const FileSource&) = delete;
+
+    /**
+     * Open the file and start prefetching (not real-time safe)
+     * @param path WAV or FLAC file path
+     * @param ioMode Streamed reads or memory mapping
+     * @param prefetchDepthMs Prefetch ring depth
+     * @return Returns true on success
+     */
+    bool open(const std::string& path,
+              AudioFile::IoMode ioMode = AudioFile::IoMode::MemoryMap,
+              int32_t prefetchDepthMs = 500);
+
+    int32_t getSampleRate() const override { return file_ ? file_->getSampleRate() : 0; }
+    int32_t getChannelCount() const override { return file_ ? file_->getChannelCount() : 0; }
+    int32_t read(float* buffer, int32_t numFrames) override;
+    bool isFinished() const override { return finished_; }
+
+private:
+    static constexpr int32_t kChunkFrames = 1024;
+
+    std::unique_ptr<AudioFile> file_;
+    PrefetchReader prefetch_;
+    FormatConverter converter_;
+    std::unique_ptr<uint8_t[]> readBuffer_;
+    int32_t bytesPerFrame_ = 0;
+    bool finished_ = false;
+};
+
+#endif // FILE_SOURCE_H
@@ -0,0 +1,817 @@
+// Host check of the FlacFile decoder: a small encoder here writes streams covering every subframe type, stereo
+// mode, partition layout, bit depth from 8 to 24, up to 8 channels and fixed or variable block sizes, and each
+// decoded stream must match its source PCM exactly, also after seeks, through the prefetch reader and around a
+// corrupted frame. Reports decode throughput (x realtime) and CPU share; -b decodes for longer.
+#include "flac_file.h"
+#include "prefetch_reader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("flac_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run encodes the same streams
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    // Uniform in [low, high]
+    int64_t range(int64_t low, int64_t high) {
+        return low + static_cast<int64_t>(next() % static_cast<uint64_t>(high - low + 1));
+    }
+
+private:
+    uint64_t state_;
+};
+
+// ---------------------------------------------------------------------------
+// Encoder
+// ---------------------------------------------------------------------------
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+    void write(uint64_t value, int32_t bits) {
+        for (int32_t bit = bits - 1; bit >= 0; bit--) {
+            accumulator_ = static_cast<uint8_t>(accumulator_ << 1 | ((value >> bit) & 1));
+            if (++count_ == 8) {
+                out_->push_back(accumulator_);
+                accumulator_ = 0;
+                count_ = 0;
+            }
+        }
+    }
+
+    void writeSigned(int64_t value, int32_t bits) { write(static_cast<uint64_t>(value), bits); }
+
+    void writeUnary(uint64_t zeros) {
+        for (; zeros >= 32; zeros -= 32) {
+            write(0, 32);
+        }
+        write(1, static_cast<int32_t>(zeros) + 1);
+    }
+
+    void align() {
+        if (count_ > 0) {
+            write(0, 8 - count_);
+        }
+    }
+
+private:
+    std::vector<uint8_t>* out_;
+    uint8_t accumulator_ = 0;
+    int32_t count_ = 0;
+};
+
+uint8_t crc8(const uint8_t* data, size_t size) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int32_t bit = 0; bit < 8; bit++) {
+            crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint16_t crc16(const uint8_t* data, size_t size) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (int32_t bit = 0; bit < 8; bit++) {
+            crc = static_cast<uint16_t>(crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Frame or sample number in the extended UTF-8 coding of frame headers
+void writeUtf8Number(std::vector<uint8_t>* out, uint64_t value) {
+    if (value < 0x80) {
+        out->push_back(static_cast<uint8_t>(value));
+        return;
+    }
+    int32_t length = 2;
+    while (length < 7 && value >= (uint64_t{1} << (5 * length + 1))) {
+        length++;
+    }
+    out->push_back(static_cast<uint8_t>((0xFF00 >> length) | (value >> (6 * (length - 1)))));
+    for (int32_t i = length - 2; i >= 0; i--) {
+        out->push_back(static_cast<uint8_t>(0x80 | ((value >> (6 * i)) & 0x3F)));
+    }
+}
+
+enum class Mode {
+    Verbatim,
+    Fixed0,
+    Fixed1,
+    Fixed2,
+    Fixed3, // Also writes its first partition with an escape code
+    Fixed4,
+    Lpc,
+};
+
+enum class Stereo {
+    Independent,
+    LeftSide,
+    SideRight,
+    MidSide,
+};
+
+struct StreamLayout {
+    const char* name;
+    int32_t sampleRate;
+    int32_t channelCount;
+    int32_t bitsPerSample;
+    std::vector<uint32_t> blockSizes; // Cycled; more than one makes a variable block size stream
+    std::vector<Mode> modes;          // Cycled per frame, constant subframes are picked whenever possible
+    int32_t lpcOrder;
+    int32_t lpcPrecision;
+    bool noise;             // Full-scale noise instead of tones, for escapes and wide Rice parameters
+    uint64_t seekInterval;  // Samples between seek points, 0 for no SEEKTABLE
+};
+
+uint64_t zigZag(int64_t residual) {
+    return residual >= 0 ? static_cast<uint64_t>(residual) << 1 : (static_cast<uint64_t>(-residual) << 1) - 1;
+}
+
+void writeResidual(BitWriter& writer, const std::vector<int64_t>& residual, int32_t order, uint32_t blockSize,
+                   int32_t partitionOrder, bool escapeFirst) {
+    while (partitionOrder > 0 && ((blockSize % (1u << partitionOrder)) != 0 ||
+                                  (blockSize >> partitionOrder) < static_cast<uint32_t>(order))) {
+        partitionOrder--;
+    }
+    const uint32_t partitionSize = blockSize >> partitionOrder;
+    std::vector<int32_t> parameters;
+    bool wide = false;
+    for (uint32_t p = 0, index = 0; p < (1u << partitionOrder); p++) {
+        uint32_t count = p == 0 ? partitionSize - order : partitionSize;
+        uint64_t bestCost = UINT64_MAX;
+        int32_t best = 0;
+        for (int32_t k = 0; k < 30; k++) {
+            uint64_t cost = 0;
+            for (uint32_t i = 0; i < count; i++) {
+                cost += (zigZag(residual[index + i]) >> k) + k + 1;
+            }
+            if (cost < bestCost) {
+                bestCost = cost;
+                best = k;
+            }
+        }
+        parameters.push_back(best);
+        wide = wide || best >= 15;
+        index += count;
+    }
+
+    const int32_t parameterBits = wide ? 5 : 4;
+    writer.write(wide ? 1 : 0, 2);
+    writer.write(static_cast<uint64_t>(partitionOrder), 4);
+    for (uint32_t p = 0, index = 0; p < (1u << partitionOrder); p++) {
+        uint32_t count = p == 0 ? partitionSize - order : partitionSize;
+        if (p == 0 && escapeFirst) {
+            int32_t bits = 1;
+            for (uint32_t i = 0; i < count; i++) {
+                int64_t value = residual[index + i];
+                while (value < -(int64_t{1} << (bits - 1)) || value >= (int64_t{1} << (bits - 1))) {
+                    bits++;
+                }
+            }
+            writer.write((1u << parameterBits) - 1, parameterBits);
+            writer.write(static_cast<uint64_t>(bits), 5);
+            for (uint32_t i = 0; i < count; i++) {
+                writer.writeSigned(residual[index + i], bits);
+            }
+        } else {
+            int32_t k = parameters[p];
+            writer.write(static_cast<uint64_t>(k), parameterBits);
+            for (uint32_t i = 0; i < count; i++) {
+                uint64_t value = zigZag(residual[index + i]);
+                writer.writeUnary(value >> k);
+                writer.write(value & ((uint64_t{1} << k) - 1), k);
+            }
+        }
+        index += count;
+    }
+}
+
+// Levinson-Durbin on the plain autocorrelation, then coefficients quantized to precision bits with a shift
+void computeLpc(const std::vector<int64_t>& x, int32_t order, int32_t precision, std::vector<int32_t>* quantized,
+                int32_t* shift) {
+    std::vector<double> autocorrelation(static_cast<size_t>(order) + 1, 0.0);
+    for (int32_t lag = 0; lag <= order; lag++) {
+        for (size_t i = static_cast<size_t>(lag); i < x.size(); i++) {
+            autocorrelation[lag] += static_cast<double>(x[i]) * static_cast<double>(x[i - lag]);
+        }
+    }
+    std::vector<double> coefficients(static_cast<size_t>(order), 0.0);
+    double error = autocorrelation[0] * (1.0 + 1e-9);
+    for (int32_t i = 0; i < order && error > 0.0; i++) {
+        double accumulator = autocorrelation[i + 1];
+        for (int32_t j = 0; j < i; j++) {
+            accumulator -= coefficients[j] * autocorrelation[i - j];
+        }
+        double reflection = accumulator / error;
+        std::vector<double> previous = coefficients;
+        coefficients[i] = reflection;
+        for (int32_t j = 0; j < i; j++) {
+            coefficients[j] = previous[j] - reflection * previous[i - 1 - j];
+        }
+        error *= 1.0 - reflection * reflection;
+    }
+
+    double largest = 0.0;
+    for (double coefficient : coefficients) {
+        largest = std::max(largest, std::fabs(coefficient));
+    }
+    int exponent = 0;
+    std::frexp(largest, &exponent);
+    *shift = largest > 0.0 ? std::min(15, std::max(0, precision - 1 - exponent)) : 0;
+    const int32_t limit = (1 << (precision - 1)) - 1;
+    quantized->clear();
+    for (double coefficient : coefficients) {
+        auto value = static_cast<int32_t>(std::lround(std::ldexp(coefficient, *shift)));
+        quantized->push_back(std::min(limit, std::max(-limit - 1, value)));
+    }
+}
+
+void writeSubframe(BitWriter& writer, std::vector<int64_t> x, int32_t bits, Mode mode, int32_t partitionOrder,
+                   const StreamLayout& layout) {
+    const auto blockSize = static_cast<uint32_t>(x.size());
+    bool constant = std::all_of(x.begin(), x.end(), [&x](int64_t value) { return value == x[0]; });
+    if (constant && mode != Mode::Verbatim) {
+        writer.write(0, 8);
+        writer.writeSigned(x[0], bits);
+        return;
+    }
+
+    // Wasted bits: trailing zeros shared by every sample
+    int32_t wasted = 0;
+    if (mode != Mode::Verbatim) {
+        int64_t combined = 0;
+        for (int64_t value : x) {
+            combined |= value;
+        }
+        while (combined != 0 && ((combined >> wasted) & 1) == 0 && wasted < bits - 1) {
+            wasted++;
+        }
+        for (int64_t& value : x) {
+            value >>= wasted;
+        }
+        bits -= wasted;
+    }
+    auto writeHeader = [&writer, wasted](uint32_t type) {
+        writer.write(type, 7);
+        writer.write(wasted > 0 ? 1 : 0, 1);
+        if (wasted > 0) {
+            writer.writeUnary(static_cast<uint64_t>(wasted - 1));
+        }
+    };
+
+    if (mode == Mode::Verbatim) {
+        writeHeader(1);
+        for (int64_t value : x) {
+            writer.writeSigned(value, bits);
+        }
+        return;
+    }
+
+    std::vector<int64_t> residual;
+    if (mode == Mode::Lpc) {
+        int32_t order = std::min<int32_t>(layout.lpcOrder, static_cast<int32_t>(blockSize));
+        std::vector<int32_t> coefficients;
+        int32_t shift = 0;
+        computeLpc(x, order, layout.lpcPrecision, &coefficients, &shift);
+        writeHeader(32 + static_cast<uint32_t>(order) - 1);
+        for (int32_t i = 0; i < order; i++) {
+            writer.writeSigned(x[i], bits);
+        }
+        writer.write(static_cast<uint64_t>(layout.lpcPrecision - 1), 4);
+        writer.writeSigned(shift, 5);
+        for (int32_t coefficient : coefficients) {
+            writer.writeSigned(coefficient, layout.lpcPrecision);
+        }
+        for (uint32_t i = static_cast<uint32_t>(order); i < blockSize; i++) {
+            int64_t sum = 0;
+            for (int32_t j = 0; j < order; j++) {
+                sum += static_cast<int64_t>(coefficients[j]) * x[i - 1 - j];
+            }
+            residual.push_back(x[i] - (sum >> shift));
+        }
+        writeResidual(writer, residual, order, blockSize, partitionOrder, false);
+        return;
+    }
+
+    int32_t order = std::min<int32_t>(static_cast<int32_t>(mode) - static_cast<int32_t>(Mode::Fixed0),
+                                      static_cast<int32_t>(blockSize));
+    writeHeader(8 + static_cast<uint32_t>(order));
+    for (int32_t i = 0; i < order; i++) {
+        writer.writeSigned(x[i], bits);
+    }
+    for (uint32_t i = static_cast<uint32_t>(order); i < blockSize; i++) {
+        int64_t prediction = 0;
+        switch (order) {
+        case 1:
+            prediction = x[i - 1];
+            break;
+        case 2:
+            prediction = 2 * x[i - 1] - x[i - 2];
+            break;
+        case 3:
+            prediction = 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+            break;
+        case 4:
+            prediction = 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+            break;
+        default:
+            break;
+        }
+        residual.push_back(x[i] - prediction);
+    }
+    writeResidual(writer, residual, order, blockSize, partitionOrder, mode == Mode::Fixed3);
+}
+
+// Block size codes of the frame header, 0 where the size is stored after the header
+int32_t getBlockSizeCode(uint32_t blockSize) {
+    static const uint32_t kSizes[][2] = {{192, 1},   {576, 2},   {1152, 3},  {2304, 4},  {4608, 5},
+                                         {256, 8},   {512, 9},   {1024, 10}, {2048, 11}, {4096, 12},
+                                         {8192, 13}, {16384, 14}, {32768, 15}};
+    for (const auto& size : kSizes) {
+        if (size[0] == blockSize) {
+            return static_cast<int32_t>(size[1]);
+        }
+    }
+    return 0;
+}
+
+int32_t getSampleSizeCode(int32_t bitsPerSample) {
+    switch (bitsPerSample) {
+    case 8:
+        return 1;
+    case 12:
+        return 2;
+    case 16:
+        return 4;
+    case 20:
+        return 5;
+    case 24:
+        return 6;
+    default:
+        return 0; // From STREAMINFO
+    }
+}
+
+/**
+ * Encode one frame, cycling subframe modes, stereo modes, partition orders and header fields by frame index
+ * @param channels Planar samples of the block
+ */
+std::vector<uint8_t> encodeFrame(const StreamLayout& layout, uint32_t index, uint64_t firstSample,
+                                 const std::vector<std::vector<int64_t>>& channels) {
+    const auto blockSize = static_cast<uint32_t>(channels[0].size());
+    const bool variable = layout.blockSizes.size() > 1;
+    const Stereo stereo = layout.channelCount == 2 ? static_cast<Stereo>(index % 4) : Stereo::Independent;
+    const Mode mode = layout.modes[index % layout.modes.size()];
+    // Every fifth frame of a whole-kHz rate repeats the rate in the header
+    const bool rateInHeader = index % 5 == 4 && layout.sampleRate % 1000 == 0 && layout.sampleRate / 1000 < 256;
+
+    std::vector<uint8_t> frame = {0xFF, static_cast<uint8_t>(variable ? 0xF9 : 0xF8)};
+    int32_t blockSizeCode = getBlockSizeCode(blockSize);
+    if (blockSizeCode == 0) {
+        blockSizeCode = blockSize <= 256 ? 6 : 7;
+    }
+    frame.push_back(static_cast<uint8_t>(blockSizeCode << 4 | (rateInHeader ? 12 : 0)));
+    int32_t assignment = stereo == Stereo::Independent ? layout.channelCount - 1 : 7 + static_cast<int32_t>(stereo);
+    frame.push_back(static_cast<uint8_t>(assignment << 4 | getSampleSizeCode(layout.bitsPerSample) << 1));
+    writeUtf8Number(&frame, variable ? firstSample : index);
+    if (blockSizeCode == 6) {
+        frame.push_back(static_cast<uint8_t>(blockSize - 1));
+    } else if (blockSizeCode == 7) {
+        frame.push_back(static_cast<uint8_t>((blockSize - 1) >> 8));
+        frame.push_back(static_cast<uint8_t>(blockSize - 1));
+    }
+    if (rateInHeader) {
+        frame.push_back(static_cast<uint8_t>(layout.sampleRate / 1000));
+    }
+    frame.push_back(crc8(frame.data(), frame.size()));
+
+    BitWriter writer(&frame);
+    const int32_t bits = layout.bitsPerSample;
+    const int32_t partitionOrder = index % 3 == 0 ? 0 : 4;
+    if (stereo == Stereo::Independent) {
+        for (const std::vector<int64_t>& channel : channels) {
+            writeSubframe(writer, channel, bits, mode, partitionOrder, layout);
+        }
+    } else {
+        const std::vector<int64_t>& left = channels[0];
+        const std::vector<int64_t>& right = channels[1];
+        std::vector<int64_t> side(blockSize);
+        std::vector<int64_t> mid(blockSize);
+        for (uint32_t i = 0; i < blockSize; i++) {
+            side[i] = left[i] - right[i];
+            mid[i] = (left[i] + right[i]) >> 1;
+        }
+        // The side channel needs one bit more
+        if (stereo == Stereo::LeftSide) {
+            writeSubframe(writer, left, bits, mode, partitionOrder, layout);
+            writeSubframe(writer, side, bits + 1, mode, partitionOrder, layout);
+        } else if (stereo == Stereo::SideRight) {
+            writeSubframe(writer, side, bits + 1, mode, partitionOrder, layout);
+            writeSubframe(writer, right, bits, mode, partitionOrder, layout);
+        } else {
+            writeSubframe(writer, mid, bits, mode, partitionOrder, layout);
+            writeSubframe(writer, side, bits + 1, mode, partitionOrder, layout);
+        }
+    }
+    writer.align();
+    uint16_t crc = crc16(frame.data(), frame.size());
+    frame.push_back(static_cast<uint8_t>(crc >> 8));
+    frame.push_back(static_cast<uint8_t>(crc));
+    return frame;
+}
+
+void putBigEndian(std::vector<uint8_t>* out, uint64_t value, int32_t bytes) {
+    for (int32_t i = bytes - 1; i >= 0; i--) {
+        out->push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+/**
+ * Write a FLAC file of interleaved samples
+ * @param corruptFrame Index of a frame to damage after its CRC was computed, -1 for none
+ * @param frameStarts Receives the first sample of each frame
+ */
+bool writeFlac(const std::string& path, const StreamLayout& layout, const std::vector<int32_t>& samples,
+               int32_t corruptFrame, std::vector<uint64_t>* frameStarts) {
+    const uint64_t totalSamples = samples.size() / static_cast<size_t>(layout.channelCount);
+    std::vector<std::vector<uint8_t>> frames;
+    frameStarts->clear();
+    uint32_t minBlock = UINT32_MAX;
+    uint32_t maxBlock = 0;
+    for (uint64_t position = 0; position < totalSamples;) {
+        auto index = static_cast<uint32_t>(frames.size());
+        uint32_t blockSize = layout.blockSizes[index % layout.blockSizes.size()];
+        blockSize = static_cast<uint32_t>(std::min<uint64_t>(blockSize, totalSamples - position));
+        std::vector<std::vector<int64_t>> channels(static_cast<size_t>(layout.channelCount));
+        for (int32_t c = 0; c < layout.channelCount; c++) {
+            for (uint32_t i = 0; i < blockSize; i++) {
+                channels[c].push_back(samples[(position + i) * layout.channelCount + c]);
+            }
+        }
+        frames.push_back(encodeFrame(layout, index, position, channels));
+        if (static_cast<int32_t>(index) == corruptFrame) {
+            frames.back()[frames.back().size() / 2] ^= 0x55;
+        }
+        frameStarts->push_back(position);
+        minBlock = std::min(minBlock, layout.blockSizes[index % layout.blockSizes.size()]);
+        maxBlock = std::max(maxBlock, layout.blockSizes[index % layout.blockSizes.size()]);
+        position += blockSize;
+    }
+
+    std::vector<uint8_t> file = {'f', 'L', 'a', 'C'};
+    std::vector<std::pair<uint8_t, std::vector<uint8_t>>> blocks;
+    std::vector<uint8_t> streamInfo;
+    putBigEndian(&streamInfo, minBlock, 2);
+    putBigEndian(&streamInfo, maxBlock, 2);
+    putBigEndian(&streamInfo, 0, 6); // Frame sizes unknown
+    putBigEndian(&streamInfo,
+                 static_cast<uint64_t>(layout.sampleRate) << 44 | static_cast<uint64_t>(layout.channelCount - 1) << 41 |
+                     static_cast<uint64_t>(layout.bitsPerSample - 1) << 36 | totalSamples,
+                 8);
+    streamInfo.resize(streamInfo.size() + 16, 0); // No MD5
+    blocks.emplace_back(0, streamInfo);
+    if (layout.seekInterval > 0) {
+        std::vector<uint8_t> seekTable;
+        uint64_t offset = 0;
+        uint64_t nextPoint = 0;
+        for (size_t i = 0; i < frames.size(); i++) {
+            if ((*frameStarts)[i] >= nextPoint) {
+                putBigEndian(&seekTable, (*frameStarts)[i], 8);
+                putBigEndian(&seekTable, offset, 8);
+                putBigEndian(&seekTable, std::min<uint64_t>(layout.blockSizes[0], totalSamples - (*frameStarts)[i]), 2);
+                nextPoint = (*frameStarts)[i] + layout.seekInterval;
+            }
+            offset += frames[i].size();
+        }
+        putBigEndian(&seekTable, UINT64_MAX, 8); // Placeholder point
+        putBigEndian(&seekTable, 0, 10);
+        blocks.emplace_back(3, seekTable);
+    }
+    blocks.emplace_back(4, std::vector<uint8_t>{8, 0, 0, 0, 'f', 'l', 'a', 'c', 'c', 'h', 'k', ' ', 0, 0, 0, 0});
+    for (size_t i = 0; i < blocks.size(); i++) {
+        file.push_back(static_cast<uint8_t>((i + 1 == blocks.size() ? 0x80 : 0) | blocks[i].first));
+        putBigEndian(&file, blocks[i].second.size(), 3);
+        file.insert(file.end(), blocks[i].second.begin(), blocks[i].second.end());
+    }
+    for (const std::vector<uint8_t>& frame : frames) {
+        file.insert(file.end(), frame.begin(), frame.end());
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(file.data()), static_cast<std::streamsize>(file.size()));
+    return out.good();
+}
+
+/**
+ * Interleaved test signal: tones with a little noise, with stretches of digital silence (constant subframes)
+ * and of samples sharing trailing zero bits (wasted bits); or full-scale noise
+ */
+std::vector<int32_t> makeSignal(const StreamLayout& layout, uint64_t frames, uint64_t seed) {
+    Random random(seed);
+    const int64_t high = (int64_t{1} << (layout.bitsPerSample - 1)) - 1;
+    std::vector<int32_t> samples;
+    samples.reserve(frames * layout.channelCount);
+    for (uint64_t i = 0; i < frames; i++) {
+        for (int32_t c = 0; c < layout.channelCount; c++) {
+            int64_t value = 0;
+            if (layout.noise) {
+                value = random.range(-high - 1, high);
+            } else {
+                double t = static_cast<double>(i) / layout.sampleRate;
+                double v = 0.5 * std::sin(2.0 * M_PI * 440.0 * (c + 1) * t) +
+                           0.2 * std::sin(2.0 * M_PI * 97.0 * t + c) +
+                           0.05 * (static_cast<double>(random.next() >> 11) / 9007199254740992.0 - 0.5);
+                value = static_cast<int64_t>(v * static_cast<double>(high));
+                uint64_t segment = (i / 5000) % 4;
+                if (segment == 2) {
+                    value = 0;
+                } else if (segment == 3) {
+                    value = value / 8 * 8;
+                }
+            }
+            samples.push_back(static_cast<int32_t>(std::min(high, std::max(-high - 1, value))));
+        }
+    }
+    return samples;
+}
+
+// Expected decoder output: each sample left-aligned in the smallest container, 8-bit as offset binary
+std::vector<uint8_t> toContainer(const StreamLayout& layout, const std::vector<int32_t>& samples) {
+    const int32_t containerBits = layout.bitsPerSample <= 8 ? 8 : layout.bitsPerSample <= 16 ? 16 : 24;
+    const int32_t shift = containerBits - layout.bitsPerSample;
+    std::vector<uint8_t> pcm;
+    for (int32_t sample : samples) {
+        auto value = static_cast<uint32_t>(sample) << shift;
+        if (containerBits == 8) {
+            pcm.push_back(static_cast<uint8_t>(value + 128));
+            continue;
+        }
+        for (int32_t byte = 0; byte < containerBits / 8; byte++) {
+            pcm.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+        }
+    }
+    return pcm;
+}
+
+// Read from the current position to the end in odd-sized pieces
+std::vector<uint8_t> readToEnd(FlacFile& file) {
+    std::vector<uint8_t> pcm;
+    uint8_t buffer[3001];
+    for (size_t count; (count = file.readAudioData(buffer, sizeof(buffer))) > 0;) {
+        pcm.insert(pcm.end(), buffer, buffer + count);
+    }
+    return pcm;
+}
+
+const std::vector<Mode> kAllModes = {Mode::Lpc,    Mode::Fixed2, Mode::Fixed1, Mode::Verbatim,
+                                     Mode::Fixed4, Mode::Fixed3, Mode::Fixed0};
+
+const StreamLayout kLayouts[] = {
+    {"44k1 2ch 16-bit", 44100, 2, 16, {4096}, kAllModes, 8, 12, false, 44100},
+    {"48k 1ch 8-bit", 48000, 1, 8, {1152}, kAllModes, 8, 12, false, 0},
+    {"96k 2ch 24-bit lpc32", 96000, 2, 24, {4608}, {Mode::Lpc, Mode::Fixed2}, 32, 15, false, 48000},
+    {"44k1 6ch 20-bit", 44100, 6, 20, {576}, kAllModes, 12, 13, false, 0},
+    {"32k 8ch 12-bit", 32000, 8, 12, {192}, kAllModes, 4, 10, false, 0},
+    {"48k 2ch 16-bit noise", 48000, 2, 16, {256}, {Mode::Verbatim, Mode::Fixed3, Mode::Lpc}, 8, 12, true, 0},
+    {"48k 2ch 16-bit variable", 48000, 2, 16, {1000, 4096, 17, 2300}, kAllModes, 8, 12, false, 0},
+};
+
+void checkLayout(const StreamLayout& layout, const std::string& dir) {
+    const char* name = layout.name;
+    const uint64_t frames = 30011; // A short last block
+    std::vector<int32_t> samples = makeSignal(layout, frames, 11);
+    std::vector<uint8_t> expected = toContainer(layout, samples);
+    const std::string path = dir + "/check.flac";
+    std::vector<uint64_t> frameStarts;
+    if (!expect(writeFlac(path, layout, samples, -1, &frameStarts), name, "cannot write the test file")) {
+        return;
+    }
+
+    FlacFile file;
+    if (!expect(file.open(path), name, "does not open") ||
+        !expect(file.getSampleRate() == layout.sampleRate && file.getChannelCount() == layout.channelCount &&
+                    file.getDataSize() == expected.size(),
+                name, "stream parameters differ")) {
+        return;
+    }
+    const auto bytesPerFrame = static_cast<uint64_t>(file.getBytesPerFrame());
+    if (!expect(readToEnd(file) == expected, name, "decoded PCM differs from the source") ||
+        !expect(file.getCorruptFrameCount() == 0, name, "frames reported corrupt")) {
+        unlink(path.c_str());
+        return;
+    }
+
+    // Seeks land on the exact sample, inside blocks and on their edges
+    Random random(5);
+    for (int32_t seek = 0; seek < 12; seek++) {
+        uint64_t frame = seek % 3 == 0 ? frameStarts[random.next() % frameStarts.size()] : random.next() % frames;
+        if (!expect(file.seekAudioData(frame * bytesPerFrame), name, "seek failed") ||
+            !expect(file.getDataPosition() == frame * bytesPerFrame, name, "position after seek is off")) {
+            break;
+        }
+        std::vector<uint8_t> piece(std::min<uint64_t>(5000, expected.size() - frame * bytesPerFrame));
+        size_t count = file.readAudioData(piece.data(), piece.size());
+        if (!expect(count == piece.size() &&
+                        std::equal(piece.begin(), piece.end(), expected.begin() + frame * bytesPerFrame),
+                    name, "decoded PCM after a seek differs")) {
+            break;
+        }
+    }
+    unlink(path.c_str());
+    printf("%s: ok (%zu frames)\n", name, frameStarts.size());
+}
+
+// A damaged frame fails its CRC and becomes silence of the same length, the frames around it stay exact
+void checkCorruption(const std::string& dir) {
+    const StreamLayout& layout = kLayouts[0];
+    const char* name = "corrupt frame";
+    std::vector<int32_t> samples = makeSignal(layout, 30000, 12);
+    std::vector<uint64_t> frameStarts;
+    const std::string path = dir + "/corrupt.flac";
+    const int32_t damaged = 3;
+    if (!expect(writeFlac(path, layout, samples, damaged, &frameStarts), name, "cannot write the test file")) {
+        return;
+    }
+    for (uint64_t i = frameStarts[damaged]; i < frameStarts[damaged + 1]; i++) {
+        for (int32_t c = 0; c < layout.channelCount; c++) {
+            samples[i * layout.channelCount + c] = 0;
+        }
+    }
+    FlacFile file;
+    if (expect(file.open(path), name, "does not open") &&
+        expect(readToEnd(file) == toContainer(layout, samples), name, "frames around the damage differ") &&
+        expect(file.getCorruptFrameCount() == 1, name, "damaged frame not counted")) {
+        printf("%s: ok\n", name);
+    }
+    unlink(path.c_str());
+}
+
+// Decoded on the reader thread with decode-ahead sized from a callback burst, as the engine plays it
+void checkPrefetch(const std::string& dir) {
+    const StreamLayout& layout = kLayouts[0];
+    const char* name = "prefetch reader";
+    std::vector<int32_t> samples = makeSignal(layout, 60000, 13);
+    std::vector<uint8_t> expected = toContainer(layout, samples);
+    std::vector<uint64_t> frameStarts;
+    const std::string path = dir + "/prefetch.flac";
+    if (!expect(writeFlac(path, layout, samples, -1, &frameStarts), name, "cannot write the test file")) {
+        return;
+    }
+    FlacFile file;
+    if (!expect(file.open(path), name, "does not open")) {
+        unlink(path.c_str());
+        return;
+    }
+    const auto frameBytes = static_cast<size_t>(file.getBytesPerFrame());
+    const size_t burstBytes = 192 * frameBytes;
+    PrefetchReader::Config config = PrefetchReader::makeConfig(44100 * file.getBytesPerFrame(), frameBytes, 50, 50, 90);
+    config.pollIntervalMs = 1;
+    PrefetchReader reader;
+    reader.setConsumerBurst(burstBytes);
+    if (!expect(reader.start(&file, config), name, "reader did not start")) {
+        unlink(path.c_str());
+        return;
+    }
+    std::vector<uint8_t> pcm;
+    std::vector<uint8_t> buffer(burstBytes);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!reader.isEndOfStream() && std::chrono::steady_clock::now() < deadline) {
+        size_t count = reader.read(buffer.data(), buffer.size());
+        pcm.insert(pcm.end(), buffer.begin(), buffer.begin() + count);
+        if (count < buffer.size()) {
+            usleep(200);
+        }
+    }
+    reader.stop();
+    if (expect(pcm == expected, name, "PCM through the reader differs from the source")) {
+        printf("%s: ok\n", name);
+    }
+    unlink(path.c_str());
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Five seconds of stereo music-like audio, LPC order 8 and 4096-sample blocks, decoded as a player would
+void measureThroughput(const std::string& dir, int32_t passes) {
+    for (int32_t bits : {16, 24}) {
+        StreamLayout layout = {"", 44100, 2, bits, {4096}, {Mode::Lpc}, 8, 14, false, 44100};
+        const uint64_t frames = 5 * 44100;
+        std::vector<int32_t> samples = makeSignal(layout, frames, 14);
+        std::vector<uint64_t> frameStarts;
+        const std::string path = dir + "/throughput.flac";
+        if (!writeFlac(path, layout, samples, -1, &frameStarts)) {
+            continue;
+        }
+        uint64_t bestNs = UINT64_MAX;
+        for (int32_t pass = 0; pass < passes; pass++) {
+            FlacFile file;
+            uint64_t beginNs = nowNs();
+            if (!file.open(path)) {
+                break;
+            }
+            uint8_t buffer[4096 * 6];
+            while (file.readAudioData(buffer, sizeof(buffer)) > 0) {
+            }
+            bestNs = std::min(bestNs, nowNs() - beginNs);
+        }
+        double realtime = 5.0 * 1e9 / static_cast<double>(std::max<uint64_t>(bestNs, 1));
+        printf("%d-bit stereo decode: %.0fx realtime, %.3f%% of one core\n", bits, realtime, 100.0 / realtime);
+        unlink(path.c_str());
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Decode the throughput files more often, the best pass counts\n"
+            "  -v            Keep the decoder's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int32_t passes = 3;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            passes = 40;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // The corrupted frame is logged, as is every open
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/aaudioplayer-flac-XXXXXX";
+    std::vector<char> dirName(pattern.begin(), pattern.end());
+    dirName.push_back('\0');
+    if (!mkdtemp(dirName.data())) {
+        printf("flac_check: cannot create %s\n", pattern.c_str());
+        return 1;
+    }
+    const std::string dir = dirName.data();
+
+    for (const StreamLayout& layout : kLayouts) {
+        checkLayout(layout, dir);
+    }
+    checkCorruption(dir);
+    checkPrefetch(dir);
+    measureThroughput(dir, passes);
+    rmdir(dir.c_str());
+
+    if (failures > 0) {
+        printf("flac_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,823 @@
+#include "flac_file.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+constexpr size_t kInputPadding = 8;             // Zeros after the input, the bit reader loads 8 bytes at a time
+constexpr size_t kMinInputBytes = 64 * 1024;    // Smallest input window, also the bisection stop distance
+constexpr size_t kScanBytes = 4096;             // Input kept ahead while searching for a frame sync
+constexpr size_t kMaxFrameHeaderBytes = 16;     // Sync to CRC-8 with the longest coded number and fields
+constexpr int32_t kMaxLpcOrder = 32;
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+
+    CrcTables() {
+        for (int32_t i = 0; i < 256; i++) {
+            auto c8 = static_cast<uint8_t>(i);
+            auto c16 = static_cast<uint16_t>(i << 8);
+            for (int32_t bit = 0; bit < 8; bit++) {
+                c8 = static_cast<uint8_t>((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = static_cast<uint16_t>((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables& getCrcTables() {
+    static const CrcTables tables;
+    return tables;
+}
+
+uint8_t computeCrc8(const uint8_t* data, size_t size) {
+    const CrcTables& tables = getCrcTables();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = tables.crc8[crc ^ data[i]];
+    }
+    return crc;
+}
+
+uint16_t computeCrc16(const uint8_t* data, size_t size) {
+    const CrcTables& tables = getCrcTables();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < size; i++) {
+        crc = static_cast<uint16_t>((crc << 8) ^ tables.crc16[(crc >> 8) ^ data[i]]);
+    }
+    return crc;
+}
+
+uint64_t readBigEndian(const uint8_t* data, int32_t bytes) {
+    uint64_t value = 0;
+    for (int32_t i = 0; i < bytes; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/**
+ * MSB-first bit reader over a buffer followed by kInputPadding zero bytes
+ * Reads past the end return zeros and are reported by isOverrun().
+ */
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size), limit_(size * 8) {}
+
+    // Unsigned value of 0 to 32 bits
+    uint32_t read(int32_t bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        auto value = static_cast<uint32_t>(peek() >> (64 - bits));
+        position_ += static_cast<size_t>(bits);
+        return value;
+    }
+
+    // Two's complement value of 0 to 32 bits
+    int32_t readSigned(int32_t bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        auto value = static_cast<int32_t>(static_cast<int64_t>(peek()) >> (64 - bits));
+        position_ += static_cast<size_t>(bits);
+        return value;
+    }
+
+    // Number of zeros before the next one bit
+    uint32_t readUnary() {
+        uint32_t zeros = 0;
+        for (;;) {
+            uint64_t bits = peek();
+            if (bits != 0) {
+                auto lead = static_cast<uint32_t>(__builtin_clzll(bits));
+                position_ += lead + 1;
+                return zeros + lead;
+            }
+            // Only the bits loaded from the buffer are known zeros, the shifted-in tail is not
+            auto known = static_cast<uint32_t>(64 - (position_ & 7));
+            zeros += known;
+            position_ += known;
+            if (position_ > limit_) {
+                return 0;
+            }
+        }
+    }
+
+    // Rice code with zigzag-folded sign
+    int32_t readRice(int32_t parameter) {
+        uint32_t value = (readUnary() << parameter) | read(parameter);
+        return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+    }
+
+    void alignToByte() { position_ = (position_ + 7) & ~static_cast<size_t>(7); }
+    size_t getBytePosition() const { return position_ >> 3; }
+    bool isOverrun() const { return position_ > limit_; }
+
+private:
+    uint64_t peek() const {
+        // Past the end the position is clamped into the zero padding
+        size_t byte = std::min(position_ >> 3, size_);
+        uint64_t value;
+        memcpy(&value, data_ + byte, sizeof(value));
+        return __builtin_bswap64(value) << (position_ & 7);
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t limit_;
+    size_t position_ = 0;
+};
+
+bool decodeResidual(BitReader& reader, int32_t order, uint32_t blockSize, int32_t* output) {
+    uint32_t method = reader.read(2);
+    if (method > 1) {
+        return false;
+    }
+    int32_t parameterBits = method == 0 ? 4 : 5;
+    uint32_t escape = method == 0 ? 15 : 31;
+    uint32_t partitionOrder = reader.read(4);
+    uint32_t partitionSize = blockSize >> partitionOrder;
+    if ((partitionSize << partitionOrder) != blockSize || partitionSize < static_cast<uint32_t>(order)) {
+        return false;
+    }
+
+    int32_t* sample = output + order;
+    for (uint32_t partition = 0; partition < (1u << partitionOrder); partition++) {
+        uint32_t count = partition == 0 ? partitionSize - static_cast<uint32_t>(order) : partitionSize;
+        uint32_t parameter = reader.read(parameterBits);
+        if (parameter == escape) {
+            // Unencoded partition, fixed-width samples
+            auto bits = static_cast<int32_t>(reader.read(5));
+            for (uint32_t i = 0; i < count; i++) {
+                *sample++ = reader.readSigned(bits);
+            }
+        } else {
+            for (uint32_t i = 0; i < count; i++) {
+                *sample++ = reader.readRice(static_cast<int32_t>(parameter));
+            }
+        }
+        if (reader.isOverrun()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void restoreFixed(int32_t order, uint32_t blockSize, int32_t* x) {
+    switch (order) {
+    case 1:
+        for (uint32_t i = 1; i < blockSize; i++) {
+            x[i] += x[i - 1];
+        }
+        break;
+    case 2:
+        for (uint32_t i = 2; i < blockSize; i++) {
+            x[i] += 2 * x[i - 1] - x[i - 2];
+        }
+        break;
+    case 3:
+        for (uint32_t i = 3; i < blockSize; i++) {
+            x[i] += 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+        }
+        break;
+    case 4:
+        for (uint32_t i = 4; i < blockSize; i++) {
+            x[i] += 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void restoreLpc(const int32_t* coefficients, int32_t order, int32_t shift, uint32_t blockSize, int32_t* x) {
+    for (auto i = static_cast<uint32_t>(order); i < blockSize; i++) {
+        int64_t sum = 0;
+        const int32_t* history = x + i;
+        for (int32_t j = 0; j < order; j++) {
+            sum += static_cast<int64_t>(coefficients[j]) * history[-1 - j];
+        }
+        x[i] += static_cast<int32_t>(sum >> shift);
+    }
+}
+
+bool decodeSubframe(BitReader& reader, int32_t bits, uint32_t blockSize, int32_t* output) {
+    if (reader.read(1) != 0) {
+        return false; // Padding bit
+    }
+    uint32_t type = reader.read(6);
+    int32_t wasted = 0;
+    if (reader.read(1)) {
+        wasted = static_cast<int32_t>(reader.readUnary()) + 1;
+        bits -= wasted;
+        if (bits <= 0) {
+            return false;
+        }
+    }
+
+    if (type == 0) {
+        // Constant
+        std::fill(output, output + blockSize, reader.readSigned(bits));
+    } else if (type == 1) {
+        // Verbatim
+        for (uint32_t i = 0; i < blockSize; i++) {
+            output[i] = reader.readSigned(bits);
+        }
+    } else if (type >= 8 && type <= 12) {
+        // Fixed polynomial predictor
+        auto order = static_cast<int32_t>(type - 8);
+        if (static_cast<uint32_t>(order) > blockSize) {
+            return false;
+        }
+        for (int32_t i = 0; i < order; i++) {
+            output[i] = reader.readSigned(bits);
+        }
+        if (!decodeResidual(reader, order, blockSize, output)) {
+            return false;
+        }
+        restoreFixed(order, blockSize, output);
+    } else if (type >= 32) {
+        // Linear predictor with quantized coefficients
+        auto order = static_cast<int32_t>(type - 31);
+        if (static_cast<uint32_t>(order) > blockSize) {
+            return false;
+        }
+        for (int32_t i = 0; i < order; i++) {
+            output[i] = reader.readSigned(bits);
+        }
+        auto precision = static_cast<int32_t>(reader.read(4)) + 1;
+        int32_t shift = reader.readSigned(5);
+        if (precision == 16 || shift < 0) {
+            return false;
+        }
+        int32_t coefficients[kMaxLpcOrder];
+        for (int32_t i = 0; i < order; i++) {
+            coefficients[i] = reader.readSigned(precision);
+        }
+        if (!decodeResidual(reader, order, blockSize, output)) {
+            return false;
+        }
+        restoreLpc(coefficients, order, shift, blockSize, output);
+    } else {
+        return false; // Reserved
+    }
+
+    if (reader.isOverrun()) {
+        return false;
+    }
+    if (wasted > 0) {
+        for (uint32_t i = 0; i < blockSize; i++) {
+            output[i] = static_cast<int32_t>(static_cast<uint32_t>(output[i]) << wasted);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// ============================================================================
+// FlacFile Class Implementation
+// ============================================================================
+
+bool FlacFile::open(const std::string& filePath, IoMode /*ioMode*/) {
+    close(); // Ensure previous file is closed
+
+    file_.open(filePath, std::ios::binary);
+    if (!file_.is_open()) {
+        LOGE("Failed to open file: %s", filePath.c_str());
+        return false;
+    }
+    file_.seekg(0, std::ios::end);
+    fileSize_ = static_cast<uint64_t>(file_.tellg());
+    file_.seekg(0, std::ios::beg);
+
+    if (!readMetadata()) {
+        LOGE("Failed to read FLAC metadata from: %s", filePath.c_str());
+        close();
+        return false;
+    }
+
+    // Left-aligned in the smallest container, like a WAV file of that depth
+    int32_t containerBits = bitsPerSample_ <= 8 ? 8 : bitsPerSample_ <= 16 ? 16 : 24;
+    format_ = containerBits == 8 ? SampleFormat::U8 : containerBits == 16 ? SampleFormat::I16 : SampleFormat::I24Packed;
+    bytesPerFrame_ = channelCount_ * containerBits / 8;
+
+    inputCapacity_ = std::max(kMinInputBytes, maxFrameBytes_ * 2);
+    input_.reset(new uint8_t[inputCapacity_ + kInputPadding]);
+    samples_.reset(new int32_t[static_cast<size_t>(maxBlockSize_) * channelCount_]);
+    pcm_.reset(new uint8_t[getDecodeUnitBytes()]);
+
+    seekInput(firstFrameOffset_);
+    pcmSize_ = 0;
+    pcmPosition_ = 0;
+    pcmFirstSample_ = 0;
+    nextSample_ = 0;
+    dataPosition_ = 0;
+    corruptFrames_ = 0;
+
+    isOpen_ = true;
+    LOGI("Successfully opened FLAC file: %s (%zu seek points)", filePath.c_str(), seekTable_.size());
+    LOGI("Format: %s", getFormatInfo().c_str());
+    return true;
+}
+
+void FlacFile::close() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+    isOpen_ = false;
+    fileSize_ = 0;
+    firstFrameOffset_ = 0;
+    sampleRate_ = 0;
+    channelCount_ = 0;
+    bitsPerSample_ = 0;
+    minBlockSize_ = 0;
+    maxBlockSize_ = 0;
+    totalSamples_ = 0;
+    maxFrameBytes_ = 0;
+    seekTable_.clear();
+    format_ = SampleFormat::Unspecified;
+    bytesPerFrame_ = 0;
+    input_.reset();
+    samples_.reset();
+    pcm_.reset();
+    inputCapacity_ = 0;
+    inputPosition_ = 0;
+    inputEnd_ = 0;
+    pcmSize_ = 0;
+    pcmPosition_ = 0;
+    dataPosition_ = 0;
+}
+
+size_t FlacFile::readAudioData(void* buffer, size_t bufferSize) {
+    if (!isOpen_ || !buffer || bufferSize == 0) {
+        return 0;
+    }
+
+    auto output = static_cast<uint8_t*>(buffer);
+    uint64_t remaining = getDataSize() - std::min(dataPosition_, getDataSize());
+    auto wanted = static_cast<size_t>(std::min<uint64_t>(bufferSize, remaining));
+    size_t bytesRead = 0;
+    while (bytesRead < wanted) {
+        if (pcmPosition_ == pcmSize_ && !decodeFrame()) {
+            break;
+        }
+        size_t bytes = std::min(wanted - bytesRead, pcmSize_ - pcmPosition_);
+        memcpy(output + bytesRead, pcm_.get() + pcmPosition_, bytes);
+        pcmPosition_ += bytes;
+        bytesRead += bytes;
+    }
+    dataPosition_ += bytesRead;
+
+    if (bytesRead < bufferSize) {
+        // If insufficient data is decoded, fill remaining part with zeros
+        memset(output + bytesRead, 0, bufferSize - bytesRead);
+    }
+    return bytesRead;
+}
+
+bool FlacFile::seekAudioData(uint64_t offset) {
+    if (!isOpen_) {
+        return false;
+    }
+
+    uint64_t sample = std::min(offset / static_cast<uint64_t>(bytesPerFrame_), totalSamples_);
+    if (!seekToSample(sample)) {
+        LOGE("Failed to seek to sample %llu", static_cast<unsigned long long>(sample));
+        return false;
+    }
+    dataPosition_ = sample * static_cast<uint64_t>(bytesPerFrame_);
+    return true;
+}
+
+std::string FlacFile::getFormatInfo() const {
+    std::ostringstream oss;
+    oss << sampleRate_ << "Hz, " << channelCount_ << " channels, " << bitsPerSample_ << " bits, FLAC";
+    return oss.str();
+}
+
+bool FlacFile::readMetadata() {
+    char magic[4];
+    file_.read(magic, 4);
+    if (file_.gcount() == 4 && memcmp(magic, "ID3", 3) == 0) {
+        // ID3v2 tag in front of the stream: 10-byte header with a syncsafe size
+        uint8_t tag[6];
+        file_.read(reinterpret_cast<char*>(tag), 6);
+        uint32_t size = (tag[2] & 0x7Fu) << 21 | (tag[3] & 0x7Fu) << 14 | (tag[4] & 0x7Fu) << 7 | (tag[5] & 0x7Fu);
+        file_.seekg(10 + static_cast<std::streamoff>(size), std::ios::beg);
+        file_.read(magic, 4);
+    }
+    if (file_.gcount() != 4 || memcmp(magic, "fLaC", 4) != 0) {
+        LOGE("Invalid FLAC signature");
+        return false;
+    }
+
+    bool haveStreamInfo = false;
+    bool last = false;
+    while (!last) {
+        uint8_t blockHeader[4];
+        file_.read(reinterpret_cast<char*>(blockHeader), 4);
+        if (file_.gcount() != 4) {
+            LOGE("Truncated FLAC metadata");
+            return false;
+        }
+        last = (blockHeader[0] & 0x80) != 0;
+        uint32_t type = blockHeader[0] & 0x7F;
+        auto length = static_cast<uint32_t>(readBigEndian(blockHeader + 1, 3));
+
+        if (type == 0 || type == 3) {
+            std::vector<uint8_t> block(length);
+            file_.read(reinterpret_cast<char*>(block.data()), length);
+            if (static_cast<uint32_t>(file_.gcount()) != length) {
+                LOGE("Truncated FLAC metadata block %u", type);
+                return false;
+            }
+            if (type == 0) {
+                if (length < 34 || !readStreamInfo(block.data())) {
+                    return false;
+                }
+                haveStreamInfo = true;
+            } else {
+                readSeekTable(block.data(), length);
+            }
+        } else if (type == 127) {
+            LOGE("Invalid FLAC metadata block type");
+            return false;
+        } else {
+            // Vorbis comments, pictures, padding, ...
+            file_.seekg(length, std::ios::cur);
+        }
+    }
+
+    if (!haveStreamInfo) {
+        LOGE("FLAC STREAMINFO missing");
+        return false;
+    }
+    firstFrameOffset_ = static_cast<uint64_t>(file_.tellg());
+    return firstFrameOffset_ < fileSize_;
+}
+
+bool FlacFile::readStreamInfo(const uint8_t* data) {
+    minBlockSize_ = static_cast<uint32_t>(readBigEndian(data, 2));
+    maxBlockSize_ = static_cast<uint32_t>(readBigEndian(data + 2, 2));
+    auto maxFrameSize = static_cast<size_t>(readBigEndian(data + 7, 3));
+    sampleRate_ = static_cast<int32_t>(readBigEndian(data + 10, 3) >> 4);
+    channelCount_ = ((data[12] >> 1) & 7) + 1;
+    bitsPerSample_ = (((data[12] & 1) << 4) | (data[13] >> 4)) + 1;
+    totalSamples_ = (static_cast<uint64_t>(data[13] & 0x0F) << 32) | readBigEndian(data + 14, 4);
+
+    if (sampleRate_ <= 0 || sampleRate_ > 192000 || bitsPerSample_ < 4 || bitsPerSample_ > 24 ||
+        maxBlockSize_ < 16 || minBlockSize_ > maxBlockSize_ || totalSamples_ == 0) {
+        LOGE("Unsupported FLAC stream: %dHz, %d channels, %d bits, blocks %u-%u, %llu samples", sampleRate_,
+             channelCount_, bitsPerSample_, minBlockSize_, maxBlockSize_,
+             static_cast<unsigned long long>(totalSamples_));
+        return false;
+    }
+
+    // Largest frame an encoder may write: the verbatim fallback with the side channel's extra bit
+    size_t verbatimBytes = (static_cast<size_t>(maxBlockSize_) * (bitsPerSample_ + 1) + 7) / 8 + 2;
+    maxFrameBytes_ = std::max(maxFrameSize, kMaxFrameHeaderBytes + channelCount_ * verbatimBytes + 2);
+    return true;
+}
+
+void FlacFile::readSeekTable(const uint8_t* data, uint32_t length) {
+    seekTable_.clear();
+    for (uint32_t offset = 0; offset + 18 <= length; offset += 18) {
+        SeekPoint point;
+        point.sample = readBigEndian(data + offset, 8);
+        point.offset = readBigEndian(data + offset + 8, 8);
+        if (point.sample != UINT64_MAX) { // Placeholder
+            seekTable_.push_back(point);
+        }
+    }
+}
+
+void FlacFile::seekInput(uint64_t fileOffset) {
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(fileOffset), std::ios::beg);
+    inputOffset_ = fileOffset;
+    inputPosition_ = 0;
+    inputEnd_ = 0;
+    inputEof_ = !file_;
+    memset(input_.get(), 0, kInputPadding);
+}
+
+// Make at least minimum bytes available from the input position, fewer only at the end of the file
+size_t FlacFile::fillInput(size_t minimum) {
+    size_t available = inputEnd_ - inputPosition_;
+    if (available >= minimum || inputEof_) {
+        return available;
+    }
+
+    // Keep the unread tail and read behind it, as much as fits
+    if (inputPosition_ > 0) {
+        memmove(input_.get(), input_.get() + inputPosition_, available);
+        inputOffset_ += inputPosition_;
+        inputPosition_ = 0;
+        inputEnd_ = available;
+    }
+    file_.read(reinterpret_cast<char*>(input_.get() + inputEnd_),
+               static_cast<std::streamsize>(inputCapacity_ - inputEnd_));
+    inputEnd_ += static_cast<size_t>(file_.gcount());
+    inputEof_ = inputEnd_ < inputCapacity_;
+    memset(input_.get() + inputEnd_, 0, kInputPadding);
+    return inputEnd_;
+}
+
+bool FlacFile::parseFrameHeader(const uint8_t* data, size_t size, FrameHeader* header) const {
+    if (size < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) {
+        return false;
+    }
+    bool variableBlockSize = (data[1] & 1) != 0;
+    uint32_t sizeCode = data[2] >> 4;
+    uint32_t rateCode = data[2] & 0x0F;
+    uint32_t channelCode = data[3] >> 4;
+    uint32_t depthCode = (data[3] >> 1) & 7;
+    if (sizeCode == 0 || rateCode == 15 || channelCode > 10 || depthCode == 3 || (data[3] & 1)) {
+        return false;
+    }
+
+    // Frame (fixed block size) or sample (variable) number, UTF-8 style coded
+    size_t position = 4;
+    uint64_t number = data[position++];
+    int32_t continuation;
+    if (number < 0x80) {
+        continuation = 0;
+    } else if (number >= 0xC0 && number < 0xFE) {
+        continuation = number >= 0xFC ? 5 : number >= 0xF8 ? 4 : number >= 0xF0 ? 3 : number >= 0xE0 ? 2 : 1;
+        number &= 0x3Fu >> continuation;
+    } else if (number == 0xFE) {
+        continuation = 6;
+        number = 0;
+    } else {
+        return false;
+    }
+    size_t fieldBytes = (sizeCode == 6 ? 1 : sizeCode == 7 ? 2 : 0) + (rateCode == 12 ? 1 : rateCode >= 13 ? 2 : 0);
+    if (position + continuation + fieldBytes + 1 > size) {
+        return false;
+    }
+    for (int32_t i = 0; i < continuation; i++) {
+        uint8_t byte = data[position++];
+        if ((byte & 0xC0) != 0x80) {
+            return false;
+        }
+        number = (number << 6) | (byte & 0x3F);
+    }
+
+    uint32_t blockSize;
+    if (sizeCode == 1) {
+        blockSize = 192;
+    } else if (sizeCode <= 5) {
+        blockSize = 576u << (sizeCode - 2);
+    } else if (sizeCode == 6) {
+        blockSize = data[position] + 1u;
+    } else if (sizeCode == 7) {
+        blockSize = static_cast<uint32_t>(readBigEndian(data + position, 2)) + 1;
+    } else {
+        blockSize = 256u << (sizeCode - 8);
+    }
+    position += fieldBytes; // Block size and sample rate fields, the rate is taken from STREAMINFO
+
+    if (computeCrc8(data, position) != data[position]) {
+        return false;
+    }
+
+    static const int32_t kDepths[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+    int32_t bitsPerSample = depthCode == 0 ? bitsPerSample_ : kDepths[depthCode];
+    int32_t channelCount = channelCode < 8 ? static_cast<int32_t>(channelCode) + 1 : 2;
+    uint64_t firstSample = variableBlockSize ? number : number * maxBlockSize_;
+    if (bitsPerSample != bitsPerSample_ || channelCount != channelCount_ || blockSize > maxBlockSize_ ||
+        firstSample >= totalSamples_) {
+        return false;
+    }
+
+    header->blockSize = blockSize;
+    header->channelAssignment = static_cast<int32_t>(channelCode);
+    header->bitsPerSample = bitsPerSample;
+    header->firstSample = firstSample;
+    header->headerBytes = position + 1;
+    return true;
+}
+
+// Advance the input to the next valid frame header before the file offset limit
+bool FlacFile::findFrame(uint64_t limit, FrameHeader* header) {
+    for (;;) {
+        size_t available = fillInput(kScanBytes);
+        uint64_t offset = getInputOffset();
+        if (available == 0 || offset >= limit) {
+            return false;
+        }
+
+        const uint8_t* data = input_.get() + inputPosition_;
+        size_t scanEnd = inputEof_ ? available : available - kMaxFrameHeaderBytes;
+        scanEnd = static_cast<size_t>(std::min<uint64_t>(scanEnd, limit - offset));
+        for (size_t i = 0; i < scanEnd; i++) {
+            if (data[i] == 0xFF && parseFrameHeader(data + i, available - i, header)) {
+                inputPosition_ += i;
+                return true;
+            }
+        }
+        inputPosition_ += scanEnd;
+    }
+}
+
+// Decode the frame at the input position into pcm_, returns false at the end of the stream
+bool FlacFile::decodeFrame() {
+    pcmSize_ = 0;
+    pcmPosition_ = 0;
+    if (nextSample_ >= totalSamples_) {
+        return false;
+    }
+
+    size_t available = fillInput(maxFrameBytes_);
+    if (available == 0) {
+        return false; // Truncated file
+    }
+    FrameHeader header;
+    if (!parseFrameHeader(input_.get() + inputPosition_, available, &header)) {
+        // Lost sync, continue at the next frame
+        corruptFrames_++;
+        LOGW("FLAC frame header invalid at offset %llu, resyncing", static_cast<unsigned long long>(getInputOffset()));
+        if (!findFrame(fileSize_, &header)) {
+            return false;
+        }
+        available = fillInput(maxFrameBytes_);
+    }
+
+    if (header.firstSample > nextSample_) {
+        // Frames were lost, keep the timeline with silence; the frame found is decoded next time
+        auto gap = static_cast<uint32_t>(std::min<uint64_t>(header.firstSample - nextSample_, maxBlockSize_));
+        pcmFirstSample_ = nextSample_;
+        writeSilence(gap);
+        nextSample_ += gap;
+        return true;
+    }
+
+    size_t frameBytes = 0;
+    pcmFirstSample_ = header.firstSample;
+    if (decodeFrameBody(input_.get() + inputPosition_, available, header, &frameBytes)) {
+        inputPosition_ += frameBytes;
+    } else {
+        corruptFrames_++;
+        LOGW("FLAC frame at sample %llu corrupt, replaced by silence",
+             static_cast<unsigned long long>(header.firstSample));
+        // Its length is unknown, continue at the next sync past the header
+        inputPosition_ += header.headerBytes;
+        FrameHeader next;
+        findFrame(fileSize_, &next);
+        writeSilence(header.blockSize);
+    }
+    nextSample_ = header.firstSample + header.blockSize;
+
+    // The last frame may be padded beyond the stream length
+    if (nextSample_ > totalSamples_) {
+        pcmSize_ = static_cast<size_t>(totalSamples_ - header.firstSample) * bytesPerFrame_;
+        nextSample_ = totalSamples_;
+    }
+    return true;
+}
+
+bool FlacFile::decodeFrameBody(const uint8_t* data, size_t size, const FrameHeader& header, size_t* frameBytes) {
+    BitReader reader(data + header.headerBytes, size - header.headerBytes);
+    uint32_t blockSize = header.blockSize;
+    int32_t assignment = header.channelAssignment;
+    int32_t* left = samples_.get();
+    int32_t* right = samples_.get() + maxBlockSize_;
+
+    for (int32_t channel = 0; channel < channelCount_; channel++) {
+        // The side channel carries one extra bit
+        bool side = (assignment == 8 && channel == 1) || (assignment == 9 && channel == 0) ||
+                    (assignment == 10 && channel == 1);
+        int32_t* output = samples_.get() + static_cast<size_t>(channel) * maxBlockSize_;
+        if (!decodeSubframe(reader, header.bitsPerSample + (side ? 1 : 0), blockSize, output)) {
+            return false;
+        }
+    }
+
+    reader.alignToByte();
+    uint32_t crc = reader.read(16);
+    if (reader.isOverrun()) {
+        return false;
+    }
+    *frameBytes = header.headerBytes + reader.getBytePosition();
+    if (computeCrc16(data, *frameBytes - 2) != crc) {
+        return false;
+    }
+
+    // Undo the stereo decorrelation
+    if (assignment == 8) {
+        for (uint32_t i = 0; i < blockSize; i++) {
+            right[i] = left[i] - right[i];
+        }
+    } else if (assignment == 9) {
+        for (uint32_t i = 0; i < blockSize; i++) {
+            left[i] += right[i];
+        }
+    } else if (assignment == 10) {
+        for (uint32_t i = 0; i < blockSize; i++) {
+            int32_t mid = static_cast<int32_t>(static_cast<uint32_t>(left[i]) << 1) | (right[i] & 1);
+            int32_t side = right[i];
+            left[i] = (mid + side) >> 1;
+            right[i] = (mid - side) >> 1;
+        }
+    }
+
+    writePcm(blockSize, 0);
+    return true;
+}
+
+// Interleave the decoded block into the output container
+void FlacFile::writePcm(uint32_t blockSize, int32_t shift) {
+    int32_t containerBits = getBytesPerSample(format_) * 8;
+    shift += containerBits - bitsPerSample_;
+    uint8_t* output = pcm_.get();
+    for (int32_t channel = 0; channel < channelCount_; channel++) {
+        const int32_t* input = samples_.get() + static_cast<size_t>(channel) * maxBlockSize_;
+        switch (format_) {
+        case SampleFormat::U8: {
+            uint8_t* sample = output + channel;
+            for (uint32_t i = 0; i < blockSize; i++, sample += bytesPerFrame_) {
+                *sample = static_cast<uint8_t>((input[i] << shift) + 128);
+            }
+            break;
+        }
+        case SampleFormat::I16: {
+            uint8_t* sample = output + channel * 2;
+            for (uint32_t i = 0; i < blockSize; i++, sample += bytesPerFrame_) {
+                auto value = static_cast<int16_t>(input[i] << shift);
+                memcpy(sample, &value, 2);
+            }
+            break;
+        }
+        default: {
+            uint8_t* sample = output + channel * 3;
+            for (uint32_t i = 0; i < blockSize; i++, sample += bytesPerFrame_) {
+                auto value = static_cast<uint32_t>(input[i]) << shift;
+                sample[0] = static_cast<uint8_t>(value);
+                sample[1] = static_cast<uint8_t>(value >> 8);
+                sample[2] = static_cast<uint8_t>(value >> 16);
+            }
+            break;
+        }
+        }
+    }
+    pcmSize_ = static_cast<size_t>(blockSize) * bytesPerFrame_;
+}
+
+void FlacFile::writeSilence(uint32_t blockSize) {
+    pcmSize_ = static_cast<size_t>(blockSize) * bytesPerFrame_;
+    memset(pcm_.get(), format_ == SampleFormat::U8 ? 0x80 : 0, pcmSize_);
+}
+
+bool FlacFile::seekToSample(uint64_t sample) {
+    pcmSize_ = 0;
+    pcmPosition_ = 0;
+    if (sample >= totalSamples_) {
+        nextSample_ = totalSamples_;
+        return true;
+    }
+
+    // The seek table, if any, bounds the search from below
+    uint64_t low = firstFrameOffset_;
+    for (const SeekPoint& point : seekTable_) {
+        if (point.sample <= sample && firstFrameOffset_ + point.offset < fileSize_) {
+            low = std::max(low, firstFrameOffset_ + point.offset);
+        }
+    }
+
+    // Bisect on frame syncs until the rest is short enough to decode through
+    uint64_t high = fileSize_;
+    while (high - low > inputCapacity_) {
+        uint64_t middle = low + (high - low) / 2;
+        seekInput(middle);
+        FrameHeader header;
+        if (!findFrame(high, &header) || header.firstSample > sample) {
+            high = middle;
+            continue;
+        }
+        low = getInputOffset();
+        if (header.firstSample + header.blockSize > sample) {
+            break;
+        }
+    }
+
+    seekInput(low);
+    FrameHeader header;
+    if (!findFrame(fileSize_, &header)) {
+        return false;
+    }
+    nextSample_ = header.firstSample;
+    while (decodeFrame()) {
+        if (nextSample_ > sample) {
+            pcmPosition_ = static_cast<size_t>(sample - pcmFirstSample_) * bytesPerFrame_;
+            return true;
+        }
+    }
+    return false;
+}
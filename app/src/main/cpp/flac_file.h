@@ -0,0 +1,154 @@
+#ifndef FLAC_FILE_H
+#define FLAC_FILE_H
+
+#include "audio_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * FLAC file decoder
+ *
+ * Self-contained, reads the native FLAC container: STREAMINFO and SEEKTABLE
+ * metadata, fixed and LPC predictors with partitioned Rice residuals, all
+ * stereo decorrelation modes and wasted bits. Every frame is checked against
+ * its CRC-16; a damaged frame is replaced by silence of the same length so
+ * the timeline stays intact, and decoding resumes at the next frame sync.
+ *
+ * Decoded frames are served as PCM in the smallest container holding the
+ * stream's bit depth (U8, I16 or I24Packed, left-aligned), so everything
+ * downstream treats it like a WAV file. Decoding happens inside
+ * readAudioData(), which is why it is meant to run on a reader thread; see
+ * getDecodeUnitBytes() for the read-ahead it needs.
+ *
+ * Streams with more than 24 bits, more than 8 channels or an unknown total
+ * length are not supported.
+ */
+class FlacFile : public AudioFile {
+public:
+    FlacFile() = default;
+
+    /**
+     * Destructor
+     */
+    ~FlacFile() noexcept override { close(); }
+
+    // Disable copy and assignment
+    FlacFile(const FlacFile&) = delete;
+    FlacFile& operator=(const FlacFile&) = delete;
+
+    /**
+     * Open FLAC file and read its metadata
+     * @param filePath File path
+     * @param ioMode Ignored, compressed data is always read into the decoder
+     * @return Returns true on success, false on failure
+     */
+    bool open(const std::string& filePath, IoMode ioMode = IoMode::Stream) override;
+
+    void close() override;
+
+    bool isOpen() const override { return isOpen_; }
+
+    /**
+     * Decode PCM data, same contract as WaveFile::readAudioData()
+     */
+    size_t readAudioData(void* buffer, size_t bufferSize) override;
+
+    /**
+     * Move the decoder to a sample, found through the seek table and a bisection on frame syncs
+     * @param offset Byte offset within the decoded PCM data, rounded down to a whole frame
+     */
+    bool seekAudioData(uint64_t offset) override;
+
+    uint64_t getDataPosition() const override { return dataPosition_; }
+    uint64_t getDataSize() const override { return totalSamples_ * static_cast<uint64_t>(bytesPerFrame_); }
+
+    int32_t getSampleRate() const override { return sampleRate_; }
+    int32_t getChannelCount() const override { return channelCount_; }
+    int32_t getBytesPerFrame() const override { return bytesPerFrame_; }
+    SampleFormat getSampleFormat() const override { return format_; }
+    std::string getFormatInfo() const override;
+
+    /**
+     * Get the PCM size of the largest block, decoded in one go
+     */
+    size_t getDecodeUnitBytes() const override {
+        return static_cast<size_t>(maxBlockSize_) * static_cast<size_t>(bytesPerFrame_);
+    }
+
+    /**
+     * Get the number of frames that failed their CRC or could not be parsed
+     */
+    uint64_t getCorruptFrameCount() const { return corruptFrames_; }
+
+private:
+    struct FrameHeader {
+        uint32_t blockSize = 0;
+        int32_t channelAssignment = 0; // 0-7 independent, 8 left/side, 9 side/right, 10 mid/side
+        int32_t bitsPerSample = 0;
+        uint64_t firstSample = 0;
+        size_t headerBytes = 0;
+    };
+
+    struct SeekPoint {
+        uint64_t sample = 0;
+        uint64_t offset = 0; // From the first frame
+    };
+
+    bool readMetadata();
+    bool readStreamInfo(const uint8_t* data);
+    void readSeekTable(const uint8_t* data, uint32_t length);
+
+    // Compressed input window over the file
+    void seekInput(uint64_t fileOffset);
+    size_t fillInput(size_t minimum);
+    uint64_t getInputOffset() const { return inputOffset_ + inputPosition_; }
+
+    bool parseFrameHeader(const uint8_t* data, size_t size, FrameHeader* header) const;
+    bool findFrame(uint64_t limit, FrameHeader* header);
+    bool decodeFrame();
+    bool decodeFrameBody(const uint8_t* data, size_t size, const FrameHeader& header, size_t* frameBytes);
+    void writePcm(uint32_t blockSize, int32_t shift);
+    void writeSilence(uint32_t blockSize);
+    bool seekToSample(uint64_t sample);
+
+    std::ifstream file_;
+    bool isOpen_ = false;
+    uint64_t fileSize_ = 0;
+    uint64_t firstFrameOffset_ = 0;
+
+    // STREAMINFO
+    int32_t sampleRate_ = 0;
+    int32_t channelCount_ = 0;
+    int32_t bitsPerSample_ = 0;
+    uint32_t minBlockSize_ = 0;
+    uint32_t maxBlockSize_ = 0;
+    uint64_t totalSamples_ = 0;
+    size_t maxFrameBytes_ = 0; // Upper bound of one compressed frame
+    std::vector<SeekPoint> seekTable_;
+
+    // Output container
+    SampleFormat format_ = SampleFormat::Unspecified;
+    int32_t bytesPerFrame_ = 0;
+
+    std::unique_ptr<uint8_t[]> input_; // Followed by zero padding for the bit reader
+    size_t inputCapacity_ = 0;
+    size_t inputPosition_ = 0;
+    size_t inputEnd_ = 0;
+    uint64_t inputOffset_ = 0; // File offset of input_[0]
+    bool inputEof_ = false;
+
+    std::unique_ptr<int32_t[]> samples_; // One block, channel after channel
+    std::unique_ptr<uint8_t[]> pcm_;     // Decoded block in the output container
+    size_t pcmSize_ = 0;
+    size_t pcmPosition_ = 0;
+    uint64_t pcmFirstSample_ = 0; // Sample at pcm_[0]
+    uint64_t nextSample_ = 0;     // First sample of the next frame to decode
+    uint64_t dataPosition_ = 0;
+    uint64_t corruptFrames_ = 0;
+};
+
+#endif // FLAC_FILE_H
@@ -0,0 +1,815 @@
+#include "format_converter.h"
+#include "audio_log.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define FORMAT_CONVERTER_HAS_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FORMAT_CONVERTER_HAS_SSE2 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FORMAT_CONVERTER_HAS_AVX2 1
+#define FORMAT_CONVERTER_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+// TPDF amplitude: difference of two 16-bit uniforms, +-1 LSB
+constexpr float kDitherScale = 1.0f / 65536.0f;
+
+inline uint32_t xorshift32(uint32_t& state) {
+    uint32_t x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    return x;
+}
+
+inline float tpdfDither(uint32_t& state) {
+    uint32_t r = xorshift32(state);
+    return static_cast<float>(static_cast<int32_t>(r & 0xFFFF) - static_cast<int32_t>(r >> 16)) * kDitherScale;
+}
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+// ---------------------------------------------------------------------------
+
+void u8ToI16Scalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<int16_t>((static_cast<int32_t>(src[i]) - 128) * 256);
+    }
+}
+
+void u8ToFloatScalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(static_cast<int32_t>(src[i]) - 128) * (1.0f / kScaleU8);
+    }
+}
+
+void i16ToI32Scalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<int32_t>(static_cast<uint32_t>(static_cast<int32_t>(src[i])) << 16);
+    }
+}
+
+void i16ToFloatScalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<float*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(src[i]) * (1.0f / kScaleI16);
+    }
+}
+
+void i24ToI32Scalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = readI24(src + i * 3);
+    }
+}
+
+void i24ToFloatScalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(readI24(src + i * 3)) * (1.0f / kScaleI32);
+    }
+}
+
+void i32ToFloatScalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const int32_t*>(source);
+    auto dst = static_cast<float*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(src[i]) * (1.0f / kScaleI32);
+    }
+}
+
+void floatToI16Scalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        float v = std::min(std::max(src[i] * kScaleI16, -kScaleI16), kScaleI16 - 1.0f);
+        dst[i] = static_cast<int16_t>(std::lrint(v));
+    }
+}
+
+void floatToI16DitherScalar(const void* source, void* target, int32_t count, uint32_t* ditherState) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        float v = src[i] * kScaleI16 + tpdfDither(ditherState[0]);
+        v = std::min(std::max(v, -kScaleI16), kScaleI16 - 1.0f);
+        dst[i] = static_cast<int16_t>(std::lrint(v));
+    }
+}
+
+void floatToI32Scalar(const void* source, void* target, int32_t count, uint32_t*) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    for (int32_t i = 0; i < count; i++) {
+        float v = std::min(std::max(src[i] * kScaleI32, -kScaleI32), kMaxI32AsFloat);
+        dst[i] = static_cast<int32_t>(std::lrint(v));
+    }
+}
+
+struct KernelSet {
+    FormatConverter::Kernel u8ToI16;
+    FormatConverter::Kernel u8ToFloat;
+    FormatConverter::Kernel i16ToI32;
+    FormatConverter::Kernel i16ToFloat;
+    FormatConverter::Kernel i24ToI32;
+    FormatConverter::Kernel i24ToFloat;
+    FormatConverter::Kernel i32ToFloat;
+    FormatConverter::Kernel floatToI16;
+    FormatConverter::Kernel floatToI16Dither;
+    FormatConverter::Kernel floatToI32;
+};
+
+const KernelSet kScalarKernels = {
+    u8ToI16Scalar,    u8ToFloatScalar,  i16ToI32Scalar,   i16ToFloatScalar,       i24ToI32Scalar,
+    i24ToFloatScalar, i32ToFloatScalar, floatToI16Scalar, floatToI16DitherScalar, floatToI32Scalar,
+};
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels (x86-64 baseline)
+// ---------------------------------------------------------------------------
+
+#if FORMAT_CONVERTER_HAS_SSE2
+void u8ToI16Sse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i zero = _mm_setzero_si128();
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Flipping the top bit turns u8 into s8, unpacking into the high byte scales by 256
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(zero, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(zero, v));
+    }
+    u8ToI16Scalar(src + i, dst + i, count - i, state);
+}
+
+void u8ToFloatSse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+        __m128i lo = _mm_unpacklo_epi8(zero, v);
+        __m128i hi = _mm_unpackhi_epi8(zero, v);
+        // Each s8 lands in the top byte of an int32, i.e. scaled by 2^24
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, lo)), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, lo)), scale));
+        _mm_storeu_ps(dst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, hi)), scale));
+        _mm_storeu_ps(dst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, hi)), scale));
+    }
+    u8ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+void i16ToI32Sse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    const __m128i zero = _mm_setzero_si128();
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    i16ToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+void i16ToFloatSse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(zero, v)), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(zero, v)), scale));
+    }
+    i16ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+void i32ToFloatSse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int32_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m128 scale = _mm_set1_ps(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    i32ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+inline __m128 ditherSse2(__m128i& state) {
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+    state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+    state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+    __m128i lo = _mm_and_si128(state, _mm_set1_epi32(0xFFFF));
+    __m128i hi = _mm_srli_epi32(state, 16);
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(lo, hi)), _mm_set1_ps(kDitherScale));
+}
+
+template <bool Dither>
+void floatToI16Sse2(const void* source, void* target, int32_t count, uint32_t* ditherState) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    const __m128 scale = _mm_set1_ps(kScaleI16);
+    const __m128 lower = _mm_set1_ps(-kScaleI16);
+    const __m128 upper = _mm_set1_ps(kScaleI16 - 1.0f);
+    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ditherState));
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        if (Dither) {
+            a = _mm_add_ps(a, ditherSse2(state));
+            b = _mm_add_ps(b, ditherSse2(state));
+        }
+        a = _mm_min_ps(_mm_max_ps(a, lower), upper);
+        b = _mm_min_ps(_mm_max_ps(b, lower), upper);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(ditherState), state);
+    if (Dither) {
+        floatToI16DitherScalar(src + i, dst + i, count - i, ditherState);
+    } else {
+        floatToI16Scalar(src + i, dst + i, count - i, ditherState);
+    }
+}
+
+void floatToI32Sse2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    const __m128 scale = _mm_set1_ps(kScaleI32);
+    const __m128 lower = _mm_set1_ps(-kScaleI32);
+    const __m128 upper = _mm_set1_ps(kMaxI32AsFloat);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lower), upper);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_cvtps_epi32(v));
+    }
+    floatToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+// No byte shuffle before SSSE3, packed 24-bit stays scalar here
+const KernelSet kSse2Kernels = {
+    u8ToI16Sse2,      u8ToFloatSse2,  i16ToI32Sse2,          i16ToFloatSse2,       i24ToI32Scalar,
+    i24ToFloatScalar, i32ToFloatSse2, floatToI16Sse2<false>, floatToI16Sse2<true>, floatToI32Sse2,
+};
+#endif // FORMAT_CONVERTER_HAS_SSE2
+
+// ---------------------------------------------------------------------------
+// AVX2 kernels (x86, selected at runtime)
+// ---------------------------------------------------------------------------
+
+#if FORMAT_CONVERTER_HAS_AVX2
+FORMAT_CONVERTER_AVX2 void u8ToI16Avx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    const __m256i bias = _mm256_set1_epi16(128);
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        v = _mm256_slli_epi16(_mm256_sub_epi16(v, bias), 8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), v);
+    }
+    u8ToI16Scalar(src + i, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 void u8ToFloatAvx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m256i bias = _mm256_set1_epi32(128);
+    const __m256 scale = _mm256_set1_ps(1.0f / kScaleU8);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(v, bias)), scale));
+    }
+    u8ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 void i16ToI32Avx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_slli_epi32(v, 16));
+    }
+    i16ToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 void i16ToFloatAvx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m256 scale = _mm256_set1_ps(1.0f / kScaleI16);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    i16ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+// Expand 8 packed 24-bit samples into the top three bytes of 8 int32
+FORMAT_CONVERTER_AVX2 inline __m256i loadI24Avx2(const uint8_t* src) {
+    const __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, //
+                                             -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12));
+    return _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1), shuffle);
+}
+
+FORMAT_CONVERTER_AVX2 void i24ToI32Avx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    int32_t i = 0;
+    // The second 16-byte load reads 4 bytes past the 8th sample
+    for (; i + 10 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), loadI24Avx2(src + i * 3));
+    }
+    i24ToI32Scalar(src + i * 3, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 void i24ToFloatAvx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m256 scale = _mm256_set1_ps(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 10 <= count; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(loadI24Avx2(src + i * 3)), scale));
+    }
+    i24ToFloatScalar(src + i * 3, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 void i32ToFloatAvx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int32_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const __m256 scale = _mm256_set1_ps(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    i32ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+FORMAT_CONVERTER_AVX2 inline __m256 ditherAvx2(__m256i& state) {
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+    state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+    state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+    __m256i lo = _mm256_and_si256(state, _mm256_set1_epi32(0xFFFF));
+    __m256i hi = _mm256_srli_epi32(state, 16);
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_sub_epi32(lo, hi)), _mm256_set1_ps(kDitherScale));
+}
+
+template <bool Dither>
+FORMAT_CONVERTER_AVX2 void floatToI16Avx2(const void* source, void* target, int32_t count, uint32_t* ditherState) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    const __m256 scale = _mm256_set1_ps(kScaleI16);
+    const __m256 lower = _mm256_set1_ps(-kScaleI16);
+    const __m256 upper = _mm256_set1_ps(kScaleI16 - 1.0f);
+    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ditherState));
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        if (Dither) {
+            a = _mm256_add_ps(a, ditherAvx2(state));
+            b = _mm256_add_ps(b, ditherAvx2(state));
+        }
+        a = _mm256_min_ps(_mm256_max_ps(a, lower), upper);
+        b = _mm256_min_ps(_mm256_max_ps(b, lower), upper);
+        // packs works per 128-bit lane, restore sample order afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(ditherState), state);
+    if (Dither) {
+        floatToI16DitherScalar(src + i, dst + i, count - i, ditherState);
+    } else {
+        floatToI16Scalar(src + i, dst + i, count - i, ditherState);
+    }
+}
+
+FORMAT_CONVERTER_AVX2 void floatToI32Avx2(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    const __m256 scale = _mm256_set1_ps(kScaleI32);
+    const __m256 lower = _mm256_set1_ps(-kScaleI32);
+    const __m256 upper = _mm256_set1_ps(kMaxI32AsFloat);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lower), upper);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtps_epi32(v));
+    }
+    floatToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+const KernelSet kAvx2Kernels = {
+    u8ToI16Avx2,    u8ToFloatAvx2,  i16ToI32Avx2,          i16ToFloatAvx2,       i24ToI32Avx2,
+    i24ToFloatAvx2, i32ToFloatAvx2, floatToI16Avx2<false>, floatToI16Avx2<true>, floatToI32Avx2,
+};
+#endif // FORMAT_CONVERTER_HAS_AVX2
+
+// ---------------------------------------------------------------------------
+// NEON kernels (aarch64)
+// ---------------------------------------------------------------------------
+
+#if FORMAT_CONVERTER_HAS_NEON
+inline int16x8_t loadU8AsI16Neon(const uint8_t* src) {
+    // Flipping the top bit turns u8 into s8, widening shift scales by 256
+    int8x8_t v = vreinterpret_s8_u8(veor_u8(vld1_u8(src), vdup_n_u8(0x80)));
+    return vshll_n_s8(v, 8);
+}
+
+void u8ToI16Neon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_s16(dst + i, loadU8AsI16Neon(src + i));
+    }
+    u8ToI16Scalar(src + i, dst + i, count - i, state);
+}
+
+void u8ToFloatNeon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const float32x4_t scale = vdupq_n_f32(1.0f / kScaleI16);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = loadU8AsI16Neon(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    u8ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+void i16ToI32Neon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_s32(dst + i, vshll_n_s16(vget_low_s16(v), 16));
+        vst1q_s32(dst + i + 4, vshll_n_s16(vget_high_s16(v), 16));
+    }
+    i16ToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+void i16ToFloatNeon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int16_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const float32x4_t scale = vdupq_n_f32(1.0f / kScaleI16);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+        vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+    }
+    i16ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+// Deinterleave 16 packed 24-bit samples and rebuild them as [0, b0, b1, b2] int32
+inline int32x4x4_t loadI24Neon(const uint8_t* src) {
+    uint8x16x3_t bytes = vld3q_u8(src);
+    uint8x16x2_t low = vzipq_u8(vdupq_n_u8(0), bytes.val[0]);
+    uint8x16x2_t high = vzipq_u8(bytes.val[1], bytes.val[2]);
+    uint16x8x2_t first = vzipq_u16(vreinterpretq_u16_u8(low.val[0]), vreinterpretq_u16_u8(high.val[0]));
+    uint16x8x2_t second = vzipq_u16(vreinterpretq_u16_u8(low.val[1]), vreinterpretq_u16_u8(high.val[1]));
+    int32x4x4_t result;
+    result.val[0] = vreinterpretq_s32_u16(first.val[0]);
+    result.val[1] = vreinterpretq_s32_u16(first.val[1]);
+    result.val[2] = vreinterpretq_s32_u16(second.val[0]);
+    result.val[3] = vreinterpretq_s32_u16(second.val[1]);
+    return result;
+}
+
+void i24ToI32Neon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        int32x4x4_t v = loadI24Neon(src + i * 3);
+        for (int k = 0; k < 4; k++) {
+            vst1q_s32(dst + i + k * 4, v.val[k]);
+        }
+    }
+    i24ToI32Scalar(src + i * 3, dst + i, count - i, state);
+}
+
+void i24ToFloatNeon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const float32x4_t scale = vdupq_n_f32(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        int32x4x4_t v = loadI24Neon(src + i * 3);
+        for (int k = 0; k < 4; k++) {
+            vst1q_f32(dst + i + k * 4, vmulq_f32(vcvtq_f32_s32(v.val[k]), scale));
+        }
+    }
+    i24ToFloatScalar(src + i * 3, dst + i, count - i, state);
+}
+
+void i32ToFloatNeon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const int32_t*>(source);
+    auto dst = static_cast<float*>(target);
+    const float32x4_t scale = vdupq_n_f32(1.0f / kScaleI32);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+    }
+    i32ToFloatScalar(src + i, dst + i, count - i, state);
+}
+
+inline float32x4_t ditherNeon(uint32x4_t& state) {
+    state = veorq_u32(state, vshlq_n_u32(state, 13));
+    state = veorq_u32(state, vshrq_n_u32(state, 17));
+    state = veorq_u32(state, vshlq_n_u32(state, 5));
+    int32x4_t lo = vreinterpretq_s32_u32(vandq_u32(state, vdupq_n_u32(0xFFFF)));
+    int32x4_t hi = vreinterpretq_s32_u32(vshrq_n_u32(state, 16));
+    return vmulq_f32(vcvtq_f32_s32(vsubq_s32(lo, hi)), vdupq_n_f32(kDitherScale));
+}
+
+template <bool Dither>
+void floatToI16Neon(const void* source, void* target, int32_t count, uint32_t* ditherState) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int16_t*>(target);
+    const float32x4_t scale = vdupq_n_f32(kScaleI16);
+    const float32x4_t lower = vdupq_n_f32(-kScaleI16);
+    const float32x4_t upper = vdupq_n_f32(kScaleI16 - 1.0f);
+    uint32x4_t state = vld1q_u32(ditherState);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t a = vmulq_f32(vld1q_f32(src + i), scale);
+        float32x4_t b = vmulq_f32(vld1q_f32(src + i + 4), scale);
+        if (Dither) {
+            a = vaddq_f32(a, ditherNeon(state));
+            b = vaddq_f32(b, ditherNeon(state));
+        }
+        a = vminq_f32(vmaxq_f32(a, lower), upper);
+        b = vminq_f32(vmaxq_f32(b, lower), upper);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+    }
+    vst1q_u32(ditherState, state);
+    if (Dither) {
+        floatToI16DitherScalar(src + i, dst + i, count - i, ditherState);
+    } else {
+        floatToI16Scalar(src + i, dst + i, count - i, ditherState);
+    }
+}
+
+void floatToI32Neon(const void* source, void* target, int32_t count, uint32_t* state) {
+    auto src = static_cast<const float*>(source);
+    auto dst = static_cast<int32_t*>(target);
+    const float32x4_t scale = vdupq_n_f32(kScaleI32);
+    const float32x4_t lower = vdupq_n_f32(-kScaleI32);
+    const float32x4_t upper = vdupq_n_f32(kMaxI32AsFloat);
+    int32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t v = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(src + i), scale), lower), upper);
+        vst1q_s32(dst + i, vcvtnq_s32_f32(v));
+    }
+    floatToI32Scalar(src + i, dst + i, count - i, state);
+}
+
+const KernelSet kNeonKernels = {
+    u8ToI16Neon,    u8ToFloatNeon,  i16ToI32Neon,          i16ToFloatNeon,       i24ToI32Neon,
+    i24ToFloatNeon, i32ToFloatNeon, floatToI16Neon<false>, floatToI16Neon<true>, floatToI32Neon,
+};
+#endif // FORMAT_CONVERTER_HAS_NEON
+
+std::atomic<bool> scalarOnly{false};
+
+bool isIsaAvailable(FormatConverter::Isa isa) {
+    switch (isa) {
+    case FormatConverter::Isa::Scalar:
+        return true;
+#if FORMAT_CONVERTER_HAS_SSE2
+    case FormatConverter::Isa::Sse2:
+        return true;
+#endif
+#if FORMAT_CONVERTER_HAS_AVX2
+    case FormatConverter::Isa::Avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if FORMAT_CONVERTER_HAS_NEON
+    case FormatConverter::Isa::Neon:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+const KernelSet& getKernelSet(FormatConverter::Isa isa) {
+    switch (isa) {
+#if FORMAT_CONVERTER_HAS_SSE2
+    case FormatConverter::Isa::Sse2:
+        return kSse2Kernels;
+#endif
+#if FORMAT_CONVERTER_HAS_AVX2
+    case FormatConverter::Isa::Avx2:
+        return kAvx2Kernels;
+#endif
+#if FORMAT_CONVERTER_HAS_NEON
+    case FormatConverter::Isa::Neon:
+        return kNeonKernels;
+#endif
+    default:
+        return kScalarKernels;
+    }
+}
+
+FormatConverter::Isa resolveIsa(FormatConverter::Isa isa) {
+    if (isa == FormatConverter::Isa::Best) {
+        return FormatConverter::getBestIsa();
+    }
+    return isIsaAvailable(isa) ? isa : FormatConverter::Isa::Scalar;
+}
+
+} // namespace
+
+bool FormatConverter::configure(
+    SampleFormat source, SampleFormat target, int32_t maxSamples, bool dither, Isa isa) {
+    source_ = source;
+    target_ = target;
+    isa_ = resolveIsa(isa);
+    passthrough_ = false;
+    direct_ = toFloat_ = fromFloat_ = nullptr;
+    scratch_.reset();
+    scratchSamples_ = 0;
+
+    // Any non-zero seed per lane, xorshift never leaves zero
+    for (int i = 0; i < 8; i++) {
+        ditherState_[i] = 0x9E3779B9u * static_cast<uint32_t>(i + 1);
+    }
+
+    bytesPerSample_ = getBytesPerSample(source);
+    if (bytesPerSample_ == 0 || getBytesPerSample(target) == 0) {
+        LOGE("Unsupported conversion: format %d -> %d", static_cast<int32_t>(source), static_cast<int32_t>(target));
+        return false;
+    }
+
+    if (source == target) {
+        passthrough_ = true;
+        return true;
+    }
+
+    direct_ = findKernel(source, target, dither, isa_);
+    if (!direct_) {
+        // Two passes through float
+        toFloat_ = findKernel(source, SampleFormat::Float, dither, isa_);
+        fromFloat_ = findKernel(SampleFormat::Float, target, dither, isa_);
+        if (!toFloat_ || !fromFloat_ || maxSamples <= 0) {
+            LOGE("Unsupported conversion: format %d -> %d", static_cast<int32_t>(source),
+                 static_cast<int32_t>(target));
+            toFloat_ = fromFloat_ = nullptr;
+            return false;
+        }
+        scratch_.reset(new float[maxSamples]);
+        scratchSamples_ = maxSamples;
+    }
+
+    bool dithered = dither && target == SampleFormat::I16 && (source == SampleFormat::Float || !direct_);
+    LOGI("Format conversion %d -> %d (%s%s, %s)", static_cast<int32_t>(source), static_cast<int32_t>(target),
+         direct_ ? "direct" : "via float", dithered ? ", dither" : "", getIsaName(isa_));
+    return true;
+}
+
+void FormatConverter::convert(const void* source, void* target, int32_t count) {
+    if (passthrough_) {
+        memcpy(target, source, static_cast<size_t>(count) * bytesPerSample_);
+        return;
+    }
+
+    if (direct_) {
+        direct_(source, target, count, ditherState_);
+        return;
+    }
+
+    if (!toFloat_) {
+        return;
+    }
+
+    auto src = static_cast<const uint8_t*>(source);
+    auto dst = static_cast<uint8_t*>(target);
+    int32_t targetBytesPerSample = getBytesPerSample(target_);
+    while (count > 0) {
+        int32_t chunk = std::min(count, scratchSamples_);
+        toFloat_(src, scratch_.get(), chunk, ditherState_);
+        fromFloat_(scratch_.get(), dst, chunk, ditherState_);
+        src += static_cast<size_t>(chunk) * bytesPerSample_;
+        dst += static_cast<size_t>(chunk) * targetBytesPerSample;
+        count -= chunk;
+    }
+}
+
+FormatConverter::Isa FormatConverter::getBestIsa() {
+    if (scalarOnly.load(std::memory_order_relaxed)) {
+        return Isa::Scalar;
+    }
+#if FORMAT_CONVERTER_HAS_NEON
+    return Isa::Neon;
+#else
+    if (isIsaAvailable(Isa::Avx2)) {
+        return Isa::Avx2;
+    }
+    if (isIsaAvailable(Isa::Sse2)) {
+        return Isa::Sse2;
+    }
+    return Isa::Scalar;
+#endif
+}
+
+void FormatConverter::setScalarOnly(bool scalar) { scalarOnly.store(scalar, std::memory_order_relaxed); }
+
+const char* FormatConverter::getIsaName(Isa isa) {
+    switch (isa) {
+    case Isa::Best:
+        return "best";
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::Sse2:
+        return "sse2";
+    case Isa::Avx2:
+        return "avx2";
+    case Isa::Neon:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+FormatConverter::Kernel FormatConverter::findKernel(SampleFormat source, SampleFormat target, bool dither, Isa isa) {
+    const KernelSet& kernels = getKernelSet(resolveIsa(isa));
+
+    switch (source) {
+    case SampleFormat::U8:
+        if (target == SampleFormat::I16) {
+            return kernels.u8ToI16;
+        }
+        return target == SampleFormat::Float ? kernels.u8ToFloat : nullptr;
+    case SampleFormat::I16:
+        if (target == SampleFormat::I32) {
+            return kernels.i16ToI32;
+        }
+        return target == SampleFormat::Float ? kernels.i16ToFloat : nullptr;
+    case SampleFormat::I24Packed:
+        if (target == SampleFormat::I32) {
+            return kernels.i24ToI32;
+        }
+        return target == SampleFormat::Float ? kernels.i24ToFloat : nullptr;
+    case SampleFormat::I32:
+        return target == SampleFormat::Float ? kernels.i32ToFloat : nullptr;
+    case SampleFormat::Float:
+        if (target == SampleFormat::I16) {
+            return dither ? kernels.floatToI16Dither : kernels.floatToI16;
+        }
+        return target == SampleFormat::I32 ? kernels.floatToI32 : nullptr;
+    default:
+        return nullptr;
+    }
+}
+
+SampleFormat FormatConverter::getPreferredDeviceFormat(SampleFormat fileFormat) {
+    switch (fileFormat) {
+    case SampleFormat::U8:
+        return SampleFormat::I16; // Lossless
+    case SampleFormat::I24Packed:
+        return SampleFormat::Float; // 24-bit mantissa, lossless
+    default:
+        return fileFormat;
+    }
+}
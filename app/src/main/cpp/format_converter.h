@@ -0,0 +1,114 @@
+#ifndef FORMAT_CONVERTER_H
+#define FORMAT_CONVERTER_H
+
+#include "audio_format.h"
+#include <cstdint>
+#include <memory>
+
+/**
+ * Sample format conversion between the file and the granted stream format
+ *
+ * Selected once at stream-open time. Direct kernels exist for
+ * u8->i16/float, i16->i32/float, i24 packed->i32/float, i32->float and
+ * float->i16 (optional TPDF dither)/i32; any other pair goes through float in
+ * a scratch buffer sized by configure(). Kernels are vectorized with NEON
+ * (aarch64), SSE2 (x86-64) or AVX2 (picked at runtime), with scalar fallbacks
+ * that produce identical output.
+ */
+class FormatConverter {
+public:
+    enum class Isa {
+        Best, // Fastest available on this CPU
+        Scalar,
+        Sse2,
+        Avx2,
+        Neon,
+    };
+
+    /**
+     * Kernel signature, count is in samples (frames * channels)
+     */
+    using Kernel = void (*)(const void* source, void* target, int32_t count, uint32_t* ditherState);
+
+    FormatConverter() = default;
+
+    // Disable copy and assignment
+    FormatConverter(const FormatConverter&) = delete;
+    FormatConverter& operator=(const FormatConverter&) = delete;
+
+    /**
+     * Select the conversion kernels (not real-time safe, may allocate)
+     * @param source Format of the samples read from the file
+     * @param target Format granted by the output stream
+     * @param maxSamples Largest count passed to convert(), sizes the scratch buffer
+     * @param dither Apply TPDF dither when reducing float to 16-bit
+     * @param isa Instruction set to use, Best picks the fastest one available
+     * @return Returns false if either format is unsupported
+     */
+    bool configure(SampleFormat source,
+                   SampleFormat target,
+                   int32_t maxSamples,
+                   bool dither = true,
+                   Isa isa = Isa::Best);
+
+    /**
+     * True when source and target formats match and data can be copied as is
+     */
+    bool isPassthrough() const { return passthrough_; }
+
+    /**
+     * Convert samples (real-time safe)
+     * @param count Sample count, at most the maxSamples given to configure()
+     */
+    void convert(const void* source, void* target, int32_t count);
+
+    SampleFormat getSourceFormat() const { return source_; }
+    SampleFormat getTargetFormat() const { return target_; }
+    Isa getIsa() const { return isa_; }
+
+    /**
+     * Get the fastest instruction set available on this CPU, Scalar while setScalarOnly() is on
+     * Also picks the kernels of the resampler, mixer and channel matrix.
+     */
+    static Isa getBestIsa();
+
+    /**
+     * Make every module pick its scalar kernels from now on (process-wide)
+     * SIMD kernels may round differently (e.g. FMA), scalar output is the same on every machine.
+     */
+    static void setScalarOnly(bool scalarOnly);
+
+    static const char* getIsaName(Isa isa);
+
+    /**
+     * Get the kernel for a direct conversion
+     * @return nullptr if there is no direct kernel for this pair on this ISA
+     */
+    static Kernel findKernel(SampleFormat source, SampleFormat target, bool dither, Isa isa);
+
+    /**
+     * Stream format to request for a file format
+     * 8-bit has no device format and 24-bit packed is rejected or converted
+     * slowly by many HALs, so both are widened before they reach the device.
+     */
+    static SampleFormat getPreferredDeviceFormat(SampleFormat fileFormat);
+
+private:
+    SampleFormat source_ = SampleFormat::Unspecified;
+    SampleFormat target_ = SampleFormat::Unspecified;
+    Isa isa_ = Isa::Scalar;
+    bool passthrough_ = false;
+    int32_t bytesPerSample_ = 0;
+
+    // Either a direct kernel, or toFloat_ followed by fromFloat_ via scratch_
+    Kernel direct_ = nullptr;
+    Kernel toFloat_ = nullptr;
+    Kernel fromFloat_ = nullptr;
+    std::unique_ptr<float[]> scratch_;
+    int32_t scratchSamples_ = 0;
+
+    // Per-lane xorshift32 state for TPDF dither
+    uint32_t ditherState_[8] = {};
+};
+
+#endif // FORMAT_CONVERTER_H
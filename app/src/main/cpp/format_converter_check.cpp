@@ -0,0 +1,403 @@
+// Host check of the FormatConverter kernels: every direct kernel on every instruction set this CPU has against
+// an independent reference of each format pair, TPDF dither bounds and bias, and conversions through float.
+// With -b it also benchmarks samples/ns of each kernel against the scalar reference.
+#include "format_converter.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("format_converter_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run converts the same samples
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    // Uniform in [low, high)
+    double uniform(double low, double high) {
+        return low + (high - low) * static_cast<double>(next() >> 11) / 9007199254740992.0;
+    }
+
+private:
+    uint64_t state_;
+};
+
+struct KernelCase {
+    const char* name;
+    SampleFormat source;
+    SampleFormat target;
+    bool dither;
+};
+
+const KernelCase kKernelCases[] = {
+    {"u8->i16", SampleFormat::U8, SampleFormat::I16, false},
+    {"u8->float", SampleFormat::U8, SampleFormat::Float, false},
+    {"i16->i32", SampleFormat::I16, SampleFormat::I32, false},
+    {"i16->float", SampleFormat::I16, SampleFormat::Float, false},
+    {"i24->i32", SampleFormat::I24Packed, SampleFormat::I32, false},
+    {"i24->float", SampleFormat::I24Packed, SampleFormat::Float, false},
+    {"i32->float", SampleFormat::I32, SampleFormat::Float, false},
+    {"float->i16", SampleFormat::Float, SampleFormat::I16, false},
+    {"float->i16 dither", SampleFormat::Float, SampleFormat::I16, true},
+    {"float->i32", SampleFormat::Float, SampleFormat::I32, false},
+};
+
+const FormatConverter::Isa kIsas[] = {FormatConverter::Isa::Scalar, FormatConverter::Isa::Sse2,
+                                      FormatConverter::Isa::Avx2, FormatConverter::Isa::Neon};
+
+// configure() falls back to scalar for an instruction set the CPU lacks
+bool isIsaAvailable(FormatConverter::Isa isa) {
+    FormatConverter converter;
+    return converter.configure(SampleFormat::I16, SampleFormat::Float, 0, false, isa) && converter.getIsa() == isa;
+}
+
+// Source samples of a format, as the value each one stands for relative to full scale
+struct Samples {
+    std::vector<uint8_t> bytes;
+    std::vector<double> values;
+};
+
+void appendSample(Samples* samples, SampleFormat format, double value, int64_t integer) {
+    const int32_t bytesPerSample = getBytesPerSample(format);
+    uint8_t raw[4];
+    if (format == SampleFormat::Float) {
+        auto sample = static_cast<float>(value);
+        memcpy(raw, &sample, sizeof(sample));
+        value = sample;
+    } else if (format == SampleFormat::U8) {
+        raw[0] = static_cast<uint8_t>(integer + 128);
+    } else {
+        // Little-endian two's complement, the low bytes of the integer
+        for (int32_t i = 0; i < bytesPerSample; i++) {
+            raw[i] = static_cast<uint8_t>(static_cast<uint64_t>(integer) >> (8 * i));
+        }
+    }
+    samples->bytes.insert(samples->bytes.end(), raw, raw + bytesPerSample);
+    samples->values.push_back(value);
+}
+
+/**
+ * Every code of the 8- and 16-bit formats, edges plus random codes of the wider ones, and for float the
+ * rounding ties, clamp edges and out-of-range values the integer targets have to handle
+ */
+Samples makeSamples(SampleFormat format) {
+    Samples samples;
+    Random random(static_cast<uint64_t>(format) + 7);
+    switch (format) {
+    case SampleFormat::U8:
+        for (int64_t code = -128; code < 128; code++) {
+            appendSample(&samples, format, code / 128.0, code);
+        }
+        break;
+    case SampleFormat::I16:
+        for (int64_t code = -32768; code < 32768; code++) {
+            appendSample(&samples, format, code / 32768.0, code);
+        }
+        break;
+    case SampleFormat::I24Packed:
+    case SampleFormat::I32: {
+        const int32_t bits = format == SampleFormat::I32 ? 32 : 24;
+        const int64_t high = (int64_t{1} << (bits - 1)) - 1;
+        for (int64_t code : {-high - 1, -high, int64_t{-1}, int64_t{0}, int64_t{1}, high - 1, high}) {
+            appendSample(&samples, format, std::ldexp(static_cast<double>(code), 1 - bits), code);
+        }
+        for (int32_t i = 0; i < 100000; i++) {
+            auto code = static_cast<int64_t>(random.next() >> (65 - bits)) - (random.next() & 1 ? high + 1 : 0);
+            appendSample(&samples, format, std::ldexp(static_cast<double>(code), 1 - bits), code);
+        }
+        break;
+    }
+    case SampleFormat::Float:
+        for (double value : {0.0, -0.0, 1.0, -1.0, 32767.0 / 32768.0, 32767.5 / 32768.0, 1.5, -1.5, 1e9, -1e9,
+                             0.5 / 32768.0, 1.5 / 32768.0, -0.5 / 32768.0, -2.5 / 32768.0, 1e-30}) {
+            appendSample(&samples, format, value, 0);
+        }
+        for (int32_t i = 0; i < 100000; i++) {
+            appendSample(&samples, format, random.uniform(-1.25, 1.25), 0);
+        }
+        // Exact halves of a 16-bit step, where round-to-nearest-even decides
+        for (int32_t i = 0; i < 1000; i++) {
+            appendSample(&samples, format, (static_cast<double>(random.next() % 65536) - 32768.0 + 0.5) / 32768.0, 0);
+        }
+        break;
+    default:
+        break;
+    }
+    return samples;
+}
+
+// Round half to even and saturate, as a device expects a full-scale value to land
+int64_t quantize(double value, double scale, double low, double high) {
+    return static_cast<int64_t>(std::nearbyint(std::min(std::max(value * scale, low), high)));
+}
+
+/**
+ * Expected output of one sample, as the target's raw integer or float bits widened to int64
+ * Float targets hold the exact value rounded once to float. Float to I32 saturates at the largest float below
+ * 2^31, the top code a float can reach.
+ */
+int64_t expectedSample(SampleFormat target, double value) {
+    switch (target) {
+    case SampleFormat::I16:
+        return quantize(value, 32768.0, -32768.0, 32767.0);
+    case SampleFormat::I32:
+        return quantize(value, 2147483648.0, -2147483648.0, 2147483520.0);
+    case SampleFormat::Float: {
+        auto sample = static_cast<float>(value);
+        uint32_t bits = 0;
+        memcpy(&bits, &sample, sizeof(bits));
+        return bits;
+    }
+    default:
+        return 0;
+    }
+}
+
+int64_t outputSample(SampleFormat target, const uint8_t* data, size_t index) {
+    switch (target) {
+    case SampleFormat::I16: {
+        int16_t sample = 0;
+        memcpy(&sample, data + index * 2, 2);
+        return sample;
+    }
+    case SampleFormat::I32: {
+        int32_t sample = 0;
+        memcpy(&sample, data + index * 4, 4);
+        return sample;
+    }
+    case SampleFormat::Float: {
+        uint32_t bits = 0;
+        memcpy(&bits, data + index * 4, 4);
+        return bits;
+    }
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Run a kernel over the samples at every start offset of a vector, so unaligned heads and scalar tails are
+ * converted as well as the vector body
+ */
+std::vector<uint8_t> runKernel(FormatConverter::Kernel kernel, const KernelCase& kernelCase, const Samples& samples,
+                               size_t offset) {
+    const size_t sourceBytes = static_cast<size_t>(getBytesPerSample(kernelCase.source));
+    const size_t targetBytes = static_cast<size_t>(getBytesPerSample(kernelCase.target));
+    const size_t count = samples.values.size() - offset;
+    std::vector<uint8_t> source(samples.bytes.begin() + static_cast<std::ptrdiff_t>(offset * sourceBytes),
+                                samples.bytes.end());
+    std::vector<uint8_t> target(count * targetBytes);
+    uint32_t ditherState[8];
+    for (int32_t lane = 0; lane < 8; lane++) {
+        ditherState[lane] = 0x9E3779B9u * static_cast<uint32_t>(lane + 1);
+    }
+    kernel(source.data(), target.data(), static_cast<int32_t>(count), ditherState);
+    return target;
+}
+
+void checkKernel(const KernelCase& kernelCase, FormatConverter::Isa isa) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s %s", kernelCase.name, FormatConverter::getIsaName(isa));
+    FormatConverter::Kernel kernel =
+        FormatConverter::findKernel(kernelCase.source, kernelCase.target, kernelCase.dither, isa);
+    if (!expect(kernel != nullptr, name, "no direct kernel")) {
+        return;
+    }
+
+    const Samples samples = makeSamples(kernelCase.source);
+    for (size_t offset = 0; offset < 9; offset++) {
+        std::vector<uint8_t> output = runKernel(kernel, kernelCase, samples, offset);
+        for (size_t i = 0; i + offset < samples.values.size(); i++) {
+            double value = samples.values[i + offset];
+            int64_t actual = outputSample(kernelCase.target, output.data(), i);
+            int64_t expected = expectedSample(kernelCase.target, value);
+            // TPDF dither spans +-1 LSB before rounding, so it may move the result by one step
+            bool ok = kernelCase.dither ? std::llabs(actual - expected) <= 1 : actual == expected;
+            if (!ok) {
+                printf("format_converter_check: %s: sample %zu (%.10g) gave %lld, expected %lld\n", name, i + offset,
+                       value, static_cast<long long>(actual), static_cast<long long>(expected));
+                failures++;
+                return;
+            }
+        }
+    }
+
+    if (kernelCase.dither) {
+        // Dither turns a constant quarter step into a mean of a quarter step, plain rounding would give zero
+        Samples quarter;
+        for (int32_t i = 0; i < 200000; i++) {
+            appendSample(&quarter, SampleFormat::Float, 0.25 / 32768.0, 0);
+        }
+        std::vector<uint8_t> output = runKernel(kernel, kernelCase, quarter, 0);
+        double sum = 0.0;
+        double squares = 0.0;
+        for (size_t i = 0; i < quarter.values.size(); i++) {
+            auto sample = static_cast<double>(outputSample(SampleFormat::I16, output.data(), i));
+            sum += sample;
+            squares += (sample - 0.25) * (sample - 0.25);
+        }
+        double mean = sum / static_cast<double>(quarter.values.size());
+        double power = squares / static_cast<double>(quarter.values.size());
+        // TPDF of +-1 LSB plus rounding: total error power about 1/4 LSB^2
+        if (!expect(std::fabs(mean - 0.25) < 0.01, name, "dither leaves the quantizer biased") ||
+            !expect(power > 0.15 && power < 0.35, name, "dither error power is not TPDF-like")) {
+            printf("format_converter_check: %s: mean %.4f, error power %.4f LSB^2\n", name, mean, power);
+        }
+    }
+    printf("%s: ok\n", name);
+}
+
+// Pairs without a direct kernel go through float in chunks of the scratch buffer
+void checkViaFloat(SampleFormat source, SampleFormat target, const char* caseName) {
+    FormatConverter converter;
+    const int32_t maxSamples = 1000;
+    if (!expect(converter.configure(source, target, maxSamples, false), caseName, "configure failed")) {
+        return;
+    }
+    const Samples samples = makeSamples(source);
+    const size_t count = samples.values.size();
+    std::vector<uint8_t> output(count * static_cast<size_t>(getBytesPerSample(target)));
+    converter.convert(samples.bytes.data(), output.data(), static_cast<int32_t>(count));
+    for (size_t i = 0; i < count; i++) {
+        // The value rounded to float on the way, then quantized
+        double value = static_cast<float>(samples.values[i]);
+        if (!expect(outputSample(target, output.data(), i) == expectedSample(target, value), caseName,
+                    "conversion through float differs from the reference")) {
+            return;
+        }
+    }
+    printf("%s: ok\n", caseName);
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Samples/ns of a kernel over a callback-sized block kept in cache, best of a few timed batches
+double measureKernel(FormatConverter::Kernel kernel, const KernelCase& kernelCase, int32_t milliseconds) {
+    const int32_t count = 4096;
+    std::vector<uint8_t> source(static_cast<size_t>(count) * 4);
+    std::vector<uint8_t> target(static_cast<size_t>(count) * 4);
+    if (kernelCase.source == SampleFormat::Float) {
+        Random random(9);
+        for (int32_t i = 0; i < count; i++) {
+            auto sample = static_cast<float>(random.uniform(-1.0, 1.0));
+            memcpy(source.data() + i * 4, &sample, sizeof(sample));
+        }
+    }
+    uint32_t ditherState[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    double best = 0.0;
+    const uint64_t endNs = nowNs() + static_cast<uint64_t>(milliseconds) * 1000000;
+    while (nowNs() < endNs) {
+        const int32_t batch = 64;
+        uint64_t beginNs = nowNs();
+        for (int32_t i = 0; i < batch; i++) {
+            kernel(source.data(), target.data(), count, ditherState);
+        }
+        uint64_t elapsedNs = std::max<uint64_t>(nowNs() - beginNs, 1);
+        best = std::max(best, static_cast<double>(batch) * count / static_cast<double>(elapsedNs));
+    }
+    return best;
+}
+
+void benchmark(const std::vector<FormatConverter::Isa>& isas, int32_t milliseconds) {
+    for (const KernelCase& kernelCase : kKernelCases) {
+        double scalar = 0.0;
+        for (FormatConverter::Isa isa : isas) {
+            FormatConverter::Kernel kernel =
+                FormatConverter::findKernel(kernelCase.source, kernelCase.target, kernelCase.dither, isa);
+            double rate = measureKernel(kernel, kernelCase, milliseconds);
+            if (isa == FormatConverter::Isa::Scalar) {
+                scalar = rate;
+            }
+            printf("%-18s %-6s %7.3f samples/ns  %5.2fx scalar\n", kernelCase.name, FormatConverter::getIsaName(isa),
+                   rate, scalar > 0.0 ? rate / scalar : 0.0);
+        }
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Also benchmark every kernel against the scalar reference\n"
+            "  -m <ms>       Time per kernel and instruction set for -b, default 200\n"
+            "  -v            Keep the converter's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool bench = false;
+    int32_t milliseconds = 200;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-m") == 0 && index + 1 < argc && atoi(argv[index + 1]) > 0) {
+            milliseconds = atoi(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // configure() logs every selection
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    std::vector<FormatConverter::Isa> isas;
+    for (FormatConverter::Isa isa : kIsas) {
+        if (isIsaAvailable(isa)) {
+            isas.push_back(isa);
+        }
+    }
+    for (const KernelCase& kernelCase : kKernelCases) {
+        for (FormatConverter::Isa isa : isas) {
+            checkKernel(kernelCase, isa);
+        }
+    }
+    checkViaFloat(SampleFormat::U8, SampleFormat::I32, "u8->i32 via float");
+    checkViaFloat(SampleFormat::I24Packed, SampleFormat::I16, "i24->i16 via float");
+    checkViaFloat(SampleFormat::I32, SampleFormat::I16, "i32->i16 via float");
+
+    if (bench) {
+        benchmark(isas, milliseconds);
+    }
+    if (failures > 0) {
+        printf("format_converter_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "latency_estimator.h"
+#include "audio_log.h"
+#include "audio_sink.h"
+#include "callback_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <pthread.h>
+
+void LatencyEstimator::RunningStat::add(double value) {
+    count++;
+    if (count == 1) {
+        min = value;
+        max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    double delta = value - mean;
+    mean += delta / static_cast<double>(count);
+    m2 += delta * (value - mean);
+}
+
+LatencyEstimator::Summary LatencyEstimator::RunningStat::getSummary() const {
+    Summary summary;
+    summary.count = count;
+    summary.mean = mean;
+    summary.stdDev = count > 1 ? std::sqrt(m2 / static_cast<double>(count - 1)) : 0;
+    summary.min = min;
+    summary.max = max;
+    return summary;
+}
+
+LatencyEstimator::~LatencyEstimator() noexcept { stop(); }
+
+void LatencyEstimator::setOptions(const Options& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    options_.sampleIntervalMs = std::max(options_.sampleIntervalMs, 1);
+    options_.driftWindowMs = std::max(options_.driftWindowMs, 1);
+    options_.logIntervalMs = std::max(options_.logIntervalMs, 0);
+}
+
+bool LatencyEstimator::start(AudioSink* sink) {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!options_.enabled || !sink) {
+            return false;
+        }
+    }
+    beginStream(sink->getSampleRate());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    sink_ = sink;
+    running_ = true;
+    thread_ = std::thread(&LatencyEstimator::samplerLoop, this);
+    return true;
+}
+
+void LatencyEstimator::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
+    }
+    wakeup_.notify_all();
+
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    sink_ = nullptr;
+    logSummary("stream closed");
+}
+
+void LatencyEstimator::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencyMs_ = RunningStat();
+    driftPpm_ = RunningStat();
+    rejected_ = 0;
+}
+
+void LatencyEstimator::beginStream(int32_t sampleRate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sampleRate_ = sampleRate;
+    referenceFrame_ = -1;
+    referenceNs_ = 0;
+    lastFrame_ = -1;
+}
+
+bool LatencyEstimator::addSample(int64_t framesWritten,
+                                 int64_t writeTimeNs,
+                                 int64_t presentedFrame,
+                                 int64_t presentedTimeNs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (sampleRate_ <= 0 || presentedFrame < lastFrame_) {
+        rejected_++;
+        return false;
+    }
+    lastFrame_ = presentedFrame;
+
+    // When the newest frame will be heard, relative to when it was written
+    double pendingNs = static_cast<double>(framesWritten - presentedFrame) * 1e9 / sampleRate_;
+    double latencyNs = static_cast<double>(presentedTimeNs - writeTimeNs) + pendingNs;
+    if (latencyNs < 0) {
+        rejected_++;
+        return false;
+    }
+    latencyMs_.add(latencyNs / 1e6);
+
+    if (referenceFrame_ < 0) {
+        referenceFrame_ = presentedFrame;
+        referenceNs_ = presentedTimeNs;
+        return true;
+    }
+    int64_t spanNs = presentedTimeNs - referenceNs_;
+    if (spanNs < static_cast<int64_t>(options_.driftWindowMs) * 1000000) {
+        return true;
+    }
+
+    double measuredRate = static_cast<double>(presentedFrame - referenceFrame_) * 1e9 / static_cast<double>(spanNs);
+    double driftPpm = (measuredRate / sampleRate_ - 1.0) * 1e6;
+    referenceFrame_ = presentedFrame;
+    referenceNs_ = presentedTimeNs;
+    if (std::fabs(driftPpm) > kMaxDriftPpm) {
+        rejected_++;
+        return false;
+    }
+    driftPpm_.add(driftPpm);
+    return true;
+}
+
+LatencyEstimator::Stats LatencyEstimator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats;
+    stats.latencyMs = latencyMs_.getSummary();
+    stats.driftPpm = driftPpm_.getSummary();
+    stats.rejected = rejected_;
+    return stats;
+}
+
+void LatencyEstimator::samplerLoop() {
+    pthread_setname_np(pthread_self(), "aap-latency");
+
+    uint64_t lastLogNs = CallbackStats::nowNs();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        int32_t intervalMs = options_.sampleIntervalMs;
+        uint64_t logIntervalNs = static_cast<uint64_t>(options_.logIntervalMs) * 1000000ULL;
+        lock.unlock();
+
+        // Timestamp first, then the write position as close as possible to the clock read
+        int64_t presentedFrame = 0;
+        int64_t presentedTimeNs = 0;
+        if (sink_->getTimestamp(&presentedFrame, &presentedTimeNs)) {
+            int64_t framesWritten = sink_->getFramesWritten();
+            auto now = static_cast<int64_t>(CallbackStats::nowNs());
+            addSample(framesWritten, now, presentedFrame, presentedTimeNs);
+        }
+
+        uint64_t now = CallbackStats::nowNs();
+        if (logIntervalNs > 0 && now - lastLogNs >= logIntervalNs) {
+            logSummary("running");
+            lastLogNs = now;
+        }
+
+        lock.lock();
+        if (running_) {
+            wakeup_.wait_for(lock, std::chrono::milliseconds(intervalMs));
+        }
+    }
+}
+
+void LatencyEstimator::logSummary(const char* when) const {
+    Stats stats = getStats();
+    if (stats.latencyMs.count == 0) {
+        return;
+    }
+    LOGI("Output latency (%s): mean=%.2fms sd=%.2fms min=%.2fms max=%.2fms n=%llu, "
+         "drift=%.1fppm sd=%.1fppm n=%llu, rejected=%llu",
+         when, stats.latencyMs.mean, stats.latencyMs.stdDev, stats.latencyMs.min, stats.latencyMs.max,
+         static_cast<unsigned long long>(stats.latencyMs.count), stats.driftPpm.mean, stats.driftPpm.stdDev,
+         static_cast<unsigned long long>(stats.driftPpm.count), static_cast<unsigned long long>(stats.rejected));
+}
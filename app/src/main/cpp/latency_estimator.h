@@ -0,0 +1,134 @@
+#ifndef LATENCY_ESTIMATOR_H
+#define LATENCY_ESTIMATOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+class AudioSink;
+
+/**
+ * Output latency and device clock drift from stream timestamps
+ *
+ * A sampler thread periodically reads the stream's presentation timestamp
+ * (frame P was heard at time Tp) together with the frames written so far (W)
+ * at time Tw. The last written frame is heard at Tp + (W - P) / rate, so its
+ * latency is that minus Tw. Drift compares how many frames the device
+ * presented over a window of at least driftWindowMs with the nominal rate.
+ *
+ * Both are kept as running mean/variance/min/max and logged periodically,
+ * no GPIO or measuring equipment is needed. addSample() holds all the math
+ * and can be fed synthetic timestamps on a host.
+ */
+class LatencyEstimator {
+public:
+    struct Options {
+        bool enabled = true;
+        int32_t sampleIntervalMs = 100;
+        int32_t driftWindowMs = 2000; // Shortest span for one drift sample
+        int32_t logIntervalMs = 10000; // 0 logs only when stopping
+    };
+
+    struct Summary {
+        uint64_t count = 0;
+        double mean = 0;
+        double stdDev = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    struct Stats {
+        Summary latencyMs;  // Write to presentation of the newest frame
+        Summary driftPpm;   // Device clock vs nominal rate, positive runs fast
+        uint64_t rejected = 0; // Timestamps that went backwards, implied negative latency or a jump
+    };
+
+    // Larger apparent drift means the position jumped (underrun, route change), not a clock error
+    static constexpr double kMaxDriftPpm = 1000.0;
+
+    LatencyEstimator() = default;
+
+    /**
+     * Destructor, stops the sampler thread
+     */
+    ~LatencyEstimator() noexcept;
+
+    // Disable copy and assignment
+    LatencyEstimator(const LatencyEstimator&) = delete;
+    LatencyEstimator& operator=(const LatencyEstimator&) = delete;
+
+    /**
+     * Set the sampling policy, applied on the next start()
+     */
+    void setOptions(const Options& options);
+
+    /**
+     * Start sampling an opened stream, statistics keep accumulating across streams
+     * @param sink Opened stream, must stay open until stop()
+     * @return Returns false if disabled
+     */
+    bool start(AudioSink* sink);
+
+    /**
+     * Stop the sampler thread (blocking) and log the summary
+     */
+    void stop();
+
+    /**
+     * Clear the statistics
+     */
+    void clear();
+
+    /**
+     * Start a new timestamp sequence, e.g. for another stream
+     * @param sampleRate Nominal stream rate
+     */
+    void beginStream(int32_t sampleRate);
+
+    /**
+     * Add one observation
+     * @param framesWritten Frames handed to the stream so far
+     * @param writeTimeNs When framesWritten was read
+     * @param presentedFrame Frame position of the stream timestamp
+     * @param presentedTimeNs Presentation time of presentedFrame, same clock as writeTimeNs
+     * @return Returns false if the observation was rejected
+     */
+    bool addSample(int64_t framesWritten, int64_t writeTimeNs, int64_t presentedFrame, int64_t presentedTimeNs);
+
+    Stats getStats() const;
+
+private:
+    // Welford's running mean and variance
+    struct RunningStat {
+        uint64_t count = 0;
+        double mean = 0;
+        double m2 = 0;
+        double min = 0;
+        double max = 0;
+
+        void add(double value);
+        Summary getSummary() const;
+    };
+
+    void samplerLoop();
+    void logSummary(const char* when) const;
+
+    std::thread thread_;
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool running_ = false;
+    Options options_;
+    AudioSink* sink_ = nullptr;
+
+    // Guarded by mutex_
+    int32_t sampleRate_ = 0;
+    int64_t referenceFrame_ = -1; // Start of the current drift window
+    int64_t referenceNs_ = 0;
+    int64_t lastFrame_ = -1;
+    RunningStat latencyMs_;
+    RunningStat driftPpm_;
+    uint64_t rejected_ = 0;
+};
+
+#endif // LATENCY_ESTIMATOR_H
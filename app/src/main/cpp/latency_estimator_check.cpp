@@ -0,0 +1,277 @@
+// Host check of LatencyEstimator: its sampler thread reads a synthetic stream whose output latency and clock drift
+// are known, the estimated mean latency and drift must match them, and timestamps that go backwards, imply negative
+// latency or jump more than kMaxDriftPpm must be rejected without touching the statistics.
+#include "latency_estimator.h"
+#include "audio_sink.h"
+#include "callback_stats.h"
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("latency_estimator_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kBurstFrames = 192;
+
+/**
+ * Stream timeline of a device whose clock runs driftPpm off the nominal rate
+ *
+ * Frames are presented at sampleRate * (1 + drift) from the start, every frame written is heard latencyMs later. The
+ * timestamp is the last burst boundary presented, stamped with its exact time, like a device reports it; the written
+ * position is whole frames. From the first timestamp after jumpAtMs both positions are jumpFrames ahead, like after
+ * an underrun.
+ */
+class SyntheticSink : public AudioSink {
+public:
+    struct Timeline {
+        double latencyMs = 0;
+        double driftPpm = 0;
+        int32_t jumpAtMs = -1;
+        int64_t jumpFrames = 0;
+    };
+
+    explicit SyntheticSink(const Timeline& timeline)
+        : timeline_(timeline),
+          framesPerNs_(kSampleRate * (1.0 + timeline.driftPpm / 1e6) / 1e9),
+          startNs_(static_cast<int64_t>(CallbackStats::nowNs())) {}
+
+    bool open(const AudioSinkConfig& /*config*/,
+              DataCallback /*dataCallback*/,
+              ErrorCallback /*errorCallback*/,
+              void* /*userData*/) override {
+        return true;
+    }
+    bool start() override { return true; }
+    bool stop() override { return true; }
+    void close() override {}
+    bool isOpen() const override { return true; }
+    int32_t getSampleRate() const override { return kSampleRate; }
+    int32_t getChannelCount() const override { return 2; }
+    SampleFormat getFormat() const override { return SampleFormat::Float; }
+    int32_t getFramesPerBurst() const override { return kBurstFrames; }
+    int32_t getBufferSizeInFrames() const override { return 2 * kBurstFrames; }
+    int32_t getBufferCapacityInFrames() const override { return 8 * kBurstFrames; }
+    int32_t setBufferSizeInFrames(int32_t numFrames) override { return numFrames; }
+    int32_t getXRunCount() const override { return 0; }
+
+    int64_t getFramesWritten() const override {
+        int64_t nowNs = static_cast<int64_t>(CallbackStats::nowNs());
+        double latencyNs = timeline_.latencyMs * 1e6;
+        return static_cast<int64_t>(std::floor((static_cast<double>(nowNs - startNs_) + latencyNs) * framesPerNs_)) +
+               jump_;
+    }
+
+    bool getTimestamp(int64_t* framePosition, int64_t* timeNs) const override {
+        int64_t nowNs = static_cast<int64_t>(CallbackStats::nowNs());
+        if (timeline_.jumpAtMs >= 0 && nowNs - startNs_ >= timeline_.jumpAtMs * INT64_C(1000000)) {
+            jump_ = timeline_.jumpFrames;
+        }
+        auto presented = static_cast<int64_t>(static_cast<double>(nowNs - startNs_) * framesPerNs_);
+        if (presented < kBurstFrames) {
+            return false;
+        }
+        int64_t frame = presented / kBurstFrames * kBurstFrames;
+        *framePosition = frame + jump_;
+        *timeNs = startNs_ + static_cast<int64_t>(std::llround(static_cast<double>(frame) / framesPerNs_));
+        return true;
+    }
+
+    const char* convertErrorToText(int32_t /*error*/) const override { return "synthetic"; }
+    const char* getName() const override { return "Synthetic"; }
+
+private:
+    const Timeline timeline_;
+    const double framesPerNs_;
+    const int64_t startNs_;
+    // Read by the estimator's sampler thread only, timestamp first
+    mutable int64_t jump_ = 0;
+};
+
+struct TimelineCase {
+    const char* name;
+    SyntheticSink::Timeline timeline;
+    uint64_t rejected;
+};
+
+// Latency tolerance: the written position is whole frames, the drift scales the latency by 1 + drift, and the host
+// may preempt the sampler between reading the positions and the clock
+constexpr double kLatencyToleranceMs = 0.05;
+// Drift tolerance: timestamps are exact, only nanosecond rounding remains
+constexpr double kDriftTolerancePpm = 0.5;
+
+void checkTimeline(const TimelineCase& timelineCase) {
+    const char* name = timelineCase.name;
+    SyntheticSink sink(timelineCase.timeline);
+    LatencyEstimator estimator;
+    LatencyEstimator::Options options;
+    options.sampleIntervalMs = 2;
+    options.driftWindowMs = 100;
+    options.logIntervalMs = 0;
+    estimator.setOptions(options);
+    if (!expect(estimator.start(&sink), name, "estimator did not start")) {
+        return;
+    }
+    // At least eight drift windows, and the jump well behind
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    LatencyEstimator::Stats stats;
+    do {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stats = estimator.getStats();
+    } while ((stats.driftPpm.count < 8 || stats.rejected < timelineCase.rejected) &&
+             std::chrono::steady_clock::now() < deadline);
+    estimator.stop();
+    stats = estimator.getStats();
+
+    char what[160];
+    snprintf(what, sizeof(what), "latency mean %.4f ms (sd %.4f, %" PRIu64 " samples), expected %.4f ms",
+             stats.latencyMs.mean, stats.latencyMs.stdDev, stats.latencyMs.count, timelineCase.timeline.latencyMs);
+    if (!expect(stats.latencyMs.count >= 100 &&
+                    std::fabs(stats.latencyMs.mean - timelineCase.timeline.latencyMs) <= kLatencyToleranceMs,
+                name, what)) {
+        return;
+    }
+    snprintf(what, sizeof(what), "drift mean %.3f ppm (%.3f..%.3f, %" PRIu64 " windows), expected %.1f ppm",
+             stats.driftPpm.mean, stats.driftPpm.min, stats.driftPpm.max, stats.driftPpm.count,
+             timelineCase.timeline.driftPpm);
+    if (!expect(stats.driftPpm.count >= 8 &&
+                    std::fabs(stats.driftPpm.min - timelineCase.timeline.driftPpm) <= kDriftTolerancePpm &&
+                    std::fabs(stats.driftPpm.max - timelineCase.timeline.driftPpm) <= kDriftTolerancePpm,
+                name, what)) {
+        return;
+    }
+    snprintf(what, sizeof(what), "%" PRIu64 " timestamps rejected, expected %" PRIu64, stats.rejected,
+             timelineCase.rejected);
+    // A jump spoils only the drift window it falls into
+    if (!expect(stats.rejected == timelineCase.rejected, name, what)) {
+        return;
+    }
+    printf("%s: latency %.3f ms (sd %.4f), drift %.2f ppm (sd %.3f, %" PRIu64 " windows), %" PRIu64 " rejected: ok\n",
+           name, stats.latencyMs.mean, stats.latencyMs.stdDev, stats.driftPpm.mean, stats.driftPpm.stdDev,
+           stats.driftPpm.count, stats.rejected);
+}
+
+/**
+ * Feed one observation of a stream presenting at exactly the nominal rate, 20 ms latency
+ * @param ms Presentation time of the timestamp
+ * @param frameOffset Added to the presented position
+ * @param latencyFrames Written ahead of the presented position
+ */
+bool feed(LatencyEstimator& estimator, int64_t ms, int64_t frameOffset = 0, int64_t latencyFrames = 960) {
+    int64_t frame = ms * (kSampleRate / 1000) + frameOffset;
+    return estimator.addSample(frame + latencyFrames, ms * 1000000, frame, ms * 1000000);
+}
+
+bool sameStats(const LatencyEstimator::Stats& a, const LatencyEstimator::Stats& b) {
+    return a.latencyMs.count == b.latencyMs.count && a.latencyMs.mean == b.latencyMs.mean &&
+           a.driftPpm.count == b.driftPpm.count && a.driftPpm.mean == b.driftPpm.mean;
+}
+
+// Observations fed by hand over 1 s drift windows, where one frame is 20.83 ppm: each bad one is rejected, counted
+// and leaves the statistics alone
+void checkRejection() {
+    const char* name = "rejection";
+    const int32_t failuresBefore = failures;
+    LatencyEstimator estimator;
+    LatencyEstimator::Options options;
+    options.driftWindowMs = 1000;
+    estimator.setOptions(options);
+
+    expect(!feed(estimator, 0), name, "accepted a sample before the stream rate was known");
+    estimator.beginStream(kSampleRate);
+    expect(feed(estimator, 0) && feed(estimator, 1000), name, "rejected a clean sample");
+    LatencyEstimator::Stats clean = estimator.getStats();
+    expect(clean.latencyMs.count == 2 && clean.latencyMs.mean == 20.0 && clean.driftPpm.count == 1 &&
+               clean.driftPpm.mean == 0.0 && clean.rejected == 1,
+           name, "clean samples not counted");
+
+    // Position went backwards, 1 frame behind the last one
+    bool rejected = !feed(estimator, 1500, -24001);
+    // Newest frame heard before it was written: written behind the presented position
+    rejected = !feed(estimator, 1500, 0, -96) && rejected;
+    LatencyEstimator::Stats stats = estimator.getStats();
+    expect(rejected && stats.rejected == 3 && sameStats(stats, clean), name,
+           "backwards or negative latency sample not rejected, or counted");
+
+    // 49 frames ahead after a window is 1020.8 ppm: a jump, its latency still counts
+    rejected = !feed(estimator, 2000, 49);
+    stats = estimator.getStats();
+    expect(rejected && stats.rejected == 4 && stats.latencyMs.count == 3 && stats.driftPpm.count == 1, name,
+           "1020.8 ppm drift not rejected");
+    // 45 more is 937.5 ppm, still a clock
+    bool accepted = feed(estimator, 3000, 49 + 45);
+    stats = estimator.getStats();
+    char what[96];
+    snprintf(what, sizeof(what), "937.5 ppm drift not kept: %.3f ppm, %" PRIu64 " windows", stats.driftPpm.max,
+             stats.driftPpm.count);
+    expect(accepted && stats.driftPpm.count == 2 && std::fabs(stats.driftPpm.max - 937.5) < 1e-6, name, what);
+    expect(stats.rejected == 4, name, "a clean sample counted as rejected");
+
+    // A new stream may start over at frame 0
+    estimator.beginStream(kSampleRate);
+    expect(feed(estimator, 0), name, "new stream did not restart the sequence");
+    if (failures == failuresBefore) {
+        printf("%s: ok\n", name);
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -v            Keep the estimator's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    checkRejection();
+    const TimelineCase timelines[] = {
+        {"20 ms, exact clock", {20.0, 0.0, -1, 0}, 0},
+        {"35 ms, +250 ppm", {35.0, 250.0, -1, 0}, 0},
+        {"12 ms, -400 ppm", {12.0, -400.0, -1, 0}, 0},
+        // 10 ms skipped at once is 100000 ppm over one window
+        {"20 ms, +100 ppm, position jump", {20.0, 100.0, 450, 480}, 1},
+    };
+    for (const TimelineCase& timelineCase : timelines) {
+        checkTimeline(timelineCase);
+    }
+
+    if (failures > 0) {
+        printf("latency_estimator_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "latency_marker.h"
+#include "audio_log.h"
+#include "callback_stats.h"
+#include "dsp_chain.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+bool LatencyMarker::prepare(const Options& options, int32_t sampleRate, int32_t channelCount, SampleFormat format) {
+    release();
+    if (!options.enabled) {
+        return true;
+    }
+    if (sampleRate <= 0 || channelCount <= 0 ||
+        !fromFloat_.configure(SampleFormat::Float, format, kChunkFrames * channelCount, false)) {
+        LOGE("Latency marker: cannot mark %dHz %dch format %d", sampleRate, channelCount,
+             static_cast<int32_t>(format));
+        return false;
+    }
+
+    options_ = options;
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    bytesPerFrame_ = channelCount * getBytesPerSample(format);
+    format_ = format;
+    periodFrames_ = std::max<int64_t>(static_cast<int64_t>(options.periodMs) * sampleRate / 1000, 2);
+    durationFrames_ = options.type == Type::Click
+                          ? 1
+                          : std::min(std::max<int64_t>(static_cast<int64_t>(options.durationMs) * sampleRate / 1000, 1),
+                                     periodFrames_ / 2);
+    muteFadeFrames_ = options.type == Type::MuteWindow
+                          ? std::min(static_cast<int64_t>(kMuteFadeMs) * sampleRate / 1000, periodFrames_ / 4)
+                          : 0;
+    scratch_.reset(new float[static_cast<size_t>(kChunkFrames) * channelCount]);
+
+    switch (options.trigger) {
+    case Trigger::SysfsGpio:
+        trigger_.reset(new FdTrigger(options.triggerPath));
+        break;
+    case Trigger::Fd:
+        trigger_.reset(new FdTrigger(options.triggerFd, FdTrigger::Encoding::Level));
+        break;
+    case Trigger::Pipe:
+        trigger_.reset(new FdTrigger(options.triggerFd, FdTrigger::Encoding::Event));
+        break;
+    default:
+        break;
+    }
+    if (trigger_ && !trigger_->open()) {
+        LOGE("Latency marker: trigger unavailable, markers are only recorded");
+        trigger_.reset();
+    }
+
+    // First marker one period in, past the stream start-up; the trigger starts low
+    frame_ = 0;
+    nextMarkerFrame_ = periodFrames_;
+    windowStart_ = 0;
+    windowEnd_ = 0;
+    markerIndex_ = 0;
+    level_ = 0;
+    recordCount_.store(0, std::memory_order_release);
+    if (trigger_ && options.trigger != Trigger::Pipe) {
+        MarkerEvent initial;
+        trigger_->fire(initial);
+    }
+
+    enabled_ = true;
+    LOGI("Latency marker: %s every %dms (%lld frames), duration %lld frames, trigger=%s", getTypeName(options.type),
+         options.periodMs, static_cast<long long>(periodFrames_), static_cast<long long>(durationFrames_),
+         trigger_ ? trigger_->getName() : "memory");
+    return true;
+}
+
+void LatencyMarker::process(void* audioData, int32_t numFrames) {
+    if (!enabled_ || numFrames <= 0) {
+        return;
+    }
+    auto output = static_cast<uint8_t*>(audioData);
+    int64_t bufferStart = frame_;
+    int64_t bufferEnd = frame_ + numFrames;
+
+    // Rest of a marker that started in an earlier buffer
+    render(output, bufferStart, std::max(windowStart_, bufferStart), std::min(windowEnd_, bufferEnd));
+    renderMuteFades(output, bufferStart, bufferEnd);
+
+    while (nextMarkerFrame_ < bufferEnd) {
+        placeMarker(nextMarkerFrame_, bufferStart);
+        render(output, bufferStart, windowStart_, std::min(windowEnd_, bufferEnd));
+        nextMarkerFrame_ += periodFrames_;
+        renderMuteFades(output, bufferStart, bufferEnd);
+    }
+    frame_ = bufferEnd;
+}
+
+void LatencyMarker::release() {
+    enabled_ = false;
+    if (trigger_) {
+        trigger_->close();
+        trigger_.reset();
+    }
+}
+
+std::vector<MarkerEvent> LatencyMarker::getRecords() const {
+    uint64_t count = recordCount_.load(std::memory_order_acquire);
+    uint64_t first = count > kMaxRecords ? count - kMaxRecords : 0;
+    std::vector<MarkerEvent> records;
+    records.reserve(static_cast<size_t>(count - first));
+    for (uint64_t i = first; i < count; i++) {
+        records.push_back(records_[i % kMaxRecords]);
+    }
+
+    // Drop the entries the audio thread may have overwritten while copying
+    uint64_t after = recordCount_.load(std::memory_order_acquire);
+    if (after < count) {
+        return {};
+    }
+    uint64_t stale = after > kMaxRecords ? after - kMaxRecords : 0;
+    if (stale > first) {
+        auto dropped = static_cast<ptrdiff_t>(std::min(stale - first, count - first));
+        records.erase(records.begin(), records.begin() + dropped);
+    }
+    return records;
+}
+
+const char* LatencyMarker::getTypeName(Type type) {
+    switch (type) {
+    case Type::Click:
+        return "click";
+    case Type::ToneBurst:
+        return "tone burst";
+    default:
+        return "mute window";
+    }
+}
+
+void LatencyMarker::placeMarker(int64_t edgeFrame, int64_t bufferStart) {
+    level_ ^= 1;
+    MarkerEvent event;
+    event.index = markerIndex_++;
+    event.frame = edgeFrame;
+    event.offset = static_cast<int32_t>(edgeFrame - bufferStart);
+    event.level = level_;
+    event.timeNs = CallbackStats::nowNs();
+    if (trigger_) {
+        trigger_->fire(event);
+    }
+
+    uint64_t count = recordCount_.load(std::memory_order_relaxed);
+    records_[count % kMaxRecords] = event;
+    recordCount_.store(count + 1, std::memory_order_release);
+
+    windowStart_ = edgeFrame;
+    windowEnd_ = edgeFrame + durationFrames_;
+}
+
+// Replace stream frames [from, to) of the buffer starting at stream frame bufferStart with the marker
+void LatencyMarker::render(uint8_t* audioData, int64_t bufferStart, int64_t from, int64_t to) {
+    if (from >= to) {
+        return;
+    }
+    uint8_t* target = audioData + (from - bufferStart) * bytesPerFrame_;
+    if (options_.type == Type::MuteWindow) {
+        memset(target, 0, static_cast<size_t>(to - from) * bytesPerFrame_);
+        return;
+    }
+
+    const float amplitude = options_.amplitude;
+    const double phaseStep = 2.0 * M_PI * options_.toneHz / sampleRate_;
+    for (int64_t chunkStart = from; chunkStart < to; chunkStart += kChunkFrames) {
+        auto frames = static_cast<int32_t>(std::min<int64_t>(to - chunkStart, kChunkFrames));
+        for (int32_t i = 0; i < frames; i++) {
+            // Tone phase counts from the edge, so every burst starts at a zero crossing going up
+            float value = options_.type == Type::Click
+                              ? amplitude
+                              : amplitude * static_cast<float>(std::sin(phaseStep * (chunkStart + i - windowStart_)));
+            std::fill_n(scratch_.get() + i * channelCount_, channelCount_, value);
+        }
+        fromFloat_.convert(scratch_.get(), target, frames * channelCount_);
+        target += static_cast<size_t>(frames) * bytesPerFrame_;
+    }
+}
+
+// Fade the program back in after the current window and out towards the next edge, within this buffer
+void LatencyMarker::renderMuteFades(uint8_t* audioData, int64_t bufferStart, int64_t bufferEnd) {
+    if (muteFadeFrames_ <= 0) {
+        return;
+    }
+    const float step = 1.0f / static_cast<float>(muteFadeFrames_ + 1);
+
+    if (markerIndex_ > 0) {
+        int64_t from = std::max(windowEnd_, bufferStart);
+        int64_t to = std::min(windowEnd_ + muteFadeFrames_, bufferEnd);
+        if (from < to) {
+            DspChain::applyGainRamp(format_, channelCount_, audioData + (from - bufferStart) * bytesPerFrame_,
+                                    static_cast<int32_t>(to - from), static_cast<float>(from - windowEnd_ + 1) * step,
+                                    step);
+        }
+    }
+
+    int64_t from = std::max(nextMarkerFrame_ - muteFadeFrames_, bufferStart);
+    int64_t to = std::min(nextMarkerFrame_, bufferEnd);
+    if (from < to) {
+        DspChain::applyGainRamp(format_, channelCount_, audioData + (from - bufferStart) * bytesPerFrame_,
+                                static_cast<int32_t>(to - from), static_cast<float>(nextMarkerFrame_ - from) * step,
+                                -step);
+    }
+}
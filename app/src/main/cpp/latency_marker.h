@@ -0,0 +1,128 @@
+#ifndef LATENCY_MARKER_H
+#define LATENCY_MARKER_H
+
+#include "audio_format.h"
+#include "format_converter.h"
+#include "marker_trigger.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Latency markers for measuring the output path with external equipment
+ *
+ * Every period a marker is written into the output buffer and a trigger is
+ * fired from the same callback. The marker edge sits at an exact stream
+ * frame, wherever it falls inside the buffer, and its frame and in-buffer
+ * offset are recorded; the delay between trigger and audible edge minus
+ * offset / rate is the output latency, with sample instead of burst
+ * resolution.
+ *
+ * Markers: a muted window, a single-frame click or a sine tone burst, each
+ * replacing the program audio. The program fades out into the muted window
+ * and back in after it, so the window itself does not click; the fade out
+ * ends exactly at the edge. Triggers: a sysfs GPIO value file, a file
+ * descriptor (level) or a pipe (binary MarkerEvent); the record of the last
+ * markers is always kept in memory, which is all a host test needs.
+ */
+class LatencyMarker {
+public:
+    enum class Type : int32_t {
+        MuteWindow,
+        Click,
+        ToneBurst,
+    };
+
+    enum class Trigger : int32_t {
+        Memory,    // Record only
+        SysfsGpio, // Level written to triggerPath
+        Fd,        // Level written to triggerFd
+        Pipe,      // MarkerEvent written to triggerFd, the write end of a pipe
+    };
+
+    struct Options {
+        bool enabled = false;
+        Type type = Type::MuteWindow;
+        Trigger trigger = Trigger::Memory;
+        std::string triggerPath = "/sys/class/gpio/gpio376/value";
+        int32_t triggerFd = -1;  // Duplicated when the stream is prepared
+        int32_t periodMs = 1000; // Time between marker edges
+        int32_t durationMs = 50; // Mute window or tone burst length, at most half the period
+        float toneHz = 1000.0f;
+        float amplitude = 0.5f; // Click and tone level, full scale is 1
+    };
+
+    static constexpr size_t kMaxRecords = 128;
+
+    LatencyMarker() = default;
+    ~LatencyMarker() noexcept { release(); }
+
+    // Disable copy and assignment
+    LatencyMarker(const LatencyMarker&) = delete;
+    LatencyMarker& operator=(const LatencyMarker&) = delete;
+
+    /**
+     * Configure for a new stream and open the trigger (not real-time safe)
+     * A trigger that cannot be opened leaves the markers recorded in memory only.
+     * @return Returns false if the stream format cannot carry markers
+     */
+    bool prepare(const Options& options, int32_t sampleRate, int32_t channelCount, SampleFormat format);
+
+    /**
+     * Place the markers falling into this buffer (real-time safe, audio thread)
+     * @param audioData Rendered output in the stream format, modified in place
+     */
+    void process(void* audioData, int32_t numFrames);
+
+    /**
+     * Stop marking and close the trigger, the stream must be stopped
+     */
+    void release();
+
+    bool isEnabled() const { return enabled_; }
+
+    /**
+     * Get the recent markers of the current stream, oldest first, safe while playing
+     */
+    std::vector<MarkerEvent> getRecords() const;
+
+    static const char* getTypeName(Type type);
+
+private:
+    static constexpr int32_t kChunkFrames = 256;
+
+    // Fade around a mute window, capped to a quarter period so fades of neighbouring windows never overlap
+    static constexpr int32_t kMuteFadeMs = 2;
+
+    void placeMarker(int64_t edgeFrame, int64_t bufferStart);
+    void render(uint8_t* audioData, int64_t bufferStart, int64_t from, int64_t to);
+    void renderMuteFades(uint8_t* audioData, int64_t bufferStart, int64_t bufferEnd);
+
+    bool enabled_ = false;
+    Options options_;
+    std::unique_ptr<MarkerTrigger> trigger_;
+    int32_t sampleRate_ = 0;
+    int32_t channelCount_ = 0;
+    int32_t bytesPerFrame_ = 0;
+    SampleFormat format_ = SampleFormat::Unspecified;
+    int64_t periodFrames_ = 0;
+    int64_t durationFrames_ = 0;
+    int64_t muteFadeFrames_ = 0;
+
+    // Audio thread
+    int64_t frame_ = 0; // Stream frame at the start of the next buffer
+    int64_t nextMarkerFrame_ = 0;
+    int64_t windowStart_ = 0; // Frames of the current marker, may span buffers
+    int64_t windowEnd_ = 0;
+    int64_t markerIndex_ = 0;
+    int32_t level_ = 0;
+    FormatConverter fromFloat_;
+    std::unique_ptr<float[]> scratch_;
+
+    MarkerEvent records_[kMaxRecords];
+    std::atomic<uint64_t> recordCount_{0};
+};
+
+#endif // LATENCY_MARKER_H
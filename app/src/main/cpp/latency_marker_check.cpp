@@ -0,0 +1,410 @@
+// Host check of LatencyMarker: program audio is marked in callbacks of random size, cut right at and right after marker
+// edges, and every output frame is compared with a model of the stream. Mute windows, clicks and tone bursts must start
+// on their exact stream frame, the mute fades must ramp towards and away from the window, every frame outside a marker
+// and its fades must be bit-exact with the program, and the records must name the frame and buffer offset of each
+// edge. The Pipe trigger must deliver every MarkerEvent, in order, beyond what the record ring keeps.
+#include "latency_marker.h"
+#include "audio_format.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("latency_marker_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, deterministic program audio and callback sizes
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) / 9007199254740992.0; }
+
+private:
+    uint64_t state_;
+};
+
+constexpr int32_t kSampleRate = 48000;
+
+// Stream formats the marker renders into
+float loadSample(SampleFormat format, const void* data, int32_t index) {
+    switch (format) {
+    case SampleFormat::I16:
+        return I16Format::load(data, index);
+    case SampleFormat::I32:
+        return I32Format::load(data, index);
+    default:
+        return FloatFormat::load(data, index);
+    }
+}
+
+void storeSample(SampleFormat format, void* data, int32_t index, float value) {
+    switch (format) {
+    case SampleFormat::I16:
+        I16Format::store(data, index, value);
+        break;
+    case SampleFormat::I32:
+        I32Format::store(data, index, value);
+        break;
+    default:
+        FloatFormat::store(data, index, value);
+        break;
+    }
+}
+
+// Largest error of a sample the marker computed in float and converted: 1.5 LSB of I16, float precision otherwise
+float toleranceOf(SampleFormat format) { return format == SampleFormat::I16 ? 1.5f / kScaleI16 : 1e-6f; }
+
+/**
+ * Program audio, the marked output and the callbacks that carried it
+ */
+struct Stream {
+    SampleFormat format;
+    int32_t channelCount;
+    int32_t bytesPerFrame;
+    int32_t frames;
+    std::vector<uint8_t> program;
+    std::vector<uint8_t> output;
+    std::vector<int64_t> bufferStarts; // Stream frame of each callback
+
+    Stream(SampleFormat sampleFormat, int32_t channels, int32_t numFrames, uint64_t seed)
+        : format(sampleFormat),
+          channelCount(channels),
+          bytesPerFrame(channels * getBytesPerSample(sampleFormat)),
+          frames(numFrames),
+          program(static_cast<size_t>(numFrames) * bytesPerFrame),
+          output(program.size()) {
+        // Loud enough that a faded frame next to an edge is still far from silence
+        Random random(seed);
+        for (int32_t i = 0; i < numFrames * channels; i++) {
+            auto magnitude = static_cast<float>(0.25 + 0.7 * random.uniform());
+            storeSample(format, program.data(), i, random.next() & 1 ? magnitude : -magnitude);
+        }
+    }
+
+    /**
+     * Offset of a stream frame in the callback buffer that carried it
+     */
+    int32_t offsetOf(int64_t frame) const {
+        auto buffer = std::upper_bound(bufferStarts.begin(), bufferStarts.end(), frame) - 1;
+        return static_cast<int32_t>(frame - *buffer);
+    }
+};
+
+/**
+ * Run the program through the marker in callbacks of 1 to 700 frames, a quarter of the buffers that would hold an
+ * edge end right before it and a quarter right after it, so edges fall on the first and the last frame of buffers
+ */
+void mark(LatencyMarker& marker, int64_t periodFrames, uint64_t seed, Stream* stream) {
+    Random random(seed);
+    std::vector<uint8_t> buffer;
+    int64_t frame = 0;
+    while (frame < stream->frames) {
+        int64_t size = random.next() % 16 == 0 ? 1 : 1 + static_cast<int64_t>(random.next() % 700);
+        int64_t edge = (frame / periodFrames + 1) * periodFrames;
+        if (edge < frame + size) {
+            switch (random.next() % 4) {
+            case 0:
+                size = edge - frame > 0 ? edge - frame : size;
+                break;
+            case 1:
+                size = edge - frame + 1;
+                break;
+            default:
+                break;
+            }
+        }
+        size = std::min<int64_t>(size, stream->frames - frame);
+
+        const size_t offset = static_cast<size_t>(frame) * stream->bytesPerFrame;
+        const size_t bytes = static_cast<size_t>(size) * stream->bytesPerFrame;
+        buffer.assign(stream->program.begin() + offset, stream->program.begin() + offset + bytes);
+        marker.process(buffer.data(), static_cast<int32_t>(size));
+        memcpy(stream->output.data() + offset, buffer.data(), bytes);
+        stream->bufferStarts.push_back(frame);
+        frame += size;
+    }
+}
+
+/**
+ * Compare every output frame with the model: the marker from each edge k * period, the program faded out towards
+ * the edge and back in after a mute window, the program bit-exact everywhere else
+ */
+bool checkOutput(const char* name,
+                 const LatencyMarker::Options& options,
+                 int64_t periodFrames,
+                 int64_t durationFrames,
+                 int64_t fadeFrames,
+                 const Stream& stream) {
+    const float tolerance = toleranceOf(stream.format);
+    const double step = 1.0 / static_cast<double>(fadeFrames + 1);
+    const double phaseStep = 2.0 * M_PI * options.toneHz / kSampleRate;
+    const uint8_t* program = stream.program.data();
+    const uint8_t* output = stream.output.data();
+    char what[160];
+
+    for (int64_t frame = 0; frame < stream.frames; frame++) {
+        const int64_t edge = frame / periodFrames * periodFrames;
+        const int64_t sinceEdge = frame - edge;
+        const int64_t toNextEdge = edge + periodFrames - frame;
+        const int32_t base = static_cast<int32_t>(frame) * stream.channelCount;
+        const size_t byteOffset = static_cast<size_t>(frame) * stream.bytesPerFrame;
+
+        const bool inMarker = edge > 0 && sinceEdge < durationFrames;
+        const bool fadingIn = edge > 0 && sinceEdge >= durationFrames && sinceEdge < durationFrames + fadeFrames;
+        const bool fadingOut = toNextEdge <= fadeFrames;
+        if (!inMarker && !fadingIn && !fadingOut) {
+            if (memcmp(program + byteOffset, output + byteOffset, stream.bytesPerFrame) != 0) {
+                snprintf(what, sizeof(what), "frame %" PRId64 " (%" PRId64 " after edge %" PRId64
+                         ", buffer offset %d) differs from the program",
+                         frame, sinceEdge, edge, stream.offsetOf(frame));
+                return expect(false, name, what);
+            }
+            continue;
+        }
+        if (inMarker && options.type == LatencyMarker::Type::MuteWindow) {
+            for (int32_t byte = 0; byte < stream.bytesPerFrame; byte++) {
+                if (output[byteOffset + byte] != 0) {
+                    snprintf(what, sizeof(what), "frame %" PRId64 " (%" PRId64 " into the window at %" PRId64
+                             ", buffer offset %d) is not silent",
+                             frame, sinceEdge, edge, stream.offsetOf(frame));
+                    return expect(false, name, what);
+                }
+            }
+            continue;
+        }
+
+        for (int32_t channel = 0; channel < stream.channelCount; channel++) {
+            double expected = 0;
+            if (inMarker) {
+                expected = options.type == LatencyMarker::Type::Click
+                               ? options.amplitude
+                               : options.amplitude * std::sin(phaseStep * static_cast<double>(sinceEdge));
+            } else {
+                const double gain = fadingOut ? static_cast<double>(toNextEdge) * step
+                                              : static_cast<double>(sinceEdge - durationFrames + 1) * step;
+                expected = gain * loadSample(stream.format, program, base + channel);
+            }
+            const float actual = loadSample(stream.format, output, base + channel);
+            if (std::fabs(actual - expected) > tolerance) {
+                snprintf(what, sizeof(what), "frame %" PRId64 " ch %d (%" PRId64 " after edge %" PRId64
+                         ", buffer offset %d) is %.7f, expected %.7f",
+                         frame, channel, sinceEdge, edge, stream.offsetOf(frame), actual, expected);
+                return expect(false, name, what);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Records and events must name each edge k * period in order: index, frame, offset in its buffer, alternating level
+ */
+bool checkEvents(const char* name,
+                 const std::vector<MarkerEvent>& events,
+                 int64_t firstIndex,
+                 int64_t periodFrames,
+                 const Stream& stream) {
+    const int64_t edges = (stream.frames - 1) / periodFrames;
+    char what[160];
+    snprintf(what, sizeof(what), "%zu events, expected %" PRId64, events.size(), edges - firstIndex);
+    if (!expect(static_cast<int64_t>(events.size()) == edges - firstIndex, name, what)) {
+        return false;
+    }
+    uint64_t lastTimeNs = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        const MarkerEvent& event = events[i];
+        const int64_t index = firstIndex + static_cast<int64_t>(i);
+        const int64_t frame = (index + 1) * periodFrames;
+        if (event.index != index || event.frame != frame || event.offset != stream.offsetOf(frame) ||
+            event.level != (index % 2 == 0 ? 1 : 0) || event.timeNs < lastTimeNs) {
+            snprintf(what, sizeof(what),
+                     "event %zu is #%" PRId64 " at %" PRId64 "+%d level %d, expected #%" PRId64 " at %" PRId64
+                     "+%d level %d",
+                     i, event.index, event.frame - event.offset, event.offset, event.level, index,
+                     frame - stream.offsetOf(frame), stream.offsetOf(frame), index % 2 == 0 ? 1 : 0);
+            return expect(false, name, what);
+        }
+        lastTimeNs = event.timeNs;
+    }
+    return true;
+}
+
+/**
+ * Edges on the first and on the last frame of a buffer
+ */
+void countBoundaryEdges(const Stream& stream, int64_t periodFrames, int32_t* first, int32_t* last) {
+    for (int64_t edge = periodFrames; edge < stream.frames; edge += periodFrames) {
+        *first += stream.offsetOf(edge) == 0;
+        *last += edge + 1 < stream.frames && stream.offsetOf(edge + 1) == 0;
+    }
+}
+
+struct MarkerCase {
+    const char* name;
+    LatencyMarker::Type type;
+    SampleFormat format;
+    int32_t channelCount;
+};
+
+// One second of program, a marker every 20 ms lasting 5 ms; the records hold all of them
+void checkMarkers(const MarkerCase& markerCase, uint64_t seed) {
+    const char* name = markerCase.name;
+    LatencyMarker::Options options;
+    options.enabled = true;
+    options.type = markerCase.type;
+    options.periodMs = 20;
+    options.durationMs = 5;
+    options.toneHz = 1000.0f;
+    options.amplitude = 0.5f;
+    LatencyMarker marker;
+    if (!expect(marker.prepare(options, kSampleRate, markerCase.channelCount, markerCase.format), name,
+                "prepare failed")) {
+        return;
+    }
+    const int64_t periodFrames = options.periodMs * kSampleRate / 1000;
+    const int64_t durationFrames =
+        markerCase.type == LatencyMarker::Type::Click ? 1 : options.durationMs * kSampleRate / 1000;
+    // 2 ms, the marker's mute fade
+    const int64_t fadeFrames = markerCase.type == LatencyMarker::Type::MuteWindow ? 2 * kSampleRate / 1000 : 0;
+
+    Stream stream(markerCase.format, markerCase.channelCount, kSampleRate, seed);
+    mark(marker, periodFrames, seed + 1, &stream);
+    if (!checkOutput(name, options, periodFrames, durationFrames, fadeFrames, stream) ||
+        !checkEvents(name, marker.getRecords(), 0, periodFrames, stream)) {
+        return;
+    }
+    int32_t firstFrameEdges = 0;
+    int32_t lastFrameEdges = 0;
+    countBoundaryEdges(stream, periodFrames, &firstFrameEdges, &lastFrameEdges);
+    if (expect(firstFrameEdges > 0 && lastFrameEdges > 0, name, "no edge on the first or last frame of a buffer")) {
+        printf("%s: %zu callbacks, %zu markers, %d on a buffer's first frame, %d on its last: ok\n", name,
+               stream.bufferStarts.size(), marker.getRecords().size(), firstFrameEdges, lastFrameEdges);
+    }
+}
+
+// A marker every 5 ms for a second: more events than the record ring keeps, the pipe must carry every one
+void checkPipe(uint64_t seed) {
+    const char* name = "pipe trigger";
+    int fds[2];
+    if (!expect(pipe(fds) == 0, name, "cannot create a pipe")) {
+        return;
+    }
+    LatencyMarker::Options options;
+    options.enabled = true;
+    options.type = LatencyMarker::Type::Click;
+    options.trigger = LatencyMarker::Trigger::Pipe;
+    options.triggerFd = fds[1];
+    options.periodMs = 5;
+    LatencyMarker marker;
+    bool prepared = marker.prepare(options, kSampleRate, 2, SampleFormat::I16);
+    // The trigger writes to its own duplicate, the pipe reaches end of file once it is released
+    close(fds[1]);
+    if (!expect(prepared, name, "prepare failed")) {
+        close(fds[0]);
+        return;
+    }
+
+    const int64_t periodFrames = options.periodMs * kSampleRate / 1000;
+    Stream stream(SampleFormat::I16, 2, kSampleRate, seed);
+    mark(marker, periodFrames, seed + 1, &stream);
+    const std::vector<MarkerEvent> records = marker.getRecords();
+    marker.release();
+
+    std::vector<MarkerEvent> events;
+    MarkerEvent event;
+    ssize_t bytes = 0;
+    while ((bytes = read(fds[0], &event, sizeof(event))) == static_cast<ssize_t>(sizeof(event))) {
+        events.push_back(event);
+    }
+    close(fds[0]);
+    if (!expect(bytes == 0, name, "partial event in the pipe") ||
+        !checkEvents(name, events, 0, periodFrames, stream) ||
+        !expect(records.size() == LatencyMarker::kMaxRecords && events.size() > records.size(), name,
+                "record ring not full") ||
+        !checkEvents(name, records, static_cast<int64_t>(events.size() - records.size()), periodFrames, stream)) {
+        return;
+    }
+    // The records are the very events the pipe carried
+    bool same = true;
+    for (size_t i = 0; i < records.size(); i++) {
+        same = same && memcmp(&records[i], &events[events.size() - records.size() + i], sizeof(MarkerEvent)) == 0;
+    }
+    if (expect(same, name, "records differ from the events written to the pipe")) {
+        printf("%s: %zu events in order, last %zu recorded: ok\n", name, events.size(), records.size());
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -s seed       Program audio and callback sizes (default 1)\n"
+            "  -v            Keep the marker's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    uint64_t seed = 1;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-s") == 0 && index + 1 < argc) {
+            seed = strtoull(argv[++index], nullptr, 0);
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    const MarkerCase cases[] = {
+        {"mute window i16 2ch", LatencyMarker::Type::MuteWindow, SampleFormat::I16, 2},
+        {"mute window float 6ch", LatencyMarker::Type::MuteWindow, SampleFormat::Float, 6},
+        {"mute window i32 1ch", LatencyMarker::Type::MuteWindow, SampleFormat::I32, 1},
+        {"click i16 2ch", LatencyMarker::Type::Click, SampleFormat::I16, 2},
+        {"click i32 2ch", LatencyMarker::Type::Click, SampleFormat::I32, 2},
+        {"tone burst i16 2ch", LatencyMarker::Type::ToneBurst, SampleFormat::I16, 2},
+        {"tone burst float 1ch", LatencyMarker::Type::ToneBurst, SampleFormat::Float, 1},
+    };
+    for (const MarkerCase& markerCase : cases) {
+        checkMarkers(markerCase, seed);
+    }
+    checkPipe(seed);
+
+    if (failures > 0) {
+        printf("latency_marker_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
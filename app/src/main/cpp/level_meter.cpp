@@ -0,0 +1,214 @@
+#include "level_meter.h"
+#include "audio_log.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <cmath>
+
+static_assert(sizeof(LevelMeter::Region) == LevelMeter::kRegionBytes, "Region layout is shared with Kotlin");
+static_assert(sizeof(std::atomic<float>) == 4 && sizeof(std::atomic<int64_t>) == 8, "Region fields must be plain");
+
+// Bound by reference in std::min, so it needs a definition before C++17
+constexpr int32_t LevelMeter::kMaxChannels;
+
+namespace {
+
+// Peak, sum of squares and clipped samples per channel
+struct MeterChannels {
+    float* peak;
+    float* sumSquares;
+    uint32_t* clips;
+};
+
+struct MeterReducer {
+    template <int32_t N>
+    struct Lanes {
+        float peak[N] = {};
+        float sum[N] = {};
+        uint32_t clips[N] = {};
+    };
+
+    float clipLevel;
+
+    template <int32_t N>
+    void add(Lanes<N>& lanes, int32_t lane, float x) const {
+        float magnitude = std::fabs(x);
+        lanes.peak[lane] = magnitude > lanes.peak[lane] ? magnitude : lanes.peak[lane];
+        lanes.sum[lane] += x * x;
+        lanes.clips[lane] += magnitude >= clipLevel ? 1 : 0;
+    }
+
+    template <int32_t N>
+    void fold(const Lanes<N>& lanes, int32_t lane, MeterChannels& channels, int32_t channel) const {
+        channels.peak[channel] = std::max(channels.peak[channel], lanes.peak[lane]);
+        channels.sumSquares[channel] += lanes.sum[lane];
+        channels.clips[channel] += lanes.clips[lane];
+    }
+
+    void addToChannel(MeterChannels& channels, int32_t channel, float x) const {
+        float magnitude = std::fabs(x);
+        channels.peak[channel] = magnitude > channels.peak[channel] ? magnitude : channels.peak[channel];
+        channels.sumSquares[channel] += x * x;
+        channels.clips[channel] += magnitude >= clipLevel ? 1 : 0;
+    }
+};
+
+/**
+ * Meter kernel, Channels > 0 fixes the channel count at compile time, see reduceChannels()
+ */
+template <typename Format, int32_t Channels>
+void meterKernel(const void* audioData,
+                 int32_t numFrames,
+                 int32_t channelCount,
+                 float clipLevel,
+                 float* peak,
+                 float* sumSquares,
+                 uint32_t* clips) {
+    MeterChannels channels{peak, sumSquares, clips};
+    reduceChannels<Format, Channels>(audioData, numFrames, channelCount, MeterReducer{clipLevel}, channels);
+}
+
+template <typename Format>
+LevelMeter::Kernel selectKernel(int32_t channelCount, bool specialized) {
+    if (specialized) {
+        switch (channelCount) {
+        case 1:
+            return meterKernel<Format, 1>;
+        case 2:
+            return meterKernel<Format, 2>;
+        case 6:
+            return meterKernel<Format, 6>;
+        case 8:
+            return meterKernel<Format, 8>;
+        default:
+            break;
+        }
+    }
+    return meterKernel<Format, 0>;
+}
+
+} // namespace
+
+LevelMeter::LevelMeter() { reset(); }
+
+LevelMeter::Kernel LevelMeter::findKernel(SampleFormat format, int32_t channelCount, bool specialized) {
+    switch (format) {
+    case SampleFormat::I16:
+        return selectKernel<I16Format>(channelCount, specialized);
+    case SampleFormat::I24Packed:
+        return selectKernel<I24PackedFormat>(channelCount, specialized);
+    case SampleFormat::I32:
+        return selectKernel<I32Format>(channelCount, specialized);
+    case SampleFormat::Float:
+        return selectKernel<FloatFormat>(channelCount, specialized);
+    default:
+        return nullptr;
+    }
+}
+
+bool LevelMeter::prepare(const Options& options, SampleFormat format, int32_t channelCount, int32_t sampleRate) {
+    enabled_ = false;
+    kernel_ = options.enabled ? findKernel(format, channelCount, true) : nullptr;
+    channelCount_ = 0;
+    sampleRate_ = 0;
+
+    bool supported = kernel_ && channelCount > 0 && channelCount <= kMaxChannels && sampleRate > 0;
+    if (options.enabled && !supported) {
+        LOGE("Level meter: unsupported stream %dch %dHz, format %d", channelCount, sampleRate,
+             static_cast<int32_t>(format));
+        kernel_ = nullptr;
+    } else if (options.enabled) {
+        channelCount_ = channelCount;
+        sampleRate_ = sampleRate;
+        windowFrames_ = std::max(static_cast<int32_t>(static_cast<int64_t>(options.windowMs) * sampleRate / 1000), 1);
+        clipLevel_ = options.clipLevel;
+        enabled_ = true;
+    }
+
+    // Readers see the new layout with zero levels until the first window is published
+    reset();
+    return !options.enabled || supported;
+}
+
+void LevelMeter::process(const void* audioData, int32_t numFrames) {
+    if (!enabled_ || numFrames <= 0) {
+        return;
+    }
+
+    // The window closes at the end of the callback that completes it
+    kernel_(audioData, numFrames, channelCount_, clipLevel_, peak_, sumSquares_, clips_);
+    windowDone_ += numFrames;
+    frame_ += numFrames;
+    if (windowDone_ >= windowFrames_) {
+        publish();
+    }
+}
+
+void LevelMeter::reset() {
+    frame_ = 0;
+    windowDone_ = 0;
+    std::fill(peak_, peak_ + kMaxChannels, 0.0f);
+    std::fill(sumSquares_, sumSquares_ + kMaxChannels, 0.0f);
+    std::fill(clips_, clips_ + kMaxChannels, 0u);
+
+    uint32_t sequence = region_.sequence.load(std::memory_order_relaxed);
+    region_.sequence.store(sequence | 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    region_.channelCount.store(channelCount_, std::memory_order_relaxed);
+    region_.framePosition.store(0, std::memory_order_relaxed);
+    region_.windowCount.store(0, std::memory_order_relaxed);
+    region_.sampleRate.store(sampleRate_, std::memory_order_relaxed);
+    for (Channel& channel : region_.channels) {
+        channel.peak.store(0.0f, std::memory_order_relaxed);
+        channel.rms.store(0.0f, std::memory_order_relaxed);
+        channel.clipCount.store(0, std::memory_order_relaxed);
+    }
+    region_.sequence.store((sequence | 1u) + 1, std::memory_order_release);
+}
+
+// Seqlock write of the finished window: odd sequence, fields, even sequence
+void LevelMeter::publish() {
+    uint32_t sequence = region_.sequence.load(std::memory_order_relaxed);
+    region_.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const float scale = 1.0f / static_cast<float>(windowDone_);
+    for (int32_t i = 0; i < channelCount_; i++) {
+        Channel& channel = region_.channels[i];
+        channel.peak.store(peak_[i], std::memory_order_relaxed);
+        channel.rms.store(std::sqrt(sumSquares_[i] * scale), std::memory_order_relaxed);
+        channel.clipCount.store(channel.clipCount.load(std::memory_order_relaxed) + clips_[i],
+                                std::memory_order_relaxed);
+        peak_[i] = 0.0f;
+        sumSquares_[i] = 0.0f;
+        clips_[i] = 0;
+    }
+    region_.framePosition.store(frame_, std::memory_order_relaxed);
+    region_.windowCount.store(region_.windowCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    region_.sequence.store(sequence + 2, std::memory_order_release);
+    windowDone_ = 0;
+}
+
+bool LevelMeter::read(Snapshot* snapshot) const {
+    for (int32_t attempt = 0; attempt < kReadAttempts; attempt++) {
+        uint32_t before = region_.sequence.load(std::memory_order_acquire);
+        if (before & 1u) {
+            continue;
+        }
+        snapshot->channelCount = std::min(region_.channelCount.load(std::memory_order_relaxed), kMaxChannels);
+        snapshot->sampleRate = region_.sampleRate.load(std::memory_order_relaxed);
+        snapshot->framePosition = region_.framePosition.load(std::memory_order_relaxed);
+        snapshot->windowCount = region_.windowCount.load(std::memory_order_relaxed);
+        for (int32_t i = 0; i < snapshot->channelCount; i++) {
+            const Channel& channel = region_.channels[i];
+            snapshot->peak[i] = channel.peak.load(std::memory_order_relaxed);
+            snapshot->rms[i] = channel.rms.load(std::memory_order_relaxed);
+            snapshot->clipCount[i] = channel.clipCount.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (region_.sequence.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+    return false;
+}
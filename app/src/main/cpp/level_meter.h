@@ -0,0 +1,146 @@
+#ifndef LEVEL_METER_H
+#define LEVEL_METER_H
+
+#include "audio_format.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Per-channel peak, RMS and clip metering of the output
+ *
+ * The audio thread reduces every callback buffer in the stream format (a
+ * kernel selected once per stream, with the channel count fixed at compile
+ * time for 1, 2, 6 and 8 channels so the reduction vectorizes) and publishes
+ * the levels of each window into a fixed shared Region under a seqlock.
+ * Readers never block the writer: they retry while the sequence is odd or
+ * changed under them. The Region lives as long as the meter and has a fixed
+ * little-endian layout, so Kotlin reads it in place through a direct
+ * ByteBuffer without a JNI call per frame.
+ *
+ * Region layout (byte offsets):
+ *   0  uint32 sequence, odd while the audio thread writes
+ *   4  int32  channel count
+ *   8  int64  stream frames metered up to the end of the last window
+ *   16 uint32 windows published since the stream was opened
+ *   20 int32  sample rate
+ *   32 + 16 * channel: float peak, float RMS (full scale 1), uint32 clipped samples since the stream opened
+ */
+class LevelMeter {
+public:
+    static constexpr int32_t kMaxChannels = 16;
+
+    struct Options {
+        bool enabled = false;
+        int32_t windowMs = 50;                 // Levels are published once per window, at a callback boundary
+        float clipLevel = 32767.0f / 32768.0f; // Samples at or above this magnitude count as clipped
+    };
+
+    struct Channel {
+        std::atomic<float> peak;
+        std::atomic<float> rms;
+        std::atomic<uint32_t> clipCount;
+        uint32_t reserved;
+    };
+
+    struct Region {
+        std::atomic<uint32_t> sequence;
+        std::atomic<int32_t> channelCount;
+        std::atomic<int64_t> framePosition;
+        std::atomic<uint32_t> windowCount;
+        std::atomic<int32_t> sampleRate;
+        uint32_t reserved[2];
+        Channel channels[kMaxChannels];
+    };
+
+    static constexpr size_t kRegionBytes = 32 + 16 * kMaxChannels;
+
+    /**
+     * Consistent copy of the published levels
+     */
+    struct Snapshot {
+        int32_t channelCount = 0;
+        int32_t sampleRate = 0;
+        int64_t framePosition = 0;
+        uint32_t windowCount = 0;
+        float peak[kMaxChannels] = {};
+        float rms[kMaxChannels] = {};
+        uint32_t clipCount[kMaxChannels] = {};
+    };
+
+    /**
+     * Reduce numFrames frames, accumulating into peak, sumSquares and clips (one entry per channel)
+     */
+    using Kernel = void (*)(const void* audioData,
+                            int32_t numFrames,
+                            int32_t channelCount,
+                            float clipLevel,
+                            float* peak,
+                            float* sumSquares,
+                            uint32_t* clips);
+
+    LevelMeter();
+
+    // Disable copy and assignment, the Region is shared by address
+    LevelMeter(const LevelMeter&) = delete;
+    LevelMeter& operator=(const LevelMeter&) = delete;
+
+    /**
+     * Configure for a new stream and publish silence (not real-time safe, the stream must not be rendering)
+     * @return Returns false if enabled and the format or channel count cannot be metered
+     */
+    bool prepare(const Options& options, SampleFormat format, int32_t channelCount, int32_t sampleRate);
+
+    /**
+     * Meter rendered output (real-time safe, audio thread)
+     * @param audioData numFrames frames in the stream format, not modified
+     */
+    void process(const void* audioData, int32_t numFrames);
+
+    /**
+     * Publish silence and zero counts, e.g. once the stream is gone (not while rendering)
+     */
+    void reset();
+
+    bool isEnabled() const { return enabled_; }
+
+    /**
+     * Get the shared Region, valid for the lifetime of the meter
+     */
+    const Region* getRegion() const { return &region_; }
+
+    /**
+     * Copy the published levels (any thread, never blocks the writer)
+     * @return Returns false if the writer kept updating during every attempt
+     */
+    bool read(Snapshot* snapshot) const;
+
+    /**
+     * Get the kernel for a format and channel count
+     * @param specialized Prefer a compile-time specialized instance over the generic loop
+     * @return nullptr if the format is unsupported
+     */
+    static Kernel findKernel(SampleFormat format, int32_t channelCount, bool specialized);
+
+private:
+    static constexpr int32_t kReadAttempts = 8;
+
+    void publish();
+
+    alignas(64) Region region_{};
+    bool enabled_ = false;
+    Kernel kernel_ = nullptr;
+    int32_t channelCount_ = 0;
+    int32_t sampleRate_ = 0;
+    int32_t windowFrames_ = 0;
+    float clipLevel_ = 1.0f;
+
+    // Audio thread: the window being accumulated
+    int64_t frame_ = 0;
+    int32_t windowDone_ = 0;
+    float peak_[kMaxChannels] = {};
+    float sumSquares_[kMaxChannels] = {};
+    uint32_t clips_[kMaxChannels] = {};
+};
+
+#endif // LEVEL_METER_H
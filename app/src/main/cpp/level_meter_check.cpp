@@ -0,0 +1,439 @@
+// Host check of LevelMeter: a 0.5 FS sine reads peak 0.500 and RMS 0.3535 in every format and channel layout,
+// a full-scale square counts every sample as clipped, the specialized kernels agree with the generic loop and a
+// double-precision reference, and a reader racing the audio thread only ever gets whole windows out of the
+// seqlock. With -b it also times every kernel per burst size, specialized against generic.
+#include "level_meter.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("level_meter_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run meters the same buffers
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    double uniform(double low, double high) {
+        return low + (high - low) * static_cast<double>(next() >> 11) / 9007199254740992.0;
+    }
+
+private:
+    uint64_t state_;
+};
+
+constexpr int32_t kSampleRate = 48000;
+constexpr double kPi = 3.14159265358979323846;
+constexpr SampleFormat kFormats[] = {SampleFormat::I16, SampleFormat::I24Packed, SampleFormat::I32,
+                                     SampleFormat::Float};
+constexpr int32_t kBurstSizes[] = {64, 192, 480, 1024};
+
+const char* getFormatName(SampleFormat format) {
+    switch (format) {
+    case SampleFormat::I16:
+        return "i16";
+    case SampleFormat::I24Packed:
+        return "i24";
+    case SampleFormat::I32:
+        return "i32";
+    case SampleFormat::Float:
+        return "float";
+    default:
+        return "?";
+    }
+}
+
+/**
+ * Interleaved samples of a format from floats, rounded like the output path
+ */
+class SampleBuffer {
+public:
+    SampleBuffer(SampleFormat format, int32_t sampleCount)
+        : format_(format), data_(static_cast<size_t>(sampleCount) * getBytesPerSample(format)) {}
+
+    void set(int32_t index, float value) {
+        switch (format_) {
+        case SampleFormat::I16:
+            I16Format::store(data_.data(), index, value);
+            break;
+        case SampleFormat::I24Packed:
+            I24PackedFormat::store(data_.data(), index, value);
+            break;
+        case SampleFormat::I32:
+            I32Format::store(data_.data(), index, value);
+            break;
+        default:
+            FloatFormat::store(data_.data(), index, value);
+            break;
+        }
+    }
+
+    float get(int32_t index) const {
+        switch (format_) {
+        case SampleFormat::I16:
+            return I16Format::load(data_.data(), index);
+        case SampleFormat::I24Packed:
+            return I24PackedFormat::load(data_.data(), index);
+        case SampleFormat::I32:
+            return I32Format::load(data_.data(), index);
+        default:
+            return FloatFormat::load(data_.data(), index);
+        }
+    }
+
+    const void* frame(int32_t frame, int32_t channelCount) const {
+        return data_.data() + static_cast<size_t>(frame) * channelCount * getBytesPerSample(format_);
+    }
+
+private:
+    SampleFormat format_;
+    std::vector<uint8_t> data_;
+};
+
+LevelMeter::Options makeOptions(int32_t windowMs) {
+    LevelMeter::Options options;
+    options.enabled = true;
+    options.windowMs = windowMs;
+    return options;
+}
+
+// One 50 ms window of a 1 kHz sine, whole periods, fed in 480-frame callbacks. Channel c runs at
+// 0.5 / (c + 1) with its own phase, so a kernel that mixes up channels reads the wrong level.
+void checkSine(SampleFormat format, int32_t channelCount) {
+    const char* name = "sine";
+    constexpr int32_t kWindowFrames = kSampleRate / 20;
+    constexpr int32_t kCallbackFrames = 480;
+    SampleBuffer buffer(format, kWindowFrames * channelCount);
+    for (int32_t frame = 0; frame < kWindowFrames; frame++) {
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+            double phase = 2.0 * kPi * (1000.0 * frame / kSampleRate + 0.25 * channel);
+            buffer.set(frame * channelCount + channel, static_cast<float>(0.5 / (channel + 1) * std::sin(phase)));
+        }
+    }
+
+    LevelMeter meter;
+    char what[96];
+    snprintf(what, sizeof(what), "%s %dch: prepare failed", getFormatName(format), channelCount);
+    if (!expect(meter.prepare(makeOptions(50), format, channelCount, kSampleRate), name, what)) {
+        return;
+    }
+    for (int32_t frame = 0; frame < kWindowFrames; frame += kCallbackFrames) {
+        meter.process(buffer.frame(frame, channelCount), kCallbackFrames);
+    }
+    LevelMeter::Snapshot snapshot;
+    snprintf(what, sizeof(what), "%s %dch: window not published", getFormatName(format), channelCount);
+    if (!expect(meter.read(&snapshot) && snapshot.windowCount == 1 && snapshot.framePosition == kWindowFrames &&
+                    snapshot.channelCount == channelCount && snapshot.sampleRate == kSampleRate,
+                name, what)) {
+        return;
+    }
+    bool levels = true;
+    for (int32_t channel = 0; channel < channelCount; channel++) {
+        const double amplitude = 0.5 / (channel + 1);
+        levels = levels && std::fabs(snapshot.peak[channel] - amplitude) < 1e-4 &&
+                 std::fabs(snapshot.rms[channel] - amplitude / std::sqrt(2.0)) < 1e-4 &&
+                 snapshot.clipCount[channel] == 0;
+    }
+    snprintf(what, sizeof(what), "%s %dch: read peak %.4f RMS %.4f, expected 0.5000 0.3536", getFormatName(format),
+             channelCount, snapshot.peak[0], snapshot.rms[0]);
+    if (expect(levels, name, what)) {
+        printf("%s %s %dch: peak %.3f RMS %.4f ok\n", name, getFormatName(format), channelCount, snapshot.peak[0],
+               snapshot.rms[0]);
+    }
+}
+
+// Full scale clips every sample, clip counts add up over windows, just below the clip level never clips
+void checkClipping(SampleFormat format, int32_t channelCount) {
+    const char* name = "clipping";
+    constexpr int32_t kFrames = 1000;
+    constexpr int32_t kWindows = 3;
+    char what[96];
+    for (float level : {1.0f, 0.999f}) {
+        SampleBuffer buffer(format, kFrames * channelCount);
+        for (int32_t frame = 0; frame < kFrames; frame++) {
+            for (int32_t channel = 0; channel < channelCount; channel++) {
+                // Half-period of 5 frames, so both signs appear in every block of the kernel
+                buffer.set(frame * channelCount + channel, (frame / 5) % 2 ? -level : level);
+            }
+        }
+        LevelMeter meter;
+        // 1 ms windows close at the end of every callback
+        if (!expect(meter.prepare(makeOptions(1), format, channelCount, kSampleRate), name, "prepare failed")) {
+            return;
+        }
+        for (int32_t window = 0; window < kWindows; window++) {
+            meter.process(buffer.frame(0, channelCount), kFrames);
+        }
+        LevelMeter::Snapshot snapshot;
+        if (!expect(meter.read(&snapshot) && snapshot.windowCount == kWindows, name, "windows not published")) {
+            return;
+        }
+        const uint32_t expectedClips = level == 1.0f ? kWindows * kFrames : 0;
+        bool counted = true;
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+            counted = counted && snapshot.clipCount[channel] == expectedClips &&
+                      std::fabs(snapshot.peak[channel] - level) < 1e-4f;
+        }
+        snprintf(what, sizeof(what), "%s %dch at %.3f: %u clipped samples, expected %u", getFormatName(format),
+                 channelCount, level, snapshot.clipCount[0], expectedClips);
+        expect(counted, name, what);
+    }
+    printf("%s %s %dch: ok\n", name, getFormatName(format), channelCount);
+}
+
+// Specialized and generic kernels against a double reference, over frame counts that leave partial blocks
+void checkKernels() {
+    const char* name = "kernels";
+    int32_t compared = 0;
+    for (SampleFormat format : kFormats) {
+        for (int32_t channelCount : {1, 2, 6, 8}) {
+            LevelMeter::Kernel kernels[] = {LevelMeter::findKernel(format, channelCount, true),
+                                            LevelMeter::findKernel(format, channelCount, false)};
+            for (int32_t frames : {1, 7, 8, 63, 192, 997}) {
+                Random random(static_cast<uint64_t>(frames) * 131 + channelCount);
+                SampleBuffer buffer(format, frames * channelCount);
+                std::vector<float> expectedPeak(channelCount, 0.0f);
+                std::vector<double> expectedSum(channelCount, 0.0);
+                std::vector<uint32_t> expectedClips(channelCount, 0);
+                for (int32_t frame = 0; frame < frames; frame++) {
+                    for (int32_t channel = 0; channel < channelCount; channel++) {
+                        auto value = static_cast<float>(random.uniform(-1.05, 1.05));
+                        buffer.set(frame * channelCount + channel, value);
+                        // Reference on the value as stored, after rounding and clamping to the format
+                        const float stored = buffer.get(frame * channelCount + channel);
+                        expectedPeak[channel] = std::max(expectedPeak[channel], std::fabs(stored));
+                        expectedSum[channel] += static_cast<double>(stored) * stored;
+                        expectedClips[channel] += std::fabs(stored) >= 32767.0f / 32768.0f ? 1 : 0;
+                    }
+                }
+                for (int32_t variant = 0; variant < 2; variant++) {
+                    std::vector<float> peak(channelCount, 0.0f);
+                    std::vector<float> sumSquares(channelCount, 0.0f);
+                    std::vector<uint32_t> clips(channelCount, 0);
+                    kernels[variant](buffer.frame(0, channelCount), frames, channelCount, 32767.0f / 32768.0f,
+                                     peak.data(), sumSquares.data(), clips.data());
+                    bool same = peak == expectedPeak && clips == expectedClips;
+                    for (int32_t channel = 0; channel < channelCount; channel++) {
+                        same = same && std::fabs(sumSquares[channel] - expectedSum[channel]) <=
+                                           1e-5 * expectedSum[channel] + 1e-12;
+                    }
+                    char what[96];
+                    snprintf(what, sizeof(what), "%s %s %dch %d frames differs from the reference",
+                             variant == 0 ? "specialized" : "generic", getFormatName(format), channelCount, frames);
+                    expect(same, name, what);
+                    compared++;
+                }
+            }
+        }
+    }
+    printf("%s: %d layouts compared\n", name, compared);
+}
+
+// The audio thread publishes one window per callback while a reader polls. Window n is DC at a level derived
+// from n on every channel, so a snapshot that mixes two windows shows unequal channels, or a level, frame
+// position and window count that do not belong together.
+void checkSeqlock() {
+    const char* name = "seqlock";
+    constexpr int32_t kChannels = 8;
+    constexpr int32_t kWindowFrames = kSampleRate / 1000;
+    constexpr uint32_t kWindows = 200000;
+    auto levelOf = [](uint32_t window) { return static_cast<float>(window % 127 + 1) / 128.0f; };
+
+    LevelMeter meter;
+    if (!expect(meter.prepare(makeOptions(1), SampleFormat::Float, kChannels, kSampleRate), name, "prepare failed")) {
+        return;
+    }
+    LevelMeter::Snapshot snapshot;
+    if (!expect(meter.read(&snapshot) && snapshot.windowCount == 0 && snapshot.channelCount == kChannels &&
+                    snapshot.peak[0] == 0.0f,
+                name, "prepare did not publish silence")) {
+        return;
+    }
+
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        std::vector<float> buffer(static_cast<size_t>(kWindowFrames) * kChannels);
+        for (uint32_t window = 1; window <= kWindows; window++) {
+            std::fill(buffer.begin(), buffer.end(), levelOf(window));
+            meter.process(buffer.data(), kWindowFrames);
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    uint64_t reads = 0;
+    uint64_t retried = 0;
+    uint64_t torn = 0;
+    uint32_t lastWindow = 0;
+    bool monotonic = true;
+    while (!done.load(std::memory_order_acquire)) {
+        if (!meter.read(&snapshot)) {
+            retried++;
+            continue;
+        }
+        reads++;
+        const uint32_t window = snapshot.windowCount;
+        monotonic = monotonic && window >= lastWindow;
+        lastWindow = window;
+        if (window == 0) {
+            continue;
+        }
+        const float level = levelOf(window);
+        bool whole = snapshot.channelCount == kChannels &&
+                     snapshot.framePosition == static_cast<int64_t>(window) * kWindowFrames;
+        for (int32_t channel = 0; channel < kChannels; channel++) {
+            whole = whole && snapshot.peak[channel] == level && std::fabs(snapshot.rms[channel] - level) < 1e-5f;
+        }
+        torn += whole ? 0 : 1;
+    }
+    writer.join();
+
+    bool last = meter.read(&snapshot) && snapshot.windowCount == kWindows &&
+                snapshot.framePosition == static_cast<int64_t>(kWindows) * kWindowFrames &&
+                snapshot.peak[kChannels - 1] == levelOf(kWindows);
+    char what[96];
+    snprintf(what, sizeof(what), "%llu of %llu snapshots mixed two windows", static_cast<unsigned long long>(torn),
+             static_cast<unsigned long long>(reads));
+    if (expect(torn == 0, name, what) && expect(monotonic, name, "window count went backwards") &&
+        expect(last, name, "last window not published")) {
+        printf("%s: %llu snapshots, %llu gave up while writing, ok\n", name, static_cast<unsigned long long>(reads),
+               static_cast<unsigned long long>(retried));
+    }
+
+    // reset() publishes silence and zero counts in the same layout
+    meter.reset();
+    expect(meter.read(&snapshot) && snapshot.windowCount == 0 && snapshot.framePosition == 0 &&
+               snapshot.channelCount == kChannels && snapshot.peak[0] == 0.0f && snapshot.rms[0] == 0.0f,
+           name, "reset did not publish silence");
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// ns per burst of a kernel over a buffer kept in cache, best of a few timed batches
+double measureKernel(LevelMeter::Kernel kernel, const SampleBuffer& buffer, int32_t channelCount,
+                     int32_t burstFrames, int32_t milliseconds) {
+    float peak[LevelMeter::kMaxChannels] = {};
+    float sumSquares[LevelMeter::kMaxChannels] = {};
+    uint32_t clips[LevelMeter::kMaxChannels] = {};
+    double best = 1e30;
+    const uint64_t endNs = nowNs() + static_cast<uint64_t>(milliseconds) * 1000000;
+    while (nowNs() < endNs) {
+        const int32_t batch = 256;
+        uint64_t beginNs = nowNs();
+        for (int32_t i = 0; i < batch; i++) {
+            kernel(buffer.frame(0, channelCount), burstFrames, channelCount, 32767.0f / 32768.0f, peak, sumSquares,
+                   clips);
+        }
+        best = std::min(best, static_cast<double>(nowNs() - beginNs) / batch);
+    }
+    // Keeps the accumulators alive
+    return best + (peak[0] < 0.0f ? 1.0 : 0.0);
+}
+
+void benchmark(int32_t milliseconds) {
+    for (SampleFormat format : kFormats) {
+        for (int32_t channelCount : {1, 2, 6, 8}) {
+            const int32_t maxFrames = kBurstSizes[sizeof(kBurstSizes) / sizeof(kBurstSizes[0]) - 1];
+            SampleBuffer buffer(format, maxFrames * channelCount);
+            Random random(5);
+            for (int32_t i = 0; i < maxFrames * channelCount; i++) {
+                buffer.set(i, static_cast<float>(random.uniform(-1.0, 1.0)));
+            }
+            for (int32_t burstFrames : kBurstSizes) {
+                double specialized = measureKernel(LevelMeter::findKernel(format, channelCount, true), buffer,
+                                                   channelCount, burstFrames, milliseconds);
+                double generic = measureKernel(LevelMeter::findKernel(format, channelCount, false), buffer,
+                                               channelCount, burstFrames, milliseconds);
+                printf("%-5s %dch %4d frames %8.0f ns/burst specialized, %8.0f generic  %5.2fx\n",
+                       getFormatName(format), channelCount, burstFrames, specialized, generic,
+                       specialized > 0.0 ? generic / specialized : 0.0);
+            }
+        }
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Also time every kernel per burst size, specialized against the generic loop\n"
+            "  -m <ms>       Time per kernel and burst size for -b, default 100\n"
+            "  -v            Keep the meter's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool bench = false;
+    int32_t milliseconds = 100;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-m") == 0 && index + 1 < argc && atoi(argv[index + 1]) > 0) {
+            milliseconds = atoi(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // prepare() logs rejected layouts
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    for (SampleFormat format : kFormats) {
+        for (int32_t channelCount : {1, 2, 3, 6, 8}) {
+            checkSine(format, channelCount);
+        }
+        checkClipping(format, 2);
+        checkClipping(format, 5);
+    }
+    checkKernels();
+    checkSeqlock();
+
+    if (bench) {
+        benchmark(milliseconds);
+    }
+    if (failures > 0) {
+        printf("level_meter_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
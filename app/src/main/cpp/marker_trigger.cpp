@@ -0,0 +1,65 @@
+#include "marker_trigger.h"
+#include "audio_log.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+FdTrigger::FdTrigger(const std::string& path) : path_(path) {}
+
+FdTrigger::FdTrigger(int fd, Encoding encoding) : sourceFd_(fd), encoding_(encoding) {}
+
+bool FdTrigger::open() {
+    close();
+    if (!path_.empty()) {
+        fd_ = ::open(path_.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            LOGE("Failed to open marker trigger %s, errno: %d", path_.c_str(), errno);
+            return false;
+        }
+    } else {
+        fd_ = fcntl(sourceFd_, F_DUPFD_CLOEXEC, 0);
+        if (fd_ < 0) {
+            LOGE("Invalid marker trigger fd %d, errno: %d", sourceFd_, errno);
+            return false;
+        }
+        // Shared with the caller's descriptor (same open file)
+        fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    }
+    failed_ = 0;
+    LOGI("Marker trigger opened: %s, fd=%d", getName(), fd_);
+    return true;
+}
+
+void FdTrigger::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void FdTrigger::fire(const MarkerEvent& event) {
+    if (fd_ < 0) {
+        return;
+    }
+
+    ssize_t result;
+    size_t size;
+    if (encoding_ == Encoding::Level) {
+        char value = event.level ? '1' : '0';
+        size = 1;
+        result = write(fd_, &value, size);
+    } else {
+        size = sizeof(event);
+        result = write(fd_, &event, size);
+    }
+    if (result != static_cast<ssize_t>(size)) {
+        failed_++;
+    }
+}
+
+const char* FdTrigger::getName() const {
+    if (!path_.empty()) {
+        return path_.c_str();
+    }
+    return encoding_ == Encoding::Level ? "fd (level)" : "fd (events)";
+}
@@ -0,0 +1,90 @@
+#ifndef MARKER_TRIGGER_H
+#define MARKER_TRIGGER_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * One latency marker, as placed in the output stream
+ */
+struct MarkerEvent {
+    int64_t index = 0;  // Marker number since the stream started
+    int64_t frame = 0;  // Stream frame of the marker edge
+    int32_t offset = 0; // Position of the edge inside the callback buffer, in frames
+    int32_t level = 0;  // Trigger level after the edge, alternates 1/0
+    uint64_t timeNs = 0; // When the buffer holding the edge was written (trigger time)
+};
+
+/**
+ * External signal fired when a marker is written into the stream
+ * fire() is called on the audio thread and must not block.
+ */
+class MarkerTrigger {
+public:
+    virtual ~MarkerTrigger() = default;
+
+    /**
+     * Acquire the output (not real-time safe)
+     * @return Returns false if it cannot be used, markers are then only recorded in memory
+     */
+    virtual bool open() = 0;
+
+    virtual void close() = 0;
+
+    virtual void fire(const MarkerEvent& event) = 0;
+
+    virtual const char* getName() const = 0;
+};
+
+/**
+ * Trigger writing to a file descriptor
+ *
+ * Level encoding writes '1'/'0', the protocol of a sysfs GPIO value file.
+ * Event encoding writes the binary MarkerEvent, for a reader on the other
+ * end of a pipe that wants the frame index; it fits in PIPE_BUF, so each
+ * write is atomic. Descriptors passed in are duplicated and switched to
+ * non-blocking, a full pipe drops the event instead of stalling the audio
+ * thread.
+ */
+class FdTrigger : public MarkerTrigger {
+public:
+    enum class Encoding {
+        Level,
+        Event,
+    };
+
+    /**
+     * Open a path when the trigger is opened (sysfs GPIO value file)
+     */
+    explicit FdTrigger(const std::string& path);
+
+    /**
+     * Write to a duplicate of a caller's descriptor
+     */
+    FdTrigger(int fd, Encoding encoding);
+
+    ~FdTrigger() override { close(); }
+
+    // Disable copy and assignment
+    FdTrigger(const FdTrigger&) = delete;
+    FdTrigger& operator=(const FdTrigger&) = delete;
+
+    bool open() override;
+    void close() override;
+    void fire(const MarkerEvent& event) override;
+    const char* getName() const override;
+
+    /**
+     * Get the number of events that could not be written
+     */
+    uint64_t getFailedCount() const { return failed_; }
+
+private:
+    std::string path_;
+    int sourceFd_ = -1;
+    Encoding encoding_ = Encoding::Level;
+    int fd_ = -1;
+    uint64_t failed_ = 0; // Audio thread only
+};
+
+#endif // MARKER_TRIGGER_H
@@ -0,0 +1,333 @@
+#include "mixer.h"
+#include "audio_log.h"
+#include "format_converter.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define MIXER_HAS_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define MIXER_HAS_SSE2 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIXER_HAS_AVX2 1
+#define MIXER_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+// Slot index in the low bits of a source id, a generation above it
+constexpr int32_t kSlotBits = 8;
+constexpr int32_t kSlotMask = (1 << kSlotBits) - 1;
+
+void accumulateScalar(float* target, const float* source, int32_t count, float startGain, float endGain) {
+    if (startGain == endGain) {
+        for (int32_t i = 0; i < count; i++) {
+            target[i] += source[i] * startGain;
+        }
+        return;
+    }
+
+    float step = count > 0 ? (endGain - startGain) / static_cast<float>(count) : 0.0f;
+    for (int32_t i = 0; i < count; i++) {
+        target[i] += source[i] * (startGain + step * static_cast<float>(i));
+    }
+}
+
+#if MIXER_HAS_SSE2
+void accumulateSse2(float* target, const float* source, int32_t count, float startGain, float endGain) {
+    float step = count > 0 ? (endGain - startGain) / static_cast<float>(count) : 0.0f;
+    __m128 gain = _mm_add_ps(_mm_set1_ps(startGain), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+    const __m128 gainStep = _mm_set1_ps(step * 4.0f);
+    int32_t i = 0;
+    if (startGain == endGain) {
+        // No ramp, so no gain update chained through the loop
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(target + i, _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(_mm_loadu_ps(source + i), gain)));
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128 mixed = _mm_add_ps(_mm_loadu_ps(target + i), _mm_mul_ps(_mm_loadu_ps(source + i), gain));
+        _mm_storeu_ps(target + i, mixed);
+        gain = _mm_add_ps(gain, gainStep);
+    }
+    for (; i < count; i++) {
+        target[i] += source[i] * (startGain + step * static_cast<float>(i));
+    }
+}
+#endif
+
+#if MIXER_HAS_AVX2
+MIXER_AVX2 void accumulateAvx2(float* target, const float* source, int32_t count, float startGain, float endGain) {
+    float step = count > 0 ? (endGain - startGain) / static_cast<float>(count) : 0.0f;
+    __m256 gain = _mm256_fmadd_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7),
+                                  _mm256_set1_ps(startGain));
+    const __m256 gainStep = _mm256_set1_ps(step * 8.0f);
+    int32_t i = 0;
+    if (startGain == endGain) {
+        for (; i + 8 <= count; i += 8) {
+            __m256 mixed = _mm256_fmadd_ps(_mm256_loadu_ps(source + i), gain, _mm256_loadu_ps(target + i));
+            _mm256_storeu_ps(target + i, mixed);
+        }
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256 mixed = _mm256_fmadd_ps(_mm256_loadu_ps(source + i), gain, _mm256_loadu_ps(target + i));
+        _mm256_storeu_ps(target + i, mixed);
+        gain = _mm256_add_ps(gain, gainStep);
+    }
+    for (; i < count; i++) {
+        target[i] += source[i] * (startGain + step * static_cast<float>(i));
+    }
+}
+#endif
+
+#if MIXER_HAS_NEON
+void accumulateNeon(float* target, const float* source, int32_t count, float startGain, float endGain) {
+    float step = count > 0 ? (endGain - startGain) / static_cast<float>(count) : 0.0f;
+    const float lanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+    float32x4_t gain = vmlaq_n_f32(vdupq_n_f32(startGain), vld1q_f32(lanes), step);
+    const float32x4_t gainStep = vdupq_n_f32(step * 4.0f);
+    int32_t i = 0;
+    if (startGain == endGain) {
+        for (; i + 4 <= count; i += 4) {
+            vst1q_f32(target + i, vfmaq_f32(vld1q_f32(target + i), vld1q_f32(source + i), gain));
+        }
+    }
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(target + i, vfmaq_f32(vld1q_f32(target + i), vld1q_f32(source + i), gain));
+        gain = vaddq_f32(gain, gainStep);
+    }
+    for (; i < count; i++) {
+        target[i] += source[i] * (startGain + step * static_cast<float>(i));
+    }
+}
+#endif
+
+using AccumulateKernel = void (*)(float* target, const float* source, int32_t count, float startGain, float endGain);
+
+// Kernel of an instruction set, nullptr if this build or CPU lacks it
+AccumulateKernel findAccumulateKernel(FormatConverter::Isa isa) {
+    switch (isa) {
+    case FormatConverter::Isa::Scalar:
+        return accumulateScalar;
+#if MIXER_HAS_SSE2
+    case FormatConverter::Isa::Sse2:
+        return accumulateSse2;
+#endif
+#if MIXER_HAS_AVX2
+    case FormatConverter::Isa::Avx2:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? accumulateAvx2 : nullptr;
+#endif
+#if MIXER_HAS_NEON
+    case FormatConverter::Isa::Neon:
+        return accumulateNeon;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+} // namespace
+
+Mixer::Mixer(FormatConverter::Isa isa) {
+    for (auto& slot : slots_) {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+    retired_.reserve(kMaxSources);
+
+    isa_ = isa == FormatConverter::Isa::Best ? FormatConverter::getBestIsa() : isa;
+    accumulate_ = findAccumulateKernel(isa_);
+    // AVX2 without FMA keeps the SSE2 kernel
+    if (!accumulate_ && isa_ == FormatConverter::Isa::Avx2) {
+        isa_ = FormatConverter::Isa::Sse2;
+        accumulate_ = findAccumulateKernel(isa_);
+    }
+    if (!accumulate_) {
+        isa_ = FormatConverter::Isa::Scalar;
+        accumulate_ = accumulateScalar;
+    }
+}
+
+Mixer::~Mixer() noexcept { clear(); }
+
+bool Mixer::prepare(int32_t channelCount, int32_t sampleRate, int32_t maxFrames) {
+    clear();
+
+    if (channelCount <= 0 || sampleRate <= 0 || maxFrames <= 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(controlLock_);
+    channelCount_ = channelCount;
+    sampleRate_ = sampleRate;
+    maxFrames_ = maxFrames;
+    scratch_.reset(new float[static_cast<size_t>(maxFrames) * channelCount]);
+    return true;
+}
+
+int32_t Mixer::addSource(std::unique_ptr<AudioSource> source, float gain) {
+    std::lock_guard<std::mutex> lock(controlLock_);
+
+    if (!source || !scratch_) {
+        return -1;
+    }
+    if (source->getChannelCount() != channelCount_ || source->getSampleRate() != sampleRate_) {
+        LOGE("Mixer source %dHz %dch does not match output %dHz %dch", source->getSampleRate(),
+             source->getChannelCount(), sampleRate_, channelCount_);
+        return -1;
+    }
+
+    std::unique_ptr<Voice> voice(new Voice());
+    voice->source = std::move(source);
+    voice->gain.store(gain, std::memory_order_relaxed);
+    voice->appliedGain = gain;
+
+    for (int32_t slot = 0; slot < kMaxSources; slot++) {
+        if (slots_[slot].load() != nullptr) {
+            continue;
+        }
+
+        voice->id = static_cast<int32_t>((++nextGeneration_ & 0x7FFFFF) << kSlotBits) | slot;
+        int32_t id = voice->id;
+        activeCount_.fetch_add(1, std::memory_order_acq_rel);
+        // Publishing the pointer makes the fully built voice visible to render()
+        slots_[slot].store(voice.release());
+        return id;
+    }
+
+    LOGE("Mixer is full (%d sources)", kMaxSources);
+    return -1;
+}
+
+bool Mixer::removeSource(int32_t id) {
+    std::lock_guard<std::mutex> lock(controlLock_);
+
+    Voice* voice = findVoice(id);
+    if (!voice) {
+        return false;
+    }
+
+    slots_[id & kSlotMask].store(nullptr);
+    if (!voice->finished.exchange(true)) {
+        activeCount_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    retire(voice);
+    reclaimRetired();
+    return true;
+}
+
+bool Mixer::setGain(int32_t id, float gain) {
+    std::lock_guard<std::mutex> lock(controlLock_);
+
+    Voice* voice = findVoice(id);
+    if (!voice) {
+        return false;
+    }
+    voice->gain.store(gain, std::memory_order_relaxed);
+    return true;
+}
+
+void Mixer::clear() {
+    std::lock_guard<std::mutex> lock(controlLock_);
+
+    for (auto& slot : slots_) {
+        delete slot.exchange(nullptr);
+    }
+    for (auto& retired : retired_) {
+        delete retired.voice;
+    }
+    retired_.clear();
+    activeCount_.store(0, std::memory_order_release);
+}
+
+void Mixer::collectGarbage() {
+    std::lock_guard<std::mutex> lock(controlLock_);
+
+    // Unpublish sources that reached their end
+    for (auto& slot : slots_) {
+        Voice* voice = slot.load();
+        if (voice && voice->finished.load(std::memory_order_acquire)) {
+            slot.store(nullptr);
+            retire(voice);
+        }
+    }
+    reclaimRetired();
+}
+
+void Mixer::reclaimRetired() {
+    // A voice retired during pass N (odd epoch) is unreachable once the epoch moved on
+    uint64_t epoch = renderEpoch_.load();
+    auto reclaimable = [epoch](const RetiredVoice& retired) {
+        return (retired.epoch & 1) == 0 || retired.epoch != epoch;
+    };
+    for (auto& retired : retired_) {
+        if (reclaimable(retired)) {
+            delete retired.voice;
+            retired.voice = nullptr;
+        }
+    }
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                                  [](const RetiredVoice& retired) { return retired.voice == nullptr; }),
+                   retired_.end());
+}
+
+Mixer::Voice* Mixer::findVoice(int32_t id) const {
+    if (id < 0) {
+        return nullptr;
+    }
+    Voice* voice = slots_[id & kSlotMask].load();
+    return voice && voice->id == id ? voice : nullptr;
+}
+
+void Mixer::retire(Voice* voice) {
+    // Sequentially consistent with render()'s epoch increment, see collectGarbage()
+    retired_.push_back({voice, renderEpoch_.load()});
+}
+
+int32_t Mixer::render(float* mix, int32_t numFrames, bool accumulate) {
+    renderEpoch_.fetch_add(1);
+
+    if (!accumulate) {
+        memset(mix, 0, static_cast<size_t>(numFrames) * channelCount_ * sizeof(float));
+    }
+
+    int32_t contributors = 0;
+    for (auto& slot : slots_) {
+        Voice* voice = slot.load();
+        if (!voice || voice->finished.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        float startGain = voice->appliedGain;
+        float endGain = voice->gain.load(std::memory_order_relaxed);
+        int32_t framesDone = 0;
+        while (framesDone < numFrames) {
+            int32_t chunkFrames = std::min(numFrames - framesDone, maxFrames_);
+            int32_t framesRead = voice->source->read(scratch_.get(), chunkFrames);
+
+            // Ramp only over the first chunk, the rest uses the new gain
+            accumulate_(mix + static_cast<size_t>(framesDone) * channelCount_, scratch_.get(),
+                        framesRead * channelCount_, startGain, endGain);
+            startGain = endGain;
+            framesDone += framesRead;
+
+            if (framesRead < chunkFrames) {
+                if (voice->source->isFinished() && !voice->finished.exchange(true)) {
+                    activeCount_.fetch_sub(1, std::memory_order_acq_rel);
+                }
+                break;
+            }
+        }
+        voice->appliedGain = endGain;
+        contributors++;
+    }
+
+    renderEpoch_.fetch_add(1);
+    return contributors;
+}
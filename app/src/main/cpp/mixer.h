@@ -0,0 +1,146 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include "audio_source.h"
+#include "format_converter.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Lock-free multi-source mixer
+ *
+ * Sums up to kMaxSources AudioSources with per-source gain into one float
+ * buffer, so alarm, notification and media layers share a single output
+ * stream. Sources live in fixed slots of atomic pointers: the control thread
+ * publishes or unpublishes a slot with one atomic exchange and the audio
+ * thread never blocks. Removed sources are retired and only destroyed once
+ * the audio thread has left the render pass that could still see them.
+ *
+ * Gain changes are ramped over one render pass to avoid zipper noise.
+ * Accumulation uses NEON/SSE2/AVX2 kernels, saturation happens when the float
+ * mix is converted to the stream format.
+ */
+class Mixer {
+public:
+    static constexpr int32_t kMaxSources = 64;
+
+    /**
+     * Constructor
+     * @param isa Instruction set of the accumulate kernels, Best picks the fastest one available
+     */
+    explicit Mixer(FormatConverter::Isa isa = FormatConverter::Isa::Best);
+
+    /**
+     * Destructor, the stream must no longer call render()
+     */
+    ~Mixer() noexcept;
+
+    // Disable copy and assignment
+    Mixer(const Mixer&) = delete;
+    Mixer& operator=(const Mixer&) = delete;
+
+    /**
+     * Set the output layout and allocate scratch memory (not real-time safe)
+     * Removes all sources, call while the stream is not rendering.
+     * @param channelCount Output channel count, sources must match
+     * @param sampleRate Output sample rate, sources must match
+     * @param maxFrames Largest frame count per scratch pass
+     */
+    bool prepare(int32_t channelCount, int32_t sampleRate, int32_t maxFrames);
+
+    /**
+     * Add a source while rendering (control thread)
+     * @param source Source with the mixer's channel count and sample rate
+     * @param gain Linear gain
+     * @return Source id, or -1 if the source does not match or all slots are busy
+     */
+    int32_t addSource(std::unique_ptr<AudioSource> source, float gain);
+
+    /**
+     * Remove a source while rendering (control thread)
+     * @return Returns false if the id is unknown
+     */
+    bool removeSource(int32_t id);
+
+    /**
+     * Change the gain of a source, ramped in the next render pass
+     * @return Returns false if the id is unknown
+     */
+    bool setGain(int32_t id, float gain);
+
+    /**
+     * Remove every source, call while the stream is not rendering
+     */
+    void clear();
+
+    /**
+     * Destroy sources that finished or were removed and are no longer visible
+     * to the audio thread (control thread)
+     */
+    void collectGarbage();
+
+    /**
+     * Get the number of sources that are still producing audio
+     */
+    int32_t getActiveCount() const { return activeCount_.load(std::memory_order_acquire); }
+
+    /**
+     * Get the instruction set of the accumulate kernels, Scalar if the requested one is unavailable
+     */
+    FormatConverter::Isa getIsa() const { return isa_; }
+
+    /**
+     * Mix all sources into mix (real-time safe, audio thread only)
+     * @param mix Interleaved float buffer of numFrames frames
+     * @param numFrames Frames to render
+     * @param accumulate Add to the existing content of mix instead of overwriting it
+     * @return Number of sources that contributed
+     */
+    int32_t render(float* mix, int32_t numFrames, bool accumulate);
+
+private:
+    /**
+     * Add gain * source to target, gain ramping linearly from startGain to endGain
+     */
+    using AccumulateKernel = void (*)(float* target, const float* source, int32_t count, float startGain,
+                                      float endGain);
+
+    struct Voice {
+        std::unique_ptr<AudioSource> source;
+        std::atomic<float> gain{1.0f};
+        float appliedGain = 1.0f;          // Audio thread only
+        std::atomic<bool> finished{false}; // Ended or removed, no longer counted as active
+        int32_t id = -1;
+    };
+
+    struct RetiredVoice {
+        Voice* voice;
+        uint64_t epoch;
+    };
+
+    Voice* findVoice(int32_t id) const;
+    void retire(Voice* voice);
+    void reclaimRetired();
+
+    std::atomic<Voice*> slots_[kMaxSources];
+    std::atomic<int32_t> activeCount_{0};
+
+    // Odd while the audio thread is inside render()
+    std::atomic<uint64_t> renderEpoch_{0};
+
+    std::mutex controlLock_; // Serializes control-thread calls, never taken by render()
+    std::vector<RetiredVoice> retired_;
+    uint32_t nextGeneration_ = 0;
+
+    int32_t channelCount_ = 0;
+    int32_t sampleRate_ = 0;
+    int32_t maxFrames_ = 0;
+    std::unique_ptr<float[]> scratch_;
+    FormatConverter::Isa isa_ = FormatConverter::Isa::Scalar;
+    AccumulateKernel accumulate_ = nullptr;
+};
+
+#endif // MIXER_H
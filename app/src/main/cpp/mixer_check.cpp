@@ -0,0 +1,470 @@
+// Host check of Mixer: with 1, 4, 16 and 64 sources the mix matches a double-precision reference sum on every
+// accumulate kernel this CPU has, through gain ramps, chunked passes, accumulation and sources that end, and a
+// control thread adding, removing and retiring sources while another thread renders never destroys a source the
+// render pass can still read. With -b it also times render() per source count and kernel.
+#include "mixer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("mixer_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run mixes the same audio
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    double uniform(double low, double high) {
+        return low + (high - low) * static_cast<double>(next() >> 11) / 9007199254740992.0;
+    }
+
+private:
+    uint64_t state_;
+};
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kChannels = 2;
+constexpr int32_t kBurstFrames = 192;
+constexpr int32_t kSourceCounts[] = {1, 4, 16, 64};
+const FormatConverter::Isa kIsas[] = {FormatConverter::Isa::Scalar, FormatConverter::Isa::Sse2,
+                                      FormatConverter::Isa::Avx2, FormatConverter::Isa::Neon};
+
+/**
+ * Seeded noise in [-1, 1), endless or ending after a frame count; two sources with one seed read the same audio
+ */
+class NoiseSource : public AudioSource {
+public:
+    NoiseSource(uint64_t seed, int64_t frames) : random_(seed), framesLeft_(frames) {}
+
+    int32_t getSampleRate() const override { return kSampleRate; }
+    int32_t getChannelCount() const override { return kChannels; }
+
+    int32_t read(float* buffer, int32_t numFrames) override {
+        int32_t frames = framesLeft_ < 0 ? numFrames : static_cast<int32_t>(std::min<int64_t>(numFrames, framesLeft_));
+        for (int32_t i = 0; i < frames * kChannels; i++) {
+            buffer[i] = static_cast<float>(random_.uniform(-1.0, 1.0));
+        }
+        if (framesLeft_ >= 0) {
+            framesLeft_ -= frames;
+        }
+        return frames;
+    }
+
+    bool isFinished() const override { return framesLeft_ == 0; }
+
+private:
+    Random random_;
+    int64_t framesLeft_; // -1 for endless
+};
+
+/**
+ * Reference mixer voice: the same source and gain ramp as Mixer::render(), summed in double
+ */
+struct ReferenceVoice {
+    NoiseSource source;
+    float appliedGain;
+    float gain;
+    bool finished = false;
+};
+
+// Sum the voices like render() does: chunks of maxFrames, the ramp over the first chunk only
+int32_t renderReference(std::vector<ReferenceVoice>& voices, double* mix, double* magnitude, int32_t numFrames,
+                        int32_t maxFrames) {
+    std::vector<float> scratch(static_cast<size_t>(maxFrames) * kChannels);
+    int32_t contributors = 0;
+    for (ReferenceVoice& voice : voices) {
+        if (voice.finished) {
+            continue;
+        }
+        float startGain = voice.appliedGain;
+        int32_t framesDone = 0;
+        while (framesDone < numFrames) {
+            int32_t chunkFrames = std::min(numFrames - framesDone, maxFrames);
+            int32_t framesRead = voice.source.read(scratch.data(), chunkFrames);
+            const int32_t count = framesRead * kChannels;
+            float step = count > 0 ? (voice.gain - startGain) / static_cast<float>(count) : 0.0f;
+            for (int32_t i = 0; i < count; i++) {
+                double term = static_cast<double>(scratch[i]) * (startGain + step * static_cast<float>(i));
+                mix[framesDone * kChannels + i] += term;
+                magnitude[framesDone * kChannels + i] += std::fabs(term);
+            }
+            startGain = voice.gain;
+            framesDone += framesRead;
+            if (framesRead < chunkFrames) {
+                voice.finished = voice.source.isFinished();
+                break;
+            }
+        }
+        voice.appliedGain = voice.gain;
+        contributors++;
+    }
+    return contributors;
+}
+
+/**
+ * Mix sourceCount sources over several passes against the reference: passes longer than the scratch buffer,
+ * new gains on every source in pass 2, accumulation into existing content on odd passes, and every fifth source
+ * ending in pass 1
+ */
+void checkReference(FormatConverter::Isa isa, int32_t sourceCount) {
+    char name[48];
+    snprintf(name, sizeof(name), "reference %s %d sources", FormatConverter::getIsaName(isa), sourceCount);
+    constexpr int32_t kMaxFrames = 128;
+    constexpr int32_t kPasses = 5;
+    constexpr int32_t kEndingFrames = kBurstFrames + 75;
+
+    Mixer mixer(isa);
+    if (!expect(mixer.prepare(kChannels, kSampleRate, kMaxFrames), name, "prepare failed")) {
+        return;
+    }
+    Random random(static_cast<uint64_t>(sourceCount) * 7 + 1);
+    std::vector<ReferenceVoice> voices;
+    std::vector<int32_t> ids;
+    voices.reserve(sourceCount);
+    for (int32_t i = 0; i < sourceCount; i++) {
+        const int64_t frames = i % 5 == 4 ? kEndingFrames : -1;
+        const auto gain = static_cast<float>(random.uniform(0.0, 1.0));
+        ids.push_back(mixer.addSource(std::unique_ptr<AudioSource>(new NoiseSource(i + 1, frames)), gain));
+        voices.push_back({NoiseSource(i + 1, frames), gain, gain});
+    }
+    if (!expect(std::find(ids.begin(), ids.end(), -1) == ids.end() && mixer.getActiveCount() == sourceCount, name,
+                "sources not added")) {
+        return;
+    }
+
+    const int32_t sampleCount = kBurstFrames * kChannels;
+    std::vector<float> mix(sampleCount);
+    std::vector<double> expected(sampleCount);
+    std::vector<double> magnitude(sampleCount);
+    double worst = 0.0;
+    bool counted = true;
+    for (int32_t pass = 0; pass < kPasses; pass++) {
+        if (pass == 2) {
+            for (int32_t i = 0; i < sourceCount; i++) {
+                voices[i].gain = static_cast<float>(random.uniform(0.0, 1.5));
+                mixer.setGain(ids[i], voices[i].gain);
+            }
+        }
+        const bool accumulate = pass % 2 == 1;
+        for (int32_t i = 0; i < sampleCount; i++) {
+            mix[i] = accumulate ? static_cast<float>(random.uniform(-1.0, 1.0)) : 1e9f;
+            expected[i] = accumulate ? mix[i] : 0.0;
+            magnitude[i] = std::fabs(expected[i]);
+        }
+        int32_t contributors = mixer.render(mix.data(), kBurstFrames, accumulate);
+        counted = counted && contributors == renderReference(voices, expected.data(), magnitude.data(),
+                                                             kBurstFrames, kMaxFrames);
+        for (int32_t i = 0; i < sampleCount; i++) {
+            // Float sums of up to 64 terms, relative to the magnitude of the terms
+            worst = std::max(worst, std::fabs(mix[i] - expected[i]) / (magnitude[i] + 1e-3));
+        }
+    }
+    const int32_t ended = sourceCount / 5;
+    char what[96];
+    snprintf(what, sizeof(what), "error %.2e of the term magnitudes", worst);
+    if (expect(counted, name, "contributor count differs from the reference") &&
+        expect(mixer.getActiveCount() == sourceCount - ended, name, "ended sources still counted as active") &&
+        expect(worst < 1e-5, name, what)) {
+        printf("%s: max error %.1e ok\n", name, worst);
+    }
+}
+
+// Lifetime of every source made by the churn check, indexed by serial
+struct SourceState {
+    std::atomic<bool> reading{false};
+    std::atomic<bool> destroyed{false};
+};
+
+constexpr int32_t kChurnSources = 4000;
+SourceState churnStates[kChurnSources];
+std::atomic<int32_t> destroyedWhileReading{0};
+std::atomic<int32_t> readAfterDestroy{0};
+
+/**
+ * Source of DC at 1.0 that flags being destroyed during, or read after, its destruction
+ */
+class TrackedSource : public AudioSource {
+public:
+    TrackedSource(int32_t serial, int64_t frames) : serial_(serial), framesLeft_(frames) {}
+
+    ~TrackedSource() override {
+        SourceState& state = churnStates[serial_];
+        if (state.reading.load()) {
+            destroyedWhileReading.fetch_add(1);
+        }
+        state.destroyed.store(true);
+    }
+
+    int32_t getSampleRate() const override { return kSampleRate; }
+    int32_t getChannelCount() const override { return kChannels; }
+
+    int32_t read(float* buffer, int32_t numFrames) override {
+        SourceState& state = churnStates[serial_];
+        state.reading.store(true);
+        if (state.destroyed.load()) {
+            readAfterDestroy.fetch_add(1);
+        }
+        int32_t frames = framesLeft_ < 0 ? numFrames : static_cast<int32_t>(std::min<int64_t>(numFrames, framesLeft_));
+        std::fill(buffer, buffer + frames * kChannels, 1.0f);
+        if (framesLeft_ >= 0) {
+            framesLeft_ -= frames;
+        }
+        // Widens the window in which a premature delete would land inside read()
+        std::this_thread::yield();
+        state.reading.store(false);
+        return frames;
+    }
+
+    bool isFinished() const override { return framesLeft_ == 0; }
+
+private:
+    int32_t serial_;
+    int64_t framesLeft_;
+};
+
+/**
+ * Add, remove, re-gain and collect sources on this thread while another thread renders. Every source plays DC
+ * at 1.0 with gain 1/128, so a pass over endless sources is n/128 on every sample, n being the contributors.
+ */
+void checkChurn() {
+    const char* name = "churn";
+    constexpr float kGain = 1.0f / 128.0f;
+    Mixer mixer;
+    if (!expect(mixer.prepare(kChannels, kSampleRate, kBurstFrames), name, "prepare failed")) {
+        return;
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int32_t> passes{0};
+    std::atomic<int32_t> inconsistent{0};
+    std::thread renderer([&] {
+        std::vector<float> mix(static_cast<size_t>(kBurstFrames) * kChannels);
+        while (!done.load(std::memory_order_acquire)) {
+            int32_t contributors = mixer.render(mix.data(), kBurstFrames, false);
+            // Sources that end mid-pass contribute fewer frames, endless ones keep the sum flat
+            bool bounded = std::all_of(mix.begin(), mix.end(), [&](float sample) {
+                return sample <= contributors * kGain && sample >= 0.0f &&
+                       sample * 128.0f == std::floor(sample * 128.0f);
+            });
+            inconsistent.fetch_add(bounded ? 0 : 1);
+            passes.fetch_add(1);
+        }
+    });
+
+    Random random(11);
+    std::vector<int32_t> live;
+    int32_t created = 0;
+    int32_t removed = 0;
+    int32_t rejected = 0;
+    while (created < kChurnSources) {
+        // Up to 48 live sources, so ids of a slot get reused while the render pass still walks the slots
+        const uint64_t action = live.size() >= 48 ? 4 : random.next() % 8;
+        if (action < 4 || live.empty()) {
+            // A third of the sources end after a few passes and are retired by collectGarbage()
+            int64_t frames = action == 0 ? static_cast<int64_t>(random.next() % (4 * kBurstFrames)) + 1 : -1;
+            int32_t id = mixer.addSource(std::unique_ptr<AudioSource>(new TrackedSource(created++, frames)), kGain);
+            if (id >= 0) {
+                live.push_back(id);
+            } else {
+                rejected++;
+            }
+        } else if (action < 6) {
+            size_t index = random.next() % live.size();
+            removed += mixer.removeSource(live[index]) ? 1 : 0;
+            live.erase(live.begin() + static_cast<std::ptrdiff_t>(index));
+        } else if (action == 6) {
+            // Same gain, so no ramp, only the atomic store racing the render pass
+            mixer.setGain(live[random.next() % live.size()], kGain);
+        } else {
+            mixer.collectGarbage();
+        }
+        // Let the renderer through every few changes, also on a single core
+        if (random.next() % 2 == 0) {
+            const int32_t seen = passes.load();
+            while (passes.load() == seen) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    done.store(true, std::memory_order_release);
+    renderer.join();
+
+    const int32_t active = mixer.getActiveCount();
+    mixer.clear();
+    int32_t leaked = 0;
+    for (int32_t serial = 0; serial < created; serial++) {
+        leaked += churnStates[serial].destroyed.load() ? 0 : 1;
+    }
+    char what[96];
+    snprintf(what, sizeof(what), "%d sources destroyed inside read(), %d read after destruction",
+             destroyedWhileReading.load(), readAfterDestroy.load());
+    bool safe = expect(destroyedWhileReading.load() == 0 && readAfterDestroy.load() == 0, name, what);
+    snprintf(what, sizeof(what), "%d passes with a sum no set of sources gives", inconsistent.load());
+    bool summed = expect(inconsistent.load() == 0, name, what);
+    snprintf(what, sizeof(what), "%d active sources with %d live ids", active, static_cast<int32_t>(live.size()));
+    bool countedActive = expect(active <= static_cast<int32_t>(live.size()), name, what);
+    snprintf(what, sizeof(what), "%d of %d sources never destroyed", leaked, created);
+    bool destroyed = expect(leaked == 0, name, what);
+    if (safe && summed && countedActive && destroyed && expect(rejected == 0, name, "source rejected below 64")) {
+        printf("%s: %d sources, %d removed, %d passes ok\n", name, created, removed, passes.load());
+    }
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/**
+ * Source replaying a short buffer, so the benchmark times the mixer rather than the source
+ */
+class LoopSource : public AudioSource {
+public:
+    explicit LoopSource(const std::vector<float>* samples) : samples_(samples) {}
+
+    int32_t getSampleRate() const override { return kSampleRate; }
+    int32_t getChannelCount() const override { return kChannels; }
+
+    int32_t read(float* buffer, int32_t numFrames) override {
+        memcpy(buffer, samples_->data(), static_cast<size_t>(numFrames) * kChannels * sizeof(float));
+        return numFrames;
+    }
+
+    bool isFinished() const override { return false; }
+
+private:
+    const std::vector<float>* samples_;
+};
+
+// ns per render() of a burst, best of a few timed batches; odd batches ramp every gain
+double measureRender(FormatConverter::Isa isa, int32_t sourceCount, const std::vector<float>* samples,
+                     int32_t milliseconds) {
+    Mixer mixer(isa);
+    mixer.prepare(kChannels, kSampleRate, kBurstFrames);
+    std::vector<int32_t> ids;
+    for (int32_t i = 0; i < sourceCount; i++) {
+        ids.push_back(mixer.addSource(std::unique_ptr<AudioSource>(new LoopSource(samples)), 0.5f));
+    }
+    std::vector<float> mix(static_cast<size_t>(kBurstFrames) * kChannels);
+    double best = 1e30;
+    const uint64_t endNs = nowNs() + static_cast<uint64_t>(milliseconds) * 1000000;
+    for (int32_t batchIndex = 0; nowNs() < endNs; batchIndex++) {
+        const int32_t batch = 256;
+        for (int32_t id : ids) {
+            mixer.setGain(id, batchIndex % 2 ? 0.25f : 0.5f);
+        }
+        uint64_t beginNs = nowNs();
+        for (int32_t i = 0; i < batch; i++) {
+            mixer.render(mix.data(), kBurstFrames, false);
+        }
+        best = std::min(best, static_cast<double>(nowNs() - beginNs) / batch);
+    }
+    return best;
+}
+
+void benchmark(const std::vector<FormatConverter::Isa>& isas, int32_t milliseconds) {
+    std::vector<float> samples(static_cast<size_t>(kBurstFrames) * kChannels);
+    Random random(3);
+    for (float& sample : samples) {
+        sample = static_cast<float>(random.uniform(-1.0, 1.0));
+    }
+    for (int32_t sourceCount : kSourceCounts) {
+        double scalar = 0.0;
+        for (FormatConverter::Isa isa : isas) {
+            double ns = measureRender(isa, sourceCount, &samples, milliseconds);
+            if (isa == FormatConverter::Isa::Scalar) {
+                scalar = ns;
+            }
+            printf("%2d sources %-6s %8.0f ns/burst %6.2f ns/frame/source  %5.2fx scalar\n", sourceCount,
+                   FormatConverter::getIsaName(isa), ns, ns / (static_cast<double>(kBurstFrames) * sourceCount),
+                   ns > 0.0 ? scalar / ns : 0.0);
+        }
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Also time render() of a %d-frame burst with 1, 4, 16 and 64 sources per kernel\n"
+            "  -m <ms>       Time per source count and kernel for -b, default 200\n"
+            "  -v            Keep the mixer's log on stderr\n",
+            program, kBurstFrames);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool bench = false;
+    int32_t milliseconds = 200;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            bench = true;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-m") == 0 && index + 1 < argc && atoi(argv[index + 1]) > 0) {
+            milliseconds = atoi(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // addSource() logs every source rejected while the slots are full
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    std::vector<FormatConverter::Isa> isas;
+    for (FormatConverter::Isa isa : kIsas) {
+        if (Mixer(isa).getIsa() == isa) {
+            isas.push_back(isa);
+        }
+    }
+    for (FormatConverter::Isa isa : isas) {
+        for (int32_t sourceCount : kSourceCounts) {
+            checkReference(isa, sourceCount);
+        }
+    }
+    checkChurn();
+
+    if (bench) {
+        benchmark(isas, milliseconds);
+    }
+    if (failures > 0) {
+        printf("mixer_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,264 @@
+// Host stress check of independent PlayerEngine instances: dozens of engines with different files, formats and
+// pipeline configs play at once on their own threads, and each output must be bit-identical to the same render
+// done alone. Also reports how aggregate throughput scales from one engine at a time to all of them at once.
+#include "offline_renderer.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+// Synthetic input file, each with its own tone so outputs cannot be confused
+struct InputFile {
+    const char* name;
+    int32_t sampleRate;
+    int32_t channelCount;
+    int32_t bitsPerSample;
+    double frequency;
+};
+
+const InputFile kInputs[] = {
+    {"44k1-2ch-i16", 44100, 2, 16, 441.0},
+    {"48k-1ch-i16", 48000, 1, 16, 997.0},
+    {"48k-2ch-i24", 48000, 2, 24, 1503.0},
+    {"96k-6ch-i16", 96000, 6, 16, 2210.0},
+};
+
+// Pipeline variants, so instances differ in more than their file
+struct Variant {
+    const char* name;
+    void (*apply)(OfflineRenderer::Options* options);
+};
+
+const Variant kVariants[] = {
+    {"as file", [](OfflineRenderer::Options*) {}},
+    {"resampled to 48k float",
+     [](OfflineRenderer::Options* options) {
+         options->config.resampleToDeviceRate = true;
+         options->config.resamplerQuality = Resampler::Quality::High;
+         options->device.sampleRate = 48000;
+         options->device.format = SampleFormat::Float;
+     }},
+    {"stereo device i16",
+     [](OfflineRenderer::Options* options) {
+         options->config.outputChannelCount = PlayerConfig::kChannelsOfDevice;
+         options->device.channelCount = 2;
+         options->device.format = SampleFormat::I16;
+     }},
+    {"gain, EQ and fades",
+     [](OfflineRenderer::Options* options) {
+         options->config.dsp.gain = 0.5f;
+         options->config.dsp.startFadeMs = 50;
+         options->config.dsp.fadeShape = DspChain::FadeShape::Exponential;
+         DspChain::Band band;
+         band.frequencyHz = 1500.0f;
+         band.q = 2.0f;
+         band.gainDb = 6.0f;
+         options->config.dsp.bands.push_back(band);
+         options->device.framesPerBurst = 96;
+     }},
+};
+
+// Copies of every file x variant pair playing at once
+constexpr int32_t kCopies = 4;
+
+bool writeWave(const std::string& path, const InputFile& input, double seconds) {
+    const int32_t bytesPerSample = input.bitsPerSample / 8;
+    const int32_t bytesPerFrame = input.channelCount * bytesPerSample;
+    const auto frames = static_cast<uint32_t>(seconds * input.sampleRate);
+    const uint32_t dataBytes = frames * static_cast<uint32_t>(bytesPerFrame);
+
+    std::string data;
+    auto putLe = [&data](uint32_t value, int32_t bytes) {
+        for (int32_t i = 0; i < bytes; i++) {
+            data.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    };
+    data.append("RIFF", 4);
+    putLe(36 + dataBytes, 4);
+    data.append("WAVEfmt ", 8);
+    putLe(16, 4);
+    putLe(1, 2);
+    putLe(static_cast<uint32_t>(input.channelCount), 2);
+    putLe(static_cast<uint32_t>(input.sampleRate), 4);
+    putLe(static_cast<uint32_t>(input.sampleRate * bytesPerFrame), 4);
+    putLe(static_cast<uint32_t>(bytesPerFrame), 2);
+    putLe(static_cast<uint32_t>(input.bitsPerSample), 2);
+    data.append("data", 4);
+    putLe(dataBytes, 4);
+
+    // A different harmonic per channel, so a channel mix-up shows too
+    const double fullScale = std::ldexp(1.0, input.bitsPerSample - 1) - 1.0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (int32_t channel = 0; channel < input.channelCount; channel++) {
+            double phase = 2.0 * M_PI * input.frequency * (channel + 1) * frame / input.sampleRate;
+            auto sample = static_cast<int32_t>(std::lrint(0.4 * fullScale * std::sin(phase)));
+            putLe(static_cast<uint32_t>(sample), bytesPerSample);
+        }
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return file.good();
+}
+
+struct Instance {
+    OfflineRenderer::Options options;
+    OfflineRenderer::Job job;
+    std::string name;
+};
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Render every instance on its own thread, all started together
+std::vector<OfflineRenderer::Result> renderConcurrently(const std::vector<Instance>& instances) {
+    std::vector<OfflineRenderer::Result> results(instances.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < instances.size(); i++) {
+        threads.emplace_back([&instances, &results, i]() {
+            results[i] = OfflineRenderer(instances[i].options).render(instances[i].job);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return results;
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -t <seconds>  Length of each input file, default 1\n"
+            "  -k            Keep the files in the work directory\n"
+            "  -v            Keep the engines' log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 1.0;
+    bool keep = false;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-k") == 0) {
+            keep = true;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-t") == 0 && index + 1 < argc && atof(argv[index + 1]) > 0.0) {
+            seconds = atof(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // Every engine logs its stream setup
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/aaudioplayer-multi-XXXXXX";
+    std::vector<char> dirName(pattern.begin(), pattern.end());
+    dirName.push_back('\0');
+    if (!mkdtemp(dirName.data())) {
+        printf("multi_instance_check: cannot create %s\n", pattern.c_str());
+        return 1;
+    }
+    const std::string dir = dirName.data();
+    std::vector<std::string> files;
+
+    // References: each file x variant rendered alone, one engine at a time
+    std::vector<Instance> references;
+    for (const InputFile& input : kInputs) {
+        std::string inputPath = dir + "/" + input.name + ".wav";
+        files.push_back(inputPath);
+        if (!writeWave(inputPath, input, seconds)) {
+            printf("multi_instance_check: cannot write %s\n", inputPath.c_str());
+            return 1;
+        }
+        for (size_t v = 0; v < sizeof(kVariants) / sizeof(kVariants[0]); v++) {
+            Instance reference;
+            kVariants[v].apply(&reference.options);
+            reference.name = std::string(input.name) + ", " + kVariants[v].name;
+            reference.job.inputPath = inputPath;
+            reference.job.outputPath = dir + "/" + input.name + "-v" + std::to_string(v) + ".wav";
+            files.push_back(reference.job.outputPath);
+            references.push_back(reference);
+        }
+    }
+
+    double audioSeconds = 0.0;
+    uint64_t beginNs = nowNs();
+    for (const Instance& reference : references) {
+        OfflineRenderer::Result result = OfflineRenderer(reference.options).render(reference.job);
+        if (!result.ok) {
+            printf("multi_instance_check: %s: %s\n", reference.name.c_str(), result.error.c_str());
+            failures++;
+        }
+        audioSeconds += result.sampleRate > 0 ? static_cast<double>(result.frames) / result.sampleRate : 0.0;
+    }
+    const uint64_t sequentialNs = nowNs() - beginNs;
+
+    // Every reference kCopies times over, all engines at once, each compared with its reference
+    std::vector<Instance> instances;
+    for (int32_t copy = 0; copy < kCopies; copy++) {
+        for (const Instance& reference : references) {
+            Instance instance = reference;
+            instance.job.outputPath = reference.job.outputPath + ".copy" + std::to_string(copy);
+            instance.job.goldenPath = reference.job.outputPath;
+            files.push_back(instance.job.outputPath);
+            instances.push_back(instance);
+        }
+    }
+    beginNs = nowNs();
+    std::vector<OfflineRenderer::Result> results = renderConcurrently(instances);
+    const uint64_t concurrentNs = nowNs() - beginNs;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!results[i].ok) {
+            printf("multi_instance_check: %s (copy %zu): %s\n", instances[i].name.c_str(), i / references.size(),
+                   results[i].error.empty() ? "output differs from the instance rendered alone"
+                                            : results[i].error.c_str());
+            failures++;
+        }
+    }
+
+    printf("%zu engines alone: %.1fx realtime in aggregate\n", references.size(),
+           audioSeconds * 1e9 / std::max<uint64_t>(sequentialNs, 1));
+    printf("%zu engines at once on %u cores: %.1fx realtime in aggregate (%.2fx the throughput alone)\n",
+           instances.size(), std::thread::hardware_concurrency(),
+           audioSeconds * kCopies * 1e9 / std::max<uint64_t>(concurrentNs, 1),
+           static_cast<double>(sequentialNs) * kCopies / std::max<uint64_t>(concurrentNs, 1));
+
+    if (!keep) {
+        for (const std::string& file : files) {
+            unlink(file.c_str());
+        }
+        rmdir(dir.c_str());
+    }
+    if (failures > 0) {
+        printf("multi_instance_check: %d failures\n", failures);
+        return 1;
+    }
+    printf("%zu concurrent engines bit-identical to their solo renders\n", instances.size());
+    return 0;
+}
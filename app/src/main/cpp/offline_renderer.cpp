@@ -0,0 +1,215 @@
+#include "offline_renderer.h"
+#include "audio_file.h"
+#include "audio_log.h"
+#include "callback_stats.h"
+#include "format_converter.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Keeps the first error the engine reports for a job
+class ErrorListener : public PlayerEngine::Listener {
+public:
+    void onPlaybackStarted() override {}
+    void onPlaybackStopped() override {}
+    void onPlaybackError(const std::string& error) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty()) {
+            error_ = error;
+        }
+    }
+
+    std::string getError() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return error_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::string error_;
+};
+
+} // namespace
+
+OfflineRenderer::OfflineRenderer(const Options& options) : options_(options) {}
+
+OfflineRenderer::Result OfflineRenderer::render(const Job& job) const {
+    Result result;
+    PlayerConfig config;
+    if (!makeConfig(job.inputPath, &config, &result.error)) {
+        return result;
+    }
+
+    // Before the engine exists, its mixer picks its kernel when constructed
+    if (options_.deterministic) {
+        FormatConverter::setScalarOnly(true);
+    }
+
+    RenderSink::Options sinkOptions;
+    sinkOptions.outputPath = job.outputPath;
+    sinkOptions.container = options_.container;
+    sinkOptions.device = options_.device;
+
+    // Only one stream per job: a single file never needs a stream swap
+    RenderSink* sink = nullptr;
+    PlayerEngine engine([&sink, &sinkOptions]() -> std::unique_ptr<AudioSink> {
+        sink = new RenderSink(sinkOptions);
+        return std::unique_ptr<AudioSink>(sink);
+    });
+    ErrorListener listener;
+    engine.setListener(&listener);
+    engine.setConfig(config);
+
+    if (!engine.start() || !sink) {
+        engine.setListener(nullptr);
+        result.error = listener.getError();
+        if (result.error.empty()) {
+            result.error = "cannot start playback";
+        }
+        return result;
+    }
+
+    sink->waitUntilFinished();
+    SimulatedSink::Stats stats = sink->getStats();
+    bool finished = !engine.isPlaying();
+    result.sampleRate = sink->getSampleRate();
+    result.frames = static_cast<int64_t>(stats.framesRendered);
+
+    // Drop the silence that pads the last burst after the end of the file
+    int64_t endFrame = engine.getEndFrame();
+    if (endFrame >= 0) {
+        sink->setFrameLimit(endFrame);
+        result.frames = std::min(result.frames, endFrame);
+    }
+    result.elapsedNs = stats.elapsedNs;
+    result.callbackNs = stats.totalCallbackNs;
+    if (result.elapsedNs > 0 && result.sampleRate > 0) {
+        result.realtimeFactor = static_cast<double>(result.frames) / result.sampleRate * 1e9 / result.elapsedNs;
+    }
+
+    // Finalize the file before the engine releases the sink, to see whether it was written completely
+    sink->close();
+    bool writeOk = sink->isWriteOk();
+    engine.stop();
+    engine.setListener(nullptr);
+
+    result.error = listener.getError();
+    if (result.error.empty() && !finished) {
+        result.error = "stopped before the end of the file";
+    }
+    if (result.error.empty() && !writeOk) {
+        result.error = "cannot write " + job.outputPath;
+    }
+
+    if (result.error.empty() && !job.goldenPath.empty()) {
+        result.compared = true;
+        result.mismatchOffset = compareFiles(job.outputPath, job.goldenPath);
+        if (result.mismatchOffset == -2) {
+            result.error = "cannot read " + job.goldenPath;
+        } else if (result.mismatchOffset >= 0) {
+            result.error = "differs from " + job.goldenPath + " at byte " + std::to_string(result.mismatchOffset);
+        }
+    }
+
+    result.ok = result.error.empty();
+    LOGI("Offline render %s: %s, %lld frames, %.1fx realtime", job.inputPath.c_str(),
+         result.ok ? "ok" : result.error.c_str(), static_cast<long long>(result.frames), result.realtimeFactor);
+    return result;
+}
+
+std::vector<OfflineRenderer::Result> OfflineRenderer::renderAll(const std::vector<Job>& jobs, Summary* summary) const {
+    std::vector<Result> results(jobs.size());
+    uint64_t beginNs = CallbackStats::nowNs();
+
+    auto threadCount = static_cast<size_t>(options_.threadCount > 0 ? options_.threadCount
+                                                                    : std::thread::hardware_concurrency());
+    threadCount = std::max<size_t>(std::min(threadCount, jobs.size()), 1);
+
+    // Workers take the next job until none is left, each result slot is written by one worker only
+    std::atomic<size_t> nextJob{0};
+    auto worker = [&]() {
+        for (size_t index = nextJob.fetch_add(1); index < jobs.size(); index = nextJob.fetch_add(1)) {
+            results[index] = render(jobs[index]);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+
+    if (summary) {
+        *summary = Summary();
+        summary->elapsedNs = CallbackStats::nowNs() - beginNs;
+        for (const Result& result : results) {
+            (result.ok ? summary->succeeded : summary->failed)++;
+            if (result.sampleRate > 0) {
+                summary->audioSeconds += static_cast<double>(result.frames) / result.sampleRate;
+            }
+        }
+        if (summary->elapsedNs > 0) {
+            summary->realtimeFactor = summary->audioSeconds * 1e9 / summary->elapsedNs;
+        }
+    }
+    return results;
+}
+
+int64_t OfflineRenderer::compareFiles(const std::string& pathA, const std::string& pathB) {
+    std::ifstream fileA(pathA, std::ios::binary);
+    std::ifstream fileB(pathB, std::ios::binary);
+    if (!fileA.is_open() || !fileB.is_open()) {
+        return -2;
+    }
+
+    char bufferA[64 * 1024];
+    char bufferB[64 * 1024];
+    int64_t offset = 0;
+    for (;;) {
+        fileA.read(bufferA, sizeof(bufferA));
+        fileB.read(bufferB, sizeof(bufferB));
+        std::streamsize countA = fileA.gcount();
+        std::streamsize countB = fileB.gcount();
+        std::streamsize common = std::min(countA, countB);
+        for (std::streamsize i = 0; i < common; i++) {
+            if (bufferA[i] != bufferB[i]) {
+                return offset + i;
+            }
+        }
+        if (countA != countB) {
+            return offset + common;
+        }
+        if (countA == 0) {
+            return -1;
+        }
+        offset += countA;
+    }
+}
+
+// Configuration of one job: the renderer's, with a prefetch ring holding the whole file
+bool OfflineRenderer::makeConfig(const std::string& inputPath, PlayerConfig* config, std::string* error) const {
+    std::unique_ptr<AudioFile> file = openAudioFile(inputPath, options_.config.ioMode);
+    if (!file || file->getSampleRate() <= 0 || file->getBytesPerFrame() <= 0) {
+        *error = "cannot open " + inputPath;
+        return false;
+    }
+    uint64_t frames = file->getDataSize() / static_cast<uint64_t>(file->getBytesPerFrame());
+    uint64_t durationMs = frames * 1000 / static_cast<uint64_t>(file->getSampleRate()) + kPrefetchMarginMs;
+
+    *config = options_.config;
+    config->audioFilePath = inputPath;
+    config->prefetchDepthMs = static_cast<int32_t>(
+        std::min<uint64_t>(durationMs, static_cast<uint64_t>(std::numeric_limits<int32_t>::max())));
+    config->prefetchHighWaterPercent = 100;
+    if (options_.deterministic) {
+        config->dither = false;
+    }
+    return true;
+}
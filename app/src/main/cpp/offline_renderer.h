@@ -0,0 +1,97 @@
+#ifndef OFFLINE_RENDERER_H
+#define OFFLINE_RENDERER_H
+
+#include "player_engine.h"
+#include "render_sink.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Faster-than-realtime rendering of files through the whole player pipeline
+ *
+ * Each job plays one file on its own PlayerEngine against a RenderSink, so
+ * file parsing, decoding, conversion, resampling, remixing and the DSP chain
+ * all run exactly as on a device, only pulled as fast as the CPU allows and
+ * written to a file instead. The prefetch ring is sized to hold the whole
+ * file, so a streamed or decoded file never underflows however fast the
+ * callback runs and the output is deterministic.
+ *
+ * renderAll() spreads jobs over worker threads, one engine per job. An
+ * optional golden file per job is compared byte for byte with the output.
+ * Output is cut after the last frame of the file. By default it renders
+ * without dither and with the scalar kernels only, so it is bit-identical
+ * on every machine and golden files need no tolerance.
+ */
+class OfflineRenderer {
+public:
+    struct Options {
+        PlayerConfig config; // audioFilePath is set per job
+        RenderSink::Container container = RenderSink::Container::Wav;
+        SimulatedSink::Options device; // Granted stream parameters and burst size
+        int32_t threadCount = 0;       // Workers of renderAll(), 0 for one per core
+        // No dither, and FormatConverter::setScalarOnly() for the whole process; false renders as on a device
+        bool deterministic = true;
+    };
+
+    struct Job {
+        std::string inputPath;
+        std::string outputPath;
+        std::string goldenPath; // Compared with the output when not empty
+    };
+
+    struct Result {
+        bool ok = false;        // Rendered to the end, written completely and matching the golden file if any
+        std::string error;      // Why not, empty on success
+        int64_t frames = 0;     // Stream frames written
+        int32_t sampleRate = 0; // Of the stream
+        uint64_t elapsedNs = 0; // From the first to the last callback
+        uint64_t callbackNs = 0;
+        double realtimeFactor = 0.0; // Audio duration / elapsed time
+        bool compared = false;
+        int64_t mismatchOffset = -1; // First differing byte, -1 if the files are identical
+    };
+
+    struct Summary {
+        int32_t succeeded = 0;
+        int32_t failed = 0;
+        double audioSeconds = 0.0;
+        uint64_t elapsedNs = 0;      // Wall time of renderAll()
+        double realtimeFactor = 0.0; // Audio rendered by all workers / wall time
+    };
+
+    explicit OfflineRenderer(const Options& options);
+
+    // Disable copy and assignment
+    OfflineRenderer(const OfflineRenderer&) = delete;
+    OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+    /**
+     * Render one file on the calling thread (blocking)
+     */
+    Result render(const Job& job) const;
+
+    /**
+     * Render all jobs on worker threads (blocking)
+     * @param summary Receives totals and the aggregate throughput, may be nullptr
+     * @return One result per job, in job order
+     */
+    std::vector<Result> renderAll(const std::vector<Job>& jobs, Summary* summary = nullptr) const;
+
+    /**
+     * Compare two files byte for byte
+     * @return Offset of the first difference (the shorter length if one is a prefix of the other),
+     *         -1 if identical, -2 if a file cannot be read
+     */
+    static int64_t compareFiles(const std::string& pathA, const std::string& pathB);
+
+private:
+    // Prefetch depth beyond the file duration
+    static constexpr int32_t kPrefetchMarginMs = 1000;
+
+    bool makeConfig(const std::string& inputPath, PlayerConfig* config, std::string* error) const;
+
+    Options options_;
+};
+
+#endif // OFFLINE_RENDERER_H
@@ -0,0 +1,595 @@
+#include "peak_index.h"
+#include "audio_log.h"
+#include "callback_stats.h"
+#include "sample_access.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(sizeof(PeakIndex::Header) == 64 && sizeof(PeakIndex::LevelEntry) == 24 && sizeof(PeakIndex::Bin) == 6,
+              "Cache layout changed, bump kVersion");
+
+// std::min takes kReadBins by reference
+constexpr uint64_t PeakIndex::kReadBins;
+
+namespace {
+
+constexpr char kMagic[4] = {'A', 'P', 'K', 'I'};
+constexpr const char* kCacheSuffix = ".peaks";
+
+// Channels a bin reduction keeps on the stack
+constexpr int32_t kMaxChannels = 64;
+
+// Complete level 0 bins hashed into the fingerprint, evenly spread from the first to the last
+constexpr uint64_t kFingerprintBins = 64;
+
+/**
+ * Reduce numFrames frames, accumulating into min, max and sumSquares (one entry per channel)
+ */
+using BinKernel = void (*)(const void* data,
+                           int32_t numFrames,
+                           int32_t channelCount,
+                           float* min,
+                           float* max,
+                           float* sumSquares);
+
+// Min, max and sum of squares per channel
+struct BinChannels {
+    float* min;
+    float* max;
+    float* sumSquares;
+};
+
+struct BinReducer {
+    template <int32_t N>
+    struct Lanes {
+        float min[N];
+        float max[N];
+        float sum[N] = {};
+        Lanes() {
+            std::fill(min, min + N, FLT_MAX);
+            std::fill(max, max + N, -FLT_MAX);
+        }
+    };
+
+    template <int32_t N>
+    void add(Lanes<N>& lanes, int32_t lane, float x) const {
+        lanes.min[lane] = x < lanes.min[lane] ? x : lanes.min[lane];
+        lanes.max[lane] = x > lanes.max[lane] ? x : lanes.max[lane];
+        lanes.sum[lane] += x * x;
+    }
+
+    template <int32_t N>
+    void fold(const Lanes<N>& lanes, int32_t lane, BinChannels& channels, int32_t channel) const {
+        channels.min[channel] = std::min(channels.min[channel], lanes.min[lane]);
+        channels.max[channel] = std::max(channels.max[channel], lanes.max[lane]);
+        channels.sumSquares[channel] += lanes.sum[lane];
+    }
+
+    void addToChannel(BinChannels& channels, int32_t channel, float x) const {
+        channels.min[channel] = x < channels.min[channel] ? x : channels.min[channel];
+        channels.max[channel] = x > channels.max[channel] ? x : channels.max[channel];
+        channels.sumSquares[channel] += x * x;
+    }
+};
+
+/**
+ * Bin kernel, Channels > 0 fixes the channel count at compile time, see reduceChannels()
+ */
+template <typename Format, int32_t Channels>
+void binKernel(const void* data, int32_t numFrames, int32_t channelCount, float* min, float* max, float* sumSquares) {
+    BinChannels channels{min, max, sumSquares};
+    reduceChannels<Format, Channels>(data, numFrames, channelCount, BinReducer(), channels);
+}
+
+template <typename Format>
+BinKernel selectKernel(int32_t channelCount) {
+    switch (channelCount) {
+    case 1:
+        return binKernel<Format, 1>;
+    case 2:
+        return binKernel<Format, 2>;
+    case 6:
+        return binKernel<Format, 6>;
+    case 8:
+        return binKernel<Format, 8>;
+    default:
+        return binKernel<Format, 0>;
+    }
+}
+
+BinKernel findKernel(SampleFormat format, int32_t channelCount) {
+    switch (format) {
+    case SampleFormat::U8:
+        return selectKernel<U8Format>(channelCount);
+    case SampleFormat::I16:
+        return selectKernel<I16Format>(channelCount);
+    case SampleFormat::I24Packed:
+        return selectKernel<I24PackedFormat>(channelCount);
+    case SampleFormat::I32:
+        return selectKernel<I32Format>(channelCount);
+    case SampleFormat::Float:
+        return selectKernel<FloatFormat>(channelCount);
+    default:
+        return nullptr;
+    }
+}
+
+int16_t quantizeSample(float value) {
+    float scaled = std::min(std::max(value * kScaleI16, -32768.0f), 32767.0f);
+    return static_cast<int16_t>(std::lrintf(scaled));
+}
+
+uint16_t quantizeRms(double rms) { return static_cast<uint16_t>(std::lrint(std::min(rms, 1.0) * 65535.0)); }
+
+double rmsOf(const PeakIndex::Bin& bin) { return bin.rms * (1.0 / 65535.0); }
+
+// Reduce the frames of one level 0 bin into one Bin per channel
+void reduceBin(BinKernel kernel, const void* data, int32_t numFrames, int32_t channelCount, PeakIndex::Bin* bins) {
+    float min[kMaxChannels];
+    float max[kMaxChannels];
+    float sumSquares[kMaxChannels] = {};
+    std::fill(min, min + channelCount, FLT_MAX);
+    std::fill(max, max + channelCount, -FLT_MAX);
+    kernel(data, numFrames, channelCount, min, max, sumSquares);
+    for (int32_t channel = 0; channel < channelCount; channel++) {
+        bins[channel].min = quantizeSample(min[channel]);
+        bins[channel].max = quantizeSample(max[channel]);
+        bins[channel].rms = quantizeRms(std::sqrt(sumSquares[channel] / numFrames));
+    }
+}
+
+// Frames covered by bin index of a level, the last one may be short
+uint64_t binFrames(uint64_t index, int64_t framesPerBin, uint64_t frameCount) {
+    uint64_t first = index * static_cast<uint64_t>(framesPerBin);
+    return first >= frameCount ? 0 : std::min<uint64_t>(static_cast<uint64_t>(framesPerBin), frameCount - first);
+}
+
+/**
+ * Merge a run of bins of one channel, RMS weighted by the frames of each bin
+ * @param count Bins of the level from first, at least one
+ */
+PeakIndex::Bin mergeBins(const PeakIndex::Level& level,
+                         uint64_t first,
+                         uint64_t count,
+                         int32_t channel,
+                         int32_t channelCount,
+                         uint64_t frameCount) {
+    PeakIndex::Bin merged{std::numeric_limits<int16_t>::max(), std::numeric_limits<int16_t>::min(), 0};
+    double sumSquares = 0.0;
+    uint64_t frames = 0;
+    for (uint64_t index = first; index < first + count; index++) {
+        const PeakIndex::Bin& bin = level.bins[index * static_cast<uint64_t>(channelCount) + channel];
+        uint64_t weight = binFrames(index, level.framesPerBin, frameCount);
+        merged.min = std::min(merged.min, bin.min);
+        merged.max = std::max(merged.max, bin.max);
+        sumSquares += rmsOf(bin) * rmsOf(bin) * static_cast<double>(weight);
+        frames += weight;
+    }
+    merged.rms = frames > 0 ? quantizeRms(std::sqrt(sumSquares / static_cast<double>(frames))) : 0;
+    return merged;
+}
+
+// FNV-1a, over the bytes of a data range
+uint64_t hashBytes(uint64_t hash, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+/**
+ * Hash the data of up to kFingerprintBins complete level 0 bins of the first frameCount frames, evenly spread
+ * from the first to the last one, so an edit anywhere in a long file is likely to hit a hashed bin
+ * @return Returns false if the data cannot be read, 0 in hash if there is no complete bin
+ */
+bool fingerprintData(AudioFile& file, uint64_t frameCount, int32_t framesPerBin, uint64_t* hash) {
+    *hash = 0;
+    uint64_t completeBins = frameCount / static_cast<uint64_t>(framesPerBin);
+    if (completeBins == 0) {
+        return true;
+    }
+    const auto binBytes = static_cast<size_t>(framesPerBin) * static_cast<size_t>(file.getBytesPerFrame());
+    std::vector<uint8_t> buffer(binBytes);
+    uint64_t value = 0xcbf29ce484222325ull;
+    const uint64_t sampleCount = std::min(completeBins, kFingerprintBins);
+    for (uint64_t sample = 0; sample < sampleCount; sample++) {
+        // First and last bin always, the others at equal strides between them
+        uint64_t bin = sampleCount == 1 ? 0 : sample * (completeBins - 1) / (sampleCount - 1);
+        if (!file.seekAudioData(bin * binBytes)) {
+            return false;
+        }
+        size_t filled = 0;
+        for (size_t read = 1; filled < binBytes && read > 0; filled += read) {
+            read = file.readAudioData(buffer.data() + filled, binBytes - filled);
+        }
+        if (filled < binBytes) {
+            return false;
+        }
+        value = hashBytes(value, buffer.data(), binBytes);
+    }
+    *hash = value;
+    return true;
+}
+
+uint64_t alignUp(uint64_t value) { return (value + 7) & ~uint64_t{7}; }
+
+/**
+ * Write an index to the cache through a temporary file renamed over it
+ * Readers of the old cache keep their mapping, the rename only replaces the name.
+ * @return Returns false if the cache cannot be written
+ */
+bool writeCache(const std::string& cachePath, const std::vector<uint8_t>& image) {
+    std::string tempPath = cachePath + ".tmp";
+    int fd = ::open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t result = ::write(fd, image.data() + written, image.size() - written);
+        if (result <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+    bool ok = ::close(fd) == 0 && written == image.size() && rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    if (!ok) {
+        unlink(tempPath.c_str());
+    }
+    return ok;
+}
+
+} // namespace
+
+PeakIndex::~PeakIndex() noexcept { reset(); }
+
+const PeakIndex::Header& PeakIndex::header() const {
+    static const Header kEmpty{};
+    return data_ ? *reinterpret_cast<const Header*>(data_) : kEmpty;
+}
+
+const char* PeakIndex::getSourceName(Source source) {
+    switch (source) {
+    case Source::Cache:
+        return "cache";
+    case Source::Incremental:
+        return "incremental";
+    case Source::Scan:
+        return "scan";
+    default:
+        return "none";
+    }
+}
+
+void PeakIndex::reset() {
+    unmap();
+    data_ = nullptr;
+    image_.clear();
+    image_.shrink_to_fit();
+    levels_.clear();
+}
+
+void PeakIndex::unmap() {
+    if (mapBase_) {
+        munmap(mapBase_, mapLength_);
+    }
+    mapBase_ = nullptr;
+    mapLength_ = 0;
+}
+
+bool PeakIndex::load(const std::string& audioPath, const Options& options) {
+    reset();
+    stats_ = BuildStats();
+    const uint64_t beginNs = CallbackStats::nowNs();
+
+    std::unique_ptr<AudioFile> file = openAudioFile(audioPath, options.ioMode);
+    struct stat st {};
+    if (!file || stat(audioPath.c_str(), &st) != 0) {
+        LOGE("Peak index: cannot open %s", audioPath.c_str());
+        return false;
+    }
+    const int32_t channelCount = file->getChannelCount();
+    const int32_t framesPerBin = options.framesPerBin;
+    if (!findKernel(file->getSampleFormat(), channelCount) || channelCount <= 0 || channelCount > kMaxChannels ||
+        framesPerBin <= 0) {
+        LOGE("Peak index: unsupported %s (%s), %d frames per bin", audioPath.c_str(), file->getFormatInfo().c_str(),
+             framesPerBin);
+        return false;
+    }
+    const auto sourceSize = static_cast<uint64_t>(st.st_size);
+    const int64_t sourceMtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    const uint64_t frameCount = file->getDataSize() / static_cast<uint64_t>(file->getBytesPerFrame());
+    const std::string cachePath = options.cachePath.empty() ? audioPath + kCacheSuffix : options.cachePath;
+
+    // A cache of the same format is used as is if the file is unchanged. Its complete level 0 bins are kept
+    // only if the file grew, in frames and in bytes, and the fingerprint of the cached range still matches;
+    // a file rewritten at the same or a smaller length is rescanned
+    uint64_t keptBins = 0;
+    if (options.useCache && mapCache(cachePath)) {
+        const Header& cached = header();
+        bool sameFormat = cached.sampleRate == file->getSampleRate() && cached.channelCount == channelCount &&
+                          cached.framesPerBin == framesPerBin &&
+                          cached.sampleFormat == static_cast<int32_t>(file->getSampleFormat());
+        if (sameFormat && cached.sourceSize == sourceSize && cached.sourceMtimeNs == sourceMtimeNs &&
+            cached.frameCount == frameCount) {
+            stats_.source = Source::Cache;
+            stats_.elapsedNs = CallbackStats::nowNs() - beginNs;
+            LOGI("Peak index: %s mapped from %s", audioPath.c_str(), cachePath.c_str());
+            return true;
+        }
+        uint64_t fingerprint = 0;
+        bool grew = frameCount > cached.frameCount && sourceSize > cached.sourceSize;
+        if (sameFormat && grew && cached.frameCount >= static_cast<uint64_t>(framesPerBin) &&
+            fingerprintData(*file, cached.frameCount, framesPerBin, &fingerprint) &&
+            fingerprint == cached.fingerprint) {
+            keptBins = cached.frameCount / static_cast<uint64_t>(framesPerBin);
+        }
+    }
+
+    // Level sizes and offsets: every level halves the one below, down to a single bin
+    std::vector<LevelEntry> entries;
+    uint64_t binCount = (frameCount + framesPerBin - 1) / static_cast<uint64_t>(framesPerBin);
+    for (int64_t levelFrames = framesPerBin; static_cast<int32_t>(entries.size()) < kMaxLevels; levelFrames *= 2) {
+        entries.push_back(LevelEntry{0, binCount, levelFrames});
+        if (binCount <= 1) {
+            break;
+        }
+        binCount = (binCount + 1) / 2;
+    }
+    uint64_t size = alignUp(sizeof(Header) + entries.size() * sizeof(LevelEntry));
+    for (LevelEntry& entry : entries) {
+        entry.offset = size;
+        size = alignUp(size + entry.binCount * static_cast<uint64_t>(channelCount) * sizeof(Bin));
+    }
+    if (size > std::numeric_limits<size_t>::max()) {
+        LOGE("Peak index: %s too large to index", audioPath.c_str());
+        reset();
+        return false;
+    }
+
+    std::vector<uint8_t> image(static_cast<size_t>(size));
+    Header newHeader{};
+    memcpy(newHeader.magic, kMagic, sizeof(kMagic));
+    newHeader.version = kVersion;
+    newHeader.headerBytes = sizeof(Header);
+    newHeader.levelCount = static_cast<uint32_t>(entries.size());
+    newHeader.sourceSize = sourceSize;
+    newHeader.sourceMtimeNs = sourceMtimeNs;
+    newHeader.frameCount = frameCount;
+    newHeader.sampleRate = file->getSampleRate();
+    newHeader.channelCount = channelCount;
+    newHeader.framesPerBin = framesPerBin;
+    newHeader.sampleFormat = static_cast<int32_t>(file->getSampleFormat());
+    memcpy(image.data() + sizeof(Header), entries.data(), entries.size() * sizeof(LevelEntry));
+    auto levelBins = [&image, &entries](size_t level) {
+        return reinterpret_cast<Bin*>(image.data() + entries[level].offset);
+    };
+    if (keptBins > 0) {
+        memcpy(levelBins(0), levels_[0].bins, keptBins * static_cast<size_t>(channelCount) * sizeof(Bin));
+    }
+    reset();
+
+    // Level 0 from the file, the levels above merged from the one below
+    const uint64_t scanBeginNs = CallbackStats::nowNs();
+    if (!scan(audioPath, options, keptBins, entries[0].binCount, frameCount, levelBins(0))) {
+        return false;
+    }
+    stats_.scanNs = CallbackStats::nowNs() - scanBeginNs;
+    for (size_t level = 1; level < entries.size(); level++) {
+        const Level below{entries[level - 1].framesPerBin, entries[level - 1].binCount, levelBins(level - 1)};
+        Bin* bins = levelBins(level);
+        for (uint64_t index = 0; index < entries[level].binCount; index++) {
+            uint64_t count = std::min<uint64_t>(2, below.binCount - index * 2);
+            for (int32_t channel = 0; channel < channelCount; channel++) {
+                bins[index * channelCount + channel] = mergeBins(below, index * 2, count, channel, channelCount,
+                                                                 frameCount);
+            }
+        }
+    }
+    if (!fingerprintData(*file, frameCount, framesPerBin, &newHeader.fingerprint)) {
+        LOGE("Peak index: cannot read %s", audioPath.c_str());
+        return false;
+    }
+    memcpy(image.data(), &newHeader, sizeof(Header));
+
+    stats_.source = keptBins > 0 ? Source::Incremental : Source::Scan;
+    if (options.useCache) {
+        stats_.cacheWritten = writeCache(cachePath, image);
+        if (!stats_.cacheWritten) {
+            LOGW("Peak index: cannot write %s, index kept in memory", cachePath.c_str());
+        }
+    }
+
+    // Serve the index from the page cache from now on, like a later load() would
+    if (!stats_.cacheWritten || !mapCache(cachePath)) {
+        image_ = std::move(image);
+        data_ = image_.data();
+        parseLevels(image_.size());
+    }
+    stats_.elapsedNs = CallbackStats::nowNs() - beginNs;
+    LOGI("Peak index: %s %s, %llu frames scanned by %d threads in %.1fms, %d levels", audioPath.c_str(),
+         getSourceName(stats_.source), static_cast<unsigned long long>(stats_.framesScanned), stats_.threadCount,
+         stats_.scanNs / 1e6, getLevelCount());
+    return true;
+}
+
+bool PeakIndex::scan(const std::string& audioPath,
+                     const Options& options,
+                     uint64_t firstBin,
+                     uint64_t binCount,
+                     uint64_t frameCount,
+                     Bin* bins) {
+    const uint64_t chunkCount = (binCount - firstBin + kChunkBins - 1) / kChunkBins;
+    auto threadCount = static_cast<uint64_t>(options.threadCount > 0 ? options.threadCount
+                                                                     : std::thread::hardware_concurrency());
+    threadCount = std::max<uint64_t>(std::min(threadCount, chunkCount), 1);
+    const auto framesPerBin = static_cast<uint64_t>(options.framesPerBin);
+
+    // Workers take the next chunk of bins until none is left, each with its own file and read position
+    std::atomic<uint64_t> nextChunk{0};
+    std::atomic<bool> failed{false};
+    std::atomic<uint64_t> bytesScanned{0};
+    auto worker = [&]() {
+        std::unique_ptr<AudioFile> file = openAudioFile(audioPath, options.ioMode);
+        if (!file) {
+            failed.store(true);
+            return;
+        }
+        const int32_t channelCount = file->getChannelCount();
+        const auto bytesPerFrame = static_cast<uint64_t>(file->getBytesPerFrame());
+        const BinKernel kernel = findKernel(file->getSampleFormat(), channelCount);
+        std::vector<uint8_t> buffer(file->isMemoryMapped() ? 0 : kReadBins * framesPerBin * bytesPerFrame);
+
+        for (uint64_t chunk = nextChunk.fetch_add(1); chunk < chunkCount && !failed.load(std::memory_order_relaxed);
+             chunk = nextChunk.fetch_add(1)) {
+            uint64_t bin = firstBin + chunk * kChunkBins;
+            const uint64_t endBin = std::min(bin + kChunkBins, binCount);
+            if (!file->seekAudioData(bin * framesPerBin * bytesPerFrame)) {
+                failed.store(true);
+                break;
+            }
+            // A mapped file hands out the whole chunk in place, others are read a few bins at a time
+            while (bin < endBin) {
+                uint64_t groupBins = buffer.empty() ? endBin - bin : std::min(kReadBins, endBin - bin);
+                uint64_t groupFrames = std::min(groupBins * framesPerBin, frameCount - bin * framesPerBin);
+                auto groupBytes = static_cast<size_t>(groupFrames * bytesPerFrame);
+                const void* data = buffer.data();
+                size_t filled = 0;
+                if (buffer.empty()) {
+                    filled = file->mapAudioData(&data, groupBytes);
+                } else {
+                    for (size_t read = 1; filled < groupBytes && read > 0; filled += read) {
+                        read = file->readAudioData(buffer.data() + filled, groupBytes - filled);
+                    }
+                }
+                if (filled < groupBytes) {
+                    failed.store(true);
+                    break;
+                }
+                for (uint64_t frame = 0; frame < groupFrames; frame += framesPerBin, bin++) {
+                    auto frames = static_cast<int32_t>(std::min(framesPerBin, groupFrames - frame));
+                    reduceBin(kernel, static_cast<const uint8_t*>(data) + frame * bytesPerFrame, frames, channelCount,
+                              bins + bin * static_cast<uint64_t>(channelCount));
+                }
+                bytesScanned.fetch_add(groupBytes, std::memory_order_relaxed);
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (uint64_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+
+    if (failed.load()) {
+        LOGE("Peak index: cannot read %s", audioPath.c_str());
+        return false;
+    }
+    stats_.threadCount = static_cast<int32_t>(threadCount);
+    stats_.framesScanned = frameCount - std::min(frameCount, firstBin * framesPerBin);
+    stats_.bytesScanned = bytesScanned.load();
+    return true;
+}
+
+bool PeakIndex::mapCache(const std::string& cachePath) {
+    reset();
+    int fd = ::open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(Header) ||
+        static_cast<uint64_t>(st.st_size) > std::numeric_limits<size_t>::max()) {
+        ::close(fd);
+        return false;
+    }
+    auto length = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (base == MAP_FAILED) {
+        LOGW("Peak index: mmap failed for %s", cachePath.c_str());
+        return false;
+    }
+    mapBase_ = base;
+    mapLength_ = length;
+    data_ = static_cast<const uint8_t*>(base);
+
+    const Header& cached = header();
+    if (memcmp(cached.magic, kMagic, sizeof(kMagic)) != 0 || cached.version != kVersion ||
+        cached.headerBytes != sizeof(Header) || !parseLevels(length)) {
+        LOGW("Peak index: ignoring invalid or outdated cache %s", cachePath.c_str());
+        reset();
+        return false;
+    }
+    return true;
+}
+
+bool PeakIndex::parseLevels(size_t size) {
+    levels_.clear();
+    const Header& index = header();
+    if (index.levelCount == 0 || index.levelCount > static_cast<uint32_t>(kMaxLevels) || index.channelCount <= 0 ||
+        index.channelCount > kMaxChannels || index.framesPerBin <= 0 ||
+        sizeof(Header) + index.levelCount * sizeof(LevelEntry) > size) {
+        return false;
+    }
+    const auto binBytes = static_cast<uint64_t>(index.channelCount) * sizeof(Bin);
+    for (uint32_t level = 0; level < index.levelCount; level++) {
+        LevelEntry entry;
+        memcpy(&entry, data_ + sizeof(Header) + level * sizeof(LevelEntry), sizeof(entry));
+        if (entry.offset % alignof(Bin) != 0 || entry.offset > size ||
+            entry.binCount > (size - entry.offset) / binBytes ||
+            entry.framesPerBin != static_cast<int64_t>(index.framesPerBin) << level) {
+            levels_.clear();
+            return false;
+        }
+        auto bins = reinterpret_cast<const Bin*>(data_ + entry.offset);
+        levels_.push_back(Level{entry.framesPerBin, entry.binCount, bins});
+    }
+    return levels_[0].binCount * static_cast<uint64_t>(index.framesPerBin) >= index.frameCount;
+}
+
+bool PeakIndex::summarize(int64_t startFrame, int64_t frameCount, int32_t columns, Bin* out) const {
+    if (!isLoaded() || startFrame < 0 || frameCount <= 0 || columns <= 0 || !out) {
+        return false;
+    }
+    const int32_t channelCount = getChannelCount();
+    const auto totalFrames = static_cast<int64_t>(getFrameCount());
+
+    // Coarsest level with bins no wider than a column
+    size_t levelIndex = 0;
+    while (levelIndex + 1 < levels_.size() && levels_[levelIndex + 1].framesPerBin <= frameCount / columns) {
+        levelIndex++;
+    }
+    const Level& level = levels_[levelIndex];
+
+    for (int32_t column = 0; column < columns; column++) {
+        int64_t begin = startFrame + frameCount * column / columns;
+        int64_t end = std::max(startFrame + frameCount * (column + 1) / columns, begin + 1);
+        end = std::min(end, totalFrames);
+        Bin* bins = out + static_cast<size_t>(column) * channelCount;
+        if (begin >= end) {
+            std::fill(bins, bins + channelCount, Bin{0, 0, 0});
+            continue;
+        }
+        auto firstBin = static_cast<uint64_t>(begin / level.framesPerBin);
+        auto lastBin = static_cast<uint64_t>((end - 1) / level.framesPerBin);
+        for (int32_t channel = 0; channel < channelCount; channel++) {
+            bins[channel] = mergeBins(level, firstBin, lastBin - firstBin + 1, channel, channelCount, getFrameCount());
+        }
+    }
+    return true;
+}
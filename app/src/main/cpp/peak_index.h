@@ -0,0 +1,187 @@
+#ifndef PEAK_INDEX_H
+#define PEAK_INDEX_H
+
+#include "audio_file.h"
+#include "audio_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Multi-resolution min/max/RMS index of a file's samples, for waveform overviews
+ *
+ * Level 0 summarizes every framesPerBin frames of each channel, every level
+ * above merges two bins of the one below, up to a single bin for the whole
+ * file. Level 0 is scanned in chunks pulled by worker threads, each with its
+ * own AudioFile, reading a memory-mapped WAV in place; the per-bin reduction
+ * is a kernel with the channel count fixed at compile time for 1, 2, 6 and 8
+ * channels so it vectorizes. The levels above are merged from level 0.
+ *
+ * The index is cached in one file, by default the audio path plus ".peaks",
+ * and memory-mapped when reused. A cache whose size, mtime and format match
+ * is used as is. When the file changed but its format did not and it grew
+ * in frames and bytes, with a fingerprint of up to 64 complete bins spread
+ * over the cached range unchanged (e.g. a recording that has grown), the
+ * cached level 0 bins are kept and only the new frames are scanned.
+ * Anything else, an in-place edit of the same length included, rebuilds.
+ *
+ * Cache layout (native byte order, little-endian on every supported ABI):
+ *   Header, then levelCount LevelEntry, then the bins of each level at its offset.
+ *   Bins are interleaved by channel: bins[bin * channelCount + channel].
+ */
+class PeakIndex {
+public:
+    static constexpr uint32_t kVersion = 2;
+    static constexpr int32_t kMaxLevels = 40;
+
+    /**
+     * Summary of one channel over the frames of one bin
+     * min and max in full scale 32768, rms in full scale 65535
+     */
+    struct Bin {
+        int16_t min;
+        int16_t max;
+        uint16_t rms;
+    };
+
+    struct Header {
+        char magic[4];        // "APKI"
+        uint32_t version;     // kVersion
+        uint32_t headerBytes; // sizeof(Header)
+        uint32_t levelCount;
+        uint64_t sourceSize; // Of the audio file when indexed
+        int64_t sourceMtimeNs;
+        uint64_t frameCount; // Frames indexed
+        int32_t sampleRate;
+        int32_t channelCount;
+        int32_t framesPerBin; // Of level 0
+        int32_t sampleFormat; // SampleFormat of the file
+        uint64_t fingerprint; // Hash of the data of up to 64 complete level 0 bins, first and last included
+    };
+
+    struct LevelEntry {
+        uint64_t offset; // Of the first bin, from the start of the cache
+        uint64_t binCount;
+        int64_t framesPerBin;
+    };
+
+    struct Level {
+        int64_t framesPerBin = 0;
+        uint64_t binCount = 0; // The last bin may cover fewer frames
+        const Bin* bins = nullptr;
+    };
+
+    struct Options {
+        int32_t threadCount = 0;    // Scan workers, 0 for one per core
+        int32_t framesPerBin = 256; // Of level 0
+        std::string cachePath;      // Empty for the audio path plus ".peaks"
+        bool useCache = true;       // Read and write the cache file; false always scans and keeps the index in memory
+        AudioFile::IoMode ioMode = AudioFile::IoMode::MemoryMap;
+    };
+
+    /**
+     * How the last load() got the index
+     */
+    enum class Source {
+        None,
+        Cache,       // Mapped from the cache file as is
+        Incremental, // Cached level 0 kept, only frames past it scanned
+        Scan,        // Scanned from the start
+    };
+
+    struct BuildStats {
+        Source source = Source::None;
+        int32_t threadCount = 0;
+        uint64_t framesScanned = 0;
+        uint64_t bytesScanned = 0; // PCM bytes reduced, decoded size for FLAC
+        uint64_t elapsedNs = 0;    // Whole load(), scan and cache write included
+        uint64_t scanNs = 0;       // Level 0 scan only
+        bool cacheWritten = false;
+    };
+
+    PeakIndex() = default;
+    ~PeakIndex() noexcept;
+
+    // Disable copy and assignment, levels point into the index
+    PeakIndex(const PeakIndex&) = delete;
+    PeakIndex& operator=(const PeakIndex&) = delete;
+
+    /**
+     * Load the index of an audio file from its cache, or build it (blocking, not for the UI thread)
+     * A cache that cannot be written only logs a warning, the index is then kept in memory.
+     * @return Returns false if the file cannot be opened or read
+     */
+    bool load(const std::string& audioPath, const Options& options);
+
+    /**
+     * Drop the index and unmap the cache
+     */
+    void reset();
+
+    bool isLoaded() const { return data_ != nullptr; }
+    bool isMapped() const { return mapBase_ != nullptr; }
+
+    int32_t getChannelCount() const { return header().channelCount; }
+    int32_t getSampleRate() const { return header().sampleRate; }
+    uint64_t getFrameCount() const { return header().frameCount; }
+    int32_t getLevelCount() const { return static_cast<int32_t>(levels_.size()); }
+    const Level& getLevel(int32_t level) const { return levels_[static_cast<size_t>(level)]; }
+    const BuildStats& getBuildStats() const { return stats_; }
+
+    /**
+     * Summarize a frame range into columns, e.g. one per pixel of a waveform view
+     * Each column merges the bins of the coarsest level that still resolves it, so the cost
+     * follows the column count rather than the range length.
+     * @param out columns * channelCount bins, interleaved by channel; columns past the end are silent
+     * @return Returns false if not loaded or the arguments are invalid
+     */
+    bool summarize(int64_t startFrame, int64_t frameCount, int32_t columns, Bin* out) const;
+
+    static const char* getSourceName(Source source);
+
+private:
+    // Level 0 bins per unit of work of a scan worker
+    static constexpr uint64_t kChunkBins = 1024;
+    // Level 0 bins read per readAudioData() from a file that is not memory-mapped
+    static constexpr uint64_t kReadBins = 64;
+
+    const Header& header() const;
+
+    /**
+     * Map an existing cache and check its layout, the caller checks it against the file
+     * @return Returns false if there is no readable cache of this version
+     */
+    bool mapCache(const std::string& cachePath);
+
+    /**
+     * Scan level 0 bins [firstBin, binCount) of the file into bins
+     * @return Returns false if a worker could not open, seek or read the file
+     */
+    bool scan(const std::string& audioPath,
+              const Options& options,
+              uint64_t firstBin,
+              uint64_t binCount,
+              uint64_t frameCount,
+              Bin* bins);
+
+    /**
+     * Set up levels_ from the Header and LevelEntry table at data_
+     * @return Returns false if the table does not fit in size bytes
+     */
+    bool parseLevels(size_t size);
+
+    /**
+     * Unmap the cache, if mapped
+     */
+    void unmap();
+
+    const uint8_t* data_ = nullptr; // Header of the index, in the mapping or image_
+    void* mapBase_ = nullptr;       // Mapped cache file
+    size_t mapLength_ = 0;
+    std::vector<uint8_t> image_; // Index kept in memory when not mapped
+    std::vector<Level> levels_;
+    BuildStats stats_;
+};
+
+#endif // PEAK_INDEX_H
@@ -0,0 +1,122 @@
+// Host command line front end of PeakIndex: builds or refreshes the peak index of files and measures the scan
+#include "peak_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] <input file>...\n"
+            "  -j <threads>  Scan workers, default one per core\n"
+            "  -b <frames>   Frames per bin of the finest level, default 256\n"
+            "  -c <path>     Cache file, only with a single input; default the input path plus .peaks\n"
+            "  -n            Do not read or write the cache\n"
+            "  -s            Use stream reads instead of memory mapping\n"
+            "  -S            Measure scan throughput from 1 to the -j or core count threads, without the cache\n",
+            program);
+}
+
+// Scans per thread count of a scaling run, the best one is reported
+static constexpr int32_t kScalingRuns = 3;
+
+static void printIndex(const char* path, const PeakIndex& index) {
+    const PeakIndex::BuildStats& stats = index.getBuildStats();
+    printf("%s: %s, %llu frames %dHz %dch, %d levels, %llu frames scanned by %d threads in %.1fms (total %.1fms)%s\n",
+           path, PeakIndex::getSourceName(stats.source), static_cast<unsigned long long>(index.getFrameCount()),
+           index.getSampleRate(), index.getChannelCount(), index.getLevelCount(),
+           static_cast<unsigned long long>(stats.framesScanned), stats.threadCount, stats.scanNs / 1e6,
+           stats.elapsedNs / 1e6, stats.cacheWritten ? ", cache written" : "");
+}
+
+/**
+ * Scan one file with 1, 2, 4... threads up to maxThreads and print throughput and speedup
+ * @return Returns false if a scan failed
+ */
+static bool measureScaling(const char* path, PeakIndex::Options options, int32_t maxThreads) {
+    std::vector<int32_t> threadCounts;
+    for (int32_t threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    options.useCache = false;
+    double baseMbPerSecond = 0.0;
+    for (int32_t threads : threadCounts) {
+        options.threadCount = threads;
+        uint64_t bestNs = 0;
+        uint64_t bytes = 0;
+        for (int32_t run = 0; run < kScalingRuns; run++) {
+            PeakIndex index;
+            if (!index.load(path, options)) {
+                fprintf(stderr, "%s: cannot index\n", path);
+                return false;
+            }
+            const PeakIndex::BuildStats& stats = index.getBuildStats();
+            bestNs = run == 0 ? stats.scanNs : std::min(bestNs, stats.scanNs);
+            bytes = stats.bytesScanned;
+        }
+        double mbPerSecond = bestNs > 0 ? bytes * 1e3 / bestNs : 0.0;
+        if (threads == 1) {
+            baseMbPerSecond = mbPerSecond;
+        }
+        printf("%s: %2d threads %8.1fms %8.1f MB/s  x%.2f\n", path, threads, bestNs / 1e6, mbPerSecond,
+               baseMbPerSecond > 0.0 ? mbPerSecond / baseMbPerSecond : 0.0);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    PeakIndex::Options options;
+    bool scaling = false;
+
+    int index = 1;
+    for (; index < argc && argv[index][0] == '-'; index++) {
+        const char* option = argv[index];
+        const char* value = index + 1 < argc ? argv[index + 1] : nullptr;
+        if (strcmp(option, "-j") == 0 && value) {
+            options.threadCount = atoi(value);
+            index++;
+        } else if (strcmp(option, "-b") == 0 && value) {
+            options.framesPerBin = atoi(value);
+            index++;
+        } else if (strcmp(option, "-c") == 0 && value) {
+            options.cachePath = value;
+            index++;
+        } else if (strcmp(option, "-n") == 0) {
+            options.useCache = false;
+        } else if (strcmp(option, "-s") == 0) {
+            options.ioMode = AudioFile::IoMode::Stream;
+        } else if (strcmp(option, "-S") == 0) {
+            scaling = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (index == argc || (!options.cachePath.empty() && argc - index > 1)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    int32_t failed = 0;
+    for (; index < argc; index++) {
+        if (scaling) {
+            int32_t maxThreads = options.threadCount > 0 ? options.threadCount
+                                                         : static_cast<int32_t>(std::thread::hardware_concurrency());
+            failed += measureScaling(argv[index], options, std::max(maxThreads, 1)) ? 0 : 1;
+            continue;
+        }
+        PeakIndex peaks;
+        if (!peaks.load(argv[index], options)) {
+            fprintf(stderr, "%s: cannot index\n", argv[index]);
+            failed++;
+            continue;
+        }
+        printIndex(argv[index], peaks);
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,383 @@
+// Host check of the whole player pipeline on SimulatedSink: PlayerEngine plays synthetic files end to end through
+// passthrough, conversion, resampling, remixing, layers and the DSP chain, each ending on the exact frame, and
+// reports the throughput of every path. A queued file in another format swaps the stream while another thread
+// reads the stream parameters and adds layers. Also checks that a sink closed from its own callback keeps its
+// burst buffer and driver thread until it is closed or destroyed on another thread.
+#include "player_engine.h"
+#include "simulated_sink.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("pipeline_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// Synthetic input file, a tone per channel
+struct InputFile {
+    const char* name;
+    int32_t sampleRate;
+    int32_t channelCount;
+    int32_t bitsPerSample;
+};
+
+const InputFile kMainInput = {"48k-2ch-i16", 48000, 2, 16};
+const InputFile kI24Input = {"48k-2ch-i24", 48000, 2, 24};
+const InputFile kRateInput = {"44k1-2ch-i16", 44100, 2, 16};
+const InputFile kSurroundInput = {"48k-6ch-i16", 48000, 6, 16};
+const InputFile kLayerInput = {"48k-2ch-i16-layer", 48000, 2, 16};
+
+// Layers are short, so the paced case stays short too
+constexpr double kLayerSeconds = 0.5;
+
+int64_t getFrames(const InputFile& input, double seconds) { return static_cast<int64_t>(seconds * input.sampleRate); }
+
+bool writeWave(const std::string& path, const InputFile& input, double seconds) {
+    const int32_t bytesPerSample = input.bitsPerSample / 8;
+    const int32_t bytesPerFrame = input.channelCount * bytesPerSample;
+    const auto frames = static_cast<uint32_t>(getFrames(input, seconds));
+    const uint32_t dataBytes = frames * static_cast<uint32_t>(bytesPerFrame);
+
+    std::string data;
+    auto putLe = [&data](uint32_t value, int32_t bytes) {
+        for (int32_t i = 0; i < bytes; i++) {
+            data.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    };
+    data.append("RIFF", 4);
+    putLe(36 + dataBytes, 4);
+    data.append("WAVEfmt ", 8);
+    putLe(16, 4);
+    putLe(1, 2);
+    putLe(static_cast<uint32_t>(input.channelCount), 2);
+    putLe(static_cast<uint32_t>(input.sampleRate), 4);
+    putLe(static_cast<uint32_t>(input.sampleRate * bytesPerFrame), 4);
+    putLe(static_cast<uint32_t>(bytesPerFrame), 2);
+    putLe(static_cast<uint32_t>(input.bitsPerSample), 2);
+    data.append("data", 4);
+    putLe(dataBytes, 4);
+
+    const double fullScale = std::ldexp(1.0, input.bitsPerSample - 1) - 1.0;
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        for (int32_t channel = 0; channel < input.channelCount; channel++) {
+            double phase = 2.0 * M_PI * 441.0 * (channel + 1) * frame / input.sampleRate;
+            auto sample = static_cast<int32_t>(std::lrint(0.4 * fullScale * std::sin(phase)));
+            putLe(static_cast<uint32_t>(sample), bytesPerSample);
+        }
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return file.good();
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Sink closed, and reopened, from inside its own data callback
+struct CloseCallbackState {
+    SimulatedSink* sink = nullptr;
+    int32_t callbacks = 0;
+    size_t burstBytes = 0;
+    bool reopenRejected = false;
+    std::atomic<bool> closed{false};
+    std::atomic<bool> returned{false};
+};
+
+AudioSink::CallbackResult closingCallback(void* userData, void* audioData, int32_t /*numFrames*/) {
+    auto state = static_cast<CloseCallbackState*>(userData);
+    if (++state->callbacks < 3) {
+        return AudioSink::CallbackResult::Continue;
+    }
+    state->sink->close();
+    state->reopenRejected = !state->sink->open(AudioSinkConfig(), closingCallback, nullptr, userData);
+    state->closed.store(true);
+    // The other thread tears the sink down meanwhile; the burst buffer has to stay valid until this returns
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    memset(audioData, 0x5A, state->burstBytes);
+    state->returned.store(true);
+    return AudioSink::CallbackResult::Continue;
+}
+
+AudioSink::CallbackResult silenceCallback(void* /*userData*/, void* audioData, int32_t numFrames) {
+    memset(audioData, 0, static_cast<size_t>(numFrames) * 2 * sizeof(int16_t));
+    return AudioSink::CallbackResult::Continue;
+}
+
+void checkCloseFromCallback(bool destroy) {
+    const char* name = destroy ? "close from callback, destroyed" : "close from callback, reopened";
+    SimulatedSink::Options options;
+    options.realtime = false;
+    options.maxFrames = 16 * options.framesPerBurst; // Ends the reopened stream
+    std::unique_ptr<SimulatedSink> sink(new SimulatedSink(options));
+    CloseCallbackState state;
+    state.sink = sink.get();
+    state.burstBytes = static_cast<size_t>(options.framesPerBurst) * 2 * sizeof(int16_t);
+    if (!expect(sink->open(AudioSinkConfig(), closingCallback, nullptr, &state) && sink->start(), name,
+                "cannot start")) {
+        return;
+    }
+    while (!state.closed.load()) {
+        std::this_thread::yield();
+    }
+
+    if (destroy) {
+        // Has to wait for the callback to return, rather than free the sink under the driver thread
+        sink.reset();
+        expect(state.returned.load(), name, "sink destroyed while its callback was running");
+    } else {
+        bool reopened = sink->open(AudioSinkConfig(), silenceCallback, nullptr, nullptr);
+        expect(state.returned.load(), name, "sink reopened while its old callback was running");
+        expect(reopened && sink->start(), name, "cannot reopen after closing from the callback");
+        sink->waitUntilFinished();
+        sink->close();
+    }
+    if (expect(state.reopenRejected, name, "open() from the callback replaced the buffer in use")) {
+        printf("%s: ok\n", name);
+    }
+}
+
+/**
+ * Pipeline configuration played end to end
+ */
+struct PipelineCase {
+    const char* name;
+    const InputFile* input;
+    int32_t layers;
+    bool paced; // Callbacks at the wall-clock rate, so layers can join before the file ends
+    void (*apply)(PlayerConfig* config, SimulatedSink::Options* device);
+};
+
+const PipelineCase kPipelineCases[] = {
+    {"passthrough i16", &kMainInput, 0, false, [](PlayerConfig*, SimulatedSink::Options*) {}},
+    {"i24 to float", &kI24Input, 0, false,
+     [](PlayerConfig*, SimulatedSink::Options* device) { device->format = SampleFormat::Float; }},
+    {"i16 to i16, streamed", &kMainInput, 0, false,
+     [](PlayerConfig* config, SimulatedSink::Options*) { config->ioMode = AudioFile::IoMode::Stream; }},
+    {"44.1k resampled to 48k", &kRateInput, 0, false,
+     [](PlayerConfig* config, SimulatedSink::Options* device) {
+         config->resampleToDeviceRate = true;
+         device->sampleRate = 48000;
+     }},
+    {"6ch remixed to stereo", &kSurroundInput, 0, false,
+     [](PlayerConfig* config, SimulatedSink::Options* device) {
+         config->outputChannelCount = PlayerConfig::kChannelsOfDevice;
+         device->channelCount = 2;
+     }},
+    {"2 layers, paced", &kLayerInput, 2, true, [](PlayerConfig*, SimulatedSink::Options*) {}},
+    {"EQ, fades and meter", &kMainInput, 0, false,
+     [](PlayerConfig* config, SimulatedSink::Options* device) {
+         config->dsp.gain = 0.5f;
+         config->dsp.startFadeMs = 50;
+         DspChain::Band band;
+         band.frequencyHz = 1000.0f;
+         band.gainDb = 6.0f;
+         config->dsp.bands.push_back(band);
+         config->levelMeter.enabled = true;
+         device->format = SampleFormat::Float;
+     }},
+};
+
+// Play a file as fast as the pipeline renders it (or paced), the last audio frame must be the last frame of the file
+void checkPipeline(const PipelineCase& pipelineCase, const std::string& dir, double seconds) {
+    const char* name = pipelineCase.name;
+    PlayerConfig config;
+    config.audioFilePath = dir + "/" + pipelineCase.input->name + ".wav";
+    SimulatedSink::Options device;
+    pipelineCase.apply(&config, &device);
+    device.realtime = pipelineCase.paced;
+
+    SimulatedSink* sink = nullptr;
+    PlayerEngine engine([&sink, &device]() -> std::unique_ptr<AudioSink> {
+        sink = new SimulatedSink(device);
+        return std::unique_ptr<AudioSink>(sink);
+    });
+    engine.setConfig(config);
+    if (!expect(engine.start() && sink, name, "cannot start playback")) {
+        return;
+    }
+    int32_t layers = 0;
+    for (int32_t i = 0; i < pipelineCase.layers; i++) {
+        layers += engine.addLayer(dir + "/" + kLayerInput.name + ".wav", 0.25f) >= 0 ? 1 : 0;
+    }
+    sink->waitUntilFinished();
+    SimulatedSink::Stats stats = sink->getStats();
+    const int32_t sampleRate = sink->getSampleRate();
+    const int64_t endFrame = engine.getEndFrame();
+    const bool stopped = !engine.isPlaying();
+    engine.stop();
+
+    // The resampler's output length is the rate ratio of the input, give or take its filter delay
+    const int64_t fileFrames =
+        getFrames(*pipelineCase.input, pipelineCase.input == &kLayerInput ? kLayerSeconds : seconds);
+    const int64_t expectedFrames = fileFrames * sampleRate / pipelineCase.input->sampleRate;
+    const int64_t tolerance = sampleRate == pipelineCase.input->sampleRate ? 0 : 64;
+    char what[96];
+    snprintf(what, sizeof(what), "ended on frame %lld, expected %lld", static_cast<long long>(endFrame),
+             static_cast<long long>(expectedFrames));
+    if (!expect(layers == pipelineCase.layers, name, "cannot add a layer") ||
+        !expect(stopped && endFrame >= 0, name, "playback did not complete") ||
+        !expect(std::llabs(endFrame - expectedFrames) <= tolerance, name, what)) {
+        return;
+    }
+    const double audioSeconds = static_cast<double>(stats.framesRendered) / sampleRate;
+    char speed[32];
+    if (pipelineCase.paced) {
+        snprintf(speed, sizeof(speed), "%llu late callbacks", static_cast<unsigned long long>(stats.deadlineMisses));
+    } else {
+        snprintf(speed, sizeof(speed), "%.1fx realtime", audioSeconds * 1e9 / std::max<uint64_t>(stats.elapsedNs, 1));
+    }
+    printf("%-24s %18s  %6.1f ns/frame  max callback %6.1f us: ok\n", name, speed,
+           static_cast<double>(stats.totalCallbackNs) / std::max<uint64_t>(stats.framesRendered, 1),
+           static_cast<double>(stats.maxCallbackNs) / 1000.0);
+}
+
+/**
+ * A queued 44.1 kHz file behind a 48 kHz one swaps the stream; meanwhile this thread reads the stream parameters
+ * and adds and removes layers, which must only ever see one whole stream or none
+ */
+void checkStreamSwap(const std::string& dir, double seconds) {
+    const char* name = "stream swap";
+    SimulatedSink::Options device;
+    device.realtime = false;
+    std::atomic<int32_t> sinksCreated{0};
+    PlayerEngine engine([&device, &sinksCreated]() -> std::unique_ptr<AudioSink> {
+        sinksCreated.fetch_add(1);
+        return std::unique_ptr<AudioSink>(new SimulatedSink(device));
+    });
+    PlayerConfig config;
+    config.audioFilePath = dir + "/" + kMainInput.name + ".wav";
+    engine.setConfig(config);
+    if (!expect(engine.start() && engine.enqueue(dir + "/" + kRateInput.name + ".wav"), name,
+                "cannot start playback")) {
+        return;
+    }
+
+    const std::string layerPath = dir + "/" + kLayerInput.name + ".wav";
+    int32_t polls = 0;
+    int32_t torn = 0;
+    int32_t layersAdded = 0;
+    bool seen44k = false;
+    const uint64_t deadlineNs = nowNs() + 30000000000ull;
+    while ((engine.isPlaying() || engine.getEndFrame() < 0) && nowNs() < deadlineNs) {
+        PlayerEngine::StreamInfo info = engine.getStreamInfo();
+        bool none = info.sampleRate == 0 && info.channelCount == 0 && info.framesPerBurst == 0;
+        bool whole = (info.sampleRate == 48000 || info.sampleRate == 44100) && info.channelCount == 2 &&
+                     info.framesPerBurst == device.framesPerBurst && info.bufferSizeInFrames > 0;
+        torn += none || whole ? 0 : 1;
+        seen44k = seen44k || info.sampleRate == 44100;
+        if (++polls % 16 == 0) {
+            int32_t id = engine.addLayer(layerPath, 0.1f);
+            if (id >= 0) {
+                layersAdded++;
+                engine.removeLayer(id);
+            }
+        }
+        std::this_thread::yield();
+    }
+    const int64_t endFrame = engine.getEndFrame();
+    engine.stop();
+
+    char what[96];
+    snprintf(what, sizeof(what), "%d of %d stream parameter reads mixed two streams", torn, polls);
+    expect(torn == 0, name, what);
+    // The second stream carries only the queued file
+    snprintf(what, sizeof(what), "%d streams opened, end frame %lld", sinksCreated.load(),
+             static_cast<long long>(endFrame));
+    if (expect(sinksCreated.load() == 2 && endFrame == getFrames(kRateInput, seconds), name, what)) {
+        printf("%s: %d reads, %d layers added, 44.1k stream %s: ok\n", name, polls, layersAdded,
+               seen44k ? "seen" : "not seen");
+    }
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -t <seconds>  Length of each input file, default 2\n"
+            "  -v            Keep the engines' log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 2.0;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[index], "-t") == 0 && index + 1 < argc && atof(argv[index + 1]) > 0.0) {
+            seconds = atof(argv[++index]);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // Every engine logs its stream setup
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    checkCloseFromCallback(true);
+    checkCloseFromCallback(false);
+
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/aaudioplayer-pipeline-XXXXXX";
+    std::vector<char> dirName(pattern.begin(), pattern.end());
+    dirName.push_back('\0');
+    if (!mkdtemp(dirName.data())) {
+        printf("pipeline_check: cannot create %s\n", pattern.c_str());
+        return 1;
+    }
+    const std::string dir = dirName.data();
+    std::vector<std::string> files;
+    for (const InputFile* input : {&kMainInput, &kI24Input, &kRateInput, &kSurroundInput, &kLayerInput}) {
+        files.push_back(dir + "/" + input->name + ".wav");
+        if (!writeWave(files.back(), *input, input == &kLayerInput ? kLayerSeconds : seconds)) {
+            printf("pipeline_check: cannot write %s\n", files.back().c_str());
+            failures++;
+        }
+    }
+
+    if (failures == 0) {
+        for (const PipelineCase& pipelineCase : kPipelineCases) {
+            checkPipeline(pipelineCase, dir, seconds);
+        }
+        checkStreamSwap(dir, seconds);
+    }
+
+    for (const std::string& file : files) {
+        unlink(file.c_str());
+    }
+    rmdir(dir.c_str());
+    if (failures > 0) {
+        printf("pipeline_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,761 @@
+#include "player_engine.h"
+#include "audio_log.h"
+#include "file_source.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// Records one callback into CallbackStats on every return path
+class CallbackTimer {
+public:
+    CallbackTimer(CallbackStats& stats, const AudioSink& sink, int32_t numFrames)
+        : stats_(stats), sink_(sink), numFrames_(numFrames), beginNs_(stats.begin(numFrames)) {}
+    ~CallbackTimer() { stats_.end(beginNs_, numFrames_, sink_.getXRunCount()); }
+
+    uint64_t getBeginNs() const { return beginNs_; }
+
+private:
+    CallbackStats& stats_;
+    const AudioSink& sink_;
+    int32_t numFrames_;
+    uint64_t beginNs_;
+};
+
+// Frames converted or mixed per pass when the stream format differs from the file format
+static constexpr int32_t kConvertChunkFrames = 1024;
+
+// Fade out and back in around a seek, short enough to sound like a cut but without the click
+static constexpr int32_t kSeekFadeMs = 5;
+
+// stop() waits this much longer than the stop fade for the callback to render it
+static constexpr int32_t kStopFadeMarginMs = 100;
+
+PlayerEngine::PlayerEngine(SinkFactory sinkFactory) : sinkFactory_(std::move(sinkFactory)) {}
+
+PlayerEngine::~PlayerEngine() noexcept {
+    releasePlayback();
+    events_.stop();
+}
+
+void PlayerEngine::setListener(Listener* listener,
+                               EventDispatcher::ThreadHook onThreadStart,
+                               EventDispatcher::ThreadHook onThreadStop) {
+    events_.stop();
+    listener_ = listener;
+    if (listener_) {
+        events_.start([this](const PlayerEvent* events, size_t count) { dispatchEvents(events, count); },
+                      std::move(onThreadStart), std::move(onThreadStop));
+    }
+}
+
+bool PlayerEngine::start() {
+    if (isPlaying_.load()) {
+        return false;
+    }
+    startNs_ = CallbackStats::nowNs();
+    latencyEstimator_.clear();
+
+    // Opening also starts the prefetch reader, moving file reads off the audio thread;
+    // a cached clip skips the file altogether
+    TrackQueue::Options trackOptions = makeTrackOptions();
+    std::unique_ptr<Track> track = TrackQueue::openTrack(config_.audioFilePath, 0, trackOptions);
+    if (!track) {
+        notifyPlaybackError("[FILE] Cannot open audio file");
+        return false;
+    }
+    streamFrame_ = 0;
+    gapStartFrame_ = -1;
+    endFrame_.store(-1);
+    seekRequestFrame_.store(-1);
+    position_.store(0);
+    startPath_ = track->source;
+    firstFramePending_.store(true);
+    queue_.start(std::move(track), trackOptions, [this] { swapStream(); });
+
+    std::unique_lock<std::mutex> sinkLock(sinkMutex_);
+    if (!openSink()) {
+        sinkLock.unlock();
+        releasePlayback();
+        notifyPlaybackError("[STREAM] Failed to create playback stream");
+        return false;
+    }
+    startedWarm_ = sink_->isReused();
+    startStreamMonitors();
+
+    // Only a fresh start fades in, a stream swap continues the next file at full level
+    if (config_.dsp.startFadeMs > 0) {
+        dspChain_.resetFade(0.0f);
+        dspChain_.fadeTo(1.0f, config_.dsp.startFadeMs, config_.dsp.fadeShape);
+    }
+
+    isPlaying_.store(true);
+    if (!sink_->start()) {
+        isPlaying_.store(false);
+        sinkLock.unlock();
+        releasePlayback();
+        notifyPlaybackError("[STREAM] Failed to start playback stream");
+        return false;
+    }
+    sinkLock.unlock();
+
+    LOGI("Playback started successfully");
+    notifyPlaybackStarted();
+    return true;
+}
+
+void PlayerEngine::stop() {
+    fadeOutForStop();
+    isPlaying_.store(false);
+    releasePlayback();
+    notifyPlaybackStopped();
+}
+
+// Let the callback fade the output to silence, so the stream stops on it instead of cutting the audio
+void PlayerEngine::fadeOutForStop() {
+    const int32_t fadeMs = config_.dsp.stopFadeMs;
+    if (!isPlaying_.load() || fadeMs <= 0) {
+        return;
+    }
+    uint32_t fadeId = dspChain_.fadeTo(0.0f, fadeMs, config_.dsp.fadeShape);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(fadeMs + kStopFadeMarginMs);
+    while (isPlaying_.load() && !dspChain_.isFadeComplete(fadeId) && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void PlayerEngine::setGain(float gain) {
+    config_.dsp.gain = gain;
+    dspChain_.setGain(gain);
+}
+
+bool PlayerEngine::prewarm() {
+    if (isPlaying_.load()) {
+        return false;
+    }
+
+    std::unique_ptr<Track> track = TrackQueue::openTrack(config_.audioFilePath, 0, makeTrackOptions());
+    std::unique_ptr<AudioSink> sink = sinkFactory_ ? sinkFactory_() : nullptr;
+    if (!track || !sink || !sink->open(makeSinkConfig(*track), dataCallback, errorCallback, this)) {
+        LOGE("Prewarm failed: %s", config_.audioFilePath.c_str());
+        return false;
+    }
+    // Never started, a pooled sink keeps the stream for the next start()
+    sink->close();
+    LOGI("Prewarmed stream for %s", track->getFormatInfo().c_str());
+    return true;
+}
+
+PlayerEngine::StreamInfo PlayerEngine::getStreamInfo() const {
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    StreamInfo info;
+    if (sink_) {
+        info.sampleRate = sink_->getSampleRate();
+        info.channelCount = sink_->getChannelCount();
+        info.framesPerBurst = sink_->getFramesPerBurst();
+        info.bufferSizeInFrames = sink_->getBufferSizeInFrames();
+    }
+    return info;
+}
+
+PrefetchReader::Stats PlayerEngine::getPrefetchStats() const {
+    return queue_.getPrefetchStats();
+}
+
+bool PlayerEngine::seek(int64_t frame) {
+    if (!isPlaying_.load()) {
+        return false;
+    }
+    frame = std::max<int64_t>(frame, 0);
+    seekRequestNs_.store(CallbackStats::nowNs(), std::memory_order_relaxed);
+    seekRequestFrame_.store(frame, std::memory_order_release);
+    position_.store(frame, std::memory_order_relaxed);
+    return true;
+}
+
+bool PlayerEngine::enqueue(const std::string& path) {
+    if (!isPlaying_.load()) {
+        LOGE("Cannot queue %s, not playing", path.c_str());
+        return false;
+    }
+    queue_.enqueue(path);
+    LOGI("Queued: %s", path.c_str());
+    return true;
+}
+
+TrackQueue::Options PlayerEngine::makeTrackOptions() {
+    TrackQueue::Options options;
+    options.ioMode = config_.ioMode;
+    options.prefetchDepthMs = config_.prefetchDepthMs;
+    options.prefetchLowWaterPercent = config_.prefetchLowWaterPercent;
+    options.prefetchHighWaterPercent = config_.prefetchHighWaterPercent;
+    options.clipCache = &clipCache_;
+    return options;
+}
+
+AudioSinkConfig PlayerEngine::makeSinkConfig(const Track& track) const {
+    // Unspecified rate lets the device pick its native one, keeping the fast path available
+    AudioSinkConfig config;
+    config.sampleRate = config_.resampleToDeviceRate ? 0 : track.getSampleRate();
+    config.channelCount = config_.outputChannelCount;
+    if (config_.outputChannelCount == PlayerConfig::kChannelsOfFile) {
+        config.channelCount = track.getChannelCount();
+    } else if (config_.outputChannelCount == PlayerConfig::kChannelsOfDevice) {
+        config.channelCount = 0; // Unspecified, the device picks
+    }
+    config.format = FormatConverter::getPreferredDeviceFormat(track.getSampleFormat());
+    config.usage = config_.usage;
+    config.contentType = config_.contentType;
+    config.performanceMode = config_.performanceMode;
+    config.sharingMode = config_.sharingMode;
+    return config;
+}
+
+// Called with sinkMutex_ held
+bool PlayerEngine::openSink() {
+    streamGeneration_++;
+    sink_ = sinkFactory_ ? sinkFactory_() : nullptr;
+    if (!sink_) {
+        LOGE("No audio sink available");
+        return false;
+    }
+
+    const Track& track = *queue_.current();
+    if (!sink_->open(makeSinkConfig(track), dataCallback, errorCallback, this)) {
+        sink_.reset();
+        return false;
+    }
+
+    // Converter follows what the device actually granted, not what was requested
+    channelCount_ = sink_->getChannelCount();
+    fileChannelCount_ = track.getChannelCount();
+    bytesPerFrame_ = channelCount_ * getBytesPerSample(sink_->getFormat());
+    fileBytesPerFrame_ = track.getBytesPerFrame();
+    if (!converter_.configure(track.getSampleFormat(), sink_->getFormat(),
+                              kConvertChunkFrames * fileChannelCount_, config_.dither)) {
+        LOGE("Stream granted %dch format %d, cannot play %s", channelCount_, static_cast<int32_t>(sink_->getFormat()),
+             track.getFormatInfo().c_str());
+        sink_->close();
+        sink_.reset();
+        return false;
+    }
+
+    convertBufferFrames_ = kConvertChunkFrames;
+    convertBuffer_.reset(new uint8_t[static_cast<size_t>(convertBufferFrames_) * fileBytesPerFrame_]);
+
+    // Layers are mixed in float, saturated when converting back to the stream format
+    int32_t mixSamples = kConvertChunkFrames * channelCount_;
+    int32_t fileSamples = kConvertChunkFrames * fileChannelCount_;
+    if (!toFloat_.configure(track.getSampleFormat(), SampleFormat::Float, fileSamples, false) ||
+        !fromFloat_.configure(SampleFormat::Float, sink_->getFormat(), mixSamples, config_.dither) ||
+        !mixer_.prepare(channelCount_, sink_->getSampleRate(), kConvertChunkFrames)) {
+        sink_->close();
+        sink_.reset();
+        return false;
+    }
+    mixBuffer_.reset(new float[mixSamples]);
+
+    resampling_ = sink_->getSampleRate() != track.getSampleRate();
+    if (resampling_ && !resampler_.prepare(track.getSampleRate(), sink_->getSampleRate(), fileChannelCount_,
+                                           config_.resamplerQuality)) {
+        sink_->close();
+        sink_.reset();
+        return false;
+    }
+
+    // A user matrix is applied even when the channel counts match (swap, balance, ...)
+    bool matrixReady = config_.channelMatrix.empty()
+                           ? channelMatrix_.configure(fileChannelCount_, channelCount_)
+                           : channelMatrix_.configure(fileChannelCount_, channelCount_, config_.channelMatrix);
+    if (!matrixReady) {
+        sink_->close();
+        sink_.reset();
+        return false;
+    }
+    remixing_ = !channelMatrix_.isIdentity();
+    remixBuffer_.reset(remixing_ ? new float[fileSamples] : nullptr);
+
+    if (!dspChain_.prepare(config_.dsp, sink_->getFormat(), channelCount_, sink_->getSampleRate(),
+                           kConvertChunkFrames)) {
+        sink_->close();
+        sink_.reset();
+        return false;
+    }
+
+    // Measurement aid only, playback goes on without it
+    latencyMarker_.prepare(config_.latencyMarker, sink_->getSampleRate(), channelCount_, sink_->getFormat());
+    levelMeter_.prepare(config_.levelMeter, sink_->getFormat(), channelCount_, sink_->getSampleRate());
+
+    // A seek still posted applies to the track of this stream
+    seekFadeFrames_ = std::max(sink_->getSampleRate() * kSeekFadeMs / 1000, 1);
+    seekState_ = SeekState::Idle;
+
+    // A decoded file keeps enough ahead for the bursts this stream pulls
+    queue_.setConsumerBurst(sink_->getFramesPerBurst(), sink_->getSampleRate());
+
+    callbackStats_.reset(sink_->getSampleRate(), sink_->getXRunCount());
+    return true;
+}
+
+// Queue worker thread: the next file needs another stream, reopen it for that file
+void PlayerEngine::swapStream() {
+    // Control threads see either the old stream or the new one, never one being torn down
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    stopStreamMonitors();
+    // The old stream stopped itself from the callback
+    if (sink_) {
+        sink_->stop();
+        sink_->close();
+        sink_.reset();
+    }
+
+    Track* track = queue_.promoteNext();
+    if (!track) {
+        // Queue was cleared in the meantime
+        isPlaying_.store(false);
+        notifyPlaybackStopped();
+        return;
+    }
+    if (!isPlaying_.load()) {
+        return;
+    }
+
+    // Layers are dropped with the old stream, they were mixed at its format
+    streamFrame_ = 0;
+    gapStartFrame_ = -1;
+    endFrame_.store(-1);
+    if (!openSink()) {
+        isPlaying_.store(false);
+        notifyPlaybackError("[STREAM] Failed to create playback stream");
+        return;
+    }
+    startStreamMonitors();
+    if (!sink_->start()) {
+        isPlaying_.store(false);
+        notifyPlaybackError("[STREAM] Failed to start playback stream");
+        return;
+    }
+    LOGI("Stream swapped for #%d %s", track->index, track->getFormatInfo().c_str());
+}
+
+// Monitors start before the stream, so no stream swap can race with them
+void PlayerEngine::startStreamMonitors() {
+    bufferTuner_.setOptions(config_.bufferTuning);
+    bufferTuner_.start(sink_.get());
+    latencyEstimator_.setOptions(config_.latencyEstimation);
+    latencyEstimator_.start(sink_.get());
+}
+
+void PlayerEngine::stopStreamMonitors() {
+    bufferTuner_.stop();
+    latencyEstimator_.stop();
+}
+
+void PlayerEngine::releasePlayback() {
+    // No stream swap may run while the stream is torn down; the swap takes sinkMutex_ too, so stop its
+    // worker before taking the lock
+    queue_.stop();
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    stopStreamMonitors();
+
+    if (sink_) {
+        sink_->stop();
+        sink_->close();
+        sink_.reset();
+    }
+
+    // The callback is no longer running, layers and tracks can be destroyed directly
+    mixer_.clear();
+    queue_.release();
+    latencyMarker_.release();
+    levelMeter_.reset();
+}
+
+AudioSink::CallbackResult PlayerEngine::dataCallback(void* userData, void* audioData, int32_t numFrames) {
+    return static_cast<PlayerEngine*>(userData)->onAudioData(audioData, numFrames);
+}
+
+void PlayerEngine::errorCallback(void* userData, int32_t error) {
+    static_cast<PlayerEngine*>(userData)->onSinkError(error);
+}
+
+// Audio callback
+AudioSink::CallbackResult PlayerEngine::onAudioData(void* audioData, int32_t numFrames) {
+    CallbackTimer timer(callbackStats_, *sink_, numFrames);
+    queue_.onCallback(timer.getBeginNs(), sink_->getSampleRate());
+    if (firstFramePending_.load(std::memory_order_relaxed) && firstFramePending_.exchange(false)) {
+        uint64_t startLatencyNs = timer.getBeginNs() - startNs_;
+        clipCache_.recordFirstFrame(startPath_, startLatencyNs);
+        (startedWarm_ ? startLatencyWarmNs_ : startLatencyColdNs_).record(startLatencyNs);
+    }
+
+    if (!isPlaying_.load()) {
+        // Stopping: silence rather than whatever the buffer held, in case the device still plays it
+        memset(audioData, 0, static_cast<size_t>(numFrames) * bytesPerFrame_);
+        return AudioSink::CallbackResult::Stop;
+    }
+
+    if (!queue_.current()) {
+        isPlaying_.store(false);
+        notifyPlaybackError("[FILE] Audio file not opened");
+        return AudioSink::CallbackResult::Stop;
+    }
+
+    if (seekRequestFrame_.load(std::memory_order_relaxed) >= 0) {
+        beginSeek(seekRequestFrame_.exchange(-1, std::memory_order_acquire));
+    }
+
+    // Only a memcpy out of the prefetch ring or cached clip, the file is read on the reader thread
+    int32_t framesRead;
+    if (resampling_ || remixing_ || mixer_.getActiveCount() > 0 || seekState_ != SeekState::Idle) {
+        framesRead = renderFloat(audioData, numFrames);
+    } else if (converter_.isPassthrough()) {
+        size_t bytesToRead = static_cast<size_t>(numFrames) * fileBytesPerFrame_;
+        framesRead = static_cast<int32_t>(readTrack(audioData, bytesToRead) / fileBytesPerFrame_);
+    } else {
+        framesRead = readConverted(audioData, numFrames);
+    }
+
+    if (framesRead < numFrames && queue_.current()->isEndOfStream()) {
+        if (queue_.isSwapNeeded()) {
+            // Next file needs another stream format, the queue worker reopens the stream
+            queue_.requestSwap(timer.getBeginNs());
+            return AudioSink::CallbackResult::Stop;
+        }
+        // While the next file is still opening the stream keeps running on silence
+        if (queue_.getUpcomingCount() == 0) {
+            // Playback completed, the last frames of the file still get the output processing
+            dspChain_.process(audioData, numFrames);
+            endFrame_.store(streamFrame_ + framesRead, std::memory_order_release);
+            isPlaying_.store(false);
+            notifyPlaybackStopped();
+            return AudioSink::CallbackResult::Stop;
+        }
+        if (gapStartFrame_ < 0) {
+            gapStartFrame_ = streamFrame_ + framesRead;
+        }
+        if (resampling_ && queue_.isNextReady()) {
+            // Queued after the resampler had already flushed the old file, restart it on the new one
+            resampler_.reset();
+        }
+    }
+    streamFrame_ += numFrames;
+
+    // A seek posted meanwhile has already reported its target
+    if (seekRequestFrame_.load(std::memory_order_relaxed) < 0) {
+        position_.store(seekState_ == SeekState::FadeOut ? seekTargetFrame_ : queue_.current()->getPosition(),
+                        std::memory_order_relaxed);
+    }
+
+    dspChain_.process(audioData, numFrames);
+
+    // Replaces program audio from the marker edge on, after everything else was rendered
+    latencyMarker_.process(audioData, numFrames);
+    levelMeter_.process(audioData, numFrames);
+
+    return AudioSink::CallbackResult::Continue;
+}
+
+// Read file frames and convert them into the stream format, returns frames read
+int32_t PlayerEngine::readConverted(void* audioData, int32_t numFrames) {
+    auto output = static_cast<uint8_t*>(audioData);
+    int32_t framesDone = 0;
+
+    while (framesDone < numFrames) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, convertBufferFrames_);
+        size_t chunkBytes = static_cast<size_t>(chunkFrames) * fileBytesPerFrame_;
+        size_t bytesRead = readTrack(convertBuffer_.get(), chunkBytes);
+        int32_t framesRead = static_cast<int32_t>(bytesRead / fileBytesPerFrame_);
+
+        converter_.convert(convertBuffer_.get(), output + static_cast<size_t>(framesDone) * bytesPerFrame_,
+                           framesRead * fileChannelCount_);
+        framesDone += framesRead;
+
+        if (bytesRead < chunkBytes) {
+            break;
+        }
+    }
+
+    // Zero is silence in every stream format (unlike u8 file data)
+    if (framesDone < numFrames) {
+        memset(output + static_cast<size_t>(framesDone) * bytesPerFrame_, 0,
+               static_cast<size_t>(numFrames - framesDone) * bytesPerFrame_);
+    }
+    return framesDone;
+}
+
+// Read file frames as float, returns frames read
+int32_t PlayerEngine::readFloat(float* buffer, int32_t numFrames) {
+    int32_t framesDone = 0;
+    while (framesDone < numFrames) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, convertBufferFrames_);
+        size_t chunkBytes = static_cast<size_t>(chunkFrames) * fileBytesPerFrame_;
+        size_t bytesRead = readTrack(convertBuffer_.get(), chunkBytes);
+        auto framesRead = static_cast<int32_t>(bytesRead / fileBytesPerFrame_);
+
+        toFloat_.convert(convertBuffer_.get(), buffer + static_cast<size_t>(framesDone) * fileChannelCount_,
+                         framesRead * fileChannelCount_);
+        framesDone += framesRead;
+
+        if (bytesRead < chunkBytes) {
+            break;
+        }
+    }
+    return framesDone;
+}
+
+// Read file bytes of the current track, continuing with the next one at the exact frame it ends
+size_t PlayerEngine::readTrack(void* buffer, size_t size) {
+    auto output = static_cast<uint8_t*>(buffer);
+    Track* track = queue_.current();
+    size_t bytesRead = track->read(output, size);
+
+    // A prepared next track has the same format, so frames line up byte for byte
+    while (bytesRead < size && track->isEndOfStream()) {
+        int64_t gapFrames = gapStartFrame_ < 0 ? 0 : streamFrame_ - gapStartFrame_;
+        track = queue_.advance(gapFrames);
+        if (!track) {
+            // Gap measured to callback granularity, from the callback that ran out
+            if (gapStartFrame_ < 0 && queue_.getUpcomingCount() > 0 && !queue_.isSwapNeeded()) {
+                gapStartFrame_ = streamFrame_;
+            }
+            break;
+        }
+        gapStartFrame_ = -1;
+        bytesRead += track->read(output + bytesRead, size - bytesRead);
+    }
+    return bytesRead;
+}
+
+// Main file (resampled and remixed if needed) plus all layers, converted to the stream format
+int32_t PlayerEngine::renderFloat(void* audioData, int32_t numFrames) {
+    auto output = static_cast<uint8_t*>(audioData);
+    int32_t mainFrames = 0;
+
+    // Keep going after the main file runs short so layers are not cut mid-buffer
+    for (int32_t framesDone = 0; framesDone < numFrames;) {
+        int32_t chunkFrames = std::min(numFrames - framesDone, kConvertChunkFrames);
+        if (seekState_ == SeekState::FadeOut) {
+            // The fade out ends on a chunk boundary, the next chunk starts at the new position
+            chunkFrames = std::min(chunkFrames, seekFadeRemaining_);
+        }
+        float* mix = mixBuffer_.get();
+        float* main = remixing_ ? remixBuffer_.get() : mix;
+
+        int32_t framesRead = readMain(main, chunkFrames);
+        if (framesRead < chunkFrames) {
+            memset(main + static_cast<size_t>(framesRead) * fileChannelCount_, 0,
+                   static_cast<size_t>(chunkFrames - framesRead) * fileChannelCount_ * sizeof(float));
+        }
+        if (remixing_) {
+            channelMatrix_.process(main, mix, chunkFrames);
+        }
+
+        mixer_.render(mix, chunkFrames, true);
+        fromFloat_.convert(mix, output + static_cast<size_t>(framesDone) * bytesPerFrame_, chunkFrames * channelCount_);
+
+        mainFrames += framesRead;
+        framesDone += chunkFrames;
+    }
+    return mainFrames;
+}
+
+// Main file at the stream rate, faded out and back in around a seek, returns frames read
+int32_t PlayerEngine::readMain(float* buffer, int32_t numFrames) {
+    int32_t framesRead =
+        resampling_ ? resampler_.process(buffer, numFrames, mainSource_) : readFloat(buffer, numFrames);
+    if (seekState_ == SeekState::Idle) {
+        return framesRead;
+    }
+
+    if (seekState_ == SeekState::Refill) {
+        if (framesRead == 0) {
+            return 0;
+        }
+        // First audio of the new position
+        seekLatencyNs_.record(CallbackStats::nowNs() - seekStartNs_);
+        seekState_ = SeekState::FadeIn;
+        seekFadeRemaining_ = seekFadeFrames_;
+    }
+
+    // Linear ramps ending at silence (out) or one frame short of unity (in)
+    const bool fadingOut = seekState_ == SeekState::FadeOut;
+    const float step = 1.0f / static_cast<float>(seekFadeFrames_);
+    int32_t fadeFrames = std::min(framesRead, seekFadeRemaining_);
+    for (int32_t i = 0; i < fadeFrames; i++) {
+        int32_t remaining = seekFadeRemaining_ - i;
+        float gain = static_cast<float>(fadingOut ? remaining - 1 : seekFadeFrames_ - remaining) * step;
+        float* frame = buffer + static_cast<size_t>(i) * fileChannelCount_;
+        for (int32_t channel = 0; channel < fileChannelCount_; channel++) {
+            frame[channel] *= gain;
+        }
+    }
+
+    if (fadingOut) {
+        // Frames missing at the end of the file count as faded
+        seekFadeRemaining_ -= numFrames;
+        if (seekFadeRemaining_ <= 0) {
+            seekTrack();
+        }
+    } else {
+        seekFadeRemaining_ -= fadeFrames;
+        if (seekFadeRemaining_ == 0) {
+            seekState_ = SeekState::Idle;
+        }
+    }
+    return framesRead;
+}
+
+// Audio thread: take over a posted seek, retargeting one in progress
+void PlayerEngine::beginSeek(int64_t frame) {
+    seekTargetFrame_ = frame;
+    seekStartNs_ = seekRequestNs_.load(std::memory_order_relaxed);
+    switch (seekState_) {
+    case SeekState::Idle:
+        seekState_ = SeekState::FadeOut;
+        seekFadeRemaining_ = seekFadeFrames_;
+        break;
+    case SeekState::FadeIn:
+        // Fade out from the gain reached so far
+        seekState_ = SeekState::FadeOut;
+        seekFadeRemaining_ = std::max(seekFadeFrames_ - seekFadeRemaining_, 1);
+        break;
+    case SeekState::Refill:
+        // Already silent
+        seekTrack();
+        break;
+    default:
+        // Fading out, the new target is taken once silent
+        break;
+    }
+}
+
+// Move the current track to the seek target and wait for its first frames
+void PlayerEngine::seekTrack() {
+    queue_.current()->seek(seekTargetFrame_);
+    if (resampling_) {
+        // Drop input of the old position still buffered in the filter
+        resampler_.reset();
+    }
+    seekState_ = SeekState::Refill;
+}
+
+int32_t PlayerEngine::MainSource::getSampleRate() const {
+    Track* track = engine_.queue_.current();
+    return track ? track->getSampleRate() : 0;
+}
+
+bool PlayerEngine::MainSource::isFinished() const {
+    // While the next file is still opening this is an underflow, not the end, so the
+    // resampler keeps its state for a seamless continuation
+    const TrackQueue& queue = engine_.queue_;
+    Track* track = queue.current();
+    return track && track->isEndOfStream() && (queue.getUpcomingCount() == 0 || queue.isSwapNeeded());
+}
+
+int32_t PlayerEngine::addLayer(const std::string& path, float gain) {
+    // The layer is built for the stream playing now, without holding up a stream swap while the file opens
+    uint32_t generation;
+    int32_t sampleRate;
+    int32_t channelCount;
+    {
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        if (!isPlaying_.load() || !sink_) {
+            LOGE("Cannot add layer, not playing");
+            return -1;
+        }
+        generation = streamGeneration_;
+        sampleRate = sink_->getSampleRate();
+        channelCount = sink_->getChannelCount();
+    }
+
+    std::unique_ptr<AudioSource> source;
+    std::shared_ptr<const ClipCache::Clip> clip = clipCache_.acquire(path);
+    if (clip) {
+        auto cached = std::make_unique<ClipSource>(std::move(clip));
+        if (!cached->isValid()) {
+            return -1;
+        }
+        source = std::move(cached);
+    } else {
+        auto file = std::make_unique<FileSource>();
+        if (!file->open(path, config_.ioMode, config_.prefetchDepthMs)) {
+            return -1;
+        }
+        source = std::move(file);
+    }
+
+    if (source->getSampleRate() != sampleRate) {
+        auto resampled = std::make_unique<ResampledSource>(std::move(source), sampleRate, config_.resamplerQuality);
+        if (!resampled->isValid()) {
+            return -1;
+        }
+        source = std::move(resampled);
+    }
+    if (source->getChannelCount() != channelCount) {
+        auto remixed = std::make_unique<RemixedSource>(std::move(source), channelCount, kConvertChunkFrames);
+        if (!remixed->isValid()) {
+            return -1;
+        }
+        source = std::move(remixed);
+    }
+
+    std::lock_guard<std::mutex> lock(sinkMutex_);
+    if (!sink_ || streamGeneration_ != generation) {
+        LOGE("Cannot add layer %s, the stream changed while it opened", path.c_str());
+        return -1;
+    }
+    mixer_.collectGarbage();
+    int32_t id = mixer_.addSource(std::move(source), gain);
+    if (id >= 0) {
+        LOGI("Layer %d added: %s, gain=%.2f", id, path.c_str(), gain);
+    }
+    return id;
+}
+
+bool PlayerEngine::removeLayer(int32_t id) {
+    bool removed = mixer_.removeSource(id);
+    mixer_.collectGarbage();
+    return removed;
+}
+
+bool PlayerEngine::setLayerGain(int32_t id, float gain) { return mixer_.setGain(id, gain); }
+
+// Error callback
+void PlayerEngine::onSinkError(int32_t error) {
+    const char* errorText = sink_ ? sink_->convertErrorToText(error) : "unknown";
+    LOGE("%s error: %s", sink_ ? sink_->getName() : "Stream", errorText);
+    isPlaying_.store(false);
+    notifyPlaybackError("[STREAM] Playback stream error: ", errorText);
+}
+
+// Producers only post, the listener runs on the dispatcher thread
+void PlayerEngine::notifyPlaybackStarted() { events_.post({PlayerEvent::Type::Started}); }
+
+void PlayerEngine::notifyPlaybackStopped() { events_.post({PlayerEvent::Type::Stopped}); }
+
+void PlayerEngine::notifyPlaybackError(const char* message, const char* detail) {
+    events_.post({PlayerEvent::Type::Error, message, detail});
+}
+
+void PlayerEngine::dispatchEvents(const PlayerEvent* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const PlayerEvent& event = events[i];
+        switch (event.type) {
+        case PlayerEvent::Type::Started:
+            listener_->onPlaybackStarted();
+            break;
+        case PlayerEvent::Type::Stopped:
+            listener_->onPlaybackStopped();
+            break;
+        case PlayerEvent::Type::Error: {
+            std::string error = event.message ? event.message : "";
+            if (event.detail) {
+                error += event.detail;
+            }
+            listener_->onPlaybackError(error);
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,455 @@
+#ifndef PLAYER_ENGINE_H
+#define PLAYER_ENGINE_H
+
+#include "audio_file.h"
+#include "audio_sink.h"
+#include "buffer_tuner.h"
+#include "callback_stats.h"
+#include "channel_matrix.h"
+#include "clip_cache.h"
+#include "dsp_chain.h"
+#include "event_dispatcher.h"
+#include "format_converter.h"
+#include "latency_estimator.h"
+#include "latency_marker.h"
+#include "level_meter.h"
+#include "mixer.h"
+#include "resampler.h"
+#include "prefetch_reader.h"
+#include "track_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Player configuration
+ * Stream attributes carry raw aaudio_* values as passed over JNI.
+ */
+struct PlayerConfig {
+    int32_t usage = 1;            // AAUDIO_USAGE_MEDIA
+    int32_t contentType = 2;      // AAUDIO_CONTENT_TYPE_MUSIC
+    int32_t performanceMode = 12; // AAUDIO_PERFORMANCE_MODE_LOW_LATENCY
+    int32_t sharingMode = 1;      // AAUDIO_SHARING_MODE_SHARED
+    std::string audioFilePath = "/data/48k_2ch_16bit.wav";
+
+    // Prefetch ring configuration
+    int32_t prefetchDepthMs = 500;
+    int32_t prefetchLowWaterPercent = 50;
+    int32_t prefetchHighWaterPercent = 90;
+    AudioFile::IoMode ioMode = AudioFile::IoMode::MemoryMap;
+
+    // TPDF dither when the device only takes 16-bit and the source has more resolution
+    bool dither = true;
+
+    // Open the stream at the device's native rate and resample in-process
+    bool resampleToDeviceRate = false;
+    Resampler::Quality resamplerQuality = Resampler::Quality::Medium;
+
+    // Grow the stream buffer on underruns, shrink it back once stable
+    BufferTuner::Options bufferTuning;
+
+    // Output latency and clock drift from stream timestamps
+    LatencyEstimator::Options latencyEstimation;
+
+    // Markers in the output for measuring latency with a scope (GPIO) or a recording
+    LatencyMarker::Options latencyMarker;
+
+    // Per-channel peak/RMS/clip levels of the output, published for the UI
+    LevelMeter::Options levelMeter;
+
+    // Stream channel count, the file is remixed when it differs
+    static constexpr int32_t kChannelsOfFile = 0;    // Same as the file (framework remixes if needed)
+    static constexpr int32_t kChannelsOfDevice = -1; // Device's native count
+    int32_t outputChannelCount = kChannelsOfFile;
+
+    // Remix gains, output channels x file channels row-major; empty uses the preset downmix
+    std::vector<float> channelMatrix;
+
+    // Output gain, EQ and the fades around start and stop
+    DspChain::Options dsp;
+};
+
+/**
+ * Playback pipeline:
+ * WAV / FLAC file -> prefetch reader / clip cache -> [resampler] -> [channel matrix] -> [mixer] -> [DSP chain]
+ * -> audio sink
+ *
+ * Files queued behind the playing one are opened ahead of time and continue
+ * it on the same stream at the exact frame it ends; a file with another
+ * format gets a new stream instead.
+ *
+ * Short files are decoded once into the clip cache and played from memory
+ * afterwards, see ClipCache.
+ *
+ * Extra layers (alarm, notification, ...) can be mixed on top of the main
+ * file while it plays, sharing its output stream. When the stream runs at
+ * the device's native rate or channel count, the file is resampled and
+ * remixed in the callback. Without layers, resampling or remixing the main
+ * file is copied straight into the stream buffer.
+ *
+ * Independent of AAudio and JNI. The output device is created through a
+ * factory, so the same engine runs on a device (AAudioSink) or on a host
+ * against a simulated device (SimulatedSink).
+ */
+class PlayerEngine {
+public:
+    /**
+     * Playback event receiver, called on the engine's event dispatcher thread
+     */
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+        virtual void onPlaybackStarted() = 0;
+        virtual void onPlaybackStopped() = 0;
+        virtual void onPlaybackError(const std::string& error) = 0;
+    };
+
+    using SinkFactory = std::function<std::unique_ptr<AudioSink>()>;
+
+    /**
+     * Constructor
+     * @param sinkFactory Creates the output device for each playback
+     */
+    explicit PlayerEngine(SinkFactory sinkFactory);
+
+    /**
+     * Destructor, stops playback
+     */
+    ~PlayerEngine() noexcept;
+
+    // Disable copy and assignment
+    PlayerEngine(const PlayerEngine&) = delete;
+    PlayerEngine& operator=(const PlayerEngine&) = delete;
+
+    /**
+     * Set the event receiver and (re)start the dispatcher thread that calls it
+     * @param listener Receiver, nullptr stops delivery (pending events are delivered first)
+     * @param onThreadStart Run first on the dispatcher thread, e.g. to attach it to a VM
+     * @param onThreadStop Run last on the dispatcher thread
+     */
+    void setListener(Listener* listener,
+                     EventDispatcher::ThreadHook onThreadStart = nullptr,
+                     EventDispatcher::ThreadHook onThreadStop = nullptr);
+
+    /**
+     * Get event delivery counters and post-to-delivery latency
+     */
+    EventDispatcher::Stats getEventStats() const { return events_.getStats(); }
+
+    /**
+     * Set configuration, applied on the next start()
+     */
+    void setConfig(const PlayerConfig& config) { config_ = config; }
+    const PlayerConfig& getConfig() const { return config_; }
+
+    /**
+     * Open the file and the output stream and start playback
+     * @return Returns true on success
+     */
+    bool start();
+
+    /**
+     * Stop playback and release the stream and file
+     * Fades out first (blocking for the fade), see DspChain::Options::stopFadeMs.
+     */
+    void stop();
+
+    /**
+     * Open (and close again) a stream for the configured file without playing it
+     * With a pooling sink factory (SinkPool) the stream stays open, so the next
+     * start() only has to start it. Also loads the file into the clip cache.
+     * @return Returns false if playing or the file or stream cannot be opened
+     */
+    bool prewarm();
+
+    bool isPlaying() const { return isPlaying_.load(); }
+
+    /**
+     * Move the playing file to a frame, safe while the stream runs
+     * The audio thread fades out, continues from the frame and fades back in; a streamed
+     * file renders silence in between until its prefetch reader has refilled from there.
+     * @param frame Frame index in the file, at or past its end finishes the file
+     * @return Returns false if not playing
+     */
+    bool seek(int64_t frame);
+
+    /**
+     * Get the frame of the playing file reached by the audio thread
+     * A pending seek reports its target; frames still queued in the stream buffer are not subtracted.
+     */
+    int64_t getPosition() const { return position_.load(std::memory_order_relaxed); }
+
+    /**
+     * Get the frames of the current stream that carry audio, once the last file has ended
+     * The burst the file ended in is padded with silence after them.
+     * @return -1 while playing, or if playback stopped before the end
+     */
+    int64_t getEndFrame() const { return endFrame_.load(std::memory_order_acquire); }
+
+    /**
+     * Get the time from seek() to the first callback rendering audio of the new position
+     */
+    LogLinearHistogram::Summary getSeekLatency() const { return seekLatencyNs_.getSummary(); }
+
+    /**
+     * Change the output gain, ramped over one callback, safe while playing
+     * @param gain Linear gain, kept for the following playbacks
+     */
+    void setGain(float gain);
+    float getGain() const { return config_.dsp.gain; }
+
+    /**
+     * Parameters of the current output stream, all zero when stopped
+     */
+    struct StreamInfo {
+        int32_t sampleRate = 0;
+        int32_t channelCount = 0;
+        int32_t framesPerBurst = 0;
+        int32_t bufferSizeInFrames = 0;
+    };
+
+    /**
+     * Get the parameters of the current output stream, safe against a concurrent stream swap
+     */
+    StreamInfo getStreamInfo() const;
+
+    PrefetchReader::Stats getPrefetchStats() const;
+
+    /**
+     * Queue a WAV file to play after the current one (and those already queued)
+     * Only while playing; the queue is dropped by stop().
+     * @return Returns false if not playing
+     */
+    bool enqueue(const std::string& path);
+
+    /**
+     * Drop all queued files, the current one plays to its end
+     */
+    void clearQueue() { queue_.clearPending(); }
+
+    /**
+     * Get the number of files queued behind the current one
+     */
+    int32_t getQueuedCount() const { return queue_.getUpcomingCount(); }
+
+    /**
+     * Get the recent track transitions of this playback, oldest first
+     */
+    std::vector<TrackQueue::Transition> getTransitions() const { return queue_.getTransitions(); }
+
+    /**
+     * Mix another WAV file into the running stream
+     * Other rates are resampled, other channel counts remixed with the preset matrix.
+     * @param path WAV file path
+     * @param gain Linear gain
+     * @return Layer id, or -1 on failure
+     */
+    int32_t addLayer(const std::string& path, float gain);
+
+    /**
+     * Stop and remove a layer
+     * @return Returns false if the layer does not exist (anymore)
+     */
+    bool removeLayer(int32_t id);
+
+    /**
+     * Change the gain of a layer (ramped)
+     * @return Returns false if the layer does not exist (anymore)
+     */
+    bool setLayerGain(int32_t id, float gain);
+
+    /**
+     * Get the number of layers still playing
+     */
+    int32_t getLayerCount() const { return mixer_.getActiveCount(); }
+
+    /**
+     * Set the clip cache limits, takes effect immediately
+     * @param budgetBytes Total size of cached PCM, 0 disables the cache
+     * @param maxClipBytes Largest file kept in memory, larger ones are streamed
+     */
+    void setClipCacheLimits(size_t budgetBytes, size_t maxClipBytes) {
+        clipCache_.setLimits(budgetBytes, maxClipBytes);
+    }
+
+    /**
+     * Load a file into the clip cache ahead of its first playback (blocking)
+     * @return Returns false if the file is unreadable or too large to cache
+     */
+    bool preloadClip(const std::string& path) { return clipCache_.acquire(path) != nullptr; }
+
+    void clearClipCache() { clipCache_.clear(); }
+
+    /**
+     * Get clip cache counters and time-to-first-frame per path
+     */
+    ClipCache::Stats getClipCacheStats() const { return clipCache_.getStats(); }
+
+    /**
+     * Time from start() to the first callback, split by whether the stream was
+     * already open (reused from a pool) or had to be created
+     */
+    struct StartLatency {
+        LogLinearHistogram::Summary warmNs;
+        LogLinearHistogram::Summary coldNs;
+    };
+
+    StartLatency getStartLatency() const {
+        return {startLatencyWarmNs_.getSummary(), startLatencyColdNs_.getSummary()};
+    }
+
+    /**
+     * Get callback timing statistics of the current (or last) playback
+     * Safe to call while playing, the audio thread is never blocked.
+     */
+    CallbackStats::Snapshot getCallbackStats() const { return callbackStats_.getSnapshot(); }
+
+    /**
+     * Get the buffer size decisions of the current (or last) stream, oldest first
+     */
+    std::vector<BufferTuner::Decision> getBufferTuningTrace() const { return bufferTuner_.getTrace(); }
+
+    BufferTuner::Stats getBufferTuningStats() const { return bufferTuner_.getStats(); }
+
+    /**
+     * Get output latency and clock drift estimated since the last start()
+     */
+    LatencyEstimator::Stats getLatencyStats() const { return latencyEstimator_.getStats(); }
+
+    /**
+     * Get the latency markers placed in the current (or last) stream, oldest first
+     */
+    std::vector<MarkerEvent> getLatencyMarkers() const { return latencyMarker_.getRecords(); }
+
+    /**
+     * Get the shared region the output levels are published to, see LevelMeter
+     * Valid for the lifetime of the engine; reads zero levels while stopped or with metering off.
+     */
+    const LevelMeter::Region* getLevelMeterRegion() const { return levelMeter_.getRegion(); }
+
+    /**
+     * Copy the output levels of the last window, safe while playing
+     * @return Returns false if no consistent copy could be taken
+     */
+    bool readLevels(LevelMeter::Snapshot* snapshot) const { return levelMeter_.read(snapshot); }
+
+private:
+    static AudioSink::CallbackResult dataCallback(void* userData, void* audioData, int32_t numFrames);
+    static void errorCallback(void* userData, int32_t error);
+
+    // Main file as a float AudioSource, input of the resampler
+    class MainSource : public AudioSource {
+    public:
+        explicit MainSource(PlayerEngine& engine) : engine_(engine) {}
+        int32_t getSampleRate() const override;
+        int32_t getChannelCount() const override { return engine_.fileChannelCount_; }
+        int32_t read(float* buffer, int32_t numFrames) override { return engine_.readFloat(buffer, numFrames); }
+        bool isFinished() const override;
+
+    private:
+        PlayerEngine& engine_;
+    };
+
+    AudioSink::CallbackResult onAudioData(void* audioData, int32_t numFrames);
+    int32_t readConverted(void* audioData, int32_t numFrames);
+    int32_t readFloat(float* buffer, int32_t numFrames);
+    int32_t renderFloat(void* audioData, int32_t numFrames);
+    size_t readTrack(void* buffer, size_t size);
+    int32_t readMain(float* buffer, int32_t numFrames);
+    void beginSeek(int64_t frame);
+    void seekTrack();
+    void fadeOutForStop();
+    void onSinkError(int32_t error);
+    TrackQueue::Options makeTrackOptions();
+    AudioSinkConfig makeSinkConfig(const Track& track) const;
+    bool openSink();
+    void swapStream();
+    void startStreamMonitors();
+    void stopStreamMonitors();
+    void releasePlayback();
+
+    void notifyPlaybackStarted();
+    void notifyPlaybackStopped();
+    void notifyPlaybackError(const char* message, const char* detail = nullptr);
+    void dispatchEvents(const PlayerEvent* events, size_t count);
+
+    SinkFactory sinkFactory_;
+    Listener* listener_ = nullptr; // Only called from the dispatcher thread
+    EventDispatcher events_;
+    PlayerConfig config_;
+
+    // Control threads and the queue worker (stream swap) use or replace sink_ only while holding sinkMutex_;
+    // the audio and error callbacks run only while it is open and do not take it
+    mutable std::mutex sinkMutex_;
+    std::unique_ptr<AudioSink> sink_;
+    uint32_t streamGeneration_ = 0; // Counts opened streams, guarded by sinkMutex_
+    ClipCache clipCache_; // Outlives queue_, whose tracks it serves
+    TrackQueue queue_; // Playing file and the ones queued behind it
+    int64_t streamFrame_ = 0;    // Stream position at the start of the current callback, audio thread only
+    int64_t gapStartFrame_ = -1; // Where the current file ran out while the next was still opening
+    std::atomic<int64_t> endFrame_{-1};
+    std::atomic<bool> isPlaying_{false};
+    uint64_t startNs_ = 0; // When start() was called, for time-to-first-frame
+    ClipCache::Path startPath_ = ClipCache::Path::Stream;
+    std::atomic<bool> firstFramePending_{false};
+    bool startedWarm_ = false; // Stream of this start() was reused
+    LogLinearHistogram startLatencyWarmNs_;
+    LogLinearHistogram startLatencyColdNs_;
+    int32_t bytesPerFrame_ = 0; // Of the granted stream format
+    int32_t fileBytesPerFrame_ = 0;
+    int32_t channelCount_ = 0; // Of the granted stream
+    int32_t fileChannelCount_ = 0;
+
+    // File format -> granted stream format, chunked through convertBuffer_
+    FormatConverter converter_;
+    std::unique_ptr<uint8_t[]> convertBuffer_;
+    int32_t convertBufferFrames_ = 0;
+
+    // Layered playback: file -> float -> mix -> stream format
+    Mixer mixer_;
+    FormatConverter toFloat_;
+    FormatConverter fromFloat_;
+    std::unique_ptr<float[]> mixBuffer_;
+
+    // File rate -> stream rate, when they differ
+    Resampler resampler_;
+    MainSource mainSource_{*this};
+    bool resampling_ = false;
+
+    // File channels -> stream channels, when they differ or a user matrix is set
+    ChannelMatrix channelMatrix_;
+    std::unique_ptr<float[]> remixBuffer_; // Main file at its own channel count
+    bool remixing_ = false;
+    // Seek: posted by seek(), carried out by the audio thread as fade out, refill, fade in
+    enum class SeekState {
+        Idle,
+        FadeOut, // Old position fading, the track moves once it reached silence
+        Refill,  // Track moved, silence until its first frames arrive
+        FadeIn,
+    };
+    std::atomic<int64_t> seekRequestFrame_{-1};
+    std::atomic<uint64_t> seekRequestNs_{0};
+    std::atomic<int64_t> position_{0};
+    SeekState seekState_ = SeekState::Idle; // Audio thread only, like the members below
+    int64_t seekTargetFrame_ = 0;
+    uint64_t seekStartNs_ = 0;
+    int32_t seekFadeFrames_ = 0; // Fade length at the stream rate
+    int32_t seekFadeRemaining_ = 0;
+    LogLinearHistogram seekLatencyNs_;
+
+    // Gain, EQ and start/stop fades on the stream format, last stage before the marker
+    DspChain dspChain_;
+
+    CallbackStats callbackStats_;
+    LatencyMarker latencyMarker_;
+    LevelMeter levelMeter_; // Meters the final output, markers included
+    // Poll sink_ from their own threads, stopped before it is closed
+    BufferTuner bufferTuner_;
+    LatencyEstimator latencyEstimator_;
+};
+
+#endif // PLAYER_ENGINE_H
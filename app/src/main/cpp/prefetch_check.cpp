@@ -0,0 +1,331 @@
+// Host check of SpscRingBuffer and PrefetchReader: ring wraparound against a reference queue, a producer and
+// consumer thread streaming a sequence through a small ring, and whole-file reads and seeks through the reader
+// in both I/O modes. Exits non-zero on the first mismatch of each case.
+#include "prefetch_reader.h"
+#include "ring_buffer.h"
+#include "wave_file.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static int failures = 0;
+
+static bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("prefetch_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// xorshift64*, so every run streams the same sizes
+class Random {
+public:
+    explicit Random(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    size_t below(size_t limit) { return limit ? static_cast<size_t>(next() % limit) : 0; }
+
+private:
+    uint64_t state_;
+};
+
+// Byte at a stream position, not periodic in any power of two a ring could alias with
+static uint8_t patternByte(uint64_t position) {
+    return static_cast<uint8_t>((position * 2654435761ull) >> 13);
+}
+
+static void fillPattern(uint8_t* data, size_t size, uint64_t position) {
+    for (size_t i = 0; i < size; i++) {
+        data[i] = patternByte(position + i);
+    }
+}
+
+static bool matchesPattern(const uint8_t* data, size_t size, uint64_t position) {
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != patternByte(position + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Random writes, in-place writes, reads and discards on a tiny ring, mirrored by a deque
+static void checkWraparound() {
+    const char* name = "wraparound";
+    SpscRingBuffer ring(50);
+    if (!expect(ring.capacity() == 64, name, "capacity not rounded up to a power of two")) {
+        return;
+    }
+
+    Random random(1);
+    std::deque<uint8_t> expected;
+    uint64_t written = 0;
+    uint8_t buffer[128];
+    for (int32_t step = 0; step < 200000; step++) {
+        size_t size = random.below(ring.capacity() + 8);
+        switch (random.below(4)) {
+            case 0: {
+                fillPattern(buffer, size, written);
+                size_t count = ring.write(buffer, size);
+                if (!expect(count == std::min(size, ring.capacity() - expected.size()), name, "short write")) {
+                    return;
+                }
+                expected.insert(expected.end(), buffer, buffer + count);
+                written += count;
+                break;
+            }
+            case 1: {
+                uint8_t* first = nullptr;
+                uint8_t* second = nullptr;
+                size_t firstSize = 0;
+                size_t secondSize = 0;
+                size_t writable = ring.getWriteRegions(&first, &firstSize, &second, &secondSize);
+                if (!expect(writable == ring.capacity() - expected.size() && firstSize + secondSize == writable,
+                            name, "write regions do not cover the free space")) {
+                    return;
+                }
+                size_t count = std::min(size, writable);
+                size_t head = std::min(count, firstSize);
+                fillPattern(first, head, written);
+                fillPattern(second, count - head, written + head);
+                ring.commitWrite(count);
+                for (size_t i = 0; i < count; i++) {
+                    expected.push_back(patternByte(written + i));
+                }
+                written += count;
+                break;
+            }
+            case 2: {
+                size_t count = ring.read(buffer, size);
+                if (!expect(count == std::min(size, expected.size()), name, "short read")) {
+                    return;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    if (!expect(buffer[i] == expected.front(), name, "read data out of order")) {
+                        return;
+                    }
+                    expected.pop_front();
+                }
+                break;
+            }
+            default: {
+                // Flush up to a published position, then keep writing behind it
+                size_t position = ring.getWritePosition();
+                fillPattern(buffer, size, written);
+                size_t count = ring.write(buffer, size);
+                written += count;
+                size_t dropped = ring.discardUntil(position);
+                if (!expect(dropped == expected.size(), name, "discard dropped the wrong amount")) {
+                    return;
+                }
+                expected.clear();
+                for (size_t i = 0; i < count; i++) {
+                    expected.push_back(patternByte(written - count + i));
+                }
+                break;
+            }
+        }
+        if (!expect(ring.availableToRead() == expected.size() &&
+                    ring.availableToRead() + ring.availableToWrite() == ring.capacity(),
+                    name, "fill level out of step")) {
+            return;
+        }
+    }
+    printf("%s: ok (%llu bytes)\n", name, static_cast<unsigned long long>(written));
+}
+
+// A producer and a consumer thread stream a sequence through a ring smaller than their largest chunks
+static void checkConcurrent() {
+    const char* name = "spsc stress";
+    const uint64_t totalBytes = 16 * 1024 * 1024;
+    SpscRingBuffer ring(4096);
+
+    std::thread producer([&ring, totalBytes]() {
+        Random random(2);
+        uint8_t buffer[6000];
+        uint64_t written = 0;
+        while (written < totalBytes) {
+            size_t size = std::min<uint64_t>(1 + random.below(sizeof(buffer)), totalBytes - written);
+            if (random.below(2) == 0) {
+                fillPattern(buffer, size, written);
+                for (size_t offset = 0; offset < size;) {
+                    size_t count = ring.write(buffer + offset, size - offset);
+                    if (count == 0) {
+                        std::this_thread::yield();
+                    }
+                    offset += count;
+                }
+                written += size;
+            } else {
+                uint8_t* first = nullptr;
+                uint8_t* second = nullptr;
+                size_t firstSize = 0;
+                size_t secondSize = 0;
+                size_t count = std::min(size, ring.getWriteRegions(&first, &firstSize, &second, &secondSize));
+                if (count == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                size_t head = std::min(count, firstSize);
+                fillPattern(first, head, written);
+                fillPattern(second, count - head, written + head);
+                ring.commitWrite(count);
+                written += count;
+            }
+        }
+    });
+
+    Random random(3);
+    uint8_t buffer[5000];
+    uint64_t consumed = 0;
+    bool intact = true;
+    while (consumed < totalBytes) {
+        size_t count = ring.read(buffer, 1 + random.below(sizeof(buffer)));
+        if (count == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (intact && !matchesPattern(buffer, count, consumed)) {
+            intact = false;
+        }
+        consumed += count;
+    }
+    producer.join();
+
+    if (expect(intact, name, "consumer saw data out of order") &&
+        expect(ring.availableToRead() == 0, name, "ring not drained")) {
+        printf("%s: ok (%llu bytes)\n", name, static_cast<unsigned long long>(consumed));
+    }
+}
+
+static bool writeWave(const std::string& path, int32_t channels, uint32_t frames) {
+    const uint32_t bytesPerFrame = static_cast<uint32_t>(channels) * 2;
+    const uint32_t dataSize = frames * bytesPerFrame;
+    uint8_t header[44];
+    auto put16 = [&header](size_t offset, uint32_t value) {
+        header[offset] = static_cast<uint8_t>(value);
+        header[offset + 1] = static_cast<uint8_t>(value >> 8);
+    };
+    auto put32 = [&put16](size_t offset, uint32_t value) {
+        put16(offset, value & 0xffff);
+        put16(offset + 2, value >> 16);
+    };
+    memcpy(header, "RIFF", 4);
+    put32(4, 36 + dataSize);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(16, 16);
+    put16(20, 1);
+    put16(22, static_cast<uint32_t>(channels));
+    put32(24, 48000);
+    put32(28, 48000 * bytesPerFrame);
+    put16(32, bytesPerFrame);
+    put16(34, 16);
+    memcpy(header + 36, "data", 4);
+    put32(40, dataSize);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    std::vector<uint8_t> data(dataSize);
+    fillPattern(data.data(), data.size(), 0);
+    ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && ok;
+}
+
+// Consume until end of stream at a callback-sized burst, checking every byte served against its position
+static bool readToEnd(PrefetchReader& reader, size_t burstBytes, uint64_t dataSize, const char* name) {
+    std::vector<uint8_t> buffer(burstBytes);
+    uint64_t position = reader.getPosition();
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (!reader.isEndOfStream()) {
+        size_t count = reader.read(buffer.data(), buffer.size());
+        if (!expect(matchesPattern(buffer.data(), count, position), name, "served data does not match the file") ||
+            !expect(count == 0 || (position + count == dataSize || count % 4 == 0), name, "partial frame served") ||
+            !expect(std::chrono::steady_clock::now() < deadline, name, "reader stalled")) {
+            return false;
+        }
+        position += count;
+        if (count < buffer.size()) {
+            // Underflow or a pending seek: give the reader thread a moment, as the next callback would
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+    return expect(position == dataSize && reader.getPosition() == dataSize, name, "stream ended early");
+}
+
+static void checkReader(const std::string& path, AudioFile::IoMode ioMode, const char* name) {
+    WaveFile file;
+    if (!expect(file.open(path, ioMode), name, "cannot open the test file")) {
+        return;
+    }
+    const uint64_t dataSize = file.getDataSize();
+
+    // A ring much smaller than the file, so the reader wraps it many times
+    PrefetchReader::Config config;
+    config.capacityBytes = 16 * 1024;
+    config.lowWaterBytes = 8 * 1024;
+    config.highWaterBytes = 14 * 1024;
+    config.frameBytes = static_cast<size_t>(file.getBytesPerFrame());
+    config.chunkBytes = 3 * 1024;
+    config.pollIntervalMs = 1;
+
+    PrefetchReader reader;
+    if (!expect(reader.start(&file, config), name, "reader did not start") ||
+        !readToEnd(reader, 1924, dataSize, name)) {
+        return;
+    }
+
+    // Seeks restart the stream mid-file, including to an offset that is not frame aligned
+    Random random(4);
+    for (int32_t seek = 0; seek < 8; seek++) {
+        uint64_t offset = random.below(static_cast<size_t>(dataSize));
+        reader.seek(offset);
+        if (!expect(reader.getPosition() == offset - offset % config.frameBytes, name, "seek not frame aligned") ||
+            !readToEnd(reader, 1924, dataSize, name)) {
+            return;
+        }
+    }
+
+    PrefetchReader::Stats stats = reader.getStats();
+    reader.stop();
+    printf("%s: ok (%llu bytes prefetched, %llu refills, %llu underflows)\n", name,
+           static_cast<unsigned long long>(stats.bytesPrefetched), static_cast<unsigned long long>(stats.refillCount),
+           static_cast<unsigned long long>(stats.underflowCount));
+}
+
+int main() {
+    checkWraparound();
+    checkConcurrent();
+
+    const char* dir = getenv("TMPDIR");
+    std::string path = std::string(dir && *dir ? dir : "/tmp") + "/aaudioplayer-prefetch-check-" +
+                       std::to_string(getpid()) + ".wav";
+    // 1.5 s of 48kHz stereo 16-bit, about 18 times the ring
+    if (expect(writeWave(path, 2, 72000), "reader", "cannot write the test file")) {
+        checkReader(path, AudioFile::IoMode::Stream, "reader stream");
+        checkReader(path, AudioFile::IoMode::MemoryMap, "reader mmap");
+    }
+    unlink(path.c_str());
+
+    if (failures > 0) {
+        printf("prefetch_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,412 @@
+#include "prefetch_reader.h"
+#include "audio_file.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+
+// sem_clockwait: bionic from API 30, glibc from 2.30
+#if defined(__ANDROID__)
+#define PREFETCH_HAVE_SEM_CLOCKWAIT (__ANDROID_API__ >= 30)
+#elif defined(__GLIBC__) && defined(__USE_GNU)
+#define PREFETCH_HAVE_SEM_CLOCKWAIT __GLIBC_PREREQ(2, 30)
+#else
+#define PREFETCH_HAVE_SEM_CLOCKWAIT 0
+#endif
+
+namespace {
+
+timespec addNs(timespec time, int64_t ns) {
+    ns += time.tv_nsec;
+    time.tv_sec += static_cast<time_t>(ns / 1000000000);
+    time.tv_nsec = static_cast<long>(ns % 1000000000);
+    return time;
+}
+
+#if !PREFETCH_HAVE_SEM_CLOCKWAIT
+int64_t elapsedNs(const timespec& from, const timespec& to) {
+    return static_cast<int64_t>(to.tv_sec - from.tv_sec) * 1000000000 + (to.tv_nsec - from.tv_nsec);
+}
+#endif
+
+} // namespace
+
+PrefetchReader::Config PrefetchReader::makeConfig(int64_t bytesPerSecond,
+                                                  size_t frameBytes,
+                                                  int32_t depthMs,
+                                                  int32_t lowWaterPercent,
+                                                  int32_t highWaterPercent) {
+    Config config;
+    frameBytes = std::max<size_t>(frameBytes, 1);
+    depthMs = std::max(depthMs, 10);
+    lowWaterPercent = std::min(std::max(lowWaterPercent, 1), 99);
+    highWaterPercent = std::min(std::max(highWaterPercent, lowWaterPercent + 1), 100);
+
+    auto depthBytes = static_cast<size_t>(bytesPerSecond * depthMs / 1000);
+    depthBytes = std::max(depthBytes - depthBytes % frameBytes, frameBytes * 2);
+
+    config.capacityBytes = depthBytes;
+    config.lowWaterBytes = depthBytes * lowWaterPercent / 100;
+    config.highWaterBytes = depthBytes * highWaterPercent / 100;
+    config.frameBytes = frameBytes;
+    config.chunkBytes = std::max<size_t>(32 * 1024 - (32 * 1024) % frameBytes, frameBytes);
+
+    // Check a few times within the time it takes to drain down to half of the low-water mark
+    config.pollIntervalMs = std::max(1, depthMs * lowWaterPercent / 100 / 8);
+    return config;
+}
+
+PrefetchReader::PrefetchReader() { sem_init(&wakeup_, 0, 0); }
+
+PrefetchReader::~PrefetchReader() noexcept {
+    stop();
+    sem_destroy(&wakeup_);
+}
+
+bool PrefetchReader::start(AudioFile* source, const Config& config) {
+    stop();
+
+    if (!source || !source->isOpen()) {
+        LOGE("Prefetch source not opened");
+        return false;
+    }
+
+    source_ = source;
+    config_ = config;
+    config_.frameBytes = std::max<size_t>(config_.frameBytes, 1);
+    config_.capacityBytes = std::max(config_.capacityBytes, config_.frameBytes * 2);
+    size_t unit = source->getDecodeUnitBytes();
+    if (unit > 0) {
+        // A decoded source is read a block at a time, keep room for whole blocks however short the depth
+        config_.capacityBytes = std::max(config_.capacityBytes, 3 * unit);
+        config_.lowWaterBytes = std::max(config_.lowWaterBytes, unit);
+        config_.highWaterBytes = std::max(config_.highWaterBytes, 2 * unit);
+    }
+    config_.highWaterBytes = std::min(std::max(config_.highWaterBytes, config_.frameBytes), config_.capacityBytes);
+    config_.lowWaterBytes = std::min(config_.lowWaterBytes, config_.highWaterBytes);
+    config_.chunkBytes = std::max(config_.chunkBytes - config_.chunkBytes % config_.frameBytes, config_.frameBytes);
+
+    // A memory-mapped file is read in place: the reader only pages data in ahead of
+    // the consumer, and the consumer copies straight from the mapping
+    mapped_ = source->isMemoryMapped();
+    if (mapped_) {
+        ring_.reset();
+    } else {
+        ring_ = std::make_unique<SpscRingBuffer>(config_.capacityBytes);
+    }
+    lowWaterBytes_.store(config_.lowWaterBytes);
+    highWaterBytes_.store(config_.highWaterBytes);
+    consumedBytes_.store(source->getDataPosition());
+    prefetchedBytes_.store(source->getDataPosition());
+    seekOffset_.store(0);
+    seekRequested_.store(0);
+    seekServed_.store(0);
+    seekFlushPosition_.store(0);
+    seekApplied_ = 0;
+    sourceExhausted_.store(false);
+    endOfStream_.store(false);
+    lowWaterSinceNs_.store(0);
+    underflowCount_.store(0);
+    underflowBytes_.store(0);
+    refillCount_.store(0);
+    maxRefillLagNs_.store(0);
+    totalRefillLagNs_.store(0);
+    bytesPrefetched_.store(0);
+
+    // Prime synchronously so the first callback already has data
+    refill(config_.highWaterBytes);
+
+    running_.store(true);
+    thread_ = std::thread(&PrefetchReader::readerLoop, this);
+
+    LOGI("Prefetch started (%s): capacity=%zu, lowWater=%zu, highWater=%zu, poll=%dms", mapped_ ? "mmap" : "ring",
+         mapped_ ? config_.capacityBytes : ring_->capacity(), config_.lowWaterBytes, config_.highWaterBytes,
+         config_.pollIntervalMs);
+    return true;
+}
+
+void PrefetchReader::stop() {
+    running_.store(false);
+    if (thread_.joinable()) {
+        sem_post(&wakeup_);
+        thread_.join();
+    }
+    source_ = nullptr;
+}
+
+size_t PrefetchReader::read(void* buffer, size_t size) {
+    if (mapped_) {
+        return readMapped(buffer, size);
+    }
+
+    if (!ring_) {
+        memset(buffer, 0, size);
+        return 0;
+    }
+
+    uint32_t requested = seekRequested_.load(std::memory_order_relaxed);
+    if (requested != seekApplied_) {
+        // Silence until the reader has moved the file, then drop what it buffered before
+        if (seekServed_.load(std::memory_order_acquire) != requested) {
+            memset(buffer, 0, size);
+            return 0;
+        }
+        // The reader refilled behind the dropped data, its next poll tops the ring up
+        ring_->discardUntil(seekFlushPosition_.load(std::memory_order_relaxed));
+        seekApplied_ = requested;
+    }
+
+    // Check exhaustion before sampling the fill level, so data written just
+    // before the flag was raised is never mistaken for the end of the stream
+    bool exhausted = sourceExhausted_.load(std::memory_order_acquire);
+    size_t available = ring_->availableToRead();
+    size_t toRead = std::min(size, exhausted ? available : available - available % config_.frameBytes);
+    size_t bytesRead = ring_->read(buffer, toRead);
+
+    if (bytesRead < size) {
+        memset(static_cast<uint8_t*>(buffer) + bytesRead, 0, size - bytesRead);
+        if (exhausted) {
+            endOfStream_.store(true, std::memory_order_release);
+        } else {
+            underflowCount_.fetch_add(1, std::memory_order_relaxed);
+            underflowBytes_.fetch_add(size - bytesRead, std::memory_order_relaxed);
+        }
+    }
+
+    consumedBytes_.fetch_add(bytesRead, std::memory_order_relaxed);
+    markLowWater(available - bytesRead, exhausted);
+    return bytesRead;
+}
+
+size_t PrefetchReader::readMapped(void* buffer, size_t size) {
+    const void* data = nullptr;
+    size_t bytesRead = source_ ? source_->mapAudioData(&data, size) : 0;
+    if (bytesRead > 0) {
+        memcpy(buffer, data, bytesRead);
+    }
+
+    if (bytesRead < size) {
+        memset(static_cast<uint8_t*>(buffer) + bytesRead, 0, size - bytesRead);
+        endOfStream_.store(true, std::memory_order_release);
+    }
+
+    uint64_t consumed = consumedBytes_.fetch_add(bytesRead, std::memory_order_relaxed) + bytesRead;
+    uint64_t prefetched = prefetchedBytes_.load(std::memory_order_acquire);
+    bool exhausted = sourceExhausted_.load(std::memory_order_relaxed);
+    markLowWater(prefetched > consumed ? static_cast<size_t>(prefetched - consumed) : 0, exhausted);
+    return bytesRead;
+}
+
+void PrefetchReader::seek(uint64_t offset) {
+    if (!source_) {
+        return;
+    }
+    offset = std::min(offset - offset % config_.frameBytes, source_->getDataSize());
+
+    uint32_t requested = seekRequested_.load(std::memory_order_relaxed) + 1;
+    if (mapped_) {
+        // Only a position change, the reader just has to page in from there
+        source_->seekAudioData(offset);
+        seekApplied_ = requested;
+    }
+    seekOffset_.store(offset, std::memory_order_relaxed);
+    consumedBytes_.store(offset, std::memory_order_relaxed);
+    endOfStream_.store(false, std::memory_order_release);
+    seekRequested_.store(requested, std::memory_order_release);
+    sem_post(&wakeup_);
+}
+
+// Reader thread: move the file to the last requested offset, returns true if there was one
+bool PrefetchReader::serveSeek() {
+    uint32_t requested = seekRequested_.load(std::memory_order_acquire);
+    if (requested == seekServed_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    uint64_t offset = seekOffset_.load(std::memory_order_relaxed);
+    if (mapped_) {
+        prefetchedBytes_.store(offset, std::memory_order_relaxed);
+        sourceExhausted_.store(false, std::memory_order_relaxed);
+        seekServed_.store(requested, std::memory_order_release);
+        refill(highWaterBytes_.load(std::memory_order_relaxed));
+        return true;
+    }
+
+    // The consumer reads nothing until served, so everything in the ring now is stale
+    size_t stale = ring_->availableToRead();
+    source_->seekAudioData(offset);
+    sourceExhausted_.store(false, std::memory_order_relaxed);
+    seekFlushPosition_.store(ring_->getWritePosition(), std::memory_order_relaxed);
+    seekServed_.store(requested, std::memory_order_release);
+
+    // Refill behind the stale data, so the consumer finds the new data as soon as it drops it
+    refill(std::min(stale + highWaterBytes_.load(std::memory_order_relaxed), ring_->capacity()));
+    return true;
+}
+
+void PrefetchReader::setConsumerBurst(size_t burstBytes) {
+    size_t unit = source_ ? source_->getDecodeUnitBytes() : 0;
+    if (unit == 0 || !ring_) {
+        return;
+    }
+
+    size_t capacity = ring_->capacity();
+    size_t high = std::min(std::max(config_.highWaterBytes, kDecodeAheadBursts * burstBytes + 2 * unit), capacity);
+    size_t low = std::max(config_.lowWaterBytes, kDecodeAheadBursts * burstBytes + unit);
+    low = std::min(low, high > unit ? high - unit : 0);
+    lowWaterBytes_.store(low, std::memory_order_relaxed);
+    highWaterBytes_.store(high, std::memory_order_relaxed);
+    LOGI("Decode-ahead for %zu-byte reads: lowWater=%zu, highWater=%zu, unit=%zu", burstBytes, low, high, unit);
+}
+
+void PrefetchReader::markLowWater(size_t level, bool exhausted) {
+    // Timestamp the low-water crossing so the reader can measure its reaction time
+    if (!exhausted && level < lowWaterBytes_.load(std::memory_order_relaxed) &&
+        lowWaterSinceNs_.load(std::memory_order_relaxed) == 0) {
+        lowWaterSinceNs_.store(nowNs(), std::memory_order_relaxed);
+    }
+}
+
+size_t PrefetchReader::bufferedBytes() const {
+    if (mapped_) {
+        uint64_t consumed = consumedBytes_.load(std::memory_order_relaxed);
+        uint64_t prefetched = prefetchedBytes_.load(std::memory_order_relaxed);
+        return prefetched > consumed ? static_cast<size_t>(prefetched - consumed) : 0;
+    }
+    return ring_ ? ring_->availableToRead() : 0;
+}
+
+PrefetchReader::Stats PrefetchReader::getStats() const {
+    Stats stats;
+    stats.underflowCount = underflowCount_.load(std::memory_order_relaxed);
+    stats.underflowBytes = underflowBytes_.load(std::memory_order_relaxed);
+    stats.refillCount = refillCount_.load(std::memory_order_relaxed);
+    stats.maxRefillLagNs = maxRefillLagNs_.load(std::memory_order_relaxed);
+    stats.totalRefillLagNs = totalRefillLagNs_.load(std::memory_order_relaxed);
+    stats.bytesPrefetched = bytesPrefetched_.load(std::memory_order_relaxed);
+    stats.fillLevel = bufferedBytes();
+    stats.capacity = ring_ ? ring_->capacity() : config_.capacityBytes;
+    return stats;
+}
+
+void PrefetchReader::readerLoop() {
+    pthread_setname_np(pthread_self(), "aap-prefetch");
+
+    while (running_.load()) {
+        serveSeek();
+        size_t lowWater = lowWaterBytes_.load(std::memory_order_relaxed);
+        if (!sourceExhausted_.load(std::memory_order_relaxed) && bufferedBytes() < lowWater) {
+            uint64_t since = lowWaterSinceNs_.exchange(0, std::memory_order_relaxed);
+            if (since != 0) {
+                uint64_t lag = nowNs() - since;
+                totalRefillLagNs_.fetch_add(lag, std::memory_order_relaxed);
+                if (lag > maxRefillLagNs_.load(std::memory_order_relaxed)) {
+                    maxRefillLagNs_.store(lag, std::memory_order_relaxed);
+                }
+            }
+            refillCount_.fetch_add(1, std::memory_order_relaxed);
+            refill(highWaterBytes_.load(std::memory_order_relaxed));
+        }
+        waitForWork();
+    }
+}
+
+// Reader thread: sleep for a poll interval or until posted, timed on the monotonic clock so that setting the wall
+// clock neither stretches nor cuts the sleep
+void PrefetchReader::waitForWork() {
+    const int64_t intervalNs = static_cast<int64_t>(config_.pollIntervalMs) * 1000000;
+    timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#if PREFETCH_HAVE_SEM_CLOCKWAIT
+    timespec deadline = addNs(start, intervalNs);
+    while (sem_clockwait(&wakeup_, CLOCK_MONOTONIC, &deadline) != 0 && errno == EINTR) {
+    }
+#else
+    // sem_timedwait only takes a wall clock deadline: rebuild it from the monotonic time left before every wait
+    for (;;) {
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t remainingNs = intervalNs - elapsedNs(start, now);
+        if (remainingNs <= 0) {
+            break;
+        }
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline = addNs(deadline, remainingNs);
+        if (sem_timedwait(&wakeup_, &deadline) == 0 || errno != EINTR) {
+            break;
+        }
+    }
+#endif
+
+    // Posts of several seeks are served by one pass
+    while (sem_trywait(&wakeup_) == 0) {
+    }
+}
+
+size_t PrefetchReader::refill(size_t targetLevel) {
+    if (mapped_) {
+        return refillMapped(targetLevel);
+    }
+
+    size_t total = 0;
+
+    while (!sourceExhausted_.load(std::memory_order_relaxed)) {
+        size_t level = ring_->availableToRead();
+        if (level >= targetLevel) {
+            break;
+        }
+
+        // Read straight into the ring's free space, no intermediate copy
+        uint8_t* first;
+        size_t firstSize;
+        uint8_t* second;
+        size_t secondSize;
+        ring_->getWriteRegions(&first, &firstSize, &second, &secondSize);
+
+        size_t want = std::min(std::min(targetLevel - level, config_.chunkBytes), firstSize);
+        if (want == 0) {
+            break;
+        }
+
+        size_t bytesRead = source_->readAudioData(first, want);
+        ring_->commitWrite(bytesRead);
+        total += bytesRead;
+
+        if (bytesRead < want) {
+            sourceExhausted_.store(true, std::memory_order_release);
+        }
+    }
+
+    bytesPrefetched_.fetch_add(total, std::memory_order_relaxed);
+    return total;
+}
+
+size_t PrefetchReader::refillMapped(size_t targetLevel) {
+    uint64_t dataSize = source_->getDataSize();
+    uint64_t start = std::max(prefetchedBytes_.load(std::memory_order_relaxed),
+                              consumedBytes_.load(std::memory_order_relaxed));
+    uint64_t end = std::min(consumedBytes_.load(std::memory_order_relaxed) + targetLevel, dataSize);
+
+    size_t total = 0;
+    if (end > start) {
+        total = static_cast<size_t>(end - start);
+        source_->prefetchAudioData(start, total, true);
+        prefetchedBytes_.store(end, std::memory_order_release);
+        bytesPrefetched_.fetch_add(total, std::memory_order_relaxed);
+    }
+
+    if (end >= dataSize) {
+        sourceExhausted_.store(true, std::memory_order_release);
+    }
+    return total;
+}
+
+uint64_t PrefetchReader::nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
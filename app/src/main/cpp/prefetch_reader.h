@@ -0,0 +1,195 @@
+#ifndef PREFETCH_READER_H
+#define PREFETCH_READER_H
+
+#include "ring_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <semaphore.h>
+#include <thread>
+
+class AudioFile;
+
+/**
+ * Background file reader feeding a lock-free ring buffer
+ *
+ * A reader thread keeps the ring between the low-water and high-water marks,
+ * so the audio callback only ever does a memcpy out of memory and never
+ * touches the file system.
+ *
+ * For a memory-mapped WaveFile no ring is used: the reader keeps the pages
+ * ahead of the consumer resident and the consumer copies from the mapping.
+ *
+ * A decoded source (FlacFile) also runs its decoder on the reader thread;
+ * see setConsumerBurst() for how far it decodes ahead.
+ *
+ * The reader polls the fill level; the consumer wakes it early for a seek
+ * by posting a semaphore, which neither locks nor allocates.
+ */
+class PrefetchReader {
+public:
+    /**
+     * Ring depth and refill policy
+     * The reader sleeps while the fill level is at or above lowWaterBytes,
+     * and once woken refills up to highWaterBytes.
+     */
+    struct Config {
+        size_t capacityBytes = 256 * 1024;
+        size_t lowWaterBytes = 128 * 1024;
+        size_t highWaterBytes = 224 * 1024;
+        size_t frameBytes = 1;         // Reads are served in whole frames
+        size_t chunkBytes = 32 * 1024; // Largest single file read
+        int32_t pollIntervalMs = 5;    // How often the reader checks the fill level
+    };
+
+    /**
+     * Counters exposed for diagnostics
+     * Underflow counters are updated by the consumer, refill counters by the reader.
+     */
+    struct Stats {
+        uint64_t underflowCount = 0;   // Reads that could not be fully served before end of file
+        uint64_t underflowBytes = 0;   // Bytes replaced by silence because of underflows
+        uint64_t refillCount = 0;      // Refill cycles started below the low-water mark
+        uint64_t maxRefillLagNs = 0;   // Longest time from crossing low-water to refill start
+        uint64_t totalRefillLagNs = 0; // Sum of refill lags (divide by refillCount for average)
+        uint64_t bytesPrefetched = 0;  // Total bytes read from the file (or paged in when mapped)
+        size_t fillLevel = 0;          // Current ring fill level in bytes
+        size_t capacity = 0;           // Ring capacity in bytes
+    };
+
+    // Consumer reads kept decoded ahead on top of one decode unit, see setConsumerBurst()
+    static constexpr size_t kDecodeAheadBursts = 4;
+
+    /**
+     * Build a config from durations
+     * @param bytesPerSecond Byte rate of the source
+     * @param frameBytes Bytes per frame of the source
+     * @param depthMs Ring depth in milliseconds
+     * @param lowWaterPercent Refill trigger as a percentage of the depth
+     * @param highWaterPercent Refill target as a percentage of the depth
+     */
+    static Config makeConfig(int64_t bytesPerSecond,
+                             size_t frameBytes,
+                             int32_t depthMs,
+                             int32_t lowWaterPercent,
+                             int32_t highWaterPercent);
+
+    PrefetchReader();
+
+    /**
+     * Destructor, stops the reader thread
+     */
+    ~PrefetchReader() noexcept;
+
+    // Disable copy and assignment
+    PrefetchReader(const PrefetchReader&) = delete;
+    PrefetchReader& operator=(const PrefetchReader&) = delete;
+
+    /**
+     * Prime the ring up to the high-water mark and start the reader thread
+     * @param source Opened audio file, must outlive the reader
+     * @param config Ring depth and refill policy
+     * @return Returns true on success
+     */
+    bool start(AudioFile* source, const Config& config);
+
+    /**
+     * Stop the reader thread (blocking)
+     */
+    void stop();
+
+    /**
+     * Copy buffered data out of the ring (real-time safe, consumer only)
+     * Any part of the buffer that cannot be served is filled with zeros.
+     * @param buffer Destination buffer
+     * @param size Bytes requested
+     * @return Actual bytes copied from the ring
+     */
+    size_t read(void* buffer, size_t size);
+
+    /**
+     * Check whether the whole file has been consumed
+     * @return Returns true once the source hit end of file and the ring is empty
+     */
+    bool isEndOfStream() const { return endOfStream_.load(std::memory_order_acquire); }
+
+    /**
+     * Continue from another position of the data chunk (real-time safe, consumer only)
+     * A memory-mapped file continues right away. Otherwise the reader thread seeks the
+     * file and refills the ring behind the data buffered so far, which is dropped; until
+     * then read() serves silence and isSeekPending() is true.
+     * @param offset Byte offset within the data chunk, rounded down to a whole frame
+     */
+    void seek(uint64_t offset);
+
+    /**
+     * Check whether read() still waits for the reader to serve a seek (consumer only)
+     */
+    bool isSeekPending() const { return seekRequested_.load(std::memory_order_relaxed) != seekApplied_; }
+
+    /**
+     * Get the consumer position within the data chunk, in bytes
+     */
+    uint64_t getPosition() const { return consumedBytes_.load(std::memory_order_relaxed); }
+
+    /**
+     * Size the decode-ahead from the consumer's read size (any thread)
+     * Only applies to decoded sources: the low-water mark is raised to
+     * kDecodeAheadBursts reads plus one decode unit, and the high-water mark
+     * to one more unit, so a whole block is always decoded ahead of the
+     * callback. The configured marks stay the floor.
+     * @param burstBytes Bytes the consumer takes per read
+     */
+    void setConsumerBurst(size_t burstBytes);
+
+    Stats getStats() const;
+
+private:
+    void readerLoop();
+    void waitForWork();
+    size_t refill(size_t targetLevel);
+    size_t refillMapped(size_t targetLevel);
+    size_t readMapped(void* buffer, size_t size);
+    bool serveSeek();
+    void markLowWater(size_t level, bool exhausted);
+    size_t bufferedBytes() const;
+    static uint64_t nowNs();
+
+    std::unique_ptr<SpscRingBuffer> ring_;
+    AudioFile* source_ = nullptr;
+    Config config_;
+    bool mapped_ = false;
+
+    // Refill marks in use, the configured ones unless raised by setConsumerBurst()
+    std::atomic<size_t> lowWaterBytes_{0};
+    std::atomic<size_t> highWaterBytes_{0};
+
+    // Consumer position; memory-mapped mode also tracks how far ahead pages are resident
+    std::atomic<uint64_t> consumedBytes_{0};
+    std::atomic<uint64_t> prefetchedBytes_{0};
+
+    // Seek handshake: the consumer bumps seekRequested_, the reader moves the file and
+    // publishes seekServed_ along with the ring position where data of the new offset begins
+    std::atomic<uint64_t> seekOffset_{0};
+    std::atomic<uint32_t> seekRequested_{0};
+    std::atomic<uint32_t> seekServed_{0};
+    std::atomic<size_t> seekFlushPosition_{0};
+    uint32_t seekApplied_ = 0; // Consumer only
+
+    std::thread thread_;
+    sem_t wakeup_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<bool> sourceExhausted_{false};
+    std::atomic<bool> endOfStream_{false};
+    std::atomic<uint64_t> lowWaterSinceNs_{0};
+
+    std::atomic<uint64_t> underflowCount_{0};
+    std::atomic<uint64_t> underflowBytes_{0};
+    std::atomic<uint64_t> refillCount_{0};
+    std::atomic<uint64_t> maxRefillLagNs_{0};
+    std::atomic<uint64_t> totalRefillLagNs_{0};
+    std::atomic<uint64_t> bytesPrefetched_{0};
+};
+
+#endif // PREFETCH_READER_H
@@ -0,0 +1,437 @@
+// The interposers below replace the plain C library functions, not their fortified inline wrappers
+#undef _FORTIFY_SOURCE
+
+#include "realtime_checker.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <string>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// glibc entry points of the allocator, used instead of dlsym() which may itself allocate
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+// std::min takes kMaxRecords by reference
+constexpr int32_t RealtimeChecker::kMaxRecords;
+
+using Violation = RealtimeChecker::Violation;
+
+namespace {
+
+struct Record {
+    std::atomic<bool> ready{false};
+    Violation type = Violation::Allocation;
+    const char* function = nullptr;
+    int32_t depth = 0;
+    void* frames[RealtimeChecker::kMaxStackFrames] = {};
+    std::atomic<uint64_t> hits{0};
+};
+
+// Trivially constructible, so reading them from inside malloc never runs an initializer
+thread_local int32_t realtimeDepth = 0;
+thread_local bool inChecker = false; // Recording or resolving, nested calls pass through unchecked
+
+std::atomic<bool> enabled{false};
+std::atomic<bool> abortOnViolation{false};
+std::atomic<uint64_t> violationCounts[static_cast<int32_t>(Violation::Count)];
+Record records[RealtimeChecker::kMaxRecords];
+std::atomic<int32_t> recordCount{0};
+
+bool isSameRecord(const Record& record, Violation type, const char* function, void* const* frames, int32_t depth) {
+    return record.type == type && record.function == function && record.depth == depth &&
+           memcmp(record.frames, frames, static_cast<size_t>(depth) * sizeof(void*)) == 0;
+}
+
+void recordViolation(Violation type, const char* function) {
+    if (realtimeDepth == 0 || inChecker || !enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    inChecker = true;
+    violationCounts[static_cast<int32_t>(type)].fetch_add(1, std::memory_order_relaxed);
+
+    // Drop this function and the interposer from the stack
+    void* frames[RealtimeChecker::kMaxStackFrames + 2];
+    int32_t depth = std::max(backtrace(frames, RealtimeChecker::kMaxStackFrames + 2) - 2, 0);
+
+    bool known = false;
+    int32_t count = std::min(recordCount.load(std::memory_order_acquire), RealtimeChecker::kMaxRecords);
+    for (int32_t i = 0; i < count && !known; i++) {
+        Record& record = records[i];
+        if (record.ready.load(std::memory_order_acquire) &&
+            isSameRecord(record, type, function, frames + 2, depth)) {
+            record.hits.fetch_add(1, std::memory_order_relaxed);
+            known = true;
+        }
+    }
+    if (!known) {
+        int32_t index = recordCount.fetch_add(1, std::memory_order_acq_rel);
+        if (index < RealtimeChecker::kMaxRecords) {
+            Record& record = records[index];
+            record.type = type;
+            record.function = function;
+            record.depth = depth;
+            memcpy(record.frames, frames + 2, static_cast<size_t>(depth) * sizeof(void*));
+            record.hits.store(1, std::memory_order_relaxed);
+            record.ready.store(true, std::memory_order_release);
+        }
+    }
+
+    if (abortOnViolation.load(std::memory_order_relaxed)) {
+        RealtimeChecker::printReport(stderr);
+        abort();
+    }
+    inChecker = false;
+}
+
+// Next definition of a C library function, resolved once
+void* resolve(std::atomic<void*>& slot, const char* name, const char* version = nullptr) {
+    void* function = slot.load(std::memory_order_acquire);
+    if (!function) {
+        bool nested = inChecker;
+        inChecker = true;
+        function = version ? dlvsym(RTLD_NEXT, name, version) : nullptr;
+        if (!function) {
+            function = dlsym(RTLD_NEXT, name);
+        }
+        inChecker = nested;
+        slot.store(function, std::memory_order_release);
+    }
+    return function;
+}
+
+// Look up the real function of the interposer it is used in
+#define REAL_FUNCTION(name, ...)                                                                                       \
+    ([]() {                                                                                                            \
+        static std::atomic<void*> slot{nullptr};                                                                       \
+        return reinterpret_cast<decltype(&name)>(resolve(slot, #name, ##__VA_ARGS__));                                 \
+    }())
+
+// Symbol version of the current condition variable ABI, dlsym() alone may return the 2.2.5 compatibility one
+constexpr const char* kCondVersion = "GLIBC_2.3.2";
+
+} // namespace
+
+RealtimeChecker::Scope::Scope() { realtimeDepth++; }
+
+RealtimeChecker::Scope::~Scope() { realtimeDepth--; }
+
+void RealtimeChecker::enable(bool abortOnFirst) {
+    // backtrace() loads its unwinder on first use, which must not happen inside a checked scope
+    void* frames[2];
+    backtrace(frames, 2);
+    abortOnViolation.store(abortOnFirst, std::memory_order_relaxed);
+    enabled.store(true, std::memory_order_release);
+}
+
+void RealtimeChecker::disable() { enabled.store(false, std::memory_order_release); }
+
+uint64_t RealtimeChecker::getViolationCount() {
+    uint64_t total = 0;
+    for (const auto& count : violationCounts) {
+        total += count.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t RealtimeChecker::getViolationCount(Violation type) {
+    return violationCounts[static_cast<int32_t>(type)].load(std::memory_order_relaxed);
+}
+
+void RealtimeChecker::clear() {
+    for (auto& count : violationCounts) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    for (Record& record : records) {
+        record.ready.store(false, std::memory_order_relaxed);
+    }
+    recordCount.store(0, std::memory_order_release);
+}
+
+uint64_t RealtimeChecker::printReport(FILE* out) {
+    uint64_t total = getViolationCount();
+    int32_t count = std::min(recordCount.load(std::memory_order_acquire), kMaxRecords);
+    fprintf(out, "Real-time violations: %llu, %d distinct\n", static_cast<unsigned long long>(total), count);
+
+    for (int32_t i = 0; i < count; i++) {
+        const Record& record = records[i];
+        if (!record.ready.load(std::memory_order_acquire)) {
+            continue;
+        }
+        fprintf(out, "#%d %s: %s, %llu hits\n", i, getViolationName(record.type), record.function,
+                static_cast<unsigned long long>(record.hits.load(std::memory_order_relaxed)));
+
+        // "binary(mangled+0x12) [0x...]": demangle the part between '(' and '+'
+        char** symbols = backtrace_symbols(record.frames, record.depth);
+        for (int32_t frame = 0; frame < record.depth; frame++) {
+            const char* symbol = symbols ? symbols[frame] : "?";
+            const char* begin = strchr(symbol, '(');
+            const char* end = begin ? strchr(begin, '+') : nullptr;
+            char* demangled = nullptr;
+            if (begin && end && end > begin + 1) {
+                std::string mangled(begin + 1, end);
+                int status = 0;
+                demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+            }
+            fprintf(out, "    %2d %s\n", frame, demangled ? demangled : symbol);
+            free(demangled);
+        }
+        free(symbols);
+    }
+    if (recordCount.load(std::memory_order_relaxed) > kMaxRecords) {
+        fprintf(out, "(only the first %d distinct violations are kept)\n", kMaxRecords);
+    }
+    return total;
+}
+
+const char* RealtimeChecker::getViolationName(Violation type) {
+    switch (type) {
+    case Violation::Allocation:
+        return "allocation";
+    case Violation::MutexLock:
+        return "lock";
+    case Violation::FileIo:
+        return "file I/O";
+    case Violation::StdioIo:
+        return "stdio";
+    case Violation::Sleep:
+        return "sleep";
+    case Violation::Futex:
+        return "futex";
+    default:
+        return "unknown";
+    }
+}
+
+bool RealtimeCheckSink::open(const AudioSinkConfig& config,
+                             DataCallback dataCallback,
+                             ErrorCallback errorCallback,
+                             void* userData) {
+    clientCallback_ = dataCallback;
+    clientUserData_ = userData;
+    return dataCallback && SimulatedSink::open(config, &RealtimeCheckSink::checkedCallback, errorCallback, this);
+}
+
+AudioSink::CallbackResult RealtimeCheckSink::checkedCallback(void* userData, void* audioData, int32_t numFrames) {
+    auto sink = static_cast<RealtimeCheckSink*>(userData);
+    RealtimeChecker::Scope scope;
+    return sink->clientCallback_(sink->clientUserData_, audioData, numFrames);
+}
+
+// Interposers: record, then pass the call through to the C library
+extern "C" {
+
+void* malloc(size_t size) {
+    recordViolation(Violation::Allocation, "malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    recordViolation(Violation::Allocation, "calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    recordViolation(Violation::Allocation, "realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) {
+    if (pointer) {
+        recordViolation(Violation::Allocation, "free");
+    }
+    __libc_free(pointer);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    recordViolation(Violation::Allocation, "memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    recordViolation(Violation::Allocation, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) {
+    recordViolation(Violation::Allocation, "posix_memalign");
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* memory = __libc_memalign(alignment, size);
+    if (!memory) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    recordViolation(Violation::MutexLock, "pthread_mutex_lock");
+    return REAL_FUNCTION(pthread_mutex_lock)(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    recordViolation(Violation::MutexLock, "pthread_rwlock_rdlock");
+    return REAL_FUNCTION(pthread_rwlock_rdlock)(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    recordViolation(Violation::MutexLock, "pthread_rwlock_wrlock");
+    return REAL_FUNCTION(pthread_rwlock_wrlock)(lock);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex) {
+    recordViolation(Violation::MutexLock, "pthread_cond_wait");
+    return REAL_FUNCTION(pthread_cond_wait, kCondVersion)(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time) {
+    recordViolation(Violation::MutexLock, "pthread_cond_timedwait");
+    return REAL_FUNCTION(pthread_cond_timedwait, kCondVersion)(condition, mutex, time);
+}
+
+int sem_wait(sem_t* semaphore) {
+    recordViolation(Violation::MutexLock, "sem_wait");
+    return REAL_FUNCTION(sem_wait)(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const struct timespec* time) {
+    recordViolation(Violation::MutexLock, "sem_timedwait");
+    return REAL_FUNCTION(sem_timedwait)(semaphore, time);
+}
+
+ssize_t read(int fd, void* buffer, size_t count) {
+    recordViolation(Violation::FileIo, "read");
+    return REAL_FUNCTION(read)(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void* buffer, size_t count) {
+    recordViolation(Violation::FileIo, "write");
+    return REAL_FUNCTION(write)(fd, buffer, count);
+}
+
+int open(const char* path, int flags, ...) {
+    recordViolation(Violation::FileIo, "open");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return REAL_FUNCTION(open)(path, flags, mode);
+}
+
+int openat(int dirFd, const char* path, int flags, ...) {
+    recordViolation(Violation::FileIo, "openat");
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return REAL_FUNCTION(openat)(dirFd, path, flags, mode);
+}
+
+int close(int fd) {
+    recordViolation(Violation::FileIo, "close");
+    return REAL_FUNCTION(close)(fd);
+}
+
+FILE* fopen(const char* path, const char* mode) {
+    recordViolation(Violation::FileIo, "fopen");
+    return REAL_FUNCTION(fopen)(path, mode);
+}
+
+size_t fread(void* buffer, size_t size, size_t count, FILE* stream) {
+    recordViolation(Violation::StdioIo, "fread");
+    return REAL_FUNCTION(fread)(buffer, size, count, stream);
+}
+
+size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream) {
+    recordViolation(Violation::StdioIo, "fwrite");
+    return REAL_FUNCTION(fwrite)(buffer, size, count, stream);
+}
+
+int fputs(const char* text, FILE* stream) {
+    recordViolation(Violation::StdioIo, "fputs");
+    return REAL_FUNCTION(fputs)(text, stream);
+}
+
+int fputc(int character, FILE* stream) {
+    recordViolation(Violation::StdioIo, "fputc");
+    return REAL_FUNCTION(fputc)(character, stream);
+}
+
+int vfprintf(FILE* stream, const char* format, va_list args) {
+    recordViolation(Violation::StdioIo, "vfprintf");
+    return REAL_FUNCTION(vfprintf)(stream, format, args);
+}
+
+int fprintf(FILE* stream, const char* format, ...) {
+    recordViolation(Violation::StdioIo, "fprintf");
+    va_list args;
+    va_start(args, format);
+    int result = REAL_FUNCTION(vfprintf)(stream, format, args);
+    va_end(args);
+    return result;
+}
+
+int printf(const char* format, ...) {
+    recordViolation(Violation::StdioIo, "printf");
+    va_list args;
+    va_start(args, format);
+    int result = REAL_FUNCTION(vfprintf)(stdout, format, args);
+    va_end(args);
+    return result;
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    recordViolation(Violation::Sleep, "nanosleep");
+    return REAL_FUNCTION(nanosleep)(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining) {
+    recordViolation(Violation::Sleep, "clock_nanosleep");
+    return REAL_FUNCTION(clock_nanosleep)(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t duration) {
+    recordViolation(Violation::Sleep, "usleep");
+    return REAL_FUNCTION(usleep)(duration);
+}
+
+long syscall(long number, ...) {
+    if (number == SYS_futex) {
+        recordViolation(Violation::Futex, "syscall(SYS_futex)");
+    }
+    va_list args;
+    va_start(args, number);
+    long arguments[6];
+    for (long& argument : arguments) {
+        argument = va_arg(args, long);
+    }
+    va_end(args);
+    return REAL_FUNCTION(syscall)(number, arguments[0], arguments[1], arguments[2], arguments[3], arguments[4],
+                                  arguments[5]);
+}
+
+} // extern "C"
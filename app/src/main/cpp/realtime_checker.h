@@ -0,0 +1,102 @@
+#ifndef REALTIME_CHECKER_H
+#define REALTIME_CHECKER_H
+
+#include "simulated_sink.h"
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * Real-time safety checker for the audio callback (Linux host diagnostic)
+ *
+ * Linking realtime_checker.cpp into an executable interposes the C library
+ * functions that must never run on the audio thread: heap allocation
+ * (malloc/free and friends, so also operator new/delete), mutex and
+ * condition variable waits, blocking file and stdio I/O (read, write, open,
+ * close, fprintf, ...), sleeps and raw futex syscalls. Each call passes
+ * through to the C library; while the calling thread is inside a
+ * RealtimeChecker::Scope it is also recorded as a violation with its stack.
+ *
+ * Identical violations (same kind, same stack) are counted once with a hit
+ * count. Recording itself does not allocate, lock or do I/O; stacks are only
+ * symbolized by printReport(). Only for host builds: never link it into the
+ * Android library.
+ */
+class RealtimeChecker {
+public:
+    enum class Violation : int32_t {
+        Allocation, // malloc, calloc, realloc, free, aligned allocation
+        MutexLock,  // pthread mutex, rwlock, condition variable and semaphore waits
+        FileIo,     // read, write, open, close
+        StdioIo,    // fprintf, fputs, fwrite, ... (the host LOGx macros)
+        Sleep,      // nanosleep, usleep
+        Futex,      // syscall(SYS_futex, ...)
+        Count,
+    };
+
+    static constexpr int32_t kMaxRecords = 64;
+    static constexpr int32_t kMaxStackFrames = 24;
+
+    /**
+     * Marks the current thread as real-time while it exists (nestable)
+     */
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        // Disable copy and assignment
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    /**
+     * Start recording violations (not real-time safe)
+     * @param abortOnViolation Abort at the first violation, to stop in a debugger on it
+     */
+    static void enable(bool abortOnViolation = false);
+
+    static void disable();
+
+    /**
+     * Get the number of violations so far, including repeated ones (any thread)
+     */
+    static uint64_t getViolationCount();
+
+    static uint64_t getViolationCount(Violation type);
+
+    /**
+     * Forget all recorded violations, only while no real-time scope is active
+     */
+    static void clear();
+
+    /**
+     * Print each distinct violation with its symbolized stack (not real-time safe)
+     * @return Number of violations, as getViolationCount()
+     */
+    static uint64_t printReport(FILE* out);
+
+    static const char* getViolationName(Violation type);
+};
+
+/**
+ * Simulated device whose callbacks run inside a RealtimeChecker::Scope
+ */
+class RealtimeCheckSink : public SimulatedSink {
+public:
+    explicit RealtimeCheckSink(const SimulatedSink::Options& options) : SimulatedSink(options) {}
+
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override;
+
+    const char* getName() const override { return "RealtimeCheck"; }
+
+private:
+    static CallbackResult checkedCallback(void* userData, void* audioData, int32_t numFrames);
+
+    DataCallback clientCallback_ = nullptr;
+    void* clientUserData_ = nullptr;
+};
+
+#endif // REALTIME_CHECKER_H
@@ -0,0 +1,171 @@
+#include "render_sink.h"
+#include "audio_log.h"
+#include "wave_file.h"
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+
+// Plain 16-byte fmt chunk: RIFF, WAVE, fmt and data headers
+static constexpr uint32_t kWaveHeaderBytes = 44;
+
+// Largest data chunk the 32-bit RIFF sizes can describe
+static constexpr uint64_t kMaxWaveDataBytes = 0xFFFFFFFFULL - (kWaveHeaderBytes - 8);
+
+static void putLe16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void putLe32(uint8_t* out, uint32_t value) {
+    putLe16(out, static_cast<uint16_t>(value));
+    putLe16(out + 2, static_cast<uint16_t>(value >> 16));
+}
+
+RenderSink::RenderSink(const Options& options)
+    : SimulatedSink(makeDeviceOptions(options.device)), options_(options) {}
+
+RenderSink::~RenderSink() { close(); }
+
+SimulatedSink::Options RenderSink::makeDeviceOptions(const SimulatedSink::Options& options) {
+    SimulatedSink::Options device = options;
+    device.realtime = false;
+    device.jitterMaxUs = 0;
+    device.openDelayUs = 0;
+    return device;
+}
+
+bool RenderSink::open(const AudioSinkConfig& config,
+                      DataCallback dataCallback,
+                      ErrorCallback errorCallback,
+                      void* userData) {
+    close();
+
+    if (!dataCallback || !SimulatedSink::open(config, &RenderSink::renderCallback, errorCallback, this)) {
+        return false;
+    }
+    clientCallback_ = dataCallback;
+    clientUserData_ = userData;
+    bytesPerFrame_ = getChannelCount() * getBytesPerSample(getFormat());
+
+    file_.open(options_.outputPath, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+        LOGE("Render sink: cannot create %s", options_.outputPath.c_str());
+        SimulatedSink::close();
+        return false;
+    }
+    dataBytes_ = 0;
+    frameLimit_ = -1;
+    writeOk_ = options_.container == Container::Raw || writeWaveHeader();
+    if (!writeOk_) {
+        LOGE("Render sink: cannot write the header of %s", options_.outputPath.c_str());
+        file_.close();
+        SimulatedSink::close();
+        return false;
+    }
+
+    LOGI("Render sink: writing %s (%s)", options_.outputPath.c_str(), getContainerName(options_.container));
+    return true;
+}
+
+void RenderSink::close() {
+    // Joins the driver thread first, nothing writes to the file afterwards
+    SimulatedSink::close();
+    finishFile();
+}
+
+const char* RenderSink::getContainerName(Container container) {
+    switch (container) {
+    case Container::Wav:
+        return "wav";
+    case Container::Raw:
+        return "raw";
+    default:
+        return "unknown";
+    }
+}
+
+AudioSink::CallbackResult RenderSink::renderCallback(void* userData, void* audioData, int32_t numFrames) {
+    auto sink = static_cast<RenderSink*>(userData);
+    CallbackResult result = sink->clientCallback_(sink->clientUserData_, audioData, numFrames);
+
+    // The stop burst carries the last frames of the file as well
+    size_t bytes = static_cast<size_t>(numFrames) * sink->bytesPerFrame_;
+    if (sink->writeOk_) {
+        sink->file_.write(static_cast<const char*>(audioData), static_cast<std::streamsize>(bytes));
+        sink->writeOk_ = sink->file_.good();
+        sink->dataBytes_ += bytes;
+    }
+    if (!sink->writeOk_) {
+        LOGE("Render sink: write to %s failed", sink->options_.outputPath.c_str());
+        return CallbackResult::Stop;
+    }
+    return result;
+}
+
+// Canonical header, the sizes are patched in by finishFile()
+bool RenderSink::writeWaveHeader() {
+    const SampleFormat format = getFormat();
+    const auto channels = static_cast<uint16_t>(getChannelCount());
+    const auto rate = static_cast<uint32_t>(getSampleRate());
+    const auto bits = static_cast<uint16_t>(getBytesPerSample(format) * 8);
+
+    uint8_t header[kWaveHeaderBytes];
+    memcpy(header, "RIFF", 4);
+    putLe32(header + 4, kWaveHeaderBytes - 8);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    putLe32(header + 16, 16);
+    putLe16(header + 20, format == SampleFormat::Float ? WaveFile::kFormatIeeeFloat : WaveFile::kFormatPcm);
+    putLe16(header + 22, channels);
+    putLe32(header + 24, rate);
+    putLe32(header + 28, rate * static_cast<uint32_t>(bytesPerFrame_));
+    putLe16(header + 32, static_cast<uint16_t>(bytesPerFrame_));
+    putLe16(header + 34, bits);
+    memcpy(header + 36, "data", 4);
+    putLe32(header + 40, 0);
+
+    file_.write(reinterpret_cast<const char*>(header), sizeof(header));
+    return file_.good();
+}
+
+void RenderSink::finishFile() {
+    if (!file_.is_open()) {
+        return;
+    }
+
+    const uint64_t headerBytes = options_.container == Container::Wav ? kWaveHeaderBytes : 0;
+    const uint64_t writtenBytes = headerBytes + dataBytes_;
+    if (frameLimit_ >= 0) {
+        dataBytes_ = std::min(dataBytes_, static_cast<uint64_t>(frameLimit_) * static_cast<uint64_t>(bytesPerFrame_));
+    }
+    // RIFF chunks are padded to an even size
+    const uint64_t padBytes = options_.container == Container::Wav ? dataBytes_ & 1 : 0;
+
+    if (options_.container == Container::Wav && writeOk_) {
+        if (dataBytes_ > kMaxWaveDataBytes) {
+            LOGW("Render sink: %s exceeds 4 GB, the WAV sizes are clamped", options_.outputPath.c_str());
+        }
+        auto dataSize = static_cast<uint32_t>(std::min(dataBytes_, kMaxWaveDataBytes));
+        uint8_t size[4];
+        putLe32(size, dataSize + static_cast<uint32_t>(padBytes) + (kWaveHeaderBytes - 8));
+        file_.seekp(4);
+        file_.write(reinterpret_cast<const char*>(size), sizeof(size));
+        putLe32(size, dataSize);
+        file_.seekp(40);
+        file_.write(reinterpret_cast<const char*>(size), sizeof(size));
+        if (padBytes) {
+            file_.seekp(static_cast<std::streamoff>(headerBytes + dataBytes_));
+            file_.put('\0');
+        }
+        writeOk_ = file_.good();
+    }
+
+    file_.close();
+    const uint64_t keptBytes = headerBytes + dataBytes_ + padBytes;
+    if (writeOk_ && keptBytes < writtenBytes && truncate(options_.outputPath.c_str(), static_cast<off_t>(keptBytes))) {
+        LOGE("Render sink: cannot trim %s", options_.outputPath.c_str());
+        writeOk_ = false;
+    }
+    if (!writeOk_) {
+        LOGE("Render sink: %s is incomplete", options_.outputPath.c_str());
+    }
+}
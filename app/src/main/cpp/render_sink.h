@@ -0,0 +1,93 @@
+#ifndef RENDER_SINK_H
+#define RENDER_SINK_H
+
+#include "simulated_sink.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * Offline output device writing the rendered stream to a file
+ *
+ * A SimulatedSink that never paces its callbacks to the wall clock, so the
+ * pipeline renders as fast as the CPU allows, and that appends every burst
+ * to a WAV or headerless raw file in the granted stream format. The burst
+ * on which the callback returns Stop is written too, padded with silence
+ * after the last frames of the file; setFrameLimit() trims that padding.
+ *
+ * The file is finalized (trimmed, WAV sizes patched in) when the sink is closed.
+ */
+class RenderSink : public SimulatedSink {
+public:
+    enum class Container : int32_t {
+        Wav,
+        Raw, // Interleaved samples only, in the stream format
+    };
+
+    struct Options {
+        std::string outputPath;
+        Container container = Container::Wav;
+        SimulatedSink::Options device; // realtime is forced off
+    };
+
+    explicit RenderSink(const Options& options);
+    ~RenderSink() override;
+
+    // Disable copy and assignment
+    RenderSink(const RenderSink&) = delete;
+    RenderSink& operator=(const RenderSink&) = delete;
+
+    /**
+     * Open the stream and create the output file
+     * @return Returns false if the stream or the file cannot be opened
+     */
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override;
+
+    /**
+     * Stop rendering and finalize the output file
+     */
+    void close() override;
+
+    /**
+     * Keep only the first frames of the output when the file is finalized
+     * @param frames Frames to keep, e.g. PlayerEngine::getEndFrame(); -1 keeps everything
+     */
+    void setFrameLimit(int64_t frames) { frameLimit_ = frames; }
+
+    const char* getName() const override { return "Render"; }
+
+    /**
+     * Check whether every burst so far reached the file
+     */
+    bool isWriteOk() const { return writeOk_; }
+
+    /**
+     * Get the bytes written to the output file after the header, after trimming once closed
+     */
+    uint64_t getDataBytes() const { return dataBytes_; }
+
+    static const char* getContainerName(Container container);
+
+private:
+    static CallbackResult renderCallback(void* userData, void* audioData, int32_t numFrames);
+    static SimulatedSink::Options makeDeviceOptions(const SimulatedSink::Options& options);
+
+    bool writeWaveHeader();
+    void finishFile();
+
+    Options options_;
+    DataCallback clientCallback_ = nullptr;
+    void* clientUserData_ = nullptr;
+    int32_t bytesPerFrame_ = 0;
+
+    // Written by the driver thread only while rendering
+    std::ofstream file_;
+    uint64_t dataBytes_ = 0;
+    bool writeOk_ = false;
+    int64_t frameLimit_ = -1;
+};
+
+#endif // RENDER_SINK_H
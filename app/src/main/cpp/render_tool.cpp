@@ -0,0 +1,122 @@
+// Host command line front end of OfflineRenderer, e.g. for regression runs on CI machines without audio hardware
+#include "offline_renderer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] <output dir> <input file>...\n"
+            "  -j <threads>  Render files in parallel, default one thread per core\n"
+            "  -b <frames>   Frames per callback, default 192\n"
+            "  -f <format>   Stream format i16, i24, i32 or float, default as the file\n"
+            "  -r            Write raw samples instead of WAV\n"
+            "  -n            Dither and use the SIMD kernels as on a device, the output then depends on the CPU\n"
+            "  -g <dir>      Compare each output with the file of the same name in <dir>\n",
+            program);
+}
+
+static bool parseFormat(const char* name, SampleFormat* format) {
+    static const struct {
+        const char* name;
+        SampleFormat format;
+    } kFormats[] = {
+        {"i16", SampleFormat::I16},
+        {"i24", SampleFormat::I24Packed},
+        {"i32", SampleFormat::I32},
+        {"float", SampleFormat::Float},
+    };
+    for (const auto& entry : kFormats) {
+        if (strcmp(name, entry.name) == 0) {
+            *format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Output name: the input file name plus the extension of the container unless it already has it,
+// so x.wav stays x.wav while x.flac becomes x.flac.wav and does not collide with it
+static std::string makeOutputName(const std::string& inputPath, RenderSink::Container container) {
+    size_t slash = inputPath.find_last_of('/');
+    std::string name = slash == std::string::npos ? inputPath : inputPath.substr(slash + 1);
+    std::string extension = std::string(".") + RenderSink::getContainerName(container);
+    if (name.size() > extension.size() &&
+        strcasecmp(name.c_str() + name.size() - extension.size(), extension.c_str()) == 0) {
+        return name;
+    }
+    return name + extension;
+}
+
+int main(int argc, char** argv) {
+    OfflineRenderer::Options options;
+    std::string goldenDir;
+
+    int index = 1;
+    for (; index < argc && argv[index][0] == '-'; index++) {
+        const char* option = argv[index];
+        const char* value = index + 1 < argc ? argv[index + 1] : nullptr;
+        if (strcmp(option, "-r") == 0) {
+            options.container = RenderSink::Container::Raw;
+            continue;
+        }
+        if (strcmp(option, "-n") == 0) {
+            options.deterministic = false;
+            continue;
+        }
+        if (!value) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (strcmp(option, "-j") == 0) {
+            options.threadCount = atoi(value);
+        } else if (strcmp(option, "-b") == 0) {
+            options.device.framesPerBurst = atoi(value);
+        } else if (strcmp(option, "-f") == 0) {
+            if (!parseFormat(value, &options.device.format)) {
+                printUsage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(option, "-g") == 0) {
+            goldenDir = value;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+        index++;
+    }
+    if (argc - index < 2) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    const std::string outputDir = argv[index++];
+    std::vector<OfflineRenderer::Job> jobs;
+    for (; index < argc; index++) {
+        OfflineRenderer::Job job;
+        job.inputPath = argv[index];
+        std::string name = makeOutputName(job.inputPath, options.container);
+        job.outputPath = outputDir + "/" + name;
+        if (!goldenDir.empty()) {
+            job.goldenPath = goldenDir + "/" + name;
+        }
+        jobs.push_back(job);
+    }
+
+    OfflineRenderer renderer(options);
+    OfflineRenderer::Summary summary;
+    std::vector<OfflineRenderer::Result> results = renderer.renderAll(jobs, &summary);
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const OfflineRenderer::Result& result = results[i];
+        printf("%s: %s, %lld frames at %d Hz, %.1fx realtime%s\n", jobs[i].inputPath.c_str(),
+               result.ok ? "ok" : result.error.c_str(), static_cast<long long>(result.frames), result.sampleRate,
+               result.realtimeFactor, result.compared && result.ok ? ", matches golden" : "");
+    }
+    printf("%d rendered, %d failed, %.1f s of audio in %.3f s, %.1fx realtime\n", summary.succeeded, summary.failed,
+           summary.audioSeconds, static_cast<double>(summary.elapsedNs) / 1e9, summary.realtimeFactor);
+    return summary.failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+#include "resampler.h"
+#include "audio_log.h"
+#include "format_converter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define RESAMPLER_HAS_NEON 1
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RESAMPLER_HAS_SSE2 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESAMPLER_HAS_AVX2 1
+#define RESAMPLER_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+// std::min takes kPullFrames by reference
+constexpr int32_t Resampler::kPullFrames;
+
+namespace {
+
+struct QualityParams {
+    int32_t taps;   // Per phase when not decimating, multiple of 8
+    double beta;    // Kaiser window shape
+    double rolloff; // Passband edge as a fraction of the lower Nyquist
+};
+
+QualityParams getQualityParams(Resampler::Quality quality) {
+    switch (quality) {
+    case Resampler::Quality::Low:
+        return {16, 6.0, 0.90};
+    case Resampler::Quality::High:
+        return {64, 10.0, 0.95};
+    case Resampler::Quality::Medium:
+    default:
+        return {32, 8.0, 0.92};
+    }
+}
+
+// Upper bound on taps per phase when decimating
+constexpr int32_t kMaxTaps = 256;
+
+// Zeroth-order modified Bessel function of the first kind
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x / 2.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+int32_t greatestCommonDivisor(int32_t a, int32_t b) {
+    while (b != 0) {
+        int32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+float dotScalar(const float* x, const float* h, int32_t count) {
+    float sum = 0.0f;
+    for (int32_t i = 0; i < count; i++) {
+        sum += x[i] * h[i];
+    }
+    return sum;
+}
+
+#if RESAMPLER_HAS_SSE2
+float dotSse2(const float* x, const float* h, int32_t count) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i), _mm_loadu_ps(h + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(h + i + 4)));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < count; i++) {
+        sum += x[i] * h[i];
+    }
+    return sum;
+}
+#endif
+
+#if RESAMPLER_HAS_AVX2
+RESAMPLER_AVX2 float dotAvx2(const float* x, const float* h, int32_t count) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(h + i + 8), acc1);
+    }
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, half);
+    float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for (; i < count; i++) {
+        sum += x[i] * h[i];
+    }
+    return sum;
+}
+#endif
+
+#if RESAMPLER_HAS_NEON
+float dotNeon(const float* x, const float* h, int32_t count) {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    int32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(h + i));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(x + i + 4), vld1q_f32(h + i + 4));
+    }
+    float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; i < count; i++) {
+        sum += x[i] * h[i];
+    }
+    return sum;
+}
+#endif
+
+} // namespace
+
+bool Resampler::prepare(int32_t inputRate, int32_t outputRate, int32_t channelCount, Quality quality) {
+    if (inputRate <= 0 || outputRate <= 0 || channelCount <= 0) {
+        return false;
+    }
+
+    int32_t divisor = greatestCommonDivisor(inputRate, outputRate);
+    int32_t phases = outputRate / divisor;
+    int32_t step = inputRate / divisor;
+    if (phases > kMaxPhases) {
+        LOGE("Resampler: %d -> %d needs %d phases (max %d)", inputRate, outputRate, phases, kMaxPhases);
+        return false;
+    }
+
+    // Decimation lowers the cutoff, widen the filter to keep the same transition band in output terms
+    QualityParams params = getQualityParams(quality);
+    double ratio = static_cast<double>(phases) / step;
+    int32_t taps = params.taps;
+    if (ratio < 1.0) {
+        taps = static_cast<int32_t>(std::ceil(params.taps / ratio / 8.0)) * 8;
+        taps = std::min(taps, kMaxTaps);
+    }
+    double cutoff = 0.5 * params.rolloff * std::min(1.0, ratio); // Cycles per input sample
+
+    channelCount_ = channelCount;
+    phaseCount_ = phases;
+    step_ = step;
+    tapCount_ = taps;
+    coefficients_.reset(new float[static_cast<size_t>(phases) * taps]);
+
+    // Row p holds h(p / L + taps / 2 - 1 - k): tap k = 0 is the oldest input frame
+    double halfLength = taps / 2.0;
+    double windowNorm = besselI0(params.beta);
+    std::vector<double> values(taps);
+    for (int32_t p = 0; p < phases; p++) {
+        float* row = coefficients_.get() + static_cast<size_t>(p) * taps;
+        double rowSum = 0.0;
+        for (int32_t k = 0; k < taps; k++) {
+            double x = static_cast<double>(p) / phases + (halfLength - 1.0) - k;
+            double arg = 2.0 * cutoff * x;
+            double sinc = std::fabs(arg) < 1e-12 ? 1.0 : std::sin(M_PI * arg) / (M_PI * arg);
+            double position = x / halfLength;
+            double window = std::fabs(position) >= 1.0
+                                ? 0.0
+                                : besselI0(params.beta * std::sqrt(1.0 - position * position)) / windowNorm;
+            values[k] = 2.0 * cutoff * sinc * window;
+            rowSum += values[k];
+        }
+        // Unity DC gain on every phase
+        for (int32_t k = 0; k < taps; k++) {
+            row[k] = static_cast<float>(values[k] / rowSum);
+        }
+    }
+
+    capacity_ = taps + kPullFrames;
+    history_.reset(new float[static_cast<size_t>(capacity_) * channelCount]);
+    pullBuffer_.reset(new float[static_cast<size_t>(kPullFrames) * channelCount]);
+
+    switch (FormatConverter::getBestIsa()) {
+#if RESAMPLER_HAS_NEON
+    case FormatConverter::Isa::Neon:
+        dot_ = dotNeon;
+        break;
+#endif
+#if RESAMPLER_HAS_AVX2
+    case FormatConverter::Isa::Avx2:
+        dot_ = __builtin_cpu_supports("fma") ? dotAvx2 : dotSse2;
+        break;
+#endif
+#if RESAMPLER_HAS_SSE2
+    case FormatConverter::Isa::Sse2:
+        dot_ = dotSse2;
+        break;
+#endif
+    default:
+        dot_ = dotScalar;
+        break;
+    }
+
+    reset();
+    LOGI("Resampler %d -> %dHz: %s, %d phases x %d taps", inputRate, outputRate, getQualityName(quality), phases,
+         taps);
+    return true;
+}
+
+void Resampler::reset() {
+    if (!history_) {
+        return;
+    }
+
+    // Prime with silence so the first output is centred on input frame 0
+    int32_t primed = tapCount_ / 2 - 1;
+    memset(history_.get(), 0, static_cast<size_t>(capacity_) * channelCount_ * sizeof(float));
+    available_ = primed;
+    start_ = 0;
+    phase_ = 0;
+    historyBase_ = -primed;
+    totalInput_ = 0;
+    inputEnded_ = false;
+}
+
+bool Resampler::fillInput(AudioSource& source) {
+    // Drop frames the window has moved past
+    if (start_ > 0) {
+        int32_t kept = available_ - start_;
+        for (int32_t c = 0; c < channelCount_; c++) {
+            float* channel = history_.get() + static_cast<size_t>(c) * capacity_;
+            memmove(channel, channel + start_, static_cast<size_t>(kept) * sizeof(float));
+        }
+        historyBase_ += start_;
+        available_ = kept;
+        start_ = 0;
+    }
+
+    while (available_ < capacity_) {
+        int32_t wanted = std::min(kPullFrames, capacity_ - available_);
+        int32_t got = inputEnded_ ? 0 : source.read(pullBuffer_.get(), wanted);
+
+        // Deinterleave into the planar history
+        for (int32_t c = 0; c < channelCount_; c++) {
+            float* channel = history_.get() + static_cast<size_t>(c) * capacity_ + available_;
+            const float* input = pullBuffer_.get() + c;
+            for (int32_t i = 0; i < got; i++) {
+                channel[i] = input[static_cast<size_t>(i) * channelCount_];
+            }
+        }
+        available_ += got;
+        totalInput_ += got;
+
+        if (got < wanted) {
+            inputEnded_ = inputEnded_ || source.isFinished();
+
+            // End of input or an underflow: pad with silence, but only as far as one window needs
+            int32_t padded = std::max(0, tapCount_ - available_);
+            for (int32_t c = 0; c < channelCount_; c++) {
+                memset(history_.get() + static_cast<size_t>(c) * capacity_ + available_, 0,
+                       static_cast<size_t>(padded) * sizeof(float));
+            }
+            available_ += padded;
+            break;
+        }
+    }
+    return available_ >= tapCount_;
+}
+
+int32_t Resampler::process(float* output, int32_t numFrames, AudioSource& source) {
+    int32_t produced = 0;
+    if (!dot_) {
+        memset(output, 0, static_cast<size_t>(numFrames) * channelCount_ * sizeof(float));
+        return 0;
+    }
+
+    for (; produced < numFrames; produced++) {
+        if (start_ + tapCount_ > available_ && !fillInput(source)) {
+            break;
+        }
+
+        // Output position passed the last real input frame
+        int64_t centre = historyBase_ + start_ + tapCount_ / 2 - 1;
+        if (inputEnded_ && centre >= totalInput_) {
+            break;
+        }
+
+        const float* row = coefficients_.get() + static_cast<size_t>(phase_) * tapCount_;
+        float* frame = output + static_cast<size_t>(produced) * channelCount_;
+        for (int32_t c = 0; c < channelCount_; c++) {
+            frame[c] = dot_(history_.get() + static_cast<size_t>(c) * capacity_ + start_, row, tapCount_);
+        }
+
+        phase_ += step_;
+        start_ += phase_ / phaseCount_;
+        phase_ %= phaseCount_;
+    }
+
+    if (produced < numFrames) {
+        memset(output + static_cast<size_t>(produced) * channelCount_, 0,
+               static_cast<size_t>(numFrames - produced) * channelCount_ * sizeof(float));
+    }
+    return produced;
+}
+
+const char* Resampler::getQualityName(Quality quality) {
+    switch (quality) {
+    case Quality::Low:
+        return "low";
+    case Quality::Medium:
+        return "medium";
+    case Quality::High:
+        return "high";
+    default:
+        return "unknown";
+    }
+}
+
+ResampledSource::ResampledSource(std::unique_ptr<AudioSource> source, int32_t outputRate, Resampler::Quality quality)
+    : source_(std::move(source)), outputRate_(outputRate) {
+    valid_ = source_ &&
+             resampler_.prepare(source_->getSampleRate(), outputRate, source_->getChannelCount(), quality);
+}
+
+int32_t ResampledSource::read(float* buffer, int32_t numFrames) {
+    if (!valid_ || finished_) {
+        return 0;
+    }
+
+    int32_t produced = resampler_.process(buffer, numFrames, *source_);
+    finished_ = produced < numFrames;
+    return produced;
+}
@@ -0,0 +1,123 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include "audio_source.h"
+#include <cstdint>
+#include <memory>
+
+/**
+ * Polyphase windowed-sinc sample rate converter
+ *
+ * Converts by the exact rational ratio outRate/inRate = L/M. The L phases of
+ * a Kaiser-windowed sinc are precomputed at prepare() time, so producing one
+ * output sample is one dot product per channel against a contiguous
+ * coefficient row. Input history is kept planar (one array per channel) so
+ * the dot products vectorize (NEON/SSE2/AVX2) for any channel count.
+ *
+ * Pulls input from an AudioSource, so it can sit in front of any source and
+ * is itself used through ResampledSource.
+ */
+class Resampler {
+public:
+    enum class Quality {
+        Low,    // 16 taps, ~60 dB stopband
+        Medium, // 32 taps, ~85 dB stopband
+        High,   // 64 taps, ~100 dB stopband
+    };
+
+    static constexpr int32_t kMaxPhases = 1024;
+
+    Resampler() = default;
+
+    // Disable copy and assignment
+    Resampler(const Resampler&) = delete;
+    Resampler& operator=(const Resampler&) = delete;
+
+    /**
+     * Build the coefficient tables and history buffers (not real-time safe)
+     * @param inputRate Source sample rate
+     * @param outputRate Stream sample rate
+     * @param channelCount Interleaved channel count
+     * @param quality Filter length and stopband tier
+     * @return Returns false if the reduced ratio needs more than kMaxPhases phases
+     */
+    bool prepare(int32_t inputRate, int32_t outputRate, int32_t channelCount, Quality quality);
+
+    /**
+     * Produce output frames, pulling input from source as needed (real-time safe)
+     * @param output Interleaved float, numFrames frames
+     * @param numFrames Frames to produce
+     * @param source Input with the prepared rate and channel count
+     * @return Frames produced; fewer than requested (rest zeroed) once source has ended
+     */
+    int32_t process(float* output, int32_t numFrames, AudioSource& source);
+
+    /**
+     * Forget history and restart at phase 0
+     */
+    void reset();
+
+    int32_t getTapCount() const { return tapCount_; }
+    int32_t getPhaseCount() const { return phaseCount_; }
+
+    static const char* getQualityName(Quality quality);
+
+private:
+    static constexpr int32_t kPullFrames = 256;
+
+    bool fillInput(AudioSource& source);
+
+    int32_t channelCount_ = 0;
+    int32_t phaseCount_ = 0; // L
+    int32_t step_ = 0;       // M
+    int32_t tapCount_ = 0;
+    std::unique_ptr<float[]> coefficients_; // phaseCount_ rows of tapCount_
+
+    // Planar history, capacity_ frames per channel
+    std::unique_ptr<float[]> history_;
+    std::unique_ptr<float[]> pullBuffer_;
+    int32_t capacity_ = 0;
+    int32_t available_ = 0; // Frames held in history
+    int32_t start_ = 0;     // First frame of the current filter window
+    int32_t phase_ = 0;
+
+    // End handling: output stops once its position passes the last real input frame
+    int64_t historyBase_ = 0; // Input frame index of history frame 0 (negative while primed)
+    int64_t totalInput_ = 0;  // Real input frames pulled so far
+    bool inputEnded_ = false;
+
+    using DotKernel = float (*)(const float* x, const float* h, int32_t count);
+    DotKernel dot_ = nullptr;
+};
+
+/**
+ * AudioSource adapter that resamples another source
+ */
+class ResampledSource : public AudioSource {
+public:
+    /**
+     * @param source Input source, owned
+     * @param outputRate Rate to produce
+     * @param quality Filter tier
+     */
+    ResampledSource(std::unique_ptr<AudioSource> source, int32_t outputRate, Resampler::Quality quality);
+
+    /**
+     * True if the resampler could be prepared for this ratio
+     */
+    bool isValid() const { return valid_; }
+
+    int32_t getSampleRate() const override { return outputRate_; }
+    int32_t getChannelCount() const override { return source_->getChannelCount(); }
+    int32_t read(float* buffer, int32_t numFrames) override;
+    bool isFinished() const override { return finished_; }
+
+private:
+    std::unique_ptr<AudioSource> source_;
+    Resampler resampler_;
+    int32_t outputRate_;
+    bool valid_ = false;
+    bool finished_ = false;
+};
+
+#endif // RESAMPLER_H
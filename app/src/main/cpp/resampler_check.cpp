@@ -0,0 +1,401 @@
+// Host check of the Resampler on every quality tier: THD+N, passband ripple, stopband and image rejection,
+// DC gain, timing alignment and output length against the exact ratio, and chunked against one-shot processing.
+// Prints the CPU cost per output frame of each tier; -b times it longer.
+#include "format_converter.h"
+#include "resampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("resampler_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+// Mono or interleaved input held in memory, served in whatever sizes the resampler pulls
+class BufferSource : public AudioSource {
+public:
+    BufferSource(std::vector<float> samples, int32_t sampleRate, int32_t channelCount)
+        : samples_(std::move(samples)), sampleRate_(sampleRate), channelCount_(channelCount) {}
+
+    int32_t getSampleRate() const override { return sampleRate_; }
+    int32_t getChannelCount() const override { return channelCount_; }
+
+    int32_t read(float* buffer, int32_t numFrames) override {
+        size_t frames = samples_.size() / channelCount_;
+        auto count = static_cast<int32_t>(std::min<size_t>(numFrames, frames - position_));
+        memcpy(buffer, samples_.data() + position_ * channelCount_, sizeof(float) * count * channelCount_);
+        position_ += static_cast<size_t>(count);
+        return count;
+    }
+
+    bool isFinished() const override { return position_ * channelCount_ >= samples_.size(); }
+
+private:
+    std::vector<float> samples_;
+    int32_t sampleRate_;
+    int32_t channelCount_;
+    size_t position_ = 0;
+};
+
+std::vector<float> makeSine(double frequency, int32_t sampleRate, int32_t frames, double amplitude) {
+    std::vector<float> samples(static_cast<size_t>(frames));
+    for (int32_t i = 0; i < frames; i++) {
+        samples[i] = static_cast<float>(amplitude * std::sin(2.0 * M_PI * frequency * i / sampleRate));
+    }
+    return samples;
+}
+
+// Resample a whole mono buffer, pulling at a callback-sized burst
+std::vector<float> resample(Resampler& resampler, std::vector<float> input, int32_t inputRate, int32_t burst = 480) {
+    BufferSource source(std::move(input), inputRate, 1);
+    std::vector<float> output;
+    std::vector<float> buffer(static_cast<size_t>(burst));
+    for (;;) {
+        int32_t produced = resampler.process(buffer.data(), burst, source);
+        output.insert(output.end(), buffer.begin(), buffer.begin() + produced);
+        if (produced < burst) {
+            return output;
+        }
+    }
+}
+
+/**
+ * Least-squares fit of sines of known frequencies plus an offset over output[begin, end)
+ * Fitting every tone present at once keeps a loud tone from leaking into the amplitude of a quiet one.
+ * @param cyclesPerSample Frequencies relative to the output rate
+ * @param residualPower Mean power of what the fit leaves, noise plus distortion
+ * @return Amplitude of each fitted sine
+ */
+std::vector<double> fitSines(const std::vector<float>& output, size_t begin, size_t end,
+                             const std::vector<double>& cyclesPerSample, double* residualPower) {
+    // Normal equations of y = sum(a sin + b cos) + c, solved with partial pivoting
+    const size_t size = cyclesPerSample.size() * 2 + 1;
+    std::vector<double> matrix(size * (size + 1), 0.0);
+    std::vector<double> basis(size);
+    auto fillBasis = [&basis, &cyclesPerSample, size](size_t n) {
+        for (size_t tone = 0; tone < cyclesPerSample.size(); tone++) {
+            basis[2 * tone] = std::sin(2.0 * M_PI * cyclesPerSample[tone] * static_cast<double>(n));
+            basis[2 * tone + 1] = std::cos(2.0 * M_PI * cyclesPerSample[tone] * static_cast<double>(n));
+        }
+        basis[size - 1] = 1.0;
+    };
+    for (size_t n = begin; n < end; n++) {
+        fillBasis(n);
+        for (size_t row = 0; row < size; row++) {
+            for (size_t column = 0; column < size; column++) {
+                matrix[row * (size + 1) + column] += basis[row] * basis[column];
+            }
+            matrix[row * (size + 1) + size] += basis[row] * output[n];
+        }
+    }
+    for (size_t pivot = 0; pivot < size; pivot++) {
+        size_t best = pivot;
+        for (size_t row = pivot + 1; row < size; row++) {
+            if (std::fabs(matrix[row * (size + 1) + pivot]) > std::fabs(matrix[best * (size + 1) + pivot])) {
+                best = row;
+            }
+        }
+        for (size_t column = 0; column <= size; column++) {
+            std::swap(matrix[pivot * (size + 1) + column], matrix[best * (size + 1) + column]);
+        }
+        for (size_t row = 0; row < size; row++) {
+            if (row == pivot) {
+                continue;
+            }
+            double factor = matrix[row * (size + 1) + pivot] / matrix[pivot * (size + 1) + pivot];
+            for (size_t column = pivot; column <= size; column++) {
+                matrix[row * (size + 1) + column] -= factor * matrix[pivot * (size + 1) + column];
+            }
+        }
+    }
+    std::vector<double> coefficients(size);
+    for (size_t row = 0; row < size; row++) {
+        coefficients[row] = matrix[row * (size + 1) + size] / matrix[row * (size + 1) + row];
+    }
+
+    if (residualPower) {
+        double sum = 0.0;
+        for (size_t n = begin; n < end; n++) {
+            fillBasis(n);
+            double fit = 0.0;
+            for (size_t i = 0; i < size; i++) {
+                fit += coefficients[i] * basis[i];
+            }
+            sum += (output[n] - fit) * (output[n] - fit);
+        }
+        *residualPower = sum / static_cast<double>(end - begin);
+    }
+    std::vector<double> amplitudes(cyclesPerSample.size());
+    for (size_t tone = 0; tone < amplitudes.size(); tone++) {
+        amplitudes[tone] = std::hypot(coefficients[2 * tone], coefficients[2 * tone + 1]);
+    }
+    return amplitudes;
+}
+
+double toDb(double ratio) { return 20.0 * std::log10(std::max(ratio, 1e-12)); }
+
+// Limits per tier, with margin below what the filters reach on the rate pairs checked
+struct TierLimits {
+    Resampler::Quality quality;
+    double maxThdN;       // dB relative to the tone, 1 kHz
+    double passbandEdge;  // Fraction of the lower Nyquist the ripple is measured up to
+    double maxRipple;     // dB, peak to peak
+    double minRejection;  // dB, stopband and image tones
+};
+
+const TierLimits kTiers[] = {
+    {Resampler::Quality::Low, -68.0, 0.50, 0.05, 70.0},
+    {Resampler::Quality::Medium, -80.0, 0.70, 0.01, 85.0},
+    {Resampler::Quality::High, -105.0, 0.80, 0.001, 110.0},
+};
+
+struct RatePair {
+    int32_t inputRate;
+    int32_t outputRate;
+    bool rejection; // Far enough from 1:1 for a tone to sit well inside the stopband
+};
+
+const RatePair kRatePairs[] = {
+    {44100, 48000, false}, {48000, 44100, false}, {48000, 96000, true}, {96000, 48000, true}, {22050, 48000, true},
+};
+
+// Frames of each measured tone, and the edge trimmed off both ends as filter transients
+constexpr int32_t kToneFrames = 32768;
+constexpr size_t kSettleFrames = 512;
+
+// Amplitudes of tones in the resampled output of a -6 dBFS sine
+std::vector<double> measureTones(Resampler& resampler, const RatePair& rates, double frequency,
+                                 const std::vector<double>& outputFrequencies, double* residualPower) {
+    resampler.reset();
+    std::vector<float> output = resample(resampler, makeSine(frequency, rates.inputRate, kToneFrames, 0.5),
+                                         rates.inputRate);
+    std::vector<double> cyclesPerSample;
+    for (double outputFrequency : outputFrequencies) {
+        cyclesPerSample.push_back(outputFrequency / rates.outputRate);
+    }
+    return fitSines(output, kSettleFrames, output.size() - kSettleFrames, cyclesPerSample, residualPower);
+}
+
+void checkQuality(const TierLimits& tier, const RatePair& rates) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s %d->%d", Resampler::getQualityName(tier.quality), rates.inputRate,
+             rates.outputRate);
+    Resampler resampler;
+    if (!expect(resampler.prepare(rates.inputRate, rates.outputRate, 1, tier.quality), name, "prepare failed")) {
+        return;
+    }
+
+    // THD+N of a 1 kHz tone
+    double residual = 0.0;
+    double amplitude = measureTones(resampler, rates, 1000.0, {1000.0}, &residual)[0];
+    double thdN = 10.0 * std::log10(std::max(residual, 1e-30) / (amplitude * amplitude / 2.0));
+
+    // Ripple from 20 Hz to the tier's passband edge, in third-octave steps
+    const double passbandEdge = tier.passbandEdge * std::min(rates.inputRate, rates.outputRate) / 2.0;
+    double minGain = 1e9;
+    double maxGain = -1e9;
+    for (double frequency = 20.0; frequency <= passbandEdge; frequency *= 1.2599) {
+        double gain = toDb(measureTones(resampler, rates, frequency, {frequency}, nullptr)[0] / 0.5);
+        minGain = std::min(minGain, gain);
+        maxGain = std::max(maxGain, gain);
+    }
+
+    // Decimation: a tone near the input Nyquist must not alias back below the output Nyquist.
+    // Interpolation: the image of a tone at a quarter of the input rate, mirrored about the input Nyquist
+    // (and folded about the output Nyquist), must be suppressed while the tone passes.
+    double rejection = 0.0;
+    if (rates.rejection) {
+        if (rates.outputRate < rates.inputRate) {
+            double frequency = 0.45 * rates.inputRate;
+            std::vector<double> tones = measureTones(resampler, rates, frequency,
+                                                     {std::fabs(rates.outputRate - frequency)}, nullptr);
+            rejection = -toDb(tones[0] / 0.5);
+        } else {
+            double frequency = rates.inputRate / 4.0;
+            double image = rates.inputRate - frequency;
+            image = image > rates.outputRate / 2.0 ? rates.outputRate - image : image;
+            std::vector<double> tones = measureTones(resampler, rates, frequency, {frequency, image}, nullptr);
+            rejection = -toDb(tones[1] / tones[0]);
+        }
+    }
+
+    printf("%-22s THD+N %7.1f dB  ripple %7.4f dB to %5.0f Hz  rejection %5.1f dB\n", name, thdN,
+           maxGain - minGain, passbandEdge, rejection);
+    expect(thdN <= tier.maxThdN, name, "THD+N above the tier's limit");
+    expect(maxGain - minGain <= tier.maxRipple, name, "passband ripple above the tier's limit");
+    expect(!rates.rejection || rejection >= tier.minRejection, name, "stopband or image rejection too low");
+}
+
+/**
+ * Output frame 0 is centred on input frame 0: an impulse at input frame n comes out at n * L / M, the
+ * stream is as long as the input at the new rate, and a constant comes out at the same level
+ */
+void checkTiming(const TierLimits& tier, const RatePair& rates) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s %d->%d timing", Resampler::getQualityName(tier.quality), rates.inputRate,
+             rates.outputRate);
+    Resampler resampler;
+    if (!resampler.prepare(rates.inputRate, rates.outputRate, 1, tier.quality)) {
+        return;
+    }
+    const double ratio = static_cast<double>(rates.outputRate) / rates.inputRate;
+    const int32_t frames = 10000;
+    const int32_t impulseFrame = 4321;
+
+    std::vector<float> input(static_cast<size_t>(frames), 0.0f);
+    input[impulseFrame] = 1.0f;
+    std::vector<float> output = resample(resampler, input, rates.inputRate);
+    size_t peak = static_cast<size_t>(std::max_element(output.begin(), output.end()) - output.begin());
+    double expectedPeak = impulseFrame * ratio;
+    double expectedLength = std::ceil(frames * ratio);
+    expect(std::fabs(static_cast<double>(peak) - expectedPeak) <= 1.0, name, "impulse not aligned to its input time");
+    expect(std::fabs(static_cast<double>(output.size()) - expectedLength) <= 1.0, name, "output length off the ratio");
+
+    resampler.reset();
+    output = resample(resampler, std::vector<float>(static_cast<size_t>(frames), 0.5f), rates.inputRate);
+    double worst = 0.0;
+    for (size_t i = kSettleFrames; i + kSettleFrames < output.size(); i++) {
+        worst = std::max(worst, std::fabs(output[i] - 0.5));
+    }
+    expect(worst < 1e-5, name, "DC gain is not unity");
+
+    // The filter looks half its taps ahead of the output position, the latency it adds to a stream
+    double latencyMs = 1000.0 * (resampler.getTapCount() / 2) / rates.inputRate;
+    if (tier.quality == Resampler::Quality::High && rates.inputRate == 44100) {
+        printf("%-22s impulse at %zu (%.1f), %zu frames, lookahead %.2f ms\n", name, peak, expectedPeak,
+               output.size(), latencyMs);
+    }
+}
+
+// Burst size must not change the output: history, phase and end handling carry over between calls
+void checkChunking(const TierLimits& tier) {
+    const char* name = Resampler::getQualityName(tier.quality);
+    std::vector<float> input = makeSine(997.0, 44100, 20000, 0.7);
+    Resampler whole;
+    Resampler chunked;
+    if (!whole.prepare(44100, 48000, 2, tier.quality) || !chunked.prepare(44100, 48000, 2, tier.quality)) {
+        return;
+    }
+    // Stereo with a different signal per channel, so channels cannot mix
+    std::vector<float> stereo(input.size() * 2);
+    for (size_t i = 0; i < input.size(); i++) {
+        stereo[2 * i] = input[i];
+        stereo[2 * i + 1] = -0.5f * input[(i * 7) % input.size()];
+    }
+    BufferSource wholeSource(stereo, 44100, 2);
+    BufferSource chunkedSource(stereo, 44100, 2);
+
+    std::vector<float> expected(30000 * 2);
+    int32_t expectedFrames = whole.process(expected.data(), 30000, wholeSource);
+    std::vector<float> actual(30000 * 2);
+    int32_t produced = 0;
+    for (int32_t burst = 1; produced < 30000; burst = burst % 997 + 13) {
+        int32_t count = chunked.process(actual.data() + produced * 2, std::min(burst, 30000 - produced),
+                                        chunkedSource);
+        produced += count;
+        if (count < burst) {
+            break;
+        }
+    }
+    expect(produced == expectedFrames && memcmp(expected.data(), actual.data(), sizeof(float) * produced * 2) == 0,
+           name, "chunked output differs from one-shot output");
+}
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// CPU cost of a tier on stereo 44.1k->48k, best of timed blocks of one second of output each
+void measureCost(const TierLimits& tier, int32_t milliseconds) {
+    Resampler resampler;
+    if (!resampler.prepare(44100, 48000, 2, tier.quality)) {
+        return;
+    }
+    std::vector<float> stereo(44100 * 2);
+    for (size_t i = 0; i < stereo.size(); i++) {
+        stereo[i] = static_cast<float>(std::sin(0.01 * i));
+    }
+    std::vector<float> buffer(480 * 2);
+    double best = 1e18;
+    const uint64_t endNs = nowNs() + static_cast<uint64_t>(milliseconds) * 1000000;
+    do {
+        BufferSource source(stereo, 44100, 2);
+        resampler.reset();
+        int32_t frames = 0;
+        uint64_t beginNs = nowNs();
+        for (int32_t produced; (produced = resampler.process(buffer.data(), 480, source)) > 0;) {
+            frames += produced;
+        }
+        best = std::min(best, static_cast<double>(nowNs() - beginNs) / std::max(frames, 1));
+    } while (nowNs() < endNs);
+    printf("%-22s %6.1f ns/frame stereo 44100->48000 (%d taps x %d phases, %s), %.2f%% of a core in realtime\n",
+           Resampler::getQualityName(tier.quality), best, resampler.getTapCount(), resampler.getPhaseCount(),
+           FormatConverter::getIsaName(FormatConverter::getBestIsa()), best * 48000 / 1e7);
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -b            Time the CPU cost per tier for longer\n"
+            "  -v            Keep the resampler's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int32_t costMs = 100;
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-b") == 0) {
+            costMs = 2000;
+        } else if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // prepare() logs every filter it builds
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    for (const TierLimits& tier : kTiers) {
+        for (const RatePair& rates : kRatePairs) {
+            checkQuality(tier, rates);
+            checkTiming(tier, rates);
+        }
+        checkChunking(tier);
+    }
+    for (const TierLimits& tier : kTiers) {
+        measureCost(tier, costMs);
+    }
+
+    if (failures > 0) {
+        printf("resampler_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+/**
+ * Single-producer/single-consumer lock-free byte ring buffer
+ *
+ * One thread may write and one other thread may read concurrently without locks.
+ * Read and write indices grow monotonically and are masked into the storage, so
+ * the capacity is always rounded up to a power of two.
+ */
+class SpscRingBuffer {
+public:
+    /**
+     * Constructor
+     * @param capacity Minimum capacity in bytes (rounded up to a power of two)
+     */
+    explicit SpscRingBuffer(size_t capacity) : capacity_(roundUpToPowerOfTwo(capacity)), mask_(capacity_ - 1) {
+        buffer_.reset(new uint8_t[capacity_]);
+    }
+
+    // Disable copy and assignment
+    SpscRingBuffer(const SpscRingBuffer&) = delete;
+    SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * Get number of bytes that can be read (safe from either side)
+     */
+    size_t availableToRead() const {
+        return writeIndex_.load(std::memory_order_acquire) - readIndex_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Get number of bytes that can be written (safe from either side)
+     */
+    size_t availableToWrite() const { return capacity_ - availableToRead(); }
+
+    /**
+     * Copy data into the ring (producer only)
+     * @param data Source data
+     * @param size Bytes to write
+     * @return Actual bytes written
+     */
+    size_t write(const void* data, size_t size) {
+        uint8_t* first;
+        size_t firstSize;
+        uint8_t* second;
+        size_t secondSize;
+        size_t writable = getWriteRegions(&first, &firstSize, &second, &secondSize);
+        size_t toWrite = std::min(size, writable);
+
+        size_t head = std::min(toWrite, firstSize);
+        memcpy(first, data, head);
+        if (toWrite > head) {
+            memcpy(second, static_cast<const uint8_t*>(data) + head, toWrite - head);
+        }
+        commitWrite(toWrite);
+        return toWrite;
+    }
+
+    /**
+     * Copy data out of the ring (consumer only)
+     * @param data Destination buffer
+     * @param size Bytes to read
+     * @return Actual bytes read
+     */
+    size_t read(void* data, size_t size) {
+        size_t readIndex = readIndex_.load(std::memory_order_relaxed);
+        size_t readable = writeIndex_.load(std::memory_order_acquire) - readIndex;
+        size_t toRead = std::min(size, readable);
+
+        size_t offset = readIndex & mask_;
+        size_t head = std::min(toRead, capacity_ - offset);
+        memcpy(data, buffer_.get() + offset, head);
+        if (toRead > head) {
+            memcpy(static_cast<uint8_t*>(data) + head, buffer_.get(), toRead - head);
+        }
+        readIndex_.store(readIndex + toRead, std::memory_order_release);
+        return toRead;
+    }
+
+    /**
+     * Get the free space as up to two contiguous regions (producer only)
+     * Lets the producer fill the ring in place, then publish with commitWrite().
+     * @return Total writable bytes (firstSize + secondSize)
+     */
+    size_t getWriteRegions(uint8_t** first, size_t* firstSize, uint8_t** second, size_t* secondSize) {
+        size_t writeIndex = writeIndex_.load(std::memory_order_relaxed);
+        size_t writable = capacity_ - (writeIndex - readIndex_.load(std::memory_order_acquire));
+
+        size_t offset = writeIndex & mask_;
+        *first = buffer_.get() + offset;
+        *firstSize = std::min(writable, capacity_ - offset);
+        *second = buffer_.get();
+        *secondSize = writable - *firstSize;
+        return writable;
+    }
+
+    /**
+     * Publish bytes written in place through getWriteRegions() (producer only)
+     */
+    void commitWrite(size_t size) {
+        writeIndex_.store(writeIndex_.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+
+    /**
+     * Get the total number of bytes ever written (safe from either side)
+     */
+    size_t getWritePosition() const { return writeIndex_.load(std::memory_order_acquire); }
+
+    /**
+     * Drop buffered data written before a write position (consumer only)
+     * Lets the consumer flush what the producer wrote up to a point it published.
+     * @param writePosition Earlier result of getWritePosition()
+     * @return Bytes dropped
+     */
+    size_t discardUntil(size_t writePosition) {
+        size_t readIndex = readIndex_.load(std::memory_order_relaxed);
+        size_t stale = writePosition - readIndex;
+        if (stale == 0 || stale > writeIndex_.load(std::memory_order_acquire) - readIndex) {
+            return 0;
+        }
+        readIndex_.store(writePosition, std::memory_order_release);
+        return stale;
+    }
+
+    /**
+     * Drop all buffered data
+     * Only valid while neither side is accessing the ring.
+     */
+    void reset() {
+        writeIndex_.store(0, std::memory_order_relaxed);
+        readIndex_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static size_t roundUpToPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    static constexpr size_t kCacheLineSize = 64;
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<uint8_t[]> buffer_;
+
+    // Producer and consumer indices live on separate cache lines to avoid false sharing
+    char padding0_[kCacheLineSize];
+    std::atomic<size_t> writeIndex_{0};
+    char padding1_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> readIndex_{0};
+    char padding2_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+};
+
+#endif // RING_BUFFER_H
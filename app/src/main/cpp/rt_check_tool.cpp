@@ -0,0 +1,97 @@
+// Host command line front end of RealtimeChecker: plays files through PlayerEngine and fails on any
+// allocation, lock or blocking call made on the audio thread
+#include "player_engine.h"
+#include "realtime_checker.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+static void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] <input file>...\n"
+            "  -t         Pace callbacks to the wall clock and seek and change the gain while playing\n"
+            "  -d <rate>  Device rate, the file is resampled in the callback when it differs\n"
+            "  -s         Use stream reads instead of memory mapping\n"
+            "  -a         Abort at the first violation, e.g. to stop in a debugger\n",
+            program);
+}
+
+// Controls exercised while a paced playback runs
+static constexpr int32_t kControlDelayMs = 100;
+
+/**
+ * Play one file to its end on a RealtimeCheckSink
+ * @param device Simulated device, paced playbacks also get a seek and a gain change
+ * @return Returns false if playback could not start
+ */
+static bool checkFile(const std::string& path, const PlayerConfig& baseConfig, const SimulatedSink::Options& device) {
+    RealtimeCheckSink* sink = nullptr;
+    PlayerEngine engine([&sink, &device]() -> std::unique_ptr<AudioSink> {
+        sink = new RealtimeCheckSink(device);
+        return std::unique_ptr<AudioSink>(sink);
+    });
+    PlayerConfig config = baseConfig;
+    config.audioFilePath = path;
+    engine.setConfig(config);
+
+    if (!engine.start() || !sink) {
+        fprintf(stderr, "%s: cannot start playback\n", path.c_str());
+        return false;
+    }
+    if (device.realtime) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kControlDelayMs));
+        engine.setGain(0.5f);
+        engine.seek(0);
+    }
+    sink->waitUntilFinished();
+    engine.stop();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    PlayerConfig config;
+    SimulatedSink::Options device;
+    device.realtime = false;
+    bool abortOnViolation = false;
+
+    int index = 1;
+    for (; index < argc && argv[index][0] == '-'; index++) {
+        if (strcmp(argv[index], "-t") == 0) {
+            device.realtime = true;
+        } else if (strcmp(argv[index], "-d") == 0 && index + 1 < argc) {
+            device.sampleRate = atoi(argv[++index]);
+            config.resampleToDeviceRate = true;
+        } else if (strcmp(argv[index], "-s") == 0) {
+            config.ioMode = AudioFile::IoMode::Stream;
+        } else if (strcmp(argv[index], "-a") == 0) {
+            abortOnViolation = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (index == argc) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    RealtimeChecker::enable(abortOnViolation);
+    int32_t failed = 0;
+    for (; index < argc; index++) {
+        uint64_t before = RealtimeChecker::getViolationCount();
+        bool played = checkFile(argv[index], config, device);
+        uint64_t violations = RealtimeChecker::getViolationCount() - before;
+        printf("%s: %s, %llu violations\n", argv[index], played ? "played" : "not played",
+               static_cast<unsigned long long>(violations));
+        if (!played || violations > 0) {
+            failed++;
+        }
+    }
+    RealtimeChecker::disable();
+
+    RealtimeChecker::printReport(stdout);
+    return failed == 0 ? 0 : 1;
+}
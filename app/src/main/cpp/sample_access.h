@@ -0,0 +1,129 @@
+#ifndef SAMPLE_ACCESS_H
+#define SAMPLE_ACCESS_H
+
+#include "audio_format.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Sample access for the kernels that work on PCM in its own format (DSP chain, level meter, peak index,
+ * format converter), and the lane layout their per-channel reductions share
+ *
+ * The format structs are template arguments: a kernel instantiated for one of them loads and stores
+ * samples with the format fixed at compile time. Samples are floats in [-1, 1); index counts samples,
+ * not bytes.
+ */
+
+// Full scale of each integer format, as float
+constexpr float kScaleU8 = 128.0f;
+constexpr float kScaleI16 = 32768.0f;
+constexpr float kScaleI32 = 2147483648.0f;
+
+// Largest float below 2^31, anything above overflows the int32 conversion
+constexpr float kMaxI32AsFloat = 2147483520.0f;
+
+// File only, offset binary
+struct U8Format {
+    static float load(const void* data, int32_t index) {
+        return (static_cast<float>(static_cast<const uint8_t*>(data)[index]) - kScaleU8) * (1.0f / kScaleU8);
+    }
+};
+
+// No lrint() in the stores below: it keeps compilers from vectorizing the loops
+struct I16Format {
+    static float load(const void* data, int32_t index) {
+        return static_cast<float>(static_cast<const int16_t*>(data)[index]) * (1.0f / kScaleI16);
+    }
+    static void store(void* data, int32_t index, float value) {
+        // Offset into the positive range so truncation rounds to nearest
+        float v = std::min(std::max(value * kScaleI16, -kScaleI16), kScaleI16 - 1.0f) + (kScaleI16 + 0.5f);
+        static_cast<int16_t*>(data)[index] = static_cast<int16_t>(static_cast<int32_t>(v) - 32768);
+    }
+};
+
+inline int32_t readI24(const uint8_t* p) {
+    return static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 |
+                                static_cast<uint32_t>(p[2]) << 24);
+}
+
+struct I24PackedFormat {
+    static float load(const void* data, int32_t index) {
+        auto p = static_cast<const uint8_t*>(data) + static_cast<size_t>(index) * 3;
+        return static_cast<float>(readI24(p)) * (1.0f / kScaleI32);
+    }
+    static void store(void* data, int32_t index, float value) {
+        float v = std::min(std::max(value * 8388608.0f, -8388608.0f), 8388607.0f);
+        auto sample = static_cast<int32_t>(v + (v >= 0.0f ? 0.5f : -0.5f));
+        auto p = static_cast<uint8_t*>(data) + static_cast<size_t>(index) * 3;
+        p[0] = static_cast<uint8_t>(sample);
+        p[1] = static_cast<uint8_t>(sample >> 8);
+        p[2] = static_cast<uint8_t>(sample >> 16);
+    }
+};
+
+struct I32Format {
+    static float load(const void* data, int32_t index) {
+        return static_cast<float>(static_cast<const int32_t*>(data)[index]) * (1.0f / kScaleI32);
+    }
+    static void store(void* data, int32_t index, float value) {
+        // Float carries 24 bits, truncating costs less than one 32-bit LSB
+        float v = std::min(std::max(value * kScaleI32, -kScaleI32), kMaxI32AsFloat);
+        static_cast<int32_t*>(data)[index] = static_cast<int32_t>(v);
+    }
+};
+
+struct FloatFormat {
+    static float load(const void* data, int32_t index) { return static_cast<const float*>(data)[index]; }
+    static void store(void* data, int32_t index, float value) { static_cast<float*>(data)[index] = value; }
+};
+
+// Frames per block of reduceChannels() on a fixed layout: Channels * kLaneBlockFrames independent lanes
+constexpr int32_t kLaneBlockFrames = 8;
+
+/**
+ * Reduce numFrames interleaved frames into one accumulator per channel
+ *
+ * Channels > 0 fixes the channel count at compile time. The fixed layouts keep one accumulator per sample
+ * of a block of kLaneBlockFrames frames; every lane stays on one channel and is independent of the others,
+ * so the block loop vectorizes without reassociating float sums. The lanes are folded into their channels
+ * at the end. Generic layouts, and the frames after the last whole block, accumulate into the channels
+ * directly. Reducer provides:
+ *   Lanes<N>                         Accumulators of N lanes, members are arrays indexed by lane
+ *   void add(Lanes<N>&, int32_t lane, float sample) const
+ *   void fold(const Lanes<N>&, int32_t lane, ChannelState&, int32_t channel) const
+ * and addToChannel(ChannelState&, int32_t channel, float sample) const for the direct path.
+ * @param channels Accumulators of the channels, updated
+ */
+template <typename Format, int32_t Channels, typename Reducer, typename ChannelState>
+void reduceChannels(const void* data,
+                    int32_t numFrames,
+                    int32_t channelCount,
+                    const Reducer& reducer,
+                    ChannelState& channels) {
+    const int32_t stride = Channels > 0 ? Channels : channelCount;
+    int32_t frame = 0;
+
+    if (Channels > 0) {
+        constexpr int32_t kLanes = kLaneBlockFrames * (Channels > 0 ? Channels : 1);
+        typename Reducer::template Lanes<kLanes> lanes;
+        for (; frame + kLaneBlockFrames <= numFrames; frame += kLaneBlockFrames) {
+            const int32_t base = frame * Channels;
+            for (int32_t lane = 0; lane < kLanes; lane++) {
+                reducer.add(lanes, lane, Format::load(data, base + lane));
+            }
+        }
+        for (int32_t lane = 0; lane < kLanes; lane++) {
+            reducer.fold(lanes, lane, channels, lane % Channels);
+        }
+    }
+
+    for (; frame < numFrames; frame++) {
+        const int32_t base = frame * stride;
+        for (int32_t channel = 0; channel < stride; channel++) {
+            reducer.addToChannel(channels, channel, Format::load(data, base + channel));
+        }
+    }
+}
+
+#endif // SAMPLE_ACCESS_H
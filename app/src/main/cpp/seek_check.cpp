@@ -0,0 +1,417 @@
+// Host check of PlayerEngine::seek() on SimulatedSink, with the file streamed, memory mapped and played from the clip
+// cache. The file is ramp coded: every frame carries its own index, so each output frame tells where in the file it
+// came from. Seeks are posted from the device callback at fixed stream frames, forwards, backwards, retargeted while
+// fading out and while fading in or refilling, and to the end of the file. Every output frame is compared with the
+// seek states: the program until the callback taking the seek, the fade out, silence while refilling, the fade in
+// starting on the target frame, then the program bit-exact from the target on. Reports the seek latency percentiles.
+#include "player_engine.h"
+#include "simulated_sink.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+bool expect(bool condition, const char* caseName, const char* what) {
+    if (!condition) {
+        printf("seek_check: %s: %s\n", caseName, what);
+        failures++;
+    }
+    return condition;
+}
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int64_t kFileFrames = 3 * kSampleRate;
+constexpr int32_t kBurstFrames = 192;
+
+// PlayerEngine fades 5 ms out and in around a seek
+constexpr int32_t kFadeFrames = kSampleRate * 5 / 1000;
+
+/**
+ * Sample of a frame of the ramp-coded stereo i16 file: 14 bits of the index per channel, bit 14 set so no frame is
+ * near silence
+ */
+int16_t codeOf(int64_t frame, int32_t channel) {
+    return static_cast<int16_t>(0x4000 | ((frame >> (14 * channel)) & 0x3FFF));
+}
+
+bool writeRampWave(const std::string& path) {
+    const auto dataBytes = static_cast<uint32_t>(kFileFrames * 4);
+    std::string data;
+    auto putLe = [&data](uint32_t value, int32_t bytes) {
+        for (int32_t i = 0; i < bytes; i++) {
+            data.push_back(static_cast<char>(value >> (8 * i)));
+        }
+    };
+    data.append("RIFF", 4);
+    putLe(36 + dataBytes, 4);
+    data.append("WAVEfmt ", 8);
+    putLe(16, 4);
+    putLe(1, 2);
+    putLe(2, 2);
+    putLe(kSampleRate, 4);
+    putLe(kSampleRate * 4, 4);
+    putLe(4, 2);
+    putLe(16, 2);
+    data.append("data", 4);
+    putLe(dataBytes, 4);
+    for (int64_t frame = 0; frame < kFileFrames; frame++) {
+        putLe(static_cast<uint16_t>(codeOf(frame, 0)), 2);
+        putLe(static_cast<uint16_t>(codeOf(frame, 1)), 2);
+    }
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return file.good();
+}
+
+/**
+ * seek(target) posted right before the callback starting at stream frame streamFrame
+ */
+struct SeekAction {
+    int64_t streamFrame;
+    int64_t target;
+};
+
+// Callback starts, a burst apart
+const SeekAction kScript[] = {
+    {50 * kBurstFrames, 100000}, // Forwards
+    {150 * kBurstFrames, 20000}, // Backwards
+    // Retargeted while fading out, the fade is longer than a burst
+    {250 * kBurstFrames, 60000},
+    {251 * kBurstFrames, 5000},
+    // Retargeted two bursts in: fading in when the file is in memory, refilling or fading in when streamed
+    {350 * kBurstFrames, 90000},
+    {352 * kBurstFrames, 30000},
+    // To the last 0.1 s, the file ends on its last frame
+    {450 * kBurstFrames, kFileFrames - kSampleRate / 10},
+};
+
+/**
+ * Simulated device recording the stream and posting the script's seeks from its callback
+ */
+class CapturingSink : public SimulatedSink {
+public:
+    CapturingSink(const Options& options, PlayerEngine** engine, std::vector<int16_t>* output)
+        : SimulatedSink(options), engine_(engine), output_(output) {}
+
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override {
+        dataCallback_ = dataCallback;
+        userData_ = userData;
+        return SimulatedSink::open(config, capture, errorCallback, this);
+    }
+
+private:
+    static CallbackResult capture(void* userData, void* audioData, int32_t numFrames) {
+        auto sink = static_cast<CapturingSink*>(userData);
+        const auto streamFrame = static_cast<int64_t>(sink->output_->size() / 2);
+        while (sink->nextAction_ < sizeof(kScript) / sizeof(kScript[0]) &&
+               kScript[sink->nextAction_].streamFrame <= streamFrame) {
+            (*sink->engine_)->seek(kScript[sink->nextAction_++].target);
+        }
+        CallbackResult result = sink->dataCallback_(sink->userData_, audioData, numFrames);
+        auto samples = static_cast<const int16_t*>(audioData);
+        sink->output_->insert(sink->output_->end(), samples, samples + static_cast<size_t>(numFrames) * 2);
+        return result;
+    }
+
+    PlayerEngine** engine_;
+    std::vector<int16_t>* output_;
+    DataCallback dataCallback_ = nullptr;
+    void* userData_ = nullptr;
+    size_t nextAction_ = 0;
+};
+
+/**
+ * What the output showed
+ */
+struct SeekTrace {
+    std::vector<int64_t> fadeInTargets; // File frame each fade in started on
+    int32_t retargetsFadingOut = 0;
+    int32_t retargetsFadingIn = 0;
+    int32_t retargetsRefilling = 0;
+    int64_t refillFrames = 0;    // Silence between fade out and fade in
+    int64_t underflowFrames = 0; // Silence while the streamed file had no data yet
+    int64_t endFrame = -1;       // Stream frame after the last frame of the file
+};
+
+/**
+ * Walk the output through the engine's seek states
+ *
+ * Idle plays the file at unity; a seek taken at a callback start fades out over kFadeFrames from one step below
+ * unity down to silence, refills in silence and fades back in from silence on the target frame. A seek while fading
+ * in fades out from the gain reached, while refilling it only moves the target. Silence where the file was expected
+ * is an underflow of the streamed file, the position does not advance (fades count it as faded).
+ */
+bool walkSeeks(const char* name, const std::vector<int16_t>& output, SeekTrace* trace) {
+    enum class State { Idle, FadeOut, Refill, FadeIn };
+    State state = State::Idle;
+    int64_t position = 0;
+    int64_t target = 0;
+    int32_t remaining = 0;
+    size_t nextAction = 0;
+    const float step = 1.0f / static_cast<float>(kFadeFrames);
+    const auto frames = static_cast<int64_t>(output.size() / 2);
+    char what[192];
+
+    auto silent = [&output](int64_t frame) { return output[frame * 2] == 0 && output[frame * 2 + 1] == 0; };
+    auto matches = [&output](int64_t frame, int64_t fileFrame, float gain) {
+        for (int32_t channel = 0; channel < 2; channel++) {
+            // The fades run in float, one LSB of rounding
+            if (std::fabs(output[frame * 2 + channel] - gain * static_cast<float>(codeOf(fileFrame, channel))) >
+                1.0f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (int64_t frame = 0; frame < frames; frame++) {
+        if (nextAction < sizeof(kScript) / sizeof(kScript[0]) && kScript[nextAction].streamFrame == frame) {
+            target = kScript[nextAction++].target;
+            switch (state) {
+            case State::Idle:
+                state = State::FadeOut;
+                remaining = kFadeFrames;
+                break;
+            case State::FadeIn:
+                trace->retargetsFadingIn++;
+                state = State::FadeOut;
+                remaining = std::max(kFadeFrames - remaining, 1);
+                break;
+            case State::Refill:
+                trace->retargetsRefilling++;
+                position = target;
+                break;
+            case State::FadeOut:
+                trace->retargetsFadingOut++;
+                break;
+            }
+        }
+
+        const char* expected = "";
+        switch (state) {
+        case State::Idle:
+            if (position >= kFileFrames) {
+                trace->endFrame = trace->endFrame < 0 ? frame : trace->endFrame;
+                if (!silent(frame)) {
+                    expected = "silence after the end of the file";
+                }
+            } else if (output[frame * 2] == codeOf(position, 0) && output[frame * 2 + 1] == codeOf(position, 1)) {
+                position++;
+                trace->endFrame = position == kFileFrames ? frame + 1 : trace->endFrame;
+            } else if (silent(frame)) {
+                trace->underflowFrames++;
+            } else {
+                expected = "the file at unity";
+            }
+            break;
+        case State::FadeOut:
+            if (matches(frame, position, static_cast<float>(remaining - 1) * step)) {
+                position++;
+            } else if (silent(frame)) {
+                trace->underflowFrames++;
+            } else {
+                expected = "the fade out";
+            }
+            if (--remaining == 0) {
+                state = State::Refill;
+                position = target;
+            }
+            break;
+        case State::Refill:
+            // The fade in starts silent on the target frame, the next one is the first audible
+            if (!silent(frame)) {
+                expected = "silence while refilling";
+            } else if (frame + 1 < frames && !silent(frame + 1) && matches(frame + 1, target + 1, step)) {
+                state = State::FadeIn;
+                remaining = kFadeFrames - 1;
+                position = target + 1;
+                trace->fadeInTargets.push_back(target);
+            } else {
+                trace->refillFrames++;
+            }
+            break;
+        case State::FadeIn:
+            if (matches(frame, position, static_cast<float>(kFadeFrames - remaining) * step)) {
+                position++;
+                if (--remaining == 0) {
+                    state = State::Idle;
+                }
+            } else if (silent(frame)) {
+                trace->underflowFrames++;
+            } else {
+                expected = "the fade in";
+            }
+            break;
+        }
+        if (*expected) {
+            snprintf(what, sizeof(what),
+                     "stream frame %" PRId64 " is %d/%d, expected %s of file frame %" PRId64 " (%d fade frames left)",
+                     frame, output[frame * 2], output[frame * 2 + 1], expected, position, remaining);
+            return expect(false, name, what);
+        }
+    }
+    return expect(state == State::Idle && trace->endFrame >= 0, name, "the file did not play to its end");
+}
+
+struct SeekMode {
+    const char* name;
+    AudioFile::IoMode ioMode;
+    bool clip;
+    // Callbacks at the wall-clock rate: unpaced, the device plays through a streamed refill in no time
+    bool paced;
+};
+
+const SeekMode kModes[] = {
+    {"streamed", AudioFile::IoMode::Stream, false, true},
+    {"memory mapped", AudioFile::IoMode::MemoryMap, false, false},
+    {"clip cache", AudioFile::IoMode::MemoryMap, true, false},
+};
+
+void checkSeeks(const SeekMode& mode, const std::string& path) {
+    const char* name = mode.name;
+    SimulatedSink::Options device;
+    device.framesPerBurst = kBurstFrames;
+    device.realtime = mode.paced;
+    PlayerEngine* enginePointer = nullptr;
+    std::vector<int16_t> output;
+    output.reserve(static_cast<size_t>(kFileFrames) * 2 * 2);
+    CapturingSink* sink = nullptr;
+    PlayerEngine engine([&]() -> std::unique_ptr<AudioSink> {
+        sink = new CapturingSink(device, &enginePointer, &output);
+        return std::unique_ptr<AudioSink>(sink);
+    });
+    enginePointer = &engine;
+    if (!mode.clip) {
+        engine.setClipCacheLimits(0, 0);
+    }
+    PlayerConfig config;
+    config.audioFilePath = path;
+    config.ioMode = mode.ioMode;
+    config.dsp.startFadeMs = 0;
+    // Fades go through float, undithered they round to the nearest LSB
+    config.dither = false;
+    engine.setConfig(config);
+    if (!expect(engine.start() && sink, name, "cannot start playback")) {
+        return;
+    }
+    sink->waitUntilFinished();
+    const int64_t endFrame = engine.getEndFrame();
+    const LogLinearHistogram::Summary latency = engine.getSeekLatency();
+    const ClipCache::Stats clipStats = engine.getClipCacheStats();
+    const bool stereoI16 = sink->getFormat() == SampleFormat::I16 && sink->getChannelCount() == 2;
+    engine.stop();
+
+    SeekTrace trace;
+    if (!expect(stereoI16, name, "stream is not stereo i16") ||
+        !expect(mode.clip ? clipStats.misses + clipStats.hits == 1 : clipStats.bypasses > 0, name,
+                mode.clip ? "file not played from the clip cache" : "file played from the clip cache") ||
+        !walkSeeks(name, output, &trace)) {
+        return;
+    }
+
+    // Every seek that was not retargeted before its fade in, in order
+    std::vector<int64_t> expectedTargets = {100000, 20000, 5000, 90000, 30000, kFileFrames - kSampleRate / 10};
+    if (trace.retargetsFadingIn == 0) {
+        expectedTargets.erase(expectedTargets.begin() + 3);
+    }
+    char what[224];
+    snprintf(what, sizeof(what),
+             "%zu fade ins (first at %" PRId64 "), %" PRIu64 " seek latencies, %d retargets fading out, %" PRId64
+             " stream frames, %" PRId64 " refill and %" PRId64 " underflow frames",
+             trace.fadeInTargets.size(), trace.fadeInTargets.empty() ? -1 : trace.fadeInTargets[0], latency.count,
+             trace.retargetsFadingOut, static_cast<int64_t>(output.size() / 2), trace.refillFrames,
+             trace.underflowFrames);
+    if (!expect(trace.fadeInTargets == expectedTargets && latency.count == expectedTargets.size() &&
+                    trace.retargetsFadingOut == 1 && trace.retargetsFadingIn + trace.retargetsRefilling == 1,
+                name, what)) {
+        return;
+    }
+    // From memory the fade in follows the fade out at once, streamed the refill waits for the reader thread
+    if (!expect((mode.ioMode == AudioFile::IoMode::Stream && !mode.clip) ||
+                    (trace.retargetsFadingIn == 1 && trace.refillFrames == 0 && trace.underflowFrames == 0),
+                name, "refilled from memory with silence")) {
+        return;
+    }
+    snprintf(what, sizeof(what), "file ended on stream frame %" PRId64 ", engine reports %" PRId64, trace.endFrame,
+             endFrame);
+    if (!expect(endFrame == trace.endFrame, name, what)) {
+        return;
+    }
+    printf("%-14s %zu seeks, retargeted %s, %6" PRId64 " refill frames, latency p50 %6.1f us p99 %6.1f us "
+           "max %6.1f us: ok\n",
+           name, trace.fadeInTargets.size(), trace.retargetsFadingIn ? "fading in" : "refilling", trace.refillFrames,
+           static_cast<double>(latency.p50) / 1000.0, static_cast<double>(latency.p99) / 1000.0,
+           static_cast<double>(latency.max) / 1000.0);
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -v            Keep the engines' log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool verbose = false;
+    for (int index = 1; index < argc; index++) {
+        if (strcmp(argv[index], "-v") == 0) {
+            verbose = true;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    // Every engine logs its stream setup
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    const char* tmp = getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/aaudioplayer-seek-XXXXXX";
+    std::vector<char> dirName(pattern.begin(), pattern.end());
+    dirName.push_back('\0');
+    if (!mkdtemp(dirName.data())) {
+        printf("seek_check: cannot create %s\n", pattern.c_str());
+        return 1;
+    }
+    const std::string path = std::string(dirName.data()) + "/ramp.wav";
+    if (!writeRampWave(path)) {
+        printf("seek_check: cannot write %s\n", path.c_str());
+        failures++;
+    }
+
+    if (failures == 0) {
+        for (const SeekMode& mode : kModes) {
+            checkSeeks(mode, path);
+        }
+    }
+
+    unlink(path.c_str());
+    rmdir(dirName.data());
+    if (failures > 0) {
+        printf("seek_check: %d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
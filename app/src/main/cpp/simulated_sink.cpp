@@ -0,0 +1,242 @@
+#include "simulated_sink.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <pthread.h>
+
+SimulatedSink::SimulatedSink() : SimulatedSink(Options()) {}
+
+SimulatedSink::SimulatedSink(const Options& options) : options_(options) {
+    options_.framesPerBurst = std::max(options_.framesPerBurst, 1);
+    options_.bufferCapacityBursts = std::max(options_.bufferCapacityBursts, 1);
+}
+
+SimulatedSink::~SimulatedSink() {
+    // Destroyed from its own callback, the driver thread would run on in freed memory
+    if (isDriverThread()) {
+        LOGE("Simulated sink destroyed on its driver thread");
+        std::terminate();
+    }
+    close();
+}
+
+bool SimulatedSink::open(const AudioSinkConfig& config,
+                         DataCallback dataCallback,
+                         ErrorCallback errorCallback,
+                         void* userData) {
+    close();
+
+    // Reopened from its own callback, the driver thread still holds the burst buffer
+    if (isDriverThread()) {
+        LOGE("Simulated sink: cannot reopen from the data callback");
+        return false;
+    }
+    if (!dataCallback || config.channelCount < 0) {
+        return false;
+    }
+
+    dataCallback_ = dataCallback;
+    errorCallback_ = errorCallback;
+    userData_ = userData;
+
+    // Options.sampleRate plays the device's native rate
+    sampleRate_ = options_.sampleRate > 0 ? options_.sampleRate : config.sampleRate;
+    if (sampleRate_ <= 0) {
+        sampleRate_ = kDefaultSampleRate;
+    }
+    channelCount_ = options_.channelCount > 0 ? options_.channelCount : config.channelCount;
+    if (channelCount_ <= 0) {
+        channelCount_ = kDefaultChannelCount;
+    }
+    format_ = options_.format != SampleFormat::Unspecified ? options_.format : config.format;
+    if (sampleRate_ <= 0 || getBytesPerSample(format_) == 0) {
+        LOGE("Simulated sink: unsupported rate %d or format %d", sampleRate_, static_cast<int32_t>(format_));
+        return false;
+    }
+
+    if (options_.openDelayUs > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(options_.openDelayUs));
+    }
+
+    // Same sizing policy as the AAudio backend: 2 bursts for low latency, 4 otherwise
+    bufferCapacity_ = options_.framesPerBurst * options_.bufferCapacityBursts;
+    bufferSize_.store(std::min(options_.framesPerBurst * (config.isLowLatency() ? 2 : 4), bufferCapacity_));
+
+    size_t burstBytes = static_cast<size_t>(options_.framesPerBurst) * channelCount_ * getBytesPerSample(format_);
+    burstBuffer_.reset(new uint8_t[burstBytes]());
+
+    open_ = true;
+    LOGI("Simulated stream created: %dHz, %dch, format=%d, burst=%d, realtime=%d", sampleRate_, channelCount_,
+         static_cast<int32_t>(format_), options_.framesPerBurst, options_.realtime ? 1 : 0);
+    return true;
+}
+
+bool SimulatedSink::start() {
+    if (!open_ || thread_.joinable()) {
+        return false;
+    }
+
+    callbackCount_.store(0);
+    framesRendered_.store(0);
+    totalCallbackNs_.store(0);
+    maxCallbackNs_.store(0);
+    deadlineMisses_.store(0);
+    xruns_.store(0);
+    startNs_.store(nowNs());
+    endNs_.store(0);
+    timestampNs_.store(0);
+    randomState_ = options_.jitterSeed ? options_.jitterSeed : 1;
+
+    running_.store(true);
+    thread_ = std::thread(&SimulatedSink::driverLoop, this);
+    return true;
+}
+
+bool SimulatedSink::stop() {
+    running_.store(false);
+    // A callback may stop its own stream, never join from the driver thread
+    if (!isDriverThread() && thread_.joinable()) {
+        thread_.join();
+    }
+    return true;
+}
+
+void SimulatedSink::close() {
+    stop();
+    open_ = false;
+    // Called from a callback: the driver thread is still inside it, writing to the burst buffer, and touches the
+    // sink until its loop exits. Keep both; the next open(), close() or the destructor on another thread joins it.
+    if (isDriverThread()) {
+        return;
+    }
+    burstBuffer_.reset();
+}
+
+int32_t SimulatedSink::setBufferSizeInFrames(int32_t numFrames) {
+    int32_t size = std::min(std::max(numFrames, options_.framesPerBurst), bufferCapacity_);
+    bufferSize_.store(size, std::memory_order_relaxed);
+    return size;
+}
+
+bool SimulatedSink::getTimestamp(int64_t* framePosition, int64_t* timeNs) const {
+    // Retry if the driver thread updated the pair in between
+    for (;;) {
+        int64_t time = timestampNs_.load(std::memory_order_acquire);
+        int64_t frame = timestampFrame_.load(std::memory_order_acquire);
+        if (time == 0 || !running_.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (timestampNs_.load(std::memory_order_acquire) == time) {
+            *framePosition = frame;
+            *timeNs = time;
+            return true;
+        }
+    }
+}
+
+void SimulatedSink::waitUntilFinished() {
+    if (!isDriverThread() && thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+SimulatedSink::Stats SimulatedSink::getStats() const {
+    Stats stats;
+    stats.callbackCount = callbackCount_.load(std::memory_order_relaxed);
+    stats.framesRendered = framesRendered_.load(std::memory_order_relaxed);
+    stats.totalCallbackNs = totalCallbackNs_.load(std::memory_order_relaxed);
+    stats.maxCallbackNs = maxCallbackNs_.load(std::memory_order_relaxed);
+    stats.deadlineMisses = deadlineMisses_.load(std::memory_order_relaxed);
+    stats.xruns = xruns_.load(std::memory_order_relaxed);
+    uint64_t end = endNs_.load(std::memory_order_relaxed);
+    stats.elapsedNs = (end ? end : nowNs()) - startNs_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void SimulatedSink::driverLoop() {
+    pthread_setname_np(pthread_self(), "aap-simdevice");
+    driverThreadId_.store(std::this_thread::get_id());
+
+    const int32_t burst = options_.framesPerBurst;
+    const uint64_t periodNs = static_cast<uint64_t>(burst) * 1000000000ULL / static_cast<uint64_t>(sampleRate_);
+    uint64_t nextWakeNs = nowNs();
+
+    while (running_.load(std::memory_order_relaxed)) {
+        if (options_.realtime) {
+            std::this_thread::sleep_until(
+                std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nextWakeNs)));
+        }
+
+        // Injected scheduling delay, e.g. preemption of the audio thread
+        uint64_t jitterNs = 0;
+        if (options_.jitterMaxUs > 0 && static_cast<int32_t>(nextRandom() % 100) < options_.jitterPercent) {
+            jitterNs = static_cast<uint64_t>(nextRandom() % (static_cast<uint32_t>(options_.jitterMaxUs) + 1)) * 1000;
+            if (options_.realtime) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(jitterNs));
+            }
+        }
+
+        uint64_t begin = nowNs();
+        CallbackResult result = dataCallback_(userData_, burstBuffer_.get(), burst);
+        uint64_t end = nowNs();
+        uint64_t cost = end - begin;
+
+        // How late the burst was delivered relative to its wake-up time
+        uint64_t lateness = options_.realtime ? (end > nextWakeNs ? end - nextWakeNs : 0) : jitterNs + cost;
+        uint64_t bufferNs = static_cast<uint64_t>(bufferSize_.load(std::memory_order_relaxed)) * 1000000000ULL /
+                            static_cast<uint64_t>(sampleRate_);
+
+        callbackCount_.fetch_add(1, std::memory_order_relaxed);
+        uint64_t frames = framesRendered_.fetch_add(burst, std::memory_order_relaxed) + burst;
+        totalCallbackNs_.fetch_add(cost, std::memory_order_relaxed);
+        if (cost > maxCallbackNs_.load(std::memory_order_relaxed)) {
+            maxCallbackNs_.store(cost, std::memory_order_relaxed);
+        }
+        if (lateness > periodNs) {
+            deadlineMisses_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // The burst just written plays after what is already queued: the frame one buffer behind it plays now
+        int64_t presented = static_cast<int64_t>(frames) - bufferSize_.load(std::memory_order_relaxed);
+        if (presented > 0) {
+            uint64_t elapsed = end - startNs_.load(std::memory_order_relaxed);
+            uint64_t deviceElapsed = static_cast<uint64_t>(static_cast<double>(elapsed) * 1e6 /
+                                                           (1e6 + static_cast<double>(options_.clockDriftPpm)));
+            timestampNs_.store(0, std::memory_order_release);
+            timestampFrame_.store(presented, std::memory_order_release);
+            timestampNs_.store(static_cast<int64_t>(startNs_.load(std::memory_order_relaxed) + deviceElapsed),
+                               std::memory_order_release);
+        }
+
+        nextWakeNs += periodNs;
+        if (lateness > bufferNs) {
+            // The device buffer ran dry: count an underrun and restart the clock like a real device
+            xruns_.fetch_add(1, std::memory_order_relaxed);
+            nextWakeNs = end + periodNs;
+        }
+
+        if (result == CallbackResult::Stop ||
+            (options_.maxFrames > 0 && static_cast<int64_t>(frames) >= options_.maxFrames)) {
+            break;
+        }
+    }
+
+    endNs_.store(nowNs(), std::memory_order_relaxed);
+    running_.store(false);
+    driverThreadId_.store(std::thread::id());
+}
+
+uint32_t SimulatedSink::nextRandom() {
+    // xorshift32, deterministic for a given seed
+    randomState_ ^= randomState_ << 13;
+    randomState_ ^= randomState_ >> 17;
+    randomState_ ^= randomState_ << 5;
+    return randomState_;
+}
+
+uint64_t SimulatedSink::nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
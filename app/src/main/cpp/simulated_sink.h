@@ -0,0 +1,138 @@
+#ifndef SIMULATED_SINK_H
+#define SIMULATED_SINK_H
+
+#include "audio_sink.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/**
+ * Host-side simulated output device
+ *
+ * A driver thread calls the data callback once per burst from a virtual
+ * clock, optionally paced to the wall clock and with injected scheduling
+ * jitter. It measures callback cost, deadline misses and throughput, and
+ * models underruns against the configured buffer size, so the player
+ * pipeline can be exercised and benchmarked without audio hardware.
+ */
+class SimulatedSink : public AudioSink {
+public:
+    static constexpr int32_t kDefaultSampleRate = 48000;
+    static constexpr int32_t kDefaultChannelCount = 2;
+
+    struct Options {
+        int32_t framesPerBurst = 192;
+        int32_t sampleRate = 0;                   // 0 grants the requested rate (48kHz if unspecified)
+        int32_t channelCount = 0;                 // 0 grants the requested count (stereo if unspecified)
+        SampleFormat format = SampleFormat::Unspecified; // Unspecified grants the requested format
+        int32_t bufferCapacityBursts = 8;
+        bool realtime = true;       // Pace callbacks to the wall clock, otherwise run as fast as possible
+        int32_t jitterMaxUs = 0;    // Maximum injected wake-up delay per callback
+        int32_t jitterPercent = 0;  // Share of callbacks that get a delay
+        uint32_t jitterSeed = 1;    // Seed for reproducible jitter
+        int64_t maxFrames = 0;      // Stop after this many frames, 0 for no limit
+        int32_t openDelayUs = 0;    // Simulated stream creation cost of open()
+        int32_t clockDriftPpm = 0;  // Device clock error seen in timestamps, positive runs fast
+    };
+
+    struct Stats {
+        uint64_t callbackCount = 0;
+        uint64_t framesRendered = 0;
+        uint64_t totalCallbackNs = 0;
+        uint64_t maxCallbackNs = 0;
+        uint64_t deadlineMisses = 0; // Callbacks finishing later than one burst after their wake-up time
+        uint64_t xruns = 0;          // Callbacks finishing after the device buffer would have run dry
+        uint64_t elapsedNs = 0;      // Wall time since start
+    };
+
+    SimulatedSink();
+    explicit SimulatedSink(const Options& options);
+
+    /**
+     * Destructor, joins the driver thread; must not run on it (from a callback)
+     */
+    ~SimulatedSink() override;
+
+    // Disable copy and assignment
+    SimulatedSink(const SimulatedSink&) = delete;
+    SimulatedSink& operator=(const SimulatedSink&) = delete;
+
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override;
+    bool start() override;
+    bool stop() override;
+    /**
+     * Stop and release the stream
+     * From a callback the driver thread cannot be joined: it and its burst buffer are released by the next
+     * open(), close() or the destructor on another thread instead.
+     */
+    void close() override;
+    bool isOpen() const override { return open_; }
+
+    int32_t getSampleRate() const override { return sampleRate_; }
+    int32_t getChannelCount() const override { return channelCount_; }
+    SampleFormat getFormat() const override { return format_; }
+    int32_t getFramesPerBurst() const override { return options_.framesPerBurst; }
+    int32_t getBufferSizeInFrames() const override { return bufferSize_.load(std::memory_order_relaxed); }
+    int32_t getBufferCapacityInFrames() const override { return bufferCapacity_; }
+    int32_t setBufferSizeInFrames(int32_t numFrames) override;
+    int32_t getXRunCount() const override { return static_cast<int32_t>(xruns_.load(std::memory_order_relaxed)); }
+    int64_t getFramesWritten() const override {
+        return static_cast<int64_t>(framesRendered_.load(std::memory_order_relaxed));
+    }
+    bool getTimestamp(int64_t* framePosition, int64_t* timeNs) const override;
+    const char* convertErrorToText(int32_t /*error*/) const override { return "simulated error"; }
+    const char* getName() const override { return "Simulated"; }
+
+    /**
+     * Wait until the driver thread has exited (callback returned Stop or maxFrames reached)
+     */
+    void waitUntilFinished();
+
+    /**
+     * Get driver statistics, safe while running
+     */
+    Stats getStats() const;
+
+private:
+    void driverLoop();
+    bool isDriverThread() const { return driverThreadId_.load() == std::this_thread::get_id(); }
+    uint32_t nextRandom();
+    static uint64_t nowNs();
+
+    Options options_;
+    bool open_ = false;
+    int32_t sampleRate_ = 0;
+    int32_t channelCount_ = 0;
+    SampleFormat format_ = SampleFormat::Unspecified;
+    int32_t bufferCapacity_ = 0;
+    std::atomic<int32_t> bufferSize_{0};
+
+    DataCallback dataCallback_ = nullptr;
+    ErrorCallback errorCallback_ = nullptr;
+    void* userData_ = nullptr;
+
+    std::unique_ptr<uint8_t[]> burstBuffer_;
+    std::thread thread_;
+    std::atomic<std::thread::id> driverThreadId_{}; // Set by the driver thread while it runs its loop
+    std::atomic<bool> running_{false};
+    uint32_t randomState_ = 1;
+
+    std::atomic<uint64_t> callbackCount_{0};
+    std::atomic<uint64_t> framesRendered_{0};
+    std::atomic<uint64_t> totalCallbackNs_{0};
+    std::atomic<uint64_t> maxCallbackNs_{0};
+    std::atomic<uint64_t> deadlineMisses_{0};
+    std::atomic<uint64_t> xruns_{0};
+    std::atomic<uint64_t> startNs_{0};
+    std::atomic<uint64_t> endNs_{0};
+
+    // Last presentation timestamp, written by the driver thread after each callback
+    std::atomic<int64_t> timestampFrame_{0};
+    std::atomic<int64_t> timestampNs_{0};
+};
+
+#endif // SIMULATED_SINK_H
@@ -0,0 +1,290 @@
+#include "sink_pool.h"
+#include "audio_log.h"
+#include "callback_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// One opened backend stream, routing its callbacks to whoever owns it at the moment
+struct SinkPool::Slot {
+    AudioSinkConfig config;
+    std::unique_ptr<AudioSink> sink;
+    int32_t initialBufferSize = 0;
+    uint64_t idleSinceNs = 0;
+
+    // Rebound while the stream is stopped; the error callback can still fire then
+    std::atomic<AudioSink::DataCallback> dataCallback{nullptr};
+    std::atomic<AudioSink::ErrorCallback> errorCallback{nullptr};
+    std::atomic<void*> userData{nullptr};
+    std::atomic<bool> failed{false};
+
+    static AudioSink::CallbackResult onData(void* userData, void* audioData, int32_t numFrames) {
+        auto* slot = static_cast<Slot*>(userData);
+        AudioSink::DataCallback callback = slot->dataCallback.load(std::memory_order_acquire);
+        if (!callback) {
+            return AudioSink::CallbackResult::Stop;
+        }
+        return callback(slot->userData.load(std::memory_order_relaxed), audioData, numFrames);
+    }
+
+    static void onError(void* userData, int32_t error) {
+        auto* slot = static_cast<Slot*>(userData);
+        slot->failed.store(true, std::memory_order_release);
+        AudioSink::ErrorCallback callback = slot->errorCallback.load(std::memory_order_acquire);
+        if (callback) {
+            callback(slot->userData.load(std::memory_order_relaxed), error);
+        }
+    }
+};
+
+/**
+ * AudioSink handed out by SinkPool, borrows a pooled stream from open() to close()
+ */
+class PooledSink : public AudioSink {
+public:
+    explicit PooledSink(SinkPool& pool) : pool_(pool) {}
+    ~PooledSink() override { close(); }
+
+    // Disable copy and assignment
+    PooledSink(const PooledSink&) = delete;
+    PooledSink& operator=(const PooledSink&) = delete;
+
+    bool open(const AudioSinkConfig& config,
+              DataCallback dataCallback,
+              ErrorCallback errorCallback,
+              void* userData) override {
+        close();
+        slot_ = pool_.acquire(config, &reused_);
+        if (!slot_) {
+            return false;
+        }
+        slot_->userData.store(userData, std::memory_order_relaxed);
+        slot_->errorCallback.store(errorCallback, std::memory_order_release);
+        slot_->dataCallback.store(dataCallback, std::memory_order_release);
+        return true;
+    }
+
+    bool start() override {
+        if (!slot_) {
+            return false;
+        }
+        running_ = true;
+        if (!slot_->sink->start()) {
+            slot_->failed.store(true);
+            return false;
+        }
+        return true;
+    }
+
+    bool stop() override {
+        if (!slot_) {
+            return false;
+        }
+        if (!slot_->sink->stop()) {
+            return false;
+        }
+        running_ = false;
+        return true;
+    }
+
+    void close() override {
+        if (!slot_) {
+            return;
+        }
+        // Only a stream known to be stopped goes back to the pool
+        if (running_ && !stop()) {
+            slot_->failed.store(true);
+        }
+        slot_->dataCallback.store(nullptr, std::memory_order_release);
+        slot_->errorCallback.store(nullptr, std::memory_order_release);
+        slot_->userData.store(nullptr, std::memory_order_relaxed);
+        running_ = false;
+        reused_ = false;
+        pool_.release(std::move(slot_));
+    }
+
+    bool isOpen() const override { return slot_ != nullptr; }
+
+    int32_t getSampleRate() const override { return slot_ ? slot_->sink->getSampleRate() : 0; }
+    int32_t getChannelCount() const override { return slot_ ? slot_->sink->getChannelCount() : 0; }
+    SampleFormat getFormat() const override {
+        return slot_ ? slot_->sink->getFormat() : SampleFormat::Unspecified;
+    }
+    int32_t getFramesPerBurst() const override { return slot_ ? slot_->sink->getFramesPerBurst() : 0; }
+    int32_t getBufferSizeInFrames() const override { return slot_ ? slot_->sink->getBufferSizeInFrames() : 0; }
+    int32_t getBufferCapacityInFrames() const override {
+        return slot_ ? slot_->sink->getBufferCapacityInFrames() : 0;
+    }
+    int32_t setBufferSizeInFrames(int32_t numFrames) override {
+        return slot_ ? slot_->sink->setBufferSizeInFrames(numFrames) : -1;
+    }
+    int32_t getXRunCount() const override { return slot_ ? slot_->sink->getXRunCount() : 0; }
+    int64_t getFramesWritten() const override { return slot_ ? slot_->sink->getFramesWritten() : 0; }
+    bool getTimestamp(int64_t* framePosition, int64_t* timeNs) const override {
+        return slot_ && slot_->sink->getTimestamp(framePosition, timeNs);
+    }
+    const char* convertErrorToText(int32_t error) const override {
+        return slot_ ? slot_->sink->convertErrorToText(error) : "no stream";
+    }
+    bool isReused() const override { return reused_; }
+    const char* getName() const override { return slot_ ? slot_->sink->getName() : "Pooled"; }
+
+private:
+    SinkPool& pool_;
+    std::unique_ptr<SinkPool::Slot> slot_;
+    bool running_ = false;
+    bool reused_ = false;
+};
+
+SinkPool::SinkPool(SinkFactory factory) : SinkPool(std::move(factory), Options()) {}
+
+SinkPool::SinkPool(SinkFactory factory, const Options& options)
+    : factory_(std::move(factory)), options_(options), reaper_(&SinkPool::reaperLoop, this) {}
+
+SinkPool::~SinkPool() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wakeup_.notify_all();
+    if (reaper_.joinable()) {
+        reaper_.join();
+    }
+    clear();
+}
+
+std::unique_ptr<AudioSink> SinkPool::createSink() { return std::unique_ptr<AudioSink>(new PooledSink(*this)); }
+
+void SinkPool::setOptions(const Options& options) {
+    std::deque<std::unique_ptr<Slot>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_ = options;
+        while (static_cast<int32_t>(idle_.size()) > std::max(options_.maxIdleSinks, 0)) {
+            dropped.push_back(std::move(idle_.front()));
+            idle_.pop_front();
+            stats_.discarded++;
+        }
+    }
+    // Timeouts may have become shorter
+    wakeup_.notify_all();
+    LOGI("Stream pool: max idle=%d, idle timeout=%dms (power saving %dms)", options.maxIdleSinks,
+         options.idleTimeoutMs, options.powerSavingIdleTimeoutMs);
+}
+
+void SinkPool::clear() {
+    std::deque<std::unique_ptr<Slot>> dropped;
+    std::lock_guard<std::mutex> lock(mutex_);
+    dropped.swap(idle_);
+}
+
+SinkPool::Stats SinkPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = stats_;
+    stats.idleCount = static_cast<int32_t>(idle_.size());
+    return stats;
+}
+
+std::unique_ptr<SinkPool::Slot> SinkPool::acquire(const AudioSinkConfig& config, bool* reused) {
+    *reused = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Most recently returned first, it is the least likely to have been disconnected
+        for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+            if ((*it)->config == config && !(*it)->failed.load(std::memory_order_acquire)) {
+                std::unique_ptr<Slot> slot = std::move(*it);
+                idle_.erase(std::next(it).base());
+                stats_.warmOpens++;
+                *reused = true;
+                return slot;
+            }
+        }
+    }
+
+    std::unique_ptr<AudioSink> sink = factory_ ? factory_() : nullptr;
+    if (!sink) {
+        return nullptr;
+    }
+    auto slot = std::make_unique<Slot>();
+    if (!sink->open(config, Slot::onData, Slot::onError, slot.get())) {
+        return nullptr;
+    }
+    slot->config = config;
+    slot->initialBufferSize = sink->getBufferSizeInFrames();
+    slot->sink = std::move(sink);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.coldOpens++;
+    return slot;
+}
+
+void SinkPool::release(std::unique_ptr<Slot> slot) {
+    if (!slot->failed.load(std::memory_order_acquire)) {
+        // The next owner expects the buffer size of a fresh stream
+        if (slot->sink->getBufferSizeInFrames() != slot->initialBufferSize) {
+            slot->sink->setBufferSizeInFrames(slot->initialBufferSize);
+        }
+        slot->idleSinceNs = CallbackStats::nowNs();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (options_.maxIdleSinks > 0 && running_) {
+            idle_.push_back(std::move(slot));
+            if (static_cast<int32_t>(idle_.size()) > options_.maxIdleSinks) {
+                slot = std::move(idle_.front());
+                idle_.pop_front();
+            }
+        }
+        if (slot) {
+            stats_.discarded++;
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.discarded++;
+    }
+    wakeup_.notify_all();
+
+    // Closing can block, never under the lock
+    slot.reset();
+}
+
+void SinkPool::reaperLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        uint64_t now = CallbackStats::nowNs();
+        uint64_t nextExpiryNs = UINT64_MAX;
+        std::vector<std::unique_ptr<Slot>> expired;
+
+        for (auto it = idle_.begin(); it != idle_.end();) {
+            uint64_t timeoutNs = static_cast<uint64_t>(getIdleTimeoutMs((*it)->config)) * 1000000ULL;
+            uint64_t expiryNs = (*it)->idleSinceNs + timeoutNs;
+            if (expiryNs <= now || (*it)->failed.load(std::memory_order_acquire)) {
+                expired.push_back(std::move(*it));
+                it = idle_.erase(it);
+                stats_.reaped++;
+            } else {
+                nextExpiryNs = std::min(nextExpiryNs, expiryNs);
+                ++it;
+            }
+        }
+
+        if (!expired.empty()) {
+            lock.unlock();
+            LOGI("Stream pool: closing %zu idle stream(s)", expired.size());
+            expired.clear();
+            lock.lock();
+            continue;
+        }
+
+        if (nextExpiryNs == UINT64_MAX) {
+            wakeup_.wait(lock);
+        } else {
+            wakeup_.wait_for(lock, std::chrono::nanoseconds(nextExpiryNs - now));
+        }
+    }
+}
+
+int32_t SinkPool::getIdleTimeoutMs(const AudioSinkConfig& config) const {
+    bool shared = config.sharingMode == 1; // AAUDIO_SHARING_MODE_SHARED
+    return config.isLowLatency() && shared ? options_.idleTimeoutMs : options_.powerSavingIdleTimeoutMs;
+}
@@ -0,0 +1,98 @@
+#ifndef SINK_POOL_H
+#define SINK_POOL_H
+
+#include "audio_sink.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * Pool of opened, stopped output streams
+ *
+ * Opening a stream is the dominant part of start latency. Sinks created by
+ * the pool hand their stream back on close() instead of closing it, and the
+ * next open() with an identical AudioSinkConfig takes it over, so starting
+ * is only a start request on a warm stream.
+ *
+ * A reaper thread closes streams that stay idle past a timeout. Streams that
+ * are not shared low-latency ones (power saving, exclusive) use a shorter
+ * timeout, they hold more of the device or keep it from sleeping. A stream
+ * that reported an error, or could not be stopped, is never reused.
+ */
+class SinkPool {
+public:
+    using SinkFactory = std::function<std::unique_ptr<AudioSink>()>;
+
+    struct Options {
+        int32_t maxIdleSinks = 2;                // 0 disables pooling, every close() closes the stream
+        int32_t idleTimeoutMs = 10000;           // Shared low-latency streams
+        int32_t powerSavingIdleTimeoutMs = 2000; // Every other performance or sharing mode
+    };
+
+    struct Stats {
+        uint64_t warmOpens = 0; // open() served by an idle stream
+        uint64_t coldOpens = 0; // open() that created a stream
+        uint64_t reaped = 0;    // Idle streams closed after their timeout
+        uint64_t discarded = 0; // Streams closed on return: failed, or over maxIdleSinks
+        int32_t idleCount = 0;
+    };
+
+    /**
+     * Constructor
+     * @param factory Creates the backend sinks the pool keeps open
+     */
+    explicit SinkPool(SinkFactory factory);
+    SinkPool(SinkFactory factory, const Options& options);
+
+    /**
+     * Destructor, closes all idle streams
+     * Every sink created by the pool must be destroyed before.
+     */
+    ~SinkPool() noexcept;
+
+    // Disable copy and assignment
+    SinkPool(const SinkPool&) = delete;
+    SinkPool& operator=(const SinkPool&) = delete;
+
+    /**
+     * Create a sink backed by the pool, usable as a PlayerEngine::SinkFactory
+     */
+    std::unique_ptr<AudioSink> createSink();
+
+    /**
+     * Change the limits, closing idle streams beyond them
+     */
+    void setOptions(const Options& options);
+
+    /**
+     * Close all idle streams
+     */
+    void clear();
+
+    Stats getStats() const;
+
+private:
+    friend class PooledSink;
+    struct Slot;
+
+    std::unique_ptr<Slot> acquire(const AudioSinkConfig& config, bool* reused);
+    void release(std::unique_ptr<Slot> slot);
+    void reaperLoop();
+    int32_t getIdleTimeoutMs(const AudioSinkConfig& config) const;
+
+    SinkFactory factory_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    Options options_;
+    std::deque<std::unique_ptr<Slot>> idle_; // Oldest first
+    Stats stats_;
+    bool running_ = true;
+    std::thread reaper_;
+};
+
+#endif // SINK_POOL_H
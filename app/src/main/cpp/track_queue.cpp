@@ -0,0 +1,318 @@
+#include "track_queue.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <chrono>
+
+// std::chrono::milliseconds takes kPollIntervalMs by reference
+constexpr int32_t TrackQueue::kPollIntervalMs;
+
+int32_t Track::getSampleRate() const { return clip ? clip->getClip().sampleRate : file->getSampleRate(); }
+
+int32_t Track::getChannelCount() const { return clip ? clip->getClip().channelCount : file->getChannelCount(); }
+
+SampleFormat Track::getSampleFormat() const { return clip ? clip->getClip().format : file->getSampleFormat(); }
+
+int32_t Track::getBytesPerFrame() const { return clip ? clip->getClip().bytesPerFrame : file->getBytesPerFrame(); }
+
+std::string Track::getFormatInfo() const { return clip ? clip->getClip().formatInfo : file->getFormatInfo(); }
+
+void Track::seek(int64_t frame) {
+    auto offset = static_cast<uint64_t>(std::max<int64_t>(frame, 0)) * static_cast<uint64_t>(getBytesPerFrame());
+    if (clip) {
+        clip->seek(static_cast<size_t>(std::min<uint64_t>(offset, clip->getClip().size)));
+    } else {
+        prefetch->seek(offset);
+    }
+}
+
+void Track::setConsumerBurst(int32_t burstFrames, int32_t streamSampleRate) {
+    if (!prefetch || burstFrames <= 0 || streamSampleRate <= 0) {
+        return;
+    }
+    // One stream burst pulls this many file frames through the resampler
+    int64_t fileFrames =
+        (static_cast<int64_t>(burstFrames) * getSampleRate() + streamSampleRate - 1) / streamSampleRate;
+    prefetch->setConsumerBurst(static_cast<size_t>(fileFrames) * static_cast<size_t>(getBytesPerFrame()));
+}
+
+int64_t Track::getPosition() const {
+    uint64_t position = clip ? clip->getPosition() : prefetch->getPosition();
+    return static_cast<int64_t>(position / static_cast<uint64_t>(getBytesPerFrame()));
+}
+
+bool Track::hasSameFormat(const Track& other) const {
+    return getSampleRate() == other.getSampleRate() && getChannelCount() == other.getChannelCount() &&
+           getSampleFormat() == other.getSampleFormat();
+}
+
+TrackQueue::~TrackQueue() noexcept {
+    stop();
+    release();
+}
+
+std::unique_ptr<Track> TrackQueue::openTrack(const std::string& path, int32_t index, const Options& options) {
+    auto track = std::make_unique<Track>();
+    track->path = path;
+    track->index = index;
+
+    if (options.clipCache) {
+        bool hit = false;
+        std::shared_ptr<const ClipCache::Clip> clip = options.clipCache->acquire(path, &hit);
+        if (clip) {
+            track->clip = std::make_unique<ClipReader>(std::move(clip));
+            track->source = hit ? ClipCache::Path::Hit : ClipCache::Path::Miss;
+            return track;
+        }
+    }
+
+    track->file = openAudioFile(path, options.ioMode);
+    if (!track->file) {
+        LOGE("Failed to open: %s", path.c_str());
+        return nullptr;
+    }
+
+    // Priming the ring here is what makes the following switch gapless
+    int32_t bytesPerFrame = track->file->getBytesPerFrame();
+    PrefetchReader::Config config = PrefetchReader::makeConfig(
+        static_cast<int64_t>(bytesPerFrame) * track->file->getSampleRate(), bytesPerFrame, options.prefetchDepthMs,
+        options.prefetchLowWaterPercent, options.prefetchHighWaterPercent);
+    track->prefetch = std::make_unique<PrefetchReader>();
+    if (!track->prefetch->start(track->file.get(), config)) {
+        LOGE("Failed to start prefetch reader: %s", path.c_str());
+        return nullptr;
+    }
+    return track;
+}
+
+bool TrackQueue::start(std::unique_ptr<Track> first, const Options& options, SwapHandler swapHandler) {
+    stop();
+    release();
+    if (!first) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    swapHandler_ = std::move(swapHandler);
+    nextIndex_ = first->index + 1;
+    transitions_.clear();
+    current_.store(first.release(), std::memory_order_release);
+
+    running_ = true;
+    thread_ = std::thread(&TrackQueue::workerLoop, this);
+    return true;
+}
+
+void TrackQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wakeup_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void TrackQueue::release() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    delete current_.exchange(nullptr);
+    delete next_.exchange(nullptr);
+    delete swapTrack_.exchange(nullptr);
+    delete retired_.exchange(nullptr);
+    dropped_.clear();
+    pending_.clear();
+    upcoming_.store(0, std::memory_order_release);
+    swapNeeded_.store(false);
+    swapRequested_.store(false);
+    awaitingSwapCallback_.store(false);
+    swapGapFrames_.store(-1);
+}
+
+void TrackQueue::enqueue(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(path);
+        upcoming_.fetch_add(1, std::memory_order_acq_rel);
+    }
+    wakeup_.notify_all();
+}
+
+void TrackQueue::clearPending() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        upcoming_.fetch_sub(static_cast<int32_t>(pending_.size()), std::memory_order_acq_rel);
+        pending_.clear();
+        clearGeneration_++;
+
+        // Each exchange decides whether the audio thread or this one got the track; the worker
+        // destroys ours, so a track is never freed while another thread promotes it
+        for (std::atomic<Track*>* slot : {&next_, &swapTrack_}) {
+            Track* track = slot->exchange(nullptr, std::memory_order_acq_rel);
+            if (track) {
+                dropTrack(track);
+            }
+        }
+        swapNeeded_.store(false, std::memory_order_release);
+    }
+    wakeup_.notify_all();
+}
+
+// Caller holds the lock, the worker destroys the track
+void TrackQueue::dropTrack(Track* track) {
+    dropped_.emplace_back(track);
+    upcoming_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+std::vector<TrackQueue::Transition> TrackQueue::getTransitions() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<Transition>(transitions_.begin(), transitions_.end());
+}
+
+void TrackQueue::setConsumerBurst(int32_t burstFrames, int32_t streamSampleRate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    burstFrames_ = burstFrames;
+    burstSampleRate_ = streamSampleRate;
+    for (Track* track : {current_.load(std::memory_order_acquire), next_.load(std::memory_order_acquire),
+                         swapTrack_.load(std::memory_order_acquire)}) {
+        if (track) {
+            track->setConsumerBurst(burstFrames, streamSampleRate);
+        }
+    }
+}
+
+PrefetchReader::Stats TrackQueue::getPrefetchStats() const {
+    // Tracks are only destroyed under the lock, the current one stays valid while it is held
+    std::lock_guard<std::mutex> lock(mutex_);
+    Track* track = current_.load(std::memory_order_acquire);
+    return track && track->prefetch ? track->prefetch->getStats() : PrefetchReader::Stats();
+}
+
+Track* TrackQueue::advance(int64_t gapFrames) {
+    Track* next = next_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!next) {
+        return nullptr;
+    }
+
+    Track* current = current_.load(std::memory_order_relaxed);
+    if (current && !next->hasSameFormat(*current)) {
+        // Never put back into next_, where clearPending() may already have looked
+        swapTrack_.store(next, std::memory_order_release);
+        swapNeeded_.store(true, std::memory_order_release);
+        return nullptr;
+    }
+
+    // The retired slot is empty: the worker only prepares a track after draining it
+    retiredGapFrames_.store(gapFrames, std::memory_order_relaxed);
+    current_.store(next, std::memory_order_release);
+    upcoming_.fetch_sub(1, std::memory_order_acq_rel);
+    retired_.store(current, std::memory_order_release);
+    return next;
+}
+
+void TrackQueue::requestSwap(uint64_t lastCallbackNs) {
+    swapEndNs_.store(lastCallbackNs, std::memory_order_relaxed);
+    swapRequested_.store(true, std::memory_order_release);
+}
+
+Track* TrackQueue::promoteNext() {
+    swapNeeded_.store(false, std::memory_order_release);
+
+    Track* next = swapTrack_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!next) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    upcoming_.fetch_sub(1, std::memory_order_acq_rel);
+    if (next->clearGeneration != clearGeneration_) {
+        // Moved here by the audio thread while clearPending() ran
+        delete next;
+        return nullptr;
+    }
+
+    Track* previous = current_.exchange(next, std::memory_order_acq_rel);
+    swapFromIndex_ = previous ? previous->index : 0;
+    delete previous;
+
+    swapGapFrames_.store(-1, std::memory_order_relaxed);
+    awaitingSwapCallback_.store(true, std::memory_order_release);
+    return next;
+}
+
+void TrackQueue::onCallback(uint64_t nowNs, int32_t sampleRate) {
+    if (!awaitingSwapCallback_.load(std::memory_order_relaxed) || !awaitingSwapCallback_.exchange(false)) {
+        return;
+    }
+    uint64_t endNs = swapEndNs_.load(std::memory_order_relaxed);
+    uint64_t gapNs = nowNs > endNs ? nowNs - endNs : 0;
+    swapGapFrames_.store(static_cast<int64_t>(gapNs * static_cast<uint64_t>(sampleRate) / 1000000000ULL),
+                         std::memory_order_release);
+}
+
+void TrackQueue::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        reclaimRetired();
+        dropped_.clear();
+
+        int64_t swapGapFrames = swapGapFrames_.exchange(-1, std::memory_order_acq_rel);
+        if (swapGapFrames >= 0) {
+            Track* current = current_.load(std::memory_order_acquire);
+            recordTransition({swapFromIndex_, current ? current->index : 0, swapGapFrames, false});
+        }
+
+        if (swapRequested_.exchange(false, std::memory_order_acq_rel)) {
+            // The handler stops and reopens the stream, it must not run under the lock
+            lock.unlock();
+            swapHandler_();
+            lock.lock();
+            continue;
+        }
+
+        if (!next_.load() && !swapTrack_.load() && !retired_.load() && !pending_.empty()) {
+            std::string path = std::move(pending_.front());
+            pending_.pop_front();
+            int32_t index = nextIndex_++;
+            uint32_t generation = clearGeneration_;
+
+            lock.unlock();
+            std::unique_ptr<Track> track = openTrack(path, index, options_);
+            lock.lock();
+
+            if (!track || generation != clearGeneration_) {
+                // Failed or cleared while opening: skip it, clearPending() did not count it
+                upcoming_.fetch_sub(1, std::memory_order_acq_rel);
+                continue;
+            }
+            track->clearGeneration = generation;
+            track->setConsumerBurst(burstFrames_, burstSampleRate_);
+            LOGI("Next track prepared: #%d %s", index, path.c_str());
+            next_.store(track.release(), std::memory_order_release);
+            continue;
+        }
+
+        // The audio thread never signals, retirements and swap requests are polled
+        wakeup_.wait_for(lock, std::chrono::milliseconds(kPollIntervalMs));
+    }
+}
+
+void TrackQueue::reclaimRetired() {
+    Track* retired = retired_.exchange(nullptr, std::memory_order_acq_rel);
+    if (!retired) {
+        return;
+    }
+
+    Track* current = current_.load(std::memory_order_acquire);
+    recordTransition({retired->index, current ? current->index : 0,
+                      retiredGapFrames_.load(std::memory_order_relaxed), true});
+    delete retired;
+}
+
+void TrackQueue::recordTransition(const Transition& transition) {
+    LOGI("Track #%d -> #%d: %s, gap %lld frames", transition.fromIndex, transition.toIndex,
+         transition.gapless ? "gapless" : "stream swap", static_cast<long long>(transition.gapFrames));
+    transitions_.push_back(transition);
+    if (transitions_.size() > kMaxTransitions) {
+        transitions_.pop_front();
+    }
+}
@@ -0,0 +1,267 @@
+#ifndef TRACK_QUEUE_H
+#define TRACK_QUEUE_H
+
+#include "audio_file.h"
+#include "clip_cache.h"
+#include "prefetch_reader.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * One opened file of the play queue: header parsed and first frames prefetched,
+ * or served from the clip cache without touching the file
+ */
+struct Track {
+    std::string path;
+    int32_t index = 0; // Position in the sequence since playback started
+    std::unique_ptr<AudioFile> file;          // Streamed tracks only
+    std::unique_ptr<PrefetchReader> prefetch; // Streamed tracks only
+    std::unique_ptr<ClipReader> clip;         // Cached tracks only
+    ClipCache::Path source = ClipCache::Path::Stream;
+    uint32_t clearGeneration = 0; // Of the queue when prepared, a later clearPending() drops the track
+
+    /**
+     * Read track data (real-time safe), same contract as PrefetchReader::read()
+     */
+    size_t read(void* buffer, size_t size) { return clip ? clip->read(buffer, size) : prefetch->read(buffer, size); }
+    bool isEndOfStream() const { return clip ? clip->isEndOfStream() : prefetch->isEndOfStream(); }
+
+    /**
+     * Continue from another frame (real-time safe, audio thread), same contract as PrefetchReader::seek()
+     */
+    void seek(int64_t frame);
+    bool isSeekPending() const { return !clip && prefetch->isSeekPending(); }
+
+    /**
+     * Size the decode-ahead of a streamed track from the callback size, see PrefetchReader::setConsumerBurst()
+     * @param burstFrames Frames per callback burst of the stream
+     * @param streamSampleRate Sample rate of the stream, the track may be resampled to it
+     */
+    void setConsumerBurst(int32_t burstFrames, int32_t streamSampleRate);
+
+    /**
+     * Get the read position in frames (audio thread)
+     */
+    int64_t getPosition() const;
+
+    // Format of the data read(), a cached clip is already in the device-preferred format
+    int32_t getSampleRate() const;
+    int32_t getChannelCount() const;
+    SampleFormat getSampleFormat() const;
+    int32_t getBytesPerFrame() const;
+    std::string getFormatInfo() const;
+
+    /**
+     * True if other can continue this track on the same stream
+     */
+    bool hasSameFormat(const Track& other) const;
+};
+
+/**
+ * Gapless playback queue
+ *
+ * Holds the playing track, at most one prepared next track and the paths
+ * still to be opened. A worker thread opens the next file (header parse and
+ * prefetch priming) while the current one plays, so the audio thread can
+ * continue with it inside the same callback. The audio thread only swaps
+ * atomic pointers; the track it leaves is handed back to the worker, which
+ * destroys it and records the transition.
+ *
+ * When the next file needs a different stream format the audio thread moves
+ * it to the swap slot and asks for a stream swap instead, which the worker
+ * carries out through the swap handler with the already opened track.
+ *
+ * Every hand-over of a prepared track is a single atomic exchange, so one
+ * thread at a time owns it, and only the worker destroys tracks.
+ */
+class TrackQueue {
+public:
+    struct Options {
+        AudioFile::IoMode ioMode = AudioFile::IoMode::MemoryMap;
+        int32_t prefetchDepthMs = 500;
+        int32_t prefetchLowWaterPercent = 50;
+        int32_t prefetchHighWaterPercent = 90;
+        ClipCache* clipCache = nullptr; // Tried first when set, must outlive the queue
+    };
+
+    /**
+     * One track change
+     * gapFrames counts stream frames of silence between the two tracks: frames
+     * rendered while the next file was still opening for a gapless change, the
+     * time from the last callback of the old stream to the first callback of
+     * the new one for a stream swap.
+     */
+    struct Transition {
+        int32_t fromIndex = 0;
+        int32_t toIndex = 0;
+        int64_t gapFrames = 0;
+        bool gapless = false; // Continued on the same stream
+    };
+
+    static constexpr size_t kMaxTransitions = 32;
+
+    /**
+     * Called on the worker thread when the next track needs a new stream
+     */
+    using SwapHandler = std::function<void()>;
+
+    TrackQueue() = default;
+
+    /**
+     * Destructor, stops the worker and closes all tracks
+     */
+    ~TrackQueue() noexcept;
+
+    // Disable copy and assignment
+    TrackQueue(const TrackQueue&) = delete;
+    TrackQueue& operator=(const TrackQueue&) = delete;
+
+    /**
+     * Open a file and prime its prefetch ring, or take it from the clip cache (blocking)
+     * @return The track, or nullptr on failure
+     */
+    static std::unique_ptr<Track> openTrack(const std::string& path, int32_t index, const Options& options);
+
+    /**
+     * Make first the current track and start preparing queued paths
+     * @param first Opened first track
+     * @param options Used for every following track
+     * @param swapHandler Performs a stream swap, see promoteNext()
+     */
+    bool start(std::unique_ptr<Track> first, const Options& options, SwapHandler swapHandler);
+
+    /**
+     * Stop the worker (blocking), waits for a running stream swap
+     */
+    void stop();
+
+    /**
+     * Close all tracks and drop queued paths
+     * Call after stop(), once the audio thread no longer reads the current track.
+     */
+    void release();
+
+    /**
+     * Append a file to the queue (control thread)
+     */
+    void enqueue(const std::string& path);
+
+    /**
+     * Drop queued paths and the prepared next track (control thread)
+     * The track is handed to the worker to destroy; one the audio thread took meanwhile for a
+     * stream swap is dropped by promoteNext().
+     */
+    void clearPending();
+
+    /**
+     * Get the number of tracks after the current one (queued, opening or prepared)
+     */
+    int32_t getUpcomingCount() const { return upcoming_.load(std::memory_order_acquire); }
+
+    /**
+     * Get the recent transitions, oldest first (control thread)
+     */
+    std::vector<Transition> getTransitions() const;
+
+    /**
+     * Get prefetch counters of the current track (control thread)
+     * All zero while a cached clip plays.
+     */
+    PrefetchReader::Stats getPrefetchStats() const;
+
+    /**
+     * Size the decode-ahead of the current, prepared and later tracks (control thread)
+     * @param burstFrames Frames per callback burst of the stream
+     * @param streamSampleRate Sample rate of the stream
+     */
+    void setConsumerBurst(int32_t burstFrames, int32_t streamSampleRate);
+
+    /**
+     * Get the playing track (audio thread, or any thread while the stream is stopped)
+     */
+    Track* current() const { return current_.load(std::memory_order_acquire); }
+
+    /**
+     * Continue with the prepared next track (real-time safe, audio thread)
+     * @param gapFrames Frames rendered since the current track ended
+     * @return The new current track, or nullptr if none is prepared or it needs a
+     *         new stream (see isSwapNeeded())
+     */
+    Track* advance(int64_t gapFrames);
+
+    /**
+     * True once advance() found a next track with another format
+     */
+    bool isSwapNeeded() const { return swapNeeded_.load(std::memory_order_acquire); }
+
+    /**
+     * True if a next track is prepared
+     */
+    bool isNextReady() const { return next_.load(std::memory_order_acquire) != nullptr; }
+
+    /**
+     * Ask the worker to swap the stream (real-time safe, audio thread)
+     * @param lastCallbackNs When the old stream wrote its last frame
+     */
+    void requestSwap(uint64_t lastCallbackNs);
+
+    /**
+     * Make the track waiting for a stream swap current (swap handler, stream stopped)
+     * @return The new current track, or nullptr if none is waiting or the queue was cleared since
+     */
+    Track* promoteNext();
+
+    /**
+     * Report a callback of the stream (real-time safe, audio thread)
+     * Completes the gap measurement of a stream swap.
+     */
+    void onCallback(uint64_t nowNs, int32_t sampleRate);
+
+private:
+    static constexpr int32_t kPollIntervalMs = 5;
+
+    void workerLoop();
+    void reclaimRetired();
+    void dropTrack(Track* track);
+    void recordTransition(const Transition& transition);
+
+    Options options_;
+    SwapHandler swapHandler_;
+
+    // Audio thread side
+    std::atomic<Track*> current_{nullptr};
+    std::atomic<Track*> next_{nullptr};
+    std::atomic<Track*> swapTrack_{nullptr}; // Next track of another format, taken by promoteNext()
+    std::atomic<Track*> retired_{nullptr}; // Left by the audio thread, destroyed by the worker
+    std::atomic<int64_t> retiredGapFrames_{0};
+    std::atomic<int32_t> upcoming_{0};
+    std::atomic<bool> swapNeeded_{false};
+    std::atomic<bool> swapRequested_{false};
+    std::atomic<uint64_t> swapEndNs_{0};
+    std::atomic<bool> awaitingSwapCallback_{false};
+    std::atomic<int64_t> swapGapFrames_{-1};
+    int32_t swapFromIndex_ = 0;
+
+    // Control side
+    mutable std::mutex mutex_; // Guards the members below and destruction of tracks
+    std::condition_variable wakeup_;
+    std::deque<std::string> pending_;
+    std::deque<Transition> transitions_;
+    std::vector<std::unique_ptr<Track>> dropped_; // Destroyed by the worker
+    int32_t nextIndex_ = 0;
+    uint32_t clearGeneration_ = 0; // Bumped by clearPending(), drops a track opened meanwhile
+    int32_t burstFrames_ = 0;      // Applied to each track the worker opens
+    int32_t burstSampleRate_ = 0;
+    bool running_ = false;
+    std::thread thread_;
+};
+
+#endif // TRACK_QUEUE_H
@@ -0,0 +1,405 @@
+// Host benchmark of the WaveFile I/O path: header parse time, sequential read throughput at callback-sized
+// bursts and the read syscalls and page faults behind them, over synthetic WAVs (optionally a multi-GB one, read
+// cold from disk) and any files given
+#include "wave_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#include <utility>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Synthetic file layout
+struct BenchCase {
+    const char* name;
+    int32_t sampleRate;
+    int32_t channelCount;
+    int32_t bitsPerSample;
+    bool isFloat;
+    bool extensible;    // WAVE_FORMAT_EXTENSIBLE fmt chunk
+    uint32_t junkBytes; // JUNK chunk before fmt, 0 for none
+    uint32_t listBytes; // LIST chunk between fmt and data, 0 for none
+};
+
+const BenchCase kCases[] = {
+    {"44k1-2ch-i16", 44100, 2, 16, false, false, 0, 0},
+    {"22k05-1ch-u8", 22050, 1, 8, false, false, 0, 0},
+    {"48k-2ch-i24", 48000, 2, 24, false, false, 0, 0},
+    {"96k-2ch-i24-ext", 96000, 2, 24, false, true, 0, 0},
+    {"48k-6ch-f32-ext", 48000, 6, 32, true, true, 0, 0},
+    {"192k-8ch-i32-ext", 192000, 8, 32, false, true, 0, 0},
+    {"48k-2ch-i16-junk4k-list1m", 48000, 2, 16, false, false, 4096, 1 << 20},
+    {"48k-2ch-i16-list64m", 48000, 2, 16, false, false, 0, 64u << 20},
+};
+
+// Bursts of the devices seen in practice, from low-latency MMAP to power-saving deep buffers
+const int32_t kBurstFrames[] = {96, 192, 256, 480, 1024, 4096};
+
+const AudioFile::IoMode kIoModes[] = {AudioFile::IoMode::Stream, AudioFile::IoMode::MemoryMap};
+
+// Layout of the -g file: plain CD-style stereo, RF64 once it passes 4 GiB
+const BenchCase kLargeCase = {"large-48k-2ch-i16", 48000, 2, 16, false, false, 0, 0};
+
+// Drop each file from the page cache before every measured read (-c)
+bool coldReads = false;
+
+const char* getIoModeName(AudioFile::IoMode ioMode) { return ioMode == AudioFile::IoMode::Stream ? "stream" : "mmap"; }
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// Read syscalls of this process so far (syscr of /proc/self/io), -1 where the kernel does not report them
+int64_t readSyscalls() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    int64_t value = 0;
+    while (io >> key >> value) {
+        if (key == "syscr:") {
+            return value;
+        }
+    }
+    return -1;
+}
+
+// Minor plus major page faults of this process so far
+int64_t pageFaults() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<int64_t>(usage.ru_minflt + usage.ru_majflt);
+}
+
+// Read syscalls of reading /proc/self/io itself, measured by calibrateSyscalls()
+int64_t probeSyscalls = 0;
+
+// Counters over a measured section
+struct Counters {
+    uint64_t ns = 0;
+    int64_t syscalls = 0; // -1 if unknown
+    int64_t faults = 0;
+};
+
+class Section {
+public:
+    Section() : syscalls_(readSyscalls()), faults_(pageFaults()), beginNs_(nowNs()) {}
+
+    Counters finish() const {
+        Counters counters;
+        counters.ns = nowNs() - beginNs_;
+        int64_t syscalls = readSyscalls();
+        counters.syscalls =
+            syscalls < 0 || syscalls_ < 0 ? -1 : std::max<int64_t>(syscalls - syscalls_ - probeSyscalls, 0);
+        counters.faults = pageFaults() - faults_;
+        return counters;
+    }
+
+private:
+    int64_t syscalls_;
+    int64_t faults_;
+    uint64_t beginNs_;
+};
+
+// Reading /proc/self/io costs read syscalls of its own, which an empty section counts
+void calibrateSyscalls() {
+    probeSyscalls = 0;
+    probeSyscalls = Section().finish().syscalls;
+    probeSyscalls = std::max<int64_t>(probeSyscalls, 0);
+}
+
+void putLe(std::string* out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out->push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+void putChunkHeader(std::string* out, const char* id, uint32_t size) {
+    out->append(id, 4);
+    putLe(out, size, 4);
+}
+
+/**
+ * Evict a file from the page cache, so the next read comes from disk
+ * @return Returns false if the kernel would not drop it
+ */
+bool dropFromCache(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // Dirty pages are not dropped, write them back first
+    bool dropped = fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return dropped;
+}
+
+/**
+ * Write a synthetic WAV, the JUNK and LIST payloads are left as holes so large ones cost no disk
+ * Files whose RIFF size does not fit 32 bits are written as RF64 with a ds64 chunk.
+ * @return Returns false if the file cannot be written
+ */
+bool writeWave(const std::string& path, const BenchCase& bench, double seconds) {
+    const int32_t bytesPerSample = bench.bitsPerSample / 8;
+    const int32_t bytesPerFrame = bench.channelCount * bytesPerSample;
+    const auto frames = static_cast<uint64_t>(seconds * bench.sampleRate);
+    const uint64_t dataBytes = frames * static_cast<uint64_t>(bytesPerFrame);
+    const uint32_t fmtBytes = bench.extensible ? 40 : 16;
+    const uint16_t formatCode = bench.isFloat ? WaveFile::kFormatIeeeFloat : WaveFile::kFormatPcm;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string header;
+    uint64_t riffBytes = 4 + 8 + fmtBytes + 8 + dataBytes;
+    riffBytes += bench.junkBytes > 0 ? 8 + bench.junkBytes : 0;
+    riffBytes += bench.listBytes > 0 ? 8 + bench.listBytes : 0;
+    const bool rf64 = riffBytes + 8 + 28 > 0xFFFFFFFFull;
+    if (rf64) {
+        // ds64: RIFF size, data size, sample count, then an empty table of other chunk sizes
+        riffBytes += 8 + 28;
+        putChunkHeader(&header, "RF64", 0xFFFFFFFF);
+        header.append("WAVE", 4);
+        putChunkHeader(&header, "ds64", 28);
+        putLe(&header, riffBytes, 8);
+        putLe(&header, dataBytes, 8);
+        putLe(&header, frames, 8);
+        putLe(&header, 0, 4);
+    } else {
+        putChunkHeader(&header, "RIFF", static_cast<uint32_t>(riffBytes));
+        header.append("WAVE", 4);
+    }
+    if (bench.junkBytes > 0) {
+        putChunkHeader(&header, "JUNK", bench.junkBytes);
+        header.append(bench.junkBytes, '\0');
+    }
+
+    putChunkHeader(&header, "fmt ", fmtBytes);
+    putLe(&header, bench.extensible ? WaveFile::kFormatExtensible : formatCode, 2);
+    putLe(&header, static_cast<uint64_t>(bench.channelCount), 2);
+    putLe(&header, static_cast<uint64_t>(bench.sampleRate), 4);
+    putLe(&header, static_cast<uint64_t>(bench.sampleRate) * static_cast<uint64_t>(bytesPerFrame), 4);
+    putLe(&header, static_cast<uint64_t>(bytesPerFrame), 2);
+    putLe(&header, static_cast<uint64_t>(bench.bitsPerSample), 2);
+    if (bench.extensible) {
+        static const uint8_t kGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                              0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+        putLe(&header, 22, 2);
+        putLe(&header, static_cast<uint64_t>(bench.bitsPerSample), 2);
+        putLe(&header, 0, 4);
+        putLe(&header, formatCode, 2);
+        header.append(reinterpret_cast<const char*>(kGuidTail), sizeof(kGuidTail));
+    }
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    if (bench.listBytes > 0) {
+        header.clear();
+        putChunkHeader(&header, "LIST", bench.listBytes);
+        file.write(header.data(), static_cast<std::streamsize>(header.size()));
+        file.seekp(bench.listBytes, std::ios::cur);
+    }
+
+    header.clear();
+    putChunkHeader(&header, "data", rf64 ? 0xFFFFFFFF : static_cast<uint32_t>(dataBytes));
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    // Any pattern does, the reader never looks at the samples
+    std::vector<char> block(64 * 1024);
+    for (size_t i = 0; i < block.size(); i++) {
+        block[i] = static_cast<char>(i * 7 + i / 256);
+    }
+    for (uint64_t written = 0; written < dataBytes;) {
+        auto count = static_cast<size_t>(std::min<uint64_t>(block.size(), dataBytes - written));
+        file.write(block.data(), static_cast<std::streamsize>(count));
+        written += count;
+    }
+    return file.good();
+}
+
+/**
+ * Time open() of a file, best and median of a number of runs
+ * @return Returns false if the file does not open
+ */
+bool measureParse(const std::string& path, const std::string& name, int32_t runs) {
+    for (AudioFile::IoMode ioMode : kIoModes) {
+        std::vector<uint64_t> times;
+        int64_t syscalls = 0;
+        for (int32_t run = 0; run < runs; run++) {
+            WaveFile file;
+            Section section;
+            bool opened = file.open(path, ioMode);
+            Counters counters = section.finish();
+            if (!opened) {
+                printf("%s: cannot open\n", path.c_str());
+                return false;
+            }
+            times.push_back(counters.ns);
+            syscalls = counters.syscalls < 0 || syscalls < 0 ? -1 : syscalls + counters.syscalls;
+        }
+        std::sort(times.begin(), times.end());
+        printf("%-28s %-6s parse   best %8.1f us  median %8.1f us  %6.1f read syscalls\n", name.c_str(),
+               getIoModeName(ioMode), times.front() / 1e3, times[times.size() / 2] / 1e3,
+               syscalls < 0 ? -1.0 : static_cast<double>(syscalls) / runs);
+    }
+    return true;
+}
+
+/**
+ * Read the whole data chunk in bursts, best of a number of runs per I/O mode and burst size
+ * @return Returns false if the file does not open
+ */
+bool measureReads(const std::string& path, const std::string& name, int32_t repeats) {
+    for (AudioFile::IoMode ioMode : kIoModes) {
+        for (int32_t burstFrames : kBurstFrames) {
+            Counters best;
+            uint64_t bytes = 0;
+            uint64_t bursts = 0;
+            for (int32_t repeat = 0; repeat < repeats; repeat++) {
+                WaveFile file;
+                if (!file.open(path, ioMode)) {
+                    printf("%s: cannot open\n", path.c_str());
+                    return false;
+                }
+                std::vector<uint8_t> buffer(static_cast<size_t>(burstFrames) * file.getBytesPerFrame());
+                if (coldReads && !dropFromCache(path)) {
+                    printf("%s: cannot drop from the page cache\n", path.c_str());
+                    return false;
+                }
+                bytes = 0;
+                bursts = 0;
+                Section section;
+                for (size_t count; (count = file.readAudioData(buffer.data(), buffer.size())) > 0;) {
+                    bytes += count;
+                    bursts++;
+                }
+                Counters counters = section.finish();
+                if (repeat == 0 || counters.ns < best.ns) {
+                    best = counters;
+                }
+            }
+            double megabytes = static_cast<double>(bytes) / (1024.0 * 1024.0);
+            printf("%-28s %-6s %4d fr %8.1f MB/s  %7.3f us/burst  %7.3f read syscalls/burst  %6.2f faults/MB\n",
+                   name.c_str(), getIoModeName(ioMode), burstFrames, best.ns > 0 ? megabytes * 1e9 / best.ns : 0.0,
+                   bursts > 0 ? best.ns / 1e3 / bursts : 0.0,
+                   best.syscalls < 0 || bursts == 0 ? -1.0 : static_cast<double>(best.syscalls) / bursts,
+                   megabytes > 0.0 ? best.faults / megabytes : 0.0);
+        }
+    }
+    return true;
+}
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] <work dir> [input file]...\n"
+            "Synthetic WAVs are written to <work dir> and removed afterwards; input files are measured as well.\n"
+            "Files are read warm from the page cache, so the figures are the parser's and the copy's, not the disk's,\n"
+            "unless -c drops them from the cache before every read.\n"
+            "  -t <seconds>  Length of the synthetic files, default 10\n"
+            "  -g <GiB>      Also measure one 48kHz stereo 16-bit file of this size (RF64 above 4 GiB)\n"
+            "  -c            Read cold: drop each file from the page cache before every measured read\n"
+            "  -p <runs>     Opens per file and I/O mode for the parse time, default 200\n"
+            "  -r <runs>     Full reads per file, I/O mode and burst size, the best counts, default 3\n"
+            "  -k            Keep the synthetic files\n"
+            "  -v            Keep the parser's log on stderr\n",
+            program);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    double seconds = 10.0;
+    double largeGiB = 0.0;
+    int32_t parseRuns = 200;
+    int32_t repeats = 3;
+    bool keep = false;
+    bool verbose = false;
+
+    int index = 1;
+    for (; index < argc && argv[index][0] == '-'; index++) {
+        const char* option = argv[index];
+        const char* value = index + 1 < argc ? argv[index + 1] : nullptr;
+        if (strcmp(option, "-k") == 0) {
+            keep = true;
+            continue;
+        }
+        if (strcmp(option, "-v") == 0) {
+            verbose = true;
+            continue;
+        }
+        if (strcmp(option, "-c") == 0) {
+            coldReads = true;
+            continue;
+        }
+        if (!value) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (strcmp(option, "-t") == 0) {
+            seconds = atof(value);
+        } else if (strcmp(option, "-g") == 0) {
+            largeGiB = atof(value);
+        } else if (strcmp(option, "-p") == 0) {
+            parseRuns = atoi(value);
+        } else if (strcmp(option, "-r") == 0) {
+            repeats = atoi(value);
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+        index++;
+    }
+    if (index >= argc || seconds <= 0.0 || largeGiB < 0.0 || parseRuns < 1 || repeats < 1) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    const std::string workDir = argv[index++];
+
+    // Every open logs the format, which would cost more than the parse itself
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    calibrateSyscalls();
+    std::vector<std::pair<BenchCase, double>> benches;
+    for (const BenchCase& bench : kCases) {
+        benches.emplace_back(bench, seconds);
+    }
+    if (largeGiB > 0.0) {
+        const double bytesPerSecond = kLargeCase.sampleRate * kLargeCase.channelCount * kLargeCase.bitsPerSample / 8.0;
+        benches.emplace_back(kLargeCase, largeGiB * 1024.0 * 1024.0 * 1024.0 / bytesPerSecond);
+    }
+
+    bool ok = true;
+    for (const auto& bench : benches) {
+        const char* name = bench.first.name;
+        std::string path = workDir + "/wavbench-" + name + ".wav";
+        if (!writeWave(path, bench.first, bench.second)) {
+            printf("%s: cannot write\n", path.c_str());
+            return 1;
+        }
+        ok = measureParse(path, name, parseRuns) && measureReads(path, name, repeats) && ok;
+        if (!keep) {
+            unlink(path.c_str());
+        }
+    }
+    for (; index < argc; index++) {
+        const char* path = argv[index];
+        const char* slash = strrchr(path, '/');
+        std::string name = slash ? slash + 1 : path;
+        ok = measureParse(path, name, parseRuns) && measureReads(path, name, repeats) && ok;
+    }
+    return ok ? 0 : 1;
+}
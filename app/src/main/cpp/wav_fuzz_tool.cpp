@@ -0,0 +1,413 @@
+// Fuzz target of the WaveFile chunk walker (readFmtChunk, findDataChunk, skipChunk) and the reads it sets up.
+// Built against libFuzzer with AAUDIO_PLAYER_LIBFUZZER, otherwise a standalone driver replays files and
+// generates structured random WAVs itself, so it also runs where only GCC is available.
+#include "wave_file.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifndef AAUDIO_PLAYER_LIBFUZZER
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#endif
+
+// WaveFile opens by path: inputs go to an unlinked temporary file, reopened through /proc/self/fd
+static int inputFd = -1;
+static std::string inputPath;
+
+// Odd size, so reads end mid-frame and mid-page
+static constexpr size_t kReadBytes = 1531;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stdout, "wavfuzz: %s\n", what);
+        fflush(stdout);
+        abort();
+    }
+}
+
+static bool createInputFile() {
+    const char* dir = getenv("TMPDIR");
+    std::string pattern = std::string(dir && *dir ? dir : "/tmp") + "/aaudioplayer-wavfuzz-XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    inputFd = mkstemp(path.data());
+    if (inputFd < 0) {
+        fprintf(stdout, "wavfuzz: cannot create %s\n", pattern.c_str());
+        return false;
+    }
+    unlink(path.data());
+    inputPath = "/proc/self/fd/" + std::to_string(inputFd);
+    return true;
+}
+
+static bool writeInput(const uint8_t* data, size_t size) {
+    if (ftruncate(inputFd, 0) != 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < size) {
+        ssize_t count = pwrite(inputFd, data + written, size - written, static_cast<off_t>(written));
+        if (count <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Open the input in one I/O mode and read its data chunk every way a player does, returns false if rejected
+static bool exercise(size_t inputSize, AudioFile::IoMode ioMode) {
+    WaveFile file;
+    if (!file.open(inputPath, ioMode)) {
+        return false;
+    }
+    const uint64_t dataSize = file.getDataSize();
+    check(dataSize > 0 && dataSize <= inputSize, "data chunk size outside the file");
+    check(file.getBytesPerFrame() > 0, "no bytes per frame");
+    check(!file.getFormatInfo().empty(), "no format info");
+    file.getSampleFormat();
+
+    uint8_t buffer[kReadBytes];
+    uint64_t total = 0;
+    for (size_t count; (count = file.readAudioData(buffer, sizeof(buffer))) > 0;) {
+        check(count <= sizeof(buffer), "read more than asked");
+        total += count;
+    }
+    check(total == dataSize, "reads do not add up to the data chunk");
+
+    check(file.seekAudioData(dataSize / 2), "seek within the data chunk failed");
+    total = 0;
+    for (size_t count; (count = file.readAudioData(buffer, sizeof(buffer))) > 0;) {
+        total += count;
+    }
+    check(total == dataSize - dataSize / 2, "reads after a seek do not add up to the rest of the data chunk");
+
+    file.seekAudioData(dataSize + kReadBytes);
+    check(file.readAudioData(buffer, sizeof(buffer)) == 0, "read past the data chunk");
+
+    if (file.isMemoryMapped()) {
+        file.prefetchAudioData(0, static_cast<size_t>(dataSize), true);
+        file.seekAudioData(0);
+        total = 0;
+        const void* data = nullptr;
+        for (size_t count; (count = file.mapAudioData(&data, kReadBytes)) > 0;) {
+            // Touch both ends of every span, the sanitizers catch a span outside the mapping
+            volatile uint8_t first = static_cast<const uint8_t*>(data)[0];
+            volatile uint8_t last = static_cast<const uint8_t*>(data)[count - 1];
+            (void)first;
+            (void)last;
+            total += count;
+        }
+        check(total == dataSize, "mapped spans do not add up to the data chunk");
+    }
+    return true;
+}
+
+// Returns true if the input opened as a WAV file
+static bool runInput(const uint8_t* data, size_t size) {
+    if ((inputFd < 0 && !createInputFile()) || !writeInput(data, size)) {
+        abort();
+    }
+    bool opened = exercise(size, AudioFile::IoMode::Stream);
+    check(exercise(size, AudioFile::IoMode::MemoryMap) == opened, "opens in one I/O mode only");
+    return opened;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    runInput(data, size);
+    return 0;
+}
+
+#ifndef AAUDIO_PLAYER_LIBFUZZER
+
+namespace {
+
+/**
+ * Random WAVs shaped like real ones: RIFF/RF64 header, chunks of plausible and bogus sizes,
+ * fmt fields around the supported range, then byte flips, truncation or trailing garbage
+ */
+class WaveGenerator {
+public:
+    explicit WaveGenerator(uint64_t seed) : state_(seed ? seed : 1) {}
+
+    std::vector<uint8_t> next() {
+        bytes_.clear();
+        static const char* const kRiffIds[] = {"RIFF", "RIFF", "RIFF", "RF64", "BW64", "RIFX"};
+        putId(kRiffIds[below(6)]);
+        put32(below(4) == 0 ? static_cast<uint32_t>(nextRandom()) : 0); // Patched below unless bogus
+        putId(below(16) == 0 ? "WAVX" : "WAVE");
+
+        int32_t chunkCount = static_cast<int32_t>(below(7));
+        bool fmtFirst = below(4) != 0;
+        for (int32_t i = 0; i < chunkCount; i++) {
+            if (i == 0 && fmtFirst) {
+                putFmt();
+                continue;
+            }
+            switch (below(6)) {
+            case 0:
+                putFmt();
+                break;
+            case 1:
+                putDs64();
+                break;
+            case 2:
+                putData();
+                break;
+            default:
+                putOther();
+                break;
+            }
+        }
+        if (below(4) != 0) {
+            putData();
+        }
+        if (bytes_.size() >= 8 && below(4) != 0) {
+            patch32(4, static_cast<uint32_t>(bytes_.size() - 8));
+        }
+        mutate();
+        return bytes_;
+    }
+
+private:
+    uint64_t nextRandom() {
+        // xorshift64*
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 0x2545F4914F6CDD1DULL;
+    }
+
+    uint32_t below(uint32_t bound) { return static_cast<uint32_t>(nextRandom() % bound); }
+
+    void putId(const char* id) { bytes_.insert(bytes_.end(), id, id + 4); }
+
+    void put16(uint16_t value) {
+        bytes_.push_back(static_cast<uint8_t>(value));
+        bytes_.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void put32(uint32_t value) {
+        put16(static_cast<uint16_t>(value));
+        put16(static_cast<uint16_t>(value >> 16));
+    }
+
+    void put64(uint64_t value) {
+        put32(static_cast<uint32_t>(value));
+        put32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void patch32(size_t offset, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            bytes_[offset + static_cast<size_t>(i)] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void putFiller(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            bytes_.push_back(static_cast<uint8_t>(nextRandom()));
+        }
+    }
+
+    // Declared chunk size: mostly the real one, sometimes odd, short, huge or the RF64 placeholder
+    uint32_t declaredSize(uint32_t actual) {
+        switch (below(10)) {
+        case 0:
+            return 0xFFFFFFFF;
+        case 1:
+            return static_cast<uint32_t>(nextRandom());
+        case 2:
+            return actual > 0 ? actual - 1 : 0;
+        case 3:
+            return actual + 1 + below(64);
+        default:
+            return actual;
+        }
+    }
+
+    void putFmt() {
+        static const uint16_t kFormats[] = {WaveFile::kFormatPcm, WaveFile::kFormatIeeeFloat,
+                                            WaveFile::kFormatExtensible, 0, 2, 0x55};
+        static const uint16_t kBits[] = {8, 16, 24, 32, 64, 0, 12, 20};
+        static const uint32_t kRates[] = {8000, 44100, 48000, 96000, 192000, 0, 384000, 1};
+        // The supported values come first in each table and are picked most of the time
+        uint16_t format = kFormats[below(8) == 0 ? below(6) : below(3)];
+        uint16_t channels = static_cast<uint16_t>(below(4) == 0 ? below(40) : 1 + below(8));
+        uint16_t bits = kBits[below(8) == 0 ? below(8) : below(4)];
+        uint32_t rate = kRates[below(8) == 0 ? below(8) : below(5)];
+        if (below(8) == 0) {
+            rate = static_cast<uint32_t>(nextRandom());
+        }
+        uint32_t extra = format == WaveFile::kFormatExtensible ? 24 : (below(4) == 0 ? below(8) : 0);
+        if (below(8) == 0) {
+            extra = below(30);
+        }
+
+        putId("fmt ");
+        put32(below(12) == 0 ? below(20) : 16 + extra);
+        put16(format);
+        put16(channels);
+        put32(rate);
+        put32(rate * channels * (bits / 8));
+        put16(static_cast<uint16_t>(channels * (bits / 8)));
+        put16(bits);
+        if (format == WaveFile::kFormatExtensible && extra >= 24) {
+            static const uint8_t kGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                                  0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+            put16(22);
+            put16(below(4) == 0 ? static_cast<uint16_t>(below(40)) : bits);
+            put32(static_cast<uint32_t>(nextRandom()));
+            put16(below(3) == 0 ? WaveFile::kFormatIeeeFloat : WaveFile::kFormatPcm);
+            bytes_.insert(bytes_.end(), kGuidTail, kGuidTail + 14);
+            putFiller(extra - 24);
+        } else {
+            putFiller(extra);
+        }
+    }
+
+    void putDs64() {
+        putId("ds64");
+        uint32_t size = below(4) == 0 ? below(40) : 28;
+        put32(size);
+        put64(nextRandom());
+        put64(below(2) == 0 ? nextRandom() : below(1 << 20));
+        put64(nextRandom());
+        put32(0);
+    }
+
+    void putData() {
+        uint32_t actual = below(8) == 0 ? below(70000) : below(4096);
+        putId("data");
+        put32(declaredSize(actual));
+        putFiller(actual);
+    }
+
+    void putOther() {
+        static const char* const kIds[] = {"LIST", "JUNK", "bext", "fact", "cue ", "\0\0\0\0"};
+        uint32_t actual = below(8) == 0 ? below(20000) : below(64);
+        putId(kIds[below(6)]);
+        put32(declaredSize(actual));
+        putFiller(actual);
+        if (below(2) == 0 && actual % 2 == 1) {
+            bytes_.push_back(0);
+        }
+    }
+
+    void mutate() {
+        switch (below(5)) {
+        case 0: // Flip a few bytes, mostly within the headers
+            for (uint32_t flips = 1 + below(4); flips > 0 && !bytes_.empty(); flips--) {
+                size_t limit = below(2) == 0 ? std::min<size_t>(bytes_.size(), 128) : bytes_.size();
+                bytes_[below(static_cast<uint32_t>(limit))] ^= static_cast<uint8_t>(1 + below(255));
+            }
+            break;
+        case 1: // Truncate
+            bytes_.resize(below(static_cast<uint32_t>(bytes_.size() + 1)));
+            break;
+        case 2: // Trailing garbage
+            putFiller(below(300));
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint64_t state_;
+    std::vector<uint8_t> bytes_;
+};
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options] [input file]...\n"
+            "  -n <count>  Random WAVs to generate after the input files, default 10000\n"
+            "  -s <seed>   Seed of the generator, default 1\n"
+            "  -o <dir>    Also save each generated input as <dir>/<index>.wav, e.g. as a libFuzzer corpus\n"
+            "  -v          Keep the parser's log on stderr\n",
+            program);
+}
+
+bool readFile(const char* path, std::vector<uint8_t>* bytes) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    bytes->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long long count = 10000;
+    unsigned long long seed = 1;
+    std::string corpusDir;
+    bool verbose = false;
+
+    int index = 1;
+    for (; index < argc && argv[index][0] == '-'; index++) {
+        const char* option = argv[index];
+        const char* value = index + 1 < argc ? argv[index + 1] : nullptr;
+        if (strcmp(option, "-v") == 0) {
+            verbose = true;
+            continue;
+        }
+        if (!value) {
+            printUsage(argv[0]);
+            return 2;
+        }
+        if (strcmp(option, "-n") == 0) {
+            count = atoll(value);
+        } else if (strcmp(option, "-s") == 0) {
+            seed = strtoull(value, nullptr, 0);
+        } else if (strcmp(option, "-o") == 0) {
+            corpusDir = value;
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+        index++;
+    }
+
+    if (!createInputFile()) {
+        return 1;
+    }
+    // Every rejected input logs why, which would drown the report
+    if (!verbose) {
+        int null = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null >= 0) {
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+    }
+
+    for (; index < argc; index++) {
+        std::vector<uint8_t> bytes;
+        if (!readFile(argv[index], &bytes)) {
+            printf("%s: cannot read\n", argv[index]);
+            return 1;
+        }
+        printf("%s: %s\n", argv[index], runInput(bytes.data(), bytes.size()) ? "opened" : "rejected");
+    }
+
+    WaveGenerator generator(seed);
+    long long opened = 0;
+    for (long long i = 0; i < count; i++) {
+        std::vector<uint8_t> bytes = generator.next();
+        if (!corpusDir.empty()) {
+            std::ofstream(corpusDir + "/" + std::to_string(i) + ".wav", std::ios::binary)
+                .write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+        opened += runInput(bytes.data(), bytes.size()) ? 1 : 0;
+    }
+    printf("%lld generated inputs (seed %llu), %lld opened, no failures\n", count, seed, opened);
+    return 0;
+}
+
+#endif // AAUDIO_PLAYER_LIBFUZZER
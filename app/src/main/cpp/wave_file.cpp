@@ -0,0 +1,495 @@
+#include "wave_file.h"
+#include "audio_log.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-ahead window requested from the kernel in memory-mapped mode
+static constexpr size_t kMapReadAheadBytes = 2 * 1024 * 1024;
+
+// Bytes 2-15 of every KSDATAFORMAT_SUBTYPE GUID, bytes 0-1 carry the format code
+static constexpr uint8_t kSubFormatGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                                   0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+// Size fields of RF64 chunks that are replaced by the ds64 chunk
+static constexpr uint32_t kRf64SizePlaceholder = 0xFFFFFFFF;
+
+// ============================================================================
+// WaveFile Class Implementation
+// ============================================================================
+
+WaveFile::WaveFile() : header_{}, isOpen_(false) {}
+
+WaveFile::~WaveFile() noexcept { close(); }
+
+bool WaveFile::open(const std::string& filePath, IoMode ioMode) {
+    close(); // Ensure previous file is closed
+
+    file_.open(filePath, std::ios::binary);
+    if (!file_.is_open()) {
+        LOGE("Failed to open file: %s", filePath.c_str());
+        return false;
+    }
+
+    if (!readHeader()) {
+        LOGE("Failed to read WAV header from: %s", filePath.c_str());
+        close();
+        return false;
+    }
+
+    if (!isValidFormat()) {
+        LOGE("Invalid WAV format in file: %s", filePath.c_str());
+        close();
+        return false;
+    }
+
+    dataPosition_ = 0;
+    if (ioMode == IoMode::MemoryMap) {
+        if (mapDataChunk(filePath)) {
+            // Every read is served from the mapping from now on
+            file_.close();
+        } else {
+            LOGW("Memory mapping failed, falling back to stream reads: %s", filePath.c_str());
+        }
+    }
+
+    isOpen_ = true;
+    LOGI("Successfully opened WAV file: %s (%s)", filePath.c_str(), isMemoryMapped() ? "mmap" : "stream");
+    LOGI("Format: %s", getFormatInfo().c_str());
+
+    return true;
+}
+
+void WaveFile::close() {
+    if (file_.is_open()) {
+        file_.close();
+    }
+    mapping_.reset();
+    isOpen_ = false;
+    header_ = {};
+    dataOffset_ = 0;
+    dataPosition_ = 0;
+    isRf64_ = false;
+    ds64DataSize_ = 0;
+}
+
+size_t WaveFile::readAudioData(void* buffer, size_t bufferSize) {
+    if (!isOpen_ || !buffer || bufferSize == 0) {
+        return 0;
+    }
+
+    // Never read past the data chunk into trailing chunks
+    uint64_t remaining = header_.dataSize - std::min<uint64_t>(dataPosition_, header_.dataSize);
+    size_t actualReadSize = static_cast<size_t>(std::min<uint64_t>(bufferSize, remaining));
+    size_t bytesRead = 0;
+
+    if (isMemoryMapped()) {
+        memcpy(buffer, mapping_.data + dataPosition_, actualReadSize);
+        bytesRead = actualReadSize;
+        if (dataPosition_ / kMapReadAheadBytes != (dataPosition_ + bytesRead) / kMapReadAheadBytes) {
+            prefetchAudioData(dataPosition_ + bytesRead, kMapReadAheadBytes, false);
+        }
+    } else {
+        // Check if bufferSize exceeds maximum streamsize value
+        constexpr auto maxStreamSize = static_cast<size_t>(std::numeric_limits<std::streamsize>::max());
+        actualReadSize = std::min(actualReadSize, maxStreamSize);
+
+        auto readSize = static_cast<std::streamsize>(actualReadSize);
+        file_.read(static_cast<char*>(buffer), readSize);
+        bytesRead = static_cast<size_t>(file_.gcount());
+    }
+    dataPosition_ += bytesRead;
+
+    if (bytesRead < bufferSize) {
+        // If insufficient data is read, fill remaining part with zeros
+        memset(static_cast<char*>(buffer) + bytesRead, 0, bufferSize - bytesRead);
+    }
+
+    return bytesRead;
+}
+
+size_t WaveFile::mapAudioData(const void** data, size_t maxBytes) {
+    if (!isOpen_ || !isMemoryMapped() || !data) {
+        return 0;
+    }
+
+    uint64_t remaining = header_.dataSize - std::min<uint64_t>(dataPosition_, header_.dataSize);
+    size_t available = static_cast<size_t>(std::min<uint64_t>(maxBytes, remaining));
+    *data = mapping_.data + dataPosition_;
+    dataPosition_ += available;
+    return available;
+}
+
+bool WaveFile::seekAudioData(uint64_t offset) {
+    if (!isOpen_) {
+        return false;
+    }
+
+    offset = std::min<uint64_t>(offset, header_.dataSize);
+    if (!isMemoryMapped()) {
+        // Clears eof after a read that ran into the end of the file
+        file_.clear();
+        file_.seekg(static_cast<std::streamoff>(dataOffset_ + offset), std::ios::beg);
+        if (!file_) {
+            LOGE("Failed to seek to data offset %llu", static_cast<unsigned long long>(offset));
+            return false;
+        }
+    }
+    dataPosition_ = offset;
+    return true;
+}
+
+void WaveFile::prefetchAudioData(uint64_t offset, size_t length, bool populate) const {
+    if (!isMemoryMapped() || offset >= header_.dataSize) {
+        return;
+    }
+
+    length = static_cast<size_t>(std::min<uint64_t>(length, header_.dataSize - offset));
+    // madvise needs a page-aligned start address
+    auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto start = reinterpret_cast<uintptr_t>(mapping_.data + offset);
+    uintptr_t alignedStart = start & ~(pageSize - 1);
+    madvise(reinterpret_cast<void*>(alignedStart), length + (start - alignedStart), MADV_WILLNEED);
+
+    if (populate) {
+        // Fault every page in now, so a later reader never blocks on disk I/O
+        volatile uint8_t sink = 0;
+        for (uintptr_t page = alignedStart; page < start + length; page += pageSize) {
+            sink ^= *reinterpret_cast<const volatile uint8_t*>(std::max(page, start));
+        }
+        (void)sink;
+    }
+}
+
+bool WaveFile::mapDataChunk(const std::string& filePath) {
+    int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOGE("Failed to open file for mapping: %s", filePath.c_str());
+        return false;
+    }
+
+    // The header parse already clamped the data chunk to the file, guard against it shrinking since
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || static_cast<uint64_t>(st.st_size) < dataOffset_ + header_.dataSize) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap offsets must be page aligned, map from the page containing the data start
+    auto pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t alignedOffset = dataOffset_ & ~(pageSize - 1);
+    uint64_t length = header_.dataSize + (dataOffset_ - alignedOffset);
+    if (header_.dataSize == 0 || length > std::numeric_limits<size_t>::max()) {
+        ::close(fd);
+        return false;
+    }
+
+    void* base = mmap(nullptr, static_cast<size_t>(length), PROT_READ, MAP_PRIVATE, fd,
+                      static_cast<off_t>(alignedOffset));
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (base == MAP_FAILED) {
+        LOGW("mmap failed for %llu bytes", static_cast<unsigned long long>(length));
+        return false;
+    }
+
+    mapping_.reset();
+    mapping_.base = base;
+    mapping_.length = static_cast<size_t>(length);
+    mapping_.data = static_cast<const uint8_t*>(base) + (dataOffset_ - alignedOffset);
+
+    // Playback reads front to back: enable aggressive read-ahead and start paging in the head
+    madvise(mapping_.base, mapping_.length, MADV_SEQUENTIAL);
+    prefetchAudioData(0, kMapReadAheadBytes, false);
+    return true;
+}
+
+WaveFile::Mapping::Mapping(Mapping&& other) noexcept : base(other.base), length(other.length), data(other.data) {
+    other.base = nullptr;
+    other.length = 0;
+    other.data = nullptr;
+}
+
+WaveFile::Mapping& WaveFile::Mapping::operator=(Mapping&& other) noexcept {
+    if (this != &other) {
+        reset();
+        base = other.base;
+        length = other.length;
+        data = other.data;
+        other.base = nullptr;
+        other.length = 0;
+        other.data = nullptr;
+    }
+    return *this;
+}
+
+void WaveFile::Mapping::reset() {
+    if (base) {
+        munmap(base, length);
+    }
+    base = nullptr;
+    length = 0;
+    data = nullptr;
+}
+
+bool WaveFile::isOpen() const { return isOpen_; }
+
+SampleFormat WaveFile::getSampleFormat() const {
+    if (getFormatTag() == kFormatIeeeFloat) {
+        return SampleFormat::Float; // Played as is on a float stream
+    }
+
+    // Stream format based on WAV file bit depth
+    switch (header_.bitsPerSample) {
+    case 8:
+        return SampleFormat::U8;
+    case 16:
+        return SampleFormat::I16;
+    case 24:
+        return SampleFormat::I24Packed;
+    case 32:
+        return SampleFormat::I32;
+    default:
+        return SampleFormat::I16; // Default return 16-bit format
+    }
+}
+
+std::string WaveFile::getFormatInfo() const {
+    std::ostringstream oss;
+    oss << static_cast<int32_t>(header_.sampleRate) << "Hz, " << static_cast<int32_t>(header_.numChannels)
+        << " channels, " << static_cast<int32_t>(header_.bitsPerSample) << " bits, "
+        << (getFormatTag() == kFormatIeeeFloat ? "float" : "PCM");
+    if (header_.audioFormat == kFormatExtensible) {
+        oss << ", extensible (mask 0x" << std::hex << header_.channelMask << std::dec << ")";
+    }
+    if (isRf64_) {
+        oss << ", RF64";
+    }
+    return oss.str();
+}
+
+bool WaveFile::isValidFormat() const {
+    uint16_t formatTag = getFormatTag();
+    bool pcm = formatTag == kFormatPcm && (header_.bitsPerSample == 8 || header_.bitsPerSample == 16 ||
+                                           header_.bitsPerSample == 24 || header_.bitsPerSample == 32);
+    bool ieeeFloat = formatTag == kFormatIeeeFloat && header_.bitsPerSample == 32;
+    return ((pcm || ieeeFloat) &&                                     // Supported sample format and bit depth
+            header_.numChannels > 0 && header_.numChannels <= 16 &&   // Reasonable channel count
+            header_.sampleRate > 0 && header_.sampleRate <= 192000 && // Reasonable sample rate
+            header_.dataSize > 0);                                    // Has audio data
+}
+
+bool WaveFile::readHeader() {
+    // Every chunk the walker visits must lie inside the file
+    file_.seekg(0, std::ios::end);
+    fileSize_ = static_cast<uint64_t>(std::max<std::streamoff>(file_.tellg(), 0));
+    file_.seekg(0, std::ios::beg);
+    chunkCount_ = 0;
+    return validateRiffHeader() && readFmtChunk() && findDataChunk();
+}
+
+bool WaveFile::validateRiffHeader() {
+    // Read RIFF identifier
+    file_.read(header_.riffId, 4);
+    if (file_.gcount() != 4) {
+        LOGE("Invalid RIFF header");
+        return false;
+    }
+    // RF64 (EBU Tech 3306) and BW64 (ITU-R BS.2088) share the ds64 layout
+    isRf64_ = strncmp(header_.riffId, "RF64", 4) == 0 || strncmp(header_.riffId, "BW64", 4) == 0;
+    if (!isRf64_ && strncmp(header_.riffId, "RIFF", 4) != 0) {
+        LOGE("Invalid RIFF header");
+        return false;
+    }
+
+    // Read file size
+    file_.read(reinterpret_cast<char*>(&header_.riffSize), 4);
+    if (file_.gcount() != 4) {
+        LOGE("Failed to read RIFF size");
+        return false;
+    }
+
+    // Read WAVE identifier
+    file_.read(header_.waveId, 4);
+    if (file_.gcount() != 4 || strncmp(header_.waveId, "WAVE", 4) != 0) {
+        LOGE("Invalid WAVE header");
+        return false;
+    }
+
+    return true;
+}
+
+bool WaveFile::readFmtChunk() {
+    char chunkId[4];
+    uint32_t chunkSize;
+
+    // Find fmt subchunk
+    while (readChunkHeader(chunkId, &chunkSize)) {
+
+        if (strncmp(chunkId, "fmt ", 4) == 0) {
+            // Found fmt subchunk
+            if (chunkSize < 16) {
+                LOGE("fmt chunk too short: %u", chunkSize);
+                return false;
+            }
+            strncpy(header_.fmtId, chunkId, 4);
+
+            // Read fmt data
+            file_.read(reinterpret_cast<char*>(&header_.audioFormat), 2);
+            file_.read(reinterpret_cast<char*>(&header_.numChannels), 2);
+            file_.read(reinterpret_cast<char*>(&header_.sampleRate), 4);
+            file_.read(reinterpret_cast<char*>(&header_.byteRate), 4);
+            file_.read(reinterpret_cast<char*>(&header_.blockAlign), 2);
+            file_.read(reinterpret_cast<char*>(&header_.bitsPerSample), 2);
+            if (file_.gcount() != 2) {
+                LOGE("Failed to read fmt chunk");
+                return false;
+            }
+
+            uint32_t extraSize = chunkSize - 16;
+            if (header_.audioFormat == kFormatExtensible) {
+                return readFmtExtension(extraSize);
+            }
+
+            // Skip extra fmt data (if any)
+            return skipChunk(extraSize);
+        } else if (isRf64_ && strncmp(chunkId, "ds64", 4) == 0) {
+            if (!readDs64Chunk(chunkSize)) {
+                return false;
+            }
+        } else if (!skipChunk(chunkSize)) {
+            // Skip other subchunks
+            return false;
+        }
+    }
+
+    LOGE("fmt chunk not found");
+    return false;
+}
+
+bool WaveFile::findDataChunk() {
+    char chunkId[4];
+    uint32_t chunkSize;
+
+    // Find data subchunk
+    while (readChunkHeader(chunkId, &chunkSize)) {
+
+        if (strncmp(chunkId, "data", 4) == 0) {
+            // Found data subchunk
+            strncpy(header_.dataId, chunkId, 4);
+            header_.dataSize = chunkSize;
+            if (isRf64_ && chunkSize == kRf64SizePlaceholder) {
+                header_.dataSize = ds64DataSize_;
+            }
+            dataOffset_ = static_cast<uint64_t>(file_.tellg());
+
+            // Truncated files: only what is actually there can be played
+            uint64_t available = fileSize_ - dataOffset_;
+            if (available < header_.dataSize) {
+                LOGW("Data chunk truncated: header says %llu bytes, file has %llu",
+                     static_cast<unsigned long long>(header_.dataSize), static_cast<unsigned long long>(available));
+                header_.dataSize = available;
+            }
+
+            LOGD("Found data chunk: size = %llu bytes", static_cast<unsigned long long>(header_.dataSize));
+            return true;
+        } else if (!skipChunk(chunkSize)) {
+            // Skip other subchunks
+            return false;
+        }
+    }
+
+    LOGE("data chunk not found");
+    return false;
+}
+
+bool WaveFile::readDs64Chunk(uint32_t chunkSize) {
+    // riffSize, dataSize and sampleCount (64-bit each), then a table of other chunk sizes
+    if (chunkSize < 24) {
+        LOGE("ds64 chunk too short: %u", chunkSize);
+        return false;
+    }
+    uint64_t riffSize = 0;
+    file_.read(reinterpret_cast<char*>(&riffSize), 8);
+    file_.read(reinterpret_cast<char*>(&ds64DataSize_), 8);
+    if (file_.gcount() != 8) {
+        LOGE("Failed to read ds64 chunk");
+        return false;
+    }
+    return skipChunk(chunkSize - 16);
+}
+
+bool WaveFile::readFmtExtension(uint32_t extraSize) {
+    // cbSize, wValidBitsPerSample, dwChannelMask, SubFormat GUID
+    if (extraSize < 24) {
+        LOGE("Extensible fmt chunk too short: %u extra bytes", extraSize);
+        return false;
+    }
+    uint16_t extensionSize = 0;
+    uint8_t guid[16];
+    file_.read(reinterpret_cast<char*>(&extensionSize), 2);
+    file_.read(reinterpret_cast<char*>(&header_.validBitsPerSample), 2);
+    file_.read(reinterpret_cast<char*>(&header_.channelMask), 4);
+    file_.read(reinterpret_cast<char*>(guid), 16);
+    if (file_.gcount() != 16) {
+        LOGE("Failed to read extensible fmt chunk");
+        return false;
+    }
+
+    // Only the KSDATAFORMAT_SUBTYPE_* GUIDs map to a format code, anything else stays unsupported
+    header_.subFormat = 0;
+    if (memcmp(guid + 2, kSubFormatGuidTail, sizeof(kSubFormatGuidTail)) == 0) {
+        header_.subFormat = static_cast<uint16_t>(guid[0] | (guid[1] << 8));
+    }
+    if (header_.validBitsPerSample > header_.bitsPerSample) {
+        LOGW("Valid bits %u exceed the %u-bit container, ignored", header_.validBitsPerSample,
+             header_.bitsPerSample);
+    }
+
+    return skipChunk(extraSize - 24);
+}
+
+bool WaveFile::readChunkHeader(char* chunkId, uint32_t* chunkSize) {
+    // A file of nothing but empty chunks must not keep the parser seeking forever
+    if (++chunkCount_ > kMaxChunks) {
+        LOGE("No fmt or data chunk within the first %d chunks", kMaxChunks);
+        return false;
+    }
+
+    // Running out of chunks ends the search, the caller reports what is missing
+    std::streamoff position = file_.tellg();
+    if (!file_ || position < 0 || static_cast<uint64_t>(position) + 8 > fileSize_) {
+        return false;
+    }
+
+    file_.read(chunkId, 4);
+    file_.read(reinterpret_cast<char*>(chunkSize), 4);
+    return file_.gcount() == 4;
+}
+
+bool WaveFile::skipChunk(uint32_t chunkSize) {
+    std::streamoff position = file_.tellg();
+    if (!file_ || position < 0) {
+        LOGE("Failed to read chunk");
+        return false;
+    }
+
+    // Seeking past the end succeeds on a stream, so bound the chunk by the file size instead
+    uint64_t end = static_cast<uint64_t>(position) + chunkSize;
+    if (end > fileSize_) {
+        LOGE("Chunk size %u runs past the end of the file", chunkSize);
+        return false;
+    }
+
+    // WAV files require subchunk size to be even, if odd need to skip one padding byte
+    // (often missing after the last chunk)
+    if (chunkSize % 2 == 1 && end < fileSize_) {
+        end++;
+    }
+    file_.seekg(static_cast<std::streamoff>(end), std::ios::beg);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,255 @@
+#ifndef WAVE_FILE_H
+#define WAVE_FILE_H
+
+#include "audio_file.h"
+#include "audio_format.h"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * WAV file management class
+ * Supports WAV file reading, parsing and audio data extraction
+ *
+ * Integer PCM and 32-bit IEEE float, in the plain or WAVE_FORMAT_EXTENSIBLE
+ * fmt chunk, and RF64/BW64 files whose data chunk size comes from the ds64
+ * chunk. Samples are served in the format they are stored.
+ */
+class WaveFile : public AudioFile {
+public:
+    // Format codes of the fmt chunk
+    static constexpr uint16_t kFormatPcm = 1;
+    static constexpr uint16_t kFormatIeeeFloat = 3;
+    static constexpr uint16_t kFormatExtensible = 0xFFFE;
+
+    // WAV file header structure
+    struct WaveHeader {
+        // RIFF header
+        char riffId[4];    // "RIFF", or "RF64"/"BW64" with 64-bit sizes in ds64
+        uint32_t riffSize; // File size - 8
+        char waveId[4];    // "WAVE"
+
+        // fmt subchunk
+        char fmtId[4];          // "fmt "
+        uint16_t audioFormat;   // Audio format (1 = PCM, 3 = IEEE float, 0xFFFE = extensible)
+        uint16_t numChannels;   // Channel count
+        uint32_t sampleRate;    // Sample rate
+        uint32_t byteRate;      // Byte rate
+        uint16_t blockAlign;    // Block align
+        uint16_t bitsPerSample; // Bits per sample
+
+        // WAVE_FORMAT_EXTENSIBLE extension
+        uint16_t validBitsPerSample; // Significant bits in each sample container
+        uint32_t channelMask;        // Speaker positions, 0 if unspecified
+        uint16_t subFormat;          // Format code taken from the SubFormat GUID
+
+        // data subchunk
+        char dataId[4];    // "data"
+        uint64_t dataSize; // Audio data size, from ds64 in RF64 files
+    };
+
+    /**
+     * Constructor
+     */
+    WaveFile();
+
+    /**
+     * Destructor
+     */
+    ~WaveFile() noexcept override;
+
+    // Disable copy and assignment
+    WaveFile(const WaveFile&) = delete;
+    WaveFile& operator=(const WaveFile&) = delete;
+
+    // Allow move
+    WaveFile(WaveFile&&) noexcept = default;
+    WaveFile& operator=(WaveFile&&) noexcept = default;
+
+    /**
+     * Open WAV file
+     * If memory mapping fails the file falls back to stream reads.
+     * @param filePath File path
+     * @param ioMode Preferred I/O backend
+     * @return Returns true on success, false on failure
+     */
+    bool open(const std::string& filePath, IoMode ioMode = IoMode::MemoryMap) override;
+
+    /**
+     * Close file
+     */
+    void close() override;
+
+    /**
+     * Read audio data
+     * @param buffer Data buffer
+     * @param bufferSize Buffer size (bytes)
+     * @return Actual bytes read
+     */
+    size_t readAudioData(void* buffer, size_t bufferSize) override;
+
+    /**
+     * Get audio data in place from the mapping, without copying (memory-mapped mode only)
+     * Advances the read position like readAudioData().
+     * @param data Receives a pointer into the mapped data chunk
+     * @param maxBytes Maximum bytes wanted
+     * @return Bytes available at *data, 0 at end of data or if not memory-mapped
+     */
+    size_t mapAudioData(const void** data, size_t maxBytes) override;
+
+    /**
+     * Move the read position within the data chunk
+     * Memory-mapped mode only moves the position and is real-time safe, stream mode seeks the file.
+     * @param offset Byte offset within the data chunk, clamped to its size
+     * @return Returns false if not open or the file cannot seek
+     */
+    bool seekAudioData(uint64_t offset) override;
+
+    /**
+     * Get the read position within the data chunk, in bytes
+     */
+    uint64_t getDataPosition() const override { return dataPosition_; }
+
+    /**
+     * Ask the kernel to page in part of the data chunk ahead of use (memory-mapped mode only)
+     * Does not move the read position and may be called from another thread.
+     * @param offset Byte offset within the data chunk
+     * @param length Byte count
+     * @param populate Also touch every page, blocking until the range is resident
+     */
+    void prefetchAudioData(uint64_t offset, size_t length, bool populate) const override;
+
+    bool isOpen() const override;
+    bool isMemoryMapped() const override { return mapping_.data != nullptr; }
+    uint64_t getDataSize() const override { return header_.dataSize; }
+
+    // Safe getter methods
+    int32_t getSampleRate() const override { return static_cast<int32_t>(header_.sampleRate); }
+    int32_t getChannelCount() const override { return static_cast<int32_t>(header_.numChannels); }
+    int32_t getBytesPerFrame() const override {
+        return static_cast<int32_t>(header_.numChannels) * static_cast<int32_t>(header_.bitsPerSample / 8);
+    }
+
+    /**
+     * Get the sample format stored in the file
+     * @return Sample format, U8 for 8-bit files
+     */
+    SampleFormat getSampleFormat() const override;
+
+    std::string getFormatInfo() const override;
+
+    /**
+     * Get the format code of the samples, the SubFormat of an extensible file
+     * @return kFormatPcm or kFormatIeeeFloat for supported files
+     */
+    uint16_t getFormatTag() const {
+        return header_.audioFormat == kFormatExtensible ? header_.subFormat : header_.audioFormat;
+    }
+
+    /**
+     * Get the speaker positions of an extensible file (WAVE_FORMAT_EXTENSIBLE dwChannelMask)
+     * @return Channel mask, 0 if the file does not specify one
+     */
+    uint32_t getChannelMask() const { return header_.channelMask; }
+
+    /**
+     * Check whether the file is RF64/BW64, with its sizes taken from the ds64 chunk
+     */
+    bool isRf64() const { return isRf64_; }
+
+    /**
+     * Validate WAV file format
+     * @return Returns true if format is correct
+     */
+    bool isValidFormat() const;
+
+private:
+    // Chunks readHeader() visits at most while looking for fmt and data
+    static constexpr int32_t kMaxChunks = 1024;
+
+    // Owned mmap of the data chunk, movable so WaveFile stays movable
+    struct Mapping {
+        void* base = nullptr;          // Page-aligned start of the mapping
+        size_t length = 0;             // Mapped length
+        const uint8_t* data = nullptr; // Start of the data chunk inside the mapping
+
+        Mapping() = default;
+        Mapping(Mapping&& other) noexcept;
+        Mapping& operator=(Mapping&& other) noexcept;
+        ~Mapping() noexcept { reset(); }
+        void reset();
+    };
+
+    std::ifstream file_;
+    WaveHeader header_{};
+    bool isOpen_;
+    uint64_t dataOffset_ = 0;   // File offset of the data chunk payload
+    uint64_t dataPosition_ = 0; // Bytes consumed from the data chunk
+    uint64_t fileSize_ = 0;     // Bounds the chunk walk of readHeader()
+    int32_t chunkCount_ = 0;    // Chunks visited by readHeader()
+    bool isRf64_ = false;
+    uint64_t ds64DataSize_ = 0; // Data chunk size from the ds64 chunk of an RF64 file
+    Mapping mapping_;
+
+    /**
+     * Map the data chunk of an opened file
+     * @return Returns true on success
+     */
+    bool mapDataChunk(const std::string& filePath);
+
+    /**
+     * Read and validate WAV file header
+     * @return Returns true on success
+     */
+    bool readHeader();
+
+    /**
+     * Validate RIFF header
+     * @return Returns true if validation passes
+     */
+    bool validateRiffHeader();
+
+    /**
+     * Find and read fmt subchunk
+     * @return Returns true on success
+     */
+    bool readFmtChunk();
+
+    /**
+     * Read the 64-bit sizes of an RF64 file
+     * @param chunkSize ds64 chunk size
+     * @return Returns true on success
+     */
+    bool readDs64Chunk(uint32_t chunkSize);
+
+    /**
+     * Read the WAVE_FORMAT_EXTENSIBLE part of the fmt chunk
+     * @param extraSize Bytes of the fmt chunk after the basic 16
+     * @return Returns true on success
+     */
+    bool readFmtExtension(uint32_t extraSize);
+
+    /**
+     * Find and locate data subchunk
+     * @return Returns true on success
+     */
+    bool findDataChunk();
+
+    /**
+     * Read the next subchunk header
+     * @param chunkId Receives the 4-character chunk ID
+     * @param chunkSize Receives the chunk size
+     * @return Returns false at the end of the file, on a read error or after kMaxChunks chunks
+     */
+    bool readChunkHeader(char* chunkId, uint32_t* chunkSize);
+
+    /**
+     * Skip unknown subchunks
+     * @param chunkSize Subchunk size
+     * @return Returns false if the chunk runs past the end of the file
+     */
+    bool skipChunk(uint32_t chunkSize);
+};
+
+#endif // WAVE_FILE_H
@@ -4,9 +4,13 @@ import android.content.Context
 import android.media.AudioAttributes
 import android.media.AudioFocusRequest
 import android.media.AudioManager
+import android.os.Build
 import android.util.Log
 import com.example.aaudioplayer.common.AAudioConstants
 import com.example.aaudioplayer.config.AAudioConfig
+import java.lang.invoke.VarHandle
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 
 /**
  * AAudio Player - supports audio focus management
@@ -14,6 +18,19 @@ import com.example.aaudioplayer.config.AAudioConfig
 class AAudioPlayer(context: Context) {
     companion object {
         private const val TAG = "AAudioPlayer"
+
+        /** Stream channel count follows the file (framework remixes if needed) */
+        const val CHANNELS_OF_FILE = 0
+        /** Stream opens at the device's native channel count, the file is remixed natively */
+        const val CHANNELS_OF_DEVICE = -1
+
+        /** File extensions the native layer can decode */
+        private val SUPPORTED_EXTENSIONS = listOf(".wav", ".flac")
+
+        private fun isSupportedAudioFile(path: String): Boolean {
+            val lowerPath = path.lowercase()
+            return SUPPORTED_EXTENSIONS.any { lowerPath.endsWith(it) }
+        }
         
         init {
             try {
@@ -30,11 +47,153 @@ class AAudioPlayer(context: Context) {
         fun onPlaybackStopped()
         fun onPlaybackError(error: String)
     }
+
+    /**
+     * Prefetch ring counters of the current playback
+     */
+    data class PrefetchStats(
+        val underflowCount: Long,
+        val underflowBytes: Long,
+        val refillCount: Long,
+        val maxRefillLagNs: Long,
+        val totalRefillLagNs: Long,
+        val bytesPrefetched: Long,
+        val fillLevel: Long,
+        val capacity: Long
+    )
+
+    /**
+     * Percentiles of one per-callback measurement
+     */
+    data class Distribution(val p50: Long, val p99: Long, val p999: Long, val max: Long)
+
+    /**
+     * Audio callback timing of the current playback, used to tune buffer sizes per device
+     */
+    data class CallbackStats(
+        val callbackCount: Long,
+        val deadlineMisses: Long,
+        val xruns: Long,
+        val framesPerBurst: Long,
+        val bufferSizeInFrames: Long,
+        val durationNs: Distribution,
+        val intervalJitterNs: Distribution,
+        val framesRequested: Distribution
+    )
+
+    /**
+     * One change between queued tracks; gapFrames is the silence between them in stream frames
+     */
+    data class TrackTransition(
+        val fromIndex: Int,
+        val toIndex: Int,
+        val gapFrames: Long,
+        val gapless: Boolean
+    )
+
+    /**
+     * Time from seek() to the first callback playing the new position
+     */
+    data class SeekLatency(val count: Long, val latencyNs: Distribution)
+
+    /**
+     * Stream pool counters; start latency is play() to first callback, split by warm (pooled) and new streams
+     */
+    data class StreamPoolStats(
+        val warmOpens: Long,
+        val coldOpens: Long,
+        val reaped: Long,
+        val discarded: Long,
+        val idleCount: Long,
+        val warmStartCount: Long,
+        val warmStartNs: Distribution,
+        val coldStartCount: Long,
+        val coldStartNs: Distribution
+    )
+
+    /**
+     * Adaptive buffer size state of the current (or last) stream; sizes in frames
+     */
+    data class BufferTuningStats(
+        val grows: Long,
+        val shrinks: Long,
+        val xruns: Long,
+        val bufferSizeInFrames: Long,
+        val minFrames: Long,
+        val maxFrames: Long,
+        val stablePeriodMs: Long
+    )
+
+    /**
+     * One buffer size change; grown after an underrun, otherwise shrunk after a stable period
+     */
+    data class BufferTuningDecision(
+        val timeNs: Long,
+        val xruns: Int,
+        val fromFrames: Int,
+        val toFrames: Int,
+        val grown: Boolean
+    )
+
+    /**
+     * Output latency (write to presentation) and device clock drift estimated from stream timestamps
+     * Standard deviations are over individual samples; rejected counts timestamps that jumped
+     */
+    data class LatencyStats(
+        val latencySamples: Long,
+        val latencyMeanMs: Double,
+        val latencyStdDevMs: Double,
+        val latencyMinMs: Double,
+        val latencyMaxMs: Double,
+        val driftSamples: Long,
+        val driftMeanPpm: Double,
+        val driftStdDevPpm: Double,
+        val rejected: Long
+    )
+
+    /**
+     * One latency marker: its edge is at stream frame [frame], [offset] frames into the buffer
+     * written when the trigger fired at [timeNs] (CLOCK_MONOTONIC); [level] is the trigger level after it
+     */
+    data class LatencyMarkerEvent(
+        val index: Long,
+        val frame: Long,
+        val offset: Int,
+        val level: Int,
+        val timeNs: Long
+    )
+
+    /**
+     * Time from play() to the first audio callback; totalNs / count is the average
+     */
+    data class FirstFrameTiming(val count: Long, val totalNs: Long, val maxNs: Long)
+
+    /**
+     * Clip cache counters, with time-to-first-frame split by where the data came from
+     */
+    data class ClipCacheStats(
+        val hits: Long,
+        val misses: Long,
+        val evictions: Long,
+        val bypasses: Long,
+        val bytesUsed: Long,
+        val budgetBytes: Long,
+        val clipCount: Long,
+        val firstFrameHit: FirstFrameTiming,
+        val firstFrameMiss: FirstFrameTiming,
+        val firstFrameStream: FirstFrameTiming
+    )
     
     private var audioManager: AudioManager = context.getSystemService(Context.AUDIO_SERVICE) as AudioManager
     private var currentConfig: AAudioConfig = AAudioConfig()
     private var listener: PlaybackListener? = null
+    // Written from the caller's thread and from native callbacks, which arrive on the engine's dispatcher thread
+    @Volatile
     private var isPlaying = false
+
+    // Opaque handle of this player's native engine, every instance plays independently
+    private var nativeHandle: Long = 0L
+    private var levelMeter: LevelMeterReader? = null
     
     // Audio focus related
     private var audioFocusRequest: AudioFocusRequest? = null
@@ -64,9 +223,13 @@ class AAudioPlayer(context: Context) {
 
     init {
         // Initialize native layer, pass default configuration
-        initializeNative(currentConfig.audioFilePath)
+        nativeHandle = initializeNative(currentConfig.audioFilePath)
+        if (nativeHandle == 0L) {
+            Log.e(TAG, "Failed to create native player")
+        }
         // Set default configuration with integer values
         setNativeConfig(
+            nativeHandle,
             AAudioConstants.getUsage(currentConfig.usage),
             AAudioConstants.getContentType(currentConfig.contentType),
             AAudioConstants.getPerformanceMode(currentConfig.performanceMode),
@@ -119,6 +282,7 @@ class AAudioPlayer(context: Context) {
         
         // Update native layer configuration with integer values
         setNativeConfig(
+            nativeHandle,
             AAudioConstants.getUsage(currentConfig.usage),
             AAudioConstants.getContentType(currentConfig.contentType),
             AAudioConstants.getPerformanceMode(currentConfig.performanceMode),
@@ -142,14 +306,14 @@ class AAudioPlayer(context: Context) {
             listener?.onPlaybackError(error)
             return false
         }
-        if (!audioPath.lowercase().endsWith(".wav")) {
-            val error = "Invalid audio file path: must end with .wav"
+        if (!isSupportedAudioFile(audioPath)) {
+            val error = "Invalid audio file path: must end with .wav or .flac"
             Log.e(TAG, error)
             listener?.onPlaybackError(error)
             return false
         }
         
-        stopNativePlayback() // Ensure previous playback is stopped first
+        stopNativePlayback(nativeHandle) // Ensure previous playback is stopped first
         
         // Request audio focus
         if (!requestAudioFocus()) {
@@ -160,8 +324,10 @@ class AAudioPlayer(context: Context) {
         
         Log.d(TAG, "Starting playback with config: ${currentConfig.description}")
         
-        val result = startNativePlayback()
-        if (!result) {
+        val result = startNativePlayback(nativeHandle)
+        if (result) {
+            isPlaying = true // The started callback follows asynchronously
+        } else {
             abandonAudioFocus()
         }
         return result
@@ -176,36 +342,528 @@ class AAudioPlayer(context: Context) {
         
         Log.d(TAG, "Stopping playback")
         
-        stopNativePlayback()
+        stopNativePlayback(nativeHandle)
+        isPlaying = false
         abandonAudioFocus() // Release focus when stopping playback
-        // Status update will be handled through native callback
+        // Listener is notified through the native callback
         return true
     }
     
     fun isPlaying(): Boolean {
         return isPlaying
     }
+
+    /**
+     * Configure the native prefetch ring, takes effect on the next play()
+     */
+    fun setPrefetchConfig(depthMs: Int, lowWaterPercent: Int, highWaterPercent: Int): Boolean {
+        return setNativePrefetchConfig(nativeHandle, depthMs, lowWaterPercent, highWaterPercent)
+    }
+
+    /**
+     * Choose between memory-mapped (default) and stream WAV reads, takes effect on the next play()
+     * FLAC files are always streamed through the decoder.
+     */
+    fun setMemoryMapped(enabled: Boolean) {
+        setNativeMemoryMapped(nativeHandle, enabled)
+    }
+
+    /**
+     * Resampler tiers, higher costs more CPU per frame
+     */
+    enum class ResamplerQuality { LOW, MEDIUM, HIGH }
+
+    /**
+     * Open the stream at the device's native rate and resample in-process, takes effect on the next play()
+     */
+    fun setResampler(enabled: Boolean, quality: ResamplerQuality = ResamplerQuality.MEDIUM) {
+        setNativeResampler(nativeHandle, enabled, quality.ordinal)
+    }
+
+    /**
+     * Select the stream channel count and how the file is remixed to it, takes effect on the next play()
+     * @param channelCount CHANNELS_OF_FILE, CHANNELS_OF_DEVICE or 1..16
+     * @param matrix Output channels x file channels gains (row-major), null for the preset downmix
+     */
+    fun setChannelMapping(channelCount: Int, matrix: FloatArray? = null): Boolean {
+        return setNativeChannelMapping(nativeHandle, channelCount, matrix)
+    }
+
+    fun getPrefetchStats(): PrefetchStats {
+        val values = getNativePrefetchStats(nativeHandle) ?: LongArray(8)
+        return PrefetchStats(
+            values[0], values[1], values[2], values[3],
+            values[4], values[5], values[6], values[7]
+        )
+    }
     
+    /**
+     * Mix another WAV or FLAC file into the current playback, resampled and remixed as needed
+     * @return Layer id, or -1 if it could not be added
+     */
+    fun addLayer(audioPath: String, gain: Float = 1.0f): Int {
+        if (!isPlaying) {
+            Log.w(TAG, "Cannot add layer, not playing")
+            return -1
+        }
+        return addNativeLayer(nativeHandle, audioPath, gain)
+    }
+
+    fun removeLayer(layerId: Int): Boolean {
+        return removeNativeLayer(nativeHandle, layerId)
+    }
+
+    fun setLayerGain(layerId: Int, gain: Float): Boolean {
+        return setNativeLayerGain(nativeHandle, layerId, gain)
+    }
+
+    /**
+     * Queue a WAV or FLAC file to follow the current playback without a gap
+     * @return false if not playing or the path is not a WAV or FLAC file
+     */
+    fun enqueue(audioPath: String): Boolean {
+        if (!isPlaying) {
+            Log.w(TAG, "Cannot queue track, not playing")
+            return false
+        }
+        if (!isSupportedAudioFile(audioPath)) {
+            Log.e(TAG, "Invalid audio file path: must end with .wav or .flac")
+            return false
+        }
+        return enqueueNativeTrack(nativeHandle, audioPath)
+    }
+
+    fun clearQueue() {
+        clearNativeQueue(nativeHandle)
+    }
+
+    fun getTransitions(): List<TrackTransition> {
+        val values = getNativeTransitions(nativeHandle) ?: return emptyList()
+        return (values.indices step 4).map { i ->
+            TrackTransition(values[i].toInt(), values[i + 1].toInt(), values[i + 2], values[i + 3] != 0L)
+        }
+    }
+
+    /**
+     * Continue the playing file from a frame, with a short fade instead of a click
+     * @param frame Frame index at the file's sample rate; at or past the end finishes the file
+     * @return false if not playing
+     */
+    fun seek(frame: Long): Boolean {
+        if (!isPlaying) {
+            Log.w(TAG, "Cannot seek, not playing")
+            return false
+        }
+        return seekNative(nativeHandle, frame)
+    }
+
+    /**
+     * Frame of the playing file reached so far; right after seek() its target
+     */
+    fun getPosition(): Long {
+        return getNativePosition(nativeHandle)
+    }
+
+    fun getSeekLatency(): SeekLatency {
+        val values = getNativeSeekLatency(nativeHandle) ?: LongArray(5)
+        return SeekLatency(values[0], Distribution(values[1], values[2], values[3], values[4]))
+    }
+
+    /**
+     * Open the stream for the current configuration now, so the next play() only has to start it
+     * @return false if playing or the file or stream could not be opened
+     */
+    fun prewarm(): Boolean {
+        if (isPlaying) {
+            return false
+        }
+        return prewarmNativeStream(nativeHandle)
+    }
+
+    /**
+     * Keep up to maxIdleStreams stopped streams open between plays; 0 closes streams on stop
+     * @param idleTimeoutMs Idle time before a shared low-latency stream is closed
+     * @param powerSavingIdleTimeoutMs Idle time before any other stream is closed
+     */
+    fun setStreamPool(maxIdleStreams: Int, idleTimeoutMs: Int = 10000, powerSavingIdleTimeoutMs: Int = 2000): Boolean {
+        return setNativeStreamPool(nativeHandle, maxIdleStreams, idleTimeoutMs, powerSavingIdleTimeoutMs)
+    }
+
+    fun getStreamPoolStats(): StreamPoolStats {
+        val values = getNativeStreamPoolStats(nativeHandle) ?: LongArray(15)
+        return StreamPoolStats(
+            values[0], values[1], values[2], values[3], values[4],
+            values[5], Distribution(values[6], values[7], values[8], values[9]),
+            values[10], Distribution(values[11], values[12], values[13], values[14])
+        )
+    }
+
+    /**
+     * Limit the memory used by cached short files; 0 budget disables the cache
+     */
+    fun setClipCacheLimits(budgetBytes: Long, maxClipBytes: Long): Boolean {
+        return setNativeClipCacheLimits(nativeHandle, budgetBytes, maxClipBytes)
+    }
+
+    /**
+     * Decode a short WAV or FLAC file into memory so its first play() skips the file system
+     * @return false if the file is unreadable or larger than the per-clip limit
+     */
+    fun preloadClip(audioPath: String): Boolean {
+        if (!isSupportedAudioFile(audioPath)) {
+            Log.e(TAG, "Invalid audio file path: must end with .wav or .flac")
+            return false
+        }
+        return preloadNativeClip(nativeHandle, audioPath)
+    }
+
+    fun clearClipCache() {
+        clearNativeClipCache(nativeHandle)
+    }
+
+    fun getClipCacheStats(): ClipCacheStats {
+        val values = getNativeClipCacheStats(nativeHandle) ?: LongArray(16)
+        return ClipCacheStats(
+            values[0], values[1], values[2], values[3], values[4], values[5], values[6],
+            FirstFrameTiming(values[7], values[8], values[9]),
+            FirstFrameTiming(values[10], values[11], values[12]),
+            FirstFrameTiming(values[13], values[14], values[15])
+        )
+    }
+
+    /**
+     * Grow the stream buffer by one burst on underruns, shrink it after stablePeriodMs without any
+     * Applies from the next play(); 0 bursts use the opened size as floor and the capacity as ceiling
+     */
+    fun setBufferTuning(enabled: Boolean, stablePeriodMs: Int = 5000, minBursts: Int = 0, maxBursts: Int = 0): Boolean {
+        return setNativeBufferTuning(nativeHandle, enabled, stablePeriodMs, minBursts, maxBursts)
+    }
+
+    fun getBufferTuningStats(): BufferTuningStats {
+        val values = getNativeBufferTuningStats(nativeHandle) ?: LongArray(7)
+        return BufferTuningStats(values[0], values[1], values[2], values[3], values[4], values[5], values[6])
+    }
+
+    fun getBufferTuningTrace(): List<BufferTuningDecision> {
+        val values = getNativeBufferTuningTrace(nativeHandle) ?: return emptyList()
+        return (values.indices step 5).map { i ->
+            BufferTuningDecision(
+                values[i], values[i + 1].toInt(), values[i + 2].toInt(), values[i + 3].toInt(), values[i + 4] != 0L
+            )
+        }
+    }
+
+    /**
+     * Sample stream timestamps every sampleIntervalMs and log a latency summary every logIntervalMs
+     * (0 only logs when the stream closes); applies from the next play()
+     */
+    fun setLatencyEstimation(enabled: Boolean, sampleIntervalMs: Int = 100, logIntervalMs: Int = 10000): Boolean {
+        return setNativeLatencyEstimation(nativeHandle, enabled, sampleIntervalMs, logIntervalMs)
+    }
+
+    /**
+     * Latency and drift since the last play(), safe to poll while playing
+     */
+    fun getLatencyStats(): LatencyStats {
+        val values = getNativeLatencyStats(nativeHandle) ?: DoubleArray(9)
+        return LatencyStats(
+            values[0].toLong(), values[1], values[2], values[3], values[4],
+            values[5].toLong(), values[6], values[7], values[8].toLong()
+        )
+    }
+
+    /**
+     * Marker written into the output every period; it replaces the program audio
+     */
+    enum class LatencyMarkerType { MUTE_WINDOW, CLICK, TONE_BURST }
+
+    /**
+     * Signal fired with every marker: MEMORY only records it, SYSFS_GPIO writes 1/0 to triggerPath,
+     * FD writes 1/0 to triggerFd, PIPE writes a binary event (index, frame, offset, level, timeNs) to triggerFd
+     */
+    enum class LatencyMarkerTrigger { MEMORY, SYSFS_GPIO, FD, PIPE }
+
+    /**
+     * Place latency markers in the output, takes effect on the next play()
+     * triggerFd is duplicated by play(), keep it open until then
+     * @param durationMs Mute window or tone burst length, at most half the period
+     */
+    fun setLatencyMarker(
+        enabled: Boolean,
+        type: LatencyMarkerType = LatencyMarkerType.MUTE_WINDOW,
+        trigger: LatencyMarkerTrigger = LatencyMarkerTrigger.SYSFS_GPIO,
+        triggerPath: String = "/sys/class/gpio/gpio376/value",
+        triggerFd: Int = -1,
+        periodMs: Int = 1000,
+        durationMs: Int = 50
+    ): Boolean {
+        return setNativeLatencyMarker(
+            nativeHandle, enabled, type.ordinal, trigger.ordinal, triggerPath, triggerFd, periodMs, durationMs
+        )
+    }
+
+    /**
+     * Markers of the current (or last) stream, oldest first
+     */
+    fun getLatencyMarkers(): List<LatencyMarkerEvent> {
+        val values = getNativeLatencyMarkers(nativeHandle) ?: return emptyList()
+        return (values.indices step 5).map { i ->
+            LatencyMarkerEvent(values[i], values[i + 1], values[i + 2].toInt(), values[i + 3].toInt(), values[i + 4])
+        }
+    }
+
+    /**
+     * Fade shape for start and stop; EXPONENTIAL moves in equal dB steps down to -60 dB
+     */
+    enum class FadeShape { LINEAR, EXPONENTIAL }
+
+    enum class EqFilterType { LOW_PASS, HIGH_PASS, PEAKING, LOW_SHELF, HIGH_SHELF }
+
+    /**
+     * EQ band, gainDb only applies to PEAKING and the shelves
+     */
+    data class EqBand(
+        val type: EqFilterType,
+        val frequencyHz: Float,
+        val q: Float = 0.7071f,
+        val gainDb: Float = 0.0f
+    )
+
+    /**
+     * Fades around play() and stop() and the output EQ, takes effect on the next play()
+     * @param startFadeMs Fade in when playback starts, 0 starts at full level
+     * @param stopFadeMs Fade out before playback stops, 0 cuts; stop() waits for it
+     * @param bands At most 8 bands, each below half the stream sample rate
+     */
+    fun setDspChain(
+        startFadeMs: Int = 10,
+        stopFadeMs: Int = 20,
+        fadeShape: FadeShape = FadeShape.LINEAR,
+        bands: List<EqBand> = emptyList()
+    ): Boolean {
+        val values = FloatArray(bands.size * 4)
+        bands.forEachIndexed { i, band ->
+            values[i * 4] = band.type.ordinal.toFloat()
+            values[i * 4 + 1] = band.frequencyHz
+            values[i * 4 + 2] = band.q
+            values[i * 4 + 3] = band.gainDb
+        }
+        return setNativeDspChain(nativeHandle, startFadeMs, stopFadeMs, fadeShape.ordinal, values)
+    }
+
+    /**
+     * Output gain (linear), ramped while playing and kept for later playbacks
+     */
+    fun setGain(gain: Float) {
+        setNativeGain(nativeHandle, gain)
+    }
+
+    /**
+     * Live output levels, read in place from the native level meter without a JNI call or allocation
+     * The buffer mirrors LevelMeter::Region and is written by the audio thread under a seqlock.
+     * Poll it from one thread, e.g. once per UI frame. After release() it reads no channels.
+     */
+    class LevelMeterReader internal constructor(buffer: ByteBuffer) {
+        private val region: ByteBuffer = buffer.order(ByteOrder.nativeOrder())
+
+        // Guarded by this: release() waits for a read in progress before the native memory is freed
+        private var released = false
+
+        /**
+         * Windows published since the stream was opened, unchanged means no new levels
+         */
+        val windowCount: Int
+            get() = synchronized(this) { if (released) 0 else region.getInt(WINDOW_COUNT_OFFSET) }
+
+        /**
+         * Copy the levels of the last window, full scale is 1.0
+         * @param clips Clipped samples per channel since the stream was opened
+         * @return Channel count (0 while stopped, disabled or released), -1 if the audio thread kept writing
+         */
+        fun read(peaks: FloatArray, rms: FloatArray, clips: IntArray): Int = synchronized(this) {
+            if (released) {
+                return 0
+            }
+            repeat(READ_ATTEMPTS) {
+                val before = region.getInt(SEQUENCE_OFFSET)
+                if (before and 1 != 0) {
+                    return@repeat
+                }
+                loadLoadFence()
+                val channels = minOf(region.getInt(CHANNEL_COUNT_OFFSET), peaks.size, rms.size, clips.size)
+                for (channel in 0 until channels) {
+                    val offset = CHANNELS_OFFSET + channel * CHANNEL_BYTES
+                    peaks[channel] = region.getFloat(offset)
+                    rms[channel] = region.getFloat(offset + 4)
+                    clips[channel] = region.getInt(offset + 8)
+                }
+                loadLoadFence()
+                if (region.getInt(SEQUENCE_OFFSET) == before) {
+                    return maxOf(channels, 0)
+                }
+            }
+            return -1
+        }
+
+        internal fun release() {
+            synchronized(this) {
+                released = true
+            }
+        }
+
+        // Below API 33 only the sequence recheck guards the copy, a rare torn read shows for one window
+        private fun loadLoadFence() {
+            if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.TIRAMISU) {
+                VarHandle.loadLoadFence()
+            }
+        }
+
+        private companion object {
+            const val SEQUENCE_OFFSET = 0
+            const val CHANNEL_COUNT_OFFSET = 4
+            const val WINDOW_COUNT_OFFSET = 16
+            const val CHANNELS_OFFSET = 32
+            const val CHANNEL_BYTES = 16
+            const val READ_ATTEMPTS = 8
+        }
+    }
+
+    /**
+     * Meter per-channel peak, RMS and clipping of the output, takes effect on the next play()
+     * @param windowMs Levels are published once per window
+     */
+    fun setLevelMeter(enabled: Boolean, windowMs: Int = 50): Boolean {
+        return setNativeLevelMeter(nativeHandle, enabled, windowMs)
+    }
+
+    /**
+     * Reader of the live output levels, the same one for the lifetime of the player
+     */
+    fun getLevelMeter(): LevelMeterReader? {
+        if (levelMeter == null && nativeHandle != 0L) {
+            levelMeter = getNativeLevelMeterBuffer(nativeHandle)?.let { LevelMeterReader(it) }
+        }
+        return levelMeter
+    }
+
+    enum class PeakIndexSource { NONE, CACHE, INCREMENTAL, SCAN }
+
+    /**
+     * Result of loadPeakIndex(); elapsedNs covers the whole load, scan and cache write included
+     */
+    data class PeakIndexInfo(
+        val frameCount: Long,
+        val sampleRate: Int,
+        val channelCount: Int,
+        val source: PeakIndexSource,
+        val framesScanned: Long,
+        val elapsedNs: Long
+    )
+
+    /**
+     * Waveform overview, values flattened as (min, max, rms) per channel per column, full scale 1.0
+     */
+    class Waveform(val columns: Int, val channelCount: Int, val values: FloatArray) {
+        fun min(column: Int, channel: Int) = values[(column * channelCount + channel) * 3]
+        fun max(column: Int, channel: Int) = values[(column * channelCount + channel) * 3 + 1]
+        fun rms(column: Int, channel: Int) = values[(column * channelCount + channel) * 3 + 2]
+    }
+
+    /**
+     * Load the peak index of a WAV or FLAC file for getWaveform(), blocking: call it off the UI thread
+     * A cached index is mapped as is, a grown file only scans its new frames, others are scanned on all cores.
+     * @param cachePath Index cache, null for the audio path plus ".peaks" (needs a writable directory)
+     * @param threadCount Scan workers, 0 for one per core
+     */
+    fun loadPeakIndex(audioPath: String, cachePath: String? = null, threadCount: Int = 0): PeakIndexInfo? {
+        val values = loadNativePeakIndex(nativeHandle, audioPath, cachePath, threadCount) ?: return null
+        return PeakIndexInfo(
+            values[0], values[1].toInt(), values[2].toInt(),
+            PeakIndexSource.values()[values[3].toInt()], values[4], values[5]
+        )
+    }
+
+    /**
+     * Summarize frames of the loaded peak index into columns, e.g. one per pixel; cheap at any zoom level
+     */
+    fun getWaveform(startFrame: Long, frameCount: Long, columns: Int): Waveform? {
+        val values = getNativeWaveform(nativeHandle, startFrame, frameCount, columns) ?: return null
+        return Waveform(columns, values.size / 3 / columns, values)
+    }
+
     fun release() {
         if (isPlaying) {
             stop()
         }
         try {
-            releaseNative()
+            // The meter buffer points into the native player, readers held elsewhere must stop first
+            levelMeter?.release()
+            levelMeter = null
+            releaseNative(nativeHandle)
+            nativeHandle = 0L
         } catch (e: Exception) {
             Log.e(TAG, "Error releasing native resources", e)
         }
         Log.d(TAG, "AAudioPlayer resources released")
     }
     
+    /**
+     * Snapshot callback timing statistics, safe to poll while playing
+     */
+    fun getCallbackStats(): CallbackStats {
+        // The native side returns null once the player is released, report empty stats then
+        val values = getNativeCallbackStats(nativeHandle) ?: LongArray(17)
+        return CallbackStats(
+            values[0], values[1], values[2], values[3], values[4],
+            Distribution(values[5], values[6], values[7], values[8]),
+            Distribution(values[9], values[10], values[11], values[12]),
+            Distribution(values[13], values[14], values[15], values[16])
+        )
+    }
+
     // Native methods
-    private external fun initializeNative(filePath: String): Boolean
-    private external fun startNativePlayback(): Boolean
-    private external fun stopNativePlayback()
-    private external fun releaseNative()
-    private external fun setNativeConfig(usage: Int, contentType: Int, performanceMode: Int, sharingMode: Int, filePath: String): Boolean
+    private external fun initializeNative(filePath: String): Long
+    private external fun startNativePlayback(handle: Long): Boolean
+    private external fun stopNativePlayback(handle: Long)
+    private external fun releaseNative(handle: Long)
+    private external fun setNativeConfig(handle: Long, usage: Int, contentType: Int, performanceMode: Int, sharingMode: Int, filePath: String): Boolean
+    private external fun setNativePrefetchConfig(handle: Long, depthMs: Int, lowWaterPercent: Int, highWaterPercent: Int): Boolean
+    private external fun setNativeMemoryMapped(handle: Long, enabled: Boolean)
+    private external fun setNativeResampler(handle: Long, enabled: Boolean, quality: Int)
+    private external fun setNativeChannelMapping(handle: Long, channelCount: Int, matrix: FloatArray?): Boolean
+    private external fun getNativePrefetchStats(handle: Long): LongArray?
+    private external fun getNativeCallbackStats(handle: Long): LongArray?
+    private external fun addNativeLayer(handle: Long, filePath: String, gain: Float): Int
+    private external fun removeNativeLayer(handle: Long, layerId: Int): Boolean
+    private external fun setNativeLayerGain(handle: Long, layerId: Int, gain: Float): Boolean
+    private external fun enqueueNativeTrack(handle: Long, filePath: String): Boolean
+    private external fun clearNativeQueue(handle: Long)
+    private external fun getNativeTransitions(handle: Long): LongArray?
+    private external fun seekNative(handle: Long, frame: Long): Boolean
+    private external fun getNativePosition(handle: Long): Long
+    private external fun getNativeSeekLatency(handle: Long): LongArray?
+    private external fun prewarmNativeStream(handle: Long): Boolean
+    private external fun setNativeStreamPool(handle: Long, maxIdleStreams: Int, idleTimeoutMs: Int, powerSavingIdleTimeoutMs: Int): Boolean
+    private external fun getNativeStreamPoolStats(handle: Long): LongArray?
+    private external fun setNativeClipCacheLimits(handle: Long, budgetBytes: Long, maxClipBytes: Long): Boolean
+    private external fun preloadNativeClip(handle: Long, filePath: String): Boolean
+    private external fun clearNativeClipCache(handle: Long)
+    private external fun getNativeClipCacheStats(handle: Long): LongArray?
+    private external fun setNativeBufferTuning(handle: Long, enabled: Boolean, stablePeriodMs: Int, minBursts: Int, maxBursts: Int): Boolean
+    private external fun getNativeBufferTuningStats(handle: Long): LongArray?
+    private external fun getNativeBufferTuningTrace(handle: Long): LongArray?
+    private external fun setNativeLatencyEstimation(handle: Long, enabled: Boolean, sampleIntervalMs: Int, logIntervalMs: Int): Boolean
+    private external fun getNativeLatencyStats(handle: Long): DoubleArray?
+    private external fun setNativeLatencyMarker(handle: Long, enabled: Boolean, type: Int, trigger: Int, triggerPath: String?, triggerFd: Int, periodMs: Int, durationMs: Int): Boolean
+    private external fun getNativeLatencyMarkers(handle: Long): LongArray?
+    private external fun setNativeDspChain(handle: Long, startFadeMs: Int, stopFadeMs: Int, fadeShape: Int, bands: FloatArray?): Boolean
+    private external fun setNativeGain(handle: Long, gain: Float)
+    private external fun setNativeLevelMeter(handle: Long, enabled: Boolean, windowMs: Int): Boolean
+    private external fun getNativeLevelMeterBuffer(handle: Long): ByteBuffer?
+    private external fun loadNativePeakIndex(handle: Long, filePath: String, cachePath: String?, threadCount: Int): LongArray?
+    private external fun getNativeWaveform(handle: Long, startFrame: Long, frameCount: Long, columns: Int): FloatArray?
     
-    // Callback methods called from Native layer
+    // Callback methods called from Native layer, on its event dispatcher thread
     @Suppress("unused")
     private fun onNativePlaybackStarted() {
         isPlaying = true